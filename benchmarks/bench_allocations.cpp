@@ -0,0 +1,54 @@
+#include <atomic>
+#include <new>
+
+#include <cstdlib>
+
+#include <bench_common.hpp>
+
+/*
+    replaces the global allocation functions for the whole benchmark binary, the
+    sized, aligned and array forms all end up in one of these two
+*/
+namespace {
+
+    std::atomic<size_t> allocations{ 0 };
+
+} // namespace
+
+void* operator new( size_t size ) {
+    allocations.fetch_add( 1, std::memory_order_relaxed );
+    if ( void* p = std::malloc( size ? size : 1 ) ) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new( size_t size, std::align_val_t alignment ) {
+    allocations.fetch_add( 1, std::memory_order_relaxed );
+    size_t align = static_cast<size_t>( alignment );
+    // aligned_alloc wants a multiple of the alignment
+    if ( void* p = std::aligned_alloc( align, ( ( size ? size : 1 ) + align - 1 ) / align * align ) ) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete( void* p ) noexcept {
+    std::free( p );
+}
+
+void operator delete( void* p, size_t ) noexcept {
+    std::free( p );
+}
+
+void operator delete( void* p, std::align_val_t ) noexcept {
+    std::free( p );
+}
+
+void operator delete( void* p, size_t, std::align_val_t ) noexcept {
+    std::free( p );
+}
+
+namespace bench {
+
+    size_t allocation_count() {
+        return allocations.load( std::memory_order_relaxed );
+    }
+
+} // namespace bench
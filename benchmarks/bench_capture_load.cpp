@@ -0,0 +1,42 @@
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <string>
+
+#include <cstddef>
+
+#include <capture_loader.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+namespace bench {
+
+    void read_packets( benchmark::State& state, const std::string& name ) {
+        auto& file = test::packet_data_files[ name ];
+        for ( auto _ : state ) {
+            auto packets = ntk::read_packets_from_file( file );
+            benchmark::DoNotOptimize( packets.data() );
+        }
+        state.SetBytesProcessed( state.iterations() * std::filesystem::file_size( file ) );
+    }
+
+    void load_packets( benchmark::State& state, const std::string& name ) {
+        auto& file = test::packet_data_files[ name ];
+        for ( auto _ : state ) {
+            auto arena = ntk::load_packets( file, static_cast<size_t>( state.range( 0 ) ) );
+            benchmark::DoNotOptimize( arena.size() );
+        }
+        state.SetBytesProcessed( state.iterations() * std::filesystem::file_size( file ) );
+    }
+
+    const int registered = []() {
+        for ( std::string name : { "lena", "earth_cam_live_stream" } ) {
+            benchmark::RegisterBenchmark( ( "CaptureLoad/ReadPackets/" + name ).c_str(), read_packets, name );
+            benchmark::RegisterBenchmark( ( "CaptureLoad/Parallel/" + name ).c_str(), load_packets, name )
+                ->Arg( 1 )->Arg( 4 )->Arg( 8 )->UseRealTime();
+        }
+        return 0;
+    }();
+
+} // namespace bench
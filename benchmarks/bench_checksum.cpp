@@ -0,0 +1,44 @@
+#include <bench_common.hpp>
+
+#include <span>
+
+#include <checksum.hpp>
+#include <decoded_packet.hpp>
+
+namespace bench {
+
+    template<uint16_t ( *Sum )( std::span<const uint8_t> )>
+    void ones_complement_sum( benchmark::State& state, const std::string& name ) {
+        auto& frames = packets( name );
+        allocations_per_op allocations( state );
+        for ( auto _ : state ) {
+            for ( auto& frame : frames ) benchmark::DoNotOptimize( Sum( frame ) );
+        }
+        state.SetBytesProcessed( state.iterations() * total_bytes( frames ) );
+        state.SetLabel( Sum == ntk::ones_complement_sum_scalar ? "scalar" : ntk::checksum_kernel_name() );
+    }
+
+    // decode and both checksums, what session_limits::verify_checksums adds per frame
+    void verify_checksums( benchmark::State& state, const std::string& name ) {
+        auto& frames = packets( name );
+        allocations_per_op allocations( state );
+        for ( auto _ : state ) {
+            for ( auto& frame : frames ) {
+                auto decoded = ntk::decode_packet( frame );
+                if ( decoded ) benchmark::DoNotOptimize( ntk::verify_checksums( *decoded ) );
+            }
+        }
+        state.SetBytesProcessed( state.iterations() * total_bytes( frames ) );
+        state.counters[ "pps" ] = benchmark::Counter( static_cast<double>( state.iterations() * frames.size() ), benchmark::Counter::kIsRate );
+    }
+
+    const int registered = []() {
+        for ( std::string name : { "earth_cam_live_stream", "long_stream" } ) {
+            benchmark::RegisterBenchmark( ( "Checksum/Scalar/" + name ).c_str(), ones_complement_sum<ntk::ones_complement_sum_scalar>, name );
+            benchmark::RegisterBenchmark( ( "Checksum/Simd/" + name ).c_str(), ones_complement_sum<ntk::ones_complement_sum>, name );
+            benchmark::RegisterBenchmark( ( "Checksum/Verify/" + name ).c_str(), verify_checksums, name );
+        }
+        return 0;
+    }();
+
+} // namespace bench
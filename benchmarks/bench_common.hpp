@@ -0,0 +1,61 @@
+#ifndef BENCH_COMMON_HPP
+#define BENCH_COMMON_HPP
+
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <constants.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+namespace bench {
+
+    // fixtures from test::packet_data_files, read once and kept for the whole run
+    inline const ntk::session& packets( const std::string& name ) {
+        static std::map<std::string,ntk::session> cache;
+        auto& session = cache[ name ];
+        if ( session.empty() ) session = ntk::read_packets_from_file( test::packet_data_files[ name ] );
+        return session;
+    }
+
+    inline size_t total_bytes( const std::vector<std::vector<uint8_t>>& buffers ) {
+        size_t bytes = 0;
+        for ( auto& buffer : buffers ) bytes += buffer.size();
+        return bytes;
+    }
+
+    // every operator new since the process started, counted in bench_allocations.cpp
+    size_t allocation_count();
+
+    /*
+        counts the allocations made while the benchmark loop runs and reports them
+        as allocs/op when it goes out of scope, construct it right before the loop
+    */
+    class allocations_per_op {
+
+        public:
+            allocations_per_op( benchmark::State& state )
+                : m_state( state ), m_start( allocation_count() ) {}
+
+            ~allocations_per_op() {
+                m_state.counters[ "allocs/op" ] = benchmark::Counter(
+                    static_cast<double>( allocation_count() - m_start ), benchmark::Counter::kAvgIterations );
+            }
+
+            allocations_per_op( const allocations_per_op& ) = delete;
+            allocations_per_op& operator=( const allocations_per_op& ) = delete;
+        private:
+            benchmark::State& m_state;
+            size_t m_start;
+    };
+
+} // namespace bench
+
+#endif
@@ -0,0 +1,78 @@
+#include <benchmark/benchmark.h>
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+#include <hex.hpp>
+
+namespace bench {
+
+    // relative to main/, like the test fixtures
+    const std::string packet_data_dir = "../packet_data";
+
+    const std::vector<std::string>& fixture_lines( const std::string& name ) {
+        static std::map<std::string,std::vector<std::string>> cache;
+        auto& lines = cache[ name ];
+        if ( lines.empty() ) {
+            std::ifstream file( packet_data_dir + "/" + name );
+            if ( !file.is_open() ) std::cerr << "Failed to open fixture: " << name << '\n';
+            std::string line;
+            while ( std::getline( file, line ) ) lines.push_back( line );
+        }
+        return lines;
+    }
+
+    size_t total_chars( const std::vector<std::string>& lines ) {
+        size_t chars = 0;
+        for ( auto& line : lines ) chars += line.size();
+        return chars;
+    }
+
+    // parse_hex_line as it was, an istringstream and std::stoul per byte
+    void legacy( benchmark::State& state, const std::string& name ) {
+        auto& lines = fixture_lines( name );
+        for ( auto _ : state ) {
+            for ( auto& line : lines ) {
+                std::vector<uint8_t> bytes;
+                std::istringstream iss( line );
+                std::string byte_str;
+                while ( iss >> byte_str ) {
+                    bytes.push_back( static_cast<uint8_t>( std::stoul( byte_str, nullptr, 16 ) ) );
+                }
+                benchmark::DoNotOptimize( bytes.data() );
+            }
+        }
+        state.SetBytesProcessed( state.iterations() * total_chars( lines ) );
+    }
+
+    template<size_t ( *Decode )( std::string_view, uint8_t* )>
+    void preallocated( benchmark::State& state, const std::string& name ) {
+        auto& lines = fixture_lines( name );
+        std::vector<uint8_t> buffer( ntk::max_decoded_hex_len( 3 * 65536 ) );
+        for ( auto _ : state ) {
+            for ( auto& line : lines ) {
+                benchmark::DoNotOptimize( Decode( line, buffer.data() ) );
+            }
+            benchmark::ClobberMemory();
+        }
+        state.SetBytesProcessed( state.iterations() * total_chars( lines ) );
+        state.SetLabel( Decode == ntk::decode_hex_line_scalar ? "scalar" : ntk::hex_decoder_name() );
+    }
+
+    const int registered = []() {
+        for ( std::string name : { "algeria", "earth_cam_live_stream" } ) {
+            std::string file = name + ".txt";
+            benchmark::RegisterBenchmark( ( "HexDecode/Legacy/" + name ).c_str(), legacy, file );
+            benchmark::RegisterBenchmark( ( "HexDecode/Scalar/" + name ).c_str(), preallocated<ntk::decode_hex_line_scalar>, file );
+            benchmark::RegisterBenchmark( ( "HexDecode/Simd/" + name ).c_str(), preallocated<ntk::decode_hex_line>, file );
+        }
+        return 0;
+    }();
+
+} // namespace bench
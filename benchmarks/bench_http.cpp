@@ -0,0 +1,81 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+#include <zlib.h>
+
+#include <decompress.hpp>
+#include <http.hpp>
+
+#include <bench_common.hpp>
+
+namespace bench {
+
+    // compressible text in place of a captured body, a few hundred kilobytes of html
+    std::vector<uint8_t> sample_body() {
+        std::string body;
+        for ( size_t i = 0; body.size() < ( 512 << 10 ); ++i ) {
+            body += "<tr><td>" + std::to_string( i ) + "</td><td>ntk benchmark row</td></tr>\n";
+        }
+        return std::vector<uint8_t>( body.begin(), body.end() );
+    }
+
+    std::vector<uint8_t> chunked( const std::vector<uint8_t>& body, size_t chunk_size ) {
+        std::vector<uint8_t> encoded;
+        char size_line[ 32 ];
+        for ( size_t offset = 0; offset < body.size(); offset += chunk_size ) {
+            size_t n = std::min( chunk_size, body.size() - offset );
+            int len = std::snprintf( size_line, sizeof( size_line ), "%zx\r\n", n );
+            encoded.insert( encoded.end(), size_line, size_line + len );
+            encoded.insert( encoded.end(), body.begin() + offset, body.begin() + offset + n );
+            encoded.push_back( '\r' );
+            encoded.push_back( '\n' );
+        }
+        for ( char c : std::string( "0\r\n\r\n" ) ) encoded.push_back( c );
+        return encoded;
+    }
+
+    std::vector<uint8_t> gzipped( const std::vector<uint8_t>& body ) {
+        z_stream zs{};
+        // 16 + 15 window bits asks zlib for a gzip header
+        deflateInit2( &zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY );
+        std::vector<uint8_t> compressed( deflateBound( &zs, body.size() ) );
+        zs.next_in = const_cast<Bytef*>( body.data() );
+        zs.avail_in = static_cast<uInt>( body.size() );
+        zs.next_out = compressed.data();
+        zs.avail_out = static_cast<uInt>( compressed.size() );
+        deflate( &zs, Z_FINISH );
+        compressed.resize( zs.total_out );
+        deflateEnd( &zs );
+        return compressed;
+    }
+
+    void decode_chunked_http_body( benchmark::State& state ) {
+        auto encoded = chunked( sample_body(), static_cast<size_t>( state.range( 0 ) ) );
+        allocations_per_op allocations( state );
+        for ( auto _ : state ) {
+            benchmark::DoNotOptimize( ntk::decode_chunked_http_body( encoded ) );
+        }
+        state.SetBytesProcessed( state.iterations() * encoded.size() );
+    }
+
+    // bytes/s counts the decompressed output, the input is a fraction of it
+    void decompress_gzip( benchmark::State& state ) {
+        auto body = sample_body();
+        auto compressed = gzipped( body );
+        allocations_per_op allocations( state );
+        for ( auto _ : state ) {
+            benchmark::DoNotOptimize( ntk::decompress_gzip( compressed ) );
+        }
+        state.SetBytesProcessed( state.iterations() * body.size() );
+    }
+
+} // namespace bench
+
+BENCHMARK( bench::decode_chunked_http_body )->Name( "HTTP/DecodeChunked" )->Arg( 256 )->Arg( 4096 )->Arg( 16384 );
+BENCHMARK( bench::decompress_gzip )->Name( "HTTP/DecompressGzip" );
@@ -0,0 +1,151 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <cstdint>
+
+#include <ring_buffer.hpp>
+
+namespace bench {
+
+    /*
+        the ring_buffer as it was before the cache-line / bulk rework, kept here as the baseline
+    */
+    template<typename T,size_t N>
+    class legacy_ring_buffer {
+
+        public:
+            legacy_ring_buffer()
+                : m_head( 0 ), m_tail( 0 ) {}
+
+            bool push( const T& item ) {
+                size_t head = m_head.load( std::memory_order_relaxed );
+                size_t tail = m_tail.load( std::memory_order_acquire );
+                size_t next_head = ( head + 1 ) % N;
+                if ( next_head == tail ) return false;
+                m_buffer[ head ] = item;
+                m_head.store( next_head, std::memory_order_release );
+                return true;
+            }
+
+            bool pop( T& item ) {
+                size_t head = m_head.load( std::memory_order_acquire );
+                size_t tail = m_tail.load( std::memory_order_relaxed );
+                if ( head == tail ) return false;
+                item = m_buffer[ tail ];
+                m_tail.store( ( tail + 1 ) % N, std::memory_order_release );
+                return true;
+            }
+        private:
+            std::array<T,N> m_buffer;
+            std::atomic<size_t> m_head;
+            std::atomic<size_t> m_tail;
+    };
+
+    constexpr size_t capacity = 1024;
+    constexpr size_t items_per_run = 1 << 20;
+    constexpr size_t bulk_size = 32;
+
+    using packet = std::vector<uint8_t>;
+
+    template<typename T>
+    T make_item() {
+        if constexpr ( std::is_same_v<T,packet> ) {
+            return packet( 1500, 0xab );
+        } else {
+            return T{};
+        }
+    }
+
+    /*
+        one producer and one consumer thread move items_per_run items through the ring,
+        Move selects push( T&& ) where the ring supports it
+    */
+    template<typename Ring,typename T,bool Move>
+    void transfer( benchmark::State& state ) {
+
+        auto ring = std::make_unique<Ring>();
+
+        for ( auto _ : state ) {
+
+            std::thread consumer( [&]() {
+                T item;
+                for ( size_t received = 0; received < items_per_run; ) {
+                    if ( ring->pop( item ) ) {
+                        benchmark::DoNotOptimize( item );
+                        ++received;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+
+            T prototype = make_item<T>();
+
+            for ( size_t sent = 0; sent < items_per_run; ++sent ) {
+                // a fresh item per push, as the capture callback builds one per packet
+                T item = prototype;
+                if constexpr ( Move ) {
+                    while ( !ring->push( std::move( item ) ) ) std::this_thread::yield();
+                } else {
+                    while ( !ring->push( item ) ) std::this_thread::yield();
+                }
+            }
+
+            consumer.join();
+        }
+
+        state.SetItemsProcessed( state.iterations() * items_per_run );
+    }
+
+    template<typename T>
+    void transfer_bulk( benchmark::State& state ) {
+
+        auto ring = std::make_unique<ntk::ring_buffer<T,capacity>>();
+
+        for ( auto _ : state ) {
+
+            std::thread consumer( [&]() {
+                std::array<T,bulk_size> items;
+                for ( size_t received = 0; received < items_per_run; ) {
+                    size_t n = ring->pop_bulk( items );
+                    benchmark::DoNotOptimize( items );
+                    if ( n == 0 ) std::this_thread::yield();
+                    received += n;
+                }
+            });
+
+            std::array<T,bulk_size> items;
+
+            for ( size_t sent = 0; sent < items_per_run; ) {
+                size_t pushed = ring->push_bulk( std::span<T>( items ).first( std::min( bulk_size, items_per_run - sent ) ) );
+                if ( pushed == 0 ) std::this_thread::yield();
+                sent += pushed;
+            }
+
+            consumer.join();
+        }
+
+        state.SetItemsProcessed( state.iterations() * items_per_run );
+    }
+
+} // namespace bench
+
+BENCHMARK( bench::transfer<bench::legacy_ring_buffer<int,bench::capacity>,int,false> )
+    ->Name( "RingBuffer/Legacy/int" )->UseRealTime();
+BENCHMARK( bench::transfer<ntk::ring_buffer<int,bench::capacity>,int,false> )
+    ->Name( "RingBuffer/Current/int" )->UseRealTime();
+BENCHMARK( bench::transfer_bulk<int> )
+    ->Name( "RingBuffer/CurrentBulk/int" )->UseRealTime();
+
+BENCHMARK( bench::transfer<bench::legacy_ring_buffer<bench::packet,bench::capacity>,bench::packet,false> )
+    ->Name( "RingBuffer/Legacy/packet" )->UseRealTime();
+BENCHMARK( bench::transfer<ntk::ring_buffer<bench::packet,bench::capacity>,bench::packet,true> )
+    ->Name( "RingBuffer/CurrentMove/packet" )->UseRealTime();
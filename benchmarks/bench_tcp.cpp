@@ -0,0 +1,127 @@
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include <cstdint>
+
+#include <ipv4.hpp>
+#include <session_columns.hpp>
+#include <tcp.hpp>
+#include <tcp_replay.hpp>
+#include <utils.hpp>
+
+#include <bench_common.hpp>
+
+namespace bench {
+
+    void parse_tcp_header( benchmark::State& state ) {
+        auto ipv4 = ntk::parse_ipv4_header( ntk::extract_ipv4_header( test::ethernet_frame_tcp ) );
+        auto raw_header = ntk::extract_tcp_header( test::ethernet_frame_tcp, ipv4.ihl );
+        allocations_per_op allocations( state );
+        for ( auto _ : state ) {
+            benchmark::DoNotOptimize( ntk::parse_tcp_header( raw_header ) );
+        }
+        state.SetBytesProcessed( state.iterations() * raw_header.size() );
+    }
+
+    void get_four_from_ethernet( benchmark::State& state, const std::string& name ) {
+        auto& session = packets( name );
+        allocations_per_op allocations( state );
+        for ( auto _ : state ) {
+            for ( auto& packet : session ) benchmark::DoNotOptimize( ntk::get_four_from_ethernet( packet ) );
+        }
+        state.SetItemsProcessed( state.iterations() * session.size() );
+        state.SetBytesProcessed( state.iterations() * total_bytes( session ) );
+    }
+
+    // a fresh session per run, every stream is opened, reassembled and completed inside the loop
+    void session_feed( benchmark::State& state, const std::string& name ) {
+        auto& session = packets( name );
+        allocations_per_op allocations( state );
+        for ( auto _ : state ) {
+            ntk::tcp_live_stream_session live_stream_session( nullptr );
+            for ( auto& packet : session ) live_stream_session.feed( packet );
+            benchmark::DoNotOptimize( live_stream_session.statistics() );
+        }
+        state.counters[ "pps" ] = benchmark::Counter( static_cast<double>( state.iterations() * session.size() ), benchmark::Counter::kIsRate );
+        state.SetBytesProcessed( state.iterations() * total_bytes( session ) );
+    }
+
+    void merge_tcp_stream_non_overlapping( benchmark::State& state, const std::string& name ) {
+        auto stream = ntk::get_tcp_stream( ntk::extract_raw_tcp_stream( packets( name ) ) );
+        size_t bytes = 0;
+        for ( auto& [ seq, data ] : stream ) bytes += data.size();
+        allocations_per_op allocations( state );
+        for ( auto _ : state ) {
+            benchmark::DoNotOptimize( ntk::merge_tcp_stream_non_overlapping( stream ) );
+        }
+        state.SetBytesProcessed( state.iterations() * bytes );
+    }
+
+    // counting FIN_ACKs by parsing every header against one pass over session_columns::flags()
+    void count_fin_ack_parsed( benchmark::State& state, const std::string& name ) {
+        auto& session = packets( name );
+        auto fin_ack = static_cast<uint8_t>( ntk::tcp_flags::FIN_ACK );
+        allocations_per_op allocations( state );
+        for ( auto _ : state ) {
+            size_t n = 0;
+            for ( auto& packet : session ) {
+                if ( ntk::is_tcp_v( packet ) ) n += ( ntk::get_tcp_header( packet.data() ).flags & fin_ack ) == fin_ack;
+            }
+            benchmark::DoNotOptimize( n );
+        }
+        state.SetItemsProcessed( state.iterations() * session.size() );
+    }
+
+    void count_fin_ack_columns( benchmark::State& state, const std::string& name ) {
+        ntk::session_columns columns( packets( name ) );
+        auto fin_ack = static_cast<uint8_t>( ntk::tcp_flags::FIN_ACK );
+        allocations_per_op allocations( state );
+        for ( auto _ : state ) {
+            benchmark::DoNotOptimize( ntk::count_flags( columns, fin_ack, fin_ack ) );
+        }
+        state.SetItemsProcessed( state.iterations() * columns.size() );
+    }
+
+    // every connection's handshake and termination, rescanning the session per connection as tcp_transfer did
+    void offline_scanners( benchmark::State& state, const std::string& name ) {
+        auto& session = packets( name );
+        auto fours = ntk::get_four_tuples( session );
+        allocations_per_op allocations( state );
+        for ( auto _ : state ) {
+            for ( auto& four : fours ) {
+                benchmark::DoNotOptimize( ntk::get_handshake( four, session ) );
+                benchmark::DoNotOptimize( ntk::get_termination( four, session ) );
+            }
+        }
+        state.SetBytesProcessed( state.iterations() * total_bytes( session ) );
+    }
+
+    // the same out of one pass through the live engine
+    void offline_replay( benchmark::State& state, const std::string& name ) {
+        auto& session = packets( name );
+        allocations_per_op allocations( state );
+        for ( auto _ : state ) {
+            benchmark::DoNotOptimize( ntk::replay_streams( session ) );
+        }
+        state.SetBytesProcessed( state.iterations() * total_bytes( session ) );
+    }
+
+    const int registered = []() {
+        benchmark::RegisterBenchmark( "TCP/ParseHeader", parse_tcp_header );
+        for ( std::string name : { "tiny_cross", "lena" } ) {
+            benchmark::RegisterBenchmark( ( "TCP/FourFromEthernet/" + name ).c_str(), get_four_from_ethernet, name );
+            benchmark::RegisterBenchmark( ( "TCP/SessionFeed/" + name ).c_str(), session_feed, name );
+            benchmark::RegisterBenchmark( ( "TCP/CountFinAck/Parsed/" + name ).c_str(), count_fin_ack_parsed, name );
+            benchmark::RegisterBenchmark( ( "TCP/CountFinAck/Columns/" + name ).c_str(), count_fin_ack_columns, name );
+        }
+        benchmark::RegisterBenchmark( "TCP/MergeNonOverlapping/lena", merge_tcp_stream_non_overlapping, "lena" );
+        // one connection, and a capture with many for the scanners to go over again for each
+        for ( std::string name : { "lena", "earth_cam_live_stream" } ) {
+            benchmark::RegisterBenchmark( ( "TCP/Offline/Scanners/" + name ).c_str(), offline_scanners, name );
+            benchmark::RegisterBenchmark( ( "TCP/Offline/Replay/" + name ).c_str(), offline_replay, name );
+        }
+        return 0;
+    }();
+
+} // namespace bench
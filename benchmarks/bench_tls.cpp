@@ -0,0 +1,165 @@
+#include <benchmark/benchmark.h>
+
+#include <iterator>
+#include <span>
+#include <vector>
+
+#include <cstdint>
+
+#include <tcp.hpp>
+#include <tls.hpp>
+#include <tls_decryptor.hpp>
+#include <work_stealing_pool.hpp>
+#include <utils.hpp>
+
+#include <bench_common.hpp>
+
+namespace bench {
+
+    // the server side of a captured https transfer, one payload per segment
+    std::vector<std::vector<uint8_t>> server_payloads( const std::string& name ) {
+        auto& session = packets( name );
+        auto four = *ntk::get_four_tuples( session ).begin();
+        return ntk::extract_payloads( ntk::flip_four( four ), session );
+    }
+
+    void split_tls_records( benchmark::State& state, const std::string& name ) {
+        std::vector<uint8_t> payload;
+        for ( auto& p : server_payloads( name ) ) payload.insert( payload.end(), p.begin(), p.end() );
+        allocations_per_op allocations( state );
+        for ( auto _ : state ) {
+            benchmark::DoNotOptimize( ntk::split_tls_records( payload ) );
+        }
+        state.SetBytesProcessed( state.iterations() * payload.size() );
+    }
+
+    void extract_tls_records( benchmark::State& state, const std::string& name ) {
+        auto payloads = server_payloads( name );
+        allocations_per_op allocations( state );
+        for ( auto _ : state ) {
+            benchmark::DoNotOptimize( ntk::extract_tls_records( payloads ) );
+        }
+        state.SetBytesProcessed( state.iterations() * total_bytes( payloads ) );
+    }
+
+    // the payloads already reassembled, what a framer over a live stream sees
+    void tls_record_framer( benchmark::State& state, const std::string& name ) {
+        std::vector<uint8_t> stream;
+        for ( auto& p : server_payloads( name ) ) stream.insert( stream.end(), p.begin(), p.end() );
+        allocations_per_op allocations( state );
+        for ( auto _ : state ) {
+            ntk::tls_record_framer framer;
+            while ( auto view = framer.next( stream ) ) benchmark::DoNotOptimize( view );
+        }
+        state.SetBytesProcessed( state.iterations() * stream.size() );
+    }
+
+    struct encrypted_handshake {
+        ntk::client_hello client_hello;
+        ntk::server_hello server_hello;
+        std::vector<ntk::tls_record> records;
+        size_t bytes;
+    };
+
+    // the encrypted handshake of tls_handshake, with the keys main/ keeps for the tests
+    encrypted_handshake handshake_records() {
+
+        auto& session = packets( "tls_handshake" );
+        auto merged_stream = ntk::get_merged_tcp_stream( session );
+
+        auto& first_packet = merged_stream.begin()->second;
+        auto& second_packet = std::next( merged_stream.begin() )->second;
+
+        auto [ first_records, first_offset ] = *ntk::split_tls_records( first_packet );
+
+        std::vector<uint8_t> remainder( first_packet.begin() + first_offset, first_packet.end() );
+        remainder.insert( remainder.end(), second_packet.begin(), second_packet.end() );
+
+        auto [ encrypted_records, offset ] = *ntk::split_tls_records( remainder );
+
+        auto client_hello_bytes = ntk::extract_payload_from_ethernet( session[ 3 ].data() );
+        auto client_hello = ntk::parse_client_hello( std::span<const uint8_t>( client_hello_bytes ).subspan( 9 ) );
+        auto server_hello = ntk::parse_server_hello( std::span<const uint8_t>( first_records[ 0 ].payload ).subspan( 4 ) );
+
+        size_t bytes = 0;
+        for ( auto& record : encrypted_records ) bytes += record.payload.size();
+
+        return { client_hello, server_hello, encrypted_records, bytes };
+    }
+
+    void decrypt_tls_data( benchmark::State& state ) {
+
+        auto handshake = handshake_records();
+        auto session_keys = ntk::get_tls_secrets( "tls_session_keys.log" );
+
+        allocations_per_op allocations( state );
+        for ( auto _ : state ) {
+            benchmark::DoNotOptimize( ntk::decrypt_tls_data( handshake.client_hello.random, handshake.server_hello.random,
+                handshake.server_hello.server_version, handshake.server_hello.cipher_suite, handshake.records, session_keys ) );
+        }
+        state.SetBytesProcessed( state.iterations() * handshake.bytes );
+    }
+
+    // the same records through one keyed decryptor into one buffer, what a connection pays per record
+    void tls_decryptor( benchmark::State& state ) {
+
+        auto handshake = handshake_records();
+        auto session_keys = ntk::get_tls_secrets( "tls_session_keys.log" );
+        auto secret = ntk::get_traffic_secret( session_keys, handshake.client_hello.random, "SERVER_HANDSHAKE_TRAFFIC_SECRET" );
+
+        ntk::tls_decryptor decryptor( handshake.server_hello.cipher_suite, secret );
+        std::vector<uint8_t> plain_text;
+
+        allocations_per_op allocations( state );
+        for ( auto _ : state ) {
+            decryptor.seek( 0 );
+            for ( auto& record : handshake.records ) {
+                benchmark::DoNotOptimize( decryptor.decrypt( record, plain_text ) );
+            }
+        }
+        state.SetBytesProcessed( state.iterations() * handshake.bytes );
+    }
+
+    // the application data of long_stream, serially and across a pool of state.range( 0 ) threads
+    void decrypt_long_stream( benchmark::State& state ) {
+
+        auto& session = packets( "long_stream" );
+        auto four = *ntk::get_four_tuples( session ).begin();
+        auto client_records = ntk::extract_tls_records( ntk::extract_payloads( four, session ) ).records;
+        auto server_records = ntk::extract_tls_records( ntk::extract_payloads( ntk::flip_four( four ), session ) ).records;
+
+        auto client_hello = ntk::get_client_hello( client_records[ 0 ] );
+        auto server_hello = ntk::get_server_hello( server_records[ 0 ] );
+        auto session_keys = ntk::get_tls_secrets( "sslkeys.log", client_hello.random );
+        auto secret = ntk::get_traffic_secret( session_keys, client_hello.random, "SERVER_TRAFFIC_SECRET_0" );
+
+        std::vector<ntk::tls_record> records( server_records.begin() + 3, server_records.end() );
+        size_t bytes = 0;
+        for ( auto& record : records ) bytes += record.payload.size();
+
+        ntk::work_stealing_pool pool( static_cast<size_t>( std::max<int64_t>( state.range( 0 ), 1 ) ) );
+        for ( auto _ : state ) {
+            if ( state.range( 0 ) == 0 ) {
+                benchmark::DoNotOptimize( ntk::decrypt_tls_data( client_hello.random, server_hello.random,
+                    server_hello.server_version, server_hello.cipher_suite, records, session_keys, "SERVER_TRAFFIC_SECRET_0" ) );
+            } else {
+                benchmark::DoNotOptimize( ntk::decrypt_tls_records_parallel( server_hello.cipher_suite, secret, records, pool, 8 ) );
+            }
+        }
+        state.SetBytesProcessed( state.iterations() * bytes );
+    }
+
+    const int registered = []() {
+        for ( std::string name : { "short_stream", "long_stream" } ) {
+            benchmark::RegisterBenchmark( ( "TLS/SplitRecords/" + name ).c_str(), split_tls_records, name );
+            benchmark::RegisterBenchmark( ( "TLS/ExtractRecords/" + name ).c_str(), extract_tls_records, name );
+            benchmark::RegisterBenchmark( ( "TLS/FrameRecords/" + name ).c_str(), tls_record_framer, name );
+        }
+        benchmark::RegisterBenchmark( "TLS/DecryptHandshake", decrypt_tls_data );
+        benchmark::RegisterBenchmark( "TLS/DecryptHandshake/Decryptor", tls_decryptor );
+        // 0 is decrypt_tls_data on the calling thread
+        benchmark::RegisterBenchmark( "TLS/DecryptLongStream", decrypt_long_stream )->Arg( 0 )->Arg( 1 )->Arg( 2 )->Arg( 4 )->UseRealTime();
+        return 0;
+    }();
+
+} // namespace bench
@@ -0,0 +1,59 @@
+#ifndef CAPTURE_ANALYSIS_HPP
+#define CAPTURE_ANALYSIS_HPP
+
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include <cstddef>
+
+#include <constants.hpp>
+#include <flow_index.hpp>
+#include <http.hpp>
+#include <tcp.hpp>
+#include <tls.hpp>
+
+namespace ntk {
+
+    struct capture_analysis_options {
+        size_t threads = 0;             // one per hardware thread when 0
+        bool extract_tls = true;
+        bool parse_http = true;
+    };
+
+    /*
+        everything reconstructed about one flow of a capture. client is the side that
+        sent the syn, or the first packet's sender when the handshake was not captured.
+        tls records are extracted when the client opens with a tls handshake record,
+        otherwise the first http request and response are parsed if the payload is http
+    */
+    struct flow_analysis {
+        size_t flow_number;             // position in flow_index::flows(), results arrive in any order
+        four_tuple client;
+
+        tcp_handshake handshake;
+        std::vector<tcp_termination> terminations;
+
+        tcp_stream client_stream;       // merged, keyed by sequence number
+        tcp_stream server_stream;
+
+        std::vector<tls_record> client_tls_records;
+        std::vector<tls_record> server_tls_records;
+
+        std::optional<http_request> request;
+        std::optional<http_response> response;
+    };
+
+    flow_analysis analyze_flow( const flow_index& index, size_t flow_number, const capture_analysis_options& options = {} );
+
+    /*
+        analyses every flow of packets on a pool of worker threads, each taking the next
+        flow not yet claimed. on_flow is called once per flow from the workers, one call
+        at a time, and it should be quick as it holds up the worker that made the result.
+        returns the number of flows once every result has been delivered
+    */
+    size_t analyze_capture( const session& packets, const capture_analysis_options& options, const std::function<void( flow_analysis&& )>& on_flow );
+
+} // namespace ntk
+
+#endif
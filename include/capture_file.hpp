@@ -0,0 +1,101 @@
+#ifndef CAPTURE_FILE_HPP
+#define CAPTURE_FILE_HPP
+
+#include <iterator>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <constants.hpp>
+#include <pcap_file.hpp>
+#include <tcp.hpp>
+
+namespace ntk {
+
+    /*
+        read-only memory-mapped view of a capture in any capture_format
+
+        iterating yields one std::span<const uint8_t> per packet, parsed only when the
+        iterator reaches it. for PCAP and PCAPNG the span points straight into the
+        mapping, for HEX into the iterator, either way it is valid until the iterator
+        moves on. pages are mapped for sequential access so resident memory follows the
+        part of the file being read rather than its size
+    */
+    class capture_file {
+
+        public:
+            class iterator {
+
+                public:
+                    using iterator_category = std::forward_iterator_tag;
+                    using value_type = std::span<const uint8_t>;
+                    using difference_type = std::ptrdiff_t;
+                    using pointer = void;
+                    using reference = std::span<const uint8_t>;
+
+                    iterator() = default;
+                    iterator( const iterator& other );
+                    iterator( iterator&& other ) = default;
+                    iterator& operator=( const iterator& other );
+                    iterator& operator=( iterator&& other ) = default;
+
+                    std::span<const uint8_t> operator*() const;
+
+                    // timestamps and wire length of the current packet
+                    const capture_record_view& record() const;
+                    // the current packet as stored in the file, see capture_cursor::stored_record
+                    std::span<const uint8_t> stored_record() const;
+
+                    iterator& operator++();
+                    iterator operator++( int );
+
+                    bool operator==( const iterator& other ) const;
+                private:
+                    iterator( std::span<const uint8_t> capture );
+
+                    void rebind();
+
+                    capture_cursor m_cursor;
+                    std::optional<capture_record_view> m_record;
+                    size_t m_index = 0;
+
+                    friend class capture_file;
+            };
+
+            capture_file( const std::string& filename );
+            ~capture_file();
+
+            capture_file( const capture_file& ) = delete;
+            capture_file& operator=( const capture_file& ) = delete;
+
+            bool is_open() const;
+            capture_format format() const;
+            // the pcap LINKTYPE_ of the packets, see to_link_type for picking their decoder
+            uint32_t datalink() const;
+            size_t size_bytes() const;
+            // the whole file, e.g. to find where a stored_record() is in it
+            std::span<const uint8_t> bytes() const;
+
+            iterator begin() const;
+            iterator end() const;
+        private:
+            const uint8_t* m_data;
+            size_t m_size;
+            bool m_open;
+            bool m_mapped;
+            // holds the contents where the platform has no mmap
+            std::vector<uint8_t> m_contents;
+    };
+
+    std::unordered_set<four_tuple> get_four_tuples( const capture_file& packets );
+
+    tcp_stream get_merged_tcp_stream( const capture_file& packets );
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef CAPTURE_LOADER_HPP
+#define CAPTURE_LOADER_HPP
+
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <constants.hpp>
+
+namespace ntk {
+
+    /*
+        the packets of a capture back to back in one buffer, in capture order
+
+        one allocation for the bytes and one for the offsets instead of one per packet,
+        packet i is [ offsets[ i ], offsets[ i + 1 ] ) of the buffer. the buffer is not
+        zeroed up front, its pages are first touched by the threads that fill them
+    */
+    class packet_arena {
+
+        public:
+            size_t size() const;
+            bool empty() const;
+            // the decoded bytes of every packet together
+            size_t size_bytes() const;
+
+            std::span<const uint8_t> operator[]( size_t i ) const;
+
+            // a copy as the per-packet vectors the rest of the library takes
+            session to_session() const;
+        private:
+            std::unique_ptr<uint8_t[]> m_bytes;
+            std::vector<size_t> m_offsets{ 0 };
+
+            friend packet_arena load_packets( const std::string& filename, size_t threads );
+    };
+
+    /*
+        reads a capture in any capture_format into a packet_arena on several threads
+
+        the mapped file is split into byte ranges that start on a record boundary, a
+        line for HEX and a record header for PCAP and PCAPNG, and every range is decoded
+        by its own thread straight into its place in the arena. the packets are the
+        same and in the same order as read_packets_from_file. threads of zero uses
+        every hardware thread, an unreadable file gives an empty arena
+    */
+    packet_arena load_packets( const std::string& filename, size_t threads = 0 );
+
+} // namespace ntk
+
+#endif
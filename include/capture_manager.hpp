@@ -0,0 +1,108 @@
+#ifndef CAPTURE_MANAGER_HPP
+#define CAPTURE_MANAGER_HPP
+
+#include <atomic>
+#include <expected>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <captured_packet.hpp>
+#include <packet_capture.hpp>
+#include <packet_listener.hpp>
+#include <ring_buffer.hpp>
+#include <statistics.hpp>
+#include <tcp_sharded_session.hpp>
+
+namespace ntk {
+
+    // one device a capture_manager listens on
+    struct interface_capture {
+        std::string device;
+        std::string filter;
+        capture_backend backend = capture_backend::PCAP;
+        tpacket_options ring_options;
+        capture_options options;
+    };
+
+    struct interface_statistics {
+        std::string device;
+        std::string filter;             // the one in place now
+        capture_statistics capture;     // the listener's own
+        uint64_t frames_merged;         // handed to the session
+        ring_statistics hand_off;       // of the ring between the capture thread and the merge thread
+    };
+
+    /*
+        captures on several devices at once into one tcp_sharded_session, e.g. both
+        links of a bond
+
+        every device has its packet_listener and capture thread, which copies each frame
+        with its timestamp into the device's own ring. one merge thread takes up to a
+        batch from each ring in turn and feeds the session, which stays the single
+        producer it has to be and routes every frame to its shard by flow hash, so a flow
+        whose directions arrive on different devices is still put together in one place.
+        a full ring holds the capture thread back and the kernel buffer takes the burst.
+        the devices must deliver frames of the session's link type, see
+        tcp_sharded_session::link, start() refuses a device whose datalink is another
+
+        set_filter() swaps the BPF program of running captures, see packet_listener::set_filter
+    */
+    class capture_manager {
+
+        public:
+            static constexpr size_t interface_ring_size = 4096;
+
+            capture_manager( tcp_sharded_session& session );
+            ~capture_manager();
+
+            capture_manager( const capture_manager& ) = delete;
+            capture_manager& operator=( const capture_manager& ) = delete;
+
+            // before start(), returns the interface's index
+            size_t add_interface( const interface_capture& capture );
+
+            /*
+                every listener or none, the ones already started are stopped again when one
+                fails to start or delivers another link type than the session decodes
+            */
+            bool start();
+            // stops the listeners and feeds what their rings still hold, the session is left running
+            void stop();
+
+            /*
+                on every interface, where any of them refuses it the ones already swapped go
+                back to their previous filter
+            */
+            std::expected<void,std::string> set_filter( const std::string& filter_exp );
+            std::expected<void,std::string> set_filter( size_t interface_index, const std::string& filter_exp );
+
+            size_t number_of_interfaces() const;
+            // meant for the thread that starts and stops the manager, like packet_listener::statistics
+            std::vector<interface_statistics> statistics();
+        private:
+            struct interface {
+                interface( const interface_capture& capture );
+
+                interface_capture capture;
+                std::unique_ptr<packet_listener> listener;
+                ring_buffer<captured_packet,interface_ring_size> ring;
+                relaxed_counter merged;
+            };
+
+            void merge();
+
+            tcp_sharded_session& m_session;
+            std::vector<std::unique_ptr<interface>> m_interfaces;
+            std::thread m_merge_thread;
+            std::atomic<bool> m_stop;
+            bool m_running;
+    };
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef CAPTURE_REPLAY_HPP
+#define CAPTURE_REPLAY_HPP
+
+#include <atomic>
+#include <chrono>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <packet_listener.hpp>
+#include <packet_pool.hpp>
+#include <pcap_file.hpp>
+#include <statistics.hpp>
+#include <thread_placement.hpp>
+#include <tpacket_ring.hpp>
+
+namespace ntk {
+
+    enum class replay_pacing {
+        ORIGINAL,               // the recorded gaps divided by speed, HEX captures have none
+        PACKETS_PER_SECOND,
+        BITS_PER_SECOND,
+        UNPACED                 // as fast as the callback returns
+    };
+
+    struct replay_options {
+        replay_pacing pacing = replay_pacing::ORIGINAL;
+        double speed = 1.0;         // ORIGINAL, 2.0 replays twice as fast
+        double rate = 0;            // PACKETS_PER_SECOND or BITS_PER_SECOND
+        size_t loops = 1;
+        // every flow is sent this many times per loop, each copy on its own ephemeral port
+        size_t flow_copies = 1;
+        // stamp frames with the time they are sent, so the pipeline's latencies are end to end
+        bool restamp = true;
+    };
+
+    struct replay_statistics {
+        uint64_t packets;
+        uint64_t bytes;
+        std::chrono::nanoseconds elapsed;
+        std::chrono::nanoseconds max_lag;   // furthest behind its schedule a frame was handed over
+
+        double packets_per_second() const;
+        double bits_per_second() const;
+    };
+
+    /*
+        replays a capture file through the packet_listener callbacks, as a repeatable load source
+
+        the file, hex text or pcap, is read into memory up front so disk reads do not
+        limit the rate. frames are handed over from a thread of its own at the pace the
+        options ask for, short waits are spun since sleeping is only good to tens of
+        microseconds. loops and copies after the first are offset in their ephemeral
+        port ( see offset_ephemeral_port ), so the session sees them as distinct flows.
+        frames that fall behind the schedule are sent at once, max_lag reports by how much
+    */
+    class capture_replay {
+
+        public:
+            capture_replay( const std::string& filename, const replay_options& options = {} );
+            ~capture_replay();
+
+            capture_replay( const capture_replay& ) = delete;
+            capture_replay& operator=( const capture_replay& ) = delete;
+
+            bool is_open() const;
+            size_t frame_count() const;
+
+            bool start( packet_callback callback );
+            // one frame per batch
+            bool start_batch( packet_batch_callback callback );
+            // frames are dropped while the pool is exhausted, like packet_listener does
+            bool start( packet_pool& pool, packet_view_callback callback );
+            void stop();
+            // blocks until every loop has been sent or stop() was called
+            void wait();
+            bool is_capturing() const;
+            void place_capture_thread( const thread_placement& placement );
+
+            // received counts the frames sent, readable while replaying
+            capture_statistics statistics() const;
+            // elapsed and max_lag are filled in once the replay has finished
+            replay_statistics report() const;
+        private:
+            void run();
+            bool wait_until( std::chrono::steady_clock::time_point due );
+
+            replay_options m_options;
+            std::vector<capture_record> m_records;
+            bool m_open;
+
+            packet_callback m_callback;
+            std::thread m_replay_thread;
+            thread_placement m_placement;
+            std::atomic<bool> m_capturing;
+            std::atomic<bool> m_stop;
+
+            std::atomic<uint64_t> m_packets;
+            std::atomic<uint64_t> m_bytes;
+            std::atomic<int64_t> m_elapsed;
+            std::atomic<int64_t> m_max_lag;
+            relaxed_counter m_pool_exhausted;
+    };
+
+    /*
+        adds offset to the higher of a tcp frame's two ports, the same one in both
+        directions, and patches the checksum. false and untouched for anything but tcp
+        over ipv4 in ethernet
+    */
+    bool offset_ephemeral_port( std::span<uint8_t> frame, uint16_t offset );
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef CAPTURED_PACKET_HPP
+#define CAPTURED_PACKET_HPP
+
+#include <chrono>
+#include <span>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ntk {
+
+    // pcap timestamps are wall-clock, so they compare directly against capture_clock::now()
+    using capture_clock = std::chrono::system_clock;
+    using capture_time = std::chrono::time_point<capture_clock,std::chrono::nanoseconds>;
+
+    /*
+        a frame together with the pcap_pkthdr fields that a bare byte vector loses
+
+        len is the length on the wire and is larger than caplen when the snaplen
+        truncated the frame, bytes always holds caplen bytes
+    */
+    struct captured_packet {
+        capture_time timestamp;
+        uint32_t caplen;
+        uint32_t len;
+        std::vector<uint8_t> bytes;
+
+        const uint8_t* data() const { return bytes.data(); }
+        size_t size() const { return bytes.size(); }
+
+        bool operator==( const captured_packet& other ) const = default;
+    };
+
+    capture_time to_capture_time( uint32_t ts_sec, uint32_t ts_usec );
+
+    captured_packet make_captured_packet( uint32_t ts_sec, uint32_t ts_usec, uint32_t len, std::span<const uint8_t> bytes );
+
+    captured_packet make_captured_packet( capture_time timestamp, std::span<const uint8_t> bytes );
+
+} // namespace ntk
+
+#endif
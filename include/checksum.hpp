@@ -0,0 +1,82 @@
+#ifndef CHECKSUM_HPP
+#define CHECKSUM_HPP
+
+#include <span>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <statistics.hpp>
+
+namespace ntk {
+
+    struct decoded_packet;
+
+    /*
+        the internet checksum, rfc 1071
+
+        the sum is taken over native 16 bit words and byte swapped once at the end, which
+        gives the same result as summing big-endian words. long spans are summed with
+        SIMD where the cpu supports it
+    */
+
+    // the ones' complement sum of data as big-endian words, a trailing odd byte padded with zero. not complemented
+    uint16_t ones_complement_sum( std::span<const uint8_t> data );
+
+    // the portable path, kept callable for tests and benchmarks
+    uint16_t ones_complement_sum_scalar( std::span<const uint8_t> data );
+
+    // combines the sums of two spans, the second has to start at an even offset of the whole
+    constexpr uint16_t ones_complement_add( uint16_t a, uint16_t b ) {
+        uint32_t sum = static_cast<uint32_t>( a ) + b;
+        return static_cast<uint16_t>( ( sum & 0xffff ) + ( sum >> 16 ) );
+    }
+
+    // name of the summing kernel selected for this cpu: "avx2", "neon" or "scalar"
+    const char* checksum_kernel_name();
+
+    enum class checksum_status {
+        VALID,
+        INVALID,
+        OFFLOADED,      // left for the nic to fill in, zero or only the pseudo header sum, as on frames captured on their way out
+        UNVERIFIABLE    // cut short by the snaplen, or an ip length zeroed by segmentation offload
+    };
+
+    struct checksum_result {
+        checksum_status ip;     // ipv6 has no header checksum and is always VALID
+        checksum_status tcp;
+
+        bool invalid() const { return ip == checksum_status::INVALID || tcp == checksum_status::INVALID; }
+    };
+
+    // the ipv4 header at frame[ ip_offset ], which must hold all of it
+    checksum_status verify_ipv4_header_checksum( std::span<const uint8_t> frame, size_t ip_offset );
+
+    // the ipv4 header checksum and the tcp checksum over its pseudo header, header and payload
+    checksum_result verify_checksums( const decoded_packet& packet );
+
+    struct checksum_statistics {
+        uint64_t verified;          // frames whose every checksum was checked and valid
+        uint64_t ip_invalid;
+        uint64_t tcp_invalid;
+        uint64_t offloaded;         // not counted as failures
+        uint64_t unverifiable;
+    };
+
+    // counts checksum_results from one thread, statistics() may be called from any
+    class checksum_counters {
+
+        public:
+            void count( const checksum_result& result );
+            checksum_statistics statistics() const;
+        private:
+            relaxed_counter m_verified;
+            relaxed_counter m_ip_invalid;
+            relaxed_counter m_tcp_invalid;
+            relaxed_counter m_offloaded;
+            relaxed_counter m_unverifiable;
+    };
+
+} // namespace ntk
+
+#endif
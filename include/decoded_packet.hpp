@@ -0,0 +1,77 @@
+#ifndef DECODED_PACKET_HPP
+#define DECODED_PACKET_HPP
+
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <constants.hpp>
+#include <flow_key.hpp>
+
+namespace ntk {
+
+    struct tcp_option;
+
+    /*
+        ipv4 or ipv6 / tcp frame decoded in one pass
+
+        holds the fixed header fields by value and points into the frame for the
+        options and payload, so building one never allocates and the frame must
+        outlive it. options are left raw and parsed only when asked for
+    */
+    struct decoded_packet {
+        std::span<const uint8_t> frame;
+
+        ip_address source_ip;
+        ip_address destination_ip;
+        uint16_t source_port;
+        uint16_t destination_port;
+
+        uint32_t sequence_number;
+        uint32_t acknowledgment_number;
+        uint8_t flags;
+        uint16_t window_size;
+
+        uint8_t ip_version;
+        uint16_t network_offset;       // where the ip header starts, after the link layer
+        uint16_t ip_header_len;        // bytes, ipv6 extension headers included
+        uint16_t tcp_header_len;       // bytes, options included
+        uint32_t ip_total_len;         // the ipv4 total length, or the ipv6 payload length plus the fixed header
+
+        std::span<const uint8_t> raw_options;
+        // ends at the ip total length, so ethernet padding on short frames is left out
+        std::span<const uint8_t> payload;
+
+        four_tuple four() const {
+            return four_tuple{ source_ip, destination_ip, source_port, destination_port };
+        }
+
+        std::vector<tcp_option> options() const;
+
+        // flag tests, members so the vector predicates in tcp.hpp stay usable as function pointers
+        bool is_syn() const { return ( flags & 0x12 ) == 0x02; }
+        bool is_syn_ack() const { return ( flags & 0x12 ) == 0x12; }
+        bool is_ack() const { return ( flags & 0x10 ) != 0; }
+        bool is_fin_ack() const { return ( flags & 0x11 ) == 0x11; }
+        bool is_reset() const { return ( flags & 0x04 ) != 0; }
+        bool is_data_packet() const { return !payload.empty(); }
+        bool is_ack_only_packet() const { return !is_data_packet() && is_ack(); }
+    };
+
+    /*
+        nothing when the frame is not ipv4 or ipv6 / tcp, is a fragment or is too short
+        for the headers it claims. the frame starts with an ethernet header, see
+        decode_packet_as in link_layer.hpp for other link types
+    */
+    std::optional<decoded_packet> decode_packet( std::span<const uint8_t> frame );
+
+    std::vector<tcp_option> parse_tcp_options( std::span<const uint8_t> raw_options );
+
+    bool is_same_connection( const decoded_packet& packet, const four_tuple& four );
+
+} // namespace ntk
+
+#endif
@@ -1,7 +1,14 @@
 #ifndef DECOMPRESS_HPP
 #define DECOMPRESS_HPP
 
+#include <array>
+#include <expected>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <stdexcept>
 #include <zlib.h>
@@ -11,6 +18,106 @@ namespace ntk {
 
     std::string decompress_gzip( const std::vector<uint8_t>& compressed );
 
+    enum class content_coding {
+        IDENTITY,
+        GZIP,
+        DEFLATE         // zlib framed as it should be, or raw deflate as some servers send it
+    };
+
+    // from a Content-Encoding value, nullopt for a coding that cannot be inflated, e.g. br
+    std::optional<content_coding> parse_content_coding( std::string_view content_encoding );
+
+    /*
+        z_streams kept for reuse
+
+        setting up a z_stream allocates its window and state, a pooled one is only reset.
+        each comes with its output buffer. thread safe, an inflater may be made on any
+        thread and return its stream from another
+    */
+    class inflater_pool {
+
+        public:
+            static constexpr size_t output_size = 32 * 1024;
+
+            struct context {
+                z_stream stream{};
+                std::array<uint8_t,output_size> output;
+            };
+
+            // at most max_idle streams are kept between uses
+            inflater_pool( size_t max_idle = 64 );
+            ~inflater_pool();
+
+            inflater_pool( const inflater_pool& ) = delete;
+            inflater_pool& operator=( const inflater_pool& ) = delete;
+
+            // reset for window_bits as inflateInit2 takes them, nullptr if zlib could not set one up
+            context* acquire( int window_bits );
+            void release( context* ctx );
+
+            size_t idle() const;
+        private:
+            size_t m_max_idle;
+            mutable std::mutex m_mutex;
+            std::vector<context*> m_idle;
+    };
+
+    inflater_pool& default_inflater_pool();
+
+    /*
+        streaming gzip / deflate decompression
+
+        fed the compressed body chunk after chunk as it arrives, it hands each piece of
+        output to a callback as a span into its pooled output buffer, so a body of any
+        size inflates in constant memory. the span is valid during the callback. which
+        deflate framing is used is decided from the first byte. an identity coding is
+        passed through
+    */
+    class inflater {
+
+        public:
+            inflater( content_coding coding, inflater_pool& pool = default_inflater_pool() );
+            ~inflater();
+
+            inflater( inflater&& other ) noexcept;
+            inflater& operator=( inflater&& other ) noexcept;
+            inflater( const inflater& ) = delete;
+            inflater& operator=( const inflater& ) = delete;
+
+            template<typename F>
+            std::expected<void,std::string> feed( std::span<const uint8_t> input, F&& on_output ) {
+                if ( input.empty() || m_done ) return {};
+                if ( m_coding == content_coding::IDENTITY ) {
+                    m_total_out += input.size();
+                    on_output( input );
+                    return {};
+                }
+                bool more = true;
+                while ( more && !m_done ) {
+                    auto output = next( input, more );
+                    if ( !output ) return std::unexpected( output.error() );
+                    if ( !output->empty() ) on_output( *output );
+                }
+                // the output buffer is not needed once the stream ended
+                if ( m_done ) release();
+                return {};
+            }
+
+            // the end of the compressed stream was read
+            bool done() const;
+            size_t total_out() const;
+        private:
+            // inflates what fits in the output buffer, more is true while there is input or output left
+            std::expected<std::span<const uint8_t>,std::string> next( std::span<const uint8_t>& input, bool& more );
+            void release();
+
+            content_coding m_coding;
+            inflater_pool* m_pool;
+            inflater_pool::context* m_context;
+            bool m_done;
+            size_t m_total_out;
+    };
+
 } // namespace ntk
 
 #endif
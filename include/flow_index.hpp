@@ -0,0 +1,61 @@
+#ifndef FLOW_INDEX_HPP
+#define FLOW_INDEX_HPP
+
+#include <unordered_map>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <constants.hpp>
+#include <flow_key.hpp>
+
+namespace ntk {
+
+    /*
+        every tcp flow of a session and where its packets are, built in one pass
+
+        each packet is decoded once and filed under its flow_key, so analysing all F
+        flows of a capture costs O(N) header parses instead of one rescan per flow.
+        packets are kept as indices into the session in capture order, with a bit for
+        whether they travel against the direction of the flow's first packet. the
+        session must outlive the index
+    */
+    class flow_index {
+
+        public:
+            struct flow_packet {
+                uint32_t index : 31;
+                uint32_t reverse : 1;
+            };
+
+            struct flow {
+                four_tuple four;            // as sent by the flow's first packet
+                std::vector<flow_packet> packets;
+
+                // true when the packet was sent by four's source, four being either direction of the flow
+                bool is_sent_by( const flow_packet& packet, const four_tuple& sender ) const {
+                    return ( sender == four ) != static_cast<bool>( packet.reverse );
+                }
+            };
+
+            flow_index( const session& packets );
+
+            const session& packets() const;
+            const std::vector<uint8_t>& packet( const flow_packet& p ) const;
+
+            // either direction of the flow finds it
+            const flow* find( const four_tuple& four ) const;
+
+            // in order of each flow's first packet
+            const std::vector<flow>& flows() const;
+            size_t size() const;
+        private:
+            const session* m_packets;
+            std::vector<flow> m_flows;
+            std::unordered_map<flow_key,uint32_t,flow_key_hash> m_index;
+    };
+
+} // namespace ntk
+
+#endif
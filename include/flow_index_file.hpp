@@ -0,0 +1,117 @@
+#ifndef FLOW_INDEX_FILE_HPP
+#define FLOW_INDEX_FILE_HPP
+
+#include <expected>
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <captured_packet.hpp>
+#include <constants.hpp>
+#include <flow_key.hpp>
+
+namespace ntk {
+
+    /*
+        a flow_index saved next to its capture, so one flow of a large capture can be
+        read without scanning the rest
+
+        the file is a fixed header, one flow record per tcp flow sorted by flow_key and
+        the packet records of every flow back to back, each giving where the packet is
+        stored in the capture. it is mapped read-only and used in place, finding a flow
+        is a binary search and reading it touches only its own packets. records are in
+        host byte order, an index written with another byte order or format version, or
+        for a capture that has changed size since, is refused
+    */
+    class flow_index_file {
+
+        public:
+            static constexpr uint32_t format_version = 1;
+            static constexpr uint32_t no_position = std::numeric_limits<uint32_t>::max();
+
+            struct packet {
+                uint64_t offset;            // of the stored record in the capture, its hex line for HEX
+                uint32_t size;
+                uint32_t reverse;           // 1 when sent against the flow's four
+                int64_t timestamp;          // nanoseconds since the epoch, zero for HEX captures
+            };
+
+            struct flow {
+                four_tuple four;            // as sent by the flow's first packet
+                uint32_t first_packet;      // into the packet records
+                uint32_t packet_count;
+                // positions within the flow's packets, no_position when there is none
+                uint32_t handshake_end;     // the ack completing the handshake
+                uint32_t termination_start; // the first fin or rst
+                int64_t first_timestamp;
+                int64_t last_timestamp;
+            };
+
+            // the index at flow_index_path( capture )
+            flow_index_file( const std::string& capture );
+            flow_index_file( const std::string& capture, const std::string& index );
+            ~flow_index_file();
+
+            flow_index_file( const flow_index_file& ) = delete;
+            flow_index_file& operator=( const flow_index_file& ) = delete;
+
+            bool is_open() const;
+            // why the index could not be used
+            const std::string& error() const;
+
+            // sorted by flow_key
+            std::span<const flow> flows() const;
+            size_t size() const;
+
+            // either direction of the flow finds it
+            const flow* find( const four_tuple& four ) const;
+            std::span<const packet> packets( const flow& f ) const;
+
+            // points into the capture, or into scratch for a HEX capture
+            std::span<const uint8_t> frame( const packet& p, std::vector<uint8_t>& scratch ) const;
+
+            // the flow's packets in capture order, nothing when the index has no such flow
+            session read_flow( const four_tuple& four ) const;
+            std::vector<captured_packet> read_captured_flow( const four_tuple& four ) const;
+        private:
+            struct mapping {
+                const uint8_t* data = nullptr;
+                size_t size = 0;
+                bool mapped = false;
+                // holds the contents where the platform has no mmap
+                std::vector<uint8_t> contents;
+            };
+
+            static bool map( const std::string& filename, mapping& m );
+            static void unmap( mapping& m );
+            bool fail( const std::string& error );
+
+            mapping m_capture;
+            mapping m_index;
+            bool m_hex = false;
+
+            std::span<const flow> m_flows;
+            std::span<const packet> m_packets;
+            std::string m_error;
+    };
+
+    // capture.pcap gets capture.pcap.flows
+    std::string flow_index_path( const std::string& capture );
+
+    /*
+        indexes every tcp flow of a capture in one pass and writes the result to index,
+        replacing it only once it is complete. returns the number of flows
+    */
+    std::expected<size_t,std::string> write_flow_index( const std::string& capture, const std::string& index );
+
+    inline std::expected<size_t,std::string> write_flow_index( const std::string& capture ) {
+        return write_flow_index( capture, flow_index_path( capture ) );
+    }
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef FLOW_KEY_HPP
+#define FLOW_KEY_HPP
+
+#include <array>
+#include <compare>
+#include <functional>
+#include <span>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ntk {
+
+    /*
+        an ipv6 address, or an ipv4 one held as its ipv4-mapped form ::ffff:a.b.c.d
+
+        built implicitly from a host order uint32_t, so ipv4 code keeps passing plain
+        addresses. two 64 bit halves in host order make comparing and hashing as cheap
+        as for a pair of integers, and order the same as the addresses' bytes
+    */
+    struct ip_address {
+        uint64_t high = 0;
+        uint64_t low = 0;
+
+        constexpr ip_address() = default;
+
+        constexpr ip_address( uint32_t v4 )
+            : high( 0 ), low( 0x0000ffff00000000ULL | v4 ) {}
+
+        // 16 bytes in network order
+        static ip_address from_bytes( std::span<const uint8_t,16> bytes );
+        std::array<uint8_t,16> bytes() const;
+
+        constexpr bool is_v4() const { return high == 0 && ( low >> 32 ) == 0xffff; }
+        // the ipv4 address in host order, only meaningful when is_v4()
+        constexpr uint32_t v4() const { return static_cast<uint32_t>( low ); }
+
+        constexpr bool operator==( const ip_address& other ) const = default;
+        constexpr auto operator<=>( const ip_address& other ) const = default;
+    };
+
+    struct four_tuple {
+        ip_address client_ip;
+        ip_address server_ip;
+        uint16_t client_port;
+        uint16_t server_port;
+
+        bool operator==( const four_tuple& other ) const {
+            return client_ip == other.client_ip &&
+                server_ip == other.server_ip &&
+                client_port == other.client_port &&
+                server_port == other.server_port;
+        }
+    };
+
+    /*
+        key naming a flow regardless of direction
+
+        the endpoint with the lower ( ip, port ) comes first, so a four_tuple and its
+        flip_four give the same key and a bidirectional lookup is a single probe
+    */
+    struct flow_key {
+        ip_address low_ip;
+        ip_address high_ip;
+        uint16_t low_port;
+        uint16_t high_port;
+
+        flow_key() = default;
+
+        // implicit, so containers keyed by flow_key can be queried with either direction's four_tuple
+        flow_key( const four_tuple& four ) {
+            bool client_low = four.client_ip < four.server_ip ||
+                              ( four.client_ip == four.server_ip && four.client_port <= four.server_port );
+            low_ip = client_low ? four.client_ip : four.server_ip;
+            high_ip = client_low ? four.server_ip : four.client_ip;
+            low_port = client_low ? four.client_port : four.server_port;
+            high_port = client_low ? four.server_port : four.client_port;
+        }
+
+        bool operator==( const flow_key& other ) const = default;
+    };
+
+    namespace flow_hash {
+
+        // wyhash style: fold the 128-bit product of the two halves back onto itself
+        inline uint64_t mix( uint64_t a, uint64_t b ) {
+            unsigned __int128 product = static_cast<unsigned __int128>( a ) * b;
+            return static_cast<uint64_t>( product ) ^ static_cast<uint64_t>( product >> 64 );
+        }
+
+        // an ipv4 address is its low half as it is, the high half of an ipv6 one is mixed in
+        inline uint64_t fold( const ip_address& ip ) {
+            return ip.high ? ip.low ^ mix( ip.high ^ 0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL ) : ip.low;
+        }
+
+        inline uint64_t hash_endpoints( const ip_address& ip_a, uint16_t port_a, const ip_address& ip_b, uint16_t port_b ) {
+            // the top 16 bits of a folded ipv4 address are clear, the port goes there
+            uint64_t a = fold( ip_a ) ^ ( static_cast<uint64_t>( port_a ) << 48 );
+            uint64_t b = fold( ip_b ) ^ ( static_cast<uint64_t>( port_b ) << 48 );
+            return mix( a ^ 0xa0761d6478bd642fULL, b ^ 0xe7037ed1a0b428dbULL );
+        }
+
+    } // namespace flow_hash
+
+    struct flow_key_hash {
+        size_t operator()( const flow_key& key ) const noexcept {
+            return static_cast<size_t>( flow_hash::hash_endpoints( key.low_ip, key.low_port, key.high_ip, key.high_port ) );
+        }
+    };
+
+    /*
+        Toeplitz hash as computed by NICs for receive side scaling
+
+        the input is the source and destination addresses followed by the source and
+        destination ports, all in network byte order, 12 bytes for ipv4 and 36 for ipv6.
+        the key is expanded into one table per input byte up front, so hashing is one
+        lookup per byte rather than eight key shifts. an ipv6 flow needs a 40 byte key,
+        with a shorter one each address is folded to 32 bits and hashed as ipv4
+    */
+    class toeplitz_hasher {
+
+        public:
+            static constexpr size_t min_key_len = 16;   // 12 input bytes plus the 32-bit window
+            static constexpr size_t ipv6_key_len = 40;  // 36 input bytes plus the window
+
+            toeplitz_hasher( std::span<const uint8_t> key );
+
+            uint32_t operator()( const four_tuple& four ) const;
+
+            // the hash selects an entry of an indirection table and the entry a queue, for
+            // the default table that ethtool installs this is ( hash % table_size ) % n_queues
+            static size_t queue_of( uint32_t hash, size_t n_queues, size_t table_size = 128 );
+        private:
+            uint32_t hash( std::span<const uint8_t> input ) const;
+
+            std::array<std::array<uint32_t,256>,36> m_tables;
+            size_t m_input_len;
+    };
+
+    /*
+        0x6d5a repeated, with it the Toeplitz hash of a flow is the same in both
+        directions, which is what lets one shard see both halves of a connection
+    */
+    inline constexpr std::array<uint8_t,40> symmetric_rss_key = {
+        0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+        0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+        0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+        0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a
+    };
+
+} // namespace ntk
+
+namespace std {
+
+    template <>
+    struct hash<ntk::four_tuple> {
+        size_t operator()( const ntk::four_tuple& ft ) const noexcept {
+            return static_cast<size_t>( ntk::flow_hash::hash_endpoints( ft.client_ip, ft.client_port, ft.server_ip, ft.server_port ) );
+        }
+    };
+
+} // namespace std
+
+#endif
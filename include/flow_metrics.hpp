@@ -0,0 +1,90 @@
+#ifndef FLOW_METRICS_HPP
+#define FLOW_METRICS_HPP
+
+#include <array>
+#include <chrono>
+#include <optional>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <captured_packet.hpp>
+#include <decoded_packet.hpp>
+#include <snapshot.hpp>
+
+namespace ntk {
+
+    // what one side of a connection sent, bytes are tcp payload
+    struct direction_metrics {
+        uint64_t packets = 0;
+        uint64_t bytes = 0;
+        uint64_t retransmissions = 0;   // payload only repeating bytes already seen
+        uint64_t out_of_order = 0;      // payload filling a gap shortly after it opened
+        uint64_t zero_windows = 0;      // times the advertised window dropped to zero
+    };
+
+    /*
+        counters of a tcp connection kept up to date packet by packet, so a flow can be
+        watched without holding any of its frames. each direction remembers the highest
+        sequence number it sent and up to max_gaps holes below it. a segment that lands
+        in a hole is out of order when it comes within the handshake rtt ( or 3ms ) of the
+        hole opening and a retransmission of a segment lost before the capture point
+        otherwise, without timestamps it is always out of order. one that lands on
+        bytes already seen is a retransmission
+    */
+    class flow_metrics {
+
+        public:
+            static constexpr size_t max_gaps = 4;
+
+            // from_client as the stream decided it, the side that sent the syn
+            void add( const decoded_packet& packet, bool from_client );
+            void add( const decoded_packet& packet, bool from_client, capture_time timestamp );
+
+            const direction_metrics& client() const;
+            const direction_metrics& server() const;
+
+            // syn to the client's ack of the syn_ack, only with timestamps
+            std::optional<std::chrono::nanoseconds> handshake_rtt() const;
+            // first to last packet, only with timestamps
+            std::optional<std::chrono::nanoseconds> duration() const;
+
+            // for checkpointing a session, the counters carry on from where they were
+            void save( snapshot_writer& out ) const;
+            bool restore( snapshot_reader& in );
+        private:
+            struct gap {
+                uint32_t begin;
+                uint32_t end;
+                std::optional<capture_time> opened;
+            };
+
+            struct direction_state {
+                direction_metrics metrics;
+                bool started = false;
+                uint32_t next_seq = 0;      // one past the highest sequence number sent
+                bool zero_window = false;
+                std::array<gap,max_gaps> gaps{};
+                size_t gap_count = 0;
+            };
+
+            void add( const decoded_packet& packet, bool from_client, std::optional<capture_time> timestamp );
+            void track_sequence( direction_state& state, const decoded_packet& packet, std::optional<capture_time> timestamp );
+            // true when [ begin, end ) overlaps a hole, which is then narrowed to what is still missing
+            bool fill_gap( direction_state& state, uint32_t begin, uint32_t end, std::optional<capture_time> timestamp, bool& late );
+            void open_gap( direction_state& state, uint32_t begin, uint32_t end, std::optional<capture_time> timestamp );
+            std::chrono::nanoseconds reorder_window() const;
+
+            direction_state m_client;
+            direction_state m_server;
+
+            std::optional<capture_time> m_first_packet;
+            std::optional<capture_time> m_last_packet;
+            std::optional<capture_time> m_syn;
+            std::optional<uint32_t> m_syn_ack_seq;
+            std::optional<std::chrono::nanoseconds> m_handshake_rtt;
+    };
+
+} // namespace ntk
+
+#endif
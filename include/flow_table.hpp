@@ -0,0 +1,152 @@
+#ifndef FLOW_TABLE_HPP
+#define FLOW_TABLE_HPP
+
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ntk {
+
+    /*
+        slot map from a flow key to its state
+
+        values live in a vector of slots that is only ever appended to, an erased slot
+        goes on a free list and is reused by the next emplace, so lookup, insert and
+        erase are O(1) and no value is moved when another flow comes or goes. the index
+        maps a key to its slot number, slot numbers stay valid until the flow is erased,
+        pointers returned by find() only until the next emplace
+    */
+    template<typename Key,typename T,typename Hash = std::hash<Key>>
+    class flow_table {
+
+        struct slot {
+            Key key;
+            std::optional<T> value;
+        };
+
+        public:
+            template<bool Const>
+            class basic_iterator {
+
+                using slots_type = std::conditional_t<Const,const std::vector<slot>,std::vector<slot>>;
+
+                public:
+                    using iterator_category = std::forward_iterator_tag;
+                    using value_type = T;
+                    using difference_type = std::ptrdiff_t;
+                    using pointer = std::conditional_t<Const,const T*,T*>;
+                    using reference = std::conditional_t<Const,const T&,T&>;
+
+                    basic_iterator() = default;
+
+                    basic_iterator( slots_type* slots, size_t index )
+                        : m_slots( slots ), m_index( index ) {
+                        skip_empty();
+                    }
+
+                    reference operator*() const { return *( *m_slots )[ m_index ].value; }
+                    pointer operator->() const { return &**this; }
+
+                    basic_iterator& operator++() {
+                        ++m_index;
+                        skip_empty();
+                        return *this;
+                    }
+
+                    basic_iterator operator++( int ) {
+                        basic_iterator previous = *this;
+                        ++*this;
+                        return previous;
+                    }
+
+                    bool operator==( const basic_iterator& other ) const { return m_index == other.m_index; }
+                private:
+                    void skip_empty() {
+                        while ( m_index < m_slots->size() && !( *m_slots )[ m_index ].value ) ++m_index;
+                    }
+
+                    slots_type* m_slots = nullptr;
+                    size_t m_index = 0;
+            };
+
+            using iterator = basic_iterator<false>;
+            using const_iterator = basic_iterator<true>;
+
+            T* find( const Key& key ) {
+                auto it = m_index.find( key );
+                return it == m_index.end() ? nullptr : &*m_slots[ it->second ].value;
+            }
+
+            const T* find( const Key& key ) const {
+                auto it = m_index.find( key );
+                return it == m_index.end() ? nullptr : &*m_slots[ it->second ].value;
+            }
+
+            bool contains( const Key& key ) const {
+                return m_index.contains( key );
+            }
+
+            // the key must not be present yet
+            template<typename... Args>
+            T& emplace( const Key& key, Args&&... args ) {
+
+                uint32_t index;
+
+                if ( !m_free.empty() ) {
+                    index = m_free.back();
+                    m_free.pop_back();
+                    m_slots[ index ].key = key;
+                } else {
+                    index = static_cast<uint32_t>( m_slots.size() );
+                    m_slots.push_back( slot{ key, std::nullopt } );
+                }
+
+                m_slots[ index ].value.emplace( std::forward<Args>( args )... );
+                m_index.emplace( key, index );
+
+                return *m_slots[ index ].value;
+            }
+
+            bool erase( const Key& key ) {
+                auto it = m_index.find( key );
+                if ( it == m_index.end() ) return false;
+
+                m_slots[ it->second ].value.reset();
+                m_free.push_back( it->second );
+                m_index.erase( it );
+
+                return true;
+            }
+
+            void reserve( size_t n ) {
+                m_slots.reserve( n );
+                m_index.reserve( n );
+            }
+
+            size_t size() const {
+                return m_index.size();
+            }
+
+            bool empty() const {
+                return m_index.empty();
+            }
+
+            iterator begin() { return iterator( &m_slots, 0 ); }
+            iterator end() { return iterator( &m_slots, m_slots.size() ); }
+            const_iterator begin() const { return const_iterator( &m_slots, 0 ); }
+            const_iterator end() const { return const_iterator( &m_slots, m_slots.size() ); }
+        private:
+            std::vector<slot> m_slots;
+            std::vector<uint32_t> m_free;
+            std::unordered_map<Key,uint32_t,Hash> m_index;
+    };
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef FRAME_ARENA_HPP
+#define FRAME_ARENA_HPP
+
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ntk {
+
+    /*
+        the frames of one stream, copied into a per-stream bump arena
+
+        bytes go into a std::pmr::monotonic_buffer_resource drawing geometrically growing
+        blocks from the upstream resource, so a long flow costs a few dozen allocations
+        instead of one per packet, and all of it is handed back in one go when the arena
+        is released or destroyed. the arena is made on the first frame, a stream that
+        never carries traffic allocates nothing. a copy gets an arena of its own from
+        the same upstream
+
+        with compress() on, frames are collected outside the arena and sealed lz4
+        compressed once a whole block of them has arrived, a block that does not shrink
+        is kept as it is. begin(), end() and operator[] inflate the sealed blocks into the
+        arena the first time they are called, like tcp_reassembler::contiguous(), so a
+        stream does that on the thread that reads it after the offload
+    */
+    class frame_arena {
+
+        public:
+            static constexpr size_t initial_block_size = 16 * 1024;
+            static constexpr size_t default_block_size = 64 * 1024;
+
+            frame_arena( std::pmr::memory_resource* upstream = std::pmr::get_default_resource() );
+
+            frame_arena( const frame_arena& other );
+            frame_arena( frame_arena&& other ) noexcept = default;
+            frame_arena& operator=( const frame_arena& other );
+            frame_arena& operator=( frame_arena&& other ) noexcept = default;
+
+            // under compress() the span lasts until the next push_back
+            std::span<const uint8_t> push_back( std::span<const uint8_t> frame );
+
+            // frees every frame at once, the upstream and compress() are kept for what comes next
+            void release();
+
+            std::vector<std::span<const uint8_t>>::const_iterator begin() const;
+            std::vector<std::span<const uint8_t>>::const_iterator end() const;
+            std::span<const uint8_t> operator[]( size_t index ) const;
+            size_t size() const;
+            bool empty() const;
+
+            // every frame in order without inflating the sealed blocks for good, e.g. to write a snapshot
+            template<typename Visitor>
+            void for_each( Visitor visitor ) const {
+                for ( auto frame : m_frames ) visitor( frame );
+                std::vector<uint8_t> inflated;
+                for ( auto& sealed : m_sealed ) {
+                    inflated.resize( sealed.size );
+                    inflate( sealed, inflated );
+                    visit_frames( inflated, sealed.lengths, visitor );
+                }
+                visit_frames( m_open, m_open_lengths, visitor );
+            }
+
+            /*
+                seals the frames held and every later one in blocks of at least block_size,
+                zero inflates what is sealed and stops
+            */
+            void compress( size_t block_size = default_block_size );
+            // what the frames take in memory, sealed blocks as they are stored
+            size_t stored_bytes() const;
+
+            std::pmr::memory_resource* upstream() const;
+        private:
+            struct sealed_block {
+                std::vector<uint8_t> bytes;
+                size_t size;                    // inflated
+                bool compressed;
+                std::vector<uint32_t> lengths;  // of its frames
+            };
+
+            template<typename Visitor>
+            static void visit_frames( std::span<const uint8_t> bytes, const std::vector<uint32_t>& lengths, Visitor& visitor ) {
+                for ( auto length : lengths ) {
+                    visitor( bytes.first( length ) );
+                    bytes = bytes.subspan( length );
+                }
+            }
+
+            std::span<uint8_t> allocate( size_t bytes ) const;
+            // compresses m_open into one block
+            void seal();
+            static void inflate( const sealed_block& sealed, std::span<uint8_t> into );
+            // copies the sealed blocks and m_open into the arena behind m_frames
+            void unseal() const;
+
+            std::pmr::memory_resource* m_upstream;
+            // behind a pointer so the frames stay put when the arena moves
+            mutable std::unique_ptr<std::pmr::monotonic_buffer_resource> m_arena;
+            // the frames in the arena, ahead of the sealed ones and those in m_open. all change under unseal()
+            mutable std::vector<std::span<const uint8_t>> m_frames;
+            mutable std::vector<sealed_block> m_sealed;
+            mutable std::vector<uint8_t> m_open;
+            mutable std::vector<uint32_t> m_open_lengths;
+            mutable size_t m_sealed_frames = 0;
+            mutable size_t m_sealed_stored = 0;
+            mutable size_t m_arena_bytes = 0;
+            // zero when frames are not compressed
+            size_t m_block_size = 0;
+    };
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef GENERATOR_HPP
+#define GENERATOR_HPP
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <version>
+
+#ifdef __cpp_lib_generator
+#include <generator>
+#endif
+
+#include <cstddef>
+
+namespace ntk {
+
+#ifdef __cpp_lib_generator
+
+    template<typename T>
+    using generator = std::generator<T>;
+
+#else
+
+    /*
+        the part of std::generator the lazy apis need, for standard libraries without <generator>
+
+        a move-only input view over a coroutine that starts on the first begin() and runs to
+        the next co_yield on every increment. yielded values are not copied, the iterator
+        points at them where they sit in the suspended coroutine, except for a const lvalue
+        which is copied as std::generator does. an exception thrown by the coroutine comes out
+        of begin() or the increment that resumed it
+    */
+    template<typename T>
+    class generator : public std::ranges::view_base {
+
+        using value = std::remove_cvref_t<T>;
+
+        public:
+            class promise_type {
+
+                public:
+                    generator get_return_object() {
+                        return generator( std::coroutine_handle<promise_type>::from_promise( *this ) );
+                    }
+
+                    std::suspend_always initial_suspend() noexcept { return {}; }
+                    std::suspend_always final_suspend() noexcept { return {}; }
+
+                    std::suspend_always yield_value( value& yielded ) noexcept {
+                        m_value = std::addressof( yielded );
+                        return {};
+                    }
+
+                    std::suspend_always yield_value( value&& yielded ) noexcept {
+                        m_value = std::addressof( yielded );
+                        return {};
+                    }
+
+                    auto yield_value( const value& yielded ) requires std::copy_constructible<value> {
+
+                        // the copy lives in the awaiter, which lasts as long as the coroutine is suspended on it
+                        struct copy_awaiter {
+                            value m_copy;
+                            promise_type* m_promise;
+
+                            bool await_ready() const noexcept { return false; }
+                            void await_suspend( std::coroutine_handle<> ) noexcept { m_promise->m_value = std::addressof( m_copy ); }
+                            void await_resume() const noexcept {}
+                        };
+
+                        return copy_awaiter{ yielded, this };
+                    }
+
+                    void return_void() noexcept {}
+
+                    void unhandled_exception() {
+                        m_exception = std::current_exception();
+                    }
+
+                    template<typename U>
+                    std::suspend_never await_transform( U&& ) = delete;
+                private:
+                    friend class generator;
+
+                    value* m_value = nullptr;
+                    std::exception_ptr m_exception;
+            };
+
+            class iterator {
+
+                public:
+                    using value_type = value;
+                    using difference_type = std::ptrdiff_t;
+
+                    iterator() = default;
+
+                    value& operator*() const {
+                        return *m_coroutine.promise().m_value;
+                    }
+
+                    iterator& operator++() {
+                        resume( m_coroutine );
+                        return *this;
+                    }
+
+                    void operator++( int ) {
+                        ++*this;
+                    }
+
+                    friend bool operator==( const iterator& it, std::default_sentinel_t ) {
+                        return it.m_coroutine.done();
+                    }
+                private:
+                    friend class generator;
+
+                    explicit iterator( std::coroutine_handle<promise_type> coroutine )
+                        : m_coroutine( coroutine ) {}
+
+                    std::coroutine_handle<promise_type> m_coroutine;
+            };
+
+            generator( generator&& other ) noexcept
+                : m_coroutine( std::exchange( other.m_coroutine, {} ) ) {}
+
+            generator& operator=( generator other ) noexcept {
+                std::swap( m_coroutine, other.m_coroutine );
+                return *this;
+            }
+
+            ~generator() {
+                if ( m_coroutine ) m_coroutine.destroy();
+            }
+
+            // once per generator, as with any input range
+            iterator begin() {
+                resume( m_coroutine );
+                return iterator( m_coroutine );
+            }
+
+            std::default_sentinel_t end() const noexcept {
+                return std::default_sentinel;
+            }
+        private:
+            explicit generator( std::coroutine_handle<promise_type> coroutine )
+                : m_coroutine( coroutine ) {}
+
+            static void resume( std::coroutine_handle<promise_type> coroutine ) {
+                coroutine.resume();
+                if ( coroutine.promise().m_exception ) {
+                    std::rethrow_exception( std::exchange( coroutine.promise().m_exception, {} ) );
+                }
+            }
+
+            std::coroutine_handle<promise_type> m_coroutine;
+    };
+
+#endif
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef HEX_HPP
+#define HEX_HPP
+
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ntk {
+
+    /*
+        decoding of the HEX capture format, one packet per line written as "%02x "
+
+        every whitespace separated token is read as a hex number and truncated to a
+        byte, a token with a non-hex character keeps the digits before it. runs of
+        well-formed "xx " pairs are decoded with SIMD where the cpu supports it
+    */
+
+    // upper bound on the bytes decode_hex_line can produce for a line
+    constexpr size_t max_decoded_hex_len( size_t line_len ) {
+        return ( line_len + 1 ) / 2;
+    }
+
+    // decodes into out, which must hold max_decoded_hex_len( line.size() ) bytes
+    size_t decode_hex_line( std::string_view line, uint8_t* out );
+
+    void decode_hex_line( std::string_view line, std::vector<uint8_t>& bytes );
+
+    // the portable path, kept callable for tests and benchmarks
+    size_t decode_hex_line_scalar( std::string_view line, uint8_t* out );
+
+    // name of the block decoder selected for this cpu: "avx2", "ssse3" or "scalar"
+    const char* hex_decoder_name();
+
+} // namespace ntk
+
+#endif
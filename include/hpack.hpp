@@ -0,0 +1,60 @@
+#ifndef HPACK_HPP
+#define HPACK_HPP
+
+#include <deque>
+#include <expected>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ntk {
+
+    struct hpack_header {
+        std::string name;
+        std::string value;
+    };
+
+    // a string literal encoded with the static huffman code of rfc 7541 appendix b
+    std::expected<std::string,std::string> hpack_huffman_decode( std::span<const uint8_t> encoded );
+
+    /*
+        hpack decoder for the header blocks one endpoint receives
+
+        keeps the dynamic table the peer's encoder builds, so every block of a connection's
+        direction has to go through the same decoder, in order. a block that does not
+        decode leaves the table out of step with the encoder, the connection cannot be
+        followed after that
+    */
+    class hpack_decoder {
+
+        public:
+            static constexpr size_t default_table_size = 4096;
+
+            hpack_decoder( size_t max_table_size = default_table_size );
+
+            // the fields of a complete block are appended to headers, in the order they were sent
+            std::expected<void,std::string> decode( std::span<const uint8_t> block, std::vector<hpack_header>& headers );
+
+            // the SETTINGS_HEADER_TABLE_SIZE the receiving endpoint announced, the encoder cannot go above it
+            void set_max_table_size( size_t size );
+
+            // as hpack counts it, 32 bytes on top of each entry's name and value
+            size_t table_size() const;
+            size_t table_entries() const;
+        private:
+            const hpack_header* entry( uint64_t index ) const;
+            void insert( hpack_header header );
+            void evict();
+
+            std::deque<hpack_header> m_table;       // newest first
+            size_t m_size;
+            size_t m_capacity;                      // set by the encoder's size updates
+            size_t m_limit;                         // set by SETTINGS
+    };
+
+} // namespace ntk
+
+#endif
@@ -2,16 +2,23 @@
 #define HTTP_HPP
 
 #include <algorithm>
+#include <array>
 
 #include <cstdint>
 #include <cstring>
 
+#include <deque>
+#include <expected>
+#include <optional>
 #include <unordered_map>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <sstream>
 
 #include <constants.hpp>
+#include <stream_events.hpp>
 #include <tcp.hpp>
 
 namespace ntk {
@@ -19,7 +26,72 @@ namespace ntk {
     // TODO: check http rules on whitespace in headers
     std::string trim( const std::string& str );
 
-    using http_headers = std::unordered_map<std::string,std::string>;
+    // header names compare without case, "content-length" is "Content-Length"
+    struct http_header_name_hash {
+        using is_transparent = void;
+        size_t operator()( std::string_view name ) const;
+    };
+
+    struct http_header_name_equal {
+        using is_transparent = void;
+        bool operator()( std::string_view lhs, std::string_view rhs ) const;
+    };
+
+    using http_headers = std::unordered_map<std::string,std::string,http_header_name_hash,http_header_name_equal>;
+
+    struct http_header_field {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    /*
+        the header lines of a message, as views into the buffer they were parsed from
+
+        fields sit in a flat array, inline up to inline_fields of them, so a typical
+        header block is parsed without allocating. names are looked up without case.
+        the headers that decide how a body is framed and read are found once, while
+        parsing, and their accessors do not search. valid only as long as the buffer
+    */
+    class http_header_view {
+
+        public:
+            static constexpr size_t inline_fields = 24;
+
+            http_header_view() = default;
+            // lines of name: value, crlf or lf separated, without the start line. lines without a colon are skipped
+            explicit http_header_view( std::string_view header_lines );
+            // fields that were already split, e.g. decoded from an hpack block. the views are kept as they are
+            explicit http_header_view( std::span<const http_header_field> fields );
+
+            std::optional<std::string_view> get( std::string_view name ) const;
+            bool contains( std::string_view name ) const;
+
+            // nullopt when missing or not a number
+            std::optional<uint64_t> content_length() const;
+            std::optional<std::string_view> transfer_encoding() const;
+            std::optional<std::string_view> content_encoding() const;
+            std::optional<std::string_view> content_type() const;
+            // the last transfer coding is chunked
+            bool is_chunked() const;
+
+            size_t size() const;
+            const http_header_field& operator[]( size_t i ) const;
+
+            // an owning copy, for a message that outlives its buffer
+            http_headers to_headers() const;
+        private:
+            enum common_header { CONTENT_LENGTH, TRANSFER_ENCODING, CONTENT_ENCODING, CONTENT_TYPE, COMMON_HEADERS };
+            static constexpr uint8_t missing = UINT8_MAX;
+
+            void add( http_header_field field );
+            std::optional<std::string_view> common( common_header header ) const;
+
+            std::array<http_header_field,inline_fields> m_inline{};
+            std::vector<http_header_field> m_overflow;
+            size_t m_size = 0;
+            // the field index of each common header, when it is one of the inline ones
+            std::array<uint8_t,COMMON_HEADERS> m_common{ missing, missing, missing, missing };
+    };
 
     enum class http_type {
         REQUEST,
@@ -45,14 +117,21 @@ namespace ntk {
         std::string http_version;
     };
 
+    /*
+        headers is filled by get_http_request and get_http_response. http_connection_parser
+        fills header_view instead, it points into the parser's buffer and is valid while
+        the event that hands the message over runs
+    */
     struct http_request {
         http_request_line request_line;
         http_headers headers;
+        http_header_view header_view;
     };
 
     struct http_response {
         http_response_status_line status_line;
         http_headers headers;
+        http_header_view header_view;
         std::vector<uint8_t> body;
     };
 
@@ -76,11 +155,17 @@ namespace ntk {
 
     bool contains_http_header( const http_headers& headers, const std::string& header_name );
 
+    // the value of header_name, nullptr when it is not there
+    const std::string* find_http_header( const http_headers& headers, std::string_view header_name );
+
     /*
         parse the status line from a http response
     */
     http_response_status_line parse_http_status_line( const std::vector<uint8_t>& status_line_bytes );
 
+    // the same without throwing, for lines off the wire that may be anything
+    std::expected<http_response_status_line,std::string> try_parse_http_status_line( std::span<const uint8_t> status_line_bytes );
+
     /*
         parse headers directly from an array of bytes representing those headers
     */
@@ -97,16 +182,184 @@ namespace ntk {
 
     std::vector<uint8_t> decode_single_chunk( const std::vector<uint8_t>& chunked_body );
 
+    // the data of the first chunk as a span into chunked_body, an error for a bad size line or a chunk cut short
+    std::expected<std::span<const uint8_t>,std::string> try_decode_single_chunk( std::span<const uint8_t> chunked_body );
+
     std::vector<uint8_t> decode_chunked_http_body( const std::vector<uint8_t>& chunked_body );
 
+    /*
+        incremental decoder for a chunked transfer coding
+
+        fed the body in slices of any size, it gives back the chunk data as spans into
+        the slice, with no copy and no buffer of its own. size lines are read a byte at
+        a time, so one split across slices costs nothing extra. chunk extensions and the
+        trailer section are read past. a malformed size line or a chunk that does not
+        end where its size says makes it failed(), a body cut short leaves it not done()
+    */
+    class chunked_decoder {
+
+        public:
+            struct piece {
+                size_t consumed;                    // bytes of the input read
+                std::span<const uint8_t> data;      // decoded bytes found in them, may be empty
+            };
+
+            // the next piece of chunk data in input. call again with what was not consumed
+            piece decode( std::span<const uint8_t> input );
+
+            // every piece of input to on_data, the bytes consumed
+            template<typename F>
+            size_t feed( std::span<const uint8_t> input, F&& on_data ) {
+                size_t consumed = 0;
+                while ( consumed < input.size() && !done() && !failed() ) {
+                    auto next = decode( input.subspan( consumed ) );
+                    if ( !next.data.empty() ) on_data( next.data );
+                    consumed += next.consumed;
+                }
+                return consumed;
+            }
+
+            // decodes buffer into its own front, the decoded bytes there
+            size_t decode_in_place( std::span<uint8_t> buffer );
+
+            // the last chunk and the trailers were read
+            bool done() const;
+            bool failed() const;
+            void reset();
+        private:
+            enum class decode_state {
+                SIZE,
+                EXTENSION,          // after a ';' on the size line
+                SIZE_LF,
+                DATA,
+                DATA_CR,
+                DATA_LF,
+                TRAILER_LINE,       // inside a trailer field
+                TRAILER_START,      // at the start of a line of the trailer section
+                TRAILER_LF,
+                DONE,
+                FAILED
+            };
+
+            decode_state m_state = decode_state::SIZE;
+            uint64_t m_remaining = 0;
+            size_t m_size_digits = 0;
+    };
+
     std::vector<uint8_t> get_first_http_respone( const session& packet_data );
 
     std::vector<uint8_t> get_http_response_data( const tcp_stream& stream );
 
+    /*
+        a message body as the pieces it arrived in, spans into the buffers it was parsed
+        from rather than a copy of them
+
+        pieces that sit next to each other in memory are kept as one. hand the pieces to
+        writev, an inflater or anything else that takes a span at a time. valid only as
+        long as the buffers
+    */
+    class http_body_view {
+
+        public:
+            void append( std::span<const uint8_t> piece );
+
+            const std::vector<std::span<const uint8_t>>& pieces() const;
+            size_t size() const;
+            bool empty() const;
+
+            // one copy, for a body that must outlive its buffers
+            std::vector<uint8_t> to_vector() const;
+        private:
+            std::vector<std::span<const uint8_t>> m_pieces;
+            size_t m_size = 0;
+    };
+
+    // the body of the first response in stream, dechunked, without copying it out of the stream's segments
+    http_body_view get_http_response_body( const tcp_stream& stream );
+
     http_request get_http_request( const std::vector<uint8_t>& http_payload );
 
     http_response get_http_response( const std::vector<uint8_t>& http_payload );
 
+    // an error for a malformed status line rather than an exception
+    std::expected<http_response,std::string> try_get_http_response( const std::vector<uint8_t>& http_payload );
+
+    class http_events {
+
+        public:
+            virtual ~http_events() = default;
+
+            virtual void on_request( const http_request& request ) {}
+            // a 1xx comes before the final response to the same request. request is nullptr when
+            // the client's direction was not fed, otherwise only its request line is kept. the
+            // body is left empty, it comes as on_body
+            virtual void on_response( const http_response& response, const http_request* request ) {}
+            // a piece of the body, dechunked, pointing into the bytes that were fed
+            virtual void on_body( http_type type, std::span<const uint8_t> data ) {}
+            // complete is false when the connection ended inside the message
+            virtual void on_message_end( http_type type, bool complete ) {}
+            // the direction is not http, or not any more. what is fed to it after is ignored
+            virtual void on_error( http_type type, const std::string& reason ) {}
+    };
+
+    /*
+        resumable http/1.1 parser for both directions of a connection
+
+        each direction is fed as it arrives, in pieces of any size, and every message on a
+        keep-alive or pipelined connection is reported, not only the first. bodies framed
+        by Content-Length, chunked or the end of the connection are handed to on_body as
+        spans into the fed bytes, nothing of a body is copied or held. only an incomplete
+        header block is kept between feeds. responses are matched to requests in order,
+        so one to a HEAD has no body
+    */
+    class http_connection_parser {
+
+        public:
+            http_connection_parser( http_events& events );
+
+            http_connection_parser( const http_connection_parser& ) = delete;
+            http_connection_parser& operator=( const http_connection_parser& ) = delete;
+
+            // false once the direction is not http
+            bool feed( stream_direction direction, std::span<const uint8_t> data );
+            // the connection closed, ends a body that runs until the close and any message cut short
+            void finish();
+        private:
+            enum class parse_state {
+                HEAD,
+                LENGTH,
+                CHUNKED,
+                UNTIL_CLOSE,
+                UPGRADED,           // after a 101 or a CONNECT, the rest is not http
+                FAILED
+            };
+
+            struct direction_state {
+                http_type type;
+                parse_state state = parse_state::HEAD;
+                std::string line;               // the header block so far
+                uint64_t remaining = 0;
+                chunked_decoder chunked;
+            };
+
+            // the bytes of data taken
+            size_t take_head( direction_state& side, std::span<const uint8_t> data );
+            void begin_request( direction_state& side, std::string_view head );
+            void begin_response( direction_state& side, std::string_view head );
+            bool set_body_framing( direction_state& side, const http_header_view& headers, bool until_close );
+            void end_message( direction_state& side, bool complete );
+            void fail( direction_state& side, const std::string& reason );
+
+            http_events& m_events;
+            direction_state m_client;
+            direction_state m_server;
+            // requests not yet answered, oldest first
+            std::deque<http_request> m_pending;
+    };
+
+    // every response in a server's payload, bodies dechunked
+    std::vector<http_response> get_http_responses( std::span<const uint8_t> server_payload );
+
 } // namespace ntk
 
 #endif
\ No newline at end of file
@@ -0,0 +1,145 @@
+#ifndef HTTP2_HPP
+#define HTTP2_HPP
+
+#include <array>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <hpack.hpp>
+#include <http.hpp>
+#include <stream_events.hpp>
+
+namespace ntk {
+
+    // what a client sends first on an h2 connection, before its SETTINGS
+    constexpr std::string_view http2_client_preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+    enum class http2_frame_type : uint8_t {
+        DATA = 0,
+        HEADERS = 1,
+        PRIORITY = 2,
+        RST_STREAM = 3,
+        SETTINGS = 4,
+        PUSH_PROMISE = 5,
+        PING = 6,
+        GOAWAY = 7,
+        WINDOW_UPDATE = 8,
+        CONTINUATION = 9
+    };
+
+    struct http2_frame_header {
+        uint32_t length;
+        http2_frame_type type;
+        uint8_t flags;
+        uint32_t stream_id;
+    };
+
+    constexpr size_t http2_frame_header_size = 9;
+
+    // nullopt when there are fewer than http2_frame_header_size bytes
+    std::optional<http2_frame_header> parse_http2_frame_header( std::span<const uint8_t> bytes );
+
+    class http2_events {
+
+        public:
+            virtual ~http2_events() = default;
+
+            // a stream's first header block arrived. the events of its request and response go to
+            // what is returned, as they would for one exchange of a http/1.1 connection. nullptr
+            // ignores the stream
+            virtual http_events* on_stream( uint32_t stream_id ) { return nullptr; }
+            // both sides of the stream ended, or the stream was reset, or the connection ended
+            virtual void on_stream_end( uint32_t stream_id ) {}
+            // the connection is not h2, or broke the protocol. what is fed to it after is ignored
+            virtual void on_error( const std::string& reason ) {}
+    };
+
+    /*
+        resumable http/2 parser for both directions of a decrypted connection
+
+        frames are parsed as they arrive, in pieces of any size, and demultiplexed by stream
+        id. header blocks go through one hpack decoder per direction and come out as a
+        http_request or http_response whose pseudo-headers fill the request or status line,
+        DATA is handed to the stream's on_body as spans into the fed bytes, so interleaved
+        streams are followed without any body being held. only an incomplete frame other
+        than DATA and a header block waiting for its CONTINUATION are kept between feeds
+    */
+    class http2_connection_parser {
+
+        public:
+            static constexpr size_t max_buffered = 1024 * 1024;
+
+            http2_connection_parser( http2_events& events );
+
+            http2_connection_parser( const http2_connection_parser& ) = delete;
+            http2_connection_parser& operator=( const http2_connection_parser& ) = delete;
+
+            // false once the connection failed
+            bool feed( stream_direction direction, std::span<const uint8_t> data );
+            // the connection closed, streams still open are cut short
+            void finish();
+        private:
+            enum class side_state {
+                IDLE,
+                OPEN,
+                CLOSED
+            };
+
+            struct stream_state {
+                http_events* events = nullptr;
+                side_state client = side_state::IDLE;
+                side_state server = side_state::IDLE;
+                bool final_response = false;        // what comes after are trailers
+                http_request request;               // only its request line
+            };
+
+            struct direction_state {
+                http_type type;
+                size_t preface_left = 0;
+                std::array<uint8_t,http2_frame_header_size> header{};
+                size_t header_size = 0;
+                http2_frame_header frame{};
+                size_t remaining = 0;               // of the current frame's payload
+                std::vector<uint8_t> payload;       // a frame other than DATA
+                bool need_pad_length = false;       // DATA only
+                size_t padding = 0;
+                hpack_decoder decoder;
+                std::vector<uint8_t> block;         // a header block waiting for CONTINUATION
+                uint32_t block_stream = 0;
+                bool block_end_stream = false;
+                std::optional<uint32_t> promised_stream;
+            };
+
+            bool begin_frame( direction_state& side );
+            // the bytes of data taken
+            size_t take_data( direction_state& side, std::span<const uint8_t> data );
+            bool end_frame( direction_state& side );
+            bool on_header_fragment( direction_state& side, std::span<const uint8_t> fragment, bool end_headers );
+            bool on_header_block( direction_state& side );
+            void on_settings( direction_state& side, std::span<const uint8_t> payload );
+            stream_state& open_stream( uint32_t stream_id );
+            void end_side( uint32_t stream_id, http_type type, bool complete );
+            void reset_stream( uint32_t stream_id );
+            void fail( const std::string& reason );
+
+            direction_state& other( direction_state& side );
+
+            http2_events& m_events;
+            direction_state m_client;
+            direction_state m_server;
+            std::unordered_map<uint32_t,stream_state> m_streams;
+            std::vector<hpack_header> m_decoded;
+            std::vector<http_header_field> m_fields;
+            bool m_failed;
+    };
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <statistics.hpp>
+
+namespace ntk {
+
+    /*
+        log-linear buckets in the style of an HDR histogram
+
+        values below 16 get a bucket each, above that every power of two is split into
+        16 equal buckets, so a recorded value is off by at most 1/16 of itself over the
+        whole 64 bit range with under a thousand counters
+    */
+    struct histogram_buckets {
+        static constexpr size_t sub_bucket_bits = 4;
+        static constexpr size_t sub_buckets = size_t( 1 ) << sub_bucket_bits;
+        static constexpr size_t count = ( 64 - sub_bucket_bits + 1 ) * sub_buckets;
+
+        static size_t index( uint64_t value );
+        // the largest value that lands in the bucket
+        static uint64_t upper_bound( size_t index );
+    };
+
+    // a histogram's counts at one point in time, merged from every recording thread
+    class histogram_snapshot {
+
+        public:
+            histogram_snapshot();
+
+            void merge( const histogram_snapshot& other );
+
+            uint64_t count() const;
+            uint64_t sum() const;
+            uint64_t max() const;
+            double mean() const;
+            // q in [0,1], the upper bound of the bucket the q-th value fell in
+            uint64_t percentile( double q ) const;
+        private:
+            std::vector<uint64_t> m_buckets;
+            uint64_t m_count;
+            uint64_t m_sum;
+            uint64_t m_max;
+
+            friend class histogram;
+    };
+
+    /*
+        histogram that any number of threads record into without sharing a cache line
+
+        each thread gets its own set of counters the first time it records, after that
+        a record is a thread_local lookup and three relaxed stores. snapshot() sums the
+        threads' counters, it can run while they record
+    */
+    class histogram {
+
+        public:
+            histogram();
+            ~histogram();
+
+            histogram( const histogram& ) = delete;
+            histogram& operator=( const histogram& ) = delete;
+
+            void record( uint64_t value );
+            // negative durations, e.g. from clocks that disagree, count as zero
+            void record( std::chrono::nanoseconds duration );
+
+            histogram_snapshot snapshot() const;
+        private:
+            struct shard {
+                std::array<relaxed_counter,histogram_buckets::count> buckets;
+                relaxed_counter count;
+                relaxed_counter sum;
+                relaxed_counter max;
+            };
+
+            shard& local();
+
+            uint64_t m_id;
+            mutable std::mutex m_mutex;
+            std::vector<std::unique_ptr<shard>> m_shards;
+    };
+
+    struct named_histogram {
+        std::string name;
+        histogram_snapshot values;
+    };
+
+    struct named_gauge {
+        std::string name;
+        int64_t value;
+    };
+
+    struct metrics_snapshot {
+        std::vector<named_histogram> histograms;
+        std::vector<named_gauge> gauges;
+
+        const histogram_snapshot* find_histogram( const std::string& name ) const;
+        std::optional<int64_t> find_gauge( const std::string& name ) const;
+    };
+
+    /*
+        named histograms and gauges of a pipeline, exported as prometheus text
+
+        a name may carry labels, e.g. ntk_shard_ring_occupancy{shard="0"}, metrics with
+        the same name before the labels form one family. gauges are sampled when a
+        snapshot is taken, so what they read has to outlive the registry's use
+    */
+    class metrics_registry {
+
+        public:
+            // the same name gives the same histogram, values are exported multiplied by scale
+            histogram& get_histogram( const std::string& name, const std::string& help = "", double scale = 1.0 );
+            void add_gauge( const std::string& name, const std::string& help, std::function<int64_t()> sample );
+
+            metrics_snapshot snapshot() const;
+            // histograms as summaries with a few quantiles, gauges as they are
+            void write_prometheus( std::ostream& os ) const;
+        private:
+            struct histogram_entry {
+                std::string name;
+                std::string help;
+                double scale;
+                std::unique_ptr<histogram> values;
+            };
+
+            struct gauge_entry {
+                std::string name;
+                std::string help;
+                std::function<int64_t()> sample;
+            };
+
+            mutable std::mutex m_mutex;
+            std::vector<histogram_entry> m_histograms;
+            std::vector<gauge_entry> m_gauges;
+    };
+
+    // nanosecond histograms exported in seconds, as prometheus expects
+    constexpr double nanoseconds_to_seconds = 1e-9;
+
+} // namespace ntk
+
+#endif
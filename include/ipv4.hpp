@@ -11,6 +11,7 @@
 #include <unordered_map>
 #include <sstream>
 #include <ranges>
+#include <span>
 
 #include <cstdint>
 #include <cstring>
@@ -20,6 +21,7 @@
 #include <stdexcept>
 
 #include <constants.hpp>
+#include <flow_key.hpp>
 
 namespace ntk {
 
@@ -42,6 +44,9 @@ namespace ntk {
     struct ipv4_header {
         size_t ihl; // internet header length in bytes
         uint16_t total_length;
+        uint16_t identification;
+        uint8_t flags;          // the top three bits of the fragment field, 0x2 don't fragment, 0x1 more fragments
+        uint16_t fragment_offset;   // in bytes
         uint8_t time_to_live;
         uint8_t protocol;
         uint16_t header_checksum;
@@ -60,6 +65,8 @@ namespace ntk {
 
     ipv4_header get_ipv4_header( const unsigned char* ethernet_frame );
 
+    class session_columns;
+
     struct ipv4_filter {
         uint32_t ip_addr;
 
@@ -68,6 +75,9 @@ namespace ntk {
             
             return ( header.source_ip_addr == ip_addr ) || ( header.destination_ip_addr == ip_addr );
         }
+
+        // the same for a row of session_columns, without parsing its packet again
+        bool operator()( const session_columns& columns, size_t row ) const;
     };
 
     sender_reciever get_sender_reciever( const unsigned char* ethernet_frame );
@@ -85,7 +95,7 @@ namespace ntk {
 
         auto dest_src = flip_sender_reciever( src_dest );
     
-        return std::views::all( packets ) | std::views::filter( [ & ] ( const auto& packet ) {
+        return std::views::all( packets ) | std::views::filter( [ &src_dest, dest_src ] ( const auto& packet ) {
             auto ip_pair = get_sender_reciever( packet.data() );
             return ip_pair == src_dest || ip_pair == dest_src;
         });
@@ -93,7 +103,13 @@ namespace ntk {
 
     bool is_ipv4( const unsigned char* ethernet_frame );
 
+    // an ipv4 frame with more fragments set or a fragment offset, its l4 header is missing or partial
+    bool is_ipv4_fragment( std::span<const uint8_t> frame, size_t ip_offset = constants::ethernet_header_len );
+
     std::string ip_to_string( uint32_t ip );
+
+    // dotted for ipv4, the compressed RFC 5952 form for ipv6
+    std::string ip_to_string( const ip_address& ip );
     
 } // namespace ntk
 
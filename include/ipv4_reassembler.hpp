@@ -0,0 +1,135 @@
+#ifndef IPV4_REASSEMBLER_HPP
+#define IPV4_REASSEMBLER_HPP
+
+#include <bitset>
+#include <chrono>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <captured_packet.hpp>
+#include <constants.hpp>
+#include <statistics.hpp>
+
+namespace ntk {
+
+    /*
+        bounds on the fragments held while their datagrams are incomplete, zero disables
+        a limit. time is capture time so only fragments fed with a timestamp expire
+    */
+    struct fragment_limits {
+        size_t max_datagrams = 1024;                                    // at once, the oldest gives way to a new one
+        size_t max_source_bytes = 1 << 20;                              // held for one source address
+        std::chrono::nanoseconds timeout = std::chrono::seconds( 30 );  // since a datagram's first fragment
+    };
+
+    struct fragment_statistics {
+        uint64_t fragments;
+        uint64_t datagrams_reassembled;
+        uint64_t datagrams_timed_out;
+        uint64_t datagrams_evicted;     // gave way to a newer datagram in a full table
+        uint64_t fragments_dropped;     // malformed, overlapping, truncated by the snaplen or over the source's budget
+        uint64_t bytes_held;
+    };
+
+    enum class fragment_result {
+        NOT_FRAGMENT,   // a whole datagram, to be used as it is
+        HELD,           // kept until the rest of its datagram arrives
+        COMPLETE,       // completed its datagram, see datagram()
+        DROPPED
+    };
+
+    /*
+        puts fragmented ipv4 datagrams back together in front of the tcp and udp paths
+
+        datagrams are keyed by source, destination, protocol and identification and sit
+        in a table of max_datagrams slots reserved on the first fragment, so a flood of
+        fragments that never complete costs no more than that. slots are kept in arrival
+        order, which makes both the timeout and making room for a new datagram O(1) at the
+        oldest end. a fragment that overlaps what is held with different bytes drops its
+        datagram, as overlaps are only ever used to evade inspection. the rebuilt frame
+        carries the first fragment's link and ip header with the length, fragment
+        fields and checksum fixed up
+    */
+    class ipv4_reassembler {
+
+        public:
+            ipv4_reassembler( const fragment_limits& limits = fragment_limits{} );
+
+            // ip_offset is where the ip header starts, after whatever link layer the frame has
+            fragment_result feed( std::span<const uint8_t> frame, std::optional<capture_time> now = std::nullopt,
+                                  size_t ip_offset = constants::ethernet_header_len );
+            // the frame completed by the last feed, valid until the next one
+            std::span<const uint8_t> datagram() const;
+            // expires datagrams up to now without a fragment
+            void advance_time( capture_time now );
+
+            // datagrams being reassembled
+            size_t size() const;
+            // safe to call from any thread while the feeding thread runs
+            fragment_statistics statistics() const;
+        private:
+            struct datagram_key {
+                uint32_t source_ip;
+                uint32_t destination_ip;
+                uint16_t identification;
+                uint8_t protocol;
+
+                bool operator==( const datagram_key& other ) const = default;
+            };
+
+            struct datagram_key_hash {
+                size_t operator()( const datagram_key& key ) const noexcept;
+            };
+
+            static constexpr uint32_t none = UINT32_MAX;
+            // 8 byte units of the largest ip payload
+            static constexpr size_t max_units = 8192;
+
+            struct slot {
+                datagram_key key;
+                std::vector<uint8_t> header;        // link and ip header, once the first fragment came
+                size_t ip_offset = 0;
+                std::vector<uint8_t> payload;       // grown to the furthest fragment end seen
+                std::bitset<max_units> received;
+                size_t units_received = 0;
+                std::optional<size_t> total;        // payload length, known from the last fragment
+                std::optional<capture_time> first_seen;
+                uint32_t older = none;
+                uint32_t newer = none;
+            };
+
+            uint32_t acquire( const datagram_key& key, std::optional<capture_time> now );
+            void release( uint32_t index );
+            void hold( uint32_t index, size_t bytes );
+            void expire( capture_time now );
+            bool complete( const slot& s ) const;
+            void rebuild( const slot& s );
+            fragment_result drop( std::optional<uint32_t> index );
+
+            fragment_limits m_limits;
+            std::vector<slot> m_slots;
+            std::vector<uint32_t> m_free;
+            std::unordered_map<datagram_key,uint32_t,datagram_key_hash> m_index;
+            std::unordered_map<uint32_t,size_t> m_source_bytes;
+            uint32_t m_oldest = none;
+            uint32_t m_newest = none;
+
+            std::vector<uint8_t> m_datagram;
+            size_t m_bytes_held = 0;
+
+            relaxed_counter m_fragments;
+            relaxed_counter m_reassembled;
+            relaxed_counter m_timed_out;
+            relaxed_counter m_evicted;
+            relaxed_counter m_dropped;
+            relaxed_counter m_bytes_held_gauge;
+    };
+
+} // namespace ntk
+
+#endif
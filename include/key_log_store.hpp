@@ -0,0 +1,115 @@
+#ifndef KEY_LOG_STORE_HPP
+#define KEY_LOG_STORE_HPP
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace ntk {
+
+    // the NSS key log labels, tls 1.3 traffic secrets and the tls 1.2 master secret
+    enum class secret_label : uint8_t {
+        CLIENT_EARLY_TRAFFIC_SECRET,
+        CLIENT_HANDSHAKE_TRAFFIC_SECRET,
+        SERVER_HANDSHAKE_TRAFFIC_SECRET,
+        CLIENT_TRAFFIC_SECRET_0,
+        SERVER_TRAFFIC_SECRET_0,
+        EXPORTER_SECRET,
+        CLIENT_RANDOM,
+        COUNT
+    };
+
+    std::optional<secret_label> parse_secret_label( std::string_view name );
+
+    const char* secret_label_name( secret_label label );
+
+    using client_random = std::array<uint8_t,32>;
+
+    // the random is random already, its first bytes make a good hash
+    struct client_random_hash {
+        size_t operator()( const client_random& random ) const {
+            size_t h;
+            std::memcpy( &h, random.data(), sizeof( h ) );
+            return h;
+        }
+    };
+
+    struct session_secrets {
+        std::array<std::vector<uint8_t>,static_cast<size_t>( secret_label::COUNT )> secrets;
+
+        // nullptr until the line for label has been read
+        const std::vector<uint8_t>* find( secret_label label ) const;
+    };
+
+    /*
+        secrets of an SSLKEYLOGFILE, indexed by the raw client random
+
+        a file is read once and then only from where the last read stopped, and a file
+        that got shorter is read again from the start. a trailing line still being
+        written waits for its newline, it is only taken without one at an end of input,
+        the constructor's first read or stop_following(). it is kept even then, should
+        the file grow after all the whole line replaces what was taken.
+        follow() does that on a thread of its own whenever inotify reports the file
+        changed, so a session is decryptable milliseconds after the client logged it.
+        lookups may run alongside
+    */
+    class key_log_store {
+
+        public:
+            key_log_store();
+            // reads what the file holds now, see follow() for what is added later
+            key_log_store( const std::string& filename );
+            ~key_log_store();
+
+            key_log_store( const key_log_store& ) = delete;
+            key_log_store& operator=( const key_log_store& ) = delete;
+
+            // reads the lines completed since the last call, returns how many were added
+            size_t poll();
+            // polls on every change of the file until stop_following(), without inotify every 100ms
+            bool follow();
+            // and reads what the file holds by then, a last line without newline included
+            void stop_following();
+
+            // one key log line, false for comments and anything malformed
+            bool add_line( std::string_view line );
+
+            std::optional<std::vector<uint8_t>> find( const client_random& random, secret_label label ) const;
+            // for a session that may not have been logged yet, e.g. a stream offloaded right after its handshake
+            std::optional<std::vector<uint8_t>> wait_for( const client_random& random, secret_label label,
+                                                          std::chrono::milliseconds timeout ) const;
+
+            // client randoms seen
+            size_t size() const;
+        private:
+            // at the end of input a trailing line without newline is taken as well
+            size_t read_appended( bool end_of_input );
+            void run_follower( std::stop_token stop );
+
+            std::string m_filename;
+            uint64_t m_offset;
+            std::string m_partial_line;
+            std::mutex m_read_mutex;
+
+            mutable std::shared_mutex m_mutex;
+            mutable std::condition_variable_any m_added;
+            std::unordered_map<client_random,session_secrets,client_random_hash> m_sessions;
+
+            std::jthread m_follower;
+    };
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef LINK_LAYER_HPP
+#define LINK_LAYER_HPP
+
+#include <optional>
+#include <span>
+#include <utility>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <decoded_packet.hpp>
+
+namespace ntk {
+
+    // the pcap LINKTYPE_ values there are decoders for
+    enum class link_type : uint32_t {
+        ETHERNET = 1,           // 802.1Q and 802.1ad tagged frames included
+        LINUX_SLL = 113         // the cooked header of captures on linux's "any" device
+    };
+
+    namespace ethertypes {
+
+        constexpr uint16_t ipv4 = 0x0800;
+        constexpr uint16_t ipv6 = 0x86dd;
+        constexpr uint16_t vlan = 0x8100;
+        constexpr uint16_t qinq = 0x88a8;
+
+    } // namespace ethertypes
+
+    // which network protocol a frame carries and where its header starts
+    struct network_header {
+        uint16_t ethertype;
+        size_t offset;
+    };
+
+    /*
+        link layer decoders, one per link_type, each tells where a frame's network layer
+        starts. they are template parameters of decode_packet_as, so the decoder for a
+        capture's link type is compiled into its own copy of the packet path rather than
+        chosen on every packet
+    */
+    struct ethernet_link {
+        static constexpr link_type type = link_type::ETHERNET;
+        static constexpr size_t header_len = 14;
+        static constexpr size_t max_tags = 2;
+
+        static std::optional<network_header> network( std::span<const uint8_t> frame ) {
+            if ( frame.size() < header_len ) return std::nullopt;
+            size_t offset = header_len;
+            uint16_t ethertype = static_cast<uint16_t>( ( frame[ 12 ] << 8 ) | frame[ 13 ] );
+            // a vlan tag, or a service tag and a vlan tag, sit in front of the real ethertype
+            for ( size_t tags = 0; ( ethertype == ethertypes::vlan || ethertype == ethertypes::qinq ) && tags < max_tags; ++tags ) {
+                if ( frame.size() < offset + 4 ) return std::nullopt;
+                ethertype = static_cast<uint16_t>( ( frame[ offset + 2 ] << 8 ) | frame[ offset + 3 ] );
+                offset += 4;
+            }
+            return network_header{ ethertype, offset };
+        }
+    };
+
+    struct linux_sll_link {
+        static constexpr link_type type = link_type::LINUX_SLL;
+        static constexpr size_t header_len = 16;
+
+        static std::optional<network_header> network( std::span<const uint8_t> frame ) {
+            if ( frame.size() < header_len ) return std::nullopt;
+            return network_header{ static_cast<uint16_t>( ( frame[ 14 ] << 8 ) | frame[ 15 ] ), header_len };
+        }
+    };
+
+    // the ip header of a frame, where it starts and ends and whom it is between
+    struct ip_layer {
+        ip_address source_ip;
+        ip_address destination_ip;
+        uint8_t version;
+        size_t offset;
+        size_t header_len;      // ipv6 extension headers included
+        uint32_t total_len;     // the ipv4 total length, or the ipv6 payload length plus the fixed header
+        size_t end;             // of the datagram within the frame
+    };
+
+    /*
+        the ipv4 or ipv6 header behind the Link's header when it carries protocol, past
+        any ipv6 extension headers. nothing for a fragment, it is decoded once whole
+    */
+    template<typename Link>
+    std::optional<ip_layer> decode_ip_as( std::span<const uint8_t> frame, uint8_t protocol );
+
+    /*
+        ipv4 or ipv6 / tcp behind the Link's header, decoded in one pass
+
+        defined in decoded_packet.cpp and instantiated for each decoder above,
+        decode_packet is the ethernet one
+    */
+    template<typename Link>
+    std::optional<decoded_packet> decode_packet_as( std::span<const uint8_t> frame );
+
+    // the decoders of one link type, picked once for a capture
+    struct link_layer {
+        link_type type;
+        std::optional<network_header> ( *network )( std::span<const uint8_t> frame );
+        std::optional<ip_layer> ( *ip )( std::span<const uint8_t> frame, uint8_t protocol );
+        std::optional<decoded_packet> ( *decode )( std::span<const uint8_t> frame );
+    };
+
+    template<typename Link>
+    constexpr link_layer link_layer_of() {
+        return link_layer{ Link::type, &Link::network, &decode_ip_as<Link>, &decode_packet_as<Link> };
+    }
+
+    link_layer link_layer_of( link_type type );
+
+    // nothing for a pcap link type without a decoder
+    std::optional<link_type> to_link_type( uint32_t datalink );
+
+    /*
+        calls f with the decoder of type as a tag, e.g. f( ethernet_link{} ), so a loop
+        over a whole capture can be written once and instantiated per link type with
+        the link layer inlined
+    */
+    template<typename F>
+    decltype(auto) with_link_layer( link_type type, F&& f ) {
+        switch ( type ) {
+            case link_type::LINUX_SLL: return std::forward<F>( f )( linux_sll_link{} );
+            case link_type::ETHERNET: break;
+        }
+        return std::forward<F>( f )( ethernet_link{} );
+    }
+
+} // namespace ntk
+
+#endif
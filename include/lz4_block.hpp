@@ -0,0 +1,35 @@
+#ifndef LZ4_BLOCK_HPP
+#define LZ4_BLOCK_HPP
+
+#include <expected>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ntk {
+
+    /*
+        the lz4 block format, without the frame around it
+
+        a block is a run of sequences, each a token, literals copied as they are and a
+        match of at least four bytes repeated from up to 64 KiB back. the compressor is a
+        single pass with one hash table probe per position, it trades ratio for speed the
+        way LZ4_compress_default does and its output is read by any lz4 decoder. a block
+        does not carry its own size, the caller keeps it next to the compressed bytes
+    */
+
+    // the most lz4_compress_block can write for size input bytes, when nothing matches
+    size_t lz4_compress_bound( size_t size );
+
+    // replaces output with input compressed as one block
+    void lz4_compress_block( std::span<const uint8_t> input, std::vector<uint8_t>& output );
+
+    // output must be exactly the size the block was compressed from, nothing is read or written out of bounds
+    std::expected<void,std::string> lz4_decompress_block( std::span<const uint8_t> input, std::span<uint8_t> output );
+
+} // namespace ntk
+
+#endif
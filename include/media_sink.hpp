@@ -0,0 +1,176 @@
+#ifndef MEDIA_SINK_HPP
+#define MEDIA_SINK_HPP
+
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include <flow_key.hpp>
+#include <http.hpp>
+#include <payload_dedup.hpp>
+#include <stream_events.hpp>
+#include <tls.hpp>
+#include <tls_live_decryptor.hpp>
+
+namespace ntk {
+
+    enum class media_kind {
+        PLAYLIST,       // an hls .m3u8
+        MPEG_TS,
+        FMP4
+    };
+
+    // by the response's content type, or the extension of the request path when that is generic
+    std::optional<media_kind> classify_media( std::string_view content_type, std::string_view path );
+
+    /*
+        writes a file through an aligned buffer
+
+        bytes are gathered in a page-aligned buffer and go to the file a whole buffer at
+        a time, so a body that arrives a record at a time costs one write per buffer
+        rather than one per record. close() writes what is left. the file is only created
+        with the first write to it, a body discarded before it filled the buffer never
+        touches the disk
+
+        follow() points a writer that has not written yet at an earlier file that may hold
+        the same bytes. from then on what is written is compared with that file instead,
+        and only the first difference, or close(), copies the part that matched over and
+        goes on writing. a body discarded while it still matches is never written at all
+    */
+    class segment_writer {
+
+        public:
+            segment_writer( size_t buffer_size = 1 << 18 );
+            ~segment_writer();
+
+            segment_writer( segment_writer&& other ) noexcept;
+            segment_writer& operator=( segment_writer&& other ) noexcept;
+            segment_writer( const segment_writer& ) = delete;
+            segment_writer& operator=( const segment_writer& ) = delete;
+
+            // truncates a file that is there already, once it is created
+            bool open( const std::filesystem::path& file );
+            bool is_open() const;
+            bool write( std::span<const uint8_t> data );
+            bool close();
+            // drops what was buffered and removes the file if it was created
+            void discard();
+            // false when the file is created already or what is buffered differs from earlier
+            bool follow( const std::filesystem::path& earlier );
+            bool following() const;
+
+            size_t bytes_written() const;
+            size_t capacity() const;
+        private:
+            bool create();
+            bool flush();
+            // whether data is what comes next in the followed file
+            bool same_as_followed( std::span<const uint8_t> data );
+            // copies what matched the followed file into the own one and stops following
+            bool unfollow();
+
+            std::filesystem::path m_path;
+            bool m_open;
+            std::FILE* m_file;
+            std::FILE* m_followed;
+            uint8_t* m_buffer;
+            size_t m_capacity;
+            size_t m_used;
+            size_t m_bytes;
+    };
+
+    struct media_segment {
+        four_tuple four;
+        media_kind kind;
+        std::string path;                   // the request target
+        std::filesystem::path file;
+        size_t bytes;
+        bool complete;                      // false when the connection ended before the body did
+        // the file an identical body was written to before, when this one was not written again
+        std::optional<std::filesystem::path> duplicate_of;
+    };
+
+    struct media_sink_statistics {
+        size_t responses = 0;
+        size_t segments = 0;                // written, complete or not
+        size_t bytes_written = 0;
+        size_t duplicates = 0;              // segments not written, a copy was on disk already
+        size_t bytes_deduplicated = 0;
+        size_t failures = 0;                // connections given up on, e.g. not http/1.1
+    };
+
+    /*
+        writes hls playlists and .ts / fmp4 segments out of decrypted http/1.1 connections
+        while they are still being sent
+
+        plug it into a tls_live_decryptor as its tls_events. each connection's records go
+        through an http_connection_parser, a response whose content type or request path
+        names media has its body, dechunked, written to a file in directory as its records
+        are decrypted. on_segment is called once the body is complete, or the connection
+        closed under it. the body is never buffered beyond the writer
+
+        with a payload_dedup_index each body is hashed as it is written. a complete body
+        found in the index is discarded, its segment names the earlier file as duplicate_of.
+        a body larger than the write buffer has its first buffer looked up before it is
+        flushed, when an earlier body began the same way the writer follows that file, so
+        a duplicate of any size is never written
+    */
+    class media_sink : public tls_events {
+
+        public:
+            using segment_callback = std::function<void( const media_segment& segment )>;
+
+            media_sink( const std::filesystem::path& directory, segment_callback on_segment = nullptr,
+                        size_t write_buffer_size = 1 << 18, payload_dedup_index* dedup = nullptr );
+
+            void on_record( const four_tuple& four, stream_direction direction, tls_content_type type,
+                            std::span<const uint8_t> plaintext ) override;
+            void on_failure( const four_tuple& four, const std::string& reason ) override;
+            void on_close( const four_tuple& four, close_reason reason ) override;
+
+            media_sink_statistics statistics() const;
+        private:
+            struct connection : http_events {
+                connection( media_sink& sink, const four_tuple& four );
+
+                void on_response( const http_response& response, const http_request* request ) override;
+                void on_body( http_type type, std::span<const uint8_t> data ) override;
+                void on_message_end( http_type type, bool complete ) override;
+                void on_error( http_type type, const std::string& reason ) override;
+
+                // ends a segment being written, as cut short unless complete
+                void end_segment( bool complete );
+
+                media_sink& sink;
+                four_tuple four;
+                http_connection_parser parser;
+                // the response being written, when it is media
+                std::optional<media_segment> segment;
+                segment_writer writer;
+                std::optional<payload_hasher> hasher;
+                // of the first write buffer of the body, once that is full
+                std::optional<payload_digest> prefix;
+                bool failed = false;
+            };
+
+            std::filesystem::path m_directory;
+            segment_callback m_on_segment;
+            size_t m_write_buffer_size;
+            payload_dedup_index* m_dedup;
+
+            std::unordered_map<flow_key,connection,flow_key_hash> m_connections;
+            size_t m_next_segment;
+            media_sink_statistics m_statistics;
+    };
+
+} // namespace ntk
+
+#endif
@@ -1,18 +1,99 @@
 #ifndef MP4_HPP
 #define MP4_HPP
 
+#include <array>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include <cstddef>
+#include <cstdint>
+
+#include <http.hpp>
+
 namespace ntk {
 
-    struct file_type_box {]
-        uint32_t length;
+    // a four character code as the big endian integer it is stored as
+    constexpr uint32_t mp4_box_type( std::string_view fourcc ) {
+        return ( uint32_t( uint8_t( fourcc[ 0 ] ) ) << 24 ) | ( uint32_t( uint8_t( fourcc[ 1 ] ) ) << 16 ) |
+               ( uint32_t( uint8_t( fourcc[ 2 ] ) ) << 8 ) | uint32_t( uint8_t( fourcc[ 3 ] ) );
+    }
+
+    std::string mp4_box_type_name( uint32_t type );
+
+    struct mp4_box {
         uint32_t type;
+        uint64_t offset;            // of the box header, from the start of the file
+        uint64_t size;              // header included, UINT64_MAX for a box that runs to the end of the file
+        uint32_t header_size;       // 8, 16 with a 64 bit size, 16 more for a uuid box
+        uint32_t depth;             // 0 for a top level box
+    };
+
+    struct file_type_box {
         uint32_t major_brand;
         uint32_t minor_version;
         std::vector<uint32_t> compatible_brands;
     };
 
+    // from the payload of a ftyp or styp box
+    std::optional<file_type_box> parse_file_type_box( std::span<const uint8_t> payload );
+
+    class mp4_events {
+
+        public:
+            virtual ~mp4_events() = default;
+
+            virtual void on_box_start( const mp4_box& box ) {}
+            // a piece of the payload of a box that is not a container, pointing into the bytes that were fed
+            virtual void on_box_data( const mp4_box& box, std::span<const uint8_t> data ) {}
+            virtual void on_box_end( const mp4_box& box ) {}
+            // the sizes do not nest, what is fed after is ignored
+            virtual void on_error( const std::string& reason ) {}
+    };
+
+    /*
+        resumable iso-bmff box parser
+
+        fed a file as it arrives, in pieces of any size, it reports where each box starts
+        and ends and descends into the containers, moov and moof and what they hold. the
+        payload of every other box, mdat above all, is handed to on_box_data as spans into
+        the fed bytes and never held, so a file of any size is walked in constant memory.
+        only a box header split across feeds is kept
+    */
+    class mp4_parser {
+
+        public:
+            mp4_parser( mp4_events& events );
+
+            // false once the boxes do not nest
+            bool feed( std::span<const uint8_t> data );
+            // the file ended, ends a box that runs to its end. false if a box was cut short
+            bool finish();
+
+            // bytes fed so far
+            uint64_t offset() const;
+        private:
+            static constexpr size_t max_header_size = 32;
+
+            // the bytes of data taken
+            size_t take_header( std::span<const uint8_t> data );
+            void close_finished();
+            void fail( const std::string& reason );
+
+            mp4_events& m_events;
+            uint64_t m_offset;
+            std::array<uint8_t,max_header_size> m_header;
+            size_t m_header_size;
+            std::vector<mp4_box> m_open;            // containers, outermost first
+            std::optional<mp4_box> m_leaf;          // the box whose payload is being fed
+            bool m_failed;
+    };
+
+    // every box of a body, in file order
+    std::vector<mp4_box> list_mp4_boxes( const http_body_view& body );
+
 } // namespace ntk
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,246 @@
+#ifndef MPMC_QUEUE_HPP
+#define MPMC_QUEUE_HPP
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <utility>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <ring_buffer.hpp>
+#include <spmc_queue.hpp>
+
+namespace ntk {
+
+    /*
+        bounded lock-free multi-producer multi-consumer transfer queue
+
+        a ring of N slots ( rounded up to a power of two ), each carrying a sequence
+        number that says whose turn it is: a producer claims the slot whose sequence
+        equals its ticket, moves the item in and bumps the sequence, a consumer claims
+        it one step later, moves the item out and hands the slot to the next lap. the
+        slots are allocated once up front, so an item costs one move in and one move out.
+        push waits for room when the ring is full, try_push does not. consumers that
+        find the ring empty in pop_for sleep on a condition variable that producers
+        only touch while somebody is asleep
+    */
+    template<typename T,size_t N,typename Filter = accept_all<T>>
+        requires FilterConcept<Filter,T>
+    class mpmc_transfer_queue : public transfer_queue_interface<T> {
+
+        static_assert( N >= 2, "mpmc_transfer_queue needs room for at least two items" );
+
+        public:
+            mpmc_transfer_queue();
+            mpmc_transfer_queue( Filter filter );
+            ~mpmc_transfer_queue();
+
+            mpmc_transfer_queue( const mpmc_transfer_queue& ) = delete;
+            mpmc_transfer_queue& operator=( const mpmc_transfer_queue& ) = delete;
+
+            void push( const T& item );
+            void push( T&& item );
+            // false when the ring is full, a filtered out item counts as pushed
+            bool try_push( T&& item );
+            std::optional<T> pop_for( std::chrono::milliseconds time_out );
+            std::optional<T> pop_for( std::chrono::milliseconds time_out, std::stop_token stop );
+            std::optional<T> try_pop();
+
+            // a snapshot, other threads may change it straight away
+            bool empty() const;
+            // items pushed and not yet popped, including ones being moved in or out right now
+            size_t size() const;
+            static constexpr size_t capacity() { return storage_size; }
+        private:
+            static constexpr size_t storage_size = std::bit_ceil( N );
+            static constexpr size_t mask = storage_size - 1;
+
+            struct alignas( cache_line_size ) slot {
+                std::atomic<size_t> sequence;
+                alignas( T ) unsigned char storage[ sizeof( T ) ];
+
+                T* item() { return std::launder( reinterpret_cast<T*>( storage ) ); }
+            };
+
+            template<typename U>
+            bool enqueue( U&& item );
+            void wake();
+
+            alignas( cache_line_size ) std::atomic<size_t> m_enqueue_position;
+            alignas( cache_line_size ) std::atomic<size_t> m_dequeue_position;
+
+            alignas( cache_line_size ) std::atomic<uint32_t> m_sleepers;
+            std::mutex m_mutex;
+            std::condition_variable_any m_cv;
+
+            std::unique_ptr<slot[]> m_slots;
+            Filter m_filter;
+    };
+
+    template<typename T,size_t N,typename Filter>
+        requires FilterConcept<Filter,T>
+    mpmc_transfer_queue<T,N,Filter>::mpmc_transfer_queue()
+        : mpmc_transfer_queue( Filter{} ) {}
+
+    template<typename T,size_t N,typename Filter>
+        requires FilterConcept<Filter,T>
+    mpmc_transfer_queue<T,N,Filter>::mpmc_transfer_queue( Filter filter )
+        : m_enqueue_position( 0 ), m_dequeue_position( 0 ), m_sleepers( 0 ),
+          m_slots( std::make_unique<slot[]>( storage_size ) ), m_filter( filter ) {
+        for ( size_t i = 0; i < storage_size; ++i ) m_slots[ i ].sequence.store( i, std::memory_order_relaxed );
+    }
+
+    template<typename T,size_t N,typename Filter>
+        requires FilterConcept<Filter,T>
+    mpmc_transfer_queue<T,N,Filter>::~mpmc_transfer_queue() {
+        while ( try_pop() ) {}
+    }
+
+    template<typename T,size_t N,typename Filter>
+        requires FilterConcept<Filter,T>
+    template<typename U>
+    bool mpmc_transfer_queue<T,N,Filter>::enqueue( U&& item ) {
+
+        size_t position = m_enqueue_position.load( std::memory_order_relaxed );
+        slot* s;
+
+        for ( ;; ) {
+            s = &m_slots[ position & mask ];
+            size_t sequence = s->sequence.load( std::memory_order_acquire );
+            auto lag = static_cast<std::ptrdiff_t>( sequence - position );
+
+            if ( lag == 0 ) {
+                if ( m_enqueue_position.compare_exchange_weak( position, position + 1, std::memory_order_relaxed ) ) break;
+            } else if ( lag < 0 ) {
+                // the consumer of the previous lap has not freed it, the ring is full
+                return false;
+            } else {
+                position = m_enqueue_position.load( std::memory_order_relaxed );
+            }
+        }
+
+        ::new ( static_cast<void*>( s->storage ) ) T( std::forward<U>( item ) );
+        s->sequence.store( position + 1, std::memory_order_release );
+
+        wake();
+
+        return true;
+    }
+
+    template<typename T,size_t N,typename Filter>
+        requires FilterConcept<Filter,T>
+    void mpmc_transfer_queue<T,N,Filter>::wake() {
+        // pairs with the fence in pop_for, either the sleeper sees the item or we see the sleeper
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        if ( m_sleepers.load( std::memory_order_relaxed ) == 0 ) return;
+        { std::lock_guard<std::mutex> lock( m_mutex ); }
+        m_cv.notify_one();
+    }
+
+    template<typename T,size_t N,typename Filter>
+        requires FilterConcept<Filter,T>
+    void mpmc_transfer_queue<T,N,Filter>::push( const T& item ) {
+        if ( !m_filter( item ) ) return;
+        while ( !enqueue( item ) ) std::this_thread::yield();
+    }
+
+    template<typename T,size_t N,typename Filter>
+        requires FilterConcept<Filter,T>
+    void mpmc_transfer_queue<T,N,Filter>::push( T&& item ) {
+        if ( !m_filter( item ) ) return;
+        // a failed enqueue leaves the item untouched, so it can be tried again
+        while ( !enqueue( std::move( item ) ) ) std::this_thread::yield();
+    }
+
+    template<typename T,size_t N,typename Filter>
+        requires FilterConcept<Filter,T>
+    bool mpmc_transfer_queue<T,N,Filter>::try_push( T&& item ) {
+        if ( !m_filter( item ) ) return true;
+        return enqueue( std::move( item ) );
+    }
+
+    template<typename T,size_t N,typename Filter>
+        requires FilterConcept<Filter,T>
+    std::optional<T> mpmc_transfer_queue<T,N,Filter>::try_pop() {
+
+        size_t position = m_dequeue_position.load( std::memory_order_relaxed );
+        slot* s;
+
+        for ( ;; ) {
+            s = &m_slots[ position & mask ];
+            size_t sequence = s->sequence.load( std::memory_order_acquire );
+            auto lag = static_cast<std::ptrdiff_t>( sequence - ( position + 1 ) );
+
+            if ( lag == 0 ) {
+                if ( m_dequeue_position.compare_exchange_weak( position, position + 1, std::memory_order_relaxed ) ) break;
+            } else if ( lag < 0 ) {
+                return std::nullopt;
+            } else {
+                position = m_dequeue_position.load( std::memory_order_relaxed );
+            }
+        }
+
+        std::optional<T> item( std::move( *s->item() ) );
+        s->item()->~T();
+        s->sequence.store( position + storage_size, std::memory_order_release );
+
+        return item;
+    }
+
+    template<typename T,size_t N,typename Filter>
+        requires FilterConcept<Filter,T>
+    std::optional<T> mpmc_transfer_queue<T,N,Filter>::pop_for( std::chrono::milliseconds time_out ) {
+        return pop_for( time_out, std::stop_token{} );
+    }
+
+    template<typename T,size_t N,typename Filter>
+        requires FilterConcept<Filter,T>
+    std::optional<T> mpmc_transfer_queue<T,N,Filter>::pop_for( std::chrono::milliseconds time_out, std::stop_token stop ) {
+
+        if ( auto item = try_pop() ) return item;
+
+        auto deadline = std::chrono::steady_clock::now() + time_out;
+        std::optional<T> item;
+
+        std::unique_lock<std::mutex> lock( m_mutex );
+        m_sleepers.fetch_add( 1, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+
+        m_cv.wait_until( lock, stop, deadline, [ & ] {
+            item = try_pop();
+            return item.has_value();
+        });
+
+        m_sleepers.fetch_sub( 1, std::memory_order_relaxed );
+
+        return item;
+    }
+
+    template<typename T,size_t N,typename Filter>
+        requires FilterConcept<Filter,T>
+    size_t mpmc_transfer_queue<T,N,Filter>::size() const {
+        size_t dequeued = m_dequeue_position.load( std::memory_order_relaxed );
+        size_t enqueued = m_enqueue_position.load( std::memory_order_relaxed );
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+
+    template<typename T,size_t N,typename Filter>
+        requires FilterConcept<Filter,T>
+    bool mpmc_transfer_queue<T,N,Filter>::empty() const {
+        size_t position = m_dequeue_position.load( std::memory_order_relaxed );
+        size_t sequence = m_slots[ position & mask ].sequence.load( std::memory_order_acquire );
+        return static_cast<std::ptrdiff_t>( sequence - ( position + 1 ) ) < 0;
+    }
+
+} // namespace ntk
+
+#endif
@@ -3,7 +3,9 @@
 
 #include <pcap.h>
 
+#include <captured_packet.hpp>
 #include <constants.hpp>
+#include <pcap_file.hpp>
 
 #include <iomanip>
 #include <iostream>
@@ -17,6 +19,28 @@ namespace ntk {
         "tcp port 443 and (host 104.22.21.231 or host 104.22.20.231 or host 172.67.10.24)"
     };
 
+    /*
+        how a device is opened and drained
+
+        the defaults match the original pcap_open_live( device, max_snap_len, 1, 1000 )
+        and an unbounded batch per pcap_dispatch
+    */
+    struct capture_options {
+        int snap_len = static_cast<int>( constants::max_snap_len );
+        bool promiscuous = true;
+        int timeout_ms = 1000;
+        int buffer_size = 0;            // kernel buffer in bytes, 0 keeps libpcap's default
+        bool immediate_mode = false;    // deliver packets as they arrive instead of per filled buffer
+        int dispatch_batch = -1;        // packets per pcap_dispatch call, -1 for everything buffered
+        bool verify_checksums = false;  // count ipv4 / tcp checksum results into capture_statistics, every frame is still delivered
+
+        // large buffer and whole-buffer batches to absorb bursts
+        static capture_options throughput();
+
+        // immediate delivery and small batches, e.g. for SNI detection
+        static capture_options latency();
+    };
+
     void packet_handler( unsigned char* user_data, 
                          const struct pcap_pkthdr* pkthdr, 
                          const unsigned char* packet ); 
@@ -25,18 +49,41 @@ namespace ntk {
                                const struct pcap_pkthdr* pkthdr,
                                const unsigned char* packet );
 
+    /*
+        pcap_handler that appends the packet to the capture_file_writer passed as user_data
+    */
+    void write_packet_to_capture_file( unsigned char* user_data,
+                                       const struct pcap_pkthdr* pkthdr,
+                                       const unsigned char* packet );
+
+    // copies the frame and keeps the header's timestamp and wire length with it
+    captured_packet make_captured_packet( const struct pcap_pkthdr* pkthdr, const unsigned char* packet );
+
     pcap_if_t* list_and_select_device();
 
     pcap_t* open_device( pcap_if_t* device );
 
     pcap_t* open_device( const char* device_name );
 
+    // pcap_create / pcap_activate with the given options, nullptr on failure
+    pcap_t* open_device( const char* device_name, const capture_options& options );
+
     bool apply_filter( pcap_t* handle, const char* filter_exp );
 
-    int run_capture_loop( pcap_t* handle, std::ofstream &file_handle );
+    /*
+        calls pcap_dispatch with dispatch_batch until pcap_breakloop or an error,
+        returns PCAP_ERROR_BREAK or the error like pcap_loop would
+    */
+    int run_capture_loop( pcap_t* handle, std::ofstream &file_handle, int dispatch_batch = -1 );
+
+    int run_capture_loop( pcap_t* handle, capture_file_writer& writer, int dispatch_batch = -1 );
 
-    int run_capture_loop( pcap_t* handle, pcap_handler callback, u_char* user_data );
+    int run_capture_loop( pcap_t* handle, pcap_handler callback, u_char* user_data, int dispatch_batch = -1 );
 
+    /*
+        the output format follows the file extension, .pcap and .pcapng are written as
+        binary captures and anything else as hex text
+    */
     void capture_packets( const std::string& filename );
 
 } // namespace ntk
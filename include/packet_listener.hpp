@@ -5,30 +5,121 @@
 #include <thread>
 #include <functional>
 #include <atomic>
+#include <expected>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
 
+#include <checksum.hpp>
 #include <constants.hpp>
+#include <link_layer.hpp>
 #include <packet_capture.hpp>
+#include <packet_pool.hpp>
+#include <statistics.hpp>
+#include <thread_placement.hpp>
+#include <tpacket_ring.hpp>
 
 namespace ntk {
 
     using packet_callback = std::function<void( const struct pcap_pkthdr*, const unsigned char* )>;
+
+    using packet_view_callback = std::function<void( packet_view&& )>;
+
+    enum class capture_backend {
+        PCAP,       // pcap_open_live + pcap_loop, one callback per packet
+        TPACKET_V3  // memory-mapped AF_PACKET ring, one callback per retired block
+    };
     
+    struct capture_statistics {
+        uint64_t received;              // ps_recv, or every packet the ring saw
+        uint64_t dropped;               // ps_drop, no room in the kernel buffer
+        uint64_t interface_dropped;     // ps_ifdrop, dropped by the interface or driver
+        uint64_t pool_exhausted;        // frames start( packet_pool&, ... ) had no slot for
+        checksum_statistics checksums;  // of the tcp frames seen, with capture_options::verify_checksums
+    };
+
     class packet_listener {
 
         public: 
-            packet_listener( const char* device_name, const char* filter_exp );
+            packet_listener( const char* device_name, const char* filter_exp,
+                             capture_backend backend = capture_backend::PCAP,
+                             const tpacket_options& ring_options = {},
+                             const capture_options& options = {} );
             ~packet_listener();
             bool start( packet_callback callback );
+            /*
+                hand frames over in batches, a whole ring block at a time with TPACKET_V3 and
+                one frame at a time with PCAP
+            */
+            bool start_batch( packet_batch_callback callback );
+            /*
+                copy each captured frame once into a slot of the pool and hand the view on,
+                frames are dropped while the pool is exhausted
+            */
+            bool start( packet_pool& pool, packet_view_callback callback );
             void stop();
             bool is_capturing() const;
+            /*
+                swaps the BPF program of a running capture without closing the handle, packets
+                arriving meanwhile wait in the kernel buffer. with PCAP it is compiled on the
+                calling thread and put in place by the capture thread between two pcap_dispatch
+                calls, which this waits for. before start() it only replaces the expression.
+                a filter that does not compile leaves the old one in place. calls from several
+                threads take turns
+            */
+            std::expected<void,std::string> set_filter( const std::string& filter_exp );
+            std::string filter() const;
+            // of the frames delivered, known once start() has opened the capture, nothing without a decoder for it
+            std::optional<link_type> link() const;
+            // where the capture thread runs, taken up by the next start()
+            void place_capture_thread( const thread_placement& placement );
+            /*
+                current counters while capturing and the final ones after stop(),
+                meant for the thread that starts and stops the listener
+            */
+            capture_statistics statistics();
         private:
+            // on the capture thread, before the frame is handed on
+            void count_checksums( std::span<const uint8_t> frame );
+            // on the capture thread between pcap_dispatch calls
+            void install_pending_filter();
+            // the capture thread has left its loop, a set_filter() still waiting is told
+            void end_filter_swaps();
+
             const char* m_device_name;
-            const char* m_filter_exp;
+            std::string m_filter_exp;
+            capture_backend m_backend;
+            tpacket_options m_ring_options;
+            capture_options m_options;
             packet_callback m_callback;
+            packet_batch_callback m_batch_callback;
             pcap_t* m_handle;
+            std::unique_ptr<tpacket_ring> m_ring;
             std::thread m_capture_thread;
+            thread_placement m_placement;
             std::atomic<bool> m_capturing;
+            relaxed_counter m_pool_exhausted;
+            // picked at start() from the capture's link type, nothing when it cannot be decoded
+            std::optional<link_layer> m_link;
+            checksum_counters m_checksums;
+            capture_statistics m_last_statistics;
+
+            // pcap_breakloop from stop() rather than from a filter swap
+            std::atomic<bool> m_stopping;
+            // held by a set_filter() until its program is in place, so swaps go one at a time
+            std::mutex m_filter_swap_mutex;
+            mutable std::mutex m_filter_mutex;
+            // a program compiled for the capture thread, with the promise of the call that waits on it
+            struct pending_filter {
+                bpf_program program;
+                std::promise<std::expected<void,std::string>> installed;
+            };
+            std::optional<pending_filter> m_pending_filter;
+            bool m_loop_running = false;
     };
 
 } // namespace ntk
@@ -0,0 +1,109 @@
+#ifndef PACKET_POOL_HPP
+#define PACKET_POOL_HPP
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <constants.hpp>
+
+namespace ntk {
+
+    class packet_pool;
+
+    /*
+        ref-counted handle to a packet stored in a packet_pool slot
+
+        copying a view shares the slot, the slot goes back to the pool when the last
+        view referring to it is destroyed
+    */
+    class packet_view {
+
+        public:
+            packet_view() = default;
+            packet_view( const packet_view& other );
+            packet_view( packet_view&& other ) noexcept;
+            packet_view& operator=( const packet_view& other );
+            packet_view& operator=( packet_view&& other ) noexcept;
+            ~packet_view();
+
+            const uint8_t* data() const;
+            size_t size() const;
+            bool empty() const;
+
+            const uint8_t* begin() const;
+            const uint8_t* end() const;
+
+            std::span<const uint8_t> bytes() const;
+            std::vector<uint8_t> to_vector() const;
+
+            size_t use_count() const;
+
+            bool operator==( const std::vector<uint8_t>& other ) const;
+            bool operator==( std::span<const uint8_t> other ) const;
+        private:
+            packet_view( packet_pool* pool, uint32_t slot );
+            void release();
+
+            packet_pool* m_pool = nullptr;
+            uint32_t m_slot = 0;
+
+            friend class packet_pool;
+    };
+
+    /*
+        preallocated slab of fixed-size packet buffers
+
+        acquire() copies a captured frame into a free slot, which is the only copy made
+        between the capture buffer and the live stream that stores it. slots are handed
+        back through a lock-free free list, so views may be released from any thread
+    */
+    class packet_pool {
+
+        public:
+            // with a numa_node the slab is bound to that node, e.g. the one of the capturing NIC
+            packet_pool( size_t slot_count, size_t slot_size = constants::max_snap_len, int numa_node = -1 );
+
+            packet_pool( const packet_pool& ) = delete;
+            packet_pool& operator=( const packet_pool& ) = delete;
+
+            std::optional<packet_view> acquire( const unsigned char* packet, size_t len );
+
+            size_t slot_count() const;
+            size_t slot_size() const;
+            size_t available() const;
+        private:
+            struct slot {
+                std::atomic<uint32_t> refs;
+                uint32_t len;
+                std::atomic<uint32_t> next;
+            };
+
+            void retain( uint32_t index );
+            void release( uint32_t index );
+
+            const uint8_t* slot_data( uint32_t index ) const;
+
+            bool pop_free( uint32_t& index );
+            void push_free( uint32_t index );
+
+            size_t m_slot_count;
+            size_t m_slot_size;
+            std::unique_ptr<uint8_t[]> m_storage;
+            std::unique_ptr<slot[]> m_slots;
+
+            // free list head: low 32 bits are the slot index, high 32 bits a tag against ABA
+            std::atomic<uint64_t> m_free_head;
+            std::atomic<size_t> m_available;
+
+            friend class packet_view;
+    };
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef PAYLOAD_CLASSIFIER_HPP
+#define PAYLOAD_CLASSIFIER_HPP
+
+#include <span>
+
+#include <cstdint>
+
+#include <decoded_packet.hpp>
+
+namespace ntk {
+
+    enum class payload_protocol : uint8_t {
+        EMPTY,
+        HTTP_REQUEST,
+        HTTP_RESPONSE,
+        TLS_CHANGE_CIPHER_SPEC,
+        TLS_ALERT,
+        TLS_HANDSHAKE,              // a handshake record other than a hello
+        TLS_CLIENT_HELLO,
+        TLS_SERVER_HELLO,
+        TLS_APPLICATION_DATA,
+        TLS_RECORD,                 // a record header whose body does not match its content type
+        UNKNOWN
+    };
+
+    constexpr bool is_http_protocol( payload_protocol protocol ) {
+        return protocol == payload_protocol::HTTP_REQUEST || protocol == payload_protocol::HTTP_RESPONSE;
+    }
+
+    constexpr bool is_tls_protocol( payload_protocol protocol ) {
+        return protocol >= payload_protocol::TLS_CHANGE_CIPHER_SPEC && protocol <= payload_protocol::TLS_RECORD;
+    }
+
+    /*
+        what a tcp payload starts with, in one pass over its first bytes
+
+        the first byte selects, from a table built at compile time, the few http method
+        and status prefixes that could follow or the tls record checks, so a payload is
+        compared against those only. nothing is copied or allocated. is_http, get_http_type,
+        is_tls and the hello and alert predicates are wrappers around it
+    */
+    payload_protocol classify_payload( std::span<const uint8_t> payload );
+
+    payload_protocol classify_packet( const decoded_packet& packet );
+
+    // EMPTY for a frame that is not ipv4 / tcp
+    payload_protocol classify_packet( std::span<const uint8_t> frame );
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef PAYLOAD_DEDUP_HPP
+#define PAYLOAD_DEDUP_HPP
+
+#include <array>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <utility>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ntk {
+
+    struct payload_digest {
+        uint64_t hash;
+        uint64_t size;
+        std::optional<std::array<uint8_t,32>> sha256;      // when confirmation was asked for
+
+        bool operator==( const payload_digest& other ) const = default;
+    };
+
+    struct payload_digest_hash {
+        size_t operator()( const payload_digest& digest ) const {
+            return static_cast<size_t>( digest.hash );
+        }
+    };
+
+    /*
+        incremental hash of a payload fed as it streams
+
+        a 64 bit wyhash style hash over 16 byte blocks, fast enough to run on every body.
+        with confirm a sha-256 is taken alongside, for a duplicate that must never be a
+        collision
+    */
+    class payload_hasher {
+
+        public:
+            payload_hasher( bool confirm = false );
+            ~payload_hasher();
+
+            payload_hasher( payload_hasher&& other ) noexcept;
+            payload_hasher& operator=( payload_hasher&& other ) noexcept;
+            payload_hasher( const payload_hasher& ) = delete;
+            payload_hasher& operator=( const payload_hasher& ) = delete;
+
+            void update( std::span<const uint8_t> data );
+            // of everything fed so far, update may go on after it
+            payload_digest digest() const;
+        private:
+            void mix_block( const uint8_t* block );
+
+            uint64_t m_state;
+            uint64_t m_size;
+            std::array<uint8_t,16> m_tail;
+            size_t m_tail_size;
+            struct sha256_context;
+            std::unique_ptr<sha256_context> m_sha256;
+    };
+
+    /*
+        the files payloads were written to, by digest, for skipping the ones seen before
+
+        bounded to max_entries digests, the least recently seen is forgotten first, so a
+        payload that has not come by in a long time is written again. with confirm the
+        digests put into it carry a sha-256 as well. thread safe, sinks on several threads
+        may share one
+
+        a payload may be put in with the digest of its first bytes too, so one that starts
+        the same way is found while it is still arriving, before any of it is written
+    */
+    class payload_dedup_index {
+
+        public:
+            payload_dedup_index( size_t max_entries = 1 << 16, bool confirm = false );
+
+            // a hasher for the payloads looked up here
+            payload_hasher hasher() const;
+
+            // the file a payload with this digest went to, it becomes the most recently seen
+            std::optional<std::filesystem::path> find( const payload_digest& digest );
+            void insert( const payload_digest& digest, const std::filesystem::path& file,
+                         std::optional<payload_digest> prefix = std::nullopt );
+            // the file of the last payload put in with this prefix, what follows the prefix may differ
+            std::optional<std::filesystem::path> find_prefix( const payload_digest& prefix );
+
+            size_t size() const;
+        private:
+            struct entry {
+                payload_digest digest;
+                std::filesystem::path file;
+                std::optional<payload_digest> prefix;
+            };
+
+            size_t m_max_entries;
+            bool m_confirm;
+            mutable std::mutex m_mutex;
+            std::list<entry> m_entries;         // most recently seen first
+            std::unordered_map<payload_digest,std::list<entry>::iterator,payload_digest_hash> m_index;
+            std::unordered_map<payload_digest,std::list<entry>::iterator,payload_digest_hash> m_prefixes;
+    };
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef PCAP_FILE_HPP
+#define PCAP_FILE_HPP
+
+#include <expected>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <constants.hpp>
+#include <hex.hpp>
+
+namespace ntk {
+
+    /*
+        on-disk capture formats
+
+        HEX is the original one-packet-per-line text format, PCAP and PCAPNG are the
+        standard binary formats and keep timestamps and the original wire length
+    */
+    enum class capture_format {
+        HEX,
+        PCAP,
+        PCAPNG
+    };
+
+    namespace pcap_constants {
+
+        const uint32_t pcap_magic_usec = 0xa1b2c3d4;
+        const uint32_t pcap_magic_nsec = 0xa1b23c4d;
+        const uint16_t pcap_version_major = 2;
+        const uint16_t pcap_version_minor = 4;
+        const size_t pcap_file_header_len = 24;
+        const size_t pcap_record_header_len = 16;
+        const uint32_t link_type_ethernet = 1;
+
+        const uint32_t pcapng_section_header = 0x0a0d0d0a;
+        const uint32_t pcapng_interface_description = 0x00000001;
+        const uint32_t pcapng_simple_packet = 0x00000003;
+        const uint32_t pcapng_enhanced_packet = 0x00000006;
+        const uint32_t pcapng_byte_order_magic = 0x1a2b3c4d;
+        const uint16_t pcapng_option_tsresol = 9;
+
+    } // namespace pcap_constants
+
+    struct capture_record {
+        uint32_t ts_sec;
+        uint32_t ts_usec;
+        uint32_t len;
+        std::vector<uint8_t> data;
+    };
+
+    struct capture_record_view {
+        uint32_t ts_sec;
+        uint32_t ts_usec;
+        uint32_t len;
+        std::span<const uint8_t> data;
+    };
+
+    // .pcap and .pcapng select the binary formats, anything else is HEX
+    capture_format capture_format_from_filename( const std::string& filename );
+
+    // looks at the leading magic number, files without one are taken to be HEX
+    capture_format detect_capture_format( const std::string& filename );
+
+    capture_format detect_capture_format( std::span<const uint8_t> capture );
+
+    /*
+        walks the records of a capture held in memory without copying them
+
+        the data of a returned view points into the capture, or for HEX into the cursor,
+        and stays valid until the next call to next(). iteration stops at the first
+        malformed record and failed() reports it
+    */
+    class capture_cursor {
+
+        public:
+            capture_cursor() = default;
+            capture_cursor( std::span<const uint8_t> capture );
+
+            std::optional<capture_record_view> next();
+
+            capture_format format() const;
+            // the pcap LINKTYPE_ of the file, or of a pcapng's first interface, ethernet for HEX
+            uint32_t datalink() const;
+            bool failed() const;
+            const std::string& error() const;
+
+            // the bytes behind the last HEX record, for rebinding a view after copying the cursor
+            std::span<const uint8_t> decoded_line() const;
+            // the last record as it is stored in the capture, the packet itself or its HEX line
+            std::span<const uint8_t> stored_record() const;
+        private:
+            std::optional<capture_record_view> next_pcap();
+            std::optional<capture_record_view> next_pcapng();
+            std::optional<capture_record_view> next_hex();
+            std::optional<capture_record_view> fail( const std::string& error );
+
+            std::span<const uint8_t> m_capture;
+            size_t m_offset = 0;
+            capture_format m_format = capture_format::HEX;
+            bool m_swapped = false;
+            bool m_nanoseconds = false;
+            uint32_t m_datalink = pcap_constants::link_type_ethernet;
+            std::vector<uint64_t> m_interface_units;
+            std::vector<uint32_t> m_interface_snap_lens;
+            std::vector<uint8_t> m_hex_bytes;
+            std::span<const uint8_t> m_stored_record;
+            std::string m_error;
+    };
+
+    /*
+        writes packets in any capture_format, each packet is assembled and handed to the
+        stream in a single write. datalink is the LINKTYPE_ of the frames, e.g.
+        pcap_datalink() of the handle they come from, HEX files do not record it
+    */
+    class capture_file_writer {
+
+        public:
+            capture_file_writer( const std::string& filename,
+                                 capture_format format,
+                                 uint32_t snap_len = constants::max_snap_len,
+                                 uint32_t datalink = pcap_constants::link_type_ethernet );
+
+            capture_file_writer( const capture_file_writer& ) = delete;
+            capture_file_writer& operator=( const capture_file_writer& ) = delete;
+
+            bool is_open() const;
+            capture_format format() const;
+
+            void write( uint32_t ts_sec, uint32_t ts_usec, uint32_t caplen, uint32_t len, const unsigned char* data );
+            void write( const capture_record& record );
+            void write( const std::vector<uint8_t>& packet );
+            void flush();
+        private:
+            void write_file_header();
+
+            std::vector<char> m_stream_buffer;
+            std::ofstream m_file;
+            capture_format m_format;
+            uint32_t m_snap_len;
+            uint32_t m_datalink;
+            std::vector<char> m_scratch;
+    };
+
+    /*
+        reads every packet of a PCAP or PCAPNG file, either byte order and both
+        microsecond and nanosecond resolution are accepted
+    */
+    std::expected<std::vector<capture_record>,std::string> read_capture_records( const std::string& filename );
+
+    std::expected<std::vector<capture_record>,std::string> parse_capture_records( const uint8_t* data, size_t size );
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <cstddef>
+
+#include <work_stealing_pool.hpp>
+
+namespace ntk {
+
+    struct stage_options {
+        // items waiting in front of the stage before push() holds the sender back
+        size_t capacity = 64;
+        // how many items the stage may work on at once, 0 is as many as the pool has threads
+        size_t concurrency = 0;
+        // items one task takes before it hands its thread back to the pool
+        size_t batch = 16;
+    };
+
+    template<typename In>
+    class stage_input {
+        public:
+            virtual ~stage_input() = default;
+            virtual void push( In&& item ) = 0;
+    };
+
+    // what a stage's function hands its results to, each result goes to every connected stage
+    template<typename Out>
+    class stage_emitter {
+
+        public:
+            void operator()( Out&& item ) const {
+                if ( m_targets.empty() ) return;
+                if constexpr ( std::is_copy_constructible_v<Out> ) {
+                    for ( size_t i = 0; i + 1 < m_targets.size(); ++i ) m_targets[ i ]->push( Out( item ) );
+                }
+                m_targets.back()->push( std::move( item ) );
+            }
+
+            void operator()( const Out& item ) const {
+                ( *this )( Out( item ) );
+            }
+
+            bool connect( stage_input<Out>* target ) {
+                if constexpr ( !std::is_copy_constructible_v<Out> ) {
+                    if ( !m_targets.empty() ) {
+                        std::cerr << "Move-only stage output can only be connected once\n";
+                        return false;
+                    }
+                }
+                m_targets.push_back( target );
+                return true;
+            }
+        private:
+            std::vector<stage_input<Out>*> m_targets;
+    };
+
+    /*
+        one node of a processing graph, running on a work_stealing_pool
+
+        items pushed in wait in a bounded queue and are run through the function by pool
+        tasks, up to concurrency of them at a time, so a slow stage only holds up the
+        items queued in front of it. the function is one of
+
+            Out f( In&& )                               one result per item
+            std::optional<Out> f( In&& )                at most one
+            void f( In&&, const stage_emitter<Out>& )   any number
+            void f( In&& )                              none, for the last stage
+
+        push() on a full stage blocks an outside thread, a pool thread runs other queued
+        tasks meanwhile, so backpressure reaches the source without starving the stages
+        that would make room. stages are connected before the first push, and have to
+        outlive the work queued for them, the destructor waits for it
+    */
+    template<typename In,typename Out = std::monostate>
+    class pipeline_stage : public stage_input<In> {
+
+        public:
+            using function = std::function<void(In&&,const stage_emitter<Out>&)>;
+
+            template<typename F>
+            pipeline_stage( work_stealing_pool& pool, F&& f, stage_options options = stage_options{} )
+                : m_pool( pool ), m_function( adapt( std::forward<F>( f ) ) ), m_options( options ),
+                  m_active( 0 ), m_processed( 0 ) {
+                if ( m_options.capacity == 0 ) m_options.capacity = 1;
+                if ( m_options.batch == 0 ) m_options.batch = 1;
+                if ( m_options.concurrency == 0 ) m_options.concurrency = pool.thread_count();
+            }
+
+            ~pipeline_stage() {
+                std::unique_lock<std::mutex> lock( m_mutex );
+                m_idle.wait( lock, [ this ] { return m_active == 0; } );
+            }
+
+            pipeline_stage( const pipeline_stage& ) = delete;
+            pipeline_stage& operator=( const pipeline_stage& ) = delete;
+
+            template<typename Next>
+            pipeline_stage& connect( pipeline_stage<Out,Next>& next ) {
+                m_emitter.connect( &next );
+                return *this;
+            }
+
+            void push( In&& item ) {
+
+                std::unique_lock<std::mutex> lock( m_mutex );
+
+                while ( m_items.size() >= m_options.capacity ) {
+                    if ( !m_pool.on_pool_thread() ) {
+                        m_not_full.wait( lock, [ this ] { return m_items.size() < m_options.capacity; } );
+                        break;
+                    }
+                    lock.unlock();
+                    if ( !m_pool.run_one() ) std::this_thread::yield();
+                    lock.lock();
+                }
+
+                m_items.push_back( std::move( item ) );
+
+                bool schedule = m_active < m_options.concurrency;
+                if ( schedule ) ++m_active;
+
+                lock.unlock();
+
+                if ( schedule ) m_pool.submit( [ this ] { drain(); } );
+            }
+
+            void push( const In& item ) {
+                push( In( item ) );
+            }
+
+            size_t queued() const {
+                std::lock_guard<std::mutex> lock( m_mutex );
+                return m_items.size();
+            }
+
+            size_t processed() const {
+                std::lock_guard<std::mutex> lock( m_mutex );
+                return m_processed;
+            }
+        private:
+            template<typename F>
+            static function adapt( F&& f ) {
+                using fn = std::decay_t<F>;
+                if constexpr ( std::is_invocable_v<fn&,In&&,const stage_emitter<Out>&> ) {
+                    return function( std::forward<F>( f ) );
+                } else {
+                    static_assert( std::is_invocable_v<fn&,In&&>, "stage function has to take In&&" );
+                    return [ f = std::forward<F>( f ) ]( In&& item, const stage_emitter<Out>& emit ) mutable {
+                        using result = std::invoke_result_t<fn&,In&&>;
+                        if constexpr ( std::is_void_v<result> ) {
+                            f( std::move( item ) );
+                        } else if constexpr ( std::is_same_v<std::decay_t<result>,std::optional<Out>> ) {
+                            auto out = f( std::move( item ) );
+                            if ( out ) emit( std::move( *out ) );
+                        } else {
+                            emit( Out( f( std::move( item ) ) ) );
+                        }
+                    };
+                }
+            }
+
+            void drain() {
+
+                for ( size_t n = 0; ; ++n ) {
+
+                    std::unique_lock<std::mutex> lock( m_mutex );
+
+                    if ( m_items.empty() ) {
+                        --m_active;
+                        if ( m_active == 0 ) m_idle.notify_all();
+                        return;
+                    }
+
+                    if ( n == m_options.batch ) {
+                        // still work to do, queue up again behind the other stages' tasks
+                        lock.unlock();
+                        m_pool.submit( [ this ] { drain(); } );
+                        return;
+                    }
+
+                    In item = std::move( m_items.front() );
+                    m_items.pop_front();
+
+                    lock.unlock();
+                    m_not_full.notify_one();
+
+                    try {
+                        m_function( std::move( item ), m_emitter );
+                    } catch ( const std::exception& e ) {
+                        std::cerr << "Pipeline stage failed: " << e.what() << '\n';
+                    }
+
+                    lock.lock();
+                    ++m_processed;
+                }
+            }
+
+            work_stealing_pool& m_pool;
+            function m_function;
+            stage_emitter<Out> m_emitter;
+            stage_options m_options;
+
+            mutable std::mutex m_mutex;
+            std::condition_variable m_not_full;
+            std::condition_variable m_idle;
+            std::deque<In> m_items;
+            size_t m_active;
+            size_t m_processed;
+    };
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef QUIC_HPP
+#define QUIC_HPP
+
+#include <array>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <tcp.hpp>
+#include <udp.hpp>
+
+namespace ntk {
+
+    namespace quic_constants {
+
+        const uint32_t version_1 = 0x00000001;
+        const size_t max_connection_id_len = 20;
+
+        // rfc 9001 5.2
+        inline constexpr std::array<uint8_t,20> initial_salt_v1 = {
+            0x38, 0x76, 0x2c, 0xf7, 0xf5, 0x59, 0x34, 0xb3, 0x4d, 0x17,
+            0x9a, 0xe6, 0xa4, 0xc8, 0x0c, 0xad, 0xcc, 0xbb, 0x7f, 0x0a
+        };
+
+    } // namespace quic_constants
+
+    // AEAD_AES_128_GCM key, iv and header protection key of one direction's Initial packets
+    struct quic_initial_keys {
+        std::vector<uint8_t> key;
+        std::vector<uint8_t> iv;
+        std::vector<uint8_t> hp;
+    };
+
+    /*
+        rfc 9001 5.2, the keys follow from the destination connection id of the client's
+        first Initial packet, which anyone on the path can read. throws when openssl fails
+    */
+    quic_initial_keys derive_quic_initial_keys( std::span<const uint8_t> destination_connection_id, bool client = true );
+
+    // the variable-length integer at data[ pos ], pos is moved past it. nothing if it runs past data
+    std::optional<uint64_t> read_quic_varint( std::span<const uint8_t> data, size_t& pos );
+
+    /*
+        reads the ClientHello out of a client's QUIC v1 Initial packets
+
+        each datagram fed may coalesce several packets, the Initial ones have their header
+        protection removed and are decrypted with the keys of the first one's destination
+        connection id, everything else is stepped over. CRYPTO frames are put back in
+        stream order, so a ClientHello spread over several packets or datagrams, as post-
+        quantum key shares make it, is whole once all of them were fed
+    */
+    class quic_initial_decoder {
+
+        public:
+            // true when the datagram held at least one Initial packet that authenticated
+            bool feed( std::span<const uint8_t> udp_payload );
+
+            // the ClientHello body, after its handshake header, once all of it is in
+            std::optional<std::span<const uint8_t>> client_hello() const;
+            // the host_name of the server_name extension, a view into the decoder
+            std::optional<std::string_view> sni() const;
+
+            // Initial packets decrypted so far
+            size_t packets() const;
+        private:
+            // the length of the Initial packet at the start of packet, or of whatever else it is. nothing to stop
+            std::optional<size_t> decrypt( std::span<const uint8_t> packet );
+            void read_frames( std::span<const uint8_t> frames );
+            void add_crypto( uint64_t offset, std::span<const uint8_t> data );
+
+            std::optional<quic_initial_keys> m_keys;
+            std::optional<uint64_t> m_largest_packet_number;
+            size_t m_packets = 0;
+
+            // the crypto stream from offset zero, and what arrived ahead of a gap
+            std::vector<uint8_t> m_crypto;
+            std::map<uint64_t,std::vector<uint8_t>> m_pending;
+    };
+
+    // the server name of a ClientHello carried whole by one client datagram's Initial packets
+    std::optional<std::string> peek_quic_sni( std::span<const uint8_t> udp_payload );
+
+    // the server name out of the client datagrams a flow kept, nothing before the ClientHello is whole
+    std::optional<std::string> get_quic_sni( const udp_flow& flow );
+
+    /*
+        udp_flow_classifier for quic, undecided until the ClientHello in the client's
+        Initial packets is whole. a flow whose first datagram is no QUIC v1 Initial gets other
+    */
+    struct quic_classifier {
+        quic_classifier( flow_verdict quic = flow_verdict::KEEP, flow_verdict other = flow_verdict::DROP );
+        flow_verdict operator()( const udp_flow& flow ) const;
+
+        flow_verdict m_quic;
+        flow_verdict m_other;
+    };
+
+    // keeps quic flows whose ClientHello names a host containing sni, like sni_classifier does for tls over tcp
+    struct quic_sni_classifier {
+        quic_sni_classifier( const std::string& sni, flow_verdict other = flow_verdict::DROP );
+        flow_verdict operator()( const udp_flow& flow ) const;
+
+        std::string m_sni;
+        flow_verdict m_other;
+    };
+
+} // namespace ntk
+
+#endif
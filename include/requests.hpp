@@ -2,13 +2,76 @@
 #define REQUESTS_HPP
 
 #include <curl/curl.h>
+#include <atomic>
+#include <chrono>
 #include <string>
 #include <iostream>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <instrumentation.hpp>
 
 namespace ntk {
 
     bool make_request_curl( const std::string& url );
 
+    struct load_options {
+        std::vector<std::string> urls;      // taken in turn, e.g. the server/index.js endpoints
+        size_t total_requests = 1000;
+        size_t max_concurrent = 1000;
+        double requests_per_second = 0;     // 0 starts them as fast as max_concurrent allows
+        long timeout_ms = 10000;
+        // NSS key log lines for every handshake, appended as they happen, empty for none
+        std::string key_log_file;
+        bool verify_peer = true;
+        // off so every request is a connection, and a handshake, of its own
+        bool reuse_connections = false;
+    };
+
+    struct load_statistics {
+        uint64_t started;
+        uint64_t completed;
+        uint64_t failed;
+        uint64_t bytes_received;
+        std::chrono::nanoseconds elapsed;
+        histogram_snapshot latency;         // whole request in nanoseconds, connect to last byte
+        std::string first_error;
+    };
+
+    /*
+        concurrent http(s) load on a single curl_multi handle
+
+        requests are started at the configured rate, at most max_concurrent at a time,
+        and driven from the thread that calls run(). responses are counted and thrown
+        away. the key log is written through OpenSSL's keylog callback, so it is complete
+        for every handshake that finished, whether or not the request did
+    */
+    class curl_load_generator {
+
+        public:
+            curl_load_generator( const load_options& options );
+
+            curl_load_generator( const curl_load_generator& ) = delete;
+            curl_load_generator& operator=( const curl_load_generator& ) = delete;
+
+            // blocks until every request is done or stop(), false if curl could not be set up
+            bool run();
+            // from any thread, requests in flight are abandoned
+            void stop();
+
+            // once run() returned
+            load_statistics statistics() const;
+        private:
+            CURL* make_easy( const std::string& url );
+
+            load_options m_options;
+            std::atomic<bool> m_stop;
+            histogram m_latency;
+            load_statistics m_statistics;
+    };
+
 } // namespace ntk
 
-#endif
\ No newline at end of file
+#endif
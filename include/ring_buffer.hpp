@@ -1,48 +1,209 @@
 #ifndef RING_BUFFER_HPP
 #define RING_BUFFER_HPP
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <span>
+#include <utility>
+
 #include <cstddef>
+#include <cstdint>
+
+#include <statistics.hpp>
 
 namespace ntk {
 
-    template<typename T,size_t N> 
+    inline constexpr size_t cache_line_size = 64;
+
+    struct ring_statistics {
+        uint64_t push_failures;     // items turned away because the ring was full
+        uint64_t high_watermark;    // highest occupancy seen by the producer
+    };
+
+    /*
+        single-producer single-consumer ring
+
+        holds up to N - 1 items. storage is rounded up to a power of two so indices are
+        masked rather than taken modulo N, head and tail run freely and live on separate
+        cache lines, and each side keeps a snapshot of the other side's index so it only
+        touches the shared line when the snapshot says the ring is full or empty
+    */
+    template<typename T,size_t N>
     class ring_buffer {
 
+        static_assert( N >= 2, "ring_buffer needs room for at least one item" );
+
         public:
+            using value_type = T;
+
             ring_buffer();
             bool push( const T& item );
-            bool pop( T& item ); 
+            bool push( T&& item );
+            template<typename... Args>
+            bool emplace( Args&&... args );
+            bool pop( T& item );
+
+            /*
+                move up to items.size() items in or out with a single index publish,
+                returns the number of items transferred
+            */
+            size_t push_bulk( std::span<T> items );
+            size_t pop_bulk( std::span<T> items );
+
+            size_t size() const;
+            bool empty() const;
+            static constexpr size_t capacity() { return N - 1; }
+
+            /*
+                kept by the producer, the watermark is measured against its snapshot of the
+                tail and so may overstate the true occupancy, never understate it
+            */
+            ring_statistics statistics() const;
         private:
-            std::array<T,N> m_buffer;
-            std::atomic<size_t> m_head;
-            std::atomic<size_t> m_tail;
+            static constexpr size_t storage_size = std::bit_ceil( N );
+            static constexpr size_t mask = storage_size - 1;
+
+            // refresh the snapshot of the other side only when it cannot satisfy the request
+            size_t free_slots( size_t head, size_t wanted );
+            size_t ready_slots( size_t tail, size_t wanted );
+
+            void record_push( size_t new_head, size_t rejected );
+
+            // producer side
+            alignas( cache_line_size ) std::atomic<size_t> m_head;
+            size_t m_cached_tail;
+            relaxed_counter m_push_failures;
+            relaxed_counter m_high_watermark;
+
+            // consumer side
+            alignas( cache_line_size ) std::atomic<size_t> m_tail;
+            size_t m_cached_head;
+
+            alignas( cache_line_size ) std::array<T,storage_size> m_buffer;
     };
 
     template<typename T,size_t N>
     ring_buffer<T,N>::ring_buffer()
-        : m_head( 0 ), m_tail( 0 ) {}
+        : m_head( 0 ), m_cached_tail( 0 ), m_tail( 0 ), m_cached_head( 0 ) {}
+
+    template<typename T,size_t N>
+    size_t ring_buffer<T,N>::free_slots( size_t head, size_t wanted ) {
+        size_t free = capacity() - ( head - m_cached_tail );
+        if ( free < wanted ) {
+            m_cached_tail = m_tail.load( std::memory_order_acquire );
+            free = capacity() - ( head - m_cached_tail );
+        }
+        return free;
+    }
+
+    template<typename T,size_t N>
+    size_t ring_buffer<T,N>::ready_slots( size_t tail, size_t wanted ) {
+        size_t ready = m_cached_head - tail;
+        if ( ready < wanted ) {
+            m_cached_head = m_head.load( std::memory_order_acquire );
+            ready = m_cached_head - tail;
+        }
+        return ready;
+    }
+
+    template<typename T,size_t N>
+    void ring_buffer<T,N>::record_push( size_t new_head, size_t rejected ) {
+        if ( rejected ) m_push_failures.add( rejected );
+        m_high_watermark.raise_to( new_head - m_cached_tail );
+    }
 
     template<typename T,size_t N>
     bool ring_buffer<T,N>::push( const T& item ) {
         size_t head = m_head.load( std::memory_order_relaxed );
-        size_t tail = m_tail.load( std::memory_order_acquire );
-        size_t next_head = ( head + 1 ) % N;
-        if ( next_head == tail ) return false;
-        m_buffer[ head ] = item;
-        m_head.store( next_head, std::memory_order_release );
+        if ( free_slots( head, 1 ) == 0 ) {
+            record_push( head, 1 );
+            return false;
+        }
+        m_buffer[ head & mask ] = item;
+        m_head.store( head + 1, std::memory_order_release );
+        record_push( head + 1, 0 );
+        return true;
+    }
+
+    template<typename T,size_t N>
+    bool ring_buffer<T,N>::push( T&& item ) {
+        size_t head = m_head.load( std::memory_order_relaxed );
+        if ( free_slots( head, 1 ) == 0 ) {
+            record_push( head, 1 );
+            return false;
+        }
+        m_buffer[ head & mask ] = std::move( item );
+        m_head.store( head + 1, std::memory_order_release );
+        record_push( head + 1, 0 );
+        return true;
+    }
+
+    template<typename T,size_t N>
+    template<typename... Args>
+    bool ring_buffer<T,N>::emplace( Args&&... args ) {
+        size_t head = m_head.load( std::memory_order_relaxed );
+        if ( free_slots( head, 1 ) == 0 ) {
+            record_push( head, 1 );
+            return false;
+        }
+        m_buffer[ head & mask ] = T( std::forward<Args>( args )... );
+        m_head.store( head + 1, std::memory_order_release );
+        record_push( head + 1, 0 );
         return true;
     }
 
     template<typename T,size_t N>
     bool ring_buffer<T,N>::pop( T& item ) {
-        size_t head = m_head.load( std::memory_order_acquire );
         size_t tail = m_tail.load( std::memory_order_relaxed );
-        if ( head == tail ) return false;
-        item = m_buffer[ tail ];
-        m_tail.store( ( tail + 1 ) % N, std::memory_order_release );
+        if ( ready_slots( tail, 1 ) == 0 ) return false;
+        // move out so the slot does not keep a reference to the item, e.g. a pooled packet
+        item = std::move( m_buffer[ tail & mask ] );
+        m_tail.store( tail + 1, std::memory_order_release );
         return true;
     }
 
+    template<typename T,size_t N>
+    size_t ring_buffer<T,N>::push_bulk( std::span<T> items ) {
+        size_t head = m_head.load( std::memory_order_relaxed );
+        size_t count = std::min( items.size(), free_slots( head, items.size() ) );
+        for ( size_t i = 0; i < count; ++i ) {
+            m_buffer[ ( head + i ) & mask ] = std::move( items[ i ] );
+        }
+        if ( count ) m_head.store( head + count, std::memory_order_release );
+        record_push( head + count, items.size() - count );
+        return count;
+    }
+
+    template<typename T,size_t N>
+    size_t ring_buffer<T,N>::pop_bulk( std::span<T> items ) {
+        size_t tail = m_tail.load( std::memory_order_relaxed );
+        size_t count = std::min( items.size(), ready_slots( tail, items.size() ) );
+        for ( size_t i = 0; i < count; ++i ) {
+            items[ i ] = std::move( m_buffer[ ( tail + i ) & mask ] );
+        }
+        if ( count ) m_tail.store( tail + count, std::memory_order_release );
+        return count;
+    }
+
+    template<typename T,size_t N>
+    size_t ring_buffer<T,N>::size() const {
+        size_t tail = m_tail.load( std::memory_order_acquire );
+        size_t head = m_head.load( std::memory_order_acquire );
+        return head - tail;
+    }
+
+    template<typename T,size_t N>
+    bool ring_buffer<T,N>::empty() const {
+        return size() == 0;
+    }
+
+    template<typename T,size_t N>
+    ring_statistics ring_buffer<T,N>::statistics() const {
+        return ring_statistics{ m_push_failures.value(), m_high_watermark.value() };
+    }
+
 } // namespace ntk
 
 #endif
@@ -0,0 +1,98 @@
+#ifndef SESSION_COLUMNS_HPP
+#define SESSION_COLUMNS_HPP
+
+#include <ranges>
+#include <span>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <captured_packet.hpp>
+#include <constants.hpp>
+#include <flow_key.hpp>
+#include <ipv4.hpp>
+
+namespace ntk {
+
+    /*
+        the tcp headers of a session decoded once into one array per field
+
+        row r describes the packet at index()[ r ] of the session, packets that are not
+        ipv4 or ipv6 / tcp have no row. a filter or count then reads one or two
+        contiguous arrays instead of parsing every frame again, e.g. counting FIN_ACKs
+        is std::ranges::count_if over flags(). the columns copy what they hold, so
+        the session does not have to outlive them
+    */
+    class session_columns {
+
+        public:
+            session_columns( const session& packets );
+            // fills timestamps() too
+            session_columns( const std::vector<captured_packet>& packets );
+
+            size_t size() const;
+            bool empty() const;
+
+            // where each row's packet is in the session it was built from
+            std::span<const uint32_t> index() const;
+
+            std::span<const ip_address> source_ip() const;
+            std::span<const ip_address> destination_ip() const;
+            std::span<const uint16_t> source_port() const;
+            std::span<const uint16_t> destination_port() const;
+            std::span<const uint32_t> sequence_number() const;
+            std::span<const uint32_t> acknowledgment_number() const;
+            std::span<const uint8_t> flags() const;
+            // of the tcp payload within its frame, ethernet padding left out
+            std::span<const uint16_t> payload_offset() const;
+            std::span<const uint32_t> payload_len() const;
+            // empty unless built from captured packets
+            std::span<const capture_time> timestamps() const;
+
+            four_tuple four( size_t row ) const;
+        private:
+            template<typename Packets>
+            void decode( const Packets& packets );
+
+            std::vector<uint32_t> m_index;
+            std::vector<ip_address> m_source_ip;
+            std::vector<ip_address> m_destination_ip;
+            std::vector<uint16_t> m_source_port;
+            std::vector<uint16_t> m_destination_port;
+            std::vector<uint32_t> m_sequence_number;
+            std::vector<uint32_t> m_acknowledgment_number;
+            std::vector<uint8_t> m_flags;
+            std::vector<uint16_t> m_payload_offset;
+            std::vector<uint32_t> m_payload_len;
+            std::vector<capture_time> m_timestamps;
+    };
+
+    // the rows sent from src_dest.first to src_dest.second, see session_columns::index for their packets
+    inline decltype(auto) filter_by_ip( const session_columns& columns, const sender_reciever& src_dest ) {
+
+        ip_address sender( src_dest.first ), reciever( src_dest.second );
+
+        return std::views::iota( size_t( 0 ), columns.size() ) | std::views::filter( [ &columns, sender, reciever ]( size_t row ) {
+            return columns.source_ip()[ row ] == sender && columns.destination_ip()[ row ] == reciever;
+        });
+    }
+
+    // the rows between the two addresses in either direction
+    inline decltype(auto) filter_by_ip_duplex( const session_columns& columns, const sender_reciever& src_dest ) {
+
+        ip_address first( src_dest.first ), second( src_dest.second );
+
+        return std::views::iota( size_t( 0 ), columns.size() ) | std::views::filter( [ &columns, first, second ]( size_t row ) {
+            auto source = columns.source_ip()[ row ];
+            auto destination = columns.destination_ip()[ row ];
+            return ( source == first && destination == second ) || ( source == second && destination == first );
+        });
+    }
+
+    // rows whose flags have every bit of mask set as in value, e.g. ( FIN_ACK, FIN_ACK )
+    size_t count_flags( const session_columns& columns, uint8_t mask, uint8_t value );
+
+} // namespace ntk
+
+#endif
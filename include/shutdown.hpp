@@ -0,0 +1,63 @@
+#ifndef SHUTDOWN_HPP
+#define SHUTDOWN_HPP
+
+#include <chrono>
+#include <span>
+
+#include <cstddef>
+
+#include <stream_processor.hpp>
+
+namespace ntk {
+
+    struct shutdown_report {
+        size_t frames_drained;      // taken off the ring after capture stopped
+        size_t streams_flushed;     // still open, offloaded with eviction_reason::SHUTDOWN
+        bool completed;             // false if the deadline cut any step short
+    };
+
+    /*
+        coordinated shutdown of a capture pipeline, in the order data flows through it
+
+        capture is stopped first so nothing new arrives, whatever is left in the ring is
+        fed to the session, the session flushes its open streams into the offload queue
+        and finally every processor drains that queue. the ring and session steps check
+        the deadline between frames, the processors between streams, what is left when
+        it passes is dropped as before.
+
+        Listener needs stop(), Ring pop( item& ) and Session feed( item ) and flush(),
+        e.g. packet_listener, ring_buffer<captured_packet,N> and tcp_live_stream_session.
+        the ring must not have another consumer by now
+    */
+    template<typename Listener, typename Ring, typename Session>
+    shutdown_report drain_pipeline( Listener& listener, Ring& ring, Session& session,
+                                    std::span<stream_processor* const> processors,
+                                    std::chrono::steady_clock::time_point deadline ) {
+
+        shutdown_report report{ 0, 0, true };
+
+        listener.stop();
+
+        typename Ring::value_type frame;
+        while ( ring.pop( frame ) ) {
+            session.feed( frame );
+            ++report.frames_drained;
+            if ( std::chrono::steady_clock::now() >= deadline ) {
+                report.completed = false;
+                break;
+            }
+        }
+
+        report.streams_flushed = session.flush();
+
+        // each one is given whatever time the one before left
+        for ( auto* processor : processors ) {
+            if ( !processor->stop( stop_mode::DRAIN, deadline ) ) report.completed = false;
+        }
+
+        return report;
+    }
+
+} // namespace ntk
+
+#endif
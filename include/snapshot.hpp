@@ -0,0 +1,142 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace ntk {
+
+    /*
+        the binary format of a checkpointed session, see tcp_live_stream_session::checkpoint
+
+        values go out as they are in memory, in host byte order, and byte strings are
+        length prefixed. a snapshot is for the next process on the same machine, its
+        header's byte order mark and format version turn anything else away
+    */
+    class snapshot_writer {
+
+        public:
+            snapshot_writer( std::ostream& out )
+                : m_out( out ) {}
+
+            template<typename T> requires std::is_trivially_copyable_v<T>
+            void write( const T& value ) {
+                m_out.write( reinterpret_cast<const char*>( &value ), sizeof( value ) );
+            }
+
+            void write_bytes( std::span<const uint8_t> bytes ) {
+                write( static_cast<uint64_t>( bytes.size() ) );
+                m_out.write( reinterpret_cast<const char*>( bytes.data() ), bytes.size() );
+            }
+
+            void write_optional_bytes( const std::optional<std::vector<uint8_t>>& bytes ) {
+                write( bytes.has_value() );
+                if ( bytes ) write_bytes( *bytes );
+            }
+
+            bool good() const {
+                return m_out.good();
+            }
+        private:
+            std::ostream& m_out;
+    };
+
+    /*
+        reads a snapshot in place, byte strings come back as spans into it. nothing is
+        read past the end, once a read comes up short it and every later one fails
+    */
+    class snapshot_reader {
+
+        public:
+            snapshot_reader( std::span<const uint8_t> data )
+                : m_data( data ) {}
+
+            template<typename T> requires std::is_trivially_copyable_v<T>
+            bool read( T& value ) {
+                if ( !take( sizeof( value ) ) ) return false;
+                std::memcpy( &value, m_data.data() + m_offset - sizeof( value ), sizeof( value ) );
+                return true;
+            }
+
+            std::optional<std::span<const uint8_t>> read_bytes() {
+                uint64_t size = 0;
+                if ( !read( size ) || size > m_data.size() - m_offset ) return fail();
+                m_offset += size;
+                return m_data.subspan( m_offset - size, size );
+            }
+
+            bool read_bytes( std::vector<uint8_t>& bytes ) {
+                auto span = read_bytes();
+                if ( !span ) return false;
+                bytes.assign( span->begin(), span->end() );
+                return true;
+            }
+
+            bool read_optional_bytes( std::optional<std::vector<uint8_t>>& bytes ) {
+                bool present = false;
+                if ( !read( present ) ) return false;
+                if ( !present ) {
+                    bytes = std::nullopt;
+                    return true;
+                }
+                bytes.emplace();
+                return read_bytes( *bytes );
+            }
+
+            bool failed() const {
+                return m_failed;
+            }
+        private:
+            bool take( size_t size ) {
+                if ( m_failed || size > m_data.size() - m_offset ) {
+                    m_failed = true;
+                    return false;
+                }
+                m_offset += size;
+                return true;
+            }
+
+            std::nullopt_t fail() {
+                m_failed = true;
+                return std::nullopt;
+            }
+
+            std::span<const uint8_t> m_data;
+            size_t m_offset = 0;
+            bool m_failed = false;
+    };
+
+    /*
+        a snapshot mapped read-only for a snapshot_reader, pages are read ahead as it is
+        read front to back once. where the platform has no mmap the file is read in
+    */
+    class snapshot_file {
+
+        public:
+            snapshot_file( const std::string& filename );
+            ~snapshot_file();
+
+            snapshot_file( const snapshot_file& ) = delete;
+            snapshot_file& operator=( const snapshot_file& ) = delete;
+
+            bool is_open() const;
+            std::span<const uint8_t> bytes() const;
+        private:
+            const uint8_t* m_data = nullptr;
+            size_t m_size = 0;
+            bool m_open = false;
+            bool m_mapped = false;
+            std::vector<uint8_t> m_contents;
+    };
+
+} // namespace ntk
+
+#endif
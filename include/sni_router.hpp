@@ -0,0 +1,124 @@
+#ifndef SNI_ROUTER_HPP
+#define SNI_ROUTER_HPP
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <spmc_queue.hpp>
+#include <statistics.hpp>
+#include <tcp.hpp>
+
+namespace ntk {
+
+    /*
+        host name rules compiled into a trie over the names' labels, last label first
+
+        "example.com" matches that name only, "*.example.com" one label below it and
+        ".example.com" the name and everything below it. a lookup walks the host's
+        labels once, however many rules there are, and nothing is allocated. names
+        compare without case. an exact rule wins over a wildcard, a wildcard over a
+        suffix and a longer suffix over a shorter one
+    */
+    class sni_rule_table {
+
+        public:
+            sni_rule_table();
+
+            // a later rule with the same pattern replaces the earlier one. false for an empty or malformed pattern
+            bool add( std::string_view pattern, size_t target );
+            std::optional<size_t> match( std::string_view host ) const;
+
+            size_t size() const;
+        private:
+            static constexpr uint32_t no_target = UINT32_MAX;
+
+            struct node {
+                uint32_t exact = no_target;
+                uint32_t wildcard = no_target;
+                uint32_t suffix = no_target;
+            };
+
+            struct edge {
+                uint32_t parent;
+                std::string label;
+            };
+
+            struct edge_view {
+                uint32_t parent;
+                std::string_view label;
+            };
+
+            struct edge_hash {
+                using is_transparent = void;
+                size_t operator()( const edge_view& e ) const;
+                size_t operator()( const edge& e ) const { return ( *this )( edge_view{ e.parent, e.label } ); }
+            };
+
+            struct edge_equal {
+                using is_transparent = void;
+                bool operator()( const edge_view& lhs, const edge_view& rhs ) const {
+                    return lhs.parent == rhs.parent && lhs.label == rhs.label;
+                }
+                bool operator()( const edge& lhs, const edge& rhs ) const { return ( *this )( view( lhs ), view( rhs ) ); }
+                bool operator()( const edge& lhs, const edge_view& rhs ) const { return ( *this )( view( lhs ), rhs ); }
+                bool operator()( const edge_view& lhs, const edge& rhs ) const { return ( *this )( lhs, view( rhs ) ); }
+                static edge_view view( const edge& e ) { return { e.parent, e.label }; }
+            };
+
+            std::vector<node> m_nodes;          // the root, the empty name, is the first
+            std::unordered_map<edge,uint32_t,edge_hash,edge_equal> m_edges;
+            size_t m_rules;
+    };
+
+    // the ClientHello's server name, from the reassembled client payload or, once that was released, the frames
+    std::optional<std::string_view> get_stream_sni( const tcp_live_stream& stream );
+
+    struct sni_router_statistics {
+        uint64_t streams_routed;
+        uint64_t streams_unmatched;     // no rule matched or no server name, given to the unmatched queue if there is one
+    };
+
+    /*
+        hands each offloaded stream to the queue of the rule its server name matches
+
+        takes the place of a spmc_transfer_queue with an sni_filter per host name: the
+        session offloads to the router and consumers pop from the queues the rules name.
+        one rule table lookup per stream, however many rules. add the routes before the
+        first stream is pushed. the router itself holds nothing, pops return nullopt
+    */
+    class sni_router : public transfer_queue_interface<tcp_live_stream> {
+
+        public:
+            sni_router( transfer_queue_interface<tcp_live_stream>* unmatched = nullptr );
+
+            // see sni_rule_table for the patterns
+            bool add_route( std::string_view pattern, transfer_queue_interface<tcp_live_stream>& queue );
+            // the queue for host, nullptr without a matching rule
+            transfer_queue_interface<tcp_live_stream>* route( std::string_view host ) const;
+
+            void push( const tcp_live_stream& stream ) override;
+            void push( tcp_live_stream&& stream ) override;
+            std::optional<tcp_live_stream> pop_for( std::chrono::milliseconds time_out ) override;
+            std::optional<tcp_live_stream> try_pop() override;
+
+            sni_router_statistics statistics() const;
+        private:
+            transfer_queue_interface<tcp_live_stream>* queue_for( const tcp_live_stream& stream );
+
+            sni_rule_table m_rules;
+            std::vector<transfer_queue_interface<tcp_live_stream>*> m_queues;
+            transfer_queue_interface<tcp_live_stream>* m_unmatched;
+
+            relaxed_counter m_streams_routed;
+            relaxed_counter m_streams_unmatched;
+    };
+
+} // namespace ntk
+
+#endif
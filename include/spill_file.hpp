@@ -0,0 +1,67 @@
+#ifndef SPILL_FILE_HPP
+#define SPILL_FILE_HPP
+
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ntk {
+
+    /*
+        append-only temporary file of frames, for streams that outgrow their memory budget
+
+        frames are written back to back and only their offsets stay in memory. once the
+        stream is done map() brings the whole file back read-only and frames() points
+        into the mapping, so reading a spilled stream costs page faults rather than a
+        copy. the file is unlinked as soon as it is created, nothing is left behind if
+        the process dies, and it is gone with the last reference
+    */
+    class spill_file {
+
+        public:
+            spill_file( const std::filesystem::path& directory );
+            ~spill_file();
+
+            spill_file( const spill_file& ) = delete;
+            spill_file& operator=( const spill_file& ) = delete;
+
+            bool is_open() const;
+
+            // fails once mapped, the file only grows while the stream is live
+            bool append( std::span<const uint8_t> frame );
+
+            bool map();
+            bool is_mapped() const;
+
+            // valid after map()
+            const std::vector<std::span<const uint8_t>>& frames() const;
+            // a copy of one frame, mapped or not, e.g. to checkpoint a stream that is still live
+            bool read( size_t index, std::vector<uint8_t>& frame ) const;
+
+            size_t frame_count() const;
+            size_t size_bytes() const;
+        private:
+            struct extent {
+                size_t offset;
+                size_t size;
+            };
+
+            int m_fd;
+            size_t m_size;
+            std::vector<extent> m_extents;
+
+            const uint8_t* m_data;
+            bool m_mapped;
+            std::vector<std::span<const uint8_t>> m_frames;
+
+            // where the platform has no mmap the file is read back into this
+            std::filesystem::path m_path;
+            std::vector<uint8_t> m_contents;
+    };
+
+} // namespace ntk
+
+#endif
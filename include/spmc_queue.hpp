@@ -6,6 +6,7 @@
 #include <condition_variable>
 #include <optional>
 #include <concepts>
+#include <stop_token>
 
 namespace ntk {
 
@@ -26,7 +27,14 @@ namespace ntk {
         public:
             virtual ~transfer_queue_interface() = default;
             virtual void push(const T& item) = 0;
+            // hands the item over without a copy, queues that can only copy keep the default
+            virtual void push( T&& item ) { push( static_cast<const T&>( item ) ); }
             virtual std::optional<T> pop_for( std::chrono::milliseconds time_out ) = 0;
+            // also returns as soon as stop is requested, queues that cannot be woken wait out the time out
+            virtual std::optional<T> pop_for( std::chrono::milliseconds time_out, std::stop_token stop ) {
+                if ( stop.stop_requested() ) return try_pop();
+                return pop_for( time_out );
+            }
             virtual std::optional<T> try_pop() = 0;
     };
 
@@ -39,14 +47,17 @@ namespace ntk {
             spmc_transfer_queue( Filter filter );
 
             void push( const T& item );
+            void push( T&& item );
             std::optional<T> pop_for( std::chrono::milliseconds time_out );
+            std::optional<T> pop_for( std::chrono::milliseconds time_out, std::stop_token stop );
             std::optional<T> try_pop();
             bool empty() const;
+            size_t size() const;
 
         private:
             std::queue<T> m_queue;
             mutable std::mutex m_mutex;
-            std::condition_variable m_cv;
+            std::condition_variable_any m_cv;
             Filter m_filter;
     };
 
@@ -66,6 +77,17 @@ namespace ntk {
         m_cv.notify_one(); 
     }
 
+    template<typename T,typename Filter>
+        requires FilterConcept<Filter,T> 
+    void spmc_transfer_queue<T,Filter>::push( T&& item ) {
+        if ( !m_filter( item ) ) return;
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_queue.push( std::move( item ) );
+        }
+        m_cv.notify_one(); 
+    }
+
     template<typename T,typename Filter>
         requires FilterConcept<Filter,T>
     std::optional<T> spmc_transfer_queue<T,Filter>::pop_for( std::chrono::milliseconds time_out ) {
@@ -78,6 +100,18 @@ namespace ntk {
         return item;
     }
 
+    template<typename T,typename Filter>
+        requires FilterConcept<Filter,T>
+    std::optional<T> spmc_transfer_queue<T,Filter>::pop_for( std::chrono::milliseconds time_out, std::stop_token stop ) {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        if ( !m_cv.wait_for( lock, stop, time_out, [ this ] { return !m_queue.empty(); } )) {
+            return std::nullopt;
+        }
+        T item = std::move( m_queue.front() );
+        m_queue.pop();
+        return item;
+    }
+
     template<typename T,typename Filter>
         requires FilterConcept<Filter,T>
     std::optional<T> spmc_transfer_queue<T,Filter>::try_pop() {
@@ -95,6 +129,13 @@ namespace ntk {
         return m_queue.empty();
     }
 
+    template<typename T,typename Filter>
+        requires FilterConcept<Filter,T>
+    size_t spmc_transfer_queue<T,Filter>::size() const {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        return m_queue.size();
+    }
+
 } // namespace ntk
 
 #endif
@@ -0,0 +1,53 @@
+#ifndef STATISTICS_HPP
+#define STATISTICS_HPP
+
+#include <atomic>
+
+#include <cstdint>
+
+namespace ntk {
+
+    /*
+        counter with a single writing thread that any thread may read
+
+        the writer does a relaxed load and store instead of a locked read-modify-write,
+        so keeping it always on costs about as much as a plain increment. counters that
+        several threads update are kept one per thread and summed when read
+    */
+    class relaxed_counter {
+
+        public:
+            relaxed_counter()
+                : m_value( 0 ) {}
+
+            relaxed_counter( const relaxed_counter& other )
+                : m_value( other.value() ) {}
+
+            relaxed_counter& operator=( const relaxed_counter& other ) {
+                m_value.store( other.value(), std::memory_order_relaxed );
+                return *this;
+            }
+
+            void add( uint64_t n = 1 ) {
+                m_value.store( m_value.load( std::memory_order_relaxed ) + n, std::memory_order_relaxed );
+            }
+
+            // for gauges, the owning thread is still the only writer
+            void set( uint64_t n ) {
+                m_value.store( n, std::memory_order_relaxed );
+            }
+
+            void raise_to( uint64_t n ) {
+                if ( n > m_value.load( std::memory_order_relaxed ) ) m_value.store( n, std::memory_order_relaxed );
+            }
+
+            uint64_t value() const {
+                return m_value.load( std::memory_order_relaxed );
+            }
+        private:
+            std::atomic<uint64_t> m_value;
+    };
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef STREAM_EVENTS_HPP
+#define STREAM_EVENTS_HPP
+
+#include <span>
+
+#include <cstdint>
+
+#include <flow_key.hpp>
+
+namespace ntk {
+
+    enum class stream_direction {
+        CLIENT_TO_SERVER,
+        SERVER_TO_CLIENT
+    };
+
+    enum class close_reason {
+        TERMINATED,     // a clean tcp termination
+        IDLE,
+        LIFETIME,
+        MEMORY,
+        SHUTDOWN        // flushed by the session while still open
+    };
+
+    /*
+        callbacks from a tcp_live_stream_session as streams progress, called on the
+        feeding thread. on_data gets each direction's payload once, in order, as soon
+        as the gap before it is closed, and the span is only valid during the call.
+        the four_tuple is the one the stream was opened with
+    */
+    class stream_events {
+        public:
+            virtual ~stream_events() = default;
+            virtual void on_open( const four_tuple& four ) {}
+            virtual void on_data( const four_tuple& four, stream_direction direction, std::span<const uint8_t> data ) {}
+            virtual void on_close( const four_tuple& four, close_reason reason ) {}
+    };
+
+} // namespace ntk
+
+#endif
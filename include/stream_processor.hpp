@@ -3,12 +3,29 @@
 
 #include <thread>
 #include <atomic>
+#include <functional>
+#include <stop_token>
+#include <vector>
 
+#include <instrumentation.hpp>
+#include <thread_placement.hpp>
 #include <tcp.hpp>
 #include <spmc_queue.hpp>
 
 namespace ntk {
 
+    enum class stop_mode {
+        IMMEDIATE,  // streams still queued are left in the queue
+        DRAIN       // workers finish what is queued before they exit
+    };
+
+    /*
+        pool of workers that take completed streams off the queue and hand them to the callback
+
+        every worker blocks in pop_for until a stream arrives or stop() is called, so a
+        stream is picked up as soon as it is queued and idle workers cost nothing. with
+        more than one worker the callback runs on several threads at once
+    */
     class stream_processor {
 
         public:
@@ -17,21 +34,41 @@ namespace ntk {
 
             stream_processor(
                 transfer_queue_interface<tcp_live_stream>& queue,
-                stream_callback callback
+                stream_callback callback,
+                size_t n_workers = 1
             );
 
             void start();
-            void stop();
+            /*
+                wakes blocked workers straight away, a callback already running is finished
+                first. a drain gives up at the deadline, returns false if it had to
+            */
+            bool stop( stop_mode mode = stop_mode::IMMEDIATE,
+                       std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max() );
+
+            size_t worker_count() const;
+
+            // records offload to callback latency and callback time, call before start()
+            void instrument( metrics_registry& registry );
+            // every worker runs with it, taken up by the next start()
+            void set_placement( const thread_placement& placement );
         private:
-            void run();
+            void run( std::stop_token stop );
             void process_stream( tcp_live_stream&& stream );
 
             transfer_queue_interface<tcp_live_stream>& m_queue;
-            std::thread m_thread;
-            std::atomic<bool> m_stop;
             stream_callback m_callback;
+            size_t m_n_workers;
+            std::atomic<bool> m_drain;
+            std::chrono::steady_clock::time_point m_drain_deadline;
+            std::atomic<bool> m_drain_cut_short;
+            histogram* m_offload_to_callback = nullptr;
+            histogram* m_callback_time = nullptr;
+            thread_placement m_placement;
+            // last, so the workers are joined before anything they use goes away
+            std::vector<std::jthread> m_workers;
     };
 
 } // namespace ntk
 
-#endif
\ No newline at end of file
+#endif
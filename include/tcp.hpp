@@ -5,18 +5,45 @@
 #include <cstring>
 
 #include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <memory>
 #include <vector>
 #include <map>
+#include <deque>
+#include <unordered_map>
 #include <unordered_set>
 #include <variant>
 #include <span>
 #include <iostream>
 #include <limits>
 #include <expected>
+#include <optional>
+#include <type_traits>
 
 #include <ipv4.hpp>
+#include <captured_packet.hpp>
+#include <checksum.hpp>
 #include <constants.hpp>
+#include <decoded_packet.hpp>
+#include <flow_index.hpp>
+#include <flow_key.hpp>
+#include <flow_metrics.hpp>
+#include <flow_table.hpp>
+#include <frame_arena.hpp>
+#include <generator.hpp>
+#include <instrumentation.hpp>
+#include <ipv4_reassembler.hpp>
+#include <link_layer.hpp>
+#include <packet_pool.hpp>
+#include <session_columns.hpp>
+#include <snapshot.hpp>
+#include <spill_file.hpp>
 #include <spmc_queue.hpp>
+#include <statistics.hpp>
+#include <stream_events.hpp>
+#include <tcp_reassembler.hpp>
+#include <timer_wheel.hpp>
 
 namespace ntk {
 
@@ -71,20 +98,6 @@ namespace ntk {
         }
     };
 
-    struct four_tuple { 
-        uint32_t client_ip;
-        uint32_t server_ip;
-        uint16_t client_port;
-        uint16_t server_port;
-
-        bool operator==( const four_tuple& other ) const {
-            return client_ip == other.client_ip &&
-                server_ip == other.server_ip &&
-                client_port == other.client_port &&
-                server_port == other.server_port;
-        }
-    };
-
     struct tcp_handshake {
         std::vector<uint8_t> syn;
         std::vector<uint8_t> syn_ack;
@@ -114,14 +127,30 @@ namespace ntk {
 
     tcp_header parse_tcp_header( const std::vector<uint8_t>& raw_tcp_header );
 
+    // the same without throwing, an error for fewer than 20 bytes or a data offset below 5
+    std::expected<tcp_header,std::string> try_parse_tcp_header( std::span<const uint8_t> raw_tcp_header );
+
     tcp_header get_tcp_header( const unsigned char* ethernet_frame );
 
     tcp_header get_tcp_header( const std::vector<uint8_t>& packet );
 
     bool is_non_overlapping_stream( const tcp_stream& stream );
 
+    // header and payload of one frame, nothing when it carries no payload
+    std::optional<raw_tcp_frame> extract_raw_tcp_frame( const unsigned char* packet_data );
+
     std::vector<raw_tcp_frame> extract_raw_tcp_stream( const session& tcp_session );
 
+    /*
+        the lazy counterparts below hold one element at a time and stop where the caller
+        stops. the session or index they read has to outlive the generator, a four_tuple is
+        taken by value as the generator keeps it
+    */
+    generator<raw_tcp_frame> generate_raw_tcp_stream( const session& tcp_session );
+
+    // sequence number and body of each frame with a well-formed header, in capture order rather than merged as get_tcp_stream does
+    generator<std::pair<uint32_t,std::vector<uint8_t>>> generate_tcp_segments( generator<raw_tcp_frame> raw_stream );
+
     raw_tcp_stream extract_tcp_stream( const session& tcp_session );
 
     tcp_stream parse_tcp_stream( const raw_tcp_stream& raw_stream );
@@ -142,39 +171,29 @@ namespace ntk {
 
     tcp_handshake get_handshake( const four_tuple& four, const session& packets );
 
+    // the flow_index overloads look at the flow's own packets only, the result is the same
+    tcp_handshake get_handshake( const four_tuple& four, const flow_index& index );
+
     std::vector<tcp_handshake> get_handshakes( const four_tuple& four, const session& packets );
 
-    class tcp_transfer {
-        public:
-            tcp_transfer( const four_tuple& four );
-            void load( const session& packet_data );
-        private:
-            void split_stream( const session& packet_data );
-        private:
-            tcp_handshake m_handshake;
-            tcp_termination m_termination;
-            std::vector<std::vector<uint8_t>> m_client_acks;
-            std::vector<std::vector<uint8_t>> m_server_acks;
-            std::vector<std::vector<uint8_t>> m_client_traffic;
-            std::vector<std::vector<uint8_t>> m_server_traffic;
-            
-            four_tuple m_four;
+    std::vector<tcp_handshake> get_handshakes( const four_tuple& four, const flow_index& index );
 
-            friend class tcp_transfer_friend_helper;
-    };
+    generator<tcp_handshake> generate_handshakes( four_tuple four, const session& packets );
+
+    generator<tcp_handshake> generate_handshakes( four_tuple four, const flow_index& index );
 
     struct tcp_handshake_feed { 
 
-        bool feed( const std::vector<uint8_t>& packet );
+        bool feed( const decoded_packet& packet );
     private:
-        bool feed_packet( const std::vector<uint8_t>& packet ); 
+        bool feed_packet( const decoded_packet& packet ); 
     public:
         void reset() {
             m_syn = m_syn_ack = m_ack = std::nullopt;
         }
 
         tcp_handshake_feed( const four_tuple& four ) 
-            : m_four( four ), m_complete( false ) {}
+            : m_four( four ), m_complete( false ), m_syn_seq_number( 0 ), m_syn_ack_seq_number( 0 ), m_syn_four( four ) {}
 
         four_tuple m_four;
         tcp_handshake m_handshake;
@@ -183,13 +202,18 @@ namespace ntk {
         std::optional<std::vector<uint8_t>> m_syn;
         std::optional<std::vector<uint8_t>> m_syn_ack;
         std::optional<std::vector<uint8_t>> m_ack;
+
+        // kept so matching the next step of the handshake needs no re-parse of the stored frame
+        uint32_t m_syn_seq_number;
+        uint32_t m_syn_ack_seq_number;
+        four_tuple m_syn_four;
     };
 
     struct tcp_termination_feed { 
     
-        bool feed( const std::vector<uint8_t>& packet );
+        bool feed( const decoded_packet& packet );
     private:
-        bool feed_packet( const std::vector<uint8_t>& packet );
+        bool feed_packet( const decoded_packet& packet );
     public:
         tcp_termination_feed( const four_tuple& four ) 
             : m_four( four ), m_fin_1_seq_number( std::numeric_limits<uint32_t>::max() ),
@@ -209,9 +233,72 @@ namespace ntk {
         uint32_t m_fin_2_seq_number;
     };
 
+    /*
+        capture timestamps of the milestones of a live stream, only streams fed with
+        captured_packet have them. the request and response are the first payloads
+        sent by the side that sent the syn and by the side that answered it
+    */
+    struct stream_timing {
+        std::optional<capture_time> first_packet;
+        std::optional<capture_time> last_packet;
+        std::optional<capture_time> syn;
+        std::optional<capture_time> syn_ack;
+        std::optional<capture_time> ack;
+        std::optional<capture_time> first_request;
+        std::optional<capture_time> first_response;
+        std::optional<capture_time> offloaded;     // wall-clock time the session handed the stream off
+    };
+
+    // why a stream left its session without a clean termination
+    enum class eviction_reason {
+        NONE,
+        IDLE,
+        LIFETIME,
+        MEMORY,
+        SHUTDOWN        // still open when the session was flushed
+    };
+
+    /*
+        what a live stream holds, frames are the traffic kept for the consumer and
+        reassembled is the in-order payload plus segments waiting on a gap. frames fed
+        through packet_view stay in their pool and are bounded by it, so they are not counted
+    */
+    struct stream_memory {
+        size_t frame_bytes = 0;
+        size_t reassembled_bytes = 0;
+        size_t spilled_bytes = 0;           // frames moved to the stream's spill_file
+        bool truncated = false;             // something was dropped to stay in budget
+
+        size_t in_memory() const { return frame_bytes + reassembled_bytes; }
+    };
+
+    /*
+        how much of a stream is stored. packets past the policy still move the handshake,
+        termination, timing and metrics() along and are then dropped, so what a flow
+        holds has a fixed bound
+    */
+    struct retention_policy {
+        enum class mode {
+            ALL,
+            HEADERS_ONLY,   // no frames or payload
+            FIRST_BYTES,    // payload up to bytes into each direction, frames until they add up to bytes per direction
+            LAST_BYTES      // the latest bytes of in-order payload per direction, no frames
+        };
+
+        mode kind = mode::ALL;
+        size_t bytes = 0;
+
+        static retention_policy all() { return {}; }
+        static retention_policy headers_only() { return { mode::HEADERS_ONLY, 0 }; }
+        static retention_policy first_bytes( size_t bytes ) { return { mode::FIRST_BYTES, bytes }; }
+        static retention_policy last_bytes( size_t bytes ) { return { mode::LAST_BYTES, bytes }; }
+    };
+
     class tcp_live_stream {
         public:
             tcp_live_stream( const four_tuple& four );
+            // the stream's frame_arena takes its blocks from upstream
+            tcp_live_stream( const four_tuple& four, std::pmr::memory_resource* upstream );
 
             tcp_live_stream( const tcp_live_stream& ) = default;
             tcp_live_stream( tcp_live_stream&& ) = default;
@@ -220,57 +307,196 @@ namespace ntk {
             bool operator==( const tcp_live_stream& other ) const;
 
             bool is_complete() const;
+            // set when the session gave up on the stream, is_complete() stays false
+            eviction_reason eviction() const;
             bool feed( const std::vector<uint8_t>& packet );
+            bool feed( std::span<const uint8_t> packet );
+            bool feed( const packet_view& packet );
+            bool feed( const captured_packet& packet );
             const four_tuple& get_four_tuple() const;
+            // as far as they were fed, the termination holds an empty fin_ack_fin_ack until one completes
+            const tcp_handshake& handshake() const;
+            const tcp_termination& termination() const;
+
+            const stream_timing& timing() const;
+            // syn to the ack that completes the handshake, as seen at the capture point
+            std::optional<std::chrono::nanoseconds> handshake_rtt() const;
+            // first request payload to first response payload
+            std::optional<std::chrono::nanoseconds> time_to_first_byte() const;
+            // capture of the last packet to the stream being offloaded
+            std::optional<std::chrono::nanoseconds> capture_to_offload_latency() const;
+            // packet, byte, retransmission and window counts per direction, kept even when no frames are
+            const flow_metrics& metrics() const;
+
+            // payload of each direction reassembled in sequence order, up to the first gap
+            std::span<const uint8_t> client_payload() const;
+            std::span<const uint8_t> server_payload() const;
+
+            stream_memory memory() const;
+            const retention_policy& retention() const;
+            // traffic written to disk over budget, its frames() are readable once offloaded
+            const spill_file* spilled_traffic() const;
 
             template<typename Predicate>
             bool traffic_contains( Predicate predicate ) const {
-                return std::any_of( m_traffic.begin(), m_traffic.end(), predicate );
+                // frames are spans, predicates written for vectors get a copy
+                auto matches = [&]( std::span<const uint8_t> packet ) {
+                    if constexpr ( std::is_invocable_v<Predicate&,std::span<const uint8_t>> ) {
+                        return static_cast<bool>( predicate( packet ) );
+                    } else {
+                        return static_cast<bool>( predicate( std::vector<uint8_t>( packet.begin(), packet.end() ) ) );
+                    }
+                };
+                if ( m_spill && m_spill->is_mapped() && std::any_of( m_spill->frames().begin(), m_spill->frames().end(), matches ) ) return true;
+                if ( std::any_of( m_traffic.begin(), m_traffic.end(), matches ) ) return true;
+                return std::any_of( m_pooled_traffic.begin(), m_pooled_traffic.end(), [&]( const packet_view& packet ) {
+                    if constexpr ( std::is_invocable_v<Predicate&,const packet_view&> ) {
+                        return static_cast<bool>( predicate( packet ) );
+                    } else {
+                        return static_cast<bool>( predicate( packet.to_vector() ) );
+                    }
+                });
+            }
+
+            // every frame held, in the order traffic_contains looks at them
+            template<typename Visitor>
+            void for_each_frame( Visitor visitor ) const {
+                if ( m_spill && m_spill->is_mapped() ) {
+                    for ( auto& frame : m_spill->frames() ) visitor( frame );
+                }
+                for ( auto& frame : m_traffic ) visitor( frame );
+                for ( auto& packet : m_pooled_traffic ) visitor( packet.bytes() );
             }
         private:
+            // the session has decoded the frame already, so the stream only decodes for direct callers
+            template<typename Packet>
+            bool feed_decoded( const decoded_packet& decoded, const Packet& packet );
+
+            bool feed_control( const decoded_packet& packet, bool& is_traffic );
+            void update_timing( const decoded_packet& packet, const capture_time& timestamp, bool is_traffic );
+            void update_reassembly( const decoded_packet& packet, bool is_traffic );
+            bool is_from_client( const decoded_packet& packet ) const;
+
+            // hands the payload the last packet completed to events, then forgets it when release is set
+            void deliver( stream_events& events, bool release );
+            // hands over everything reassembled so far, for a stream held back until it was classified
+            void deliver_held( stream_events& events, bool release );
+            // drops frames and payload held so far and keeps none from now on
+            void keep_headers_only();
+            // bounds what is kept from now on, what is held already is cut down to the policy
+            void retain( const retention_policy& policy );
+            // keeps sealed in-order payload and frames lz4 compressed until they are read, see tcp_reassembler::compress and frame_arena::compress
+            void compress_payload();
+
+            // moves the frames held so far to a new spill file, later frames are appended to it
+            bool spill( const std::filesystem::path& directory );
+            // stops keeping frames, or only payload when the frames go to disk anyway
+            void truncate();
+
+            // everything the stream holds, spilled frames included, for tcp_live_stream_session::checkpoint
+            void save( snapshot_writer& out ) const;
+            // spilled frames go to a new spill file in spill_directory, or stay in memory if none can be made
+            bool restore( snapshot_reader& in, const std::filesystem::path& spill_directory );
+
             tcp_handshake_feed m_handshake_feed;
             tcp_termination_feed m_termination_feed;
         protected:
-            std::vector<std::vector<uint8_t>> m_traffic;
+            frame_arena m_traffic;
+            // traffic fed through packet_view, kept in its packet_pool slot until the stream is dropped
+            std::vector<packet_view> m_pooled_traffic;
+            // frames spilled over budget, ahead of anything still in m_traffic; copies share the file
+            std::shared_ptr<spill_file> m_spill;
         private:
             four_tuple m_four;
-
+            stream_timing m_timing;
+            flow_metrics m_metrics;
+            eviction_reason m_eviction = eviction_reason::NONE;
+
+            tcp_reassembler m_client_reassembler;
+            tcp_reassembler m_server_reassembler;
+
+            bool m_frames_truncated = false;
+            bool m_payload_truncated = false;
+            // off when the session streams events and has no queue to hand the frames to
+            bool m_store_frames = true;
+            // set once the session's flow_classifier has decided, or straight away without one
+            bool m_classified = true;
+            bool m_headers_only = false;
+            retention_policy m_retention;
+            // frames stored per direction, for retention_policy::mode::FIRST_BYTES
+            size_t m_client_frame_bytes = 0;
+            size_t m_server_frame_bytes = 0;
+
+            // in-order payload the last packet added, for stream_events::on_data
+            struct delivery {
+                stream_direction direction = stream_direction::CLIENT_TO_SERVER;
+                size_t bytes = 0;
+            };
+            delivery m_delivery;
+
+            friend class tcp_live_stream_session;
             friend class tcp_live_stream_friend_helper;
+            friend class tcp_transfer;
 
             friend std::ostream& operator<<( std::ostream& os, const tcp_live_stream& live_stream );
             friend void output_stream_to_file( const std::string& filename, const tcp_live_stream& live_stream );
     };
 
+    /*
+        one connection of a session, each side's data and acks between handshake and termination
+
+        load() replays the session through the live engine ( see replay_stream ) and reads
+        the handshake, termination and frames off the stream it offloads, so offline and
+        live analysis of the same traffic agree
+    */
+    class tcp_transfer {
+        public:
+            tcp_transfer( const four_tuple& four );
+            void load( const session& packet_data );
+            // the replayed connection, nullopt before load() or when the session does not have it
+            const std::optional<tcp_live_stream>& stream() const;
+        private:
+            void split_stream( const tcp_live_stream& stream );
+        private:
+            tcp_handshake m_handshake;
+            tcp_termination m_termination;
+            std::vector<std::vector<uint8_t>> m_client_acks;
+            std::vector<std::vector<uint8_t>> m_server_acks;
+            std::vector<std::vector<uint8_t>> m_client_traffic;
+            std::vector<std::vector<uint8_t>> m_server_traffic;
+            std::optional<tcp_live_stream> m_stream;
+            
+            four_tuple m_four;
+
+            friend class tcp_transfer_friend_helper;
+    };
+
     four_tuple get_four_from_ethernet( const unsigned char* packet );
 
     four_tuple get_four_from_ethernet( const std::vector<uint8_t>& packet );
 
     four_tuple flip_four( const four_tuple& four );
 
-} // namespace ntk
+    std::unordered_set<four_tuple> get_four_tuples( const session& packets );
 
-namespace std {
+    // tcp flows only, as the index skips anything else
+    std::unordered_set<four_tuple> get_four_tuples( const flow_index& index );
 
-    template <>
-    struct hash<ntk::four_tuple> {
-        size_t operator()( const ntk::four_tuple& ft ) const noexcept {
-            size_t h1 = hash<uint32_t>{}( ft.client_ip );
-            size_t h2 = hash<uint32_t>{}( ft.server_ip );
-            size_t h3 = hash<uint16_t>{}( ft.client_port );
-            size_t h4 = hash<uint16_t>{}( ft.server_port );
-            return h1 ^ ( h2 << 1 ) ^ ( h3 << 2 ) ^ ( h4 << 3 ); 
-        }
-    };
+    // as sent by each flow's first row
+    std::unordered_set<four_tuple> get_four_tuples( const session_columns& columns );
 
-} // namespace std
+    tcp_termination get_termination( const four_tuple& four, const session& packets );
 
-namespace ntk {
+    tcp_termination get_termination( const four_tuple& four, const flow_index& index );
 
-    std::unordered_set<four_tuple> get_four_tuples( const session& packets );
+    std::vector<tcp_termination> get_terminations( const four_tuple& four, const session& packets );
 
-    tcp_termination get_termination( const four_tuple& four, const session& packets );
+    std::vector<tcp_termination> get_terminations( const four_tuple& four, const flow_index& index );
 
-    std::vector<tcp_termination> get_terminations( const four_tuple& four, const session& packets );
+    // in get_terminations' order, the flow is read a second time for its resets
+    generator<tcp_termination> generate_terminations( four_tuple four, const session& packets );
+
+    generator<tcp_termination> generate_terminations( four_tuple four, const flow_index& index );
 
     class tcp_transfer_friend_helper {
         public:
@@ -287,7 +513,8 @@ namespace ntk {
         public:
             static const tcp_handshake_feed& handshake_feed( const tcp_live_stream& t );
             static const tcp_termination_feed& termination_feed( const tcp_live_stream& t );
-            static const std::vector<std::vector<uint8_t>>& traffic( const tcp_live_stream& t );
+            static const frame_arena& traffic( const tcp_live_stream& t );
+            static const std::vector<packet_view>& pooled_traffic( const tcp_live_stream& t );
             static const four_tuple& four( const tcp_live_stream& t );
     };
 
@@ -307,20 +534,213 @@ namespace ntk {
 
     bool is_syn( const std::vector<uint8_t>& packet );
 
+    struct session_statistics {
+        uint64_t packets_fed;
+        uint64_t packets_unmatched;     // accepted by no live stream, e.g. before a handshake or after completion
+        uint64_t streams_offloaded;
+        uint64_t streams_evicted;       // given up on by the limits, offloaded too when there is a queue
+        uint64_t bytes_in_memory;       // held by the live streams right now, see stream_memory
+        uint64_t bytes_spilled;
+        uint64_t streams_dropped;       // turned away by the flow_classifier, only their flow_key is kept
+    };
+
+    enum class overflow_policy {
+        SPILL,          // write the frames to a spill_file, drop payload only if it alone is over budget
+        TRUNCATE        // keep what is held and drop the rest
+    };
+
+    /*
+        bounds on how long a live stream is kept and how much it may hold, zero disables
+        a limit. time is capture time so only streams fed with captured_packet expire.
+        a stream over max_flow_bytes gets the overflow policy, over max_session_bytes
+        the largest streams are spilled and, if that is not enough, evicted
+    */
+    struct session_limits {
+        std::chrono::nanoseconds idle_timeout{ 0 };     // since the stream's last packet
+        std::chrono::nanoseconds max_lifetime{ 0 };     // since the stream's first packet
+
+        size_t max_flow_bytes = 0;
+        size_t max_session_bytes = 0;
+        overflow_policy on_overflow = overflow_policy::SPILL;
+        // the system temporary directory when empty
+        std::filesystem::path spill_directory;
+
+        // where the streams' frame_arena blocks come from, the default resource when null
+        std::pmr::memory_resource* frame_upstream = nullptr;
+
+        // for the ipv4 fragments held until their datagram is whole and fed in their place
+        fragment_limits fragments;
+
+        // of the frames fed, e.g. to_link_type( capture_file::datalink() )
+        link_type link = link_type::ETHERNET;
+
+        /*
+            drops frames whose ipv4 header or tcp checksum is wrong before they reach a
+            stream, where a corrupt byte would only show up later as a tag failure in
+            decrypt_aes_gcm. checksums left to the nic by offload are let through
+        */
+        bool verify_checksums = false;
+
+        /*
+            streams keep no frames or payload from their first packet, only handshake,
+            termination, timing and metrics(), so many more flows fit in the same memory.
+            the flow_classifier is not asked as there is no payload to decide on
+        */
+        bool metrics_only = false;
+
+        /*
+            in-order payload a stream holds is lz4 compressed a block at a time once more
+            has arrived behind it, and inflated the first time client_payload() or
+            server_payload() is read, e.g. after the stream was offloaded. the stored frames
+            carry the same payload and are sealed the same way, until the frames are first
+            read. memory() counts both compressed. pays off for plaintext protocols,
+            encrypted payload is kept as it is. frames held in a packet_pool slot or spilled
+            to disk are not compressed
+        */
+        bool compress_payload = false;
+
+        // tombstones of flows the classifier dropped held at once, the oldest gives way to a new one
+        size_t max_dropped_flows = 65536;
+
+        // what every stream stores from its first packet
+        retention_policy retention;
+        // what streams the flow_classifier answers flow_verdict::RETAIN for store
+        retention_policy classified_retention;
+    };
+
+    enum class flow_verdict {
+        UNDECIDED,      // ask again when more client payload has arrived
+        KEEP,
+        DROP,           // forget the stream, later packets of the flow are ignored while it goes on
+        HEADERS_ONLY,   // follow handshake, termination and timing but keep no frames or payload
+        RETAIN          // keep what session_limits::classified_retention allows, everything for a udp flow
+    };
+
+    /*
+        asked by the session when a stream's first client payload has been reassembled,
+        and again on every later packet while it answers UNDECIDED. nothing about the
+        stream is reported to stream_events until it has been decided
+    */
+    using flow_classifier = std::function<flow_verdict( const tcp_live_stream& stream )>;
+
+    struct flow_memory_usage {
+        four_tuple four;
+        stream_memory memory;
+    };
+
     class tcp_live_stream_session { 
 
         public:
             tcp_live_stream_session();
             tcp_live_stream_session( transfer_queue_interface<tcp_live_stream>* offload_queue );
+            tcp_live_stream_session( transfer_queue_interface<tcp_live_stream>* offload_queue, const session_limits& limits );
+            /*
+                streams progress to events as well as, or with a null queue instead of, the
+                queue. without a queue nothing already delivered is kept, payload is released
+                after on_data and frames are not stored, and a closed stream leaves at once
+            */
+            tcp_live_stream_session( transfer_queue_interface<tcp_live_stream>* offload_queue, stream_events* events, const session_limits& limits = session_limits{} );
             void feed( const std::vector<uint8_t>& packet );
+            void feed( const packet_view& packet );
+            // copies what it keeps, so the span only has to outlive the call, e.g. a capture_file packet
+            void feed( std::span<const uint8_t> packet );
+            // like the vector overload, but the streams also record when things happened
+            void feed( const captured_packet& packet );
+            // expires streams up to now without a packet, e.g. from a timer while the link is quiet
+            void advance_time( capture_time now );
             size_t number_of_completed_transfers();
+            // safe to call from any thread while the feeding thread runs
+            session_statistics statistics() const;
+            // of the ipv4 fragments put back together in front of the streams, from any thread too
+            fragment_statistics fragments() const;
+            // of the frames checked when session_limits::verify_checksums is set, from any thread too
+            checksum_statistics checksums() const;
+            // one entry per live stream, from the feeding thread only
+            std::vector<flow_memory_usage> memory_usage() const;
+            // applies to streams opened from now on, set it before the first packet
+            void set_classifier( flow_classifier classifier );
+            /*
+                offloads every stream that is still open, marked with eviction_reason::SHUTDOWN,
+                so nothing fed so far is lost when capture stops. returns how many there were
+            */
+            size_t flush();
+            /*
+                writes every live stream to a snapshot at filename, with its handshake and
+                termination progress, reassembly, metrics and frames, plus the flows dropped
+                by the classifier and the counters. from the feeding thread, e.g. before a
+                restart or an upgrade. returns the number of streams written
+            */
+            std::expected<size_t,std::string> checkpoint( const std::string& filename ) const;
+            /*
+                carries on from a checkpoint(), before the first packet is fed. the streams
+                pick up with the next packet of their flow, so a tls stream whose handshake
+                was seen before the restart can still be decrypted. ipv4 fragments waiting
+                on the rest of their datagram are not in the snapshot
+            */
+            std::expected<size_t,std::string> restore( const std::string& filename );
+            // records capture to offload latency and exports the memory gauge, label e.g. shard="0"
+            void instrument( metrics_registry& registry, const std::string& label = "" );
         private:
-            void offload( tcp_live_stream&& stream );
+            template<typename Packet>
+            void feed_packet( const Packet& packet );
 
-            std::vector<tcp_live_stream> m_live_streams;
-            std::unordered_set<four_tuple> m_four_tuples;
+            void offload( tcp_live_stream&& stream );
+            void close( const flow_key& key, close_reason reason );
+            // reports a stream held back by the classifier, with everything it has reassembled
+            void open( tcp_live_stream& stream );
+            void drop( const flow_key& key, const stream_memory& held, std::optional<capture_time> now );
+            std::optional<capture_time> tombstone_deadline( capture_time now ) const;
+
+            void schedule_expiry( const flow_key& key, const tcp_live_stream& stream );
+            void expire( const flow_key& key, capture_time now );
+            void evict( const flow_key& key, eviction_reason reason );
+
+            void account( const stream_memory& before, const stream_memory& after );
+            void enforce_budget( tcp_live_stream& stream );
+            bool shed( tcp_live_stream& stream );
+            std::filesystem::path spill_directory() const;
+
+            // live streams by their direction-independent flow_key, completed ones leave in O(1)
+            flow_table<flow_key,tcp_live_stream,flow_key_hash> m_live_streams;
+            /*
+                flows the classifier dropped, whose later packets are ignored. a tombstone goes
+                once its flow has been quiet for the idle timeout, or the lifetime without one,
+                and the oldest gives way beyond session_limits::max_dropped_flows. any other
+                flow leaves no trace, a later packet on its 4-tuple starts a new stream
+            */
+            struct tombstone {
+                std::optional<capture_time> expires;
+                // matches its entry in m_tombstone_order, an older entry for the same flow is stale
+                uint64_t placed = 0;
+            };
+            std::unordered_map<flow_key,tombstone,flow_key_hash> m_tombstones;
+            // oldest first
+            std::deque<std::pair<flow_key,uint64_t>> m_tombstone_order;
+            uint64_t m_tombstones_placed = 0;
 
             transfer_queue_interface<tcp_live_stream>* m_offload_queue;
+            stream_events* m_events = nullptr;
+            flow_classifier m_classifier;
+
+            session_limits m_limits;
+            timer_wheel<flow_key> m_expiry_timers;
+            ipv4_reassembler m_fragments;
+            // picked once from the limits, the packet path calls straight into its decoder
+            link_layer m_link = link_layer_of<ethernet_link>();
+
+            relaxed_counter m_packets_fed;
+            relaxed_counter m_packets_unmatched;
+            relaxed_counter m_streams_offloaded;
+            relaxed_counter m_streams_evicted;
+            relaxed_counter m_streams_dropped;
+            checksum_counters m_checksums;
+
+            // the sum of every live stream's stream_memory::in_memory()
+            size_t m_bytes_in_memory = 0;
+            relaxed_counter m_bytes_in_memory_gauge;
+            relaxed_counter m_bytes_spilled;
+
+            histogram* m_capture_to_offload = nullptr;
 
             friend class tcp_live_stream_session_friend_helper;
     }; 
@@ -328,8 +748,8 @@ namespace ntk {
     class tcp_live_stream_session_friend_helper {
         public:
             static const tcp_live_stream& get_live_stream( const tcp_live_stream_session& t, const four_tuple& four );
-            static const std::vector<tcp_live_stream>& live_streams( const tcp_live_stream_session& t );
-            static const std::unordered_set<four_tuple>& four_tuples( const tcp_live_stream_session& t );
+            static const flow_table<flow_key,tcp_live_stream,flow_key_hash>& live_streams( const tcp_live_stream_session& t );
+            static size_t tombstones( const tcp_live_stream_session& t );
     };
 
     bool is_valid_handshake( const tcp_handshake& handshake );
@@ -350,6 +770,12 @@ namespace ntk {
 
     std::vector<std::vector<uint8_t>> extract_payloads( const four_tuple& four, const std::vector<std::vector<uint8_t>>& packets );
 
+    std::vector<std::vector<uint8_t>> extract_payloads( const four_tuple& four, const flow_index& index );
+
+    generator<std::vector<uint8_t>> generate_payloads( four_tuple four, const session& packets );
+
+    generator<std::vector<uint8_t>> generate_payloads( four_tuple four, const flow_index& index );
+
     std::expected<std::vector<std::vector<uint8_t>>,std::string> extract_client_packets( const session& packets );
 
     std::expected<std::vector<std::vector<uint8_t>>,std::string> extract_server_packets( const session& packets ); 
@@ -361,6 +787,8 @@ namespace ntk {
 
     std::expected<client_server_payloads,std::string> split_payloads( const session& packets );
 
+    std::expected<client_server_payloads,std::string> split_payloads( const flow_index& index );
+
 } // namespace ntk
 
 #endif
\ No newline at end of file
@@ -0,0 +1,120 @@
+#ifndef TCP_REASSEMBLER_HPP
+#define TCP_REASSEMBLER_HPP
+
+#include <span>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <snapshot.hpp>
+
+namespace ntk {
+
+    // true when sequence number a comes before b, correct across the 2^32 wrap ( RFC 1982 )
+    inline bool seq_before( uint32_t a, uint32_t b ) {
+        return static_cast<int32_t>( a - b ) < 0;
+    }
+
+    /*
+        rebuilds one direction of a tcp connection into a contiguous byte stream
+
+        in-order payload is appended to a growable buffer as it arrives, segments from
+        beyond the next expected sequence number wait in a short list kept in sequence
+        order and are pulled in once the gap closes. retransmissions and overlaps are
+        trimmed against what is already held, every comparison is made relative to the
+        next expected sequence number so a wrap of the sequence space is harmless
+
+        with compress() on, in-order payload is sealed a block at a time once a whole block
+        sits ahead of the latest segment and kept lz4 compressed, a block that does not
+        shrink is kept as it is. contiguous() inflates the sealed blocks back the first time
+        the payload is read, e.g. by the consumer of an offloaded stream
+    */
+    class tcp_reassembler {
+
+        public:
+            // segments further ahead than this are dropped rather than held
+            static constexpr uint32_t max_window = 1u << 30;
+            static constexpr size_t max_pending_segments = 256;
+            static constexpr size_t default_block_size = 64 * 1024;
+
+            tcp_reassembler();
+
+            // the sequence number of the first payload byte, e.g. the syn's plus one
+            void start( uint32_t initial_seq );
+            bool started() const;
+            // forgets everything until the next start(), the keep_first / keep_last bounds stay
+            void reset();
+
+            // returns the number of bytes appended to the in-order stream
+            size_t add( uint32_t seq, std::span<const uint8_t> payload );
+
+            // inflates whatever was sealed, the payload stays uncompressed from then on until more is sealed
+            std::span<const uint8_t> contiguous() const;
+            // the end of contiguous(), at least what the last add() appended is there without inflating anything
+            std::span<const uint8_t> recent( size_t bytes ) const;
+            // of contiguous(), without inflating it
+            size_t size() const;
+            // what the in-order payload takes in memory, sealed blocks as they are stored
+            size_t stored_bytes() const;
+            // forgets the in-order bytes held so far, e.g. once they were handed to a consumer
+            void release();
+            uint32_t next_seq() const;
+
+            // only the first bytes of the stream are kept, payload past them is dropped on arrival
+            void keep_first( size_t bytes );
+            // only the latest bytes of in-order payload are kept, contiguous() is at most that long
+            void keep_last( size_t bytes );
+            // seals in-order payload in blocks of block_size, zero inflates what is sealed and stops.
+            // nothing is sealed under keep_last, which bounds the payload already
+            void compress( size_t block_size = default_block_size );
+
+            size_t pending_segments() const;
+            size_t pending_bytes() const;
+
+            // everything including the held segments and bounds, for checkpointing a session
+            void save( snapshot_writer& out ) const;
+            bool restore( snapshot_reader& in );
+        private:
+            struct segment {
+                uint32_t seq;
+                std::vector<uint8_t> data;
+            };
+
+            size_t append( uint32_t seq, std::span<const uint8_t> payload );
+            void hold( uint32_t seq, std::span<const uint8_t> payload );
+            size_t drain();
+            // compresses whole blocks off the front of m_data
+            void seal();
+            // writes the sealed blocks out inflated, into is m_sealed_size long
+            void inflate( std::span<uint8_t> into ) const;
+            // puts the sealed blocks back in front of m_data
+            void unseal() const;
+
+            struct sealed_block {
+                std::vector<uint8_t> bytes;
+                size_t size;            // inflated
+                bool compressed;
+            };
+
+            // sealed payload comes ahead of m_data. both change under contiguous(), which inflates
+            mutable std::vector<sealed_block> m_sealed;
+            mutable std::vector<uint8_t> m_data;
+            mutable size_t m_sealed_size;
+            mutable size_t m_sealed_stored;
+            std::vector<segment> m_pending;
+            uint32_t m_initial_seq;
+            uint32_t m_next_seq;
+            // kept running, the session asks for it on every packet to account memory
+            size_t m_pending_bytes;
+            bool m_started;
+            // zero when unbounded
+            size_t m_keep_first;
+            size_t m_keep_last;
+            // zero when payload is not compressed
+            size_t m_block_size;
+    };
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef TCP_REPLAY_HPP
+#define TCP_REPLAY_HPP
+
+#include <expected>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <tcp.hpp>
+
+namespace ntk {
+
+    /*
+        offline analysis through the live engine
+
+        the packets are fed to a tcp_live_stream_session as fast as it takes them, and the
+        streams it offloads, completed ones as they complete and the rest when it is
+        flushed at the end, are returned in that order. they are the streams a live
+        capture of the same traffic gives, so whatever the session does on its hot path
+        offline analysis does as well
+    */
+    std::vector<tcp_live_stream> replay_streams( const session& packets, const session_limits& limits = {} );
+
+    // a capture read in place rather than loaded, pcap timestamps go with each packet and the link type is the file's
+    std::expected<std::vector<tcp_live_stream>,std::string> replay_streams( const std::string& filename, const session_limits& limits = {} );
+
+    // the connection of four in either direction, the other streams are let go of as they are offloaded
+    std::optional<tcp_live_stream> replay_stream( const four_tuple& four, const session& packets, const session_limits& limits = {} );
+
+} // namespace ntk
+
+#endif
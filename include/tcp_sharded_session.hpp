@@ -0,0 +1,144 @@
+#ifndef TCP_SHARDED_SESSION_HPP
+#define TCP_SHARDED_SESSION_HPP
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <span>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <captured_packet.hpp>
+#include <flow_key.hpp>
+#include <ipv4_reassembler.hpp>
+#include <link_layer.hpp>
+#include <packet_pool.hpp>
+#include <ring_buffer.hpp>
+#include <spmc_queue.hpp>
+#include <tcp.hpp>
+#include <thread_placement.hpp>
+
+namespace ntk {
+
+    /*
+        hash of a four_tuple that is the same for both directions of a flow,
+        so four and flip_four( four ) always land on the same shard
+    */
+    size_t symmetric_flow_hash( const four_tuple& four );
+
+    /*
+        how frames are spread over the shards
+
+        FLOW_KEY is flow_key_hash modulo the shard count. TOEPLITZ reproduces the RSS
+        queue choice of a NIC programmed with symmetric_rss_key and the default
+        indirection table, so with one shard per receive queue every flow is handled
+        by the shard whose queue received it
+    */
+    enum class shard_hash {
+        FLOW_KEY,
+        TOEPLITZ
+    };
+
+    /*
+        front-end that spreads frames over n_shards worker threads
+
+        each frame is decoded with the link layer of session_limits::link and routed by
+        its shard_hash into a per-shard SPSC ring, every worker owns its own
+        tcp_live_stream_session so per-flow state is never shared between threads. a
+        frame that does not decode, e.g. arp, goes to the first shard, which counts it as
+        unmatched. completed streams from all shards go to the one offload queue, which
+        must therefore accept pushes from several threads. ipv4 fragments are
+        reassembled before routing, as only the first one has ports.
+
+        feed() must be called from a single thread, it is the producer of every ring
+    */
+    class tcp_sharded_session {
+
+        public:
+            static constexpr size_t shard_ring_size = 4096;
+
+            tcp_sharded_session( size_t n_shards );
+            tcp_sharded_session( size_t n_shards, transfer_queue_interface<tcp_live_stream>* offload_queue,
+                                 shard_hash hash = shard_hash::FLOW_KEY );
+            // every shard's session runs with limits, e.g. timeouts, link type and retention. budgets hold per shard
+            tcp_sharded_session( size_t n_shards, transfer_queue_interface<tcp_live_stream>* offload_queue, const session_limits& limits,
+                                 shard_hash hash = shard_hash::FLOW_KEY );
+            ~tcp_sharded_session();
+
+            tcp_sharded_session( const tcp_sharded_session& ) = delete;
+            tcp_sharded_session& operator=( const tcp_sharded_session& ) = delete;
+
+            void feed( const std::vector<uint8_t>& packet );
+            void feed( const packet_view& packet );
+            void feed( captured_packet packet );
+
+            // drains every ring and joins the workers, the shards may be inspected afterwards
+            void stop();
+            // stop(), then flushes every shard's open streams, returns how many there were
+            size_t flush();
+
+            size_t number_of_shards() const;
+            // what every frame fed is decoded as, session_limits::link
+            link_type link() const;
+            size_t shard_of( const four_tuple& four ) const;
+
+            // only meaningful once stop() has returned
+            size_t number_of_completed_transfers();
+
+            // counters of every shard summed, readable while the workers run
+            session_statistics statistics() const;
+            fragment_statistics fragments() const;
+
+            // every shard gets a copy, called from the workers at once, set it before the first feed()
+            void set_classifier( const flow_classifier& classifier );
+            // every shard's session, and each ring's occupancy as ntk_shard_ring_occupancy{shard="i"}
+            void instrument( metrics_registry& registry );
+            /*
+                shard i runs with placements[ i % size ], its ring and session are moved to
+                the placement's numa node, e.g. a near_device() placement for every shard
+            */
+            void place_workers( const std::vector<thread_placement>& placements );
+
+            // a full ring makes feed() retry, every retry counts as a push failure
+            ring_statistics shard_ring_statistics( size_t shard_index ) const;
+        private:
+            using shard_packet = std::variant<std::vector<uint8_t>,packet_view,captured_packet>;
+
+            struct shard {
+                shard( transfer_queue_interface<tcp_live_stream>* offload_queue, const session_limits& limits );
+
+                ring_buffer<shard_packet,shard_ring_size> ring;
+                tcp_live_stream_session session;
+                std::thread worker;
+            };
+
+            // nothing for an ipv4 fragment, which is held until its datagram is whole and fed in its place
+            std::optional<size_t> route( std::span<const uint8_t> frame, std::optional<capture_time> now );
+            void dispatch( size_t shard_index, shard_packet&& packet );
+            void reassemble( std::span<const uint8_t> frame, std::optional<capture_time> now, size_t ip_offset );
+            void run_shard( shard& s );
+
+            shard_hash m_hash;
+            toeplitz_hasher m_toeplitz;
+            link_layer m_link;
+            // on the feeding thread, the datagram a fragment completes is routed like any frame
+            ipv4_reassembler m_fragments;
+
+            std::vector<std::unique_ptr<shard>> m_shards;
+            std::atomic<bool> m_stop;
+
+            friend class tcp_sharded_session_friend_helper;
+    };
+
+    class tcp_sharded_session_friend_helper {
+        public:
+            static const tcp_live_stream_session& shard_session( const tcp_sharded_session& t, size_t shard_index );
+    };
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef THREAD_PLACEMENT_HPP
+#define THREAD_PLACEMENT_HPP
+
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+
+namespace ntk {
+
+    /*
+        where a thread of the pipeline runs and where the memory it sets up lives
+
+        the usual placement keeps the capture thread, the session workers and the rings
+        between them on the socket the NIC hangs off, near_device() looks that up. on
+        platforms without affinity or NUMA policies placements are reported and ignored
+    */
+    struct thread_placement {
+        std::vector<unsigned> cpus;     // empty leaves the thread wherever the OS puts it
+        int numa_node = -1;             // -1 for no preference
+
+        bool empty() const { return cpus.empty() && numa_node < 0; }
+
+        static thread_placement on_cpus( std::vector<unsigned> cpus );
+        // every cpu of the node, with memory bound to it
+        static thread_placement on_node( int node );
+        // the node of a network device, empty when the system does not say, e.g. a virtual device
+        static thread_placement near_device( const std::string& device );
+    };
+
+    // the calling thread
+    bool apply_placement( const thread_placement& placement );
+    bool apply_placement( std::thread& thread, const thread_placement& placement );
+
+    std::optional<int> numa_node_of_device( const std::string& device );
+    std::vector<unsigned> cpus_of_numa_node( int node );
+    // the numbers in a sysfs cpu list, e.g. "0-3,8,10-11"
+    std::vector<unsigned> parse_cpu_list( const std::string& list );
+
+    /*
+        prefers node for the pages of [ address, address + size ), pages not touched yet
+        are allocated there and, with move set, ones already in memory migrate to it
+    */
+    bool bind_memory_to_node( const void* address, size_t size, int node, bool move = true );
+
+} // namespace ntk
+
+#endif
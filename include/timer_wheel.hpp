@@ -0,0 +1,148 @@
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <captured_packet.hpp>
+
+namespace ntk {
+
+    /*
+        hierarchical timer wheel over capture time
+
+        four levels of 64 slots, level n slots are 64^n ticks wide, so with the default
+        one millisecond tick deadlines up to about 4.6 hours away are placed exactly and
+        anything further is parked in the last slot and placed again when it comes up.
+        scheduling is O(1), advancing costs one slot per elapsed tick plus a cascade
+        every 64 ticks. timers cannot be cancelled, the owner checks on expiry whether
+        the deadline still holds and schedules again if not
+    */
+    template<typename Id>
+    class timer_wheel {
+
+        public:
+            static constexpr size_t slot_bits = 6;
+            static constexpr size_t slots_per_level = 1 << slot_bits;
+            static constexpr size_t levels = 4;
+
+            timer_wheel( std::chrono::nanoseconds tick = std::chrono::milliseconds( 1 ) )
+                : m_tick( tick ), m_now( 0 ), m_size( 0 ) {}
+
+            void schedule( const Id& id, capture_time deadline ) {
+                if ( !m_origin ) m_origin = deadline;
+                // the current tick has been visited already
+                place( entry{ id, to_tick( deadline ) }, m_now + 1 );
+                ++m_size;
+            }
+
+            // moves the wheel up to now and calls expired( id ) for every timer due by then
+            template<typename Expired>
+            void advance( capture_time now, Expired&& expired ) {
+
+                if ( !m_origin ) return;
+
+                uint64_t target = to_tick( now );
+
+                // nothing to visit on the way, e.g. a quiet capture
+                if ( m_size == 0 ) {
+                    if ( target > m_now ) m_now = target;
+                    return;
+                }
+
+                while ( m_now < target ) {
+
+                    ++m_now;
+
+                    // every 64 ticks the next slot of the level above is spread over the levels below,
+                    // highest level first so what it hands down is cascaded again on the same tick
+                    size_t top = 0;
+                    while ( top + 1 < levels && !( m_now & ( ( uint64_t( 1 ) << ( slot_bits * ( top + 1 ) ) ) - 1 ) ) ) ++top;
+                    for ( size_t level = top; level >= 1; --level ) cascade( level );
+
+                    auto& due = m_wheels[ 0 ][ m_now & ( slots_per_level - 1 ) ];
+                    if ( due.empty() ) continue;
+
+                    auto fired = std::move( due );
+                    due.clear();
+
+                    for ( auto& e : fired ) {
+                        if ( e.deadline > m_now ) {
+                            // parked beyond the wheel's span, not due yet
+                            place( e, m_now + 1 );
+                            continue;
+                        }
+                        --m_size;
+                        expired( e.id );
+                    }
+
+                    if ( m_size == 0 ) {
+                        m_now = target;
+                        break;
+                    }
+                }
+            }
+
+            size_t size() const {
+                return m_size;
+            }
+
+            bool empty() const {
+                return m_size == 0;
+            }
+        private:
+            struct entry {
+                Id id;
+                uint64_t deadline;
+            };
+
+            uint64_t to_tick( capture_time t ) const {
+                if ( t <= *m_origin ) return 0;
+                return static_cast<uint64_t>( ( t - *m_origin ) / m_tick );
+            }
+
+            // earliest is the first tick still to be visited, anything already due fires then
+            void place( const entry& e, uint64_t earliest ) {
+
+                uint64_t deadline = std::max( e.deadline, earliest );
+                uint64_t delta = deadline - m_now;
+
+                for ( size_t level = 0; level < levels; ++level ) {
+                    if ( delta < ( uint64_t( 1 ) << ( slot_bits * ( level + 1 ) ) ) ) {
+                        size_t slot = ( deadline >> ( slot_bits * level ) ) & ( slots_per_level - 1 );
+                        m_wheels[ level ][ slot ].push_back( entry{ e.id, deadline } );
+                        return;
+                    }
+                }
+
+                // beyond the span, park in the top slot just cascaded, which comes round last
+                size_t slot = ( m_now >> ( slot_bits * ( levels - 1 ) ) ) & ( slots_per_level - 1 );
+                m_wheels[ levels - 1 ][ slot ].push_back( e );
+            }
+
+            void cascade( size_t level ) {
+                auto& slot = m_wheels[ level ][ ( m_now >> ( slot_bits * level ) ) & ( slots_per_level - 1 ) ];
+                auto moving = std::move( slot );
+                slot.clear();
+                // called before the current tick's slot is visited, so it may still take entries
+                for ( auto& e : moving ) place( e, m_now );
+            }
+
+            std::chrono::nanoseconds m_tick;
+            std::optional<capture_time> m_origin;
+            uint64_t m_now;
+            size_t m_size;
+
+            std::array<std::array<std::vector<entry>,slots_per_level>,levels> m_wheels;
+    };
+
+} // namespace ntk
+
+#endif
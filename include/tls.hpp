@@ -4,9 +4,11 @@
 #include <array>
 #include <map>
 #include <vector>
+#include <optional>
 #include <ranges>
 #include <span>
 #include <string>
+#include <string_view>
 #include <expected>
 #include <fstream>
 #include <sstream>
@@ -22,6 +24,7 @@
 #include <openssl/evp.h>
 #include <openssl/kdf.h>
 
+#include <key_log_store.hpp>
 #include <tcp.hpp>
 
 namespace ntk {
@@ -66,6 +69,64 @@ namespace ntk {
         std::vector<uint8_t> payload;
     };
 
+    // a record inside a buffer someone else owns, valid until that buffer is written to
+    struct tls_record_view {
+        tls_content_type content_type;
+        uint16_t version;
+        std::span<const uint8_t> payload;
+
+        tls_record to_record() const;
+    };
+
+    /*
+        frames tls records out of one direction of a reassembled byte stream
+
+        all that is kept between calls is the offset of the next record header, so
+        the stream can keep growing, and moving, between calls and a record that
+        spans many segments is read once when its last byte is in. pass the whole
+        stream from its first byte each time, e.g. tcp_live_stream::server_payload(),
+        and reset() after the stream's buffer was released
+    */
+    class tls_record_framer {
+
+        public:
+            tls_record_framer();
+
+            // the next complete record, nullopt until all of it is in the stream
+            std::optional<tls_record_view> next( std::span<const uint8_t> stream );
+
+            size_t offset() const;
+            // part of a record past the offset is waiting for the rest
+            bool has_remainder( std::span<const uint8_t> stream ) const;
+            void reset();
+        private:
+            size_t m_offset;
+    };
+
+    /*
+        walks the handshake messages in the plaintext of handshake records
+
+        a message, or only its 4 byte header, may go on in the next record. the part of
+        a header that was in the last record is kept and completed from the next, the
+        body of a message is skipped whatever records it spans
+    */
+    class tls_handshake_walker {
+
+        public:
+            tls_handshake_walker();
+
+            // the content of the next handshake record, what was left of the last is dropped
+            void feed( std::span<const uint8_t> content );
+            // the type of the next message whose header is complete in it, nullopt once it is walked
+            std::optional<uint8_t> next();
+            void reset();
+        private:
+            std::span<const uint8_t> m_content;
+            size_t m_skip;                      // body bytes of the last message not walked yet
+            std::array<uint8_t,4> m_header;
+            size_t m_header_size;
+    };
+
     struct tls_record_extraction_result {
         std::vector<tls_record> records;
         bool has_remainder;
@@ -124,9 +185,16 @@ namespace ntk {
 
     std::string string_to_hex( const std::vector<uint8_t>& data );
 
+    // rfc 8446 7.1, the label gets its "tls13 " prefix here. throws when openssl fails
+    std::vector<uint8_t> hkdf_expand_label( const std::vector<uint8_t>& secret, const std::string& label,
+                                            const std::vector<uint8_t>& context, size_t out_len, const EVP_MD* hash_func );
+
     tls_key_material derive_tls_key_iv( const std::vector<uint8_t>& secret, const EVP_MD* hash_func,
                                         size_t key_len, size_t iv_len );
 
+    // rfc 8446 7.2, the application traffic secret N + 1 a KeyUpdate moves to. throws for suites other than aes gcm
+    std::vector<uint8_t> next_traffic_secret( uint16_t cipher_suite_id, const std::vector<uint8_t>& secret );
+
     std::vector<tls_record> decrypt_tls_data(
         const std::array<uint8_t,32>& client_random,
         const std::array<uint8_t,32>& server_random,
@@ -136,6 +204,38 @@ namespace ntk {
         const secrets& session_keys,
         const std::string& secret_label = "SERVER_HANDSHAKE_TRAFFIC_SECRET" );
 
+    // the same with the secret looked up by its raw client random
+    std::vector<tls_record> decrypt_tls_data(
+        const std::array<uint8_t,32>& client_random,
+        const std::array<uint8_t,32>& server_random,
+        const uint16_t tls_version,
+        const uint16_t cipher_suite_id,
+        const std::vector<tls_record>& encrypted_records,
+        const key_log_store& key_log,
+        secret_label label = secret_label::SERVER_HANDSHAKE_TRAFFIC_SECRET );
+
+    /*
+        decrypt_tls_data a record at a time. the secret is looked up on the call, so a missing
+        one throws there, and a record that fails to decrypt throws from the increment reaching it
+    */
+    generator<tls_record> generate_decrypted_records(
+        const std::array<uint8_t,32>& client_random,
+        const std::array<uint8_t,32>& server_random,
+        const uint16_t tls_version,
+        const uint16_t cipher_suite_id,
+        generator<tls_record> encrypted_records,
+        const secrets& session_keys,
+        const std::string& secret_label = "SERVER_HANDSHAKE_TRAFFIC_SECRET" );
+
+    generator<tls_record> generate_decrypted_records(
+        const std::array<uint8_t,32>& client_random,
+        const std::array<uint8_t,32>& server_random,
+        const uint16_t tls_version,
+        const uint16_t cipher_suite_id,
+        generator<tls_record> encrypted_records,
+        const key_log_store& key_log,
+        secret_label label = secret_label::SERVER_HANDSHAKE_TRAFFIC_SECRET );
+
     tls_record decrypt_record( const std::array<uint8_t,32>& client_random,
                                const std::array<uint8_t,32>& server_random,
                                const uint16_t tls_version,
@@ -151,8 +251,27 @@ namespace ntk {
                                              const std::array<uint8_t,32>& client_random,
                                              const std::string& label );
 
+    // throws std::out_of_range like the map lookup does when the session has not been logged
+    std::vector<uint8_t> get_traffic_secret( const key_log_store& key_log,
+                                             const std::array<uint8_t,32>& client_random,
+                                             secret_label label );
+
     std::vector<uint8_t> build_tls13_aad( tls_content_type content_type, uint16_t version, uint16_t length );
 
+    // throws on a tag mismatch
+    std::vector<uint8_t> decrypt_aes_gcm( const std::vector<uint8_t>& key,
+                                          const std::vector<uint8_t>& nonce,
+                                          const std::vector<uint8_t>& aad,
+                                          const std::vector<uint8_t>& cipher_text_with_tag,
+                                          const EVP_CIPHER* cipher );
+
+    // the same with the tag mismatch, or a cipher text shorter than its tag, as an error
+    std::expected<std::vector<uint8_t>,std::string> try_decrypt_aes_gcm( std::span<const uint8_t> key,
+                                                                        std::span<const uint8_t> nonce,
+                                                                        std::span<const uint8_t> aad,
+                                                                        std::span<const uint8_t> cipher_text_with_tag,
+                                                                        const EVP_CIPHER* cipher );
+
     std::vector<uint8_t> extract_certificate( const std::vector<uint8_t>& handshake_payload );
 
     bool is_tls( const unsigned char* packet );
@@ -187,6 +306,21 @@ namespace ntk {
 
     std::expected<std::string,std::string> get_sni( const client_hello& hello );
 
+    /*
+        the ClientHello body, after its handshake header, of a tcp payload that starts with
+        the record. nothing is copied and nothing past the payload is read, a hello that
+        continues in the next segment is cut short where the payload ends
+    */
+    std::optional<std::span<const uint8_t>> peek_client_hello( std::span<const uint8_t> tcp_payload );
+
+    // the host_name in the server_name extension, a view into tcp_payload. nullopt without one
+    std::optional<std::string_view> peek_sni( std::span<const uint8_t> tcp_payload );
+
+    // the same for a ClientHello body on its own, e.g. out of a quic crypto stream
+    std::optional<std::string_view> peek_sni_in_client_hello( std::span<const uint8_t> client_hello_body );
+
+    std::optional<std::string_view> peek_sni_from_ethernet_frame( std::span<const uint8_t> ethernet_frame );
+
     std::vector<std::string> get_snis( const session& packets, const std::string& host );
 
     std::expected<bool,std::string> has_sni( const client_hello& hello, const std::string& host );
@@ -215,14 +349,35 @@ namespace ntk {
             server_hello s_hello;
     };
 
+    /*
+        a tcp_live_stream seen as tls. promoting a stream parses nothing, the hellos, the
+        sni and the records are read out of the reassembled payload, or the frames once
+        that was released, the first time they are asked for and kept. the first calls
+        write the cache, so they are not safe from several threads at once
+    */
     class tls_live_stream : public tcp_live_stream {
         public:
             tls_live_stream( const tcp_live_stream& tcp_stream );
+            // takes over the frames and payload, nothing is copied
+            tls_live_stream( tcp_live_stream&& tcp_stream );
+
+            // nullopt when the stream holds no complete hello
+            const std::optional<client_hello>& get_client_hello() const;
+            const std::optional<server_hello>& get_server_hello() const;
+            // the get_sni error when there is no server name
             const std::string& get_sni() const;
+            // every complete record of the direction's reassembled payload
+            const std::vector<tls_record>& client_records() const;
+            const std::vector<tls_record>& server_records() const;
         private:
-            client_hello m_client_hello;
-            server_hello m_server_hello;
-            std::string m_sni;
+            // the direction's payload from its first record, or the frame carrying its hello
+            std::span<const uint8_t> leading_payload( bool client ) const;
+
+            mutable std::optional<std::optional<client_hello>> m_client_hello;
+            mutable std::optional<std::optional<server_hello>> m_server_hello;
+            mutable std::optional<std::string> m_sni;
+            mutable std::optional<std::vector<tls_record>> m_client_records;
+            mutable std::optional<std::vector<tls_record>> m_server_records;
 
             friend std::ostream& operator<<( std::ostream& os, const tls_live_stream& live_stream );
     };
@@ -238,8 +393,33 @@ namespace ntk {
         std::string m_sni;
     };
 
+    /*
+        flow_classifier that reads the ClientHello out of the client's first payload, so
+        streams are decided as soon as the record is in rather than after the transfer.
+        anything that does not start with a tls handshake record gets other
+    */
+    struct tls_classifier {
+        tls_classifier( flow_verdict tls = flow_verdict::KEEP, flow_verdict other = flow_verdict::DROP );
+        flow_verdict operator()( const ntk::tcp_live_stream& stream ) const;
+
+        flow_verdict m_tls;
+        flow_verdict m_other;
+    };
+
+    // keeps streams whose ClientHello names a host containing sni, anything else gets other
+    struct sni_classifier {
+        sni_classifier( const std::string& sni, flow_verdict other = flow_verdict::DROP );
+        flow_verdict operator()( const ntk::tcp_live_stream& stream ) const;
+
+        std::string m_sni;
+        flow_verdict m_other;
+    };
+
     tls_record_extraction_result extract_tls_records( const std::vector<std::vector<uint8_t>>& payloads );
 
+    // each record as soon as the payloads completing it are read, only the unfinished record is buffered and one left at the end is dropped
+    generator<tls_record> generate_tls_records( generator<std::vector<uint8_t>> payloads );
+
     std::expected<tls_record,std::string> get_tls_record_from_ethernet( std::span<const uint8_t> packet );
 
 } // namespace ntk
@@ -0,0 +1,83 @@
+#ifndef TLS_DECRYPTOR_HPP
+#define TLS_DECRYPTOR_HPP
+
+#include <array>
+#include <expected>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <openssl/evp.h>
+
+#include <tls.hpp>
+#include <work_stealing_pool.hpp>
+
+namespace ntk {
+
+    /*
+        decrypts the records of one direction of a tls 1.3 connection
+
+        key and iv are derived once per traffic secret and the cipher context keeps its
+        key schedule, a record only sets the nonce for its sequence number. records are
+        decrypted into buffers the caller owns, so a stream of small records costs the
+        aes and nothing else. the sequence number advances with every record decrypted,
+        hand over application data records only and in the order they were sent
+    */
+    class tls_decryptor {
+
+        public:
+            tls_decryptor();
+            tls_decryptor( uint16_t cipher_suite_id, const std::vector<uint8_t>& secret );
+            ~tls_decryptor();
+
+            tls_decryptor( tls_decryptor&& other ) noexcept;
+            tls_decryptor& operator=( tls_decryptor&& other ) noexcept;
+            tls_decryptor( const tls_decryptor& ) = delete;
+            tls_decryptor& operator=( const tls_decryptor& ) = delete;
+
+            // a new traffic secret, e.g. handshake to application, starts over at sequence 0. throws for suites other than aes gcm
+            void rekey( uint16_t cipher_suite_id, const std::vector<uint8_t>& secret );
+            bool is_keyed() const;
+
+            uint64_t sequence() const;
+            // for a record that is not the next one, decrypt_record does this
+            void seek( uint64_t seq_num );
+
+            /*
+                payload is the ciphertext with its tag, out takes payload.size() - 16 bytes.
+                returns the plaintext length, the error leaves the sequence number where it was
+            */
+            std::expected<size_t,std::string> decrypt( tls_content_type content_type, uint16_t version,
+                                                       std::span<const uint8_t> payload, std::span<uint8_t> out );
+            // out is resized to the plaintext, keeping its capacity from record to record
+            std::expected<size_t,std::string> decrypt( const tls_record& record, std::vector<uint8_t>& out );
+            std::expected<size_t,std::string> decrypt( const tls_record_view& record, std::vector<uint8_t>& out );
+
+        private:
+            EVP_CIPHER_CTX* m_ctx;
+            std::array<uint8_t,12> m_iv;
+            uint64_t m_seq_num;
+            bool m_keyed;
+    };
+
+    /*
+        decrypt_tls_data over the pool for long record sequences, e.g. a whole video flow
+
+        a tls 1.3 nonce depends on nothing but the iv and the sequence number, so the
+        records are cut into chunks of chunk_records and each chunk is decrypted by a
+        decryptor of its own from the sequence number it starts at. the result is in
+        record order and the same as decrypt_tls_data gives, records other than
+        application data are copied through without taking a sequence number. throws
+        the first chunk's error once every chunk has finished. safe to call from a
+        task on the pool, the calling thread runs chunks itself while it waits
+    */
+    std::vector<tls_record> decrypt_tls_records_parallel( uint16_t cipher_suite_id, const std::vector<uint8_t>& secret,
+                                                          const std::vector<tls_record>& encrypted_records,
+                                                          work_stealing_pool& pool, size_t chunk_records = 256 );
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef TLS_LIVE_DECRYPTOR_HPP
+#define TLS_LIVE_DECRYPTOR_HPP
+
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <flow_key.hpp>
+#include <key_log_store.hpp>
+#include <stream_events.hpp>
+#include <tls.hpp>
+#include <tls_decryptor.hpp>
+
+namespace ntk {
+
+    /*
+        callbacks from a tls_live_decryptor, called from its stream_events callbacks and
+        so on the session's feeding thread. spans are only valid during the call
+    */
+    class tls_events {
+        public:
+            virtual ~tls_events() = default;
+            // both hellos are in, nothing of the connection has been decrypted yet
+            virtual void on_handshake( const four_tuple& four, const client_hello& client, const server_hello& server ) {}
+            // type is the record's inner content type, plaintext comes without it and its padding
+            virtual void on_record( const four_tuple& four, stream_direction direction, tls_content_type type,
+                                    std::span<const uint8_t> plaintext ) {}
+            // the connection is not decrypted any further, e.g. not tls 1.3 or a record failed its tag
+            virtual void on_failure( const four_tuple& four, const std::string& reason ) {}
+            virtual void on_close( const four_tuple& four, close_reason reason ) {}
+    };
+
+    struct tls_live_statistics {
+        size_t connections = 0;         // open now
+        size_t records_decrypted = 0;
+        size_t bytes_decrypted = 0;     // plaintext
+        size_t failures = 0;
+    };
+
+    /*
+        decrypts tls 1.3 connections while they are still open, as stream_events of a
+        tcp_live_stream_session
+
+        each direction's payload is framed as it arrives. the hellos give the client
+        random and the cipher suite, the handshake records are decrypted with the
+        handshake traffic secrets and the Finished in them switches that direction to
+        its application traffic secret. every record is decrypted as soon as it is
+        complete and its ciphertext is dropped, so what is held is an incomplete record
+        per direction. records wait while their secret is not in key_log yet, they are
+        tried again with the next payload, on close or with retry() and given up on
+        once more than max_buffered_bytes are waiting
+    */
+    class tls_live_decryptor : public stream_events {
+
+        public:
+            tls_live_decryptor( const key_log_store& key_log, tls_events& events, size_t max_buffered_bytes = 1 << 20 );
+
+            void on_open( const four_tuple& four ) override;
+            void on_data( const four_tuple& four, stream_direction direction, std::span<const uint8_t> data ) override;
+            void on_close( const four_tuple& four, close_reason reason ) override;
+
+            // tries the connections waiting for a secret again, e.g. after key_log read new lines
+            void retry();
+
+            tls_live_statistics statistics() const;
+        private:
+            enum class phase {
+                HELLO,
+                HANDSHAKE,
+                APPLICATION
+            };
+
+            struct direction_state {
+                std::vector<uint8_t> buffer;        // from the first byte not yet decrypted
+                tls_record_framer framer;
+                tls_decryptor decryptor;
+                phase stage = phase::HELLO;
+                tls_handshake_walker handshake;
+            };
+
+            struct connection {
+                four_tuple four;
+                std::optional<client_hello> client;
+                std::optional<server_hello> server;
+                direction_state client_to_server;
+                direction_state server_to_client;
+                bool failed = false;
+            };
+
+            void process( connection& conn, stream_direction direction );
+            // false while the secret for the record up next is not there yet
+            bool ensure_keyed( connection& conn, stream_direction direction, direction_state& state );
+            void fail( connection& conn, const std::string& reason );
+
+            const key_log_store& m_key_log;
+            tls_events& m_events;
+            size_t m_max_buffered_bytes;
+
+            std::unordered_map<flow_key,connection,flow_key_hash> m_connections;
+            std::vector<uint8_t> m_plain_text;
+            tls_live_statistics m_statistics;
+    };
+
+} // namespace ntk
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef TLS_SESSION_DECODER_HPP
+#define TLS_SESSION_DECODER_HPP
+
+#include <expected>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <constants.hpp>
+#include <key_log_store.hpp>
+#include <stream_events.hpp>
+#include <tls.hpp>
+#include <tls_decryptor.hpp>
+
+namespace ntk {
+
+    // the secrets a record was protected with
+    enum class tls_epoch : uint8_t {
+        PLAINTEXT,      // the hellos and anything else sent in the clear
+        HANDSHAKE,
+        APPLICATION
+    };
+
+    // one record of a tls_transcript, its content is plaintext[ offset, offset + length )
+    struct tls_transcript_record {
+        stream_direction direction;
+        tls_content_type type;          // the inner content type of a decrypted record
+        tls_epoch epoch;
+        uint32_t generation;            // N of the application traffic secret, one more with every KeyUpdate
+        size_t offset;
+        size_t length;
+    };
+
+    // both directions of a connection in the order their records went by
+    struct tls_transcript {
+        std::vector<tls_transcript_record> records;
+        // the records' content back to back, without inner content types and padding
+        std::vector<uint8_t> plaintext;
+
+        std::span<const uint8_t> content( const tls_transcript_record& record ) const;
+        // the application data of one direction, e.g. an http response and its body
+        std::vector<uint8_t> application_data( stream_direction direction ) const;
+    };
+
+    /*
+        decrypts both directions of a tls 1.3 connection in one pass
+
+        payload is fed in the order it went by, each direction is framed as it comes
+        and every complete record is decrypted straight into the transcript. the hellos
+        give the client random and the cipher suite, a direction starts on its handshake
+        traffic secret, its Finished moves it to its traffic secret 0 and each KeyUpdate
+        it sends to the next generation. records wait while a secret is not in key_log,
+        they are tried again with the next feed() and finish() reports the ones still
+        waiting at the end
+    */
+    class tls13_session_decoder {
+
+        public:
+            tls13_session_decoder( const key_log_store& key_log );
+
+            // the error stays, feeding after it does nothing
+            std::expected<void,std::string> feed( stream_direction direction, std::span<const uint8_t> data );
+            // an error for records whose secret never arrived, a record cut off at the end of the capture is not one
+            std::expected<void,std::string> finish();
+
+            const std::optional<client_hello>& client() const;
+            const std::optional<server_hello>& server() const;
+
+            const tls_transcript& transcript() const;
+            tls_transcript take_transcript();
+        private:
+            struct direction_state {
+                std::vector<uint8_t> buffer;        // from the first byte not yet decoded
+                tls_record_framer framer;
+                tls_decryptor decryptor;
+                std::vector<uint8_t> secret;        // for the next KeyUpdate
+                tls_epoch epoch = tls_epoch::PLAINTEXT;
+                uint32_t generation = 0;
+                tls_handshake_walker handshake;
+            };
+
+            direction_state& state_of( stream_direction direction );
+            // decodes what is complete in stream, a direction's buffer or the payload just fed
+            void process( stream_direction direction, std::span<const uint8_t> stream );
+            bool ensure_keyed( stream_direction direction, direction_state& state );
+            void fail( const std::string& reason );
+
+            const key_log_store& m_key_log;
+
+            std::optional<client_hello> m_client;
+            std::optional<server_hello> m_server;
+            direction_state m_client_to_server;
+            direction_state m_server_to_client;
+
+            tls_transcript m_transcript;
+            std::optional<std::string> m_error;
+    };
+
+    /*
+        the transcript of the connection four, the client's side of it, from a capture.
+        the packets are taken in capture order and decoded once, it replaces a
+        decrypt_tls_data per secret label and direction
+    */
+    std::expected<tls_transcript,std::string> decode_tls13_session( const four_tuple& four, const session& packets,
+                                                                    const key_log_store& key_log );
+
+} // namespace ntk
+
+#endif
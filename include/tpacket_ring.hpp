@@ -0,0 +1,83 @@
+#ifndef TPACKET_RING_HPP
+#define TPACKET_RING_HPP
+
+#include <pcap.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <constants.hpp>
+
+namespace ntk {
+
+    /*
+        a frame handed to a batch consumer, data points into the capture buffer and is
+        only valid for the duration of the callback
+    */
+    struct capture_frame {
+        struct pcap_pkthdr header;
+        const unsigned char* data;
+    };
+
+    using packet_batch_callback = std::function<void( std::span<const capture_frame> )>;
+
+    struct tpacket_options {
+        size_t block_size = 1 << 22;
+        size_t block_count = 64;
+        size_t frame_size = 1 << 11;
+        unsigned int retire_timeout_ms = 60;
+        int poll_timeout_ms = 100;
+    };
+
+    struct tpacket_statistics {
+        uint64_t packets;
+        uint64_t drops;
+        uint64_t queue_freezes;
+    };
+
+    /*
+        memory-mapped AF_PACKET ring using TPACKET_V3
+
+        the kernel fills whole blocks of frames, each retired block is handed to the
+        consumer in one call and returned to the kernel afterwards
+    */
+    class tpacket_ring {
+
+        public:
+            tpacket_ring( const tpacket_options& options = {} );
+            ~tpacket_ring();
+
+            tpacket_ring( const tpacket_ring& ) = delete;
+            tpacket_ring& operator=( const tpacket_ring& ) = delete;
+
+            bool open( const char* device_name, const char* filter_exp );
+            void run( const packet_batch_callback& callback );
+            void stop();
+            void close();
+
+            // totals since open(), the kernel resets its own counters on every read
+            tpacket_statistics statistics();
+            // also while run() is going, the kernel replaces the socket's program in one step
+            bool attach_filter( const char* filter_exp );
+        private:
+            void process_block( uint8_t* block, const packet_batch_callback& callback );
+
+            tpacket_options m_options;
+            int m_fd;
+            uint8_t* m_map;
+            size_t m_map_len;
+            std::atomic<bool> m_stop;
+            std::vector<capture_frame> m_frames;
+            std::mutex m_statistics_mutex;
+            tpacket_statistics m_statistics;
+    };
+
+} // namespace ntk
+
+#endif
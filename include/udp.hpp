@@ -1,14 +1,30 @@
 #ifndef UDP_HPP
 #define UDP_HPP
 
-#include <constants.hpp>
-
 #include <array>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <span>
+#include <unordered_set>
+#include <vector>
 
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 
+#include <captured_packet.hpp>
+#include <constants.hpp>
+#include <flow_key.hpp>
+#include <flow_table.hpp>
+#include <ipv4_reassembler.hpp>
+#include <link_layer.hpp>
+#include <spmc_queue.hpp>
+#include <statistics.hpp>
+#include <stream_events.hpp>
+#include <tcp.hpp>
+#include <timer_wheel.hpp>
+
 namespace ntk {
 
     struct udp_header {
@@ -24,6 +40,193 @@ namespace ntk {
 
     bool is_udp( const unsigned char* ethernet_frame );
 
+    /*
+        ipv4 or ipv6 / udp frame decoded in one pass, like decoded_packet it points
+        into the frame for the payload so the frame must outlive it
+    */
+    struct decoded_datagram {
+        std::span<const uint8_t> frame;
+
+        ip_address source_ip;
+        ip_address destination_ip;
+        uint16_t source_port;
+        uint16_t destination_port;
+
+        uint8_t ip_version;
+        uint16_t network_offset;
+        uint16_t ip_header_len;
+
+        // ends at the udp length, so link layer padding is left out
+        std::span<const uint8_t> payload;
+
+        four_tuple four() const {
+            return four_tuple{ source_ip, destination_ip, source_port, destination_port };
+        }
+    };
+
+    // the udp header and payload behind an ip header found by decode_ip_as
+    std::optional<decoded_datagram> decode_datagram( std::span<const uint8_t> frame, const ip_layer& ip );
+
+    // nothing when the ethernet frame is not ipv4 or ipv6 / udp, is a fragment or is too short
+    std::optional<decoded_datagram> decode_datagram( std::span<const uint8_t> frame );
+
+    struct udp_datagram {
+        bool from_client;
+        std::optional<capture_time> timestamp;
+        std::vector<uint8_t> payload;
+    };
+
+    struct udp_direction_counters {
+        uint64_t datagrams = 0;
+        uint64_t bytes = 0;     // of udp payload
+    };
+
+    /*
+        a bidirectional udp conversation between two endpoints
+
+        udp has no handshake, the sender of the first datagram seen is taken to be the
+        client. counters and timestamps cover every datagram, the payloads only of
+        the first few, which is all a dns exchange or the start of a quic handshake needs
+    */
+    class udp_flow {
+
+        public:
+            udp_flow( const four_tuple& four );
+
+            const four_tuple& get_four_tuple() const;
+
+            const udp_direction_counters& client() const;
+            const udp_direction_counters& server() const;
+
+            // only known for flows fed with captured_packet
+            std::optional<capture_time> first_packet() const;
+            std::optional<capture_time> last_packet() const;
+            std::optional<std::chrono::nanoseconds> duration() const;
+
+            // the first datagrams of the flow, up to udp_session_limits::max_flow_datagrams
+            const std::vector<udp_datagram>& datagrams() const;
+            // whether later datagrams were counted but not kept
+            bool datagrams_truncated() const;
+
+            // why the session let go of the flow, udp has no close of its own
+            close_reason reason() const;
+        private:
+            void feed( const decoded_datagram& datagram, std::optional<capture_time> timestamp, size_t max_datagrams );
+            void keep_counters_only();
+
+            four_tuple m_four;
+            udp_direction_counters m_client;
+            udp_direction_counters m_server;
+            std::optional<capture_time> m_first_packet;
+            std::optional<capture_time> m_last_packet;
+            std::vector<udp_datagram> m_datagrams;
+            bool m_truncated = false;
+            bool m_counters_only = false;
+            bool m_classified = true;
+            close_reason m_reason = close_reason::SHUTDOWN;
+
+            friend class udp_flow_session;
+    };
+
+    /*
+        bounds on how long a flow is kept, zero disables a limit. time is capture time
+        so only flows fed with captured_packet expire, without a close of its own an
+        idle timeout is what ends a udp flow
+    */
+    struct udp_session_limits {
+        std::chrono::nanoseconds idle_timeout = std::chrono::seconds( 30 );    // since the flow's last datagram
+        std::chrono::nanoseconds max_lifetime{ 0 };                            // since the flow's first datagram
+
+        // payloads kept per flow, the rest are only counted
+        size_t max_flow_datagrams = 16;
+
+        // for the ipv4 fragments held until their datagram is whole and fed in their place
+        fragment_limits fragments;
+
+        // of the frames fed, e.g. to_link_type( capture_file::datalink() )
+        link_type link = link_type::ETHERNET;
+    };
+
+    struct udp_session_statistics {
+        uint64_t datagrams_fed;
+        uint64_t datagrams_unmatched;   // not udp, or too short for the headers they claim
+        uint64_t flows_opened;
+        uint64_t flows_offloaded;
+        uint64_t flows_evicted;         // by the idle timeout or lifetime, offloaded too when there is a queue
+        uint64_t flows_dropped;         // turned away by the classifier, only their flow_key is kept
+    };
+
+    /*
+        asked by the session on every client datagram of a flow while it answers
+        UNDECIDED, e.g. quic_sni_classifier on the flow's Initial packets. HEADERS_ONLY
+        keeps counting the flow but drops its payloads
+    */
+    using udp_flow_classifier = std::function<flow_verdict( const udp_flow& flow )>;
+
+    /*
+        groups udp datagrams into bidirectional flows, the udp counterpart of
+        tcp_live_stream_session
+
+        flows live in a flow_table under their direction-independent flow_key and are
+        expired on a timer_wheel over capture time, an expired or flushed flow is handed
+        to the offload queue. ipv4 fragments are reassembled in front of the flows. like
+        the tcp session it is fed from one thread, so one session per shard of a
+        symmetric_flow_hash split scales it out. a classifier can drop or keep a flow on
+        its first datagram, before anything of it is held
+    */
+    class udp_flow_session {
+
+        public:
+            udp_flow_session();
+            udp_flow_session( transfer_queue_interface<udp_flow>* offload_queue, const udp_session_limits& limits = udp_session_limits{} );
+
+            void feed( const std::vector<uint8_t>& packet );
+            // copies what it keeps, so the span only has to outlive the call
+            void feed( std::span<const uint8_t> packet );
+            // flows also record when their datagrams arrived, and expire
+            void feed( const captured_packet& packet );
+            // expires flows up to now without a datagram, e.g. from a timer while the link is quiet
+            void advance_time( capture_time now );
+            // offloads every open flow, marked with close_reason::SHUTDOWN, returns how many there were
+            size_t flush();
+
+            // applies to flows opened from now on, set it before the first packet
+            void set_classifier( udp_flow_classifier classifier );
+
+            // flows open right now
+            size_t size() const;
+            const udp_flow* find( const four_tuple& four ) const;
+
+            // safe to call from any thread while the feeding thread runs
+            udp_session_statistics statistics() const;
+            fragment_statistics fragments() const;
+        private:
+            template<typename Packet>
+            void feed_packet( const Packet& packet );
+
+            void schedule_expiry( const flow_key& key, const udp_flow& flow );
+            void expire( const flow_key& key, capture_time now );
+            void close( const flow_key& key, close_reason reason );
+
+            flow_table<flow_key,udp_flow,flow_key_hash> m_flows;
+            // flows the classifier dropped, their later datagrams are ignored
+            std::unordered_set<flow_key,flow_key_hash> m_dropped;
+            udp_flow_classifier m_classifier;
+
+            transfer_queue_interface<udp_flow>* m_offload_queue = nullptr;
+            udp_session_limits m_limits;
+            timer_wheel<flow_key> m_expiry_timers;
+            ipv4_reassembler m_fragments;
+            link_layer m_link = link_layer_of<ethernet_link>();
+
+            relaxed_counter m_datagrams_fed;
+            relaxed_counter m_datagrams_unmatched;
+            relaxed_counter m_flows_opened;
+            relaxed_counter m_flows_offloaded;
+            relaxed_counter m_flows_evicted;
+            relaxed_counter m_flows_dropped;
+    };
+
 } // end namesapce
 
-#endif
\ No newline at end of file
+#endif
@@ -11,6 +11,8 @@
 #include <iomanip>
 
 #include <constants.hpp>
+#include <capture_file.hpp>
+#include <pcap_file.hpp>
 #include "tcp.hpp"
 #include "ipv4.hpp"
 #include "tls.hpp"
@@ -19,7 +21,9 @@
 namespace ntk {
 
     /*
-        read in a series of packets from a file that was made using packet-capture
+        read in a series of packets from a file that was made using packet-capture,
+        pcap and pcapng files are recognised by their magic number, anything else is
+        read as hex text
     */
     session read_packets_from_file( const std::string& packet_data_file );
 
@@ -76,11 +80,12 @@ namespace ntk {
         }
 
         std::string line;
+        std::vector<uint8_t> packet;
         int line_number = 0;
 
         while ( std::getline( file, line ) ) {
             line_number++;
-            std::vector<uint8_t> packet = parse_hex_line( line );
+            decode_hex_line( line, packet );
             if ( filter( packet ) ) {
                 line_numbers.push_back( line_number );
             }
@@ -129,6 +134,9 @@ namespace ntk {
 
     void write_payload_to_file( const std::vector<uint8_t>& payload, const std::string& filename );
 
+    // the pieces are gathered by writev, not copied into one buffer first
+    void write_payload_to_file( const http_body_view& payload, const std::string& filename );
+
 } // namespace ntk
 
 #endif
\ No newline at end of file
@@ -0,0 +1,77 @@
+#ifndef WORK_STEALING_POOL_HPP
+#define WORK_STEALING_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+
+namespace ntk {
+
+    /*
+        fixed pool of threads with one task deque per thread
+
+        a task submitted from one of the pool's own threads goes on that thread's deque
+        and is taken back newest first, which keeps a flow's next stage on the core that
+        just touched its data. a thread whose deque is empty steals the oldest task of
+        another before it goes to sleep, tasks from outside the pool are dealt out round
+        robin. a task that throws is reported and dropped, the thread carries on
+    */
+    class work_stealing_pool {
+
+        public:
+            using task = std::function<void()>;
+
+            // 0 threads means one per hardware thread
+            work_stealing_pool( size_t n_threads = 0 );
+            // runs what is still queued, then joins
+            ~work_stealing_pool();
+
+            work_stealing_pool( const work_stealing_pool& ) = delete;
+            work_stealing_pool& operator=( const work_stealing_pool& ) = delete;
+
+            void submit( task t );
+
+            // runs one queued task on the calling thread, for threads waiting on the pool's work
+            bool run_one();
+            // blocks until every task submitted so far, and everything they submitted, has run
+            void wait_idle();
+
+            // true on the pool's own threads
+            bool on_pool_thread() const;
+            size_t thread_count() const;
+        private:
+            struct worker_queue {
+                std::mutex mutex;
+                std::deque<task> tasks;
+            };
+
+            void run( std::stop_token stop, size_t index );
+            bool pop( size_t index, task& t );
+            bool steal( size_t thief, task& t );
+            void execute( task& t );
+
+            std::vector<std::unique_ptr<worker_queue>> m_queues;
+            std::atomic<size_t> m_next_queue;
+            // on a deque, and submitted but not yet finished
+            std::atomic<size_t> m_queued;
+            std::atomic<size_t> m_pending;
+
+            std::mutex m_mutex;
+            std::condition_variable_any m_work_cv;
+            std::condition_variable m_idle_cv;
+
+            // last, so the threads are joined before anything they use goes away
+            std::vector<std::jthread> m_threads;
+    };
+
+} // namespace ntk
+
+#endif
@@ -7,24 +7,32 @@ SCRIPT_DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
 SRC_DIR="$SCRIPT_DIR/../src"
 INCLUDE_DIR="$SCRIPT_DIR/../include"
 TEST_DIR="$SCRIPT_DIR/../tests"
+BENCH_DIR="$SCRIPT_DIR/../benchmarks"
 BUILD_DIR="$SCRIPT_DIR/../build"
 LIB_DIR="$SCRIPT_DIR/../lib"
 
 # Executables in current directory
 MAIN_BIN="$SCRIPT_DIR/ntk"
 TEST_BIN="$SCRIPT_DIR/ntk_tests"
+BENCH_BIN="$SCRIPT_DIR/ntk_bench"
 
 # Clean option
 if [[ "$1" == "--clean" ]]; then
     echo "Cleaning build artifacts..."
     rm -rf "$BUILD_DIR"
-    rm -f "$MAIN_BIN" "$TEST_BIN"
+    rm -f "$MAIN_BIN" "$TEST_BIN" "$BENCH_BIN"
     echo "✅ Clean complete."
     exit 0
 fi
 
+# Benchmark option
+BUILD_BENCH=0
+if [[ "$1" == "--bench" ]]; then
+    BUILD_BENCH=1
+fi
+
 # Create build dirs
-mkdir -p "$BUILD_DIR/obj" "$BUILD_DIR/test_obj"
+mkdir -p "$BUILD_DIR/obj" "$BUILD_DIR/test_obj" "$BUILD_DIR/bench_obj" "$BUILD_DIR/bench_src_obj"
 
 # Compiler and flags
 CXX=g++
@@ -80,4 +88,21 @@ $CXX $CXXFLAGS "${SRC_OBJS[@]}" "${TEST_OBJS[@]}" \
     -o "$TEST_BIN" \
     -lgtest -lgtest_main -lpcap -lssl -lcrypto $LIBS -lcurl -lz
 
-echo "✅ Build complete. Run ./ntk or ./ntk_tests"
+# Link benchmark binary
+if [[ "$BUILD_BENCH" == 1 ]]; then
+    BENCH_SRC_OBJS=()
+    BENCH_OBJS=()
+    # the sources again at -O2, measuring the -O0 objects would say little
+    CXXFLAGS="-O2 -g -std=c++23 -fPIC"
+    INCLUDES="$INCLUDES -I$BENCH_DIR"
+    compile_objects "$SRC_DIR" "$BUILD_DIR/bench_src_obj" BENCH_SRC_OBJS
+    compile_objects "$BENCH_DIR" "$BUILD_DIR/bench_obj" BENCH_OBJS
+
+    echo "Linking benchmark binary..."
+    $CXX $CXXFLAGS "${BENCH_SRC_OBJS[@]}" "${BENCH_OBJS[@]}" \
+        $INCLUDES -L"$LIB_DIR" \
+        -o "$BENCH_BIN" \
+        -lbenchmark -lbenchmark_main -lpthread -lpcap -lssl -lcrypto -lcurl -lz
+fi
+
+echo "✅ Build complete. Run ./ntk or ./ntk_tests ( ./ntk_bench with --bench )"
@@ -1,9 +1,20 @@
+#include <capture_replay.hpp>
+#include <instrumentation.hpp>
 #include <packet_capture.hpp>
+#include <ring_buffer.hpp>
+#include <shutdown.hpp>
+#include <spmc_queue.hpp>
+#include <stream_processor.hpp>
+#include <tcp.hpp>
 
 #ifdef _WIN32
 #include <winsock2.h>
 #endif
 
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
 #include <string>
 
 uint16_t get_ethernet_type( const unsigned char *packet ) {
@@ -27,7 +38,94 @@ void print_mac_address( const unsigned char* mac ) {
     }
 }
 
-int main() {
+void print_latency( const ntk::metrics_snapshot& snapshot, const std::string& name ) {
+    auto values = snapshot.find_histogram( name );
+    if ( !values || values->count() == 0 ) return;
+    std::cout << name << " p50 " << values->percentile( 0.5 ) / 1000 << "us"
+              << " p99 " << values->percentile( 0.99 ) / 1000 << "us"
+              << " max " << values->max() / 1000 << "us\n";
+}
+
+/*
+    replays a capture through ring_buffer -> tcp_live_stream_session -> stream_processor
+    at the given pace and reports the achieved rate, what the ring turned away and the
+    pipeline's latencies, e.g.
+
+        ./ntk --replay ../packet_data/lena.txt --pps 200000 --loops 100 --flows 10
+*/
+int replay_load_test( int argc, char** argv ) {
+
+    ntk::replay_options options{ .pacing = ntk::replay_pacing::UNPACED };
+    std::string filename = argv[ 2 ];
+
+    for ( int i = 3; i + 1 < argc; i += 2 ) {
+        std::string flag = argv[ i ];
+        double value = std::atof( argv[ i + 1 ] );
+        if ( flag == "--pps" ) {
+            options.pacing = ntk::replay_pacing::PACKETS_PER_SECOND;
+            options.rate = value;
+        } else if ( flag == "--gbps" ) {
+            options.pacing = ntk::replay_pacing::BITS_PER_SECOND;
+            options.rate = value * 1e9;
+        } else if ( flag == "--speed" ) {
+            options.pacing = ntk::replay_pacing::ORIGINAL;
+            options.speed = value;
+        } else if ( flag == "--loops" ) {
+            options.loops = static_cast<size_t>( value );
+        } else if ( flag == "--flows" ) {
+            options.flow_copies = static_cast<size_t>( value );
+        } else {
+            std::cerr << "Unknown option: " << flag << '\n';
+            return 1;
+        }
+    }
+
+    ntk::capture_replay replay( filename, options );
+    if ( !replay.is_open() ) return 1;
+
+    auto ring = std::make_unique<ntk::ring_buffer<ntk::captured_packet,4096>>();
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session session( &offload_queue );
+
+    std::atomic<size_t> streams{ 0 };
+    ntk::stream_processor processor( offload_queue, [&]( ntk::tcp_live_stream&& ) { ++streams; } );
+
+    ntk::metrics_registry registry;
+    session.instrument( registry );
+    processor.instrument( registry );
+
+    processor.start();
+    replay.start( [&]( const struct pcap_pkthdr* header, const unsigned char* packet ) {
+        ring->push( ntk::make_captured_packet( header, packet ) );
+    });
+
+    ntk::captured_packet packet;
+    while ( replay.is_capturing() ) {
+        if ( ring->pop( packet ) ) session.feed( packet );
+    }
+
+    ntk::stream_processor* processors[] = { &processor };
+    auto drained = ntk::drain_pipeline( replay, *ring, session, processors,
+                                        std::chrono::steady_clock::now() + std::chrono::seconds( 10 ) );
+
+    auto report = replay.report();
+    std::cout << "sent " << report.packets << " packets in " << std::chrono::duration<double>( report.elapsed ).count() << "s, "
+              << report.packets_per_second() << " pps, " << report.bits_per_second() / 1e9 << " Gbps, "
+              << "max lag " << report.max_lag.count() / 1000 << "us\n";
+    std::cout << "ring dropped " << ring->statistics().push_failures << ", high watermark " << ring->statistics().high_watermark << '\n';
+    std::cout << "streams " << streams << ", flushed at shutdown " << drained.streams_flushed
+              << ( drained.completed ? "" : ", drain cut short" ) << '\n';
+
+    auto snapshot = registry.snapshot();
+    print_latency( snapshot, "ntk_capture_to_offload_seconds" );
+    print_latency( snapshot, "ntk_offload_to_callback_seconds" );
+
+    return 0;
+}
+
+int main( int argc, char** argv ) {
+
+    if ( argc >= 3 && std::string( argv[ 1 ] ) == "--replay" ) return replay_load_test( argc, argv );
 
     const std::string filename = "../packet_data/test.txt";
 
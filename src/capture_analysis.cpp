@@ -0,0 +1,121 @@
+#include <capture_analysis.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace ntk {
+
+    namespace {
+
+        tcp_stream merged_stream_of( const flow_index& index, const flow_index::flow& flow, const four_tuple& sender ) {
+
+            std::vector<raw_tcp_frame> raw_stream;
+
+            for ( auto& p : flow.packets ) {
+                if ( !flow.is_sent_by( p, sender ) ) continue;
+                auto frame = extract_raw_tcp_frame( index.packet( p ).data() );
+                if ( frame ) raw_stream.push_back( std::move( *frame ) );
+            }
+
+            return merge_tcp_stream_non_overlapping( get_tcp_stream( raw_stream ) );
+        }
+
+        std::vector<std::vector<uint8_t>> payloads_of( const tcp_stream& stream ) {
+            std::vector<std::vector<uint8_t>> payloads;
+            payloads.reserve( stream.size() );
+            for ( auto& [ seq, payload ] : stream ) payloads.push_back( payload );
+            return payloads;
+        }
+
+        std::vector<uint8_t> bytes_of( const tcp_stream& stream ) {
+            std::vector<uint8_t> bytes;
+            for ( auto& [ seq, payload ] : stream ) bytes.insert( bytes.end(), payload.begin(), payload.end() );
+            return bytes;
+        }
+
+        // the http parsers expect a complete head, anything short of one is left alone
+        bool has_http_head( const std::vector<uint8_t>& bytes ) {
+            const char* end_of_head = "\r\n\r\n";
+            return bytes.size() >= 5 && is_http( bytes ) && std::search( bytes.begin(), bytes.end(), end_of_head, end_of_head + 4 ) != bytes.end();
+        }
+
+        constexpr uint8_t tls_handshake_record = 22;
+
+    } // namespace
+
+    flow_analysis analyze_flow( const flow_index& index, size_t flow_number, const capture_analysis_options& options ) {
+
+        const auto& flow = index.flows().at( flow_number );
+
+        flow_analysis analysis;
+        analysis.flow_number = flow_number;
+
+        analysis.handshake = get_handshake( flow.four, index );
+        analysis.terminations = get_terminations( flow.four, index );
+
+        analysis.client = analysis.handshake.empty() ? flow.four : get_four_from_ethernet( analysis.handshake.syn );
+
+        analysis.client_stream = merged_stream_of( index, flow, analysis.client );
+        analysis.server_stream = merged_stream_of( index, flow, flip_four( analysis.client ) );
+
+        bool is_tls = !analysis.client_stream.empty() && !analysis.client_stream.begin()->second.empty() &&
+                      analysis.client_stream.begin()->second[ 0 ] == tls_handshake_record;
+
+        if ( is_tls ) {
+            if ( options.extract_tls ) {
+                analysis.client_tls_records = extract_tls_records( payloads_of( analysis.client_stream ) ).records;
+                analysis.server_tls_records = extract_tls_records( payloads_of( analysis.server_stream ) ).records;
+            }
+        } else if ( options.parse_http ) {
+            auto client_bytes = bytes_of( analysis.client_stream );
+            auto server_bytes = bytes_of( analysis.server_stream );
+            if ( has_http_head( client_bytes ) && get_http_type( client_bytes ) == http_type::REQUEST ) {
+                analysis.request = get_http_request( client_bytes );
+            }
+            // a malformed status line leaves the flow reported without its response
+            if ( has_http_head( server_bytes ) && get_http_type( server_bytes ) == http_type::RESPONSE ) {
+                auto response = try_get_http_response( server_bytes );
+                if ( response ) {
+                    analysis.response = std::move( *response );
+                } else {
+                    std::cerr << "Failed to parse http of flow " << flow_number << ": " << response.error() << '\n';
+                }
+            }
+        }
+
+        return analysis;
+    }
+
+    size_t analyze_capture( const session& packets, const capture_analysis_options& options, const std::function<void( flow_analysis&& )>& on_flow ) {
+
+        flow_index index( packets );
+
+        size_t threads = options.threads ? options.threads : std::max( 1u, std::thread::hardware_concurrency() );
+        threads = std::min( threads, std::max<size_t>( index.size(), 1 ) );
+
+        std::atomic<size_t> next_flow{ 0 };
+        std::mutex delivery;
+
+        auto work = [&]() {
+            for ( size_t flow_number = next_flow.fetch_add( 1 ); flow_number < index.size(); flow_number = next_flow.fetch_add( 1 ) ) {
+                auto analysis = analyze_flow( index, flow_number, options );
+                std::lock_guard<std::mutex> lock( delivery );
+                on_flow( std::move( analysis ) );
+            }
+        };
+
+        // the calling thread is one of the workers
+        std::vector<std::thread> workers;
+        workers.reserve( threads - 1 );
+        for ( size_t i = 1; i < threads; ++i ) workers.emplace_back( work );
+
+        work();
+
+        for ( auto& worker : workers ) worker.join();
+
+        return index.size();
+    }
+
+} // namespace ntk
@@ -0,0 +1,192 @@
+#include <capture_file.hpp>
+
+#include <fstream>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ntk {
+
+    capture_file::iterator::iterator( std::span<const uint8_t> capture )
+        : m_cursor( capture ) {
+        m_record = m_cursor.next();
+    }
+
+    capture_file::iterator::iterator( const iterator& other )
+        : m_cursor( other.m_cursor ), m_record( other.m_record ), m_index( other.m_index ) {
+        rebind();
+    }
+
+    capture_file::iterator& capture_file::iterator::operator=( const iterator& other ) {
+        m_cursor = other.m_cursor;
+        m_record = other.m_record;
+        m_index = other.m_index;
+        rebind();
+        return *this;
+    }
+
+    void capture_file::iterator::rebind() {
+        // HEX records live in the cursor, so a copy has to point at its own decoded line
+        if ( m_record && m_cursor.format() == capture_format::HEX ) {
+            m_record->data = m_cursor.decoded_line();
+        }
+    }
+
+    std::span<const uint8_t> capture_file::iterator::operator*() const {
+        return m_record->data;
+    }
+
+    const capture_record_view& capture_file::iterator::record() const {
+        return *m_record;
+    }
+
+    std::span<const uint8_t> capture_file::iterator::stored_record() const {
+        return m_cursor.stored_record();
+    }
+
+    capture_file::iterator& capture_file::iterator::operator++() {
+        m_record = m_cursor.next();
+        ++m_index;
+        if ( !m_record && m_cursor.failed() ) {
+            std::cerr << "Stopped reading capture: " << m_cursor.error() << '\n';
+        }
+        return *this;
+    }
+
+    capture_file::iterator capture_file::iterator::operator++( int ) {
+        iterator previous = *this;
+        ++*this;
+        return previous;
+    }
+
+    bool capture_file::iterator::operator==( const iterator& other ) const {
+        if ( !m_record || !other.m_record ) return !m_record && !other.m_record;
+        return m_index == other.m_index;
+    }
+
+#ifndef _WIN32
+
+    capture_file::capture_file( const std::string& filename )
+        : m_data( nullptr ), m_size( 0 ), m_open( false ), m_mapped( false ) {
+
+        int fd = ::open( filename.c_str(), O_RDONLY );
+        if ( fd < 0 ) {
+            std::cerr << "Failed to open file: " << filename << '\n';
+            return;
+        }
+
+        struct stat file_stat;
+        if ( fstat( fd, &file_stat ) < 0 ) {
+            std::cerr << "Failed to stat file: " << filename << '\n';
+            ::close( fd );
+            return;
+        }
+
+        m_size = static_cast<size_t>( file_stat.st_size );
+        m_open = true;
+
+        if ( m_size > 0 ) {
+            void* map = mmap( nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+            if ( map == MAP_FAILED ) {
+                std::cerr << "Failed to map file: " << filename << '\n';
+                m_size = 0;
+                m_open = false;
+            } else {
+                // read ahead aggressively and let the kernel drop pages behind the reader
+                madvise( map, m_size, MADV_SEQUENTIAL );
+                m_data = static_cast<const uint8_t*>( map );
+                m_mapped = true;
+            }
+        }
+
+        // the mapping keeps the file alive on its own
+        ::close( fd );
+    }
+
+    capture_file::~capture_file() {
+        if ( m_mapped ) munmap( const_cast<uint8_t*>( m_data ), m_size );
+    }
+
+#else
+
+    capture_file::capture_file( const std::string& filename )
+        : m_data( nullptr ), m_size( 0 ), m_open( false ), m_mapped( false ) {
+
+        std::ifstream file( filename, std::ios::binary | std::ios::ate );
+        if ( !file.is_open() ) {
+            std::cerr << "Failed to open file: " << filename << '\n';
+            return;
+        }
+
+        m_contents.resize( static_cast<size_t>( file.tellg() ) );
+        file.seekg( 0 );
+        file.read( reinterpret_cast<char*>( m_contents.data() ), m_contents.size() );
+
+        m_data = m_contents.data();
+        m_size = m_contents.size();
+        m_open = true;
+    }
+
+    capture_file::~capture_file() {}
+
+#endif
+
+    bool capture_file::is_open() const {
+        return m_open;
+    }
+
+    capture_format capture_file::format() const {
+        return detect_capture_format( std::span<const uint8_t>( m_data, m_size ) );
+    }
+
+    uint32_t capture_file::datalink() const {
+        return capture_cursor( std::span<const uint8_t>( m_data, m_size ) ).datalink();
+    }
+
+    size_t capture_file::size_bytes() const {
+        return m_size;
+    }
+
+    std::span<const uint8_t> capture_file::bytes() const {
+        return std::span<const uint8_t>( m_data, m_size );
+    }
+
+    capture_file::iterator capture_file::begin() const {
+        return iterator( std::span<const uint8_t>( m_data, m_size ) );
+    }
+
+    capture_file::iterator capture_file::end() const {
+        return iterator();
+    }
+
+    std::unordered_set<four_tuple> get_four_tuples( const capture_file& packets ) {
+
+        std::unordered_set<four_tuple> four_tuples;
+        std::unordered_set<flow_key,flow_key_hash> seen;
+
+        for ( auto packet : packets ) {
+            auto four = get_four_from_ethernet( packet.data() );
+            if ( seen.insert( four ).second ) four_tuples.insert( four );
+        }
+
+        return four_tuples;
+    }
+
+    tcp_stream get_merged_tcp_stream( const capture_file& packets ) {
+
+        std::vector<raw_tcp_frame> raw_stream;
+
+        for ( auto packet : packets ) {
+            auto frame = extract_raw_tcp_frame( packet.data() );
+            if ( frame ) raw_stream.push_back( std::move( *frame ) );
+        }
+
+        return merge_tcp_stream_non_overlapping( get_tcp_stream( raw_stream ) );
+    }
+
+} // namespace ntk
@@ -0,0 +1,163 @@
+#include <capture_loader.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <thread>
+
+#include <capture_file.hpp>
+#include <hex.hpp>
+#include <pcap_file.hpp>
+
+namespace ntk {
+
+    namespace {
+
+        // work( 0 ) runs on the calling thread, the other parts on threads of their own
+        template<typename Work>
+        void run_parts( size_t parts, Work&& work ) {
+            std::vector<std::thread> workers;
+            workers.reserve( parts - 1 );
+            for ( size_t part = 1; part < parts; ++part ) workers.emplace_back( work, part );
+            work( 0 );
+            for ( auto& worker : workers ) worker.join();
+        }
+
+        // starts of the ranges and the end of the last, each moved forward to just past a newline
+        std::vector<size_t> line_aligned_bounds( std::string_view text, size_t parts ) {
+
+            std::vector<size_t> bounds{ 0 };
+
+            for ( size_t part = 1; part < parts; ++part ) {
+                size_t at = std::max( bounds.back(), text.size() / parts * part );
+                size_t newline = text.find( '\n', at );
+                at = newline == std::string_view::npos ? text.size() : newline + 1;
+                if ( at > bounds.back() && at < text.size() ) bounds.push_back( at );
+            }
+
+            bounds.push_back( text.size() );
+            return bounds;
+        }
+
+    } // namespace
+
+    size_t packet_arena::size() const {
+        return m_offsets.size() - 1;
+    }
+
+    bool packet_arena::empty() const {
+        return size() == 0;
+    }
+
+    size_t packet_arena::size_bytes() const {
+        return m_offsets.back();
+    }
+
+    std::span<const uint8_t> packet_arena::operator[]( size_t i ) const {
+        return std::span<const uint8_t>( m_bytes.get() + m_offsets[ i ], m_offsets[ i + 1 ] - m_offsets[ i ] );
+    }
+
+    session packet_arena::to_session() const {
+        session packets;
+        packets.reserve( size() );
+        for ( size_t i = 0; i < size(); ++i ) {
+            auto packet = ( *this )[ i ];
+            packets.emplace_back( packet.begin(), packet.end() );
+        }
+        return packets;
+    }
+
+    packet_arena load_packets( const std::string& filename, size_t threads ) {
+
+        packet_arena arena;
+
+        capture_file file( filename );
+        if ( !file.is_open() ) return arena;
+
+        if ( threads == 0 ) threads = std::max( 1u, std::thread::hardware_concurrency() );
+
+        auto capture = file.bytes();
+
+        if ( file.format() == capture_format::HEX ) {
+
+            std::string_view text( reinterpret_cast<const char*>( capture.data() ), capture.size() );
+            auto bounds = line_aligned_bounds( text, threads );
+            size_t parts = bounds.size() - 1;
+
+            /*
+                no range can decode to more than max_decoded_hex_len of its text, so each
+                gets that much of the arena up front and decodes without waiting on the
+                ranges before it. the ranges are then moved down to close the gaps
+            */
+            std::vector<size_t> regions( parts + 1, 0 );
+            for ( size_t part = 0; part < parts; ++part ) {
+                regions[ part + 1 ] = regions[ part ] + max_decoded_hex_len( bounds[ part + 1 ] - bounds[ part ] );
+            }
+
+            arena.m_bytes = std::make_unique_for_overwrite<uint8_t[]>( regions.back() );
+            std::vector<std::vector<size_t>> ends( parts );
+
+            run_parts( parts, [&]( size_t part ) {
+
+                uint8_t* out = arena.m_bytes.get() + regions[ part ];
+                size_t written = 0;
+                size_t offset = bounds[ part ];
+
+                while ( offset < bounds[ part + 1 ] ) {
+                    size_t newline = text.find( '\n', offset );
+                    size_t line_end = std::min( newline == std::string_view::npos ? text.size() : newline, bounds[ part + 1 ] );
+
+                    size_t decoded = decode_hex_line( text.substr( offset, line_end - offset ), out + written );
+                    // blank lines carry no packet, as in capture_cursor
+                    if ( decoded ) {
+                        written += decoded;
+                        ends[ part ].push_back( written );
+                    }
+                    offset = line_end + 1;
+                }
+            });
+
+            size_t packet_count = 0;
+            for ( auto& part_ends : ends ) packet_count += part_ends.size();
+            arena.m_offsets.reserve( packet_count + 1 );
+
+            for ( size_t part = 0; part < parts; ++part ) {
+                size_t start = arena.m_offsets.back();
+                if ( ends[ part ].empty() ) continue;
+                if ( start != regions[ part ] ) {
+                    std::memmove( arena.m_bytes.get() + start, arena.m_bytes.get() + regions[ part ], ends[ part ].back() );
+                }
+                for ( size_t end : ends[ part ] ) arena.m_offsets.push_back( start + end );
+            }
+
+            return arena;
+        }
+
+        // pcap and pcapng have no marker to resync on, the record headers are walked once to find the boundaries
+        std::vector<std::span<const uint8_t>> records;
+        capture_cursor cursor( capture );
+        while ( auto record = cursor.next() ) records.push_back( record->data );
+
+        arena.m_offsets.resize( records.size() + 1 );
+        for ( size_t i = 0; i < records.size(); ++i ) arena.m_offsets[ i + 1 ] = arena.m_offsets[ i ] + records[ i ].size();
+
+        arena.m_bytes = std::make_unique_for_overwrite<uint8_t[]>( arena.m_offsets.back() );
+
+        // the ranges split the bytes evenly, not the records
+        size_t parts = std::max<size_t>( 1, std::min( threads, records.size() ) );
+        std::vector<size_t> firsts( parts + 1, records.size() );
+        for ( size_t part = 0; part < parts; ++part ) {
+            size_t target = arena.m_offsets.back() / parts * part;
+            firsts[ part ] = std::lower_bound( arena.m_offsets.begin(), arena.m_offsets.end() - 1, target ) - arena.m_offsets.begin();
+        }
+
+        run_parts( parts, [&]( size_t part ) {
+            for ( size_t i = firsts[ part ]; i < firsts[ part + 1 ]; ++i ) {
+                if ( !records[ i ].empty() ) std::memcpy( arena.m_bytes.get() + arena.m_offsets[ i ], records[ i ].data(), records[ i ].size() );
+            }
+        });
+
+        return arena;
+    }
+
+} // namespace ntk
@@ -0,0 +1,159 @@
+#include <capture_manager.hpp>
+
+#include <algorithm>
+#include <array>
+
+namespace ntk {
+
+    capture_manager::interface::interface( const interface_capture& capture )
+        : capture( capture ) {}
+
+    capture_manager::capture_manager( tcp_sharded_session& session )
+        : m_session( session ), m_stop( false ), m_running( false ) {}
+
+    capture_manager::~capture_manager() {
+        stop();
+    }
+
+    size_t capture_manager::add_interface( const interface_capture& capture ) {
+        m_interfaces.push_back( std::make_unique<interface>( capture ) );
+        return m_interfaces.size() - 1;
+    }
+
+    bool capture_manager::start() {
+
+        if ( m_running || m_interfaces.empty() ) return false;
+
+        m_stop = false;
+        m_running = true;
+
+        for ( auto& i : m_interfaces ) {
+
+            // the listener keeps the device name as a pointer, the interface outlives it
+            i->listener = std::make_unique<packet_listener>( i->capture.device.c_str(), i->capture.filter.c_str(),
+                                                             i->capture.backend, i->capture.ring_options, i->capture.options );
+
+            bool started = i->listener->start( [ ring = &i->ring, stopping = &m_stop ]( const struct pcap_pkthdr* header, const unsigned char* packet ) {
+                auto frame = make_captured_packet( header, packet );
+                // lossless, a full ring holds the capture thread back until the merge thread catches up. stop() sets
+                // the flag only once the listeners are joined, so it is seen here just when start() gives up
+                while ( !ring->push( std::move( frame ) ) ) {
+                    if ( stopping->load( std::memory_order_acquire ) ) return;
+                    std::this_thread::yield();
+                }
+            });
+
+            // the session decodes every frame as its one link type, a device delivering another is refused
+            if ( !started || i->listener->link() != m_session.link() ) {
+                // no merge thread yet, a capture thread waiting on a full ring lets go
+                m_stop.store( true, std::memory_order_release );
+                stop();
+                // nothing captured before the refusal reaches the session
+                captured_packet discarded;
+                for ( auto& other : m_interfaces ) {
+                    while ( other->ring.pop( discarded ) ) {}
+                }
+                return false;
+            }
+        }
+
+        // once every device is known to fit the session
+        m_merge_thread = std::thread( [ this ]() { merge(); } );
+
+        return true;
+    }
+
+    void capture_manager::merge() {
+
+        std::array<captured_packet,32> batch;
+
+        while ( true ) {
+
+            size_t moved = 0;
+
+            // a batch from each in turn, so a busy device does not hold the others' frames back
+            for ( auto& i : m_interfaces ) {
+                size_t n = i->ring.pop_bulk( batch );
+                for ( size_t k = 0; k < n; ++k ) m_session.feed( std::move( batch[ k ] ) );
+                i->merged.add( n );
+                moved += n;
+            }
+
+            if ( moved == 0 ) {
+                // the listeners are stopped before the flag is set, so rings empty after seeing it are final
+                if ( m_stop.load( std::memory_order_acquire ) &&
+                     std::ranges::all_of( m_interfaces, []( const auto& i ) { return i->ring.empty(); } ) ) break;
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void capture_manager::stop() {
+
+        if ( !m_running ) return;
+
+        // no frame is pushed once every capture thread has been joined
+        for ( auto& i : m_interfaces ) {
+            if ( i->listener ) i->listener->stop();
+        }
+
+        m_stop.store( true, std::memory_order_release );
+        if ( m_merge_thread.joinable() ) m_merge_thread.join();
+        m_running = false;
+    }
+
+    std::expected<void,std::string> capture_manager::set_filter( const std::string& filter_exp ) {
+
+        std::vector<std::string> previous;
+
+        for ( size_t index = 0; index < m_interfaces.size(); ++index ) {
+
+            previous.push_back( m_interfaces[ index ]->capture.filter );
+            auto swapped = set_filter( index, filter_exp );
+            if ( swapped ) continue;
+
+            for ( size_t undo = 0; undo < index; ++undo ) set_filter( undo, previous[ undo ] );
+            return std::unexpected( m_interfaces[ index ]->capture.device + ": " + swapped.error() );
+        }
+
+        return {};
+    }
+
+    std::expected<void,std::string> capture_manager::set_filter( size_t interface_index, const std::string& filter_exp ) {
+
+        if ( interface_index >= m_interfaces.size() ) return std::unexpected( "no interface " + std::to_string( interface_index ) );
+
+        auto& i = *m_interfaces[ interface_index ];
+        if ( i.listener ) {
+            auto swapped = i.listener->set_filter( filter_exp );
+            if ( !swapped ) return swapped;
+        }
+
+        // and for the next start()
+        i.capture.filter = filter_exp;
+        return {};
+    }
+
+    size_t capture_manager::number_of_interfaces() const {
+        return m_interfaces.size();
+    }
+
+    std::vector<interface_statistics> capture_manager::statistics() {
+
+        std::vector<interface_statistics> all;
+        all.reserve( m_interfaces.size() );
+
+        for ( auto& i : m_interfaces ) {
+            all.push_back( interface_statistics{
+                .device = i->capture.device,
+                .filter = i->capture.filter,
+                .capture = i->listener ? i->listener->statistics() : capture_statistics{ 0, 0, 0, 0, {} },
+                .frames_merged = i->merged.value(),
+                .hand_off = i->ring.statistics()
+            });
+        }
+
+        return all;
+    }
+
+} // namespace ntk
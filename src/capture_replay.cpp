@@ -0,0 +1,275 @@
+#include <capture_replay.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+#include <capture_file.hpp>
+#include <constants.hpp>
+
+namespace ntk {
+
+    namespace {
+
+        uint16_t read_u16( const uint8_t* p ) {
+            return static_cast<uint16_t>( ( p[ 0 ] << 8 ) | p[ 1 ] );
+        }
+
+        void write_u16( uint8_t* p, uint16_t value ) {
+            p[ 0 ] = static_cast<uint8_t>( value >> 8 );
+            p[ 1 ] = static_cast<uint8_t>( value );
+        }
+
+        // rfc 1624, HC' = ~( ~HC + ~m + m' )
+        uint16_t update_checksum( uint16_t checksum, uint16_t old_word, uint16_t new_word ) {
+            uint32_t sum = static_cast<uint16_t>( ~checksum ) + static_cast<uint16_t>( ~old_word ) + new_word;
+            sum = ( sum & 0xffff ) + ( sum >> 16 );
+            sum = ( sum & 0xffff ) + ( sum >> 16 );
+            return static_cast<uint16_t>( ~sum );
+        }
+
+        std::chrono::nanoseconds record_time( const capture_record& record ) {
+            return std::chrono::seconds( record.ts_sec ) + std::chrono::microseconds( record.ts_usec );
+        }
+
+    } // namespace
+
+    double replay_statistics::packets_per_second() const {
+        if ( elapsed.count() <= 0 ) return 0;
+        return static_cast<double>( packets ) / std::chrono::duration<double>( elapsed ).count();
+    }
+
+    double replay_statistics::bits_per_second() const {
+        if ( elapsed.count() <= 0 ) return 0;
+        return static_cast<double>( bytes ) * 8 / std::chrono::duration<double>( elapsed ).count();
+    }
+
+    bool offset_ephemeral_port( std::span<uint8_t> frame, uint16_t offset ) {
+
+        const size_t eth = constants::ethernet_header_len;
+
+        if ( frame.size() < eth + 20 ) return false;
+        if ( read_u16( frame.data() + 12 ) != 0x0800 ) return false;
+
+        uint8_t* ip = frame.data() + eth;
+        if ( ( ip[ 0 ] >> 4 ) != 4 || ip[ 9 ] != 6 ) return false;
+
+        size_t ihl = static_cast<size_t>( ip[ 0 ] & 0x0f ) * 4;
+        if ( ihl < 20 || frame.size() < eth + ihl + 18 ) return false;
+
+        uint8_t* tcp = ip + ihl;
+        uint16_t source_port = read_u16( tcp );
+        uint16_t destination_port = read_u16( tcp + 2 );
+
+        uint8_t* port = source_port > destination_port ? tcp : tcp + 2;
+        uint16_t old_port = read_u16( port );
+        uint16_t new_port = static_cast<uint16_t>( old_port + offset );
+
+        write_u16( port, new_port );
+        write_u16( tcp + 16, update_checksum( read_u16( tcp + 16 ), old_port, new_port ) );
+
+        return true;
+    }
+
+    capture_replay::capture_replay( const std::string& filename, const replay_options& options )
+        : m_options( options ), m_open( false ), m_capturing( false ), m_stop( false ),
+          m_packets( 0 ), m_bytes( 0 ), m_elapsed( 0 ), m_max_lag( 0 ) {
+
+        capture_file file( filename );
+        if ( !file.is_open() ) {
+            std::cerr << "Failed to open capture for replay: " << filename << '\n';
+            return;
+        }
+
+        for ( auto it = file.begin(); it != file.end(); ++it ) {
+            auto& record = it.record();
+            auto bytes = *it;
+            m_records.push_back( capture_record{ record.ts_sec, record.ts_usec, record.len, { bytes.begin(), bytes.end() } } );
+        }
+
+        m_open = true;
+    }
+
+    capture_replay::~capture_replay() {
+        stop();
+    }
+
+    bool capture_replay::is_open() const {
+        return m_open;
+    }
+
+    size_t capture_replay::frame_count() const {
+        return m_records.size();
+    }
+
+    bool capture_replay::start( packet_callback callback ) {
+
+        if ( !m_open || m_capturing ) return false;
+        if ( m_replay_thread.joinable() ) m_replay_thread.join();
+
+        m_callback = std::move( callback );
+        m_stop = false;
+        m_packets = 0;
+        m_bytes = 0;
+        m_elapsed = 0;
+        m_max_lag = 0;
+
+        m_capturing = true;
+        m_replay_thread = std::thread( [ this ]() {
+            if ( !m_placement.empty() ) apply_placement( m_placement );
+            run();
+            m_capturing = false;
+        });
+
+        return true;
+    }
+
+    bool capture_replay::start_batch( packet_batch_callback callback ) {
+
+        return start( [ callback = std::move( callback ) ]( const struct pcap_pkthdr* header, const unsigned char* packet ) {
+            capture_frame frame{ *header, packet };
+            callback( std::span<const capture_frame>( &frame, 1 ) );
+        });
+    }
+
+    bool capture_replay::start( packet_pool& pool, packet_view_callback callback ) {
+
+        return start( [ this, &pool, callback = std::move( callback ) ]( const struct pcap_pkthdr* header, const unsigned char* packet ) {
+            auto view = pool.acquire( packet, header->caplen );
+            if ( view ) {
+                callback( std::move( *view ) );
+            } else {
+                m_pool_exhausted.add();
+            }
+        });
+    }
+
+    void capture_replay::stop() {
+        m_stop = true;
+        wait();
+    }
+
+    void capture_replay::wait() {
+        if ( m_replay_thread.joinable() ) m_replay_thread.join();
+    }
+
+    bool capture_replay::is_capturing() const {
+        return m_capturing;
+    }
+
+    void capture_replay::place_capture_thread( const thread_placement& placement ) {
+        m_placement = placement;
+    }
+
+    capture_statistics capture_replay::statistics() const {
+        return capture_statistics{ m_packets.load( std::memory_order_relaxed ), 0, 0, m_pool_exhausted.value() };
+    }
+
+    replay_statistics capture_replay::report() const {
+        return replay_statistics{
+            m_packets.load( std::memory_order_relaxed ),
+            m_bytes.load( std::memory_order_relaxed ),
+            std::chrono::nanoseconds( m_elapsed.load( std::memory_order_relaxed ) ),
+            std::chrono::nanoseconds( m_max_lag.load( std::memory_order_relaxed ) )
+        };
+    }
+
+    bool capture_replay::wait_until( std::chrono::steady_clock::time_point due ) {
+
+        using namespace std::chrono_literals;
+
+        // sleep most of a long gap, spin the rest
+        while ( !m_stop ) {
+            auto now = std::chrono::steady_clock::now();
+            if ( now >= due ) return true;
+            if ( due - now > 200us ) {
+                std::this_thread::sleep_for( std::min<std::chrono::nanoseconds>( due - now - 100us, 10ms ) );
+            }
+        }
+
+        return false;
+    }
+
+    void capture_replay::run() {
+
+        if ( m_records.empty() ) return;
+
+        const auto first = record_time( m_records.front() );
+        const auto span = record_time( m_records.back() ) - first;
+        const double speed = m_options.speed > 0 ? m_options.speed : 1.0;
+        const size_t copies = std::max<size_t>( m_options.flow_copies, 1 );
+
+        std::vector<uint8_t> scratch;
+        uint64_t sent = 0;
+        uint64_t bits = 0;
+        int64_t max_lag = 0;
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for ( size_t loop = 0; loop < m_options.loops && !m_stop; ++loop ) {
+
+            for ( size_t i = 0; i < m_records.size() && !m_stop; ++i ) {
+
+                auto& record = m_records[ i ];
+
+                for ( size_t copy = 0; copy < copies && !m_stop; ++copy ) {
+
+                    // the first copy of the first loop goes out as recorded
+                    size_t flow = loop * copies + copy;
+
+                    const uint8_t* data = record.data.data();
+                    if ( flow > 0 ) {
+                        scratch.assign( record.data.begin(), record.data.end() );
+                        // only tcp can be told apart as a new flow, the rest is sent once
+                        if ( !offset_ephemeral_port( scratch, static_cast<uint16_t>( flow ) ) ) continue;
+                        data = scratch.data();
+                    }
+
+                    std::chrono::nanoseconds offset{ 0 };
+                    switch ( m_options.pacing ) {
+                        case replay_pacing::ORIGINAL:
+                            offset = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                ( ( record_time( record ) - first ) + span * loop ) / speed );
+                            break;
+                        case replay_pacing::PACKETS_PER_SECOND:
+                            if ( m_options.rate > 0 ) offset = std::chrono::nanoseconds( static_cast<int64_t>( sent * 1e9 / m_options.rate ) );
+                            break;
+                        case replay_pacing::BITS_PER_SECOND:
+                            if ( m_options.rate > 0 ) offset = std::chrono::nanoseconds( static_cast<int64_t>( bits * 1e9 / m_options.rate ) );
+                            break;
+                        case replay_pacing::UNPACED:
+                            break;
+                    }
+
+                    auto due = start + offset;
+                    if ( m_options.pacing != replay_pacing::UNPACED && !wait_until( due ) ) break;
+
+                    auto now = std::chrono::steady_clock::now();
+                    max_lag = std::max<int64_t>( max_lag, ( now - due ).count() );
+
+                    struct pcap_pkthdr header{};
+                    if ( m_options.restamp ) {
+                        auto wall = std::chrono::duration_cast<std::chrono::microseconds>( capture_clock::now().time_since_epoch() ).count();
+                        header.ts.tv_sec = static_cast<decltype( header.ts.tv_sec )>( wall / 1000000 );
+                        header.ts.tv_usec = static_cast<decltype( header.ts.tv_usec )>( wall % 1000000 );
+                    } else {
+                        header.ts.tv_sec = record.ts_sec;
+                        header.ts.tv_usec = record.ts_usec;
+                    }
+                    header.caplen = static_cast<bpf_u_int32>( record.data.size() );
+                    header.len = record.len ? record.len : header.caplen;
+
+                    m_callback( &header, data );
+
+                    ++sent;
+                    bits += static_cast<uint64_t>( header.len ) * 8;
+                    m_packets.store( sent, std::memory_order_relaxed );
+                    m_bytes.store( bits / 8, std::memory_order_relaxed );
+                }
+            }
+        }
+
+        m_elapsed = ( std::chrono::steady_clock::now() - start ).count();
+        m_max_lag = max_lag;
+    }
+
+} // namespace ntk
@@ -0,0 +1,27 @@
+#include <captured_packet.hpp>
+
+namespace ntk {
+
+    capture_time to_capture_time( uint32_t ts_sec, uint32_t ts_usec ) {
+        return capture_time( std::chrono::seconds( ts_sec ) + std::chrono::microseconds( ts_usec ) );
+    }
+
+    captured_packet make_captured_packet( uint32_t ts_sec, uint32_t ts_usec, uint32_t len, std::span<const uint8_t> bytes ) {
+        return captured_packet{
+            .timestamp = to_capture_time( ts_sec, ts_usec ),
+            .caplen = static_cast<uint32_t>( bytes.size() ),
+            .len = len,
+            .bytes = std::vector<uint8_t>( bytes.begin(), bytes.end() )
+        };
+    }
+
+    captured_packet make_captured_packet( capture_time timestamp, std::span<const uint8_t> bytes ) {
+        return captured_packet{
+            .timestamp = timestamp,
+            .caplen = static_cast<uint32_t>( bytes.size() ),
+            .len = static_cast<uint32_t>( bytes.size() ),
+            .bytes = std::vector<uint8_t>( bytes.begin(), bytes.end() )
+        };
+    }
+
+} // namespace ntk
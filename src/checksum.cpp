@@ -0,0 +1,265 @@
+#include <checksum.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+#include <decoded_packet.hpp>
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define NTK_CHECKSUM_X86 1
+#include <immintrin.h>
+#elif defined( __aarch64__ )
+#define NTK_CHECKSUM_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace ntk {
+
+    namespace {
+
+        constexpr uint8_t tcp_protocol = 6;
+
+        // shorter spans, an ip header or a pure ack, are not worth leaving the scalar loop for
+        constexpr size_t min_vector_len = 64;
+
+        // blocks one 32 bit accumulator lane can take, two words of at most 0xffff each per block
+        constexpr size_t max_blocks_per_lane = size_t( 1 ) << 15;
+
+        uint16_t read_u16( const uint8_t* p ) {
+            return static_cast<uint16_t>( ( p[ 0 ] << 8 ) | p[ 1 ] );
+        }
+
+        // a 32 bit word is its two halves modulo 0xffff, so wide words fold to the same sum
+        uint64_t native_sum_scalar( const uint8_t* data, size_t len ) {
+
+            uint64_t sum = 0;
+            size_t i = 0;
+
+            for ( ; i + 8 <= len; i += 8 ) {
+                uint32_t a, b;
+                std::memcpy( &a, data + i, 4 );
+                std::memcpy( &b, data + i + 4, 4 );
+                sum += a;
+                sum += b;
+            }
+
+            for ( ; i + 2 <= len; i += 2 ) {
+                uint16_t word;
+                std::memcpy( &word, data + i, 2 );
+                sum += word;
+            }
+
+            // the odd byte is the first of a word whose second is zero, in memory order
+            if ( i < len ) {
+                uint16_t word = 0;
+                std::memcpy( &word, data + i, 1 );
+                sum += word;
+            }
+
+            return sum;
+        }
+
+        uint16_t fold( uint64_t sum ) {
+            while ( sum >> 16 ) sum = ( sum & 0xffff ) + ( sum >> 16 );
+            auto folded = static_cast<uint16_t>( sum );
+            if constexpr ( std::endian::native == std::endian::little ) folded = std::byteswap( folded );
+            return folded;
+        }
+
+        /*
+            a kernel sums whole blocks from the start of data and reports how many bytes
+            it covered, the scalar loop takes the rest
+        */
+        struct sum_kernel {
+            uint64_t ( *sum )( const uint8_t* data, size_t len, size_t& covered );
+            const char* name;
+        };
+
+#ifdef NTK_CHECKSUM_X86
+
+        // 32 bytes per block, widened to 32 bit lanes and drained to 64 bits before a lane can overflow
+        __attribute__(( target( "avx2" ) ))
+        uint64_t native_sum_avx2( const uint8_t* data, size_t len, size_t& covered ) {
+
+            const __m256i zero = _mm256_setzero_si256();
+            uint64_t total = 0;
+            size_t i = 0;
+
+            while ( len - i >= 32 ) {
+
+                size_t blocks = std::min( ( len - i ) / 32, max_blocks_per_lane );
+                __m256i lanes = zero;
+
+                for ( size_t b = 0; b < blocks; ++b, i += 32 ) {
+                    __m256i words = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data + i ) );
+                    lanes = _mm256_add_epi32( lanes, _mm256_unpacklo_epi16( words, zero ) );
+                    lanes = _mm256_add_epi32( lanes, _mm256_unpackhi_epi16( words, zero ) );
+                }
+
+                __m256i wide = _mm256_add_epi64( _mm256_unpacklo_epi32( lanes, zero ), _mm256_unpackhi_epi32( lanes, zero ) );
+                alignas( 32 ) std::array<uint64_t,4> parts;
+                _mm256_store_si256( reinterpret_cast<__m256i*>( parts.data() ), wide );
+                total += parts[ 0 ] + parts[ 1 ] + parts[ 2 ] + parts[ 3 ];
+            }
+
+            covered = i;
+            return total;
+        }
+
+#endif
+
+#ifdef NTK_CHECKSUM_NEON
+
+        // 16 bytes per block, pairwise added into 32 bit lanes and drained like the avx2 kernel
+        uint64_t native_sum_neon( const uint8_t* data, size_t len, size_t& covered ) {
+
+            uint64_t total = 0;
+            size_t i = 0;
+
+            while ( len - i >= 16 ) {
+
+                size_t blocks = std::min( ( len - i ) / 16, max_blocks_per_lane );
+                uint32x4_t lanes = vdupq_n_u32( 0 );
+
+                for ( size_t b = 0; b < blocks; ++b, i += 16 ) {
+                    lanes = vpadalq_u16( lanes, vreinterpretq_u16_u8( vld1q_u8( data + i ) ) );
+                }
+
+                total += vaddlvq_u32( lanes );
+            }
+
+            covered = i;
+            return total;
+        }
+
+#endif
+
+        // chosen once for the running cpu, no kernel means scalar
+        const sum_kernel* selected_kernel() {
+            static const sum_kernel* selected = []() -> const sum_kernel* {
+#ifdef NTK_CHECKSUM_X86
+                static const sum_kernel avx2{ native_sum_avx2, "avx2" };
+                if ( __builtin_cpu_supports( "avx2" ) ) return &avx2;
+#endif
+#ifdef NTK_CHECKSUM_NEON
+                static const sum_kernel neon{ native_sum_neon, "neon" };
+                return &neon;
+#endif
+                return nullptr;
+            }();
+            return selected;
+        }
+
+        uint16_t pseudo_header_sum( const decoded_packet& packet, uint32_t tcp_len ) {
+
+            if ( packet.ip_version == 4 ) {
+                uint32_t source = packet.source_ip.v4();
+                uint32_t destination = packet.destination_ip.v4();
+                std::array<uint8_t,12> pseudo = {
+                    static_cast<uint8_t>( source >> 24 ), static_cast<uint8_t>( source >> 16 ), static_cast<uint8_t>( source >> 8 ), static_cast<uint8_t>( source ),
+                    static_cast<uint8_t>( destination >> 24 ), static_cast<uint8_t>( destination >> 16 ), static_cast<uint8_t>( destination >> 8 ), static_cast<uint8_t>( destination ),
+                    0x00, tcp_protocol, static_cast<uint8_t>( tcp_len >> 8 ), static_cast<uint8_t>( tcp_len )
+                };
+                return ones_complement_sum_scalar( pseudo );
+            }
+
+            // rfc 8200 8.1, a 32 bit upper-layer length and the next header in the last byte
+            std::array<uint8_t,40> pseudo{};
+            auto source = packet.source_ip.bytes();
+            auto destination = packet.destination_ip.bytes();
+            std::memcpy( pseudo.data(), source.data(), 16 );
+            std::memcpy( pseudo.data() + 16, destination.data(), 16 );
+            pseudo[ 32 ] = static_cast<uint8_t>( tcp_len >> 24 );
+            pseudo[ 33 ] = static_cast<uint8_t>( tcp_len >> 16 );
+            pseudo[ 34 ] = static_cast<uint8_t>( tcp_len >> 8 );
+            pseudo[ 35 ] = static_cast<uint8_t>( tcp_len );
+            pseudo[ 39 ] = tcp_protocol;
+            return ones_complement_sum_scalar( pseudo );
+        }
+
+    } // namespace
+
+    uint16_t ones_complement_sum_scalar( std::span<const uint8_t> data ) {
+        return fold( native_sum_scalar( data.data(), data.size() ) );
+    }
+
+    uint16_t ones_complement_sum( std::span<const uint8_t> data ) {
+
+        const sum_kernel* kernel = selected_kernel();
+        if ( !kernel || data.size() < min_vector_len ) return ones_complement_sum_scalar( data );
+
+        size_t covered = 0;
+        uint64_t sum = kernel->sum( data.data(), data.size(), covered );
+
+        // the kernels cover whole blocks, so the rest starts on an even offset
+        return fold( sum + native_sum_scalar( data.data() + covered, data.size() - covered ) );
+    }
+
+    const char* checksum_kernel_name() {
+        const sum_kernel* kernel = selected_kernel();
+        return kernel ? kernel->name : "scalar";
+    }
+
+    checksum_status verify_ipv4_header_checksum( std::span<const uint8_t> frame, size_t ip_offset ) {
+
+        if ( frame.size() < ip_offset + 20 ) return checksum_status::UNVERIFIABLE;
+
+        size_t header_len = ( frame[ ip_offset ] & 0x0f ) * 4;
+        if ( header_len < 20 || frame.size() < ip_offset + header_len ) return checksum_status::UNVERIFIABLE;
+
+        // summed with the checksum field in it, a valid header comes to all ones
+        if ( ones_complement_sum_scalar( frame.subspan( ip_offset, header_len ) ) == 0xffff ) return checksum_status::VALID;
+
+        return read_u16( frame.data() + ip_offset + 10 ) == 0 ? checksum_status::OFFLOADED : checksum_status::INVALID;
+    }
+
+    checksum_result verify_checksums( const decoded_packet& packet ) {
+
+        checksum_result result{ checksum_status::VALID, checksum_status::VALID };
+
+        if ( packet.ip_version == 4 ) result.ip = verify_ipv4_header_checksum( packet.frame, packet.network_offset );
+
+        // the segment has to be in the frame whole, and its length known from the ip header
+        if ( packet.ip_total_len < static_cast<uint32_t>( packet.ip_header_len ) + packet.tcp_header_len ||
+             packet.frame.size() < packet.network_offset + packet.ip_total_len ) {
+            result.tcp = checksum_status::UNVERIFIABLE;
+            return result;
+        }
+
+        uint32_t tcp_len = packet.ip_total_len - packet.ip_header_len;
+        size_t tcp_offset = packet.network_offset + packet.ip_header_len;
+
+        uint16_t pseudo = pseudo_header_sum( packet, tcp_len );
+        uint16_t sum = ones_complement_add( pseudo, ones_complement_sum( packet.frame.subspan( tcp_offset, tcp_len ) ) );
+
+        if ( sum == 0xffff ) return result;
+
+        // checksum offload leaves zero or, on linux, the pseudo header sum for the nic to finish
+        uint16_t field = read_u16( packet.frame.data() + tcp_offset + 16 );
+        result.tcp = field == 0 || field == pseudo ? checksum_status::OFFLOADED : checksum_status::INVALID;
+
+        return result;
+    }
+
+    void checksum_counters::count( const checksum_result& result ) {
+
+        if ( result.invalid() ) {
+            if ( result.ip == checksum_status::INVALID ) m_ip_invalid.add();
+            if ( result.tcp == checksum_status::INVALID ) m_tcp_invalid.add();
+        } else if ( result.ip == checksum_status::OFFLOADED || result.tcp == checksum_status::OFFLOADED ) {
+            m_offloaded.add();
+        } else if ( result.ip == checksum_status::UNVERIFIABLE || result.tcp == checksum_status::UNVERIFIABLE ) {
+            m_unverifiable.add();
+        } else {
+            m_verified.add();
+        }
+    }
+
+    checksum_statistics checksum_counters::statistics() const {
+        return checksum_statistics{ m_verified.value(), m_ip_invalid.value(), m_tcp_invalid.value(),
+                                    m_offloaded.value(), m_unverifiable.value() };
+    }
+
+} // namespace ntk
@@ -0,0 +1,218 @@
+#include <decoded_packet.hpp>
+#include <link_layer.hpp>
+#include <tcp.hpp>
+
+#include <algorithm>
+
+namespace ntk {
+
+    namespace {
+
+        uint16_t read_u16( const uint8_t* p ) {
+            return static_cast<uint16_t>( ( p[ 0 ] << 8 ) | p[ 1 ] );
+        }
+
+        uint32_t read_u32( const uint8_t* p ) {
+            return ( static_cast<uint32_t>( p[ 0 ] ) << 24 ) | ( static_cast<uint32_t>( p[ 1 ] ) << 16 ) |
+                   ( static_cast<uint32_t>( p[ 2 ] ) << 8 ) | p[ 3 ];
+        }
+
+        constexpr uint8_t ipv4_version = 4;
+        constexpr uint8_t ipv6_version = 6;
+        constexpr uint8_t tcp_protocol = 6;
+
+        // ipv6 next header values of the extension headers that may come before tcp or udp
+        constexpr uint8_t hop_by_hop_options = 0;
+        constexpr uint8_t routing_header = 43;
+        constexpr uint8_t fragment_header = 44;
+        constexpr uint8_t destination_options = 60;
+        constexpr size_t max_extension_headers = 8;
+
+        std::optional<decoded_packet> decode_tcp( std::span<const uint8_t> frame, const ip_layer& ip ) {
+
+            size_t tcp_offset = ip.offset + ip.header_len;
+
+            if ( frame.size() < tcp_offset + 20 ) return std::nullopt;
+
+            const uint8_t* tcp = frame.data() + tcp_offset;
+            size_t tcp_header_len = ( tcp[ 12 ] >> 4 ) * 4;
+            size_t payload_offset = tcp_offset + tcp_header_len;
+
+            if ( tcp_header_len < 20 || frame.size() < payload_offset ) return std::nullopt;
+
+            // a snaplen-truncated frame keeps whatever payload was captured
+            size_t payload_end = std::min( frame.size(), std::max( ip.end, payload_offset ) );
+
+            return decoded_packet{
+                .frame = frame,
+                .source_ip = ip.source_ip,
+                .destination_ip = ip.destination_ip,
+                .source_port = read_u16( tcp ),
+                .destination_port = read_u16( tcp + 2 ),
+                .sequence_number = read_u32( tcp + 4 ),
+                .acknowledgment_number = read_u32( tcp + 8 ),
+                .flags = tcp[ 13 ],
+                .window_size = read_u16( tcp + 14 ),
+                .ip_version = ip.version,
+                .network_offset = static_cast<uint16_t>( ip.offset ),
+                .ip_header_len = static_cast<uint16_t>( ip.header_len ),
+                .tcp_header_len = static_cast<uint16_t>( tcp_header_len ),
+                .ip_total_len = ip.total_len,
+                .raw_options = frame.subspan( tcp_offset + 20, tcp_header_len - 20 ),
+                .payload = frame.subspan( payload_offset, payload_end - payload_offset )
+            };
+        }
+
+        std::optional<ip_layer> decode_ipv4( std::span<const uint8_t> frame, size_t ip_offset, uint8_t protocol ) {
+
+            if ( frame.size() < ip_offset + 20 ) return std::nullopt;
+
+            const uint8_t* ip = frame.data() + ip_offset;
+
+            if ( ( ip[ 0 ] >> 4 ) != ipv4_version || ip[ 9 ] != protocol ) return std::nullopt;
+
+            // a fragment holds part of a segment or datagram at most, it is decoded once reassembled
+            if ( read_u16( ip + 6 ) & 0x3fff ) return std::nullopt;
+
+            size_t ip_header_len = ( ip[ 0 ] & 0x0f ) * 4;
+            if ( ip_header_len < 20 ) return std::nullopt;
+
+            uint16_t ip_total_len = read_u16( ip + 2 );
+
+            // a zero total length is left by segmentation offload, the payload then runs to the end of the frame
+            size_t ip_end = ip_total_len ? ip_offset + ip_total_len : frame.size();
+
+            return ip_layer{ read_u32( ip + 12 ), read_u32( ip + 16 ), ipv4_version, ip_offset, ip_header_len, ip_total_len, ip_end };
+        }
+
+        std::optional<ip_layer> decode_ipv6( std::span<const uint8_t> frame, size_t ip_offset, uint8_t protocol ) {
+
+            if ( frame.size() < ip_offset + 40 ) return std::nullopt;
+
+            const uint8_t* ip = frame.data() + ip_offset;
+
+            if ( ( ip[ 0 ] >> 4 ) != ipv6_version ) return std::nullopt;
+
+            uint8_t next_header = ip[ 6 ];
+            size_t header_len = 40;
+
+            for ( size_t n = 0; next_header != protocol; ++n ) {
+
+                if ( n == max_extension_headers || frame.size() < ip_offset + header_len + 8 ) return std::nullopt;
+
+                const uint8_t* extension = ip + header_len;
+
+                if ( next_header == fragment_header ) {
+                    // only an atomic fragment, offset zero and no more to come, carries a whole segment or datagram
+                    if ( read_u16( extension + 2 ) & 0xfff9 ) return std::nullopt;
+                    header_len += 8;
+                } else if ( next_header == hop_by_hop_options || next_header == routing_header || next_header == destination_options ) {
+                    header_len += ( extension[ 1 ] + 1 ) * 8;
+                } else {
+                    return std::nullopt;
+                }
+
+                next_header = extension[ 0 ];
+            }
+
+            uint16_t payload_len = read_u16( ip + 4 );
+
+            // a zero payload length is a jumbogram or segmentation offload, either way it runs to the end of the frame
+            size_t ip_end = payload_len ? ip_offset + 40 + payload_len : frame.size();
+
+            return ip_layer{ ip_address::from_bytes( frame.subspan( ip_offset + 8 ).first<16>() ),
+                             ip_address::from_bytes( frame.subspan( ip_offset + 24 ).first<16>() ),
+                             ipv6_version, ip_offset, header_len, 40u + payload_len, ip_end };
+        }
+
+    } // namespace
+
+    template<typename Link>
+    std::optional<ip_layer> decode_ip_as( std::span<const uint8_t> frame, uint8_t protocol ) {
+
+        auto network = Link::network( frame );
+        if ( !network ) return std::nullopt;
+
+        switch ( network->ethertype ) {
+            case ethertypes::ipv4: return decode_ipv4( frame, network->offset, protocol );
+            case ethertypes::ipv6: return decode_ipv6( frame, network->offset, protocol );
+            default: return std::nullopt;
+        }
+    }
+
+    template std::optional<ip_layer> decode_ip_as<ethernet_link>( std::span<const uint8_t> frame, uint8_t protocol );
+    template std::optional<ip_layer> decode_ip_as<linux_sll_link>( std::span<const uint8_t> frame, uint8_t protocol );
+
+    template<typename Link>
+    std::optional<decoded_packet> decode_packet_as( std::span<const uint8_t> frame ) {
+        auto ip = decode_ip_as<Link>( frame, tcp_protocol );
+        if ( !ip ) return std::nullopt;
+        return decode_tcp( frame, *ip );
+    }
+
+    template std::optional<decoded_packet> decode_packet_as<ethernet_link>( std::span<const uint8_t> frame );
+    template std::optional<decoded_packet> decode_packet_as<linux_sll_link>( std::span<const uint8_t> frame );
+
+    std::optional<decoded_packet> decode_packet( std::span<const uint8_t> frame ) {
+        return decode_packet_as<ethernet_link>( frame );
+    }
+
+    link_layer link_layer_of( link_type type ) {
+        return with_link_layer( type, []( auto link ) { return link_layer_of<decltype( link )>(); } );
+    }
+
+    std::optional<link_type> to_link_type( uint32_t datalink ) {
+        switch ( datalink ) {
+            case static_cast<uint32_t>( link_type::ETHERNET ): return link_type::ETHERNET;
+            case static_cast<uint32_t>( link_type::LINUX_SLL ): return link_type::LINUX_SLL;
+            default: return std::nullopt;
+        }
+    }
+
+    std::vector<tcp_option> decoded_packet::options() const {
+        return parse_tcp_options( raw_options );
+    }
+
+    std::vector<tcp_option> parse_tcp_options( std::span<const uint8_t> raw_options ) {
+
+        std::vector<tcp_option> options;
+
+        size_t index = 0;
+
+        while ( index < raw_options.size() ) {
+
+            uint8_t kind = raw_options[ index ];
+
+            if ( kind == 0 ) {
+                break;
+            } else if ( kind == 1 ) {
+                options.push_back( { kind, {} } );
+                index += 1;
+            } else {
+
+                if ( index + 1 >= raw_options.size() ) break;
+
+                uint8_t length = raw_options[ index + 1 ];
+
+                if ( length < 2 || index + length > raw_options.size() ) break;
+
+                std::vector<uint8_t> data( raw_options.begin() + index + 2, raw_options.begin() + index + length );
+
+                options.push_back( { kind, data } );
+
+                index += length;
+            }
+        }
+
+        return options;
+    }
+
+    bool is_same_connection( const decoded_packet& packet, const four_tuple& four ) {
+        bool ip_match = ( packet.source_ip == four.client_ip || packet.destination_ip == four.client_ip ) &&
+                        ( packet.source_ip == four.server_ip || packet.destination_ip == four.server_ip );
+        bool port_match = ( packet.source_port == four.client_port || packet.destination_port == four.client_port ) &&
+                          ( packet.source_port == four.server_port || packet.destination_port == four.server_port );
+        return ip_match && port_match;
+    }
+
+} // namespace ntk
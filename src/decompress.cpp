@@ -1,40 +1,180 @@
 #include <decompress.hpp> 
 
+#include <algorithm>
+#include <cctype>
+#include <utility>
+
 namespace ntk {
     
     std::string decompress_gzip( const std::vector<uint8_t>& compressed ) {
 
-        z_stream stream{};
-        stream.next_in = const_cast<Bytef*>( compressed.data() );
-        stream.avail_in = compressed.size();
+        inflater gzip( content_coding::GZIP );
+        std::string out_string;
+
+        auto inflated = gzip.feed( compressed, [&]( std::span<const uint8_t> output ) {
+            out_string.append( reinterpret_cast<const char*>( output.data() ), output.size() );
+        });
 
-        if ( inflateInit2( &stream, 16 + MAX_WBITS ) != Z_OK ) {
-            throw std::runtime_error( "inflateInit2 failed" );
+        if ( !inflated ) {
+            throw std::runtime_error( inflated.error() );
         }
 
-        char out_buffer[ 32768 ];
-        std::string out_string;
+        if ( !gzip.done() ) {
+            throw std::runtime_error( "inflate did not reach stream end" );
+        }
+
+        return out_string;
+    }
+
+    std::optional<content_coding> parse_content_coding( std::string_view content_encoding ) {
+
+        while ( !content_encoding.empty() && ( content_encoding.front() == ' ' || content_encoding.front() == '\t' ) ) content_encoding.remove_prefix( 1 );
+        while ( !content_encoding.empty() && ( content_encoding.back() == ' ' || content_encoding.back() == '\t' ) ) content_encoding.remove_suffix( 1 );
+
+        auto is = [&]( std::string_view name ) {
+            return content_encoding.size() == name.size() && std::equal( name.begin(), name.end(), content_encoding.begin(), []( char a, char b ) {
+                return a == std::tolower( static_cast<unsigned char>( b ) );
+            });
+        };
+
+        if ( content_encoding.empty() || is( "identity" ) ) return content_coding::IDENTITY;
+        if ( is( "gzip" ) || is( "x-gzip" ) ) return content_coding::GZIP;
+        if ( is( "deflate" ) ) return content_coding::DEFLATE;
+        return std::nullopt;
+    }
 
-        int ret;
+    inflater_pool::inflater_pool( size_t max_idle )
+        : m_max_idle( max_idle ) {}
 
-        do {
-            stream.next_out = reinterpret_cast<Bytef*>( out_buffer );
-            stream.avail_out = sizeof( out_buffer );
+    inflater_pool::~inflater_pool() {
+        for ( auto* ctx : m_idle ) {
+            inflateEnd( &ctx->stream );
+            delete ctx;
+        }
+    }
 
-            ret = inflate( &stream, 0 );
+    inflater_pool::context* inflater_pool::acquire( int window_bits ) {
 
-            if ( out_string.size() < stream.total_out ) {
-                out_string.append( out_buffer, stream.total_out - out_string.size() );
+        context* ctx = nullptr;
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            if ( !m_idle.empty() ) {
+                ctx = m_idle.back();
+                m_idle.pop_back();
             }
-        } while ( ret == Z_OK );
+        }
 
-        inflateEnd( &stream );
+        if ( ctx ) {
+            if ( inflateReset2( &ctx->stream, window_bits ) == Z_OK ) return ctx;
+            inflateEnd( &ctx->stream );
+            delete ctx;
+        }
 
-        if ( ret != Z_STREAM_END ) {
-            throw std::runtime_error( "inflate did not reach stream end" );
+        ctx = new context;
+        if ( inflateInit2( &ctx->stream, window_bits ) != Z_OK ) {
+            delete ctx;
+            return nullptr;
         }
+        return ctx;
+    }
 
-        return out_string;
+    void inflater_pool::release( context* ctx ) {
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            if ( m_idle.size() < m_max_idle ) {
+                m_idle.push_back( ctx );
+                return;
+            }
+        }
+        inflateEnd( &ctx->stream );
+        delete ctx;
+    }
+
+    size_t inflater_pool::idle() const {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        return m_idle.size();
+    }
+
+    inflater_pool& default_inflater_pool() {
+        static inflater_pool pool;
+        return pool;
+    }
+
+    inflater::inflater( content_coding coding, inflater_pool& pool )
+        : m_coding( coding ), m_pool( &pool ), m_context( nullptr ), m_done( false ), m_total_out( 0 ) {}
+
+    inflater::~inflater() {
+        release();
+    }
+
+    inflater::inflater( inflater&& other ) noexcept
+        : m_coding( other.m_coding ), m_pool( other.m_pool ), m_context( std::exchange( other.m_context, nullptr ) ),
+          m_done( other.m_done ), m_total_out( other.m_total_out ) {}
+
+    inflater& inflater::operator=( inflater&& other ) noexcept {
+        if ( this != &other ) {
+            release();
+            m_coding = other.m_coding;
+            m_pool = other.m_pool;
+            m_context = std::exchange( other.m_context, nullptr );
+            m_done = other.m_done;
+            m_total_out = other.m_total_out;
+        }
+        return *this;
+    }
+
+    void inflater::release() {
+        if ( m_context ) m_pool->release( std::exchange( m_context, nullptr ) );
+    }
+
+    std::expected<std::span<const uint8_t>,std::string> inflater::next( std::span<const uint8_t>& input, bool& more ) {
+
+        if ( !m_context ) {
+            int window_bits = 16 + MAX_WBITS;
+            if ( m_coding == content_coding::DEFLATE ) {
+                // a zlib header is a deflate method with a check that makes the first two bytes a multiple of 31
+                bool zlib = ( input[ 0 ] & 0x0f ) == 8 && ( input[ 0 ] >> 4 ) <= 7 &&
+                            ( input.size() < 2 || ( input[ 0 ] * 256 + input[ 1 ] ) % 31 == 0 );
+                window_bits = zlib ? MAX_WBITS : -MAX_WBITS;
+            }
+            m_context = m_pool->acquire( window_bits );
+            if ( !m_context ) return std::unexpected( "inflateInit2 failed" );
+        }
+
+        auto& stream = m_context->stream;
+        stream.next_in = const_cast<Bytef*>( input.data() );
+        stream.avail_in = static_cast<uInt>( input.size() );
+        stream.next_out = m_context->output.data();
+        stream.avail_out = static_cast<uInt>( m_context->output.size() );
+
+        int ret = ::inflate( &stream, Z_NO_FLUSH );
+
+        size_t produced = m_context->output.size() - stream.avail_out;
+        input = input.subspan( input.size() - stream.avail_in );
+        m_total_out += produced;
+
+        if ( ret == Z_STREAM_END ) {
+            // gzip members may follow one another
+            if ( m_coding == content_coding::GZIP && !input.empty() && input[ 0 ] == 0x1f ) {
+                inflateReset( &stream );
+            } else {
+                m_done = true;
+            }
+        } else if ( ret != Z_OK && ret != Z_BUF_ERROR ) {
+            return std::unexpected( stream.msg ? std::string( stream.msg ) : "inflate failed" );
+        }
+
+        // no progress could be made, the input ran out inside the stream
+        more = !m_done && ret != Z_BUF_ERROR && ( stream.avail_out == 0 || !input.empty() );
+        return std::span<const uint8_t>( m_context->output.data(), produced );
+    }
+
+    bool inflater::done() const {
+        return m_done;
+    }
+
+    size_t inflater::total_out() const {
+        return m_total_out;
     }
 
-} // namespace ntk
\ No newline at end of file
+} // namespace ntk
@@ -0,0 +1,44 @@
+#include <flow_index.hpp>
+#include <decoded_packet.hpp>
+
+namespace ntk {
+
+    flow_index::flow_index( const session& packets )
+        : m_packets( &packets ) {
+
+        for ( size_t i = 0; i < packets.size(); ++i ) {
+
+            auto decoded = decode_packet( packets[ i ] );
+            if ( !decoded ) continue;
+
+            auto four = decoded->four();
+            auto [ it, inserted ] = m_index.try_emplace( flow_key( four ), static_cast<uint32_t>( m_flows.size() ) );
+            if ( inserted ) m_flows.push_back( flow{ four, {} } );
+
+            auto& f = m_flows[ it->second ];
+            f.packets.push_back( flow_packet{ static_cast<uint32_t>( i ), four == f.four ? 0u : 1u } );
+        }
+    }
+
+    const session& flow_index::packets() const {
+        return *m_packets;
+    }
+
+    const std::vector<uint8_t>& flow_index::packet( const flow_packet& p ) const {
+        return ( *m_packets )[ p.index ];
+    }
+
+    const flow_index::flow* flow_index::find( const four_tuple& four ) const {
+        auto it = m_index.find( flow_key( four ) );
+        return it == m_index.end() ? nullptr : &m_flows[ it->second ];
+    }
+
+    const std::vector<flow_index::flow>& flow_index::flows() const {
+        return m_flows;
+    }
+
+    size_t flow_index::size() const {
+        return m_flows.size();
+    }
+
+} // namespace ntk
@@ -0,0 +1,406 @@
+#include <flow_index_file.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <capture_file.hpp>
+#include <decoded_packet.hpp>
+#include <hex.hpp>
+#include <link_layer.hpp>
+
+namespace ntk {
+
+    namespace {
+
+        constexpr char index_magic[ 8 ] = { 'N', 'T', 'K', 'F', 'L', 'O', 'W', 'S' };
+        constexpr uint32_t byte_order_mark = 0x01020304;
+
+        struct file_header {
+            char magic[ 8 ];
+            uint32_t version;
+            uint32_t byte_order;
+            uint64_t capture_size;
+            uint32_t capture_format;
+            uint32_t datalink;
+            uint64_t flow_count;
+            uint64_t packet_count;
+            uint64_t flows_offset;
+            uint64_t packets_offset;
+        };
+
+        static_assert( sizeof( file_header ) == 64 );
+        static_assert( sizeof( flow_index_file::packet ) == 24 );
+        static_assert( sizeof( flow_index_file::flow ) == 72 );
+        static_assert( std::is_trivially_copyable_v<flow_index_file::flow> );
+
+        auto key_order( const flow_key& key ) {
+            return std::tie( key.low_ip, key.low_port, key.high_ip, key.high_port );
+        }
+
+        bool key_before( const flow_key& a, const flow_key& b ) {
+            return key_order( a ) < key_order( b );
+        }
+
+        int64_t nanoseconds_since_epoch( const capture_record_view& record ) {
+            return to_capture_time( record.ts_sec, record.ts_usec ).time_since_epoch().count();
+        }
+
+        // a flow while the capture is read, with what it takes to spot its handshake
+        struct flow_builder {
+            flow_index_file::flow record;
+            std::vector<flow_index_file::packet> packets;
+            std::optional<uint32_t> syn_ack_seq;
+            bool syn = false;
+        };
+
+        void add_packet( flow_builder& builder, const decoded_packet& decoded, const flow_index_file::packet& p ) {
+
+            uint32_t position = static_cast<uint32_t>( builder.packets.size() );
+            auto& record = builder.record;
+            bool from_client = !p.reverse;
+
+            if ( from_client && decoded.is_syn() ) {
+                builder.syn = true;
+                builder.syn_ack_seq = std::nullopt;
+            } else if ( !from_client && decoded.is_syn_ack() && builder.syn ) {
+                builder.syn_ack_seq = decoded.sequence_number;
+            } else if ( from_client && decoded.is_ack() && builder.syn_ack_seq &&
+                        decoded.acknowledgment_number == *builder.syn_ack_seq + 1 &&
+                        record.handshake_end == flow_index_file::no_position ) {
+                record.handshake_end = position;
+            }
+
+            if ( ( decoded.is_fin_ack() || decoded.is_reset() ) && record.termination_start == flow_index_file::no_position ) {
+                record.termination_start = position;
+            }
+
+            if ( builder.packets.empty() ) record.first_timestamp = p.timestamp;
+            record.last_timestamp = p.timestamp;
+
+            builder.packets.push_back( p );
+        }
+
+    } // namespace
+
+    flow_index_file::flow_index_file( const std::string& capture )
+        : flow_index_file( capture, flow_index_path( capture ) ) {}
+
+    flow_index_file::flow_index_file( const std::string& capture, const std::string& index ) {
+
+        if ( !map( index, m_index ) ) {
+            fail( "Failed to open index: " + index );
+            return;
+        }
+
+        if ( !map( capture, m_capture ) ) {
+            fail( "Failed to open capture: " + capture );
+            return;
+        }
+
+        if ( m_index.size < sizeof( file_header ) ) {
+            fail( "index header is truncated" );
+            return;
+        }
+
+        file_header header;
+        std::memcpy( &header, m_index.data, sizeof( header ) );
+
+        if ( std::memcmp( header.magic, index_magic, sizeof( index_magic ) ) != 0 ) {
+            fail( "not a flow index" );
+            return;
+        }
+        if ( header.byte_order != byte_order_mark ) {
+            fail( "flow index was written with another byte order" );
+            return;
+        }
+        if ( header.version != format_version ) {
+            fail( "flow index version " + std::to_string( header.version ) + " is not supported" );
+            return;
+        }
+        if ( header.capture_size != m_capture.size ) {
+            fail( "flow index is stale, the capture has changed since it was written" );
+            return;
+        }
+
+        // divided rather than multiplied, counts from a damaged file must not wrap around
+        auto fits = [ this ]( uint64_t offset, uint64_t count, size_t record_size ) {
+            return offset <= m_index.size && count <= ( m_index.size - offset ) / record_size;
+        };
+        if ( header.flows_offset % alignof( flow ) != 0 || header.packets_offset % alignof( packet ) != 0 ||
+             !fits( header.flows_offset, header.flow_count, sizeof( flow ) ) ||
+             !fits( header.packets_offset, header.packet_count, sizeof( packet ) ) ) {
+            fail( "flow index is truncated" );
+            return;
+        }
+
+        m_hex = static_cast<capture_format>( header.capture_format ) == capture_format::HEX;
+        m_flows = std::span<const flow>( reinterpret_cast<const flow*>( m_index.data + header.flows_offset ), header.flow_count );
+        m_packets = std::span<const packet>( reinterpret_cast<const packet*>( m_index.data + header.packets_offset ), header.packet_count );
+
+        for ( auto& f : m_flows ) {
+            if ( static_cast<uint64_t>( f.first_packet ) + f.packet_count > m_packets.size() ) {
+                fail( "flow index has a flow past its packet records" );
+                return;
+            }
+        }
+    }
+
+    flow_index_file::~flow_index_file() {
+        unmap( m_index );
+        unmap( m_capture );
+    }
+
+    bool flow_index_file::fail( const std::string& error ) {
+        m_error = error;
+        m_flows = {};
+        m_packets = {};
+        return false;
+    }
+
+#ifndef _WIN32
+
+    bool flow_index_file::map( const std::string& filename, mapping& m ) {
+
+        int fd = ::open( filename.c_str(), O_RDONLY );
+        if ( fd < 0 ) return false;
+
+        struct stat file_stat;
+        if ( fstat( fd, &file_stat ) < 0 ) {
+            ::close( fd );
+            return false;
+        }
+
+        m.size = static_cast<size_t>( file_stat.st_size );
+
+        if ( m.size > 0 ) {
+            void* map = mmap( nullptr, m.size, PROT_READ, MAP_PRIVATE, fd, 0 );
+            if ( map == MAP_FAILED ) {
+                ::close( fd );
+                m.size = 0;
+                return false;
+            }
+            // a flow's packets are scattered through the capture, read-ahead would only waste pages
+            madvise( map, m.size, MADV_RANDOM );
+            m.data = static_cast<const uint8_t*>( map );
+            m.mapped = true;
+        }
+
+        ::close( fd );
+        return true;
+    }
+
+    void flow_index_file::unmap( mapping& m ) {
+        if ( m.mapped ) munmap( const_cast<uint8_t*>( m.data ), m.size );
+        m.mapped = false;
+    }
+
+#else
+
+    bool flow_index_file::map( const std::string& filename, mapping& m ) {
+
+        std::ifstream file( filename, std::ios::binary | std::ios::ate );
+        if ( !file.is_open() ) return false;
+
+        m.contents.resize( static_cast<size_t>( file.tellg() ) );
+        file.seekg( 0 );
+        file.read( reinterpret_cast<char*>( m.contents.data() ), m.contents.size() );
+
+        m.data = m.contents.data();
+        m.size = m.contents.size();
+        return true;
+    }
+
+    void flow_index_file::unmap( mapping& m ) {}
+
+#endif
+
+    bool flow_index_file::is_open() const {
+        return m_error.empty();
+    }
+
+    const std::string& flow_index_file::error() const {
+        return m_error;
+    }
+
+    std::span<const flow_index_file::flow> flow_index_file::flows() const {
+        return m_flows;
+    }
+
+    size_t flow_index_file::size() const {
+        return m_flows.size();
+    }
+
+    const flow_index_file::flow* flow_index_file::find( const four_tuple& four ) const {
+
+        flow_key key( four );
+
+        auto it = std::partition_point( m_flows.begin(), m_flows.end(), [&]( const flow& f ) {
+            return key_before( flow_key( f.four ), key );
+        });
+
+        if ( it == m_flows.end() || !( flow_key( it->four ) == key ) ) return nullptr;
+        return &*it;
+    }
+
+    std::span<const flow_index_file::packet> flow_index_file::packets( const flow& f ) const {
+        return m_packets.subspan( f.first_packet, f.packet_count );
+    }
+
+    std::span<const uint8_t> flow_index_file::frame( const packet& p, std::vector<uint8_t>& scratch ) const {
+
+        if ( p.offset + p.size > m_capture.size ) return {};
+
+        std::span<const uint8_t> stored( m_capture.data + p.offset, p.size );
+        if ( !m_hex ) return stored;
+
+        decode_hex_line( std::string_view( reinterpret_cast<const char*>( stored.data() ), stored.size() ), scratch );
+        return scratch;
+    }
+
+    session flow_index_file::read_flow( const four_tuple& four ) const {
+
+        session packets;
+        const flow* f = find( four );
+        if ( !f ) return packets;
+
+        std::vector<uint8_t> scratch;
+        packets.reserve( f->packet_count );
+        for ( auto& p : this->packets( *f ) ) {
+            auto bytes = frame( p, scratch );
+            packets.emplace_back( bytes.begin(), bytes.end() );
+        }
+
+        return packets;
+    }
+
+    std::vector<captured_packet> flow_index_file::read_captured_flow( const four_tuple& four ) const {
+
+        std::vector<captured_packet> packets;
+        const flow* f = find( four );
+        if ( !f ) return packets;
+
+        std::vector<uint8_t> scratch;
+        packets.reserve( f->packet_count );
+        for ( auto& p : this->packets( *f ) ) {
+            packets.push_back( make_captured_packet( capture_time( std::chrono::nanoseconds( p.timestamp ) ), frame( p, scratch ) ) );
+        }
+
+        return packets;
+    }
+
+    std::string flow_index_path( const std::string& capture ) {
+        return capture + ".flows";
+    }
+
+    std::expected<size_t,std::string> write_flow_index( const std::string& capture, const std::string& index ) {
+
+        capture_file packets( capture );
+        if ( !packets.is_open() ) return std::unexpected( "Failed to open capture: " + capture );
+
+        auto type = to_link_type( packets.datalink() );
+        if ( !type ) return std::unexpected( "no decoder for link type " + std::to_string( packets.datalink() ) );
+
+        link_layer link = link_layer_of( *type );
+        const uint8_t* base = packets.bytes().data();
+
+        std::vector<flow_builder> flows;
+        std::unordered_map<flow_key,uint32_t,flow_key_hash> by_key;
+        size_t packet_count = 0;
+
+        for ( auto it = packets.begin(); it != packets.end(); ++it ) {
+
+            auto decoded = link.decode( *it );
+            if ( !decoded ) continue;
+
+            auto four = decoded->four();
+            auto [ entry, inserted ] = by_key.try_emplace( flow_key( four ), static_cast<uint32_t>( flows.size() ) );
+
+            if ( inserted ) {
+                flow_builder builder;
+                // zeroed so the padding in the record is written as zeros too, which value-initialisation
+                // does not promise. four_tuple's constructor makes the record non-trivial but it is
+                // trivially copyable, asserted above, so clearing its bytes is sound
+                std::memset( static_cast<void*>( &builder.record ), 0, sizeof( builder.record ) );
+                builder.record.four = four;
+                builder.record.handshake_end = flow_index_file::no_position;
+                builder.record.termination_start = flow_index_file::no_position;
+                flows.push_back( std::move( builder ) );
+            }
+
+            auto& builder = flows[ entry->second ];
+            auto stored = it.stored_record();
+
+            flow_index_file::packet p{};
+            p.offset = static_cast<uint64_t>( stored.data() - base );
+            p.size = static_cast<uint32_t>( stored.size() );
+            p.reverse = !( four == builder.record.four );
+            p.timestamp = packets.format() == capture_format::HEX ? 0 : nanoseconds_since_epoch( it.record() );
+
+            add_packet( builder, *decoded, p );
+            packet_count++;
+        }
+
+        std::sort( flows.begin(), flows.end(), []( const flow_builder& a, const flow_builder& b ) {
+            return key_before( flow_key( a.record.four ), flow_key( b.record.four ) );
+        });
+
+        file_header header{};
+        std::memcpy( header.magic, index_magic, sizeof( index_magic ) );
+        header.version = flow_index_file::format_version;
+        header.byte_order = byte_order_mark;
+        header.capture_size = packets.size_bytes();
+        header.capture_format = static_cast<uint32_t>( packets.format() );
+        header.datalink = packets.datalink();
+        header.flow_count = flows.size();
+        header.packet_count = packet_count;
+        header.flows_offset = sizeof( file_header );
+        header.packets_offset = header.flows_offset + flows.size() * sizeof( flow_index_file::flow );
+
+        // written beside the final name and moved over it, a reader never sees half an index
+        std::string partial = index + ".partial";
+        {
+            std::ofstream file( partial, std::ios::binary | std::ios::trunc );
+            if ( !file.is_open() ) return std::unexpected( "Failed to open index: " + partial );
+
+            file.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+
+            uint32_t first_packet = 0;
+            for ( auto& builder : flows ) {
+                builder.record.first_packet = first_packet;
+                builder.record.packet_count = static_cast<uint32_t>( builder.packets.size() );
+                first_packet += builder.record.packet_count;
+                file.write( reinterpret_cast<const char*>( &builder.record ), sizeof( builder.record ) );
+            }
+
+            for ( auto& builder : flows ) {
+                file.write( reinterpret_cast<const char*>( builder.packets.data() ), builder.packets.size() * sizeof( flow_index_file::packet ) );
+            }
+
+            if ( !file ) {
+                file.close();
+                std::remove( partial.c_str() );
+                return std::unexpected( "Failed to write index: " + partial );
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename( partial, index, ec );
+        if ( ec ) return std::unexpected( "Failed to move index into place: " + ec.message() );
+
+        return flows.size();
+    }
+
+} // namespace ntk
@@ -0,0 +1,122 @@
+#include <flow_key.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace ntk {
+
+    namespace {
+
+        void put_u32( uint8_t* p, uint32_t value ) {
+            p[ 0 ] = static_cast<uint8_t>( value >> 24 );
+            p[ 1 ] = static_cast<uint8_t>( value >> 16 );
+            p[ 2 ] = static_cast<uint8_t>( value >> 8 );
+            p[ 3 ] = static_cast<uint8_t>( value );
+        }
+
+        void put_u64( uint8_t* p, uint64_t value ) {
+            put_u32( p, static_cast<uint32_t>( value >> 32 ) );
+            put_u32( p + 4, static_cast<uint32_t>( value ) );
+        }
+
+        uint64_t get_u64( const uint8_t* p ) {
+            uint64_t value = 0;
+            for ( size_t i = 0; i < 8; ++i ) value = ( value << 8 ) | p[ i ];
+            return value;
+        }
+
+        // where the key is too short for ipv6, the address is xor folded to 32 bits
+        uint32_t fold_to_32( const ip_address& ip ) {
+            return static_cast<uint32_t>( ip.high >> 32 ) ^ static_cast<uint32_t>( ip.high ) ^
+                   static_cast<uint32_t>( ip.low >> 32 ) ^ static_cast<uint32_t>( ip.low );
+        }
+
+    } // namespace
+
+    ip_address ip_address::from_bytes( std::span<const uint8_t,16> bytes ) {
+        ip_address ip;
+        ip.high = get_u64( bytes.data() );
+        ip.low = get_u64( bytes.data() + 8 );
+        return ip;
+    }
+
+    std::array<uint8_t,16> ip_address::bytes() const {
+        std::array<uint8_t,16> bytes;
+        put_u64( bytes.data(), high );
+        put_u64( bytes.data() + 8, low );
+        return bytes;
+    }
+
+    toeplitz_hasher::toeplitz_hasher( std::span<const uint8_t> key ) {
+
+        if ( key.size() < min_key_len ) {
+            throw std::runtime_error( "Toeplitz key needs at least 16 bytes" );
+        }
+
+        // the 32-bit window of the key that lines up with input bit i
+        auto window = [&]( size_t bit ) {
+            uint32_t w = 0;
+            for ( size_t j = 0; j < 32; ++j ) {
+                size_t key_bit = bit + j;
+                uint32_t b = ( key[ key_bit / 8 ] >> ( 7 - key_bit % 8 ) ) & 1;
+                w = ( w << 1 ) | b;
+            }
+            return w;
+        };
+
+        // as many input bytes as the key has windows for
+        m_input_len = std::min( m_tables.size(), key.size() - 4 );
+
+        for ( size_t byte = 0; byte < m_input_len; ++byte ) {
+            for ( size_t value = 0; value < 256; ++value ) {
+                uint32_t h = 0;
+                for ( size_t bit = 0; bit < 8; ++bit ) {
+                    if ( value & ( 0x80 >> bit ) ) h ^= window( byte * 8 + bit );
+                }
+                m_tables[ byte ][ value ] = h;
+            }
+        }
+    }
+
+    uint32_t toeplitz_hasher::operator()( const four_tuple& four ) const {
+
+        if ( four.client_ip.is_v4() && four.server_ip.is_v4() ) {
+            uint8_t input[ 12 ];
+            put_u32( input, four.client_ip.v4() );
+            put_u32( input + 4, four.server_ip.v4() );
+            input[ 8 ] = static_cast<uint8_t>( four.client_port >> 8 );
+            input[ 9 ] = static_cast<uint8_t>( four.client_port );
+            input[ 10 ] = static_cast<uint8_t>( four.server_port >> 8 );
+            input[ 11 ] = static_cast<uint8_t>( four.server_port );
+            return hash( input );
+        }
+
+        if ( m_input_len < 36 ) {
+            return ( *this )( four_tuple{ fold_to_32( four.client_ip ), fold_to_32( four.server_ip ), four.client_port, four.server_port } );
+        }
+
+        uint8_t input[ 36 ];
+        auto client = four.client_ip.bytes();
+        auto server = four.server_ip.bytes();
+        std::copy( client.begin(), client.end(), input );
+        std::copy( server.begin(), server.end(), input + 16 );
+        input[ 32 ] = static_cast<uint8_t>( four.client_port >> 8 );
+        input[ 33 ] = static_cast<uint8_t>( four.client_port );
+        input[ 34 ] = static_cast<uint8_t>( four.server_port >> 8 );
+        input[ 35 ] = static_cast<uint8_t>( four.server_port );
+        return hash( input );
+    }
+
+    uint32_t toeplitz_hasher::hash( std::span<const uint8_t> input ) const {
+        uint32_t h = 0;
+        for ( size_t i = 0; i < input.size(); ++i ) {
+            h ^= m_tables[ i ][ input[ i ] ];
+        }
+        return h;
+    }
+
+    size_t toeplitz_hasher::queue_of( uint32_t hash, size_t n_queues, size_t table_size ) {
+        return ( hash % table_size ) % n_queues;
+    }
+
+} // namespace ntk
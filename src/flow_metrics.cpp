@@ -0,0 +1,186 @@
+#include <flow_metrics.hpp>
+
+#include <algorithm>
+
+#include <tcp_reassembler.hpp>
+
+namespace ntk {
+
+    namespace {
+        constexpr uint8_t syn_flag = 0x02;
+        constexpr uint8_t fin_flag = 0x01;
+    }
+
+    void flow_metrics::add( const decoded_packet& packet, bool from_client ) {
+        add( packet, from_client, std::nullopt );
+    }
+
+    void flow_metrics::add( const decoded_packet& packet, bool from_client, capture_time timestamp ) {
+        add( packet, from_client, std::optional<capture_time>( timestamp ) );
+    }
+
+    void flow_metrics::add( const decoded_packet& packet, bool from_client, std::optional<capture_time> timestamp ) {
+
+        if ( timestamp ) {
+            if ( !m_first_packet ) m_first_packet = timestamp;
+            m_last_packet = timestamp;
+        }
+
+        auto& state = from_client ? m_client : m_server;
+        state.metrics.packets++;
+        state.metrics.bytes += packet.payload.size();
+
+        // a reset or syn carries no real window
+        if ( !packet.is_reset() && !( packet.flags & syn_flag ) ) {
+            bool zero_window = packet.window_size == 0;
+            if ( zero_window && !state.zero_window ) state.metrics.zero_windows++;
+            state.zero_window = zero_window;
+        }
+
+        if ( from_client && packet.is_syn() ) {
+            // a new syn starts the handshake over
+            m_syn = timestamp;
+            m_syn_ack_seq = std::nullopt;
+            m_handshake_rtt = std::nullopt;
+        } else if ( !from_client && packet.is_syn_ack() ) {
+            m_syn_ack_seq = packet.sequence_number;
+        } else if ( from_client && packet.is_ack() && !m_handshake_rtt && m_syn_ack_seq &&
+                    packet.acknowledgment_number == *m_syn_ack_seq + 1 && m_syn && timestamp ) {
+            m_handshake_rtt = *timestamp - *m_syn;
+        }
+
+        track_sequence( state, packet, timestamp );
+    }
+
+    void flow_metrics::track_sequence( direction_state& state, const decoded_packet& packet, std::optional<capture_time> timestamp ) {
+
+        if ( packet.flags & syn_flag ) {
+            state.started = true;
+            state.next_seq = packet.sequence_number + 1;
+            state.gap_count = 0;
+            return;
+        }
+
+        // a fin takes up a sequence number like a byte of payload
+        uint32_t length = static_cast<uint32_t>( packet.payload.size() ) + ( ( packet.flags & fin_flag ) ? 1 : 0 );
+        if ( length == 0 ) return;
+
+        uint32_t begin = packet.sequence_number;
+        uint32_t end = begin + length;
+
+        if ( !state.started ) {
+            // joined mid-flow, the first segment seen is taken as in order
+            state.started = true;
+            state.next_seq = end;
+            return;
+        }
+
+        if ( !seq_before( begin, state.next_seq ) ) {
+            if ( begin != state.next_seq ) open_gap( state, state.next_seq, begin, timestamp );
+            state.next_seq = end;
+            return;
+        }
+
+        bool late = false;
+        if ( fill_gap( state, begin, end, timestamp, late ) && !late ) {
+            state.metrics.out_of_order++;
+        } else {
+            state.metrics.retransmissions++;
+        }
+
+        if ( seq_before( state.next_seq, end ) ) state.next_seq = end;
+    }
+
+    bool flow_metrics::fill_gap( direction_state& state, uint32_t begin, uint32_t end, std::optional<capture_time> timestamp, bool& late ) {
+
+        bool filled = false;
+
+        for ( size_t i = 0; i < state.gap_count; ) {
+
+            auto& hole = state.gaps[ i ];
+            if ( !seq_before( begin, hole.end ) || !seq_before( hole.begin, end ) ) {
+                ++i;
+                continue;
+            }
+
+            filled = true;
+            if ( timestamp && hole.opened && *timestamp - *hole.opened > reorder_window() ) late = true;
+
+            bool covers_begin = !seq_before( hole.begin, begin );
+            bool covers_end = !seq_before( end, hole.end );
+
+            if ( covers_begin && covers_end ) {
+                state.gaps[ i ] = state.gaps[ --state.gap_count ];
+                continue;
+            }
+
+            if ( covers_begin ) {
+                hole.begin = end;
+            } else if ( covers_end ) {
+                hole.end = begin;
+            } else {
+                // landed in the middle, what is left after it becomes a hole of its own
+                gap rest{ end, hole.end, hole.opened };
+                hole.end = begin;
+                if ( state.gap_count < max_gaps ) state.gaps[ state.gap_count++ ] = rest;
+            }
+            ++i;
+        }
+
+        return filled;
+    }
+
+    void flow_metrics::open_gap( direction_state& state, uint32_t begin, uint32_t end, std::optional<capture_time> timestamp ) {
+
+        // the oldest hole is forgotten first, a segment filling it later counts as a retransmission
+        if ( state.gap_count == max_gaps ) {
+            std::move( state.gaps.begin() + 1, state.gaps.end(), state.gaps.begin() );
+            state.gap_count--;
+        }
+
+        state.gaps[ state.gap_count++ ] = gap{ begin, end, timestamp };
+    }
+
+    std::chrono::nanoseconds flow_metrics::reorder_window() const {
+        return m_handshake_rtt ? *m_handshake_rtt : std::chrono::milliseconds( 3 );
+    }
+
+    const direction_metrics& flow_metrics::client() const {
+        return m_client.metrics;
+    }
+
+    const direction_metrics& flow_metrics::server() const {
+        return m_server.metrics;
+    }
+
+    std::optional<std::chrono::nanoseconds> flow_metrics::handshake_rtt() const {
+        return m_handshake_rtt;
+    }
+
+    std::optional<std::chrono::nanoseconds> flow_metrics::duration() const {
+        if ( !m_first_packet ) return std::nullopt;
+        return *m_last_packet - *m_first_packet;
+    }
+
+    void flow_metrics::save( snapshot_writer& out ) const {
+        out.write( m_client );
+        out.write( m_server );
+        out.write( m_first_packet );
+        out.write( m_last_packet );
+        out.write( m_syn );
+        out.write( m_syn_ack_seq );
+        out.write( m_handshake_rtt );
+    }
+
+    bool flow_metrics::restore( snapshot_reader& in ) {
+        in.read( m_client );
+        in.read( m_server );
+        in.read( m_first_packet );
+        in.read( m_last_packet );
+        in.read( m_syn );
+        in.read( m_syn_ack_seq );
+        in.read( m_handshake_rtt );
+        return !in.failed() && m_client.gap_count <= max_gaps && m_server.gap_count <= max_gaps;
+    }
+
+} // namespace ntk
@@ -0,0 +1,198 @@
+#include <frame_arena.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <cstring>
+
+#include <lz4_block.hpp>
+
+namespace ntk {
+
+    frame_arena::frame_arena( std::pmr::memory_resource* upstream )
+        : m_upstream( upstream ) {}
+
+    frame_arena::frame_arena( const frame_arena& other )
+        : m_upstream( other.m_upstream ) {
+        // the copy holds every frame inflated, and seals what comes after like the original
+        m_frames.reserve( other.size() );
+        other.for_each( [ this ]( std::span<const uint8_t> frame ) { push_back( frame ); } );
+        m_block_size = other.m_block_size;
+    }
+
+    frame_arena& frame_arena::operator=( const frame_arena& other ) {
+        if ( this != &other ) {
+            frame_arena copy( other );
+            *this = std::move( copy );
+        }
+        return *this;
+    }
+
+    std::span<uint8_t> frame_arena::allocate( size_t bytes ) const {
+        if ( bytes == 0 ) return {};
+        if ( !m_arena ) m_arena = std::make_unique<std::pmr::monotonic_buffer_resource>( initial_block_size, m_upstream );
+        m_arena_bytes += bytes;
+        return std::span<uint8_t>( static_cast<uint8_t*>( m_arena->allocate( bytes, 1 ) ), bytes );
+    }
+
+    std::span<const uint8_t> frame_arena::push_back( std::span<const uint8_t> frame ) {
+
+        if ( m_block_size ) {
+            // before the frame goes in, so the span returned is never sealed right away
+            if ( m_open.size() >= m_block_size ) seal();
+            m_open.insert( m_open.end(), frame.begin(), frame.end() );
+            m_open_lengths.push_back( static_cast<uint32_t>( frame.size() ) );
+            return std::span<const uint8_t>( m_open ).last( frame.size() );
+        }
+
+        auto bytes = allocate( frame.size() );
+        if ( !frame.empty() ) std::memcpy( bytes.data(), frame.data(), frame.size() );
+
+        m_frames.emplace_back( bytes.data(), frame.size() );
+        return m_frames.back();
+    }
+
+    void frame_arena::release() {
+        m_arena.reset();
+        std::vector<std::span<const uint8_t>>().swap( m_frames );
+        std::vector<sealed_block>().swap( m_sealed );
+        std::vector<uint8_t>().swap( m_open );
+        std::vector<uint32_t>().swap( m_open_lengths );
+        m_sealed_frames = 0;
+        m_sealed_stored = 0;
+        m_arena_bytes = 0;
+    }
+
+    void frame_arena::compress( size_t block_size ) {
+
+        if ( block_size == 0 ) {
+            unseal();
+            m_block_size = 0;
+            return;
+        }
+
+        m_block_size = block_size;
+
+        unseal();
+        if ( m_frames.empty() ) return;
+
+        // what the arena holds moves out and is sealed with the rest, the arena goes
+        for ( auto frame : m_frames ) {
+            m_open.insert( m_open.end(), frame.begin(), frame.end() );
+            m_open_lengths.push_back( static_cast<uint32_t>( frame.size() ) );
+        }
+        m_arena.reset();
+        std::vector<std::span<const uint8_t>>().swap( m_frames );
+        m_arena_bytes = 0;
+
+        seal();
+    }
+
+    void frame_arena::seal() {
+
+        size_t offset = 0;
+        size_t frames = 0;
+
+        while ( frames < m_open_lengths.size() ) {
+
+            // whole frames up to at least a block
+            size_t end = frames;
+            size_t size = 0;
+            while ( end < m_open_lengths.size() && size < m_block_size ) size += m_open_lengths[ end++ ];
+            if ( size < m_block_size ) break;
+
+            std::span<const uint8_t> block( m_open.data() + offset, size );
+            sealed_block sealed{ .bytes = {}, .size = size, .compressed = true,
+                                 .lengths = std::vector<uint32_t>( m_open_lengths.begin() + frames, m_open_lengths.begin() + end ) };
+            lz4_compress_block( block, sealed.bytes );
+
+            if ( sealed.bytes.size() >= block.size() ) {
+                sealed.bytes.assign( block.begin(), block.end() );
+                sealed.compressed = false;
+            }
+            sealed.bytes.shrink_to_fit();
+
+            m_sealed_frames += end - frames;
+            m_sealed_stored += sealed.bytes.size();
+            m_sealed.push_back( std::move( sealed ) );
+
+            offset += size;
+            frames = end;
+        }
+
+        // what is left is less than a block, so the copy is short
+        m_open.erase( m_open.begin(), m_open.begin() + offset );
+        m_open_lengths.erase( m_open_lengths.begin(), m_open_lengths.begin() + frames );
+    }
+
+    void frame_arena::inflate( const sealed_block& sealed, std::span<uint8_t> into ) {
+        if ( !sealed.compressed ) {
+            std::copy( sealed.bytes.begin(), sealed.bytes.end(), into.begin() );
+        } else if ( auto inflated = lz4_decompress_block( sealed.bytes, into ); !inflated ) {
+            // only ever our own output, this is memory gone bad
+            throw std::runtime_error( inflated.error() );
+        }
+    }
+
+    void frame_arena::unseal() const {
+
+        if ( m_sealed.empty() && m_open_lengths.empty() ) return;
+
+        auto add = [ this ]( std::span<const uint8_t> bytes, const std::vector<uint32_t>& lengths ) {
+            for ( auto length : lengths ) {
+                m_frames.push_back( bytes.first( length ) );
+                bytes = bytes.subspan( length );
+            }
+        };
+
+        m_frames.reserve( size() );
+
+        for ( auto& sealed : m_sealed ) {
+            auto into = allocate( sealed.size );
+            inflate( sealed, into );
+            add( into, sealed.lengths );
+        }
+
+        auto into = allocate( m_open.size() );
+        if ( !m_open.empty() ) std::memcpy( into.data(), m_open.data(), m_open.size() );
+        add( into, m_open_lengths );
+
+        std::vector<sealed_block>().swap( m_sealed );
+        std::vector<uint8_t>().swap( m_open );
+        std::vector<uint32_t>().swap( m_open_lengths );
+        m_sealed_frames = 0;
+        m_sealed_stored = 0;
+    }
+
+    std::vector<std::span<const uint8_t>>::const_iterator frame_arena::begin() const {
+        unseal();
+        return m_frames.begin();
+    }
+
+    std::vector<std::span<const uint8_t>>::const_iterator frame_arena::end() const {
+        unseal();
+        return m_frames.end();
+    }
+
+    std::span<const uint8_t> frame_arena::operator[]( size_t index ) const {
+        unseal();
+        return m_frames[ index ];
+    }
+
+    size_t frame_arena::size() const {
+        return m_frames.size() + m_sealed_frames + m_open_lengths.size();
+    }
+
+    bool frame_arena::empty() const {
+        return size() == 0;
+    }
+
+    size_t frame_arena::stored_bytes() const {
+        return m_arena_bytes + m_sealed_stored + m_open.size();
+    }
+
+    std::pmr::memory_resource* frame_arena::upstream() const {
+        return m_upstream;
+    }
+
+} // namespace ntk
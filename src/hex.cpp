@@ -0,0 +1,262 @@
+#include <hex.hpp>
+
+#include <array>
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define NTK_HEX_X86 1
+#include <immintrin.h>
+#endif
+
+namespace ntk {
+
+    namespace {
+
+        constexpr std::array<int8_t,256> make_hex_digit_table() {
+            std::array<int8_t,256> table{};
+            for ( auto& value : table ) value = -1;
+            for ( int c = '0'; c <= '9'; ++c ) table[ c ] = static_cast<int8_t>( c - '0' );
+            for ( int c = 'a'; c <= 'f'; ++c ) table[ c ] = static_cast<int8_t>( c - 'a' + 10 );
+            for ( int c = 'A'; c <= 'F'; ++c ) table[ c ] = static_cast<int8_t>( c - 'A' + 10 );
+            return table;
+        }
+
+        constexpr auto hex_digit_table = make_hex_digit_table();
+
+        bool is_space( char c ) {
+            return c == ' ' || ( c >= '\t' && c <= '\r' );
+        }
+
+        // one token starting at line[ i ], returns the index just past it
+        size_t decode_token( const char* line, size_t i, size_t len, uint8_t* out, size_t& n ) {
+
+            unsigned int value = 0;
+            bool digits = false;
+
+            for ( ; i < len && !is_space( line[ i ] ); ++i ) {
+                int digit = hex_digit_table[ static_cast<unsigned char>( line[ i ] ) ];
+                if ( digit < 0 ) {
+                    while ( i < len && !is_space( line[ i ] ) ) ++i;
+                    break;
+                }
+                value = ( value << 4 ) | static_cast<unsigned int>( digit );
+                digits = true;
+            }
+
+            if ( digits ) out[ n++ ] = static_cast<uint8_t>( value );
+
+            return i;
+        }
+
+        /*
+            a block decoder turns chars "xx " pairs starting at a token boundary into
+            chars / 3 bytes, and declines ( returns false ) for anything else
+        */
+        struct hex_block_decoder {
+            size_t chars;
+            bool ( *decode )( const char* in, uint8_t* out );
+            const char* name;
+        };
+
+#ifdef NTK_HEX_X86
+
+        /*
+            48 chars hold 16 pairs, the high digits sit at 3j, the low digits at 3j + 1 and
+            the spaces at 3j + 2. across the three 16 byte loads that pattern repeats with
+            these offsets, the shuffles gather each digit into its output lane
+        */
+        constexpr int space_mask_a = 0x4924;
+        constexpr int space_mask_b = 0x2492;
+        constexpr int space_mask_c = 0x9249;
+
+        __attribute__(( target( "ssse3" ) ))
+        __m128i hex_nibbles_ssse3( __m128i chars, __m128i& valid ) {
+            __m128i digit = _mm_sub_epi8( chars, _mm_set1_epi8( '0' ) );
+            __m128i is_digit = _mm_cmpeq_epi8( _mm_min_epu8( digit, _mm_set1_epi8( 9 ) ), digit );
+            __m128i letter = _mm_sub_epi8( _mm_or_si128( chars, _mm_set1_epi8( 0x20 ) ), _mm_set1_epi8( 'a' ) );
+            __m128i is_letter = _mm_cmpeq_epi8( _mm_min_epu8( letter, _mm_set1_epi8( 5 ) ), letter );
+            valid = _mm_and_si128( valid, _mm_or_si128( is_digit, is_letter ) );
+            return _mm_or_si128( _mm_and_si128( is_digit, digit ),
+                                 _mm_and_si128( is_letter, _mm_add_epi8( letter, _mm_set1_epi8( 10 ) ) ) );
+        }
+
+        __attribute__(( target( "ssse3" ) ))
+        bool decode_block_ssse3( const char* in, uint8_t* out ) {
+
+            __m128i a = _mm_loadu_si128( reinterpret_cast<const __m128i*>( in ) );
+            __m128i b = _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + 16 ) );
+            __m128i c = _mm_loadu_si128( reinterpret_cast<const __m128i*>( in + 32 ) );
+
+            const __m128i space = _mm_set1_epi8( ' ' );
+            if ( ( _mm_movemask_epi8( _mm_cmpeq_epi8( a, space ) ) & space_mask_a ) != space_mask_a ||
+                 ( _mm_movemask_epi8( _mm_cmpeq_epi8( b, space ) ) & space_mask_b ) != space_mask_b ||
+                 ( _mm_movemask_epi8( _mm_cmpeq_epi8( c, space ) ) & space_mask_c ) != space_mask_c ) {
+                return false;
+            }
+
+            __m128i high = _mm_or_si128( _mm_or_si128(
+                _mm_shuffle_epi8( a, _mm_setr_epi8( 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 ) ),
+                _mm_shuffle_epi8( b, _mm_setr_epi8( -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1 ) ) ),
+                _mm_shuffle_epi8( c, _mm_setr_epi8( -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13 ) ) );
+
+            __m128i low = _mm_or_si128( _mm_or_si128(
+                _mm_shuffle_epi8( a, _mm_setr_epi8( 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 ) ),
+                _mm_shuffle_epi8( b, _mm_setr_epi8( -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1 ) ) ),
+                _mm_shuffle_epi8( c, _mm_setr_epi8( -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14 ) ) );
+
+            __m128i valid = _mm_set1_epi8( -1 );
+            __m128i high_nibbles = hex_nibbles_ssse3( high, valid );
+            __m128i low_nibbles = hex_nibbles_ssse3( low, valid );
+
+            if ( _mm_movemask_epi8( valid ) != 0xffff ) return false;
+
+            // every nibble is below 16 so the 16 bit shift cannot carry into the next byte
+            __m128i bytes = _mm_or_si128( _mm_slli_epi16( high_nibbles, 4 ), low_nibbles );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( out ), bytes );
+
+            return true;
+        }
+
+        __attribute__(( target( "avx2" ) ))
+        __m256i load_pair_avx2( const char* first, const char* second ) {
+            __m128i low = _mm_loadu_si128( reinterpret_cast<const __m128i*>( first ) );
+            __m128i high = _mm_loadu_si128( reinterpret_cast<const __m128i*>( second ) );
+            return _mm256_inserti128_si256( _mm256_castsi128_si256( low ), high, 1 );
+        }
+
+        __attribute__(( target( "avx2" ) ))
+        __m256i hex_nibbles_avx2( __m256i chars, __m256i& valid ) {
+            __m256i digit = _mm256_sub_epi8( chars, _mm256_set1_epi8( '0' ) );
+            __m256i is_digit = _mm256_cmpeq_epi8( _mm256_min_epu8( digit, _mm256_set1_epi8( 9 ) ), digit );
+            __m256i letter = _mm256_sub_epi8( _mm256_or_si256( chars, _mm256_set1_epi8( 0x20 ) ), _mm256_set1_epi8( 'a' ) );
+            __m256i is_letter = _mm256_cmpeq_epi8( _mm256_min_epu8( letter, _mm256_set1_epi8( 5 ) ), letter );
+            valid = _mm256_and_si256( valid, _mm256_or_si256( is_digit, is_letter ) );
+            return _mm256_or_si256( _mm256_and_si256( is_digit, digit ),
+                                    _mm256_and_si256( is_letter, _mm256_add_epi8( letter, _mm256_set1_epi8( 10 ) ) ) );
+        }
+
+        // two 48 char blocks side by side, one per 128 bit lane, since the shuffles stay in-lane
+        __attribute__(( target( "avx2" ) ))
+        bool decode_block_avx2( const char* in, uint8_t* out ) {
+
+            __m256i a = load_pair_avx2( in, in + 48 );
+            __m256i b = load_pair_avx2( in + 16, in + 64 );
+            __m256i c = load_pair_avx2( in + 32, in + 80 );
+
+            auto both_lanes = []( int mask ) { return static_cast<uint32_t>( mask ) | ( static_cast<uint32_t>( mask ) << 16 ); };
+
+            const __m256i space = _mm256_set1_epi8( ' ' );
+            if ( ( static_cast<uint32_t>( _mm256_movemask_epi8( _mm256_cmpeq_epi8( a, space ) ) ) & both_lanes( space_mask_a ) ) != both_lanes( space_mask_a ) ||
+                 ( static_cast<uint32_t>( _mm256_movemask_epi8( _mm256_cmpeq_epi8( b, space ) ) ) & both_lanes( space_mask_b ) ) != both_lanes( space_mask_b ) ||
+                 ( static_cast<uint32_t>( _mm256_movemask_epi8( _mm256_cmpeq_epi8( c, space ) ) ) & both_lanes( space_mask_c ) ) != both_lanes( space_mask_c ) ) {
+                return false;
+            }
+
+            __m256i high = _mm256_or_si256( _mm256_or_si256(
+                _mm256_shuffle_epi8( a, _mm256_setr_epi8( 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                          0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 ) ),
+                _mm256_shuffle_epi8( b, _mm256_setr_epi8( -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1,
+                                                          -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1 ) ) ),
+                _mm256_shuffle_epi8( c, _mm256_setr_epi8( -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13,
+                                                          -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13 ) ) );
+
+            __m256i low = _mm256_or_si256( _mm256_or_si256(
+                _mm256_shuffle_epi8( a, _mm256_setr_epi8( 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                          1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 ) ),
+                _mm256_shuffle_epi8( b, _mm256_setr_epi8( -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1,
+                                                          -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1 ) ) ),
+                _mm256_shuffle_epi8( c, _mm256_setr_epi8( -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14,
+                                                          -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14 ) ) );
+
+            __m256i valid = _mm256_set1_epi8( -1 );
+            __m256i high_nibbles = hex_nibbles_avx2( high, valid );
+            __m256i low_nibbles = hex_nibbles_avx2( low, valid );
+
+            if ( static_cast<uint32_t>( _mm256_movemask_epi8( valid ) ) != 0xffffffff ) return false;
+
+            __m256i bytes = _mm256_or_si256( _mm256_slli_epi16( high_nibbles, 4 ), low_nibbles );
+            _mm256_storeu_si256( reinterpret_cast<__m256i*>( out ), bytes );
+
+            return true;
+        }
+
+#endif
+
+        struct hex_block_decoders {
+            std::array<hex_block_decoder,2> decoders;
+            size_t count;
+        };
+
+        // widest first, chosen once for the running cpu
+        const hex_block_decoders& block_decoders() {
+            static const hex_block_decoders selected = []() {
+                hex_block_decoders d{};
+#ifdef NTK_HEX_X86
+                if ( __builtin_cpu_supports( "avx2" ) ) d.decoders[ d.count++ ] = { 96, decode_block_avx2, "avx2" };
+                if ( __builtin_cpu_supports( "ssse3" ) ) d.decoders[ d.count++ ] = { 48, decode_block_ssse3, "ssse3" };
+#endif
+                return d;
+            }();
+            return selected;
+        }
+
+    } // namespace
+
+    size_t decode_hex_line_scalar( std::string_view line, uint8_t* out ) {
+
+        const char* data = line.data();
+        size_t len = line.size();
+        size_t n = 0;
+        size_t i = 0;
+
+        while ( i < len ) {
+            while ( i < len && is_space( data[ i ] ) ) ++i;
+            if ( i == len ) break;
+            i = decode_token( data, i, len, out, n );
+        }
+
+        return n;
+    }
+
+    size_t decode_hex_line( std::string_view line, uint8_t* out ) {
+
+        const auto& blocks = block_decoders();
+
+        const char* data = line.data();
+        size_t len = line.size();
+        size_t n = 0;
+        size_t i = 0;
+
+        while ( i < len ) {
+
+            while ( i < len && is_space( data[ i ] ) ) ++i;
+            if ( i == len ) break;
+
+            // at a token boundary, try the widest block that fits before falling back to one token
+            bool decoded = false;
+            for ( size_t d = 0; d < blocks.count; ++d ) {
+                auto& block = blocks.decoders[ d ];
+                if ( len - i >= block.chars && block.decode( data + i, out + n ) ) {
+                    i += block.chars;
+                    n += block.chars / 3;
+                    decoded = true;
+                    break;
+                }
+            }
+
+            if ( !decoded ) i = decode_token( data, i, len, out, n );
+        }
+
+        return n;
+    }
+
+    void decode_hex_line( std::string_view line, std::vector<uint8_t>& bytes ) {
+        bytes.resize( max_decoded_hex_len( line.size() ) );
+        bytes.resize( decode_hex_line( line, bytes.data() ) );
+    }
+
+    const char* hex_decoder_name() {
+        const auto& blocks = block_decoders();
+        return blocks.count ? blocks.decoders[ 0 ].name : "scalar";
+    }
+
+} // namespace ntk
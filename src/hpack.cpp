@@ -0,0 +1,309 @@
+#include <hpack.hpp>
+
+#include <array>
+#include <utility>
+
+namespace ntk {
+
+    namespace {
+
+        constexpr size_t entry_overhead = 32;
+        constexpr size_t max_code_len = 30;
+        constexpr uint16_t eos_symbol = 256;
+
+        // rfc 7541 appendix a
+        const std::array<hpack_header,61> static_table = {{
+            { ":authority", "" },
+            { ":method", "GET" },
+            { ":method", "POST" },
+            { ":path", "/" },
+            { ":path", "/index.html" },
+            { ":scheme", "http" },
+            { ":scheme", "https" },
+            { ":status", "200" },
+            { ":status", "204" },
+            { ":status", "206" },
+            { ":status", "304" },
+            { ":status", "400" },
+            { ":status", "404" },
+            { ":status", "500" },
+            { "accept-charset", "" },
+            { "accept-encoding", "gzip, deflate" },
+            { "accept-language", "" },
+            { "accept-ranges", "" },
+            { "accept", "" },
+            { "access-control-allow-origin", "" },
+            { "age", "" },
+            { "allow", "" },
+            { "authorization", "" },
+            { "cache-control", "" },
+            { "content-disposition", "" },
+            { "content-encoding", "" },
+            { "content-language", "" },
+            { "content-length", "" },
+            { "content-location", "" },
+            { "content-range", "" },
+            { "content-type", "" },
+            { "cookie", "" },
+            { "date", "" },
+            { "etag", "" },
+            { "expect", "" },
+            { "expires", "" },
+            { "from", "" },
+            { "host", "" },
+            { "if-match", "" },
+            { "if-modified-since", "" },
+            { "if-none-match", "" },
+            { "if-range", "" },
+            { "if-unmodified-since", "" },
+            { "last-modified", "" },
+            { "link", "" },
+            { "location", "" },
+            { "max-forwards", "" },
+            { "proxy-authenticate", "" },
+            { "proxy-authorization", "" },
+            { "range", "" },
+            { "referer", "" },
+            { "refresh", "" },
+            { "retry-after", "" },
+            { "server", "" },
+            { "set-cookie", "" },
+            { "strict-transport-security", "" },
+            { "transfer-encoding", "" },
+            { "user-agent", "" },
+            { "vary", "" },
+            { "via", "" },
+            { "www-authenticate", "" }
+        }};
+
+        // the code length of each symbol in rfc 7541 appendix b, 256 is eos. the code is
+        // canonical, so the lengths alone give every code
+        constexpr std::array<uint8_t,257> huffman_code_lengths = {
+            13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+            28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+             6, 10, 10, 12, 13,  6,  8, 11, 10, 10,  8, 11,  8,  6,  6,  6,
+             5,  5,  5,  6,  6,  6,  6,  6,  6,  6,  7,  8, 15,  6, 12, 10,
+            13,  6,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,
+             7,  7,  7,  7,  7,  7,  7,  7,  8,  7,  8, 13, 19, 13, 14,  6,
+            15,  5,  6,  5,  6,  5,  6,  6,  6,  5,  7,  7,  6,  6,  6,  5,
+             6,  7,  6,  5,  5,  6,  7,  7,  7,  7,  7, 15, 11, 14, 13, 28,
+            20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+            24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+            22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+            21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+            26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+            19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+            20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+            26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+            30
+        };
+
+        // symbols ordered by code, and how many codes there are of each length
+        struct canonical_code {
+            std::array<uint16_t,257> symbols{};
+            std::array<uint16_t,max_code_len + 1> counts{};
+        };
+
+        constexpr canonical_code make_canonical_code() {
+            canonical_code code;
+            size_t next = 0;
+            for ( size_t len = 1; len <= max_code_len; ++len ) {
+                for ( uint16_t symbol = 0; symbol < huffman_code_lengths.size(); ++symbol ) {
+                    if ( huffman_code_lengths[ symbol ] != len ) continue;
+                    code.symbols[ next++ ] = symbol;
+                    ++code.counts[ len ];
+                }
+            }
+            return code;
+        }
+
+        constexpr canonical_code huffman_code = make_canonical_code();
+
+        // an integer with an n-bit prefix, rfc 7541 5.1
+        std::expected<uint64_t,std::string> decode_integer( std::span<const uint8_t> block, size_t& pos, int prefix_bits ) {
+
+            if ( pos >= block.size() ) return std::unexpected( "truncated integer" );
+
+            uint64_t max_prefix = ( 1u << prefix_bits ) - 1;
+            uint64_t value = block[ pos++ ] & max_prefix;
+            if ( value < max_prefix ) return value;
+
+            for ( int shift = 0; shift <= 28; shift += 7 ) {
+                if ( pos >= block.size() ) return std::unexpected( "truncated integer" );
+                uint8_t byte = block[ pos++ ];
+                value += static_cast<uint64_t>( byte & 0x7f ) << shift;
+                if ( !( byte & 0x80 ) ) return value;
+            }
+
+            return std::unexpected( "integer too large" );
+        }
+
+        std::expected<std::string,std::string> decode_string( std::span<const uint8_t> block, size_t& pos ) {
+
+            if ( pos >= block.size() ) return std::unexpected( "truncated string" );
+            bool huffman = block[ pos ] & 0x80;
+
+            auto length = decode_integer( block, pos, 7 );
+            if ( !length ) return std::unexpected( length.error() );
+            if ( *length > block.size() - pos ) return std::unexpected( "truncated string" );
+
+            auto bytes = block.subspan( pos, static_cast<size_t>( *length ) );
+            pos += bytes.size();
+
+            if ( huffman ) return hpack_huffman_decode( bytes );
+            return std::string( reinterpret_cast<const char*>( bytes.data() ), bytes.size() );
+        }
+
+    } // namespace
+
+    std::expected<std::string,std::string> hpack_huffman_decode( std::span<const uint8_t> encoded ) {
+
+        std::string decoded;
+        decoded.reserve( encoded.size() * 8 / 5 );
+
+        // canonical decoding: codes of one length are consecutive, first is the first of the current length
+        uint32_t code = 0;
+        uint32_t first = 0;
+        size_t index = 0;
+        size_t len = 0;
+        bool all_ones = true;
+
+        for ( uint8_t byte : encoded ) {
+            for ( int bit = 7; bit >= 0; --bit ) {
+
+                uint32_t b = ( byte >> bit ) & 1;
+                code = ( code << 1 ) | b;
+                all_ones &= b == 1;
+                ++len;
+
+                uint32_t count = huffman_code.counts[ len ];
+                if ( code - first < count ) {
+                    uint16_t symbol = huffman_code.symbols[ index + code - first ];
+                    if ( symbol == eos_symbol ) return std::unexpected( "huffman string contains eos" );
+                    decoded.push_back( static_cast<char>( symbol ) );
+                    code = first = 0;
+                    index = 0;
+                    len = 0;
+                    all_ones = true;
+                    continue;
+                }
+
+                if ( len == max_code_len ) return std::unexpected( "invalid huffman code" );
+                first = ( first + count ) << 1;
+                index += count;
+            }
+        }
+
+        // what is left is padding, the start of eos: fewer than 8 bits, all ones
+        if ( len > 7 || !all_ones ) return std::unexpected( "invalid huffman padding" );
+
+        return decoded;
+    }
+
+    hpack_decoder::hpack_decoder( size_t max_table_size )
+        : m_size( 0 ), m_capacity( max_table_size ), m_limit( max_table_size ) {}
+
+    std::expected<void,std::string> hpack_decoder::decode( std::span<const uint8_t> block, std::vector<hpack_header>& headers ) {
+
+        size_t pos = 0;
+
+        while ( pos < block.size() ) {
+
+            uint8_t first = block[ pos ];
+
+            // indexed field, 6.1
+            if ( first & 0x80 ) {
+                auto index = decode_integer( block, pos, 7 );
+                if ( !index ) return std::unexpected( index.error() );
+                auto* field = entry( *index );
+                if ( !field ) return std::unexpected( "header index out of range" );
+                headers.push_back( *field );
+                continue;
+            }
+
+            // dynamic table size update, 6.3
+            if ( ( first & 0xe0 ) == 0x20 ) {
+                auto size = decode_integer( block, pos, 5 );
+                if ( !size ) return std::unexpected( size.error() );
+                if ( *size > m_limit ) return std::unexpected( "table size update above the limit" );
+                m_capacity = static_cast<size_t>( *size );
+                evict();
+                continue;
+            }
+
+            // a literal, with incremental indexing ( 6.2.1 ), without ( 6.2.2 ) or never indexed ( 6.2.3 )
+            bool indexing = first & 0x40;
+            auto index = decode_integer( block, pos, indexing ? 6 : 4 );
+            if ( !index ) return std::unexpected( index.error() );
+
+            hpack_header header;
+            if ( *index > 0 ) {
+                auto* field = entry( *index );
+                if ( !field ) return std::unexpected( "header index out of range" );
+                header.name = field->name;
+            } else {
+                auto name = decode_string( block, pos );
+                if ( !name ) return std::unexpected( name.error() );
+                header.name = std::move( *name );
+            }
+
+            auto value = decode_string( block, pos );
+            if ( !value ) return std::unexpected( value.error() );
+            header.value = std::move( *value );
+
+            if ( indexing ) insert( header );
+            headers.push_back( std::move( header ) );
+        }
+
+        return {};
+    }
+
+    void hpack_decoder::set_max_table_size( size_t size ) {
+        m_limit = size;
+        if ( m_capacity > m_limit ) {
+            m_capacity = m_limit;
+            evict();
+        }
+    }
+
+    size_t hpack_decoder::table_size() const {
+        return m_size;
+    }
+
+    size_t hpack_decoder::table_entries() const {
+        return m_table.size();
+    }
+
+    const hpack_header* hpack_decoder::entry( uint64_t index ) const {
+
+        if ( index == 0 ) return nullptr;
+        if ( index <= static_table.size() ) return &static_table[ index - 1 ];
+
+        index -= static_table.size() + 1;
+        return index < m_table.size() ? &m_table[ index ] : nullptr;
+    }
+
+    void hpack_decoder::insert( hpack_header header ) {
+
+        size_t size = header.name.size() + header.value.size() + entry_overhead;
+
+        // an entry larger than the table empties it and is not added, 4.4
+        if ( size > m_capacity ) {
+            m_table.clear();
+            m_size = 0;
+            return;
+        }
+
+        m_table.push_front( std::move( header ) );
+        m_size += size;
+        evict();
+    }
+
+    void hpack_decoder::evict() {
+        while ( m_size > m_capacity && !m_table.empty() ) {
+            m_size -= m_table.back().name.size() + m_table.back().value.size() + entry_overhead;
+            m_table.pop_back();
+        }
+    }
+
+} // namespace ntk
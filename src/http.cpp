@@ -1,7 +1,69 @@
 #include <http.hpp>
+#include <payload_classifier.hpp>
+
+#include <cctype>
+#include <charconv>
+#include <stdexcept>
 
 namespace ntk {
 
+    namespace {
+
+        // a header block longer than this is not http we can follow
+        constexpr size_t max_head_len = 64 * 1024;
+
+        char lower( char c ) {
+            return c >= 'A' && c <= 'Z' ? static_cast<char>( c + ( 'a' - 'A' ) ) : c;
+        }
+
+        bool iequals( std::string_view lhs, std::string_view rhs ) {
+            return lhs.size() == rhs.size() && std::equal( lhs.begin(), lhs.end(), rhs.begin(), []( char a, char b ) {
+                return lower( a ) == lower( b );
+            });
+        }
+
+        // in the order of http_header_view::common_header
+        constexpr std::array<std::string_view,4> common_header_names = {
+            "Content-Length", "Transfer-Encoding", "Content-Encoding", "Content-Type"
+        };
+
+        std::string_view trim_view( std::string_view text ) {
+            while ( !text.empty() && ( text.front() == ' ' || text.front() == '\t' ) ) text.remove_prefix( 1 );
+            while ( !text.empty() && ( text.back() == ' ' || text.back() == '\t' || text.back() == '\r' ) ) text.remove_suffix( 1 );
+            return text;
+        }
+
+        std::optional<uint64_t> parse_number( std::string_view text, int base ) {
+            text = trim_view( text );
+            if ( text.empty() || text.size() > 16 ) return std::nullopt;
+            uint64_t value = 0;
+            for ( char c : text ) {
+                int digit = std::isdigit( static_cast<unsigned char>( c ) ) ? c - '0'
+                          : base == 16 && std::isxdigit( static_cast<unsigned char>( c ) ) ? std::tolower( c ) - 'a' + 10
+                          : -1;
+                if ( digit < 0 ) return std::nullopt;
+                value = value * base + digit;
+            }
+            return value;
+        }
+
+        // false as soon as the first bytes rule out a request or status line, so a stream that is
+        // not http is not held until a header block's worth of it went by
+        bool could_start_message( http_type type, std::string_view head ) {
+            if ( type == http_type::RESPONSE ) {
+                std::string_view version = "HTTP/";
+                return head.substr( 0, version.size() ) == version.substr( 0, std::min( head.size(), version.size() ) );
+            }
+            constexpr size_t max_method_len = 16;
+            for ( size_t i = 0; i < head.size() && i <= max_method_len; ++i ) {
+                if ( head[ i ] == ' ' ) return i > 0;
+                if ( head[ i ] < 'A' || head[ i ] > 'Z' ) return false;
+            }
+            return head.size() <= max_method_len;
+        }
+
+    } // namespace
+
     std::string trim( const std::string& str ) {
         
         size_t start = str.find_first_not_of(" \t\r\n" );
@@ -13,26 +75,14 @@ namespace ntk {
     }
 
     bool is_http( const std::vector<uint8_t>& maybe_http_payload ) {
-
-        std::string first_five( maybe_http_payload.begin(), maybe_http_payload.begin() + 5 );
-
-        if ( first_five.compare( 0, 5, "HTTP/" ) == 0 || first_five.compare( 0, 3, "GET" ) == 0 ) {
-            return true;
-        }
-        
-        return false;
+        return is_http_protocol( classify_payload( maybe_http_payload ) );
     }
 
     http_type get_http_type( const std::vector<uint8_t>& http_payload ) {
-
-        std::string first_five( http_payload.begin(), http_payload.begin() + 5 );
-
-        if ( first_five.compare( 0, 5, "HTTP/" ) == 0 ) {
-            return http_type::RESPONSE; 
-        } else if ( first_five.compare( 0, 3, "GET" ) == 0 ) {
-            return http_type::REQUEST;
-        } else {
-            return http_type::DATA;
+        switch ( classify_payload( http_payload ) ) {
+            case payload_protocol::HTTP_RESPONSE: return http_type::RESPONSE;
+            case payload_protocol::HTTP_REQUEST: return http_type::REQUEST;
+            default: return http_type::DATA;
         }
     }
 
@@ -73,11 +123,12 @@ namespace ntk {
         auto request_line_end = std::search( begin, end, "\r\n", "\r\n" + 2 );
         std::vector<uint8_t> request_line( begin, request_line_end );
 
-        auto headers_start = request_line_end + 2; 
+        // a payload cut before the end of a section leaves the sections after it empty
+        auto headers_start = request_line_end == end ? end : request_line_end + 2; 
         auto headers_end = std::search( headers_start, end, "\r\n\r\n", "\r\n\r\n" + 4 );
         std::vector<uint8_t> headers( headers_start, headers_end );
         
-        auto body_start = headers_end + 4; 
+        auto body_start = headers_end == end ? end : headers_end + 4; 
         std::vector<uint8_t> body( body_start, end );
 
         return { request_line, headers, body };
@@ -94,95 +145,196 @@ namespace ntk {
         return r_line;
     }
 
+    size_t http_header_name_hash::operator()( std::string_view name ) const {
+        // fnv-1a over the lower case name
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for ( char c : name ) {
+            hash ^= static_cast<uint8_t>( lower( c ) );
+            hash *= 0x100000001b3ull;
+        }
+        return static_cast<size_t>( hash );
+    }
+
+    bool http_header_name_equal::operator()( std::string_view lhs, std::string_view rhs ) const {
+        return iequals( lhs, rhs );
+    }
+
     bool contains_http_header( const http_headers& headers, const std::string& header_name  ) {
         return headers.contains( header_name );
     }  
 
-    http_headers parse_http_headers(const std::vector<uint8_t>& header_bytes) {
-        
-        std::string headers_string( header_bytes.begin(), header_bytes.end() );
-        http_headers headers;
+    const std::string* find_http_header( const http_headers& headers, std::string_view header_name ) {
+        auto it = headers.find( header_name );
+        return it == headers.end() ? nullptr : &it->second;
+    }
 
-        size_t pos = 0;
+    http_header_view::http_header_view( std::string_view header_lines ) {
+
+        static_assert( common_header_names.size() == COMMON_HEADERS );
 
-        while ( pos < headers_string.size() ) {
-            
-            size_t line_end = headers_string.find( "\r\n", pos );
-            std::string line;
+        while ( !header_lines.empty() ) {
+
+            size_t line_end = header_lines.find( '\n' );
+            auto line = header_lines.substr( 0, line_end );
+            header_lines.remove_prefix( line_end == std::string_view::npos ? header_lines.size() : line_end + 1 );
+
+            size_t colon = line.find( ':' );
+            if ( colon == std::string_view::npos ) continue;
+
+            add( { trim_view( line.substr( 0, colon ) ), trim_view( line.substr( colon + 1 ) ) } );
+        }
+    }
+
+    http_header_view::http_header_view( std::span<const http_header_field> fields ) {
+        for ( const auto& field : fields ) add( field );
+    }
 
-            if ( line_end == std::string::npos ) {
-                line = headers_string.substr( pos );
-                pos = headers_string.size();
-            } else {
-                line = headers_string.substr( pos, line_end - pos );
-                pos = line_end + 2; 
+    void http_header_view::add( http_header_field field ) {
+        if ( m_size < inline_fields ) {
+            for ( size_t i = 0; i < common_header_names.size(); ++i ) {
+                // the first of a repeated header, as a lookup would find
+                if ( m_common[ i ] == missing && iequals( field.name, common_header_names[ i ] ) ) m_common[ i ] = static_cast<uint8_t>( m_size );
             }
+            m_inline[ m_size ] = field;
+        } else {
+            m_overflow.push_back( field );
+        }
+        ++m_size;
+    }
 
-            size_t colon_pos = line.find( ':' );
-            std::string key = trim( line.substr( 0, colon_pos ) );
-            std::string value = trim( line.substr( colon_pos + 1 ) );
+    std::optional<std::string_view> http_header_view::get( std::string_view name ) const {
+        for ( size_t i = 0; i < m_size; ++i ) {
+            if ( iequals( ( *this )[ i ].name, name ) ) return ( *this )[ i ].value;
+        }
+        return std::nullopt;
+    }
+
+    bool http_header_view::contains( std::string_view name ) const {
+        return get( name ).has_value();
+    }
 
-            headers[ key ] = value;
+    std::optional<std::string_view> http_header_view::common( common_header header ) const {
+        if ( m_common[ header ] != missing ) return m_inline[ m_common[ header ] ].value;
+        if ( m_size <= inline_fields ) return std::nullopt;
+
+        // only a header past the inline fields is searched for
+        for ( const auto& field : m_overflow ) {
+            if ( iequals( field.name, common_header_names[ header ] ) ) return field.value;
         }
+        return std::nullopt;
+    }
+
+    std::optional<uint64_t> http_header_view::content_length() const {
+        auto value = common( CONTENT_LENGTH );
+        return value ? parse_number( *value, 10 ) : std::nullopt;
+    }
+
+    std::optional<std::string_view> http_header_view::transfer_encoding() const {
+        return common( TRANSFER_ENCODING );
+    }
 
+    std::optional<std::string_view> http_header_view::content_encoding() const {
+        return common( CONTENT_ENCODING );
+    }
+
+    std::optional<std::string_view> http_header_view::content_type() const {
+        return common( CONTENT_TYPE );
+    }
+
+    bool http_header_view::is_chunked() const {
+        auto codings = transfer_encoding();
+        if ( !codings ) return false;
+        auto last = codings->substr( codings->rfind( ',' ) == std::string_view::npos ? 0 : codings->rfind( ',' ) + 1 );
+        return iequals( trim_view( last ), "chunked" );
+    }
+
+    size_t http_header_view::size() const {
+        return m_size;
+    }
+
+    const http_header_field& http_header_view::operator[]( size_t i ) const {
+        return i < inline_fields ? m_inline[ i ] : m_overflow[ i - inline_fields ];
+    }
+
+    http_headers http_header_view::to_headers() const {
+        http_headers headers;
+        headers.reserve( m_size );
+        for ( size_t i = 0; i < m_size; ++i ) {
+            const auto& field = ( *this )[ i ];
+            headers.insert_or_assign( std::string( field.name ), std::string( field.value ) );
+        }
         return headers;
     }
 
+    http_headers parse_http_headers( const std::vector<uint8_t>& header_bytes ) {
+        std::string_view header_lines( reinterpret_cast<const char*>( header_bytes.data() ), header_bytes.size() );
+        return http_header_view( header_lines ).to_headers();
+    }
+
     http_headers get_http_headers_from_payload( const std::vector<uint8_t>& http_payload_bytes ) {
         auto http_header_bytes = std::get<1>( split_http_payload( http_payload_bytes ) );
         return parse_http_headers( http_header_bytes );
     }
 
     http_response_status_line parse_http_status_line( const std::vector<uint8_t>& status_line_bytes ) {
+        auto status_line = try_parse_http_status_line( status_line_bytes );
+        if ( !status_line ) throw std::invalid_argument( status_line.error() );
+        return std::move( *status_line );
+    }
 
-        std::string line( status_line_bytes.begin(), status_line_bytes.end() );
-        std::istringstream stream(line);
-        
-        http_response_status_line status_line;
-        stream >> status_line.http_version;
+    std::expected<http_response_status_line,std::string> try_parse_http_status_line( std::span<const uint8_t> status_line_bytes ) {
+
+        std::string_view line( reinterpret_cast<const char*>( status_line_bytes.data() ), status_line_bytes.size() );
+        auto is_space = []( char c ) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; };
+        auto skip_spaces = [&]() { while ( !line.empty() && is_space( line.front() ) ) line.remove_prefix( 1 ); };
 
-        std::string status_code_string;
-        stream >> status_code_string;
-        status_line.status_code = std::stoi( status_code_string );
+        skip_spaces();
+        size_t version_end = std::find_if( line.begin(), line.end(), is_space ) - line.begin();
+        if ( version_end == 0 ) return std::unexpected( "status line without a version" );
 
-        std::string reason_phrase;
-        std::getline( stream, reason_phrase );
+        http_response_status_line status_line;
+        status_line.http_version = std::string( line.substr( 0, version_end ) );
+        line.remove_prefix( version_end );
+        skip_spaces();
+
+        auto [ end, ec ] = std::from_chars( line.data(), line.data() + line.size(), status_line.status_code );
+        if ( ec != std::errc() || ( end != line.data() + line.size() && !is_space( *end ) ) ) {
+            return std::unexpected( "status line without a status code" );
+        }
+        line.remove_prefix( end - line.data() );
 
-        status_line.reason_phrase = trim(reason_phrase);
+        status_line.reason_phrase = std::string( trim_view( line ) );
+        while ( !status_line.reason_phrase.empty() && is_space( status_line.reason_phrase.back() ) ) status_line.reason_phrase.pop_back();
 
         return status_line;
     }
 
     std::vector<uint8_t> decode_single_chunk( const std::vector<uint8_t>& chunked_body ) {
-        auto it = std::search( chunked_body.begin(), chunked_body.end(), "\r\n", "\r\n" + 2 );
-        size_t chunk_size = std::stoul( std::string( chunked_body.begin(), it ), nullptr, 16 );
-        auto data_start = it + 2;
-        return std::vector<uint8_t>( data_start, data_start + chunk_size );
+        auto chunk = try_decode_single_chunk( chunked_body );
+        if ( !chunk ) throw std::invalid_argument( chunk.error() );
+        return std::vector<uint8_t>( chunk->begin(), chunk->end() );
     }
 
-    std::vector<uint8_t> decode_chunked_http_body( const std::vector<uint8_t>& chunked_body ) {
-            
-        std::vector<uint8_t> decoded;
-        size_t pos = 0;
-
-        while (pos < chunked_body.size()) {
+    std::expected<std::span<const uint8_t>,std::string> try_decode_single_chunk( std::span<const uint8_t> chunked_body ) {
 
-            auto crlf = std::search( chunked_body.begin() + pos, chunked_body.end(), "\r\n", "\r\n" + 2 );
-            if ( crlf == chunked_body.end() ) break;
+        std::string_view body( reinterpret_cast<const char*>( chunked_body.data() ), chunked_body.size() );
+        size_t line_end = body.find( "\r\n" );
+        if ( line_end == std::string_view::npos ) return std::unexpected( "chunk size line without an end" );
 
-            std::string chunk_size_str( chunked_body.begin() + pos, crlf );
-            size_t chunk_size = std::stoul( chunk_size_str, nullptr, 16 );
-            
-            pos = crlf - chunked_body.begin() + 2;
-
-            if ( chunk_size == 0 ) break;
-            if ( pos + chunk_size > chunked_body.size() ) break;
-            
-            decoded.insert( decoded.end(), chunked_body.begin() + pos, chunked_body.begin() + pos + chunk_size );
-            
-            pos += chunk_size + 2;  
+        size_t chunk_size = 0;
+        auto [ end, ec ] = std::from_chars( body.data(), body.data() + line_end, chunk_size, 16 );
+        if ( ec != std::errc() || ( end != body.data() + line_end && *end != ';' && *end != ' ' ) ) {
+            return std::unexpected( "malformed chunk size" );
         }
 
+        size_t data_start = line_end + 2;
+        if ( chunk_size > chunked_body.size() - data_start ) return std::unexpected( "chunk cut short" );
+        return chunked_body.subspan( data_start, chunk_size );
+    }
+
+    std::vector<uint8_t> decode_chunked_http_body( const std::vector<uint8_t>& chunked_body ) {
+        std::vector<uint8_t> decoded( chunked_body );
+        decoded.resize( chunked_decoder().decode_in_place( decoded ) );
         return decoded;
     }
 
@@ -202,6 +354,39 @@ namespace ntk {
     }   
 
     std::vector<uint8_t> get_http_response_data( const tcp_stream& stream ) {
+        return get_http_response_body( stream ).to_vector();
+    }
+
+    void http_body_view::append( std::span<const uint8_t> piece ) {
+        if ( piece.empty() ) return;
+        m_size += piece.size();
+        if ( !m_pieces.empty() && m_pieces.back().data() + m_pieces.back().size() == piece.data() ) {
+            m_pieces.back() = std::span<const uint8_t>( m_pieces.back().data(), m_pieces.back().size() + piece.size() );
+            return;
+        }
+        m_pieces.push_back( piece );
+    }
+
+    const std::vector<std::span<const uint8_t>>& http_body_view::pieces() const {
+        return m_pieces;
+    }
+
+    size_t http_body_view::size() const {
+        return m_size;
+    }
+
+    bool http_body_view::empty() const {
+        return m_size == 0;
+    }
+
+    std::vector<uint8_t> http_body_view::to_vector() const {
+        std::vector<uint8_t> bytes;
+        bytes.reserve( m_size );
+        for ( auto piece : m_pieces ) bytes.insert( bytes.end(), piece.begin(), piece.end() );
+        return bytes;
+    }
+
+    http_body_view get_http_response_body( const tcp_stream& stream ) {
 
         auto response_pos = std::find_if( stream.begin(), stream.end(), 
             []( const auto& pair ) { 
@@ -210,23 +395,29 @@ namespace ntk {
             } 
         );
 
-        auto response = *response_pos;
-        auto http_headers = get_http_headers_from_payload( response.second );
-        auto response_data = std::get<2>( split_http_payload( response.second ) );
-
-        auto it = std::next( response_pos );
-
-        while ( it != stream.end() ) {
-            response_data.insert( response_data.end(),
-                it->second.begin(), it->second.end() );
-            ++it;
+        struct first_body : http_events {
+            void on_body( http_type type, std::span<const uint8_t> data ) override {
+                if ( !ended ) body.append( data );
+            }
+            void on_message_end( http_type type, bool complete ) override {
+                // a 1xx ends before anything of the body, the final response is the one wanted
+                if ( !body.empty() || !interim ) ended = true;
+            }
+            void on_response( const http_response& response, const http_request* request ) override {
+                interim = response.status_line.status_code < 200;
+            }
+            http_body_view body;
+            bool interim = false;
+            bool ended = false;
+        } events;
+
+        http_connection_parser parser( events );
+        for ( auto it = response_pos; it != stream.end() && !events.ended; ++it ) {
+            if ( !parser.feed( stream_direction::SERVER_TO_CLIENT, it->second ) ) break;
         }
+        if ( !events.ended ) parser.finish();
 
-        if ( contains_http_header( http_headers, "Content-Length" ) ) {
-            return response_data;
-        } else {
-            return decode_chunked_http_body( response_data );
-        }
+        return std::move( events.body );
     }
 
     http_request get_http_request( const std::vector<uint8_t>& http_payload ) {
@@ -241,15 +432,430 @@ namespace ntk {
     }
 
     http_response get_http_response( const std::vector<uint8_t>& http_payload ) {
+        auto response = try_get_http_response( http_payload );
+        if ( !response ) throw std::invalid_argument( response.error() );
+        return std::move( *response );
+    }
+
+    std::expected<http_response,std::string> try_get_http_response( const std::vector<uint8_t>& http_payload ) {
 
         http_response response;
 
         auto [ status_line_bytes, header_bytes, body_bytes ] = split_http_payload( http_payload );
-        response.status_line = parse_http_status_line( status_line_bytes );
+        auto status_line = try_parse_http_status_line( status_line_bytes );
+        if ( !status_line ) return std::unexpected( status_line.error() );
+
+        response.status_line = std::move( *status_line );
         response.headers = parse_http_headers( header_bytes );
-        response.body = body_bytes;
+        response.body = std::move( body_bytes );
 
         return response;
     }
 
-} // namespace ntk
\ No newline at end of file
+    chunked_decoder::piece chunked_decoder::decode( std::span<const uint8_t> input ) {
+
+        // a size line longer than this is not a size
+        constexpr size_t max_size_digits = 16;
+
+        size_t pos = 0;
+
+        while ( pos < input.size() ) {
+
+            uint8_t c = input[ pos ];
+
+            switch ( m_state ) {
+
+                case decode_state::SIZE:
+                    if ( std::isxdigit( c ) ) {
+                        if ( ++m_size_digits > max_size_digits ) {
+                            m_state = decode_state::FAILED;
+                            return { pos, {} };
+                        }
+                        m_remaining = m_remaining * 16 + ( std::isdigit( c ) ? c - '0' : lower( static_cast<char>( c ) ) - 'a' + 10 );
+                    } else if ( m_size_digits > 0 && ( c == ';' || c == ' ' || c == '\t' ) ) {
+                        m_state = decode_state::EXTENSION;
+                    } else if ( m_size_digits > 0 && c == '\r' ) {
+                        m_state = decode_state::SIZE_LF;
+                    } else if ( m_size_digits > 0 && c == '\n' ) {
+                        m_state = m_remaining == 0 ? decode_state::TRAILER_START : decode_state::DATA;
+                    } else {
+                        m_state = decode_state::FAILED;
+                        return { pos, {} };
+                    }
+                    ++pos;
+                    break;
+
+                case decode_state::EXTENSION:
+                    if ( c == '\n' ) m_state = m_remaining == 0 ? decode_state::TRAILER_START : decode_state::DATA;
+                    ++pos;
+                    break;
+
+                case decode_state::SIZE_LF:
+                    if ( c != '\n' ) {
+                        m_state = decode_state::FAILED;
+                        return { pos, {} };
+                    }
+                    m_state = m_remaining == 0 ? decode_state::TRAILER_START : decode_state::DATA;
+                    ++pos;
+                    break;
+
+                case decode_state::DATA: {
+                    size_t n = static_cast<size_t>( std::min<uint64_t>( m_remaining, input.size() - pos ) );
+                    m_remaining -= n;
+                    if ( m_remaining == 0 ) m_state = decode_state::DATA_CR;
+                    return { pos + n, input.subspan( pos, n ) };
+                }
+
+                case decode_state::DATA_CR:
+                case decode_state::DATA_LF:
+                    if ( c == '\r' && m_state == decode_state::DATA_CR ) {
+                        m_state = decode_state::DATA_LF;
+                    } else if ( c == '\n' ) {
+                        m_state = decode_state::SIZE;
+                        m_size_digits = 0;
+                    } else {
+                        m_state = decode_state::FAILED;
+                        return { pos, {} };
+                    }
+                    ++pos;
+                    break;
+
+                case decode_state::TRAILER_START:
+                    if ( c == '\r' ) {
+                        m_state = decode_state::TRAILER_LF;
+                    } else if ( c == '\n' ) {
+                        m_state = decode_state::DONE;
+                        return { pos + 1, {} };
+                    } else {
+                        m_state = decode_state::TRAILER_LINE;
+                    }
+                    ++pos;
+                    break;
+
+                case decode_state::TRAILER_LINE:
+                    if ( c == '\n' ) m_state = decode_state::TRAILER_START;
+                    ++pos;
+                    break;
+
+                case decode_state::TRAILER_LF:
+                    if ( c != '\n' ) {
+                        m_state = decode_state::FAILED;
+                        return { pos, {} };
+                    }
+                    m_state = decode_state::DONE;
+                    return { pos + 1, {} };
+
+                case decode_state::DONE:
+                case decode_state::FAILED:
+                    return { pos, {} };
+            }
+        }
+
+        return { pos, {} };
+    }
+
+    size_t chunked_decoder::decode_in_place( std::span<uint8_t> buffer ) {
+
+        // decoded bytes never run ahead of the input, so moving them down never overwrites what is still to be read
+        size_t decoded = 0;
+        feed( buffer, [&]( std::span<const uint8_t> data ) {
+            std::memmove( buffer.data() + decoded, data.data(), data.size() );
+            decoded += data.size();
+        });
+        return decoded;
+    }
+
+    bool chunked_decoder::done() const {
+        return m_state == decode_state::DONE;
+    }
+
+    bool chunked_decoder::failed() const {
+        return m_state == decode_state::FAILED;
+    }
+
+    void chunked_decoder::reset() {
+        m_state = decode_state::SIZE;
+        m_remaining = 0;
+        m_size_digits = 0;
+    }
+
+    http_connection_parser::http_connection_parser( http_events& events )
+        : m_events( events ), m_client{ http_type::REQUEST }, m_server{ http_type::RESPONSE } {}
+
+    bool http_connection_parser::feed( stream_direction direction, std::span<const uint8_t> data ) {
+
+        auto& side = direction == stream_direction::CLIENT_TO_SERVER ? m_client : m_server;
+
+        while ( !data.empty() ) {
+
+            size_t taken = 0;
+
+            switch ( side.state ) {
+
+                case parse_state::HEAD:
+                    taken = take_head( side, data );
+                    break;
+
+                case parse_state::LENGTH:
+                    taken = static_cast<size_t>( std::min<uint64_t>( side.remaining, data.size() ) );
+                    m_events.on_body( side.type, data.first( taken ) );
+                    side.remaining -= taken;
+                    if ( side.remaining == 0 ) end_message( side, true );
+                    break;
+
+                case parse_state::CHUNKED: {
+                    auto piece = side.chunked.decode( data );
+                    taken = piece.consumed;
+                    if ( !piece.data.empty() ) m_events.on_body( side.type, piece.data );
+                    if ( side.chunked.failed() ) {
+                        fail( side, "malformed chunked body" );
+                    } else if ( side.chunked.done() ) {
+                        end_message( side, true );
+                    }
+                    break;
+                }
+
+                case parse_state::UNTIL_CLOSE:
+                    m_events.on_body( side.type, data );
+                    taken = data.size();
+                    break;
+
+                case parse_state::UPGRADED:
+                    return true;
+
+                case parse_state::FAILED:
+                    return false;
+            }
+
+            data = data.subspan( taken );
+        }
+
+        return side.state != parse_state::FAILED;
+    }
+
+    size_t http_connection_parser::take_head( direction_state& side, std::span<const uint8_t> data ) {
+
+        size_t taken = 0;
+
+        // empty lines between messages are allowed
+        if ( side.line.empty() ) {
+            while ( taken < data.size() && ( data[ taken ] == '\r' || data[ taken ] == '\n' ) ) ++taken;
+            if ( taken == data.size() ) return taken;
+        }
+
+        // the block ends with an empty line, where the search stopped last time is kept in the line itself
+        size_t search_from = side.line.size() >= 3 ? side.line.size() - 3 : 0;
+        side.line.append( reinterpret_cast<const char*>( data.data() + taken ), data.size() - taken );
+
+        size_t end = std::string::npos;
+        for ( size_t i = search_from; i < side.line.size(); ++i ) {
+            if ( side.line[ i ] != '\n' ) continue;
+            if ( i + 1 < side.line.size() && side.line[ i + 1 ] == '\n' ) {
+                end = i + 2;
+                break;
+            }
+            if ( i + 2 < side.line.size() && side.line[ i + 1 ] == '\r' && side.line[ i + 2 ] == '\n' ) {
+                end = i + 3;
+                break;
+            }
+        }
+
+        if ( end == std::string::npos ) {
+            if ( side.line.size() > max_head_len ) {
+                fail( side, "header block too long" );
+            } else if ( !could_start_message( side.type, side.line ) ) {
+                fail( side, side.type == http_type::REQUEST ? "not a http/1.x request" : "not a http/1.x response" );
+            }
+            return data.size();
+        }
+
+        // what was appended beyond the block belongs to the body or the next message
+        size_t beyond = side.line.size() - end;
+        std::string head = std::move( side.line );
+        head.resize( end );
+        side.line.clear();
+
+        if ( side.type == http_type::REQUEST ) {
+            begin_request( side, head );
+        } else {
+            begin_response( side, head );
+        }
+
+        return data.size() - beyond;
+    }
+
+    namespace {
+
+        // the start line and the header lines after it
+        std::pair<std::string_view,std::string_view> split_head( std::string_view head ) {
+            size_t first_end = head.find( '\n' );
+            auto start_line = head.substr( 0, first_end );
+            if ( start_line.ends_with( '\r' ) ) start_line.remove_suffix( 1 );
+            return { start_line, head.substr( first_end + 1 ) };
+        }
+
+        std::optional<http_request_line> parse_request_line( std::string_view line ) {
+            size_t first = line.find( ' ' );
+            size_t second = first == std::string_view::npos ? first : line.find( ' ', first + 1 );
+            if ( first == 0 || second == std::string_view::npos || !line.substr( second + 1 ).starts_with( "HTTP/1." ) ) return std::nullopt;
+            return http_request_line{
+                std::string( line.substr( 0, first ) ),
+                std::string( line.substr( first + 1, second - first - 1 ) ),
+                std::string( line.substr( second + 1 ) )
+            };
+        }
+
+        std::optional<http_response_status_line> parse_status_line( std::string_view line ) {
+            if ( !line.starts_with( "HTTP/1." ) || line.size() < 12 || line[ 8 ] != ' ' ) return std::nullopt;
+            auto status = parse_number( line.substr( 9, 3 ), 10 );
+            if ( !status ) return std::nullopt;
+            return http_response_status_line{
+                std::string( line.substr( 0, 8 ) ),
+                static_cast<int>( *status ),
+                std::string( trim_view( line.substr( 12 ) ) )
+            };
+        }
+
+    } // namespace
+
+    void http_connection_parser::begin_request( direction_state& side, std::string_view head ) {
+
+        auto [ start_line, header_lines ] = split_head( head );
+
+        auto request_line = parse_request_line( start_line );
+        if ( !request_line ) {
+            fail( side, "not a http/1.x request" );
+            return;
+        }
+
+        http_request request;
+        request.request_line = std::move( *request_line );
+        request.header_view = http_header_view( header_lines );
+
+        m_events.on_request( request );
+
+        // a request has a body only when its headers say so
+        if ( set_body_framing( side, request.header_view, false ) && side.state == parse_state::HEAD ) end_message( side, true );
+
+        // the view does not outlive the head, the response needs only the request line
+        request.header_view = http_header_view();
+        m_pending.push_back( std::move( request ) );
+    }
+
+    void http_connection_parser::begin_response( direction_state& side, std::string_view head ) {
+
+        auto [ start_line, header_lines ] = split_head( head );
+
+        auto status_line = parse_status_line( start_line );
+        if ( !status_line ) {
+            fail( side, "not a http/1.x response" );
+            return;
+        }
+
+        http_response response;
+        response.status_line = std::move( *status_line );
+        response.header_view = http_header_view( header_lines );
+
+        int status = response.status_line.status_code;
+        const http_request* request = m_pending.empty() ? nullptr : &m_pending.front();
+
+        m_events.on_response( response, request );
+
+        // an interim response, the final one answers the same request
+        if ( status >= 100 && status < 200 ) {
+            end_message( side, true );
+            if ( status == 101 ) side.state = parse_state::UPGRADED;
+            return;
+        }
+
+        std::string method = request ? request->request_line.method_token : "";
+        if ( !m_pending.empty() ) m_pending.pop_front();
+
+        if ( method == "CONNECT" && status >= 200 && status < 300 ) {
+            end_message( side, true );
+            side.state = parse_state::UPGRADED;
+            return;
+        }
+
+        if ( method == "HEAD" || status == 204 || status == 304 ) {
+            end_message( side, true );
+            return;
+        }
+
+        if ( set_body_framing( side, response.header_view, true ) && side.state == parse_state::HEAD ) end_message( side, true );
+    }
+
+    bool http_connection_parser::set_body_framing( direction_state& side, const http_header_view& headers, bool until_close ) {
+
+        if ( headers.is_chunked() ) {
+            side.state = parse_state::CHUNKED;
+            side.chunked.reset();
+        } else if ( headers.contains( "Content-Length" ) ) {
+            auto length = headers.content_length();
+            if ( !length ) {
+                fail( side, "malformed Content-Length" );
+                return false;
+            }
+            side.remaining = *length;
+            side.state = *length > 0 ? parse_state::LENGTH : parse_state::HEAD;
+        } else {
+            side.state = until_close ? parse_state::UNTIL_CLOSE : parse_state::HEAD;
+        }
+
+        return true;
+    }
+
+    void http_connection_parser::end_message( direction_state& side, bool complete ) {
+        side.state = parse_state::HEAD;
+        side.remaining = 0;
+        side.line.clear();
+        m_events.on_message_end( side.type, complete );
+    }
+
+    void http_connection_parser::fail( direction_state& side, const std::string& reason ) {
+        side.state = parse_state::FAILED;
+        std::string().swap( side.line );
+        m_events.on_error( side.type, reason );
+    }
+
+    void http_connection_parser::finish() {
+        for ( auto* side : { &m_client, &m_server } ) {
+            switch ( side->state ) {
+                case parse_state::UNTIL_CLOSE:
+                    end_message( *side, true );
+                    break;
+                case parse_state::LENGTH:
+                case parse_state::CHUNKED:
+                    end_message( *side, false );
+                    break;
+                default:
+                    side->line.clear();
+                    break;
+            }
+        }
+        m_pending.clear();
+    }
+
+    std::vector<http_response> get_http_responses( std::span<const uint8_t> server_payload ) {
+
+        struct collector : http_events {
+            void on_response( const http_response& response, const http_request* request ) override {
+                if ( response.status_line.status_code < 200 ) return;
+                auto& copy = responses.emplace_back();
+                copy.status_line = response.status_line;
+                copy.headers = response.header_view.to_headers();
+            }
+            void on_body( http_type type, std::span<const uint8_t> data ) override {
+                responses.back().body.insert( responses.back().body.end(), data.begin(), data.end() );
+            }
+            std::vector<http_response> responses;
+        } events;
+
+        http_connection_parser parser( events );
+        parser.feed( stream_direction::SERVER_TO_CLIENT, server_payload );
+        parser.finish();
+
+        return std::move( events.responses );
+    }
+
+} // namespace ntk
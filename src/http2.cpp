@@ -0,0 +1,392 @@
+#include <http2.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace ntk {
+
+    namespace {
+
+        constexpr uint8_t flag_end_stream = 0x1;
+        constexpr uint8_t flag_ack = 0x1;
+        constexpr uint8_t flag_end_headers = 0x4;
+        constexpr uint8_t flag_padded = 0x8;
+        constexpr uint8_t flag_priority = 0x20;
+
+        constexpr uint16_t settings_header_table_size = 0x1;
+        constexpr size_t settings_entry_size = 6;
+
+        uint32_t read_u32( const uint8_t* bytes ) {
+            return ( uint32_t( bytes[ 0 ] ) << 24 ) | ( uint32_t( bytes[ 1 ] ) << 16 ) | ( uint32_t( bytes[ 2 ] ) << 8 ) | bytes[ 3 ];
+        }
+
+        bool buffered( http2_frame_type type ) {
+            return type != http2_frame_type::DATA;
+        }
+
+    } // namespace
+
+    std::optional<http2_frame_header> parse_http2_frame_header( std::span<const uint8_t> bytes ) {
+
+        if ( bytes.size() < http2_frame_header_size ) return std::nullopt;
+
+        http2_frame_header header;
+        header.length = ( uint32_t( bytes[ 0 ] ) << 16 ) | ( uint32_t( bytes[ 1 ] ) << 8 ) | bytes[ 2 ];
+        header.type = static_cast<http2_frame_type>( bytes[ 3 ] );
+        header.flags = bytes[ 4 ];
+        // the reserved bit is ignored
+        header.stream_id = read_u32( bytes.data() + 5 ) & 0x7fffffff;
+        return header;
+    }
+
+    http2_connection_parser::http2_connection_parser( http2_events& events )
+        : m_events( events ), m_client{ http_type::REQUEST, http2_client_preface.size() }, m_server{ http_type::RESPONSE }, m_failed( false ) {}
+
+    bool http2_connection_parser::feed( stream_direction direction, std::span<const uint8_t> data ) {
+
+        auto& side = direction == stream_direction::CLIENT_TO_SERVER ? m_client : m_server;
+
+        while ( !data.empty() && !m_failed ) {
+
+            // the preface is compared as it comes in, so a connection that is not h2 fails at once
+            if ( side.preface_left > 0 ) {
+                size_t offset = http2_client_preface.size() - side.preface_left;
+                size_t taken = std::min( side.preface_left, data.size() );
+                if ( std::memcmp( data.data(), http2_client_preface.data() + offset, taken ) != 0 ) {
+                    fail( "not an http/2 connection" );
+                    break;
+                }
+                side.preface_left -= taken;
+                data = data.subspan( taken );
+                continue;
+            }
+
+            if ( side.header_size < http2_frame_header_size ) {
+                size_t taken = std::min( http2_frame_header_size - side.header_size, data.size() );
+                std::memcpy( side.header.data() + side.header_size, data.data(), taken );
+                side.header_size += taken;
+                data = data.subspan( taken );
+                if ( side.header_size < http2_frame_header_size ) break;
+                if ( !begin_frame( side ) ) break;
+                if ( side.remaining == 0 ) end_frame( side );
+                continue;
+            }
+
+            size_t taken = 0;
+            if ( buffered( side.frame.type ) ) {
+                taken = std::min( side.remaining, data.size() );
+                side.payload.insert( side.payload.end(), data.begin(), data.begin() + taken );
+                side.remaining -= taken;
+            } else {
+                taken = take_data( side, data );
+            }
+            data = data.subspan( taken );
+
+            if ( side.remaining == 0 ) end_frame( side );
+        }
+
+        return !m_failed;
+    }
+
+    void http2_connection_parser::finish() {
+        std::vector<uint32_t> open;
+        for ( const auto& [ stream_id, stream ] : m_streams ) open.push_back( stream_id );
+        std::sort( open.begin(), open.end() );
+        for ( uint32_t stream_id : open ) reset_stream( stream_id );
+    }
+
+    bool http2_connection_parser::begin_frame( direction_state& side ) {
+
+        side.frame = *parse_http2_frame_header( side.header );
+        side.remaining = side.frame.length;
+        side.payload.clear();
+
+        bool continuing = !side.block.empty() || side.block_stream != 0;
+        if ( continuing != ( side.frame.type == http2_frame_type::CONTINUATION ) ||
+             ( continuing && side.frame.stream_id != side.block_stream ) ) {
+            fail( "header block interrupted" );
+            return false;
+        }
+
+        if ( buffered( side.frame.type ) && side.frame.length > max_buffered ) {
+            fail( "frame too large" );
+            return false;
+        }
+
+        switch ( side.frame.type ) {
+            case http2_frame_type::DATA:
+            case http2_frame_type::HEADERS:
+            case http2_frame_type::CONTINUATION:
+            case http2_frame_type::PUSH_PROMISE:
+            case http2_frame_type::RST_STREAM:
+                if ( side.frame.stream_id == 0 ) {
+                    fail( "stream frame on stream 0" );
+                    return false;
+                }
+                break;
+            default:
+                break;
+        }
+
+        if ( side.frame.type == http2_frame_type::DATA ) {
+            side.need_pad_length = side.frame.flags & flag_padded;
+            side.padding = 0;
+        }
+
+        return true;
+    }
+
+    size_t http2_connection_parser::take_data( direction_state& side, std::span<const uint8_t> data ) {
+
+        size_t taken = 0;
+
+        if ( side.need_pad_length ) {
+            side.need_pad_length = false;
+            side.padding = data[ 0 ];
+            --side.remaining;
+            if ( side.padding > side.remaining ) {
+                fail( "padding longer than the frame" );
+                return data.size();
+            }
+            taken = 1;
+        }
+
+        // the frame's data, then its padding
+        size_t body_left = side.remaining - side.padding;
+        size_t body = std::min( body_left, data.size() - taken );
+        if ( body > 0 ) {
+            auto it = m_streams.find( side.frame.stream_id );
+            if ( it != m_streams.end() && it->second.events ) {
+                auto state = side.type == http_type::REQUEST ? it->second.client : it->second.server;
+                if ( state == side_state::OPEN ) it->second.events->on_body( side.type, data.subspan( taken, body ) );
+            }
+            taken += body;
+            side.remaining -= body;
+        }
+
+        if ( side.remaining <= side.padding ) {
+            size_t skipped = std::min( side.remaining, data.size() - taken );
+            taken += skipped;
+            side.remaining -= skipped;
+            side.padding -= skipped;
+        }
+
+        return taken;
+    }
+
+    bool http2_connection_parser::end_frame( direction_state& side ) {
+
+        side.header_size = 0;
+        auto& frame = side.frame;
+        std::span<const uint8_t> payload( side.payload );
+
+        switch ( frame.type ) {
+
+            case http2_frame_type::DATA:
+                if ( frame.flags & flag_end_stream ) end_side( frame.stream_id, side.type, true );
+                return true;
+
+            case http2_frame_type::HEADERS:
+            case http2_frame_type::PUSH_PROMISE: {
+                size_t padding = 0;
+                if ( frame.flags & flag_padded ) {
+                    if ( payload.empty() ) break;
+                    padding = payload[ 0 ];
+                    payload = payload.subspan( 1 );
+                }
+                if ( frame.type == http2_frame_type::HEADERS && ( frame.flags & flag_priority ) ) {
+                    if ( payload.size() < 5 ) break;
+                    payload = payload.subspan( 5 );
+                }
+                side.promised_stream.reset();
+                if ( frame.type == http2_frame_type::PUSH_PROMISE ) {
+                    if ( payload.size() < 4 ) break;
+                    side.promised_stream = read_u32( payload.data() ) & 0x7fffffff;
+                    payload = payload.subspan( 4 );
+                }
+                if ( padding > payload.size() ) break;
+                side.block_stream = frame.stream_id;
+                side.block_end_stream = frame.type == http2_frame_type::HEADERS && ( frame.flags & flag_end_stream );
+                return on_header_fragment( side, payload.first( payload.size() - padding ), frame.flags & flag_end_headers );
+            }
+
+            case http2_frame_type::CONTINUATION:
+                return on_header_fragment( side, payload, frame.flags & flag_end_headers );
+
+            case http2_frame_type::RST_STREAM:
+                reset_stream( frame.stream_id );
+                return true;
+
+            case http2_frame_type::SETTINGS:
+                if ( !( frame.flags & flag_ack ) ) on_settings( side, payload );
+                return true;
+
+            default:
+                // PRIORITY, PING, GOAWAY, WINDOW_UPDATE and unknown types carry nothing to follow
+                return true;
+        }
+
+        fail( "malformed frame" );
+        return false;
+    }
+
+    bool http2_connection_parser::on_header_fragment( direction_state& side, std::span<const uint8_t> fragment, bool end_headers ) {
+
+        if ( side.block.size() + fragment.size() > max_buffered ) {
+            fail( "header block too large" );
+            return false;
+        }
+
+        bool ok = true;
+        if ( end_headers && side.block.empty() ) {
+            // the common case, the block is decoded where it is
+            side.block.assign( fragment.begin(), fragment.end() );
+            ok = on_header_block( side );
+        } else {
+            side.block.insert( side.block.end(), fragment.begin(), fragment.end() );
+            if ( end_headers ) ok = on_header_block( side );
+        }
+
+        if ( end_headers ) {
+            side.block.clear();
+            side.block_stream = 0;
+        }
+        return ok;
+    }
+
+    bool http2_connection_parser::on_header_block( direction_state& side ) {
+
+        m_decoded.clear();
+        if ( auto decoded = side.decoder.decode( side.block, m_decoded ); !decoded ) {
+            fail( "hpack: " + decoded.error() );
+            return false;
+        }
+
+        // regular fields as views into the decoded ones, :authority stands in for Host
+        m_fields.clear();
+        std::string_view method, path, authority, status;
+        bool has_host = false;
+        for ( const auto& header : m_decoded ) {
+            if ( header.name == ":method" ) method = header.value;
+            else if ( header.name == ":path" ) path = header.value;
+            else if ( header.name == ":authority" ) authority = header.value;
+            else if ( header.name == ":status" ) status = header.value;
+            else if ( !header.name.starts_with( ':' ) ) {
+                has_host |= header.name == "host";
+                m_fields.push_back( { header.name, header.value } );
+            }
+        }
+        if ( !has_host && !authority.empty() ) m_fields.push_back( { "host", authority } );
+
+        uint32_t stream_id = side.promised_stream.value_or( side.block_stream );
+        auto& stream = open_stream( stream_id );
+
+        // a pushed request is complete as promised, the response comes on the promised stream
+        if ( side.promised_stream || side.type == http_type::REQUEST ) {
+            if ( stream.client != side_state::IDLE ) {
+                // trailers
+                if ( side.block_end_stream ) end_side( stream_id, http_type::REQUEST, true );
+                return true;
+            }
+
+            http_request request;
+            request.request_line = { std::string( method ), std::string( method == "CONNECT" ? authority : path ), "HTTP/2" };
+            request.header_view = http_header_view( m_fields );
+            stream.client = side_state::OPEN;
+            if ( stream.events ) stream.events->on_request( request );
+            stream.request.request_line = std::move( request.request_line );
+
+            if ( side.promised_stream || side.block_end_stream ) end_side( stream_id, http_type::REQUEST, true );
+            return true;
+        }
+
+        if ( stream.final_response ) {
+            if ( side.block_end_stream ) end_side( stream_id, http_type::RESPONSE, true );
+            return true;
+        }
+
+        int status_code = 0;
+        auto [ end, ec ] = std::from_chars( status.data(), status.data() + status.size(), status_code );
+        if ( ec != std::errc() || end != status.data() + status.size() ) {
+            fail( "response without a valid :status" );
+            return false;
+        }
+
+        http_response response;
+        response.status_line = { "HTTP/2", status_code, "" };
+        response.header_view = http_header_view( m_fields );
+        const http_request* request = stream.client != side_state::IDLE ? &stream.request : nullptr;
+
+        // an interim response is a message of its own, the final one follows on the same stream
+        if ( status_code >= 100 && status_code < 200 ) {
+            if ( stream.events ) {
+                stream.events->on_response( response, request );
+                stream.events->on_message_end( http_type::RESPONSE, true );
+            }
+            return true;
+        }
+
+        stream.final_response = true;
+        stream.server = side_state::OPEN;
+        if ( stream.events ) stream.events->on_response( response, request );
+        if ( side.block_end_stream ) end_side( stream_id, http_type::RESPONSE, true );
+        return true;
+    }
+
+    void http2_connection_parser::on_settings( direction_state& side, std::span<const uint8_t> payload ) {
+        // what one endpoint announces bounds the encoder of the other
+        for ( size_t i = 0; i + settings_entry_size <= payload.size(); i += settings_entry_size ) {
+            uint16_t id = ( uint16_t( payload[ i ] ) << 8 ) | payload[ i + 1 ];
+            if ( id == settings_header_table_size ) other( side ).decoder.set_max_table_size( read_u32( payload.data() + i + 2 ) );
+        }
+    }
+
+    http2_connection_parser::stream_state& http2_connection_parser::open_stream( uint32_t stream_id ) {
+        auto [ it, inserted ] = m_streams.try_emplace( stream_id );
+        if ( inserted ) it->second.events = m_events.on_stream( stream_id );
+        return it->second;
+    }
+
+    void http2_connection_parser::end_side( uint32_t stream_id, http_type type, bool complete ) {
+
+        auto it = m_streams.find( stream_id );
+        if ( it == m_streams.end() ) return;
+        auto& stream = it->second;
+
+        auto& state = type == http_type::REQUEST ? stream.client : stream.server;
+        if ( state == side_state::OPEN && stream.events ) stream.events->on_message_end( type, complete );
+        state = side_state::CLOSED;
+
+        if ( stream.client == side_state::CLOSED && stream.server == side_state::CLOSED ) {
+            if ( stream.events ) m_events.on_stream_end( stream_id );
+            m_streams.erase( it );
+        }
+    }
+
+    void http2_connection_parser::reset_stream( uint32_t stream_id ) {
+
+        auto it = m_streams.find( stream_id );
+        if ( it == m_streams.end() ) return;
+        auto& stream = it->second;
+
+        if ( stream.events ) {
+            if ( stream.client == side_state::OPEN ) stream.events->on_message_end( http_type::REQUEST, false );
+            if ( stream.server == side_state::OPEN ) stream.events->on_message_end( http_type::RESPONSE, false );
+            m_events.on_stream_end( stream_id );
+        }
+        m_streams.erase( it );
+    }
+
+    void http2_connection_parser::fail( const std::string& reason ) {
+        if ( m_failed ) return;
+        finish();
+        m_failed = true;
+        m_events.on_error( reason );
+    }
+
+    http2_connection_parser::direction_state& http2_connection_parser::other( direction_state& side ) {
+        return &side == &m_client ? m_server : m_client;
+    }
+
+} // namespace ntk
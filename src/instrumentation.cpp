@@ -0,0 +1,212 @@
+#include <instrumentation.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <set>
+#include <sstream>
+
+namespace ntk {
+
+    namespace {
+        // ids are never reused, so a thread's entry for a histogram that is gone is never looked up again
+        std::atomic<uint64_t> next_histogram_id{ 0 };
+        thread_local std::vector<void*> t_shards;
+
+        std::string family_of( const std::string& name ) {
+            return name.substr( 0, name.find( '{' ) );
+        }
+
+        // adds a label to a name that may already carry some
+        std::string with_label( const std::string& name, const std::string& label ) {
+            auto brace = name.find( '{' );
+            if ( brace == std::string::npos ) return name + "{" + label + "}";
+            return name.substr( 0, name.size() - 1 ) + "," + label + "}";
+        }
+
+        std::string with_suffix( const std::string& name, const std::string& suffix ) {
+            auto brace = name.find( '{' );
+            if ( brace == std::string::npos ) return name + suffix;
+            return name.substr( 0, brace ) + suffix + name.substr( brace );
+        }
+    }
+
+    size_t histogram_buckets::index( uint64_t value ) {
+        if ( value < sub_buckets ) return static_cast<size_t>( value );
+        size_t exponent = std::bit_width( value ) - 1;
+        size_t sub = static_cast<size_t>( value >> ( exponent - sub_bucket_bits ) ) & ( sub_buckets - 1 );
+        return ( exponent - sub_bucket_bits + 1 ) * sub_buckets + sub;
+    }
+
+    uint64_t histogram_buckets::upper_bound( size_t index ) {
+        if ( index < sub_buckets ) return index;
+        size_t exponent = index / sub_buckets + sub_bucket_bits - 1;
+        uint64_t sub = index % sub_buckets;
+        uint64_t width = uint64_t( 1 ) << ( exponent - sub_bucket_bits );
+        return ( uint64_t( 1 ) << exponent ) + ( sub + 1 ) * width - 1;
+    }
+
+    histogram_snapshot::histogram_snapshot()
+        : m_buckets( histogram_buckets::count, 0 ), m_count( 0 ), m_sum( 0 ), m_max( 0 ) {}
+
+    void histogram_snapshot::merge( const histogram_snapshot& other ) {
+        for ( size_t i = 0; i < m_buckets.size(); ++i ) m_buckets[ i ] += other.m_buckets[ i ];
+        m_count += other.m_count;
+        m_sum += other.m_sum;
+        m_max = std::max( m_max, other.m_max );
+    }
+
+    uint64_t histogram_snapshot::count() const {
+        return m_count;
+    }
+
+    uint64_t histogram_snapshot::sum() const {
+        return m_sum;
+    }
+
+    uint64_t histogram_snapshot::max() const {
+        return m_max;
+    }
+
+    double histogram_snapshot::mean() const {
+        return m_count ? static_cast<double>( m_sum ) / m_count : 0.0;
+    }
+
+    uint64_t histogram_snapshot::percentile( double q ) const {
+
+        if ( m_count == 0 ) return 0;
+
+        q = std::clamp( q, 0.0, 1.0 );
+        uint64_t rank = std::max<uint64_t>( 1, static_cast<uint64_t>( std::ceil( q * m_count ) ) );
+
+        uint64_t seen = 0;
+        for ( size_t i = 0; i < m_buckets.size(); ++i ) {
+            seen += m_buckets[ i ];
+            // no bucket bound says more than the largest value recorded
+            if ( seen >= rank ) return std::min( histogram_buckets::upper_bound( i ), m_max );
+        }
+
+        return m_max;
+    }
+
+    histogram::histogram()
+        : m_id( next_histogram_id.fetch_add( 1, std::memory_order_relaxed ) ) {}
+
+    histogram::~histogram() = default;
+
+    void histogram::record( uint64_t value ) {
+        shard& s = local();
+        s.buckets[ histogram_buckets::index( value ) ].add();
+        s.count.add();
+        s.sum.add( value );
+        s.max.raise_to( value );
+    }
+
+    void histogram::record( std::chrono::nanoseconds duration ) {
+        record( static_cast<uint64_t>( std::max<int64_t>( duration.count(), 0 ) ) );
+    }
+
+    histogram::shard& histogram::local() {
+
+        if ( m_id < t_shards.size() && t_shards[ m_id ] ) return *static_cast<shard*>( t_shards[ m_id ] );
+
+        if ( m_id >= t_shards.size() ) t_shards.resize( m_id + 1, nullptr );
+
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_shards.push_back( std::make_unique<shard>() );
+        t_shards[ m_id ] = m_shards.back().get();
+
+        return *m_shards.back();
+    }
+
+    histogram_snapshot histogram::snapshot() const {
+
+        histogram_snapshot result;
+
+        std::lock_guard<std::mutex> lock( m_mutex );
+        for ( auto& s : m_shards ) {
+            for ( size_t i = 0; i < histogram_buckets::count; ++i ) result.m_buckets[ i ] += s->buckets[ i ].value();
+            result.m_count += s->count.value();
+            result.m_sum += s->sum.value();
+            result.m_max = std::max( result.m_max, s->max.value() );
+        }
+
+        return result;
+    }
+
+    const histogram_snapshot* metrics_snapshot::find_histogram( const std::string& name ) const {
+        auto found = std::find_if( histograms.begin(), histograms.end(), [&]( const named_histogram& h ) { return h.name == name; } );
+        return found == histograms.end() ? nullptr : &found->values;
+    }
+
+    std::optional<int64_t> metrics_snapshot::find_gauge( const std::string& name ) const {
+        auto found = std::find_if( gauges.begin(), gauges.end(), [&]( const named_gauge& g ) { return g.name == name; } );
+        if ( found == gauges.end() ) return std::nullopt;
+        return found->value;
+    }
+
+    histogram& metrics_registry::get_histogram( const std::string& name, const std::string& help, double scale ) {
+
+        std::lock_guard<std::mutex> lock( m_mutex );
+
+        for ( auto& entry : m_histograms ) {
+            if ( entry.name == name ) return *entry.values;
+        }
+
+        m_histograms.push_back( histogram_entry{ name, help, scale, std::make_unique<histogram>() } );
+        return *m_histograms.back().values;
+    }
+
+    void metrics_registry::add_gauge( const std::string& name, const std::string& help, std::function<int64_t()> sample ) {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_gauges.push_back( gauge_entry{ name, help, std::move( sample ) } );
+    }
+
+    metrics_snapshot metrics_registry::snapshot() const {
+
+        metrics_snapshot result;
+
+        std::lock_guard<std::mutex> lock( m_mutex );
+        for ( auto& entry : m_histograms ) result.histograms.push_back( named_histogram{ entry.name, entry.values->snapshot() } );
+        for ( auto& entry : m_gauges ) result.gauges.push_back( named_gauge{ entry.name, entry.sample() } );
+
+        return result;
+    }
+
+    void metrics_registry::write_prometheus( std::ostream& os ) const {
+
+        static constexpr std::array<double,4> quantiles = { 0.5, 0.9, 0.99, 0.999 };
+
+        std::lock_guard<std::mutex> lock( m_mutex );
+
+        // HELP and TYPE once per family
+        std::set<std::string> described;
+        auto describe = [&]( const std::string& name, const std::string& help, const char* type ) {
+            auto family = family_of( name );
+            if ( !described.insert( family ).second ) return;
+            if ( !help.empty() ) os << "# HELP " << family << ' ' << help << '\n';
+            os << "# TYPE " << family << ' ' << type << '\n';
+        };
+
+        for ( auto& entry : m_histograms ) {
+
+            auto values = entry.values->snapshot();
+            describe( entry.name, entry.help, "summary" );
+
+            for ( double q : quantiles ) {
+                std::ostringstream quantile;
+                quantile << "quantile=\"" << q << '"';
+                os << with_label( entry.name, quantile.str() ) << ' ' << values.percentile( q ) * entry.scale << '\n';
+            }
+            os << with_suffix( entry.name, "_sum" ) << ' ' << values.sum() * entry.scale << '\n';
+            os << with_suffix( entry.name, "_count" ) << ' ' << values.count() << '\n';
+        }
+
+        for ( auto& entry : m_gauges ) {
+            describe( entry.name, entry.help, "gauge" );
+            os << entry.name << ' ' << entry.sample() << '\n';
+        }
+    }
+
+} // namespace ntk
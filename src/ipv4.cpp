@@ -1,6 +1,8 @@
 
 #include <ipv4.hpp>
 
+#include <arpa/inet.h>
+
 namespace ntk {
 
     std::vector<uint8_t> extract_ipv4_header( const unsigned char* ethernet_frame ) {
@@ -20,6 +22,9 @@ namespace ntk {
 
         header.ihl = ( raw_ipv4_header[ 0 ] & 0x0F ) * 4;
         header.total_length = ( raw_ipv4_header[ 2 ] << 8 ) | raw_ipv4_header[ 3 ];
+        header.identification = ( raw_ipv4_header[ 4 ] << 8 ) | raw_ipv4_header[ 5 ];
+        header.flags = raw_ipv4_header[ 6 ] >> 5;
+        header.fragment_offset = ( ( ( raw_ipv4_header[ 6 ] & 0x1f ) << 8 ) | raw_ipv4_header[ 7 ] ) * 8;
         header.time_to_live = raw_ipv4_header[ 8 ];
         header.protocol = raw_ipv4_header[ 9 ];
         header.header_checksum = ( raw_ipv4_header[ 10 ] << 8 ) | raw_ipv4_header[ 11 ];
@@ -59,6 +64,24 @@ namespace ntk {
         return dest_src;
     }
 
+    bool is_ipv4_fragment( std::span<const uint8_t> frame, size_t ip_offset ) {
+
+        if ( frame.size() < ip_offset + 20 || ( frame[ ip_offset ] >> 4 ) != 4 ) return false;
+
+        // more fragments and the offset, don't fragment alone is a whole datagram
+        return ( ( frame[ ip_offset + 6 ] & 0x3f ) | frame[ ip_offset + 7 ] ) != 0;
+    }
+
+    std::string ip_to_string( const ip_address& ip ) {
+
+        if ( ip.is_v4() ) return ip_to_string( ip.v4() );
+
+        auto bytes = ip.bytes();
+        char text[ INET6_ADDRSTRLEN ];
+        if ( !inet_ntop( AF_INET6, bytes.data(), text, sizeof( text ) ) ) return "";
+        return text;
+    }
+
     std::string ip_to_string( uint32_t ip ) {
         std::ostringstream oss;
 
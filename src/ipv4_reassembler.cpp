@@ -0,0 +1,241 @@
+#include <ipv4_reassembler.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include <checksum.hpp>
+#include <constants.hpp>
+#include <flow_key.hpp>
+#include <ipv4.hpp>
+
+namespace ntk {
+
+    namespace {
+
+        constexpr uint16_t more_fragments = 0x2000;
+        constexpr uint16_t fragment_offset_mask = 0x1fff;
+        constexpr size_t max_datagram_len = 65535;
+
+        uint16_t read_u16( const uint8_t* p ) {
+            return static_cast<uint16_t>( ( p[ 0 ] << 8 ) | p[ 1 ] );
+        }
+
+        uint32_t read_u32( const uint8_t* p ) {
+            return ( static_cast<uint32_t>( p[ 0 ] ) << 24 ) | ( static_cast<uint32_t>( p[ 1 ] ) << 16 ) |
+                   ( static_cast<uint32_t>( p[ 2 ] ) << 8 ) | p[ 3 ];
+        }
+
+        void write_u16( uint8_t* p, uint16_t value ) {
+            p[ 0 ] = static_cast<uint8_t>( value >> 8 );
+            p[ 1 ] = static_cast<uint8_t>( value );
+        }
+
+    } // namespace
+
+    size_t ipv4_reassembler::datagram_key_hash::operator()( const datagram_key& key ) const noexcept {
+        uint64_t addresses = ( static_cast<uint64_t>( key.source_ip ) << 32 ) | key.destination_ip;
+        uint64_t rest = ( static_cast<uint64_t>( key.identification ) << 8 ) | key.protocol;
+        return static_cast<size_t>( flow_hash::mix( addresses ^ 0xa0761d6478bd642fULL, rest ^ 0xe7037ed1a0b428dbULL ) );
+    }
+
+    ipv4_reassembler::ipv4_reassembler( const fragment_limits& limits )
+        : m_limits( limits ) {}
+
+    fragment_result ipv4_reassembler::feed( std::span<const uint8_t> frame, std::optional<capture_time> now, size_t ip_offset ) {
+
+        if ( !is_ipv4_fragment( frame, ip_offset ) ) return fragment_result::NOT_FRAGMENT;
+
+        m_fragments.add();
+        if ( now ) expire( *now );
+
+        const uint8_t* ip = frame.data() + ip_offset;
+
+        size_t ip_header_len = ( ip[ 0 ] & 0x0f ) * 4;
+        size_t total_length = read_u16( ip + 2 );
+
+        // a fragment cut short by the snaplen leaves a hole that never fills
+        if ( ip_header_len < 20 || total_length <= ip_header_len || frame.size() < ip_offset + total_length ) return drop( std::nullopt );
+
+        uint16_t fragment = read_u16( ip + 6 );
+        bool last = !( fragment & more_fragments );
+        size_t begin = static_cast<size_t>( fragment & fragment_offset_mask ) * 8;
+        auto data = frame.subspan( ip_offset + ip_header_len, total_length - ip_header_len );
+        size_t end = begin + data.size();
+
+        // every fragment but the last carries whole 8 byte units, and no datagram is larger than 64 KiB
+        if ( ( !last && data.size() % 8 != 0 ) || ip_header_len + end > max_datagram_len ) return drop( std::nullopt );
+
+        datagram_key key{ read_u32( ip + 12 ), read_u32( ip + 16 ), read_u16( ip + 4 ), ip[ 9 ] };
+
+        auto found = m_index.find( key );
+        uint32_t index = found != m_index.end() ? found->second : acquire( key, now );
+        slot& s = m_slots[ index ];
+
+        // the end is fixed by the last fragment, nothing may lie beyond it
+        if ( ( s.total && end > *s.total ) || ( last && ( ( s.total && *s.total != end ) || s.payload.size() > end ) ) ) return drop( index );
+
+        size_t first_unit = begin / 8;
+        size_t end_unit = ( end + 7 ) / 8;
+        size_t units_held = 0;
+        for ( size_t unit = first_unit; unit < end_unit; ++unit ) units_held += s.received[ unit ];
+
+        if ( units_held > 0 ) {
+            // a retransmitted copy is harmless, anything else overlapping is not
+            bool same = units_held == end_unit - first_unit && end <= s.payload.size() &&
+                        std::equal( data.begin(), data.end(), s.payload.begin() + begin );
+            return same ? fragment_result::HELD : drop( index );
+        }
+
+        size_t header_len = begin == 0 ? ip_offset + ip_header_len : 0;
+        size_t growth = std::max( end, s.payload.size() ) - s.payload.size() + header_len;
+        auto source = m_source_bytes.find( key.source_ip );
+        size_t source_bytes = source != m_source_bytes.end() ? source->second : 0;
+        if ( m_limits.max_source_bytes > 0 && source_bytes + growth > m_limits.max_source_bytes ) return drop( index );
+
+        if ( end > s.payload.size() ) s.payload.resize( end );
+        std::memcpy( s.payload.data() + begin, data.data(), data.size() );
+        for ( size_t unit = first_unit; unit < end_unit; ++unit ) s.received.set( unit );
+        s.units_received += end_unit - first_unit;
+        if ( last ) s.total = end;
+        if ( header_len ) {
+            s.header.assign( frame.begin(), frame.begin() + header_len );
+            s.ip_offset = ip_offset;
+        }
+        hold( index, growth );
+
+        if ( !complete( s ) ) return fragment_result::HELD;
+
+        rebuild( s );
+        release( index );
+        m_reassembled.add();
+        return fragment_result::COMPLETE;
+    }
+
+    std::span<const uint8_t> ipv4_reassembler::datagram() const {
+        return m_datagram;
+    }
+
+    void ipv4_reassembler::advance_time( capture_time now ) {
+        expire( now );
+    }
+
+    size_t ipv4_reassembler::size() const {
+        return m_index.size();
+    }
+
+    fragment_statistics ipv4_reassembler::statistics() const {
+        return fragment_statistics{ m_fragments.value(), m_reassembled.value(), m_timed_out.value(),
+                                    m_evicted.value(), m_dropped.value(), m_bytes_held_gauge.value() };
+    }
+
+    uint32_t ipv4_reassembler::acquire( const datagram_key& key, std::optional<capture_time> now ) {
+
+        // reserved once so slots never move, a capture without fragments pays nothing
+        if ( m_slots.capacity() == 0 && m_limits.max_datagrams > 0 ) m_slots.reserve( m_limits.max_datagrams );
+
+        if ( m_free.empty() && m_limits.max_datagrams > 0 && m_slots.size() >= m_limits.max_datagrams ) {
+            release( m_oldest );
+            m_evicted.add();
+        }
+
+        uint32_t index;
+        if ( !m_free.empty() ) {
+            index = m_free.back();
+            m_free.pop_back();
+        } else {
+            index = static_cast<uint32_t>( m_slots.size() );
+            m_slots.emplace_back();
+        }
+
+        slot& s = m_slots[ index ];
+        s.key = key;
+        s.first_seen = now;
+
+        s.older = m_newest;
+        s.newer = none;
+        if ( m_newest != none ) m_slots[ m_newest ].newer = index;
+        m_newest = index;
+        if ( m_oldest == none ) m_oldest = index;
+
+        m_index.emplace( key, index );
+        return index;
+    }
+
+    void ipv4_reassembler::release( uint32_t index ) {
+
+        slot& s = m_slots[ index ];
+
+        size_t held = s.header.size() + s.payload.size();
+        if ( auto it = m_source_bytes.find( s.key.source_ip ); it != m_source_bytes.end() ) {
+            it->second -= std::min( it->second, held );
+            if ( it->second == 0 ) m_source_bytes.erase( it );
+        }
+        m_bytes_held -= held;
+        m_bytes_held_gauge.set( m_bytes_held );
+
+        if ( s.older != none ) m_slots[ s.older ].newer = s.newer; else m_oldest = s.newer;
+        if ( s.newer != none ) m_slots[ s.newer ].older = s.older; else m_newest = s.older;
+
+        m_index.erase( s.key );
+
+        // the buffers are given back, a table full of stale datagrams holds nothing
+        s.header = std::vector<uint8_t>();
+        s.ip_offset = 0;
+        s.payload = std::vector<uint8_t>();
+        s.received.reset();
+        s.units_received = 0;
+        s.total.reset();
+        s.first_seen.reset();
+        s.older = s.newer = none;
+
+        m_free.push_back( index );
+    }
+
+    void ipv4_reassembler::hold( uint32_t index, size_t bytes ) {
+        if ( bytes == 0 ) return;
+        m_source_bytes[ m_slots[ index ].key.source_ip ] += bytes;
+        m_bytes_held += bytes;
+        m_bytes_held_gauge.set( m_bytes_held );
+    }
+
+    void ipv4_reassembler::expire( capture_time now ) {
+
+        if ( m_limits.timeout.count() == 0 ) return;
+
+        // arrival order is deadline order, the oldest datagram is the first to run out
+        while ( m_oldest != none ) {
+            const slot& s = m_slots[ m_oldest ];
+            if ( !s.first_seen || now - *s.first_seen < m_limits.timeout ) break;
+            release( m_oldest );
+            m_timed_out.add();
+        }
+    }
+
+    bool ipv4_reassembler::complete( const slot& s ) const {
+        return s.total && !s.header.empty() && s.units_received == ( *s.total + 7 ) / 8;
+    }
+
+    void ipv4_reassembler::rebuild( const slot& s ) {
+
+        m_datagram.resize( s.header.size() + *s.total );
+        std::memcpy( m_datagram.data(), s.header.data(), s.header.size() );
+        std::memcpy( m_datagram.data() + s.header.size(), s.payload.data(), *s.total );
+
+        uint8_t* ip = m_datagram.data() + s.ip_offset;
+        size_t ip_header_len = s.header.size() - s.ip_offset;
+
+        write_u16( ip + 2, static_cast<uint16_t>( ip_header_len + *s.total ) );
+        // only don't fragment is kept, the datagram is whole now
+        write_u16( ip + 6, read_u16( ip + 6 ) & 0x4000 );
+        write_u16( ip + 10, 0 );
+        write_u16( ip + 10, static_cast<uint16_t>( ~ones_complement_sum( std::span<const uint8_t>( ip, ip_header_len ) ) ) );
+    }
+
+    fragment_result ipv4_reassembler::drop( std::optional<uint32_t> index ) {
+        // a datagram missing a fragment can never complete, so it goes with it
+        if ( index ) release( *index );
+        m_dropped.add();
+        return fragment_result::DROPPED;
+    }
+
+} // namespace ntk
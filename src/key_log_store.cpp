@@ -0,0 +1,262 @@
+#include <key_log_store.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace ntk {
+
+    namespace {
+
+        constexpr std::array<const char*,static_cast<size_t>( secret_label::COUNT )> label_names = {
+            "CLIENT_EARLY_TRAFFIC_SECRET",
+            "CLIENT_HANDSHAKE_TRAFFIC_SECRET",
+            "SERVER_HANDSHAKE_TRAFFIC_SECRET",
+            "CLIENT_TRAFFIC_SECRET_0",
+            "SERVER_TRAFFIC_SECRET_0",
+            "EXPORTER_SECRET",
+            "CLIENT_RANDOM"
+        };
+
+        int nibble( char c ) {
+            if ( c >= '0' && c <= '9' ) return c - '0';
+            if ( c >= 'a' && c <= 'f' ) return c - 'a' + 10;
+            if ( c >= 'A' && c <= 'F' ) return c - 'A' + 10;
+            return -1;
+        }
+
+        bool decode_hex( std::string_view hex, uint8_t* out ) {
+            for ( size_t i = 0; i + 1 < hex.size(); i += 2 ) {
+                int high = nibble( hex[ i ] );
+                int low = nibble( hex[ i + 1 ] );
+                if ( high < 0 || low < 0 ) return false;
+                out[ i / 2 ] = static_cast<uint8_t>( ( high << 4 ) | low );
+            }
+            return hex.size() % 2 == 0;
+        }
+
+        std::string_view next_field( std::string_view& line ) {
+            size_t start = line.find_first_not_of( " \t" );
+            if ( start == std::string_view::npos ) {
+                line = {};
+                return {};
+            }
+            size_t end = line.find_first_of( " \t\r", start );
+            auto field = line.substr( start, end - start );
+            line = end == std::string_view::npos ? std::string_view{} : line.substr( end );
+            return field;
+        }
+
+    } // namespace
+
+    std::optional<secret_label> parse_secret_label( std::string_view name ) {
+        for ( size_t i = 0; i < label_names.size(); ++i ) {
+            if ( name == label_names[ i ] ) return static_cast<secret_label>( i );
+        }
+        return std::nullopt;
+    }
+
+    const char* secret_label_name( secret_label label ) {
+        return label < secret_label::COUNT ? label_names[ static_cast<size_t>( label ) ] : "";
+    }
+
+    const std::vector<uint8_t>* session_secrets::find( secret_label label ) const {
+        auto& secret = secrets[ static_cast<size_t>( label ) ];
+        return secret.empty() ? nullptr : &secret;
+    }
+
+    key_log_store::key_log_store()
+        : m_offset( 0 ) {}
+
+    key_log_store::key_log_store( const std::string& filename )
+        : m_filename( filename ), m_offset( 0 ) {
+        read_appended( true );
+    }
+
+    key_log_store::~key_log_store() {
+        stop_following();
+    }
+
+    bool key_log_store::add_line( std::string_view line ) {
+
+        auto label_field = next_field( line );
+        if ( label_field.empty() || label_field[ 0 ] == '#' ) return false;
+
+        auto label = parse_secret_label( label_field );
+        if ( !label ) return false;
+
+        auto random_hex = next_field( line );
+        auto secret_hex = next_field( line );
+
+        client_random random;
+        if ( random_hex.size() != 2 * random.size() || !decode_hex( random_hex, random.data() ) ) return false;
+
+        std::vector<uint8_t> secret( secret_hex.size() / 2 );
+        if ( secret.empty() || !decode_hex( secret_hex, secret.data() ) ) return false;
+
+        {
+            std::unique_lock lock( m_mutex );
+            m_sessions[ random ].secrets[ static_cast<size_t>( *label ) ] = std::move( secret );
+        }
+        m_added.notify_all();
+
+        return true;
+    }
+
+    size_t key_log_store::poll() {
+        return read_appended( false );
+    }
+
+    size_t key_log_store::read_appended( bool end_of_input ) {
+
+        std::lock_guard read_lock( m_read_mutex );
+
+        if ( m_filename.empty() ) return 0;
+
+        std::ifstream file( m_filename, std::ios::binary );
+        if ( !file.is_open() ) return 0;
+
+        file.seekg( 0, std::ios::end );
+        uint64_t size = static_cast<uint64_t>( file.tellg() );
+
+        // truncated or replaced, read it again from the start
+        if ( size < m_offset ) {
+            m_offset = 0;
+            m_partial_line.clear();
+        }
+
+        std::string chunk( size - m_offset, '\0' );
+        file.seekg( static_cast<std::streamoff>( m_offset ) );
+        file.read( chunk.data(), static_cast<std::streamsize>( chunk.size() ) );
+        chunk.resize( static_cast<size_t>( file.gcount() ) );
+        m_offset += chunk.size();
+
+        size_t added = 0;
+        size_t start = 0;
+
+        while ( true ) {
+            size_t end = chunk.find( '\n', start );
+            if ( end == std::string::npos ) break;
+            std::string_view line( chunk.data() + start, end - start );
+            if ( !m_partial_line.empty() ) {
+                m_partial_line.append( line );
+                added += add_line( m_partial_line );
+                m_partial_line.clear();
+            } else {
+                added += add_line( line );
+            }
+            start = end + 1;
+        }
+
+        // only part of the last line has been written so far. nothing arriving for a while does not
+        // mean it is complete, an even length prefix of the secret would parse as a shorter secret
+        m_partial_line.append( chunk, start, std::string::npos );
+
+        if ( end_of_input && !m_partial_line.empty() ) added += add_line( m_partial_line );
+
+        return added;
+    }
+
+    bool key_log_store::follow() {
+
+        if ( m_filename.empty() ) return false;
+        if ( m_follower.joinable() ) return true;
+
+        m_follower = std::jthread( [ this ]( std::stop_token stop ) { run_follower( stop ); } );
+        return true;
+    }
+
+    void key_log_store::stop_following() {
+        if ( !m_follower.joinable() ) return;
+        m_follower.request_stop();
+        m_follower.join();
+        read_appended( true );
+    }
+
+    void key_log_store::run_follower( std::stop_token stop ) {
+
+#ifdef __linux__
+        // the directory is watched, so a key log created or replaced later is picked up as well
+        auto path = std::filesystem::absolute( m_filename );
+        std::string name = path.filename().string();
+
+        int fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+        int wd = fd < 0 ? -1 : inotify_add_watch( fd, path.parent_path().c_str(), IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO );
+
+        if ( wd >= 0 ) {
+            alignas( inotify_event ) char events[ 4096 ];
+
+            while ( !stop.stop_requested() ) {
+
+                // woken by the file changing, the timeout is only there to notice stop
+                pollfd p{ fd, POLLIN, 0 };
+                if ( ::poll( &p, 1, 100 ) <= 0 ) continue;
+
+                bool changed = false;
+                ssize_t n;
+                while ( ( n = ::read( fd, events, sizeof( events ) ) ) > 0 ) {
+                    for ( char* e = events; e < events + n; ) {
+                        auto* event = reinterpret_cast<inotify_event*>( e );
+                        if ( event->len && name == event->name ) changed = true;
+                        e += sizeof( inotify_event ) + event->len;
+                    }
+                }
+
+                if ( changed ) poll();
+            }
+
+            ::close( fd );
+            return;
+        }
+
+        std::cerr << "Failed to watch key log, polling instead: " << m_filename << '\n';
+        if ( fd >= 0 ) ::close( fd );
+#endif
+
+        while ( !stop.stop_requested() ) {
+            poll();
+            std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+        }
+    }
+
+    std::optional<std::vector<uint8_t>> key_log_store::find( const client_random& random, secret_label label ) const {
+
+        std::shared_lock lock( m_mutex );
+
+        auto it = m_sessions.find( random );
+        if ( it == m_sessions.end() ) return std::nullopt;
+
+        auto* secret = it->second.find( label );
+        if ( !secret ) return std::nullopt;
+
+        return *secret;
+    }
+
+    std::optional<std::vector<uint8_t>> key_log_store::wait_for( const client_random& random, secret_label label,
+                                                                 std::chrono::milliseconds timeout ) const {
+
+        std::shared_lock lock( m_mutex );
+
+        const std::vector<uint8_t>* secret = nullptr;
+        m_added.wait_for( lock, timeout, [ & ]() {
+            auto it = m_sessions.find( random );
+            secret = it == m_sessions.end() ? nullptr : it->second.find( label );
+            return secret != nullptr;
+        });
+
+        if ( !secret ) return std::nullopt;
+        return *secret;
+    }
+
+    size_t key_log_store::size() const {
+        std::shared_lock lock( m_mutex );
+        return m_sessions.size();
+    }
+
+} // namespace ntk
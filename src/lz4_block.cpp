@@ -0,0 +1,182 @@
+#include <lz4_block.hpp>
+
+#include <algorithm>
+#include <array>
+
+#include <cstring>
+
+namespace ntk {
+
+    namespace {
+
+        constexpr size_t min_match = 4;
+        // the last match starts at least this far from the end of the block
+        constexpr size_t match_limit = 12;
+        // and the block always ends on this many literals
+        constexpr size_t last_literals = 5;
+        constexpr size_t max_offset = 65535;
+
+        constexpr int hash_bits = 12;
+        // after this many misses in a row the search steps further, so incompressible data goes fast
+        constexpr size_t skip_trigger = 6;
+
+        uint32_t read32( const uint8_t* p ) {
+            uint32_t value;
+            std::memcpy( &value, p, sizeof( value ) );
+            return value;
+        }
+
+        uint32_t hash( uint32_t sequence ) {
+            return ( sequence * 2654435761u ) >> ( 32 - hash_bits );
+        }
+
+        // a length past what the token holds goes on in bytes of 255 and a last one below it
+        uint8_t* write_length( uint8_t* out, size_t length ) {
+            for ( ; length >= 255; length -= 255 ) *out++ = 255;
+            *out++ = static_cast<uint8_t>( length );
+            return out;
+        }
+
+        uint8_t* write_sequence( uint8_t* out, const uint8_t* literals, size_t literal_length, size_t offset, size_t match_length ) {
+
+            uint8_t* token = out++;
+            *token = static_cast<uint8_t>( std::min<size_t>( literal_length, 15 ) << 4 );
+            if ( literal_length >= 15 ) out = write_length( out, literal_length - 15 );
+
+            std::memcpy( out, literals, literal_length );
+            out += literal_length;
+
+            // the last sequence has literals only
+            if ( match_length == 0 ) return out;
+
+            *out++ = static_cast<uint8_t>( offset );
+            *out++ = static_cast<uint8_t>( offset >> 8 );
+
+            match_length -= min_match;
+            *token |= static_cast<uint8_t>( std::min<size_t>( match_length, 15 ) );
+            if ( match_length >= 15 ) out = write_length( out, match_length - 15 );
+
+            return out;
+        }
+
+        // false when the length runs past the end of the input
+        bool read_length( std::span<const uint8_t> input, size_t& position, size_t& length ) {
+            uint8_t byte;
+            do {
+                if ( position == input.size() ) return false;
+                byte = input[ position++ ];
+                length += byte;
+            } while ( byte == 255 );
+            return true;
+        }
+
+    } // namespace
+
+    size_t lz4_compress_bound( size_t size ) {
+        return size + size / 255 + 16;
+    }
+
+    void lz4_compress_block( std::span<const uint8_t> input, std::vector<uint8_t>& output ) {
+
+        output.resize( lz4_compress_bound( input.size() ) );
+
+        const uint8_t* base = input.data();
+        size_t size = input.size();
+        uint8_t* out = output.data();
+        size_t anchor = 0;
+
+        if ( size > match_limit ) {
+
+            // positions plus one, zero is a slot never filled
+            std::array<uint32_t,1 << hash_bits> table{};
+
+            size_t last_start = size - match_limit;
+            size_t end_of_match = size - last_literals;
+            size_t position = 0;
+            size_t misses = 0;
+
+            while ( position <= last_start ) {
+
+                uint32_t sequence = read32( base + position );
+                uint32_t& slot = table[ hash( sequence ) ];
+                size_t candidate = slot;
+                slot = static_cast<uint32_t>( position + 1 );
+
+                if ( candidate == 0 || position - ( candidate - 1 ) > max_offset || read32( base + candidate - 1 ) != sequence ) {
+                    position += 1 + ( misses++ >> skip_trigger );
+                    continue;
+                }
+
+                size_t match = candidate - 1;
+
+                // the match may run back into literals not yet written
+                while ( position > anchor && match > 0 && base[ position - 1 ] == base[ match - 1 ] ) {
+                    --position;
+                    --match;
+                }
+
+                size_t length = min_match;
+                while ( position + length < end_of_match && base[ match + length ] == base[ position + length ] ) ++length;
+
+                out = write_sequence( out, base + anchor, position - anchor, position - match, length );
+
+                position += length;
+                anchor = position;
+                misses = 0;
+
+                // one of the positions skipped over, so a repeat of what was just matched is found
+                if ( position <= last_start ) table[ hash( read32( base + position - 2 ) ) ] = static_cast<uint32_t>( position - 1 );
+            }
+        }
+
+        out = write_sequence( out, base + anchor, size - anchor, 0, 0 );
+        output.resize( out - output.data() );
+    }
+
+    std::expected<void,std::string> lz4_decompress_block( std::span<const uint8_t> input, std::span<uint8_t> output ) {
+
+        size_t in = 0;
+        size_t out = 0;
+
+        while ( true ) {
+
+            if ( in == input.size() ) return std::unexpected( "lz4 block ends without its last literals" );
+            uint8_t token = input[ in++ ];
+
+            size_t literal_length = token >> 4;
+            if ( literal_length == 15 && !read_length( input, in, literal_length ) ) return std::unexpected( "lz4 literal length is truncated" );
+
+            if ( literal_length > input.size() - in || literal_length > output.size() - out ) return std::unexpected( "lz4 literals run past the block" );
+            std::memcpy( output.data() + out, input.data() + in, literal_length );
+            in += literal_length;
+            out += literal_length;
+
+            if ( in == input.size() ) break;
+
+            if ( input.size() - in < 2 ) return std::unexpected( "lz4 match offset is truncated" );
+            size_t offset = input[ in ] | ( static_cast<size_t>( input[ in + 1 ] ) << 8 );
+            in += 2;
+            if ( offset == 0 || offset > out ) return std::unexpected( "lz4 match offset points before the block" );
+
+            size_t match_length = token & 15;
+            if ( match_length == 15 && !read_length( input, in, match_length ) ) return std::unexpected( "lz4 match length is truncated" );
+            match_length += min_match;
+
+            if ( match_length > output.size() - out ) return std::unexpected( "lz4 match runs past the block" );
+
+            // byte by byte where the match overlaps what it writes, a run of one byte repeated
+            uint8_t* destination = output.data() + out;
+            const uint8_t* source = destination - offset;
+            if ( offset >= match_length ) {
+                std::memcpy( destination, source, match_length );
+            } else {
+                for ( size_t i = 0; i < match_length; ++i ) destination[ i ] = source[ i ];
+            }
+            out += match_length;
+        }
+
+        if ( out != output.size() ) return std::unexpected( "lz4 block is shorter than expected" );
+        return {};
+    }
+
+} // namespace ntk
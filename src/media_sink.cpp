@@ -0,0 +1,377 @@
+#include <media_sink.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <system_error>
+#include <utility>
+
+namespace ntk {
+
+    namespace {
+
+        constexpr size_t page_size = 4096;
+
+        bool iequals( std::string_view lhs, std::string_view rhs ) {
+            return lhs.size() == rhs.size() && std::equal( lhs.begin(), lhs.end(), rhs.begin(), []( char a, char b ) {
+                return std::tolower( static_cast<unsigned char>( a ) ) == std::tolower( static_cast<unsigned char>( b ) );
+            });
+        }
+
+        bool icontains( std::string_view text, std::string_view word ) {
+            if ( word.size() > text.size() ) return false;
+            for ( size_t i = 0; i + word.size() <= text.size(); ++i ) {
+                if ( iequals( text.substr( i, word.size() ), word ) ) return true;
+            }
+            return false;
+        }
+
+        // the last part of the path without its query, kept to characters safe in a file name
+        std::string file_name_for( std::string_view path ) {
+            path = path.substr( 0, path.find_first_of( "?#" ) );
+            if ( auto slash = path.rfind( '/' ); slash != std::string_view::npos ) path.remove_prefix( slash + 1 );
+
+            std::string name;
+            for ( char c : path ) {
+                bool safe = std::isalnum( static_cast<unsigned char>( c ) ) || c == '.' || c == '-' || c == '_';
+                name.push_back( safe ? c : '_' );
+            }
+            if ( name.empty() || name == "." || name == ".." ) name = "segment";
+            return name;
+        }
+
+    } // namespace
+
+    std::optional<media_kind> classify_media( std::string_view content_type, std::string_view path ) {
+
+        if ( icontains( content_type, "mpegurl" ) ) return media_kind::PLAYLIST;
+        if ( icontains( content_type, "video/mp2t" ) ) return media_kind::MPEG_TS;
+        if ( icontains( content_type, "video/mp4" ) || icontains( content_type, "video/iso.segment" ) ||
+             icontains( content_type, "audio/mp4" ) ) return media_kind::FMP4;
+
+        // servers often send segments as octet-stream, the extension tells then
+        path = path.substr( 0, path.find_first_of( "?#" ) );
+        auto has_extension = [&]( std::string_view extension ) {
+            return path.size() >= extension.size() && iequals( path.substr( path.size() - extension.size() ), extension );
+        };
+        if ( has_extension( ".m3u8" ) ) return media_kind::PLAYLIST;
+        if ( has_extension( ".ts" ) ) return media_kind::MPEG_TS;
+        if ( has_extension( ".m4s" ) || has_extension( ".mp4" ) || has_extension( ".m4v" ) ) return media_kind::FMP4;
+
+        return std::nullopt;
+    }
+
+    segment_writer::segment_writer( size_t buffer_size )
+        : m_open( false ), m_file( nullptr ), m_followed( nullptr ), m_buffer( nullptr ), m_capacity( std::max( page_size, ( buffer_size + page_size - 1 ) / page_size * page_size ) ),
+          m_used( 0 ), m_bytes( 0 ) {}
+
+    segment_writer::~segment_writer() {
+        close();
+        std::free( m_buffer );
+    }
+
+    segment_writer::segment_writer( segment_writer&& other ) noexcept
+        : m_path( std::move( other.m_path ) ), m_open( std::exchange( other.m_open, false ) ),
+          m_file( std::exchange( other.m_file, nullptr ) ), m_followed( std::exchange( other.m_followed, nullptr ) ),
+          m_buffer( std::exchange( other.m_buffer, nullptr ) ),
+          m_capacity( other.m_capacity ), m_used( std::exchange( other.m_used, 0 ) ), m_bytes( std::exchange( other.m_bytes, 0 ) ) {}
+
+    segment_writer& segment_writer::operator=( segment_writer&& other ) noexcept {
+        if ( this != &other ) {
+            close();
+            std::free( m_buffer );
+            m_path = std::move( other.m_path );
+            m_open = std::exchange( other.m_open, false );
+            m_file = std::exchange( other.m_file, nullptr );
+            m_followed = std::exchange( other.m_followed, nullptr );
+            m_buffer = std::exchange( other.m_buffer, nullptr );
+            m_capacity = other.m_capacity;
+            m_used = std::exchange( other.m_used, 0 );
+            m_bytes = std::exchange( other.m_bytes, 0 );
+        }
+        return *this;
+    }
+
+    bool segment_writer::open( const std::filesystem::path& file ) {
+
+        close();
+
+        // the buffer is only taken for a writer that is used, and kept from file to file
+        if ( !m_buffer ) {
+            m_buffer = static_cast<uint8_t*>( std::aligned_alloc( page_size, m_capacity ) );
+            if ( !m_buffer ) return false;
+        }
+
+        m_path = file;
+        m_open = true;
+        m_used = 0;
+        m_bytes = 0;
+        return true;
+    }
+
+    bool segment_writer::is_open() const {
+        return m_open;
+    }
+
+    bool segment_writer::write( std::span<const uint8_t> data ) {
+
+        if ( !m_open ) return false;
+
+        if ( m_followed ) {
+            if ( same_as_followed( data ) ) {
+                m_bytes += data.size();
+                return true;
+            }
+            if ( !unfollow() ) return false;
+        }
+
+        while ( !data.empty() ) {
+            size_t n = std::min( data.size(), m_capacity - m_used );
+            std::memcpy( m_buffer + m_used, data.data(), n );
+            m_used += n;
+            m_bytes += n;
+            data = data.subspan( n );
+            if ( m_used == m_capacity && !flush() ) return false;
+        }
+
+        return true;
+    }
+
+    bool segment_writer::create() {
+        if ( m_file ) return true;
+        m_file = std::fopen( m_path.string().c_str(), "wb" );
+        if ( !m_file ) return false;
+        // the aligned buffer does the batching, stdio would only copy it again
+        std::setvbuf( m_file, nullptr, _IONBF, 0 );
+        return true;
+    }
+
+    bool segment_writer::flush() {
+        if ( !create() ) return false;
+        if ( m_used == 0 ) return true;
+        bool written = std::fwrite( m_buffer, 1, m_used, m_file ) == m_used;
+        m_used = 0;
+        return written;
+    }
+
+    bool segment_writer::close() {
+        if ( !m_open ) return true;
+        m_open = false;
+        bool flushed = ( !m_followed || unfollow() ) && flush();
+        bool closed = m_file && std::fclose( m_file ) == 0;
+        m_file = nullptr;
+        return flushed && closed;
+    }
+
+    void segment_writer::discard() {
+        if ( !m_open ) return;
+        m_open = false;
+        m_used = 0;
+        if ( m_followed ) {
+            std::fclose( m_followed );
+            m_followed = nullptr;
+        }
+        if ( m_file ) {
+            std::fclose( m_file );
+            m_file = nullptr;
+            std::error_code ec;
+            std::filesystem::remove( m_path, ec );
+        }
+    }
+
+    bool segment_writer::follow( const std::filesystem::path& earlier ) {
+
+        if ( !m_open || m_file || m_followed ) return false;
+
+        m_followed = std::fopen( earlier.string().c_str(), "rb" );
+        if ( !m_followed ) return false;
+
+        // what is buffered is not in the followed file yet, it is checked a page at a time
+        std::array<uint8_t,page_size> page;
+        for ( size_t offset = 0; offset < m_used; offset += page.size() ) {
+            size_t n = std::min( page.size(), m_used - offset );
+            if ( std::fread( page.data(), 1, n, m_followed ) != n || std::memcmp( page.data(), m_buffer + offset, n ) != 0 ) {
+                std::fclose( m_followed );
+                m_followed = nullptr;
+                return false;
+            }
+        }
+
+        m_used = 0;
+        return true;
+    }
+
+    bool segment_writer::following() const {
+        return m_followed != nullptr;
+    }
+
+    bool segment_writer::same_as_followed( std::span<const uint8_t> data ) {
+        // nothing is buffered while following, the buffer reads the followed file
+        while ( !data.empty() ) {
+            size_t n = std::min( data.size(), m_capacity );
+            if ( std::fread( m_buffer, 1, n, m_followed ) != n || std::memcmp( m_buffer, data.data(), n ) != 0 ) return false;
+            data = data.subspan( n );
+        }
+        return true;
+    }
+
+    bool segment_writer::unfollow() {
+
+        bool copied = create() && std::fseek( m_followed, 0, SEEK_SET ) == 0;
+        for ( size_t left = m_bytes; copied && left > 0; ) {
+            size_t n = std::min( left, m_capacity );
+            copied = std::fread( m_buffer, 1, n, m_followed ) == n && std::fwrite( m_buffer, 1, n, m_file ) == n;
+            left -= n;
+        }
+
+        std::fclose( m_followed );
+        m_followed = nullptr;
+        m_used = 0;
+        return copied;
+    }
+
+    size_t segment_writer::bytes_written() const {
+        return m_bytes;
+    }
+
+    size_t segment_writer::capacity() const {
+        return m_capacity;
+    }
+
+    media_sink::media_sink( const std::filesystem::path& directory, segment_callback on_segment, size_t write_buffer_size,
+                            payload_dedup_index* dedup )
+        : m_directory( directory ), m_on_segment( std::move( on_segment ) ), m_write_buffer_size( write_buffer_size ),
+          m_dedup( dedup ), m_next_segment( 0 ) {}
+
+    void media_sink::on_record( const four_tuple& four, stream_direction direction, tls_content_type type,
+                                std::span<const uint8_t> plaintext ) {
+
+        if ( type != tls_content_type::APPLICATION_DATA ) return;
+
+        auto& conn = m_connections.try_emplace( four, *this, four ).first->second;
+        if ( !conn.failed ) conn.parser.feed( direction, plaintext );
+    }
+
+    void media_sink::on_failure( const four_tuple& four, const std::string& reason ) {
+        auto it = m_connections.find( four );
+        if ( it == m_connections.end() || it->second.failed ) return;
+        it->second.end_segment( false );
+        it->second.failed = true;
+        ++m_statistics.failures;
+    }
+
+    void media_sink::on_close( const four_tuple& four, close_reason reason ) {
+
+        auto it = m_connections.find( four );
+        if ( it == m_connections.end() ) return;
+
+        // a body without a length ends with the connection, any other is cut short
+        if ( !it->second.failed ) it->second.parser.finish();
+        it->second.end_segment( false );
+
+        m_connections.erase( it );
+    }
+
+    media_sink_statistics media_sink::statistics() const {
+        return m_statistics;
+    }
+
+    media_sink::connection::connection( media_sink& sink, const four_tuple& four )
+        : sink( sink ), four( four ), parser( *this ), writer( sink.m_write_buffer_size ) {}
+
+    void media_sink::connection::on_response( const http_response& response, const http_request* request ) {
+
+        int status = response.status_line.status_code;
+        if ( status < 200 ) return;
+
+        ++sink.m_statistics.responses;
+        if ( status >= 300 ) return;
+
+        std::string path = request ? request->request_line.path : "";
+        auto kind = classify_media( response.header_view.content_type().value_or( "" ), path );
+        if ( !kind ) return;
+
+        char prefix[ 32 ];
+        std::snprintf( prefix, sizeof( prefix ), "%06zu_", sink.m_next_segment++ );
+        auto file = sink.m_directory / ( prefix + file_name_for( path ) );
+
+        if ( writer.open( file ) ) {
+            segment = media_segment{ four, *kind, std::move( path ), file, 0, false, std::nullopt };
+            if ( sink.m_dedup ) hasher = sink.m_dedup->hasher();
+        } else {
+            ++sink.m_statistics.failures;
+        }
+    }
+
+    void media_sink::connection::on_body( http_type type, std::span<const uint8_t> data ) {
+
+        if ( type != http_type::RESPONSE || !segment ) return;
+
+        // the first buffer is looked up before it is flushed, a body that starts like an
+        // earlier one is compared with that file rather than written
+        size_t written = writer.bytes_written();
+        if ( hasher && written < writer.capacity() && written + data.size() >= writer.capacity() ) {
+            auto head = data.first( writer.capacity() - written );
+            hasher->update( head );
+            prefix = hasher->digest();
+            if ( auto earlier = sink.m_dedup->find_prefix( *prefix ) ) writer.follow( *earlier );
+            if ( !writer.write( head ) ) {
+                end_segment( false );
+                return;
+            }
+            data = data.subspan( head.size() );
+        }
+
+        if ( hasher ) hasher->update( data );
+        if ( !writer.write( data ) ) end_segment( false );
+    }
+
+    void media_sink::connection::on_message_end( http_type type, bool complete ) {
+        if ( type == http_type::RESPONSE ) end_segment( complete );
+    }
+
+    void media_sink::connection::on_error( http_type type, const std::string& reason ) {
+        end_segment( false );
+        failed = true;
+        ++sink.m_statistics.failures;
+    }
+
+    void media_sink::connection::end_segment( bool complete ) {
+
+        if ( !segment ) return;
+
+        segment->bytes = writer.bytes_written();
+
+        // only a complete body is known to be the same as the earlier one
+        std::optional<payload_digest> digest;
+        if ( hasher && complete ) {
+            digest = hasher->digest();
+            segment->duplicate_of = sink.m_dedup->find( *digest );
+        }
+
+        if ( segment->duplicate_of ) {
+            writer.discard();
+            segment->complete = true;
+            ++sink.m_statistics.duplicates;
+            sink.m_statistics.bytes_deduplicated += segment->bytes;
+        } else {
+            // the file is created on the first write, that is where a bad directory shows
+            bool closed = writer.close();
+            if ( !closed ) ++sink.m_statistics.failures;
+            segment->complete = closed && complete;
+            if ( digest && closed ) sink.m_dedup->insert( *digest, segment->file, prefix );
+        }
+        hasher.reset();
+        prefix.reset();
+
+        ++sink.m_statistics.segments;
+        if ( !segment->duplicate_of ) sink.m_statistics.bytes_written += segment->bytes;
+
+        if ( sink.m_on_segment ) sink.m_on_segment( *segment );
+        segment.reset();
+    }
+
+} // namespace ntk
@@ -0,0 +1,197 @@
+#include <mp4.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace ntk {
+
+    namespace {
+
+        constexpr uint64_t unbounded = std::numeric_limits<uint64_t>::max();
+
+        constexpr std::array<uint32_t,11> container_types = {
+            mp4_box_type( "moov" ), mp4_box_type( "trak" ), mp4_box_type( "mdia" ), mp4_box_type( "minf" ),
+            mp4_box_type( "stbl" ), mp4_box_type( "edts" ), mp4_box_type( "dinf" ), mp4_box_type( "mvex" ),
+            mp4_box_type( "moof" ), mp4_box_type( "traf" ), mp4_box_type( "mfra" )
+        };
+
+        uint32_t read_u32( const uint8_t* bytes ) {
+            return ( uint32_t( bytes[ 0 ] ) << 24 ) | ( uint32_t( bytes[ 1 ] ) << 16 ) | ( uint32_t( bytes[ 2 ] ) << 8 ) | bytes[ 3 ];
+        }
+
+        uint64_t read_u64( const uint8_t* bytes ) {
+            return ( uint64_t( read_u32( bytes ) ) << 32 ) | read_u32( bytes + 4 );
+        }
+
+        bool is_container( uint32_t type ) {
+            return std::find( container_types.begin(), container_types.end(), type ) != container_types.end();
+        }
+
+        uint64_t box_end( const mp4_box& box ) {
+            return box.size == unbounded ? unbounded : box.offset + box.size;
+        }
+
+        // what the header buffered so far says its whole length is
+        size_t header_length( std::span<const uint8_t> header ) {
+            if ( header.size() < 8 ) return 8;
+            size_t length = read_u32( header.data() ) == 1 ? 16 : 8;
+            if ( read_u32( header.data() + 4 ) == mp4_box_type( "uuid" ) ) length += 16;
+            return length;
+        }
+
+        struct box_collector : mp4_events {
+            void on_box_start( const mp4_box& box ) override {
+                boxes.push_back( box );
+            }
+            std::vector<mp4_box> boxes;
+        };
+
+    } // namespace
+
+    std::string mp4_box_type_name( uint32_t type ) {
+        std::string name( 4, ' ' );
+        for ( int i = 0; i < 4; ++i ) {
+            char c = static_cast<char>( type >> ( 24 - 8 * i ) );
+            name[ i ] = c >= 0x20 && c < 0x7f ? c : '?';
+        }
+        return name;
+    }
+
+    std::optional<file_type_box> parse_file_type_box( std::span<const uint8_t> payload ) {
+
+        if ( payload.size() < 8 || payload.size() % 4 != 0 ) return std::nullopt;
+
+        file_type_box box{ read_u32( payload.data() ), read_u32( payload.data() + 4 ), {} };
+        for ( size_t i = 8; i < payload.size(); i += 4 ) box.compatible_brands.push_back( read_u32( payload.data() + i ) );
+        return box;
+    }
+
+    mp4_parser::mp4_parser( mp4_events& events )
+        : m_events( events ), m_offset( 0 ), m_header{}, m_header_size( 0 ), m_failed( false ) {}
+
+    bool mp4_parser::feed( std::span<const uint8_t> data ) {
+
+        while ( !data.empty() && !m_failed ) {
+
+            size_t taken = 0;
+
+            if ( m_leaf ) {
+                uint64_t left = box_end( *m_leaf ) - m_offset;
+                taken = static_cast<size_t>( std::min<uint64_t>( left, data.size() ) );
+                m_events.on_box_data( *m_leaf, data.first( taken ) );
+                m_offset += taken;
+                if ( m_offset == box_end( *m_leaf ) ) {
+                    m_events.on_box_end( *m_leaf );
+                    m_leaf.reset();
+                }
+            } else {
+                taken = take_header( data );
+            }
+
+            data = data.subspan( taken );
+            close_finished();
+        }
+
+        return !m_failed;
+    }
+
+    bool mp4_parser::finish() {
+
+        if ( m_failed ) return false;
+
+        // only a box without a size may end with the file
+        bool cut = m_header_size > 0 || ( m_leaf && m_leaf->size != unbounded );
+        for ( const auto& box : m_open ) cut |= box.size != unbounded;
+        if ( cut ) return false;
+
+        if ( m_leaf ) m_events.on_box_end( *m_leaf );
+        m_leaf.reset();
+        for ( auto it = m_open.rbegin(); it != m_open.rend(); ++it ) m_events.on_box_end( *it );
+        m_open.clear();
+        return true;
+    }
+
+    uint64_t mp4_parser::offset() const {
+        return m_offset;
+    }
+
+    size_t mp4_parser::take_header( std::span<const uint8_t> data ) {
+
+        size_t taken = 0;
+        while ( taken < data.size() ) {
+            size_t length = header_length( std::span( m_header ).first( m_header_size ) );
+            if ( m_header_size == length ) break;
+            size_t part = std::min( length - m_header_size, data.size() - taken );
+            std::memcpy( m_header.data() + m_header_size, data.data() + taken, part );
+            m_header_size += part;
+            taken += part;
+        }
+        m_offset += taken;
+
+        size_t length = header_length( std::span( m_header ).first( m_header_size ) );
+        if ( m_header_size < length ) return taken;
+
+        mp4_box box;
+        box.type = read_u32( m_header.data() + 4 );
+        box.offset = m_offset - length;
+        box.header_size = static_cast<uint32_t>( length );
+        box.depth = static_cast<uint32_t>( m_open.size() );
+        m_header_size = 0;
+
+        uint64_t parent_end = m_open.empty() ? unbounded : box_end( m_open.back() );
+        uint32_t size = read_u32( m_header.data() );
+        if ( size == 1 ) {
+            box.size = read_u64( m_header.data() + 8 );
+        } else if ( size == 0 ) {
+            // to the end of the file, or of what holds it
+            box.size = parent_end == unbounded ? unbounded : parent_end - box.offset;
+        } else {
+            box.size = size;
+        }
+
+        if ( box.size < length ) {
+            fail( "box " + mp4_box_type_name( box.type ) + " shorter than its header" );
+            return taken;
+        }
+        if ( box_end( box ) > parent_end ) {
+            fail( "box " + mp4_box_type_name( box.type ) + " runs past the box that holds it" );
+            return taken;
+        }
+
+        m_events.on_box_start( box );
+
+        if ( is_container( box.type ) ) {
+            m_open.push_back( box );
+        } else if ( box_end( box ) == m_offset ) {
+            m_events.on_box_end( box );
+        } else {
+            m_leaf = box;
+        }
+        return taken;
+    }
+
+    void mp4_parser::close_finished() {
+        // a container ends with its last child, and may end the one holding it with it
+        while ( !m_open.empty() && !m_leaf && m_header_size == 0 && box_end( m_open.back() ) == m_offset ) {
+            m_events.on_box_end( m_open.back() );
+            m_open.pop_back();
+        }
+    }
+
+    void mp4_parser::fail( const std::string& reason ) {
+        m_failed = true;
+        m_events.on_error( reason );
+    }
+
+    std::vector<mp4_box> list_mp4_boxes( const http_body_view& body ) {
+        box_collector collector;
+        mp4_parser parser( collector );
+        for ( auto piece : body.pieces() ) {
+            if ( !parser.feed( piece ) ) break;
+        }
+        parser.finish();
+        return collector.boxes;
+    }
+
+} // namespace ntk
@@ -1,5 +1,7 @@
 #include <packet_capture.hpp>
 
+#include <flow_index_file.hpp>
+
 namespace ntk {
 
     void packet_handler( unsigned char *user_data, 
@@ -31,17 +33,78 @@ namespace ntk {
         *file_handle << std::endl;
     }
 
+    void write_packet_to_capture_file( unsigned char* user_data,
+                                       const struct pcap_pkthdr* pkthdr,
+                                       const unsigned char* packet ) {
+
+        auto* writer = reinterpret_cast<capture_file_writer*>( user_data );
+
+        writer->write( static_cast<uint32_t>( pkthdr->ts.tv_sec ),
+                       static_cast<uint32_t>( pkthdr->ts.tv_usec ),
+                       pkthdr->caplen,
+                       pkthdr->len,
+                       packet );
+    }
+
+    captured_packet make_captured_packet( const struct pcap_pkthdr* pkthdr, const unsigned char* packet ) {
+        return make_captured_packet( static_cast<uint32_t>( pkthdr->ts.tv_sec ),
+                                     static_cast<uint32_t>( pkthdr->ts.tv_usec ),
+                                     pkthdr->len,
+                                     std::span<const uint8_t>( packet, pkthdr->caplen ) );
+    }
+
     pcap_t* open_device( pcap_if_t* device ) {
         pcap_t* handle = open_device( device->name );
         return handle;
     }
 
+    capture_options capture_options::throughput() {
+        capture_options options;
+        options.buffer_size = 64 << 20;
+        options.dispatch_batch = -1;
+        return options;
+    }
+
+    capture_options capture_options::latency() {
+        capture_options options;
+        options.buffer_size = 4 << 20;
+        options.immediate_mode = true;
+        options.timeout_ms = 10;
+        options.dispatch_batch = 64;
+        return options;
+    }
+
     pcap_t* open_device( const char* device_name ) {
+        return open_device( device_name, capture_options{} );
+    }
+
+    pcap_t* open_device( const char* device_name, const capture_options& options ) {
+
         char errbuf[ PCAP_ERRBUF_SIZE ];
-        pcap_t* handle = pcap_open_live( device_name, constants::max_snap_len, 1, 1000, errbuf );
+        pcap_t* handle = pcap_create( device_name, errbuf );
         if ( !handle ) {
             std::cerr << "Error opening device: " << errbuf << std::endl;
+            return nullptr;
         }
+
+        pcap_set_snaplen( handle, options.snap_len );
+        pcap_set_promisc( handle, options.promiscuous ? 1 : 0 );
+        pcap_set_timeout( handle, options.timeout_ms );
+        pcap_set_immediate_mode( handle, options.immediate_mode ? 1 : 0 );
+        if ( options.buffer_size > 0 ) {
+            pcap_set_buffer_size( handle, options.buffer_size );
+        }
+
+        int status = pcap_activate( handle );
+        if ( status < 0 ) {
+            std::cerr << "Error activating device: " << pcap_statustostr( status ) << " " << pcap_geterr( handle ) << std::endl;
+            pcap_close( handle );
+            return nullptr;
+        }
+        if ( status > 0 ) {
+            std::cerr << "Warning activating device: " << pcap_statustostr( status ) << std::endl;
+        }
+
         return handle;
     }
 
@@ -60,22 +123,26 @@ namespace ntk {
         return true;
     }
 
-    int run_capture_loop( pcap_t* handle, pcap_handler callback, u_char* user_data ) {
+    int run_capture_loop( pcap_t* handle, pcap_handler callback, u_char* user_data, int dispatch_batch ) {
         std::cout << "Capturing packets... Press Ctrl+C to stop." << std::endl;
-        int ret = pcap_loop( handle, 0, callback, user_data );
-        if ( ret < 0 ) {
-            std::cerr << "Error capturing packets: " << pcap_geterr( handle ) << std::endl;
+        while ( true ) {
+            // 0 only means the read timed out with nothing buffered
+            int ret = pcap_dispatch( handle, dispatch_batch, callback, user_data );
+            if ( ret == PCAP_ERROR_BREAK ) return ret;
+            if ( ret < 0 ) {
+                std::cerr << "Error capturing packets: " << pcap_geterr( handle ) << std::endl;
+                return ret;
+            }
         }
-        return ret;
     }
 
-    int run_capture_loop( pcap_t *handle, std::ofstream &file_handle ) {
-        std::cout << "Capturing packets... Press Ctrl+C to stop." << std::endl;
-        int ret = pcap_loop( handle, 0, write_packet_to_file, reinterpret_cast<u_char*>( &file_handle ) );
-        //int ret = pcap_loop( handle, 0, packet_handler, nullptr );
-        if ( ret < 0 ) {
-            std::cerr << "Error capturing packets: " << pcap_geterr( handle ) << std::endl;
-        }
+    int run_capture_loop( pcap_t *handle, std::ofstream &file_handle, int dispatch_batch ) {
+        return run_capture_loop( handle, write_packet_to_file, reinterpret_cast<u_char*>( &file_handle ), dispatch_batch );
+    }
+
+    int run_capture_loop( pcap_t* handle, capture_file_writer& writer, int dispatch_batch ) {
+        int ret = run_capture_loop( handle, write_packet_to_capture_file, reinterpret_cast<u_char*>( &writer ), dispatch_batch );
+        writer.flush();
         return ret;
     }
 
@@ -115,11 +182,6 @@ namespace ntk {
     }
 
     void capture_packets( const std::string& filename ) {
-        std::ofstream file_handle( filename );
-        if ( !file_handle.is_open() ) {
-            std::cerr << "Failed to open output file." << std::endl;
-            return;
-        }
 
         pcap_if_t* device = list_and_select_device();
         if ( !device ) return;
@@ -138,10 +200,25 @@ namespace ntk {
 
         std::cout << "Successfully opened device: " << device->name << std::endl;
 
-        run_capture_loop( handle, file_handle );
+        // labelled with what the device delivers, e.g. the cooked frames of "any", so the file is decoded right later
+        capture_file_writer writer( filename, capture_format_from_filename( filename ), constants::max_snap_len,
+                                    static_cast<uint32_t>( pcap_datalink( handle ) ) );
+        if ( !writer.is_open() ) {
+            std::cerr << "Failed to open output file." << std::endl;
+            pcap_close( handle );
+            pcap_freealldevs( device );
+            return;
+        }
+
+        run_capture_loop( handle, writer );
 
         pcap_close( handle );
         pcap_freealldevs( device );
+
+        // the loop has flushed everything it wrote, so the index sees the whole capture
+        auto indexed = write_flow_index( filename );
+        if ( indexed ) std::cout << "Indexed " << *indexed << " flows into " << flow_index_path( filename ) << std::endl;
+        else std::cerr << "Failed to index capture: " << indexed.error() << std::endl;
     }
 
 } // namespace ntk
\ No newline at end of file
@@ -2,8 +2,12 @@
 
 namespace ntk {
 
-    packet_listener::packet_listener( const char* device_name, const char* filter_exp ) 
-        : m_device_name( device_name ), m_filter_exp( filter_exp ), m_handle( nullptr ) {}
+    packet_listener::packet_listener( const char* device_name, const char* filter_exp,
+                                      capture_backend backend, const tpacket_options& ring_options,
+                                      const capture_options& options ) 
+        : m_device_name( device_name ), m_filter_exp( filter_exp ? filter_exp : "" ), m_backend( backend ),
+          m_ring_options( ring_options ), m_options( options ), m_handle( nullptr ), m_last_statistics{ 0, 0, 0, 0, {} },
+          m_stopping( false ) {}
         
     packet_listener::~packet_listener() {
         stop();
@@ -14,29 +18,235 @@ namespace ntk {
         if ( m_capturing ) return false; 
 
         m_callback = callback;
-        m_handle = open_device( m_device_name );
-        apply_filter( m_handle, m_filter_exp );
+
+        if ( m_backend == capture_backend::TPACKET_V3 ) {
+            return start_batch( [ this ]( std::span<const capture_frame> frames ) {
+                for ( const auto& frame : frames ) {
+                    m_callback( &frame.header, frame.data );
+                }
+            });
+        }
+
+        m_handle = open_device( m_device_name, m_options );
+        if ( !m_handle ) return false;
+
+        if ( !apply_filter( m_handle, m_filter_exp.c_str() ) ) {
+            pcap_close( m_handle );
+            m_handle = nullptr;
+            return false;
+        }
+
+        if ( auto type = to_link_type( static_cast<uint32_t>( pcap_datalink( m_handle ) ) ) ) m_link = link_layer_of( *type );
 
         m_capturing = true;
+        m_stopping = false;
+        {
+            std::lock_guard lock( m_filter_mutex );
+            m_loop_running = true;
+        }
 
         m_capture_thread = std::thread( [ this ]() {
 
-            run_capture_loop( m_handle,
-                []( u_char* user, const struct pcap_pkthdr* h, const u_char* bytes ) {
-                    auto* self = reinterpret_cast<packet_listener*>( user );
-                    if ( self->m_callback ) {
-                        self->m_callback( h, bytes );
-                    }
-                }, 
-                reinterpret_cast<u_char*>( this ) );
+            if ( !m_placement.empty() ) apply_placement( m_placement );
+
+            std::cout << "Capturing packets... Press Ctrl+C to stop." << std::endl;
+
+            while ( true ) {
+                install_pending_filter();
+
+                int ret = pcap_dispatch( m_handle, m_options.dispatch_batch,
+                    []( u_char* user, const struct pcap_pkthdr* h, const u_char* bytes ) {
+                        auto* self = reinterpret_cast<packet_listener*>( user );
+                        if ( self->m_options.verify_checksums ) self->count_checksums( std::span<const uint8_t>( bytes, h->caplen ) );
+                        if ( self->m_callback ) {
+                            self->m_callback( h, bytes );
+                        }
+                    },
+                    reinterpret_cast<u_char*>( this ) );
+
+                // 0 only means the read timed out with nothing buffered, a break not from stop() was a filter swap
+                if ( ret >= 0 || ( ret == PCAP_ERROR_BREAK && !m_stopping ) ) continue;
+                if ( ret != PCAP_ERROR_BREAK ) std::cerr << "Error capturing packets: " << pcap_geterr( m_handle ) << std::endl;
+                break;
+            }
+
+            end_filter_swaps();
         });
 
         return true;
     }
 
+    bool packet_listener::start_batch( packet_batch_callback callback ) {
+
+        if ( m_capturing ) return false;
+
+        m_batch_callback = callback;
+
+        if ( m_backend == capture_backend::PCAP ) {
+            return start( [ this ]( const struct pcap_pkthdr* header, const unsigned char* packet ) {
+                capture_frame frame{ *header, packet };
+                m_batch_callback( std::span<const capture_frame>( &frame, 1 ) );
+            });
+        }
+
+        m_ring = std::make_unique<tpacket_ring>( m_ring_options );
+        if ( !m_ring->open( m_device_name, m_filter_exp.empty() ? nullptr : m_filter_exp.c_str() ) ) {
+            m_ring.reset();
+            return false;
+        }
+
+        // an AF_PACKET socket of type SOCK_RAW delivers ethernet frames
+        m_link = link_layer_of<ethernet_link>();
+
+        m_capturing = true;
+
+        m_capture_thread = std::thread( [ this ]() {
+            if ( !m_placement.empty() ) apply_placement( m_placement );
+            if ( m_options.verify_checksums ) {
+                m_ring->run( [ this ]( std::span<const capture_frame> frames ) {
+                    for ( const auto& frame : frames ) count_checksums( std::span<const uint8_t>( frame.data, frame.header.caplen ) );
+                    m_batch_callback( frames );
+                });
+            } else {
+                m_ring->run( m_batch_callback );
+            }
+        });
+
+        return true;
+    }
+
+    bool packet_listener::start( packet_pool& pool, packet_view_callback callback ) {
+
+        return start( [ this, &pool, callback = std::move( callback ) ]( const struct pcap_pkthdr* header, const unsigned char* packet ) {
+            auto view = pool.acquire( packet, header->caplen );
+            if ( view ) {
+                callback( std::move( *view ) );
+            } else {
+                m_pool_exhausted.add();
+            }
+        });
+    }
+
+    void packet_listener::count_checksums( std::span<const uint8_t> frame ) {
+        if ( !m_link ) return;
+        if ( auto decoded = m_link->decode( frame ) ) m_checksums.count( verify_checksums( *decoded ) );
+    }
+
+    std::expected<void,std::string> packet_listener::set_filter( const std::string& filter_exp ) {
+
+        // until this swap is done with, a second one would take the pending program's place
+        std::lock_guard swap( m_filter_swap_mutex );
+        std::unique_lock lock( m_filter_mutex );
+
+        if ( m_capturing && m_ring ) {
+            if ( !m_ring->attach_filter( filter_exp.c_str() ) ) return std::unexpected( "Failed to attach filter: " + filter_exp );
+            m_filter_exp = filter_exp;
+            return {};
+        }
+
+        if ( !m_loop_running ) {
+            m_filter_exp = filter_exp;
+            return {};
+        }
+
+        // compiled against a handle of its own, the live one belongs to the capture thread
+        pcap_t* dead = pcap_open_dead( pcap_datalink( m_handle ), m_options.snap_len );
+        bpf_program program;
+        if ( pcap_compile( dead, &program, filter_exp.c_str(), 1, PCAP_NETMASK_UNKNOWN ) == -1 ) {
+            std::string error = "Error compiling filter: " + std::string( pcap_geterr( dead ) );
+            pcap_close( dead );
+            return std::unexpected( error );
+        }
+        pcap_close( dead );
+
+        m_pending_filter.emplace( program );
+        auto installed = m_pending_filter->installed.get_future();
+
+        // wakes pcap_dispatch, the loop goes round and takes the program up first
+        pcap_breakloop( m_handle );
+        lock.unlock();
+
+        auto result = installed.get();
+        if ( result ) {
+            lock.lock();
+            m_filter_exp = filter_exp;
+        }
+        return result;
+    }
+
+    void packet_listener::install_pending_filter() {
+
+        std::lock_guard lock( m_filter_mutex );
+        if ( !m_pending_filter ) return;
+
+        if ( pcap_setfilter( m_handle, &m_pending_filter->program ) == -1 ) {
+            m_pending_filter->installed.set_value( std::unexpected( "Error setting filter: " + std::string( pcap_geterr( m_handle ) ) ) );
+        } else {
+            m_pending_filter->installed.set_value( {} );
+        }
+
+        pcap_freecode( &m_pending_filter->program );
+        m_pending_filter.reset();
+    }
+
+    void packet_listener::end_filter_swaps() {
+
+        std::lock_guard lock( m_filter_mutex );
+        m_loop_running = false;
+        if ( !m_pending_filter ) return;
+
+        m_pending_filter->installed.set_value( std::unexpected( "capture stopped before the filter was set" ) );
+        pcap_freecode( &m_pending_filter->program );
+        m_pending_filter.reset();
+    }
+
+    std::string packet_listener::filter() const {
+        std::lock_guard lock( m_filter_mutex );
+        return m_filter_exp;
+    }
+
+    std::optional<link_type> packet_listener::link() const {
+        if ( !m_link ) return std::nullopt;
+        return m_link->type;
+    }
+
+    void packet_listener::place_capture_thread( const thread_placement& placement ) {
+        m_placement = placement;
+    }
+
+    capture_statistics packet_listener::statistics() {
+
+        if ( m_capturing && m_ring ) {
+            auto ring_statistics = m_ring->statistics();
+            m_last_statistics = capture_statistics{ ring_statistics.packets, ring_statistics.drops, 0, 0 };
+        } else if ( m_capturing && m_handle ) {
+            struct pcap_stat ps;
+            if ( pcap_stats( m_handle, &ps ) == 0 ) {
+                m_last_statistics = capture_statistics{ ps.ps_recv, ps.ps_drop, ps.ps_ifdrop, 0 };
+            }
+        }
+
+        m_last_statistics.pool_exhausted = m_pool_exhausted.value();
+        m_last_statistics.checksums = m_checksums.statistics();
+        return m_last_statistics;
+    }
+
     void packet_listener::stop() {
 
+        // keep the final counters readable once the handle is gone
+        if ( m_capturing ) statistics();
+
+        if ( m_capturing && m_ring ) {
+            m_ring->stop();
+            if ( m_capture_thread.joinable() ) {
+                m_capture_thread.join();
+            }
+            m_ring.reset();
+            m_capturing = false;
+        }
+
         if ( m_capturing ) {
+            m_stopping = true;
             pcap_breakloop( m_handle );
             if ( m_capture_thread.joinable() ) {
                 m_capture_thread.join();
@@ -0,0 +1,216 @@
+#include <packet_pool.hpp>
+#include <thread_placement.hpp>
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace ntk {
+
+    namespace {
+
+        constexpr uint32_t no_slot = std::numeric_limits<uint32_t>::max();
+
+        uint64_t make_head( uint64_t tag, uint32_t index ) {
+            return ( tag << 32 ) | index;
+        }
+
+        uint32_t head_index( uint64_t head ) {
+            return static_cast<uint32_t>( head & 0xffffffff );
+        }
+
+        uint64_t head_tag( uint64_t head ) {
+            return head >> 32;
+        }
+
+    } // namespace
+
+    // packet view
+
+    packet_view::packet_view( packet_pool* pool, uint32_t slot )
+        : m_pool( pool ), m_slot( slot ) {}
+
+    packet_view::packet_view( const packet_view& other )
+        : m_pool( other.m_pool ), m_slot( other.m_slot ) {
+        if ( m_pool ) m_pool->retain( m_slot );
+    }
+
+    packet_view::packet_view( packet_view&& other ) noexcept
+        : m_pool( other.m_pool ), m_slot( other.m_slot ) {
+        other.m_pool = nullptr;
+    }
+
+    packet_view& packet_view::operator=( const packet_view& other ) {
+        if ( this == &other ) return *this;
+        if ( other.m_pool ) other.m_pool->retain( other.m_slot );
+        release();
+        m_pool = other.m_pool;
+        m_slot = other.m_slot;
+        return *this;
+    }
+
+    packet_view& packet_view::operator=( packet_view&& other ) noexcept {
+        if ( this == &other ) return *this;
+        release();
+        m_pool = other.m_pool;
+        m_slot = other.m_slot;
+        other.m_pool = nullptr;
+        return *this;
+    }
+
+    packet_view::~packet_view() {
+        release();
+    }
+
+    void packet_view::release() {
+        if ( m_pool ) {
+            m_pool->release( m_slot );
+            m_pool = nullptr;
+        }
+    }
+
+    const uint8_t* packet_view::data() const {
+        return m_pool ? m_pool->slot_data( m_slot ) : nullptr;
+    }
+
+    size_t packet_view::size() const {
+        return m_pool ? m_pool->m_slots[ m_slot ].len : 0;
+    }
+
+    bool packet_view::empty() const {
+        return size() == 0;
+    }
+
+    const uint8_t* packet_view::begin() const {
+        return data();
+    }
+
+    const uint8_t* packet_view::end() const {
+        return data() + size();
+    }
+
+    std::span<const uint8_t> packet_view::bytes() const {
+        return { data(), size() };
+    }
+
+    std::vector<uint8_t> packet_view::to_vector() const {
+        return std::vector<uint8_t>( begin(), end() );
+    }
+
+    size_t packet_view::use_count() const {
+        return m_pool ? m_pool->m_slots[ m_slot ].refs.load( std::memory_order_relaxed ) : 0;
+    }
+
+    bool packet_view::operator==( const std::vector<uint8_t>& other ) const {
+        return size() == other.size() && std::memcmp( data(), other.data(), size() ) == 0;
+    }
+
+    bool packet_view::operator==( std::span<const uint8_t> other ) const {
+        return size() == other.size() && std::memcmp( data(), other.data(), size() ) == 0;
+    }
+
+    // packet pool
+
+    packet_pool::packet_pool( size_t slot_count, size_t slot_size, int numa_node )
+        : m_slot_count( slot_count ), m_slot_size( slot_size ),
+          m_storage( new uint8_t[ slot_count * slot_size ] ),
+          m_slots( new slot[ slot_count ] ),
+          m_free_head( make_head( 0, no_slot ) ), m_available( 0 ) {
+
+        if ( slot_count == 0 || slot_count >= no_slot ) {
+            throw std::invalid_argument( "packet_pool slot count out of range" );
+        }
+
+        if ( numa_node >= 0 ) {
+            // the slab is untouched so far, its pages are allocated on the node at first write
+            bind_memory_to_node( m_storage.get(), slot_count * slot_size, numa_node );
+            bind_memory_to_node( m_slots.get(), slot_count * sizeof( slot ), numa_node );
+        }
+
+        for ( size_t i = slot_count; i > 0; --i ) {
+            m_slots[ i - 1 ].refs.store( 0, std::memory_order_relaxed );
+            m_slots[ i - 1 ].len = 0;
+            push_free( static_cast<uint32_t>( i - 1 ) );
+        }
+    }
+
+    std::optional<packet_view> packet_pool::acquire( const unsigned char* packet, size_t len ) {
+
+        if ( len > m_slot_size ) len = m_slot_size;
+
+        uint32_t index;
+        if ( !pop_free( index ) ) return std::nullopt;
+
+        slot& s = m_slots[ index ];
+        std::memcpy( m_storage.get() + index * m_slot_size, packet, len );
+        s.len = static_cast<uint32_t>( len );
+        s.refs.store( 1, std::memory_order_relaxed );
+
+        return packet_view( this, index );
+    }
+
+    size_t packet_pool::slot_count() const {
+        return m_slot_count;
+    }
+
+    size_t packet_pool::slot_size() const {
+        return m_slot_size;
+    }
+
+    size_t packet_pool::available() const {
+        return m_available.load( std::memory_order_relaxed );
+    }
+
+    void packet_pool::retain( uint32_t index ) {
+        m_slots[ index ].refs.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    void packet_pool::release( uint32_t index ) {
+        if ( m_slots[ index ].refs.fetch_sub( 1, std::memory_order_acq_rel ) == 1 ) {
+            push_free( index );
+        }
+    }
+
+    const uint8_t* packet_pool::slot_data( uint32_t index ) const {
+        return m_storage.get() + index * m_slot_size;
+    }
+
+    bool packet_pool::pop_free( uint32_t& index ) {
+
+        uint64_t head = m_free_head.load( std::memory_order_acquire );
+
+        while ( true ) {
+            uint32_t top = head_index( head );
+            if ( top == no_slot ) return false;
+
+            uint32_t next = m_slots[ top ].next.load( std::memory_order_relaxed );
+            uint64_t new_head = make_head( head_tag( head ) + 1, next );
+
+            if ( m_free_head.compare_exchange_weak( head, new_head,
+                                                    std::memory_order_acq_rel,
+                                                    std::memory_order_acquire ) ) {
+                index = top;
+                m_available.fetch_sub( 1, std::memory_order_relaxed );
+                return true;
+            }
+        }
+    }
+
+    void packet_pool::push_free( uint32_t index ) {
+
+        uint64_t head = m_free_head.load( std::memory_order_relaxed );
+
+        while ( true ) {
+            m_slots[ index ].next.store( head_index( head ), std::memory_order_relaxed );
+            uint64_t new_head = make_head( head_tag( head ) + 1, index );
+
+            if ( m_free_head.compare_exchange_weak( head, new_head,
+                                                    std::memory_order_release,
+                                                    std::memory_order_relaxed ) ) {
+                m_available.fetch_add( 1, std::memory_order_relaxed );
+                return;
+            }
+        }
+    }
+
+} // namespace ntk
@@ -0,0 +1,106 @@
+#include <payload_classifier.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <string_view>
+
+namespace ntk {
+
+    namespace {
+
+        struct http_prefix {
+            std::string_view text;
+            payload_protocol protocol;
+        };
+
+        constexpr std::array<http_prefix,10> http_prefixes = {{
+            { "HTTP/", payload_protocol::HTTP_RESPONSE },
+            { "GET ", payload_protocol::HTTP_REQUEST },
+            { "HEAD ", payload_protocol::HTTP_REQUEST },
+            { "POST ", payload_protocol::HTTP_REQUEST },
+            { "PUT ", payload_protocol::HTTP_REQUEST },
+            { "PATCH ", payload_protocol::HTTP_REQUEST },
+            { "DELETE ", payload_protocol::HTTP_REQUEST },
+            { "OPTIONS ", payload_protocol::HTTP_REQUEST },
+            { "CONNECT ", payload_protocol::HTTP_REQUEST },
+            { "TRACE ", payload_protocol::HTTP_REQUEST }
+        }};
+
+        constexpr uint8_t tls_change_cipher_spec = 20;
+        constexpr uint8_t tls_alert = 21;
+        constexpr uint8_t tls_handshake = 22;
+        constexpr uint8_t tls_application_data = 23;
+
+        constexpr uint16_t tls_candidate = 1u << 15;
+        static_assert( http_prefixes.size() < 15 );
+
+        // for each first byte, a bit per http prefix starting with it, and one for a tls content type
+        constexpr std::array<uint16_t,256> make_first_byte_table() {
+            std::array<uint16_t,256> table{};
+            for ( size_t i = 0; i < http_prefixes.size(); ++i ) {
+                table[ static_cast<uint8_t>( http_prefixes[ i ].text[ 0 ] ) ] |= static_cast<uint16_t>( 1u << i );
+            }
+            for ( uint8_t type = tls_change_cipher_spec; type <= tls_application_data; ++type ) table[ type ] |= tls_candidate;
+            return table;
+        }
+
+        constexpr std::array<uint16_t,256> first_byte_table = make_first_byte_table();
+
+        bool starts_with( std::span<const uint8_t> payload, std::string_view prefix ) {
+            return payload.size() >= prefix.size() &&
+                   std::equal( prefix.begin(), prefix.end(), payload.begin(), []( char c, uint8_t b ) { return static_cast<uint8_t>( c ) == b; } );
+        }
+
+        payload_protocol classify_tls( std::span<const uint8_t> payload ) {
+
+            // the major version of every ssl 3 / tls record layer
+            if ( payload.size() < 2 || payload[ 1 ] != 3 ) return payload_protocol::UNKNOWN;
+
+            switch ( payload[ 0 ] ) {
+                case tls_change_cipher_spec:
+                    return payload_protocol::TLS_CHANGE_CIPHER_SPEC;
+                case tls_alert: {
+                    if ( payload.size() < 7 ) return payload_protocol::TLS_RECORD;
+                    uint16_t length = static_cast<uint16_t>( ( payload[ 3 ] << 8 ) | payload[ 4 ] );
+                    bool known_level = payload[ 5 ] == 1 || payload[ 5 ] == 2;
+                    return length >= 2 && known_level ? payload_protocol::TLS_ALERT : payload_protocol::TLS_RECORD;
+                }
+                case tls_handshake:
+                    if ( payload.size() < 6 ) return payload_protocol::TLS_HANDSHAKE;
+                    if ( payload[ 5 ] == 1 ) return payload_protocol::TLS_CLIENT_HELLO;
+                    if ( payload[ 5 ] == 2 ) return payload_protocol::TLS_SERVER_HELLO;
+                    return payload_protocol::TLS_HANDSHAKE;
+                default:
+                    return payload_protocol::TLS_APPLICATION_DATA;
+            }
+        }
+
+    } // namespace
+
+    payload_protocol classify_payload( std::span<const uint8_t> payload ) {
+
+        if ( payload.empty() ) return payload_protocol::EMPTY;
+
+        uint16_t candidates = first_byte_table[ payload[ 0 ] ];
+        if ( candidates & tls_candidate ) return classify_tls( payload );
+
+        while ( candidates ) {
+            int i = std::countr_zero( candidates );
+            if ( starts_with( payload, http_prefixes[ i ].text ) ) return http_prefixes[ i ].protocol;
+            candidates &= candidates - 1;
+        }
+
+        return payload_protocol::UNKNOWN;
+    }
+
+    payload_protocol classify_packet( const decoded_packet& packet ) {
+        return classify_payload( packet.payload );
+    }
+
+    payload_protocol classify_packet( std::span<const uint8_t> frame ) {
+        auto decoded = decode_packet( frame );
+        return decoded ? classify_payload( decoded->payload ) : payload_protocol::EMPTY;
+    }
+
+} // namespace ntk
@@ -0,0 +1,153 @@
+#include <payload_dedup.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+#include <openssl/evp.h>
+
+#include <flow_key.hpp>
+
+namespace ntk {
+
+    namespace {
+
+        constexpr uint64_t secret_0 = 0xa0761d6478bd642fULL;
+        constexpr uint64_t secret_1 = 0xe7037ed1a0b428dbULL;
+        constexpr uint64_t secret_2 = 0x8ebc6af09c88c6e3ULL;
+
+        uint64_t read_u64( const uint8_t* bytes ) {
+            uint64_t value;
+            std::memcpy( &value, bytes, sizeof( value ) );
+            return value;
+        }
+
+    } // namespace
+
+    struct payload_hasher::sha256_context {
+        EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+        ~sha256_context() { EVP_MD_CTX_free( ctx ); }
+    };
+
+    payload_hasher::payload_hasher( bool confirm )
+        : m_state( secret_2 ), m_size( 0 ), m_tail{}, m_tail_size( 0 ) {
+        if ( confirm ) {
+            m_sha256 = std::make_unique<sha256_context>();
+            EVP_DigestInit_ex( m_sha256->ctx, EVP_sha256(), nullptr );
+        }
+    }
+
+    payload_hasher::~payload_hasher() = default;
+    payload_hasher::payload_hasher( payload_hasher&& other ) noexcept = default;
+    payload_hasher& payload_hasher::operator=( payload_hasher&& other ) noexcept = default;
+
+    void payload_hasher::update( std::span<const uint8_t> data ) {
+
+        if ( m_sha256 ) EVP_DigestUpdate( m_sha256->ctx, data.data(), data.size() );
+        m_size += data.size();
+
+        // a block split across updates is completed first
+        if ( m_tail_size > 0 ) {
+            size_t n = std::min( m_tail.size() - m_tail_size, data.size() );
+            std::memcpy( m_tail.data() + m_tail_size, data.data(), n );
+            m_tail_size += n;
+            data = data.subspan( n );
+            if ( m_tail_size < m_tail.size() ) return;
+            mix_block( m_tail.data() );
+            m_tail_size = 0;
+        }
+
+        while ( data.size() >= m_tail.size() ) {
+            mix_block( data.data() );
+            data = data.subspan( m_tail.size() );
+        }
+
+        std::memcpy( m_tail.data(), data.data(), data.size() );
+        m_tail_size = data.size();
+    }
+
+    payload_digest payload_hasher::digest() const {
+
+        std::array<uint8_t,16> last{};
+        std::memcpy( last.data(), m_tail.data(), m_tail_size );
+        uint64_t state = flow_hash::mix( read_u64( last.data() ) ^ secret_0 ^ m_state, read_u64( last.data() + 8 ) ^ secret_1 );
+        payload_digest digest{ flow_hash::mix( state ^ m_size, secret_2 ), m_size, std::nullopt };
+
+        if ( m_sha256 ) {
+            // finalized on a copy so the running one can go on
+            EVP_MD_CTX* copy = EVP_MD_CTX_new();
+            std::array<uint8_t,32> sha256{};
+            unsigned int length = 0;
+            if ( copy && EVP_MD_CTX_copy_ex( copy, m_sha256->ctx ) == 1 && EVP_DigestFinal_ex( copy, sha256.data(), &length ) == 1 ) {
+                digest.sha256 = sha256;
+            }
+            EVP_MD_CTX_free( copy );
+        }
+
+        return digest;
+    }
+
+    void payload_hasher::mix_block( const uint8_t* block ) {
+        m_state = flow_hash::mix( read_u64( block ) ^ secret_0 ^ m_state, read_u64( block + 8 ) ^ secret_1 );
+    }
+
+    payload_dedup_index::payload_dedup_index( size_t max_entries, bool confirm )
+        : m_max_entries( std::max<size_t>( max_entries, 1 ) ), m_confirm( confirm ) {}
+
+    payload_hasher payload_dedup_index::hasher() const {
+        return payload_hasher( m_confirm );
+    }
+
+    std::optional<std::filesystem::path> payload_dedup_index::find( const payload_digest& digest ) {
+        std::lock_guard lock( m_mutex );
+        auto it = m_index.find( digest );
+        if ( it == m_index.end() ) return std::nullopt;
+        m_entries.splice( m_entries.begin(), m_entries, it->second );
+        return it->second->file;
+    }
+
+    std::optional<std::filesystem::path> payload_dedup_index::find_prefix( const payload_digest& prefix ) {
+        std::lock_guard lock( m_mutex );
+        auto it = m_prefixes.find( prefix );
+        if ( it == m_prefixes.end() ) return std::nullopt;
+        m_entries.splice( m_entries.begin(), m_entries, it->second );
+        return it->second->file;
+    }
+
+    void payload_dedup_index::insert( const payload_digest& digest, const std::filesystem::path& file,
+                                      std::optional<payload_digest> prefix ) {
+
+        std::lock_guard lock( m_mutex );
+
+        if ( auto it = m_index.find( digest ); it != m_index.end() ) {
+            it->second->file = file;
+            if ( prefix ) {
+                it->second->prefix = prefix;
+                m_prefixes.insert_or_assign( *prefix, it->second );
+            }
+            m_entries.splice( m_entries.begin(), m_entries, it->second );
+            return;
+        }
+
+        m_entries.push_front( entry{ digest, file, prefix } );
+        m_index.emplace( digest, m_entries.begin() );
+        if ( prefix ) m_prefixes.insert_or_assign( *prefix, m_entries.begin() );
+
+        if ( m_entries.size() > m_max_entries ) {
+            auto last = std::prev( m_entries.end() );
+            // a later payload with the same prefix may have taken it over
+            if ( last->prefix ) {
+                if ( auto it = m_prefixes.find( *last->prefix ); it != m_prefixes.end() && it->second == last ) m_prefixes.erase( it );
+            }
+            m_index.erase( last->digest );
+            m_entries.pop_back();
+        }
+    }
+
+    size_t payload_dedup_index::size() const {
+        std::lock_guard lock( m_mutex );
+        return m_entries.size();
+    }
+
+} // namespace ntk
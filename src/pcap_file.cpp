@@ -0,0 +1,482 @@
+#include <pcap_file.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <iostream>
+
+namespace ntk {
+
+    namespace {
+
+        uint16_t read_u16( const uint8_t* data, bool swapped ) {
+            uint16_t value;
+            std::memcpy( &value, data, sizeof( value ) );
+            return swapped ? std::byteswap( value ) : value;
+        }
+
+        uint32_t read_u32( const uint8_t* data, bool swapped ) {
+            uint32_t value;
+            std::memcpy( &value, data, sizeof( value ) );
+            return swapped ? std::byteswap( value ) : value;
+        }
+
+        template<typename T>
+        void append( std::vector<char>& out, T value ) {
+            const char* bytes = reinterpret_cast<const char*>( &value );
+            out.insert( out.end(), bytes, bytes + sizeof( T ) );
+        }
+
+        size_t pad_to_32_bits( size_t len ) {
+            return ( len + 3 ) & ~size_t( 3 );
+        }
+
+        // nullopt when the units per second do not fit in 64 bits, 2^64 and 10^20 up
+        std::optional<uint64_t> tsresol_units( uint8_t tsresol ) {
+            uint8_t exponent = tsresol & 0x7f;
+            if ( tsresol & 0x80 ) {
+                if ( exponent >= 64 ) return std::nullopt;
+                return uint64_t( 1 ) << exponent;
+            }
+            if ( exponent >= 20 ) return std::nullopt;
+            uint64_t units = 1;
+            for ( uint8_t i = 0; i < exponent; ++i ) units *= 10;
+            return units;
+        }
+
+        // the if_tsresol option of an interface description block, microseconds when absent
+        std::optional<uint64_t> interface_units( const uint8_t* options, size_t options_len, bool swapped ) {
+
+            size_t offset = 0;
+
+            while ( offset + 4 <= options_len ) {
+                uint16_t code = read_u16( options + offset, swapped );
+                uint16_t len = read_u16( options + offset + 2, swapped );
+                offset += 4;
+
+                if ( code == 0 ) break;
+                if ( code == pcap_constants::pcapng_option_tsresol && len >= 1 && offset < options_len ) {
+                    return tsresol_units( options[ offset ] );
+                }
+
+                offset += pad_to_32_bits( len );
+            }
+
+            return 1000000;
+        }
+
+        // the link type of the first interface description block, looked up ahead of the records
+        std::optional<uint32_t> first_interface_link_type( std::span<const uint8_t> capture ) {
+
+            bool swapped = false;
+            size_t offset = 0;
+
+            while ( offset + 12 <= capture.size() ) {
+                const uint8_t* block = capture.data() + offset;
+                if ( read_u32( block, false ) == pcap_constants::pcapng_section_header ) {
+                    swapped = read_u32( block + 8, false ) != pcap_constants::pcapng_byte_order_magic;
+                }
+                uint32_t block_type = read_u32( block, swapped );
+                uint32_t block_len = read_u32( block + 4, swapped );
+                if ( block_len < 12 || block_len % 4 != 0 || block_len > capture.size() - offset ) break;
+                if ( block_type == pcap_constants::pcapng_interface_description && block_len >= 14 ) {
+                    return read_u16( block + 8, swapped );
+                }
+                offset += block_len;
+            }
+
+            return std::nullopt;
+        }
+
+    } // namespace
+
+    capture_format detect_capture_format( std::span<const uint8_t> capture ) {
+
+        if ( capture.size() < 4 ) return capture_format::HEX;
+
+        uint32_t magic = read_u32( capture.data(), false );
+
+        if ( magic == pcap_constants::pcapng_section_header ) return capture_format::PCAPNG;
+
+        for ( uint32_t known : { pcap_constants::pcap_magic_usec, pcap_constants::pcap_magic_nsec } ) {
+            if ( magic == known || magic == std::byteswap( known ) ) return capture_format::PCAP;
+        }
+
+        return capture_format::HEX;
+    }
+
+    capture_cursor::capture_cursor( std::span<const uint8_t> capture )
+        : m_capture( capture ), m_format( detect_capture_format( capture ) ) {
+
+        if ( m_format == capture_format::PCAP ) {
+
+            if ( capture.size() < pcap_constants::pcap_file_header_len ) {
+                fail( "pcap file header is truncated" );
+                return;
+            }
+
+            uint32_t magic = read_u32( capture.data(), false );
+            m_swapped = magic == std::byteswap( pcap_constants::pcap_magic_usec ) ||
+                        magic == std::byteswap( pcap_constants::pcap_magic_nsec );
+            m_nanoseconds = magic == pcap_constants::pcap_magic_nsec ||
+                            magic == std::byteswap( pcap_constants::pcap_magic_nsec );
+            m_offset = pcap_constants::pcap_file_header_len;
+            m_datalink = read_u32( capture.data() + 20, m_swapped );
+        } else if ( m_format == capture_format::PCAPNG ) {
+            m_datalink = first_interface_link_type( capture ).value_or( pcap_constants::link_type_ethernet );
+        }
+    }
+
+    capture_format capture_cursor::format() const {
+        return m_format;
+    }
+
+    uint32_t capture_cursor::datalink() const {
+        return m_datalink;
+    }
+
+    bool capture_cursor::failed() const {
+        return !m_error.empty();
+    }
+
+    const std::string& capture_cursor::error() const {
+        return m_error;
+    }
+
+    std::span<const uint8_t> capture_cursor::decoded_line() const {
+        return m_hex_bytes;
+    }
+
+    std::span<const uint8_t> capture_cursor::stored_record() const {
+        return m_stored_record;
+    }
+
+    std::optional<capture_record_view> capture_cursor::fail( const std::string& error ) {
+        m_error = error;
+        m_offset = m_capture.size();
+        return std::nullopt;
+    }
+
+    std::optional<capture_record_view> capture_cursor::next() {
+        if ( m_offset >= m_capture.size() ) return std::nullopt;
+        switch ( m_format ) {
+            case capture_format::PCAP: return next_pcap();
+            case capture_format::PCAPNG: return next_pcapng();
+            case capture_format::HEX: return next_hex();
+        }
+        return std::nullopt;
+    }
+
+    std::optional<capture_record_view> capture_cursor::next_pcap() {
+
+        const uint8_t* data = m_capture.data();
+        size_t size = m_capture.size();
+
+        if ( m_offset + pcap_constants::pcap_record_header_len > size ) return fail( "pcap record header is truncated" );
+
+        capture_record_view record;
+        record.ts_sec = read_u32( data + m_offset, m_swapped );
+        record.ts_usec = read_u32( data + m_offset + 4, m_swapped );
+        uint32_t caplen = read_u32( data + m_offset + 8, m_swapped );
+        record.len = read_u32( data + m_offset + 12, m_swapped );
+
+        if ( m_nanoseconds ) record.ts_usec /= 1000;
+
+        m_offset += pcap_constants::pcap_record_header_len;
+
+        if ( caplen > size - m_offset ) return fail( "pcap record is truncated" );
+
+        record.data = m_capture.subspan( m_offset, caplen );
+        m_stored_record = record.data;
+        m_offset += caplen;
+
+        return record;
+    }
+
+    std::optional<capture_record_view> capture_cursor::next_pcapng() {
+
+        const uint8_t* data = m_capture.data();
+        size_t size = m_capture.size();
+
+        while ( m_offset + 12 <= size ) {
+
+            const uint8_t* block = data + m_offset;
+
+            if ( read_u32( block, false ) == pcap_constants::pcapng_section_header ) {
+                // every section starts over with its own byte order and interfaces
+                uint32_t byte_order = read_u32( block + 8, false );
+                if ( byte_order == pcap_constants::pcapng_byte_order_magic ) {
+                    m_swapped = false;
+                } else if ( byte_order == std::byteswap( pcap_constants::pcapng_byte_order_magic ) ) {
+                    m_swapped = true;
+                } else {
+                    return fail( "pcapng section has an unknown byte order" );
+                }
+                m_interface_units.clear();
+                m_interface_snap_lens.clear();
+            }
+
+            uint32_t block_type = read_u32( block, m_swapped );
+            uint32_t block_len = read_u32( block + 4, m_swapped );
+
+            if ( block_len < 12 || block_len % 4 != 0 || block_len > size - m_offset ) {
+                return fail( "pcapng block is truncated" );
+            }
+
+            m_offset += block_len;
+
+            const uint8_t* body = block + 8;
+            size_t body_len = block_len - 12;
+
+            switch ( block_type ) {
+
+                case pcap_constants::pcapng_interface_description: {
+                    if ( body_len < 8 ) return fail( "pcapng interface block is truncated" );
+                    m_interface_snap_lens.push_back( read_u32( body + 4, m_swapped ) );
+                    auto units = interface_units( body + 8, body_len - 8, m_swapped );
+                    if ( !units ) return fail( "pcapng interface block has an unsupported timestamp resolution" );
+                    m_interface_units.push_back( *units );
+                    break;
+                }
+
+                case pcap_constants::pcapng_enhanced_packet: {
+                    if ( body_len < 20 ) return fail( "pcapng packet block is truncated" );
+
+                    uint32_t interface_id = read_u32( body, m_swapped );
+                    if ( interface_id >= m_interface_units.size() ) return fail( "pcapng packet references an unknown interface" );
+
+                    uint64_t ts = ( static_cast<uint64_t>( read_u32( body + 4, m_swapped ) ) << 32 ) | read_u32( body + 8, m_swapped );
+                    uint32_t caplen = read_u32( body + 12, m_swapped );
+
+                    if ( caplen > body_len - 20 ) return fail( "pcapng packet data is truncated" );
+
+                    uint64_t units = m_interface_units[ interface_id ];
+
+                    capture_record_view record;
+                    record.ts_sec = static_cast<uint32_t>( ts / units );
+                    record.ts_usec = static_cast<uint32_t>( static_cast<long double>( ts % units ) * 1000000 / units );
+                    record.len = read_u32( body + 16, m_swapped );
+                    record.data = std::span<const uint8_t>( body + 20, caplen );
+                    m_stored_record = record.data;
+                    return record;
+                }
+
+                case pcap_constants::pcapng_simple_packet: {
+                    if ( body_len < 4 ) return fail( "pcapng packet block is truncated" );
+                    if ( m_interface_units.empty() ) return fail( "pcapng packet references an unknown interface" );
+
+                    // a snap length of zero means unlimited
+                    uint32_t len = read_u32( body, m_swapped );
+                    uint32_t snap_len = m_interface_snap_lens[ 0 ] ? m_interface_snap_lens[ 0 ] : len;
+                    uint32_t caplen = std::min<uint32_t>( { len, snap_len, static_cast<uint32_t>( body_len - 4 ) } );
+
+                    m_stored_record = std::span<const uint8_t>( body + 4, caplen );
+                    return capture_record_view{ 0, 0, len, m_stored_record };
+                }
+
+                default:
+                    break;
+            }
+        }
+
+        m_offset = size;
+        return std::nullopt;
+    }
+
+    std::optional<capture_record_view> capture_cursor::next_hex() {
+
+        const char* text = reinterpret_cast<const char*>( m_capture.data() );
+        size_t size = m_capture.size();
+
+        // blank lines carry no packet and are skipped
+        while ( m_offset < size ) {
+
+            const void* newline = std::memchr( text + m_offset, '\n', size - m_offset );
+            size_t line_end = newline ? static_cast<const char*>( newline ) - text : size;
+
+            decode_hex_line( std::string_view( text + m_offset, line_end - m_offset ), m_hex_bytes );
+            m_stored_record = m_capture.subspan( m_offset, line_end - m_offset );
+            m_offset = line_end + 1;
+
+            if ( !m_hex_bytes.empty() ) {
+                uint32_t len = static_cast<uint32_t>( m_hex_bytes.size() );
+                return capture_record_view{ 0, 0, len, std::span<const uint8_t>( m_hex_bytes ) };
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    capture_format capture_format_from_filename( const std::string& filename ) {
+        if ( filename.ends_with( ".pcapng" ) ) return capture_format::PCAPNG;
+        if ( filename.ends_with( ".pcap" ) ) return capture_format::PCAP;
+        return capture_format::HEX;
+    }
+
+    capture_format detect_capture_format( const std::string& filename ) {
+
+        std::ifstream file( filename, std::ios::binary );
+        uint8_t magic_bytes[ 4 ];
+
+        if ( !file.read( reinterpret_cast<char*>( magic_bytes ), sizeof( magic_bytes ) ) ) {
+            return capture_format::HEX;
+        }
+
+        return detect_capture_format( std::span<const uint8_t>( magic_bytes ) );
+    }
+
+    capture_file_writer::capture_file_writer( const std::string& filename, capture_format format, uint32_t snap_len, uint32_t datalink )
+        : m_stream_buffer( 1 << 20 ), m_format( format ), m_snap_len( snap_len ), m_datalink( datalink ) {
+
+        // the buffer has to be installed before the file is opened to take effect
+        m_file.rdbuf()->pubsetbuf( m_stream_buffer.data(), m_stream_buffer.size() );
+        m_file.open( filename, format == capture_format::HEX ? std::ios::out : std::ios::out | std::ios::binary );
+
+        if ( !m_file.is_open() ) {
+            std::cerr << "Failed to open capture file: " << filename << std::endl;
+            return;
+        }
+
+        write_file_header();
+    }
+
+    bool capture_file_writer::is_open() const {
+        return m_file.is_open();
+    }
+
+    capture_format capture_file_writer::format() const {
+        return m_format;
+    }
+
+    void capture_file_writer::write_file_header() {
+
+        m_scratch.clear();
+
+        if ( m_format == capture_format::PCAP ) {
+            append<uint32_t>( m_scratch, pcap_constants::pcap_magic_usec );
+            append<uint16_t>( m_scratch, pcap_constants::pcap_version_major );
+            append<uint16_t>( m_scratch, pcap_constants::pcap_version_minor );
+            append<int32_t>( m_scratch, 0 );                                    // thiszone
+            append<uint32_t>( m_scratch, 0 );                                   // sigfigs
+            append<uint32_t>( m_scratch, m_snap_len );
+            append<uint32_t>( m_scratch, m_datalink );
+        }
+
+        if ( m_format == capture_format::PCAPNG ) {
+            /* section header block */
+            append<uint32_t>( m_scratch, pcap_constants::pcapng_section_header );
+            append<uint32_t>( m_scratch, 28 );
+            append<uint32_t>( m_scratch, pcap_constants::pcapng_byte_order_magic );
+            append<uint16_t>( m_scratch, 1 );                                   // major version
+            append<uint16_t>( m_scratch, 0 );                                   // minor version
+            append<int64_t>( m_scratch, -1 );                                   // section length unknown
+            append<uint32_t>( m_scratch, 28 );
+            /* interface description block, microsecond timestamps by default */
+            append<uint32_t>( m_scratch, pcap_constants::pcapng_interface_description );
+            append<uint32_t>( m_scratch, 20 );
+            append<uint16_t>( m_scratch, static_cast<uint16_t>( m_datalink ) );
+            append<uint16_t>( m_scratch, 0 );                                   // reserved
+            append<uint32_t>( m_scratch, m_snap_len );
+            append<uint32_t>( m_scratch, 20 );
+        }
+
+        m_file.write( m_scratch.data(), m_scratch.size() );
+    }
+
+    void capture_file_writer::write( uint32_t ts_sec, uint32_t ts_usec, uint32_t caplen, uint32_t len, const unsigned char* data ) {
+
+        caplen = std::min( caplen, m_snap_len );
+
+        m_scratch.clear();
+
+        switch ( m_format ) {
+
+            case capture_format::HEX: {
+                static const char digits[] = "0123456789abcdef";
+                for ( uint32_t i = 0; i < caplen; ++i ) {
+                    m_scratch.push_back( digits[ data[ i ] >> 4 ] );
+                    m_scratch.push_back( digits[ data[ i ] & 0x0f ] );
+                    m_scratch.push_back( ' ' );
+                }
+                m_scratch.push_back( '\n' );
+                break;
+            }
+
+            case capture_format::PCAP: {
+                append<uint32_t>( m_scratch, ts_sec );
+                append<uint32_t>( m_scratch, ts_usec );
+                append<uint32_t>( m_scratch, caplen );
+                append<uint32_t>( m_scratch, len );
+                m_scratch.insert( m_scratch.end(), data, data + caplen );
+                break;
+            }
+
+            case capture_format::PCAPNG: {
+                uint32_t block_len = static_cast<uint32_t>( 32 + pad_to_32_bits( caplen ) );
+                uint64_t ts = static_cast<uint64_t>( ts_sec ) * 1000000 + ts_usec;
+
+                append<uint32_t>( m_scratch, pcap_constants::pcapng_enhanced_packet );
+                append<uint32_t>( m_scratch, block_len );
+                append<uint32_t>( m_scratch, 0 );                               // interface id
+                append<uint32_t>( m_scratch, static_cast<uint32_t>( ts >> 32 ) );
+                append<uint32_t>( m_scratch, static_cast<uint32_t>( ts ) );
+                append<uint32_t>( m_scratch, caplen );
+                append<uint32_t>( m_scratch, len );
+                m_scratch.insert( m_scratch.end(), data, data + caplen );
+                m_scratch.resize( m_scratch.size() + pad_to_32_bits( caplen ) - caplen, 0 );
+                append<uint32_t>( m_scratch, block_len );
+                break;
+            }
+        }
+
+        m_file.write( m_scratch.data(), m_scratch.size() );
+    }
+
+    void capture_file_writer::write( const capture_record& record ) {
+        write( record.ts_sec, record.ts_usec, static_cast<uint32_t>( record.data.size() ), record.len, record.data.data() );
+    }
+
+    void capture_file_writer::write( const std::vector<uint8_t>& packet ) {
+        uint32_t len = static_cast<uint32_t>( packet.size() );
+        write( 0, 0, len, len, packet.data() );
+    }
+
+    void capture_file_writer::flush() {
+        m_file.flush();
+    }
+
+    std::expected<std::vector<capture_record>,std::string> parse_capture_records( const uint8_t* data, size_t size ) {
+
+        std::span<const uint8_t> capture( data, size );
+
+        if ( detect_capture_format( capture ) == capture_format::HEX ) return std::unexpected( "not a pcap or pcapng file" );
+
+        capture_cursor cursor( capture );
+        std::vector<capture_record> records;
+
+        while ( auto record = cursor.next() ) {
+            records.push_back( { record->ts_sec, record->ts_usec, record->len, { record->data.begin(), record->data.end() } } );
+        }
+
+        if ( cursor.failed() ) return std::unexpected( cursor.error() );
+
+        return records;
+    }
+
+    std::expected<std::vector<capture_record>,std::string> read_capture_records( const std::string& filename ) {
+
+        std::ifstream file( filename, std::ios::binary | std::ios::ate );
+
+        if ( !file.is_open() ) return std::unexpected( "Failed to open file: " + filename );
+
+        std::vector<uint8_t> contents( static_cast<size_t>( file.tellg() ) );
+        file.seekg( 0 );
+
+        if ( !file.read( reinterpret_cast<char*>( contents.data() ), contents.size() ) ) {
+            return std::unexpected( "Failed to read file: " + filename );
+        }
+
+        return parse_capture_records( contents.data(), contents.size() );
+    }
+
+} // namespace ntk
@@ -0,0 +1,363 @@
+#include <quic.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+
+#include <tls.hpp>
+
+namespace ntk {
+
+    namespace {
+
+        constexpr uint8_t initial_packet_type = 0;
+        constexpr uint8_t retry_packet_type = 3;
+        constexpr size_t sample_len = 16;
+        constexpr size_t max_packet_number_len = 4;
+        // a ClientHello is a few KiB at most, anything past this is not one
+        constexpr size_t max_crypto_len = 1 << 16;
+
+        // rfc 9000 19, the frames an Initial packet may carry
+        constexpr uint64_t padding_frame = 0x00;
+        constexpr uint64_t ping_frame = 0x01;
+        constexpr uint64_t ack_frame = 0x02;
+        constexpr uint64_t ack_ecn_frame = 0x03;
+        constexpr uint64_t crypto_frame = 0x06;
+        constexpr uint64_t connection_close_frame = 0x1c;
+
+        std::vector<uint8_t> hkdf_extract( std::span<const uint8_t> salt, std::span<const uint8_t> key, const EVP_MD* hash_func ) {
+
+            std::vector<uint8_t> out( EVP_MD_get_size( hash_func ) );
+            size_t out_len = out.size();
+
+            EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id( EVP_PKEY_HKDF, nullptr );
+            if ( !ctx ) throw std::runtime_error( "EVP_PKEY_CTX_new_id failed" );
+
+            if ( EVP_PKEY_derive_init( ctx ) <= 0 ||
+                 EVP_PKEY_CTX_set_hkdf_mode( ctx, EVP_PKEY_HKDEF_MODE_EXTRACT_ONLY ) <= 0 ||
+                 EVP_PKEY_CTX_set_hkdf_md( ctx, hash_func ) <= 0 ||
+                 EVP_PKEY_CTX_set1_hkdf_salt( ctx, salt.data(), salt.size() ) <= 0 ||
+                 EVP_PKEY_CTX_set1_hkdf_key( ctx, key.data(), key.size() ) <= 0 ||
+                 EVP_PKEY_derive( ctx, out.data(), &out_len ) <= 0 ) {
+
+                EVP_PKEY_CTX_free( ctx );
+                throw std::runtime_error( "HKDF-Extract failed" );
+            }
+
+            EVP_PKEY_CTX_free( ctx );
+            return out;
+        }
+
+        // rfc 9001 5.4.3, aes-128 of the sample with the header protection key
+        std::optional<std::array<uint8_t,16>> header_protection_mask( std::span<const uint8_t> hp, std::span<const uint8_t> sample ) {
+
+            std::array<uint8_t,16> mask;
+            int len = 0;
+
+            EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+            if ( !ctx ) return std::nullopt;
+
+            bool encrypted = EVP_EncryptInit_ex( ctx, EVP_aes_128_ecb(), nullptr, hp.data(), nullptr ) > 0 &&
+                             EVP_CIPHER_CTX_set_padding( ctx, 0 ) > 0 &&
+                             EVP_EncryptUpdate( ctx, mask.data(), &len, sample.data(), static_cast<int>( sample_len ) ) > 0;
+            EVP_CIPHER_CTX_free( ctx );
+
+            if ( !encrypted || len != static_cast<int>( sample_len ) ) return std::nullopt;
+            return mask;
+        }
+
+        // rfc 9000 a.3, the full packet number closest to the one after the largest seen
+        uint64_t decode_packet_number( std::optional<uint64_t> largest, uint64_t truncated, size_t len ) {
+
+            uint64_t expected = largest ? *largest + 1 : 0;
+            uint64_t window = uint64_t( 1 ) << ( len * 8 );
+            uint64_t half_window = window / 2;
+            uint64_t candidate = ( expected & ~( window - 1 ) ) | truncated;
+
+            if ( candidate + half_window <= expected && candidate < ( uint64_t( 1 ) << 62 ) - window ) return candidate + window;
+            if ( candidate > expected + half_window && candidate >= window ) return candidate - window;
+            return candidate;
+        }
+
+    } // namespace
+
+    quic_initial_keys derive_quic_initial_keys( std::span<const uint8_t> destination_connection_id, bool client ) {
+
+        const EVP_MD* sha256 = EVP_sha256();
+
+        auto initial_secret = hkdf_extract( quic_constants::initial_salt_v1, destination_connection_id, sha256 );
+        auto secret = hkdf_expand_label( initial_secret, client ? "client in" : "server in", {}, 32, sha256 );
+
+        return quic_initial_keys{
+            .key = hkdf_expand_label( secret, "quic key", {}, 16, sha256 ),
+            .iv = hkdf_expand_label( secret, "quic iv", {}, 12, sha256 ),
+            .hp = hkdf_expand_label( secret, "quic hp", {}, 16, sha256 )
+        };
+    }
+
+    std::optional<uint64_t> read_quic_varint( std::span<const uint8_t> data, size_t& pos ) {
+
+        if ( pos >= data.size() ) return std::nullopt;
+
+        size_t len = size_t( 1 ) << ( data[ pos ] >> 6 );
+        if ( pos + len > data.size() ) return std::nullopt;
+
+        uint64_t value = data[ pos ] & 0x3f;
+        for ( size_t i = 1; i < len; ++i ) value = ( value << 8 ) | data[ pos + i ];
+
+        pos += len;
+        return value;
+    }
+
+    bool quic_initial_decoder::feed( std::span<const uint8_t> udp_payload ) {
+
+        size_t before = m_packets;
+
+        // coalesced packets follow each other, padding or a short header packet ends the walk
+        for ( size_t pos = 0; pos < udp_payload.size(); ) {
+            auto len = decrypt( udp_payload.subspan( pos ) );
+            if ( !len ) break;
+            pos += *len;
+        }
+
+        return m_packets > before;
+    }
+
+    std::optional<size_t> quic_initial_decoder::decrypt( std::span<const uint8_t> packet ) {
+
+        // long header form and the fixed bit, then the version and both connection ids
+        if ( packet.size() < 7 || ( packet[ 0 ] & 0xc0 ) != 0xc0 ) return std::nullopt;
+
+        uint32_t version = ( static_cast<uint32_t>( packet[ 1 ] ) << 24 ) | ( static_cast<uint32_t>( packet[ 2 ] ) << 16 ) |
+                           ( static_cast<uint32_t>( packet[ 3 ] ) << 8 ) | packet[ 4 ];
+        if ( version != quic_constants::version_1 ) return std::nullopt;
+
+        size_t pos = 5;
+        size_t dcid_len = packet[ pos++ ];
+        if ( dcid_len > quic_constants::max_connection_id_len || pos + dcid_len + 1 > packet.size() ) return std::nullopt;
+        auto dcid = packet.subspan( pos, dcid_len );
+        pos += dcid_len;
+
+        size_t scid_len = packet[ pos++ ];
+        if ( scid_len > quic_constants::max_connection_id_len || pos + scid_len > packet.size() ) return std::nullopt;
+        pos += scid_len;
+
+        uint8_t type = ( packet[ 0 ] >> 4 ) & 0x03;
+        if ( type == retry_packet_type ) return packet.size();
+
+        if ( type == initial_packet_type ) {
+            auto token_len = read_quic_varint( packet, pos );
+            if ( !token_len || *token_len > packet.size() - pos ) return std::nullopt;
+            pos += *token_len;
+        }
+
+        auto length = read_quic_varint( packet, pos );
+        if ( !length || *length > packet.size() - pos ) return std::nullopt;
+
+        size_t pn_offset = pos;
+        size_t end = pn_offset + *length;
+
+        // 0-rtt and handshake packets are stepped over, only the Initial keys are known
+        if ( type != initial_packet_type ) return end;
+
+        if ( end < pn_offset + max_packet_number_len + sample_len ) return std::nullopt;
+
+        if ( !m_keys ) m_keys = derive_quic_initial_keys( dcid );
+
+        auto mask = header_protection_mask( m_keys->hp, packet.subspan( pn_offset + max_packet_number_len, sample_len ) );
+        if ( !mask ) return std::nullopt;
+
+        uint8_t first = packet[ 0 ] ^ ( ( *mask )[ 0 ] & 0x0f );
+        size_t pn_len = ( first & 0x03 ) + 1;
+
+        // the unprotected header is the associated data
+        std::vector<uint8_t> header( packet.begin(), packet.begin() + pn_offset + pn_len );
+        header[ 0 ] = first;
+        uint64_t truncated = 0;
+        for ( size_t i = 0; i < pn_len; ++i ) {
+            header[ pn_offset + i ] ^= ( *mask )[ 1 + i ];
+            truncated = ( truncated << 8 ) | header[ pn_offset + i ];
+        }
+
+        uint64_t packet_number = decode_packet_number( m_largest_packet_number, truncated, pn_len );
+
+        std::vector<uint8_t> nonce = m_keys->iv;
+        for ( size_t i = 0; i < 8; ++i ) nonce[ nonce.size() - 1 - i ] ^= static_cast<uint8_t>( packet_number >> ( 8 * i ) );
+
+        auto plain_text = try_decrypt_aes_gcm( m_keys->key, nonce, header,
+                                               packet.subspan( pn_offset + pn_len, end - pn_offset - pn_len ), EVP_aes_128_gcm() );
+
+        // another connection's Initial or a corrupted one, either way the next packet may still be ours
+        if ( !plain_text ) return end;
+
+        if ( !m_largest_packet_number || packet_number > *m_largest_packet_number ) m_largest_packet_number = packet_number;
+        ++m_packets;
+
+        read_frames( *plain_text );
+        return end;
+    }
+
+    void quic_initial_decoder::read_frames( std::span<const uint8_t> frames ) {
+
+        size_t pos = 0;
+
+        while ( pos < frames.size() ) {
+
+            auto type = read_quic_varint( frames, pos );
+            if ( !type ) return;
+
+            switch ( *type ) {
+                case padding_frame:
+                case ping_frame:
+                    break;
+                case ack_frame:
+                case ack_ecn_frame: {
+                    // largest acknowledged, delay, range count and first range, then the ranges and ecn counts
+                    auto largest = read_quic_varint( frames, pos );
+                    auto delay = read_quic_varint( frames, pos );
+                    auto ranges = read_quic_varint( frames, pos );
+                    auto first_range = read_quic_varint( frames, pos );
+                    if ( !largest || !delay || !ranges || !first_range || *ranges > frames.size() ) return;
+                    size_t fields = *ranges * 2 + ( *type == ack_ecn_frame ? 3 : 0 );
+                    for ( size_t i = 0; i < fields; ++i ) {
+                        if ( !read_quic_varint( frames, pos ) ) return;
+                    }
+                    break;
+                }
+                case crypto_frame: {
+                    auto offset = read_quic_varint( frames, pos );
+                    auto len = read_quic_varint( frames, pos );
+                    if ( !offset || !len || *len > frames.size() - pos ) return;
+                    add_crypto( *offset, frames.subspan( pos, *len ) );
+                    pos += *len;
+                    break;
+                }
+                case connection_close_frame: {
+                    auto error = read_quic_varint( frames, pos );
+                    auto frame_type = read_quic_varint( frames, pos );
+                    auto reason_len = read_quic_varint( frames, pos );
+                    if ( !error || !frame_type || !reason_len || *reason_len > frames.size() - pos ) return;
+                    pos += *reason_len;
+                    break;
+                }
+                default:
+                    // not allowed in an Initial packet, nothing after it can be trusted
+                    return;
+            }
+        }
+    }
+
+    void quic_initial_decoder::add_crypto( uint64_t offset, std::span<const uint8_t> data ) {
+
+        if ( offset > max_crypto_len || data.size() > max_crypto_len - offset ) return;
+
+        if ( offset > m_crypto.size() ) {
+            auto& pending = m_pending[ offset ];
+            if ( data.size() > pending.size() ) pending.assign( data.begin(), data.end() );
+            return;
+        }
+
+        auto append = [&]( uint64_t begin, std::span<const uint8_t> bytes ) {
+            uint64_t end = begin + bytes.size();
+            if ( end > m_crypto.size() ) m_crypto.insert( m_crypto.end(), bytes.end() - ( end - m_crypto.size() ), bytes.end() );
+        };
+
+        append( offset, data );
+
+        // what arrived ahead of the gap just closed
+        while ( !m_pending.empty() && m_pending.begin()->first <= m_crypto.size() ) {
+            append( m_pending.begin()->first, m_pending.begin()->second );
+            m_pending.erase( m_pending.begin() );
+        }
+    }
+
+    std::optional<std::span<const uint8_t>> quic_initial_decoder::client_hello() const {
+
+        constexpr size_t handshake_header_size = 4;
+
+        if ( m_crypto.size() < handshake_header_size || m_crypto[ 0 ] != 1 ) return std::nullopt;
+
+        size_t hello_len = ( m_crypto[ 1 ] << 16 ) | ( m_crypto[ 2 ] << 8 ) | m_crypto[ 3 ];
+        if ( m_crypto.size() < handshake_header_size + hello_len ) return std::nullopt;
+
+        return std::span<const uint8_t>( m_crypto ).subspan( handshake_header_size, hello_len );
+    }
+
+    std::optional<std::string_view> quic_initial_decoder::sni() const {
+        auto hello = client_hello();
+        if ( !hello ) return std::nullopt;
+        return peek_sni_in_client_hello( *hello );
+    }
+
+    size_t quic_initial_decoder::packets() const {
+        return m_packets;
+    }
+
+    std::optional<std::string> peek_quic_sni( std::span<const uint8_t> udp_payload ) {
+        quic_initial_decoder decoder;
+        decoder.feed( udp_payload );
+        auto sni = decoder.sni();
+        if ( !sni ) return std::nullopt;
+        return std::string( *sni );
+    }
+
+    std::optional<std::string> get_quic_sni( const udp_flow& flow ) {
+
+        quic_initial_decoder decoder;
+
+        for ( auto& datagram : flow.datagrams() ) {
+            if ( !datagram.from_client ) continue;
+            decoder.feed( datagram.payload );
+            if ( auto sni = decoder.sni() ) return std::string( *sni );
+        }
+
+        return std::nullopt;
+    }
+
+    namespace {
+
+        // nothing while undecided, otherwise whether the client's Initial packets hold a whole ClientHello
+        std::optional<std::optional<std::string>> leading_quic_sni( const udp_flow& flow ) {
+
+            quic_initial_decoder decoder;
+            bool first = true;
+
+            for ( auto& datagram : flow.datagrams() ) {
+                if ( !datagram.from_client ) continue;
+                bool initial = decoder.feed( datagram.payload );
+                if ( first && !initial ) return std::optional<std::string>();
+                first = false;
+                if ( decoder.client_hello() ) {
+                    auto sni = decoder.sni();
+                    return sni ? std::optional<std::string>( std::string( *sni ) ) : std::optional<std::string>( "" );
+                }
+            }
+
+            // no more datagrams are kept, the rest of the hello will never be seen
+            if ( flow.datagrams_truncated() ) return std::optional<std::string>();
+            return std::nullopt;
+        }
+
+    } // namespace
+
+    quic_classifier::quic_classifier( flow_verdict quic, flow_verdict other )
+        : m_quic( quic ), m_other( other ) {}
+
+    flow_verdict quic_classifier::operator()( const udp_flow& flow ) const {
+        auto sni = leading_quic_sni( flow );
+        if ( !sni ) return flow_verdict::UNDECIDED;
+        return sni->has_value() ? m_quic : m_other;
+    }
+
+    quic_sni_classifier::quic_sni_classifier( const std::string& sni, flow_verdict other )
+        : m_sni( sni ), m_other( other ) {}
+
+    flow_verdict quic_sni_classifier::operator()( const udp_flow& flow ) const {
+        auto sni = leading_quic_sni( flow );
+        if ( !sni ) return flow_verdict::UNDECIDED;
+        return sni->has_value() && !( *sni )->empty() && ( *sni )->contains( m_sni ) ? flow_verdict::KEEP : m_other;
+    }
+
+} // namespace ntk
@@ -1,7 +1,36 @@
 #include <requests.hpp>
 
+#include <algorithm>
+#include <fstream>
+#include <unordered_set>
+
+#include <openssl/ssl.h>
+
 namespace ntk {
 
+    namespace {
+
+        // the generator's key log, keylog callbacks run inside curl_multi_perform on the run() thread
+        thread_local std::ofstream* t_key_log = nullptr;
+
+        void write_key_log_line( const SSL*, const char* line ) {
+            if ( !t_key_log ) return;
+            *t_key_log << line << '\n';
+            t_key_log->flush();
+        }
+
+        CURLcode install_key_log( CURL*, void* ssl_ctx, void* ) {
+            SSL_CTX_set_keylog_callback( static_cast<SSL_CTX*>( ssl_ctx ), write_key_log_line );
+            return CURLE_OK;
+        }
+
+        size_t count_bytes( char*, size_t size, size_t n, void* user ) {
+            *static_cast<uint64_t*>( user ) += size * n;
+            return size * n;
+        }
+
+    } // namespace
+
     bool make_request_curl( const std::string& url ) {
 
         CURL* curl = curl_easy_init();
@@ -27,4 +56,143 @@ namespace ntk {
         return true;
     };
 
+    curl_load_generator::curl_load_generator( const load_options& options )
+        : m_options( options ), m_stop( false ), m_statistics{ 0, 0, 0, 0, std::chrono::nanoseconds( 0 ), {}, "" } {}
+
+    CURL* curl_load_generator::make_easy( const std::string& url ) {
+
+        CURL* curl = curl_easy_init();
+        if ( !curl ) return nullptr;
+
+        curl_easy_setopt( curl, CURLOPT_URL, url.c_str() );
+        curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, count_bytes );
+        curl_easy_setopt( curl, CURLOPT_WRITEDATA, &m_statistics.bytes_received );
+        curl_easy_setopt( curl, CURLOPT_TIMEOUT_MS, m_options.timeout_ms );
+        curl_easy_setopt( curl, CURLOPT_NOSIGNAL, 1L );
+
+        if ( !m_options.reuse_connections ) {
+            curl_easy_setopt( curl, CURLOPT_FRESH_CONNECT, 1L );
+            curl_easy_setopt( curl, CURLOPT_FORBID_REUSE, 1L );
+        }
+
+        if ( !m_options.verify_peer ) {
+            curl_easy_setopt( curl, CURLOPT_SSL_VERIFYPEER, 0L );
+            curl_easy_setopt( curl, CURLOPT_SSL_VERIFYHOST, 0L );
+        }
+
+        // only the OpenSSL backend has the callback, anything else reports it unsupported
+        if ( t_key_log && curl_easy_setopt( curl, CURLOPT_SSL_CTX_FUNCTION, install_key_log ) != CURLE_OK ) {
+            std::cerr << "Key log needs curl built with OpenSSL\n";
+        }
+
+        return curl;
+    }
+
+    bool curl_load_generator::run() {
+
+        if ( m_options.urls.empty() ) return false;
+
+        curl_global_init( CURL_GLOBAL_DEFAULT );
+
+        CURLM* multi = curl_multi_init();
+        if ( !multi ) {
+            std::cerr << "Failed to initialize curl multi\n";
+            return false;
+        }
+
+        curl_multi_setopt( multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, static_cast<long>( m_options.max_concurrent ) );
+
+        std::ofstream key_log;
+        if ( !m_options.key_log_file.empty() ) {
+            key_log.open( m_options.key_log_file, std::ios::app );
+            if ( !key_log.is_open() ) std::cerr << "Failed to open key log: " << m_options.key_log_file << '\n';
+            else t_key_log = &key_log;
+        }
+
+        m_statistics = load_statistics{ 0, 0, 0, 0, std::chrono::nanoseconds( 0 ), {}, "" };
+
+        std::unordered_set<CURL*> active;
+        auto start = std::chrono::steady_clock::now();
+
+        while ( !m_stop && ( m_statistics.started < m_options.total_requests || !active.empty() ) ) {
+
+            auto now = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration<double>( now - start ).count();
+
+            // catch up on every start the rate allows by now
+            while ( m_statistics.started < m_options.total_requests && active.size() < m_options.max_concurrent &&
+                    ( m_options.requests_per_second <= 0 || m_statistics.started < elapsed * m_options.requests_per_second ) ) {
+
+                const auto& url = m_options.urls[ m_statistics.started % m_options.urls.size() ];
+                CURL* curl = make_easy( url );
+                if ( !curl ) {
+                    std::cerr << "Failed to initialize curl\n";
+                    break;
+                }
+                curl_multi_add_handle( multi, curl );
+                active.insert( curl );
+                ++m_statistics.started;
+            }
+
+            int running = 0;
+            curl_multi_perform( multi, &running );
+
+            int queued = 0;
+            while ( CURLMsg* msg = curl_multi_info_read( multi, &queued ) ) {
+
+                if ( msg->msg != CURLMSG_DONE ) continue;
+
+                CURL* curl = msg->easy_handle;
+
+                if ( msg->data.result == CURLE_OK ) {
+                    ++m_statistics.completed;
+                    curl_off_t total_us = 0;
+                    curl_easy_getinfo( curl, CURLINFO_TOTAL_TIME_T, &total_us );
+                    m_latency.record( std::chrono::microseconds( total_us ) );
+                } else {
+                    ++m_statistics.failed;
+                    if ( m_statistics.first_error.empty() ) m_statistics.first_error = curl_easy_strerror( msg->data.result );
+                }
+
+                curl_multi_remove_handle( multi, curl );
+                curl_easy_cleanup( curl );
+                active.erase( curl );
+            }
+
+            // wake up for curl's own timers and in time for the next start the rate allows
+            long timeout_ms = 100;
+            long curl_timeout_ms = -1;
+            curl_multi_timeout( multi, &curl_timeout_ms );
+            if ( curl_timeout_ms >= 0 ) timeout_ms = std::min( timeout_ms, curl_timeout_ms );
+            if ( m_statistics.started < m_options.total_requests && active.size() < m_options.max_concurrent ) {
+                if ( m_options.requests_per_second <= 0 ) timeout_ms = 0;
+                else timeout_ms = std::min( timeout_ms, std::max( 1L, static_cast<long>( 1000 / m_options.requests_per_second ) ) );
+            }
+            bool finished = active.empty() && m_statistics.started >= m_options.total_requests;
+            if ( timeout_ms > 0 && !finished ) curl_multi_poll( multi, nullptr, 0, static_cast<int>( timeout_ms ), nullptr );
+        }
+
+        m_statistics.elapsed = std::chrono::steady_clock::now() - start;
+        m_statistics.latency = m_latency.snapshot();
+
+        // whatever is still in flight after stop()
+        for ( CURL* curl : active ) {
+            curl_multi_remove_handle( multi, curl );
+            curl_easy_cleanup( curl );
+        }
+
+        curl_multi_cleanup( multi );
+        t_key_log = nullptr;
+
+        return true;
+    }
+
+    void curl_load_generator::stop() {
+        m_stop = true;
+    }
+
+    load_statistics curl_load_generator::statistics() const {
+        return m_statistics;
+    }
+
 } // namespace ntk
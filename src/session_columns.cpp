@@ -0,0 +1,122 @@
+#include <session_columns.hpp>
+
+#include <type_traits>
+
+#include <decoded_packet.hpp>
+
+namespace ntk {
+
+    session_columns::session_columns( const session& packets ) {
+        decode( packets );
+    }
+
+    session_columns::session_columns( const std::vector<captured_packet>& packets ) {
+        decode( packets );
+    }
+
+    template<typename Packets>
+    void session_columns::decode( const Packets& packets ) {
+
+        constexpr bool timestamped = std::is_same_v<typename Packets::value_type,captured_packet>;
+
+        m_index.reserve( packets.size() );
+        m_source_ip.reserve( packets.size() );
+        m_destination_ip.reserve( packets.size() );
+        m_source_port.reserve( packets.size() );
+        m_destination_port.reserve( packets.size() );
+        m_sequence_number.reserve( packets.size() );
+        m_acknowledgment_number.reserve( packets.size() );
+        m_flags.reserve( packets.size() );
+        m_payload_offset.reserve( packets.size() );
+        m_payload_len.reserve( packets.size() );
+        if constexpr ( timestamped ) m_timestamps.reserve( packets.size() );
+
+        for ( size_t i = 0; i < packets.size(); ++i ) {
+
+            auto decoded = decode_packet( std::span<const uint8_t>( packets[ i ].data(), packets[ i ].size() ) );
+            if ( !decoded ) continue;
+
+            m_index.push_back( static_cast<uint32_t>( i ) );
+            m_source_ip.push_back( decoded->source_ip );
+            m_destination_ip.push_back( decoded->destination_ip );
+            m_source_port.push_back( decoded->source_port );
+            m_destination_port.push_back( decoded->destination_port );
+            m_sequence_number.push_back( decoded->sequence_number );
+            m_acknowledgment_number.push_back( decoded->acknowledgment_number );
+            m_flags.push_back( decoded->flags );
+            m_payload_offset.push_back( static_cast<uint16_t>( decoded->payload.data() - decoded->frame.data() ) );
+            m_payload_len.push_back( static_cast<uint32_t>( decoded->payload.size() ) );
+            if constexpr ( timestamped ) m_timestamps.push_back( packets[ i ].timestamp );
+        }
+    }
+
+    size_t session_columns::size() const {
+        return m_index.size();
+    }
+
+    bool session_columns::empty() const {
+        return m_index.empty();
+    }
+
+    std::span<const uint32_t> session_columns::index() const {
+        return m_index;
+    }
+
+    std::span<const ip_address> session_columns::source_ip() const {
+        return m_source_ip;
+    }
+
+    std::span<const ip_address> session_columns::destination_ip() const {
+        return m_destination_ip;
+    }
+
+    std::span<const uint16_t> session_columns::source_port() const {
+        return m_source_port;
+    }
+
+    std::span<const uint16_t> session_columns::destination_port() const {
+        return m_destination_port;
+    }
+
+    std::span<const uint32_t> session_columns::sequence_number() const {
+        return m_sequence_number;
+    }
+
+    std::span<const uint32_t> session_columns::acknowledgment_number() const {
+        return m_acknowledgment_number;
+    }
+
+    std::span<const uint8_t> session_columns::flags() const {
+        return m_flags;
+    }
+
+    std::span<const uint16_t> session_columns::payload_offset() const {
+        return m_payload_offset;
+    }
+
+    std::span<const uint32_t> session_columns::payload_len() const {
+        return m_payload_len;
+    }
+
+    std::span<const capture_time> session_columns::timestamps() const {
+        return m_timestamps;
+    }
+
+    four_tuple session_columns::four( size_t row ) const {
+        return four_tuple{ m_source_ip[ row ], m_destination_ip[ row ], m_source_port[ row ], m_destination_port[ row ] };
+    }
+
+    size_t count_flags( const session_columns& columns, uint8_t mask, uint8_t value ) {
+        // a byte compare per row with no branch, which the compiler turns into vector code
+        auto flags = columns.flags();
+        size_t n = 0;
+        for ( size_t row = 0; row < flags.size(); ++row ) n += ( flags[ row ] & mask ) == value;
+        return n;
+    }
+
+    bool ipv4_filter::operator()( const session_columns& columns, size_t row ) const {
+        ip_address address( ip_addr );
+        return columns.source_ip()[ row ] == address || columns.destination_ip()[ row ] == address;
+    }
+
+} // namespace ntk
@@ -0,0 +1,77 @@
+#include <snapshot.hpp>
+
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ntk {
+
+#ifndef _WIN32
+
+    snapshot_file::snapshot_file( const std::string& filename ) {
+
+        int fd = ::open( filename.c_str(), O_RDONLY );
+        if ( fd < 0 ) return;
+
+        struct stat file_stat;
+        if ( fstat( fd, &file_stat ) < 0 ) {
+            ::close( fd );
+            return;
+        }
+
+        m_size = static_cast<size_t>( file_stat.st_size );
+
+        if ( m_size > 0 ) {
+            void* map = mmap( nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+            if ( map == MAP_FAILED ) {
+                ::close( fd );
+                m_size = 0;
+                return;
+            }
+            madvise( map, m_size, MADV_SEQUENTIAL );
+            m_data = static_cast<const uint8_t*>( map );
+            m_mapped = true;
+        }
+
+        ::close( fd );
+        m_open = true;
+    }
+
+    snapshot_file::~snapshot_file() {
+        if ( m_mapped ) munmap( const_cast<uint8_t*>( m_data ), m_size );
+    }
+
+#else
+
+    snapshot_file::snapshot_file( const std::string& filename ) {
+
+        std::ifstream file( filename, std::ios::binary | std::ios::ate );
+        if ( !file.is_open() ) return;
+
+        m_contents.resize( static_cast<size_t>( file.tellg() ) );
+        file.seekg( 0 );
+        file.read( reinterpret_cast<char*>( m_contents.data() ), m_contents.size() );
+
+        m_data = m_contents.data();
+        m_size = m_contents.size();
+        m_open = true;
+    }
+
+    snapshot_file::~snapshot_file() {}
+
+#endif
+
+    bool snapshot_file::is_open() const {
+        return m_open;
+    }
+
+    std::span<const uint8_t> snapshot_file::bytes() const {
+        return std::span<const uint8_t>( m_data, m_size );
+    }
+
+} // namespace ntk
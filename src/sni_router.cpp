@@ -0,0 +1,199 @@
+#include <sni_router.hpp>
+
+#include <array>
+#include <cctype>
+
+#include <tls.hpp>
+
+namespace ntk {
+
+    namespace {
+
+        constexpr size_t max_name_len = 253;
+        constexpr size_t max_label_len = 63;
+
+        // lower case into out, without a trailing dot. nullopt for a name longer than dns allows
+        std::optional<std::string_view> normalize( std::string_view name, std::array<char,max_name_len>& out ) {
+            if ( !name.empty() && name.back() == '.' ) name.remove_suffix( 1 );
+            if ( name.size() > out.size() ) return std::nullopt;
+            for ( size_t i = 0; i < name.size(); ++i ) {
+                out[ i ] = static_cast<char>( std::tolower( static_cast<unsigned char>( name[ i ] ) ) );
+            }
+            return std::string_view( out.data(), name.size() );
+        }
+
+    } // namespace
+
+    size_t sni_rule_table::edge_hash::operator()( const edge_view& e ) const {
+        size_t h = std::hash<std::string_view>{}( e.label );
+        return h ^ ( e.parent * 0x9e3779b97f4a7c15ull );
+    }
+
+    sni_rule_table::sni_rule_table()
+        : m_nodes( 1 ), m_rules( 0 ) {}
+
+    bool sni_rule_table::add( std::string_view pattern, size_t target ) {
+
+        if ( target >= no_target ) return false;
+
+        enum class kind { EXACT, WILDCARD, SUFFIX } rule = kind::EXACT;
+        if ( pattern.starts_with( "*." ) ) {
+            rule = kind::WILDCARD;
+            pattern.remove_prefix( 2 );
+        } else if ( pattern.starts_with( "." ) ) {
+            rule = kind::SUFFIX;
+            pattern.remove_prefix( 1 );
+        }
+
+        std::array<char,max_name_len> buffer;
+        auto name = normalize( pattern, buffer );
+        if ( !name || name->empty() ) return false;
+
+        // the labels are checked before the trie is touched
+        for ( size_t start = 0; start <= name->size(); ) {
+            size_t dot = std::min( name->find( '.', start ), name->size() );
+            size_t len = dot - start;
+            if ( len == 0 || len > max_label_len || name->substr( start, len ).find( '*' ) != std::string_view::npos ) return false;
+            start = dot + 1;
+        }
+
+        uint32_t node = 0;
+        size_t end = name->size();
+        while ( true ) {
+            size_t dot = name->rfind( '.', end - 1 );
+            size_t start = dot == std::string_view::npos ? 0 : dot + 1;
+            auto label = name->substr( start, end - start );
+
+            auto it = m_edges.find( edge_view{ node, label } );
+            if ( it == m_edges.end() ) {
+                uint32_t child = static_cast<uint32_t>( m_nodes.size() );
+                m_nodes.emplace_back();
+                it = m_edges.emplace( edge{ node, std::string( label ) }, child ).first;
+            }
+            node = it->second;
+
+            if ( start == 0 ) break;
+            end = dot;
+        }
+
+        auto& slot = rule == kind::EXACT ? m_nodes[ node ].exact
+                   : rule == kind::WILDCARD ? m_nodes[ node ].wildcard
+                   : m_nodes[ node ].suffix;
+        if ( slot == no_target ) ++m_rules;
+        slot = static_cast<uint32_t>( target );
+
+        return true;
+    }
+
+    std::optional<size_t> sni_rule_table::match( std::string_view host ) const {
+
+        std::array<char,max_name_len> buffer;
+        auto name = normalize( host, buffer );
+        if ( !name || name->empty() ) return std::nullopt;
+
+        uint32_t wildcard = no_target;
+        uint32_t suffix = no_target;
+
+        uint32_t node = 0;
+        size_t end = name->size();
+        while ( true ) {
+            size_t dot = name->rfind( '.', end - 1 );
+            size_t start = dot == std::string_view::npos ? 0 : dot + 1;
+
+            auto it = m_edges.find( edge_view{ node, name->substr( start, end - start ) } );
+            if ( it == m_edges.end() ) break;
+            node = it->second;
+
+            const auto& n = m_nodes[ node ];
+            if ( n.suffix != no_target ) suffix = n.suffix;
+
+            if ( start == 0 ) {
+                if ( n.exact != no_target ) return n.exact;
+                break;
+            }
+
+            // a wildcard stands for exactly the one label left
+            if ( n.wildcard != no_target && dot > 0 && name->rfind( '.', dot - 1 ) == std::string_view::npos ) wildcard = n.wildcard;
+
+            if ( dot == 0 ) break;
+            end = dot;
+        }
+
+        if ( wildcard != no_target ) return wildcard;
+        if ( suffix != no_target ) return suffix;
+        return std::nullopt;
+    }
+
+    size_t sni_rule_table::size() const {
+        return m_rules;
+    }
+
+    std::optional<std::string_view> get_stream_sni( const tcp_live_stream& stream ) {
+
+        if ( auto sni = peek_sni( stream.client_payload() ) ) return sni;
+
+        std::optional<std::string_view> sni;
+        stream.traffic_contains( [&]( const auto& packet ) {
+            sni = peek_sni_from_ethernet_frame( std::span<const uint8_t>( packet.data(), packet.size() ) );
+            return sni.has_value();
+        });
+        return sni;
+    }
+
+    sni_router::sni_router( transfer_queue_interface<tcp_live_stream>* unmatched )
+        : m_unmatched( unmatched ) {}
+
+    bool sni_router::add_route( std::string_view pattern, transfer_queue_interface<tcp_live_stream>& queue ) {
+
+        // routes to the same queue share its index
+        size_t index = 0;
+        while ( index < m_queues.size() && m_queues[ index ] != &queue ) ++index;
+
+        if ( !m_rules.add( pattern, index ) ) return false;
+        if ( index == m_queues.size() ) m_queues.push_back( &queue );
+        return true;
+    }
+
+    transfer_queue_interface<tcp_live_stream>* sni_router::route( std::string_view host ) const {
+        auto index = m_rules.match( host );
+        return index ? m_queues[ *index ] : nullptr;
+    }
+
+    transfer_queue_interface<tcp_live_stream>* sni_router::queue_for( const tcp_live_stream& stream ) {
+
+        transfer_queue_interface<tcp_live_stream>* queue = nullptr;
+        if ( auto sni = get_stream_sni( stream ) ) queue = route( *sni );
+
+        if ( queue ) {
+            m_streams_routed.add();
+            return queue;
+        }
+
+        m_streams_unmatched.add();
+        return m_unmatched;
+    }
+
+    void sni_router::push( const tcp_live_stream& stream ) {
+        if ( auto queue = queue_for( stream ) ) queue->push( stream );
+    }
+
+    void sni_router::push( tcp_live_stream&& stream ) {
+        if ( auto queue = queue_for( stream ) ) queue->push( std::move( stream ) );
+    }
+
+    std::optional<tcp_live_stream> sni_router::pop_for( std::chrono::milliseconds time_out ) {
+        return std::nullopt;
+    }
+
+    std::optional<tcp_live_stream> sni_router::try_pop() {
+        return std::nullopt;
+    }
+
+    sni_router_statistics sni_router::statistics() const {
+        return sni_router_statistics{
+            .streams_routed = m_streams_routed.value(),
+            .streams_unmatched = m_streams_unmatched.value()
+        };
+    }
+
+} // namespace ntk
@@ -0,0 +1,216 @@
+#include <spill_file.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#include <atomic>
+#endif
+
+namespace ntk {
+
+#ifndef _WIN32
+
+    spill_file::spill_file( const std::filesystem::path& directory )
+        : m_fd( -1 ), m_size( 0 ), m_data( nullptr ), m_mapped( false ) {
+
+        std::string name = ( directory / "ntk-spill-XXXXXX" ).string();
+
+        m_fd = mkstemp( name.data() );
+        if ( m_fd < 0 ) {
+            std::cerr << "Failed to create spill file in: " << directory << '\n';
+            return;
+        }
+
+        // the descriptor and later the mapping keep it alive
+        ::unlink( name.c_str() );
+    }
+
+    spill_file::~spill_file() {
+        if ( m_mapped ) munmap( const_cast<uint8_t*>( m_data ), m_size );
+        if ( m_fd >= 0 ) ::close( m_fd );
+    }
+
+    bool spill_file::append( std::span<const uint8_t> frame ) {
+
+        if ( m_fd < 0 || m_mapped ) return false;
+
+        size_t written = 0;
+        while ( written < frame.size() ) {
+            ssize_t n = ::write( m_fd, frame.data() + written, frame.size() - written );
+            if ( n < 0 && errno == EINTR ) continue;
+            if ( n <= 0 ) {
+                std::cerr << "Failed to write spill file\n";
+                // drop the partial frame so the extents keep matching the file
+                if ( ftruncate( m_fd, static_cast<off_t>( m_size ) ) == 0 ) lseek( m_fd, 0, SEEK_END );
+                return false;
+            }
+            written += static_cast<size_t>( n );
+        }
+
+        m_extents.push_back( extent{ m_size, frame.size() } );
+        m_size += frame.size();
+
+        return true;
+    }
+
+    bool spill_file::map() {
+
+        if ( m_mapped ) return true;
+        if ( m_fd < 0 ) return false;
+
+        if ( m_size > 0 ) {
+            void* map = mmap( nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0 );
+            if ( map == MAP_FAILED ) {
+                std::cerr << "Failed to map spill file\n";
+                return false;
+            }
+            madvise( map, m_size, MADV_SEQUENTIAL );
+            m_data = static_cast<const uint8_t*>( map );
+        }
+
+        m_mapped = true;
+
+        // the mapping keeps the file alive on its own
+        ::close( m_fd );
+        m_fd = -1;
+
+        m_frames.reserve( m_extents.size() );
+        for ( auto& e : m_extents ) m_frames.emplace_back( m_data + e.offset, e.size );
+
+        return true;
+    }
+
+    bool spill_file::read( size_t index, std::vector<uint8_t>& frame ) const {
+
+        if ( index >= m_extents.size() ) return false;
+
+        auto& e = m_extents[ index ];
+        frame.resize( e.size );
+
+        if ( m_mapped ) {
+            std::copy( m_data + e.offset, m_data + e.offset + e.size, frame.begin() );
+            return true;
+        }
+
+        size_t done = 0;
+        while ( done < e.size ) {
+            ssize_t n = ::pread( m_fd, frame.data() + done, e.size - done, static_cast<off_t>( e.offset + done ) );
+            if ( n < 0 && errno == EINTR ) continue;
+            if ( n <= 0 ) return false;
+            done += static_cast<size_t>( n );
+        }
+
+        return true;
+    }
+
+#else
+
+    spill_file::spill_file( const std::filesystem::path& directory )
+        : m_fd( -1 ), m_size( 0 ), m_data( nullptr ), m_mapped( false ) {
+
+        static std::atomic<uint64_t> sequence{ 0 };
+
+        m_path = directory / ( "ntk-spill-" + std::to_string( sequence.fetch_add( 1 ) ) );
+
+        std::ofstream file( m_path, std::ios::binary | std::ios::trunc );
+        if ( !file.is_open() ) {
+            std::cerr << "Failed to create spill file in: " << directory << '\n';
+            return;
+        }
+
+        m_fd = 0;
+    }
+
+    spill_file::~spill_file() {
+        std::error_code ec;
+        if ( !m_path.empty() ) std::filesystem::remove( m_path, ec );
+    }
+
+    bool spill_file::append( std::span<const uint8_t> frame ) {
+
+        if ( m_fd < 0 || m_mapped ) return false;
+
+        std::ofstream file( m_path, std::ios::binary | std::ios::app );
+        file.write( reinterpret_cast<const char*>( frame.data() ), frame.size() );
+        if ( !file ) {
+            std::cerr << "Failed to write spill file\n";
+            return false;
+        }
+
+        m_extents.push_back( extent{ m_size, frame.size() } );
+        m_size += frame.size();
+
+        return true;
+    }
+
+    bool spill_file::map() {
+
+        if ( m_mapped ) return true;
+        if ( m_fd < 0 ) return false;
+
+        std::ifstream file( m_path, std::ios::binary );
+        m_contents.resize( m_size );
+        file.read( reinterpret_cast<char*>( m_contents.data() ), m_size );
+        if ( !file ) {
+            std::cerr << "Failed to read spill file\n";
+            return false;
+        }
+
+        m_data = m_contents.data();
+        m_mapped = true;
+
+        m_frames.reserve( m_extents.size() );
+        for ( auto& e : m_extents ) m_frames.emplace_back( m_data + e.offset, e.size );
+
+        return true;
+    }
+
+    bool spill_file::read( size_t index, std::vector<uint8_t>& frame ) const {
+
+        if ( index >= m_extents.size() ) return false;
+
+        auto& e = m_extents[ index ];
+        frame.resize( e.size );
+
+        if ( m_mapped ) {
+            std::copy( m_data + e.offset, m_data + e.offset + e.size, frame.begin() );
+            return true;
+        }
+
+        std::ifstream file( m_path, std::ios::binary );
+        file.seekg( static_cast<std::streamoff>( e.offset ) );
+        file.read( reinterpret_cast<char*>( frame.data() ), e.size );
+        return static_cast<bool>( file );
+    }
+
+#endif
+
+    bool spill_file::is_open() const {
+        return m_fd >= 0 || m_mapped;
+    }
+
+    bool spill_file::is_mapped() const {
+        return m_mapped;
+    }
+
+    const std::vector<std::span<const uint8_t>>& spill_file::frames() const {
+        return m_frames;
+    }
+
+    size_t spill_file::frame_count() const {
+        return m_extents.size();
+    }
+
+    size_t spill_file::size_bytes() const {
+        return m_size;
+    }
+
+} // namespace ntk
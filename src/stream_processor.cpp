@@ -1,34 +1,88 @@
 #include <stream_processor.hpp>
 
+#include <algorithm>
+
 namespace ntk {
 
+    namespace {
+        // only bounds the wait on queues that cannot be woken by a stop request
+        constexpr std::chrono::milliseconds pop_time_out( 100 );
+    }
+
     stream_processor::stream_processor( transfer_queue_interface<tcp_live_stream>& queue,
-                                        stream_callback callback ) 
-        : m_queue( queue ), m_stop( false ), m_callback( callback ) {}
+                                        stream_callback callback,
+                                        size_t n_workers ) 
+        : m_queue( queue ), m_callback( callback ), m_n_workers( std::max<size_t>( n_workers, 1 ) ), m_drain( false ),
+          m_drain_deadline( std::chrono::steady_clock::time_point::max() ), m_drain_cut_short( false ) {}
 
     void stream_processor::start() {
-        m_thread = std::thread( &stream_processor::run, this );
+        if ( !m_workers.empty() ) return;
+        m_drain = false;
+        m_workers.reserve( m_n_workers );
+        for ( size_t i = 0; i < m_n_workers; ++i ) {
+            m_workers.emplace_back( [ this ]( std::stop_token stop ) { run( stop ); } );
+        }
     }
 
-    void stream_processor::stop() {
-        m_stop = true;
-        if ( m_thread.joinable() ) m_thread.join();
+    bool stream_processor::stop( stop_mode mode, std::chrono::steady_clock::time_point deadline ) {
+        // written before request_stop(), which the workers synchronise with
+        m_drain_deadline = deadline;
+        m_drain_cut_short = false;
+        m_drain = mode == stop_mode::DRAIN;
+        for ( auto& worker : m_workers ) worker.request_stop();
+        for ( auto& worker : m_workers ) worker.join();
+        m_workers.clear();
+        return !m_drain_cut_short;
     }
 
-    void stream_processor::run() {
-        while ( !m_stop ) {
-            auto stream = m_queue.try_pop();
+    size_t stream_processor::worker_count() const {
+        return m_n_workers;
+    }
+
+    void stream_processor::instrument( metrics_registry& registry ) {
+        m_offload_to_callback = &registry.get_histogram( "ntk_offload_to_callback_seconds",
+                                                         "Offload of a stream to its callback starting.", nanoseconds_to_seconds );
+        m_callback_time = &registry.get_histogram( "ntk_callback_seconds", "Time spent in the stream callback.", nanoseconds_to_seconds );
+    }
+
+    void stream_processor::set_placement( const thread_placement& placement ) {
+        m_placement = placement;
+    }
 
-            if ( stream ) {
-                process_stream( std::move( stream.value() ) );
-            } else {
-                std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    void stream_processor::run( std::stop_token stop ) {
+
+        if ( !m_placement.empty() ) apply_placement( m_placement );
+
+        while ( !stop.stop_requested() ) {
+            auto stream = m_queue.pop_for( pop_time_out, stop );
+            if ( stream ) process_stream( std::move( stream.value() ) );
+        }
+
+        if ( !m_drain ) return;
+
+        while ( true ) {
+            if ( std::chrono::steady_clock::now() >= m_drain_deadline ) {
+                m_drain_cut_short = true;
+                return;
             }
+            auto stream = m_queue.try_pop();
+            if ( !stream ) return;
+            process_stream( std::move( stream.value() ) );
         }
     }
 
     void stream_processor::process_stream( tcp_live_stream&& stream ) {
+
+        if ( !m_callback_time ) {
+            m_callback( std::move( stream ) );
+            return;
+        }
+
+        if ( stream.timing().offloaded ) m_offload_to_callback->record( capture_clock::now() - *stream.timing().offloaded );
+
+        auto start = std::chrono::steady_clock::now();
         m_callback( std::move( stream ) );
+        m_callback_time->record( std::chrono::steady_clock::now() - start );
     }
 
-} // namespace ntk
\ No newline at end of file
+} // namespace ntk
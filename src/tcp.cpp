@@ -1,4 +1,5 @@
 #include <tcp.hpp>
+#include <tcp_replay.hpp>
 
 namespace ntk {
 
@@ -18,10 +19,14 @@ namespace ntk {
 
 
     tcp_header parse_tcp_header( const std::vector<uint8_t>& raw_tcp_header ) {
+        auto header = try_parse_tcp_header( raw_tcp_header );
+        if ( !header ) throw std::runtime_error( header.error() );
+        return std::move( *header );
+    }
 
-        if ( raw_tcp_header.size() < 20 ) {
-            throw std::runtime_error( "Invalid TCP header size" );
-        }
+    std::expected<tcp_header,std::string> try_parse_tcp_header( std::span<const uint8_t> raw_tcp_header ) {
+
+        if ( raw_tcp_header.size() < 20 ) return std::unexpected( "Invalid TCP header size" );
 
         tcp_header header;
 
@@ -36,6 +41,7 @@ namespace ntk {
                                        ( raw_tcp_header[ 10 ] << 8 ) | raw_tcp_header[ 11 ];
 
         header.data_offset = ( raw_tcp_header[ 12 ] >> 4 ) & 0x0f;  
+        if ( header.data_offset < 5 ) return std::unexpected( "Invalid TCP data offset" );
 
         header.flags = raw_tcp_header[ 13 ];
 
@@ -47,37 +53,10 @@ namespace ntk {
 
         if ( header.data_offset == 5 ) 
             return header;
-        
-        size_t index = 20;
-
-        size_t header_byte_length = header.data_offset * 4;
-
-        while ( index < header_byte_length ) {
-
-            uint8_t kind = raw_tcp_header[ index ];
-    
-            if ( kind == 0 ) {
-                break;
-            } else if ( kind == 1 ) {
-                header.options.push_back( { kind, {} } );
-                index += 1;
-            } else {
-
-                uint8_t length = raw_tcp_header[ index + 1 ];
-    
-                std::vector<uint8_t> data;
 
-                if ( length > 2 ) {
-                    data.insert( data.end(), 
-                                 raw_tcp_header.begin() + index + 2,
-                                 raw_tcp_header.begin() + index + length);
-                }
-    
-                header.options.push_back( { kind, data } );
+        size_t header_byte_length = std::min<size_t>( header.data_offset * 4, raw_tcp_header.size() );
 
-                index += length;
-            }
-        }
+        header.options = parse_tcp_options( raw_tcp_header.subspan( 20, header_byte_length - 20 ) );
 
         return header;
     }
@@ -91,47 +70,67 @@ namespace ntk {
         return get_tcp_header( packet.data() );
     }
 
-    std::vector<raw_tcp_frame> extract_raw_tcp_stream( const session& tcp_session ) {
+    std::optional<raw_tcp_frame> extract_raw_tcp_frame( const unsigned char* packet_data ) {
 
-        std::vector<raw_tcp_frame> tcp_stream;
+        auto ipv4_header = extract_ipv4_header( packet_data );
+        auto parsed_ipv4_header = parse_ipv4_header( ipv4_header );
 
-        for ( auto& packet : tcp_session ) {
+        auto header = extract_tcp_header( packet_data, parsed_ipv4_header.ihl );
+        auto body = extract_payload_from_ethernet( packet_data );
 
-            const unsigned char* packet_data = reinterpret_cast<const unsigned char*>( packet.data() );
+        if ( body.empty() ) {
+            return std::nullopt;
+        }
 
-            auto ipv4_header = extract_ipv4_header( packet_data );
-            auto parsed_ipv4_header = parse_ipv4_header( ipv4_header );
+        raw_tcp_frame frame = {
+            .header = header,
+            .body = body
+        };
 
-            auto header = extract_tcp_header( packet_data, parsed_ipv4_header.ihl );
-            auto body = extract_payload_from_ethernet( packet_data );
+        return frame;
+    }
 
-            if ( body.empty() ) {
-                continue;
-            }
+    std::vector<raw_tcp_frame> extract_raw_tcp_stream( const session& tcp_session ) {
 
-            raw_tcp_frame frame = {
-                .header = header,
-                .body = body
-            };
+        std::vector<raw_tcp_frame> tcp_stream;
 
-            tcp_stream.push_back( frame );
+        for ( auto& packet : tcp_session ) {
+            auto frame = extract_raw_tcp_frame( reinterpret_cast<const unsigned char*>( packet.data() ) );
+            if ( frame ) tcp_stream.push_back( std::move( *frame ) );
         }
 
         return tcp_stream;
     }
 
+    generator<raw_tcp_frame> generate_raw_tcp_stream( const session& tcp_session ) {
+        for ( auto& packet : tcp_session ) {
+            auto frame = extract_raw_tcp_frame( reinterpret_cast<const unsigned char*>( packet.data() ) );
+            if ( frame ) co_yield std::move( *frame );
+        }
+    }
+
     tcp_stream get_tcp_stream( const std::vector<raw_tcp_frame>& raw_stream ) {
 
         tcp_stream stream;
 
+        // a frame with a malformed header is left out
         for ( auto& tcp_frame : raw_stream ) {
-            auto parsed_tcp_header = parse_tcp_header( tcp_frame.header );
-            stream[ parsed_tcp_header.sequence_number ] = tcp_frame.body;
+            auto parsed_tcp_header = try_parse_tcp_header( tcp_frame.header );
+            if ( parsed_tcp_header ) stream[ parsed_tcp_header->sequence_number ] = tcp_frame.body;
         }
 
         return stream;
     } 
 
+    generator<std::pair<uint32_t,std::vector<uint8_t>>> generate_tcp_segments( generator<raw_tcp_frame> raw_stream ) {
+        for ( auto&& tcp_frame : raw_stream ) {
+            auto parsed_tcp_header = try_parse_tcp_header( tcp_frame.header );
+            if ( !parsed_tcp_header ) continue;
+            std::pair<uint32_t,std::vector<uint8_t>> segment{ parsed_tcp_header->sequence_number, std::move( tcp_frame.body ) };
+            co_yield std::move( segment );
+        }
+    }
+
     bool is_non_overlapping_stream( const tcp_stream& stream ) {
 
         if ( stream.empty() ) return true;
@@ -235,9 +234,8 @@ namespace ntk {
     }
 
     bool is_same_connection( const std::vector<uint8_t>& packet, const four_tuple& four ) {
-        tcp_header packet_tcp_header = get_tcp_header( packet.data() );
-        ipv4_header packet_ip_header = get_ipv4_header( packet.data() );
-        return is_same_connection( packet_ip_header, packet_tcp_header, four );
+        auto decoded = decode_packet( packet );
+        return decoded && is_same_connection( *decoded, four );
     }
 
     bool is_syn( const tcp_header& packet_tcp_header ) {
@@ -246,8 +244,8 @@ namespace ntk {
     }
 
     bool is_syn( const std::vector<uint8_t>& packet ) {
-        tcp_header header = get_tcp_header( packet.data() );
-        return is_syn( header );
+        auto decoded = decode_packet( packet );
+        return decoded && decoded->is_syn();
     }
 
     bool is_ack( const tcp_header& packet_tcp_header ) {
@@ -255,8 +253,8 @@ namespace ntk {
     }
 
     bool is_ack( const std::vector<uint8_t>& packet ) {
-        tcp_header header = get_tcp_header( packet.data() );
-        return is_ack( header );
+        auto decoded = decode_packet( packet );
+        return decoded && decoded->is_ack();
     }
 
     bool is_syn_ack( const tcp_header& packet_tcp_header ) {
@@ -265,31 +263,23 @@ namespace ntk {
     }
 
     bool is_syn_ack( const std::vector<uint8_t>& packet ) {
-        tcp_header header = get_tcp_header( packet.data() );
-        return is_syn_ack( header );
+        auto decoded = decode_packet( packet );
+        return decoded && decoded->is_syn_ack();
     }
 
     bool is_syn_of( const std::vector<uint8_t>& packet, const four_tuple& four ) {
-        tcp_header packet_tcp_header = get_tcp_header( packet.data() );
-        ipv4_header packet_ip_header = get_ipv4_header( packet.data() );
-
-        return is_syn( packet_tcp_header ) && is_same_connection( packet_ip_header, packet_tcp_header, four );
+        auto decoded = decode_packet( packet );
+        return decoded && decoded->is_syn() && is_same_connection( *decoded, four );
     }
 
     bool is_syn_ack_of( const std::vector<uint8_t>& packet, const four_tuple& four ) {
-
-        tcp_header packet_tcp_header = get_tcp_header( packet.data() );
-        ipv4_header packet_ip_header = get_ipv4_header( packet.data() );
-        
-        return is_syn_ack( packet_tcp_header ) && is_same_connection( packet_ip_header, packet_tcp_header, four );
+        auto decoded = decode_packet( packet );
+        return decoded && decoded->is_syn_ack() && is_same_connection( *decoded, four );
     }
 
     bool is_ack_of( const std::vector<uint8_t>& packet, const four_tuple& four ) {
-
-        tcp_header packet_tcp_header = get_tcp_header( packet.data() );
-        ipv4_header packet_ip_header = get_ipv4_header( packet.data() );
-
-        return is_ack( packet_tcp_header ) && is_same_connection( packet_ip_header, packet_tcp_header, four );
+        auto decoded = decode_packet( packet );
+        return decoded && decoded->is_ack() && is_same_connection( *decoded, four );
     }
 
     bool flags_contains( const uint8_t header_flags, const tcp_flags flags ) {
@@ -297,37 +287,121 @@ namespace ntk {
     }
 
     bool is_reset( const std::vector<uint8_t>& packet ) {
-        tcp_header packet_tcp_header = get_tcp_header( packet.data() );
-        return flags_contains( packet_tcp_header.flags, tcp_flags::RST );
+        auto decoded = decode_packet( packet );
+        return decoded && decoded->is_reset();
     }
 
-    tcp_handshake get_handshake( const four_tuple& four, const session& packets ) {
-        
-        tcp_handshake handshake;
+    namespace {
 
-        std::vector<std::vector<uint8_t>> connection_packets;
-        for ( const auto& packet : packets ) {
-            if ( is_same_connection( packet, four ) ) {
-                connection_packets.push_back( packet );
+        // a flow's packets in capture order, pointing into the session
+        using connection = std::vector<const std::vector<uint8_t>*>;
+
+        connection connection_packets( const four_tuple& four, const session& packets ) {
+            connection packets_of_four;
+            for ( const auto& packet : packets ) {
+                if ( is_same_connection( packet, four ) ) packets_of_four.push_back( &packet );
             }
+            return packets_of_four;
         }
 
-        for ( size_t i = 0; i + 2 < connection_packets.size(); ++i ) {
-            const auto& syn_pkt = connection_packets[ i ];
-            const auto& syn_ack_pkt = connection_packets[ i + 1 ];
-            const auto& ack_pkt = connection_packets[ i + 2 ];
+        connection connection_packets( const four_tuple& four, const flow_index& index ) {
+            connection packets_of_four;
+            if ( auto flow = index.find( four ) ) {
+                packets_of_four.reserve( flow->packets.size() );
+                for ( auto& p : flow->packets ) packets_of_four.push_back( &index.packet( p ) );
+            }
+            return packets_of_four;
+        }
 
-            if ( is_syn_of( syn_pkt, four ) &&
-                 is_syn_ack_of( syn_ack_pkt, four ) &&
-                 is_ack_of( ack_pkt, four ) ) {
-                handshake.syn = syn_pkt;
-                handshake.syn_ack = syn_ack_pkt;
-                handshake.ack = ack_pkt;
-                return handshake;
+        // the same, one packet at a time
+        generator<const std::vector<uint8_t>*> each_connection_packet( four_tuple four, const session& packets ) {
+            for ( const auto& packet : packets ) {
+                if ( is_same_connection( packet, four ) ) co_yield &packet;
             }
         }
 
-        return {}; 
+        generator<const std::vector<uint8_t>*> each_connection_packet( four_tuple four, const flow_index& index ) {
+            if ( auto flow = index.find( four ) ) {
+                for ( auto& p : flow->packets ) co_yield &index.packet( p );
+            }
+        }
+
+        tcp_handshake find_handshake( const four_tuple& four, const connection& connection_packets ) {
+
+            tcp_handshake handshake;
+
+            for ( size_t i = 0; i + 2 < connection_packets.size(); ++i ) {
+                const auto& syn_pkt = *connection_packets[ i ];
+                const auto& syn_ack_pkt = *connection_packets[ i + 1 ];
+                const auto& ack_pkt = *connection_packets[ i + 2 ];
+
+                if ( is_syn_of( syn_pkt, four ) &&
+                     is_syn_ack_of( syn_ack_pkt, four ) &&
+                     is_ack_of( ack_pkt, four ) ) {
+                    handshake.syn = syn_pkt;
+                    handshake.syn_ack = syn_ack_pkt;
+                    handshake.ack = ack_pkt;
+                    return handshake;
+                }
+            }
+
+            return {};
+        }
+
+        std::vector<tcp_handshake> find_handshakes( const four_tuple& four, const connection& connection_packets ) {
+
+            std::vector<tcp_handshake> handshakes;
+
+            for ( size_t i = 0; i + 2 < connection_packets.size(); ++i ) {
+                const auto& syn_pkt = *connection_packets[ i ];
+                const auto& syn_ack_pkt = *connection_packets[ i + 1 ];
+                const auto& ack_pkt = *connection_packets[ i + 2 ];
+
+                if ( is_syn_of( syn_pkt, four ) &&
+                     is_syn_ack_of( syn_ack_pkt, four ) &&
+                     is_ack_of( ack_pkt, four ) ) {
+                    tcp_handshake handshake;
+                    handshake.syn = syn_pkt;
+                    handshake.syn_ack = syn_ack_pkt;
+                    handshake.ack = ack_pkt;
+                    handshakes.push_back( handshake );
+                }
+            }
+
+            return handshakes;
+        }
+
+        // find_handshakes over a window of the last three packets
+        template<typename Packets>
+        generator<tcp_handshake> lazy_handshakes( four_tuple four, const Packets& packets ) {
+
+            std::array<const std::vector<uint8_t>*,3> window{};
+            size_t seen = 0;
+
+            for ( auto* packet : each_connection_packet( four, packets ) ) {
+                window = { window[ 1 ], window[ 2 ], packet };
+                if ( ++seen < 3 ) continue;
+
+                if ( is_syn_of( *window[ 0 ], four ) &&
+                     is_syn_ack_of( *window[ 1 ], four ) &&
+                     is_ack_of( *window[ 2 ], four ) ) {
+                    tcp_handshake handshake;
+                    handshake.syn = *window[ 0 ];
+                    handshake.syn_ack = *window[ 1 ];
+                    handshake.ack = *window[ 2 ];
+                    co_yield std::move( handshake );
+                }
+            }
+        }
+
+    } // namespace
+
+    tcp_handshake get_handshake( const four_tuple& four, const session& packets ) {
+        return find_handshake( four, connection_packets( four, packets ) );
+    }
+
+    tcp_handshake get_handshake( const four_tuple& four, const flow_index& index ) {
+        return find_handshake( four, connection_packets( four, index ) );
     }
 
     tcp_handshake get_handshake( const session& packets ) {
@@ -353,33 +427,19 @@ namespace ntk {
     }
 
     std::vector<tcp_handshake> get_handshakes( const four_tuple& four, const session& packets ) {
-        
-        std::vector<tcp_handshake> handshakes;
-
-        std::vector<std::vector<uint8_t>> connection_packets;
-        for ( const auto& packet : packets ) {
-            if ( is_same_connection( packet, four ) ) {
-                connection_packets.push_back( packet );
-            }
-        }
+        return find_handshakes( four, connection_packets( four, packets ) );
+    }
 
-        for ( size_t i = 0; i + 2 < connection_packets.size(); ++i ) {
-            const auto& syn_pkt = connection_packets[ i ];
-            const auto& syn_ack_pkt = connection_packets[ i + 1 ];
-            const auto& ack_pkt = connection_packets[ i + 2 ];
+    std::vector<tcp_handshake> get_handshakes( const four_tuple& four, const flow_index& index ) {
+        return find_handshakes( four, connection_packets( four, index ) );
+    }
 
-            if ( is_syn_of( syn_pkt, four ) &&
-                 is_syn_ack_of( syn_ack_pkt, four ) &&
-                 is_ack_of( ack_pkt, four ) ) {
-                tcp_handshake handshake;
-                handshake.syn = syn_pkt;
-                handshake.syn_ack = syn_ack_pkt;
-                handshake.ack = ack_pkt;
-                handshakes.push_back( handshake );
-            }
-        }
+    generator<tcp_handshake> generate_handshakes( four_tuple four, const session& packets ) {
+        return lazy_handshakes( four, packets );
+    }
 
-        return handshakes; 
+    generator<tcp_handshake> generate_handshakes( four_tuple four, const flow_index& index ) {
+        return lazy_handshakes( four, index );
     }
 
     const std::vector<uint8_t>* get_end_of_handshake( const session& packets, 
@@ -411,154 +471,231 @@ namespace ntk {
         return nullptr;
     }
 
-    tcp_termination get_termination( const four_tuple& four, const session& packets ) {
+    namespace {
 
-        std::vector<std::vector<uint8_t>> connection_packets;
+        tcp_termination find_termination( const connection& connection_packets ) {
 
-        for ( const auto& packet : packets ) {
-            if ( is_same_connection( packet, four ) ) {
-                connection_packets.push_back( packet );
-            }
-        }
+            std::optional<std::vector<uint8_t>> fin_1;
+            std::optional<std::vector<uint8_t>> ack_1; 
+            std::optional<std::vector<uint8_t>> fin_2; 
+            std::optional<std::vector<uint8_t>> ack_2;
 
-        std::optional<std::vector<uint8_t>> fin_1;
-        std::optional<std::vector<uint8_t>> ack_1; 
-        std::optional<std::vector<uint8_t>> fin_2; 
-        std::optional<std::vector<uint8_t>> ack_2;
+            uint32_t fin_1_seq_number = std::numeric_limits<uint32_t>::max();
+            uint32_t fin_2_seq_number = std::numeric_limits<uint32_t>::max();
 
-        uint32_t fin_1_seq_number = std::numeric_limits<uint32_t>::max();
-        uint32_t fin_2_seq_number = std::numeric_limits<uint32_t>::max();
+            auto is_fin_ack = [&]( const auto& packet_tcp_header ) {
+                return ( packet_tcp_header.flags & static_cast<uint8_t>( tcp_flags::FIN_ACK ) ) == static_cast<uint8_t>( tcp_flags::FIN_ACK );
+            };
 
-        auto is_fin_ack = [&]( const auto& packet_tcp_header ) {
-            return ( packet_tcp_header.flags & static_cast<uint8_t>( tcp_flags::FIN_ACK ) ) == static_cast<uint8_t>( tcp_flags::FIN_ACK );
-        };
+            for ( const auto* connection_packet : connection_packets ) {
+                const auto& packet = *connection_packet;
+        
+                auto packet_tcp_header = get_tcp_header( packet.data() );
 
-        for ( const auto& packet : connection_packets ) {
-    
-            auto packet_tcp_header = get_tcp_header( packet.data() );
+                if ( is_fin_ack( packet_tcp_header ) ) {
+                    std::cout << "seq: " << packet_tcp_header.sequence_number << std::endl;
+                }
 
-            if ( is_fin_ack( packet_tcp_header ) ) {
-                std::cout << "seq: " << packet_tcp_header.sequence_number << std::endl;
-            }
+                if ( !fin_1 && is_fin_ack( packet_tcp_header ) ) {
+                    fin_1 = packet;
+                    fin_1_seq_number = packet_tcp_header.sequence_number;
+                    std::cout << "fin_1_seq_number: " << fin_1_seq_number << std::endl;
+                    continue;
+                }
 
-            if ( !fin_1 && is_fin_ack( packet_tcp_header ) ) {
-                fin_1 = packet;
-                fin_1_seq_number = packet_tcp_header.sequence_number;
-                std::cout << "fin_1_seq_number: " << fin_1_seq_number << std::endl;
-                continue;
-            }
+                if ( !fin_2 && is_fin_ack( packet_tcp_header ) ) {
+                    if ( packet_tcp_header.sequence_number == fin_1_seq_number ) continue;
+                    fin_2 = packet;
+                    fin_2_seq_number = packet_tcp_header.sequence_number;
+                    
+                    if ( packet_tcp_header.acknowledgment_number == fin_1_seq_number + 1 ) {
+                        ack_1 = packet;
+                        std::cout << "ack_1 set by piggyback on fin_2 packet" << std::endl;
+                    }
+                    continue;
+                }
 
-            if ( !fin_2 && is_fin_ack( packet_tcp_header ) ) {
-                if ( packet_tcp_header.sequence_number == fin_1_seq_number ) continue;
-                fin_2 = packet;
-                fin_2_seq_number = packet_tcp_header.sequence_number;
-                
-                if ( packet_tcp_header.acknowledgment_number == fin_1_seq_number + 1 ) {
-                    ack_1 = packet;
-                    std::cout << "ack_1 set by piggyback on fin_2 packet" << std::endl;
+                if ( fin_1 && !ack_1 ) {
+                    if ( is_ack( packet_tcp_header ) &&
+                         packet_tcp_header.acknowledgment_number == fin_1_seq_number + 1 ) {
+                        ack_1 = packet;
+                        std::cout << "ack 1 set" << std::endl;
+                        continue;
+                    }
                 }
-                continue;
-            }
 
-            if ( fin_1 && !ack_1 ) {
-                if ( is_ack( packet_tcp_header ) &&
-                     packet_tcp_header.acknowledgment_number == fin_1_seq_number + 1 ) {
-                    ack_1 = packet;
-                    std::cout << "ack 1 set" << std::endl;
-                    continue;
+                if ( fin_2 && !ack_2 && is_ack( packet_tcp_header ) ) {
+                    if ( packet_tcp_header.acknowledgment_number == fin_2_seq_number + 1 ) {
+                        ack_2 = packet;
+                        continue;
+                    }
                 }
             }
 
-            if ( fin_2 && !ack_2 && is_ack( packet_tcp_header ) ) {
-                if ( packet_tcp_header.acknowledgment_number == fin_2_seq_number + 1 ) {
-                    ack_2 = packet;
-                    continue;
+            if ( fin_1 && ack_1 && fin_2 && ack_2 ) {
+                return tcp_termination{
+                    .closing_sequence = fin_ack_fin_ack{ *fin_1, *ack_1, *fin_2, *ack_2 }
+                };
+            }
+
+            for ( const auto* connection_packet : connection_packets ) {
+                const auto& packet = *connection_packet;
+                auto packet_tcp_header = get_tcp_header( packet.data() );
+                if ( packet_tcp_header.flags & 0x04 ) { 
+                    return tcp_termination {
+                        .closing_sequence = packet
+                    };
                 }
             }
-        }
 
-        if ( fin_1 && ack_1 && fin_2 && ack_2 ) {
-            return tcp_termination{
-                .closing_sequence = fin_ack_fin_ack{ *fin_1, *ack_1, *fin_2, *ack_2 }
-            };
+            return {};
         }
 
-        for ( const auto& packet : connection_packets ) {
-            auto packet_tcp_header = get_tcp_header( packet.data() );
-            if ( packet_tcp_header.flags & 0x04 ) { 
-                return tcp_termination {
-                    .closing_sequence = packet
-                };
-            }
-        }
+        std::vector<tcp_termination> find_terminations( const connection& connection_packets ) {
 
-        return {};
-    }
+            std::vector<tcp_termination> terminations;
 
-    std::vector<tcp_termination> get_terminations( const four_tuple& four, const session& packets ) {
+            std::optional<std::vector<uint8_t>> fin_1;
+            std::optional<std::vector<uint8_t>> ack_1; 
+            std::optional<std::vector<uint8_t>> fin_2; 
+            std::optional<std::vector<uint8_t>> ack_2;
+
+            uint32_t fin_1_seq_number = std::numeric_limits<uint32_t>::max();
+            uint32_t fin_2_seq_number = std::numeric_limits<uint32_t>::max();
+
+            auto is_fin_ack = [&]( const auto& packet_tcp_header ) {
+                return ( packet_tcp_header.flags & static_cast<uint8_t>( tcp_flags::FIN_ACK ) ) == static_cast<uint8_t>( tcp_flags::FIN_ACK );
+            };
 
-        std::vector<tcp_termination> terminations;
+            auto is_ack_of_fin_ack = [&]( const auto& tcp_header, uint32_t fin_ack_seq_number ) {
+                return tcp_header.acknowledgment_number == fin_ack_seq_number + 1;
+            };
+
+            for ( const auto* connection_packet : connection_packets ) {
+                const auto& packet = *connection_packet;
+        
+                auto packet_tcp_header = get_tcp_header( packet.data() );
+
+                if ( !fin_1 && is_fin_ack( packet_tcp_header ) ) {
+                    fin_1 = packet;
+                    fin_1_seq_number = packet_tcp_header.sequence_number;
+                } else if ( !fin_2 && is_fin_ack( packet_tcp_header ) ) {
+                    if ( packet_tcp_header.sequence_number == fin_1_seq_number ) continue;
+                    fin_2 = packet;
+                    fin_2_seq_number = packet_tcp_header.sequence_number;
+                } else if ( fin_1 && !ack_1 && is_ack( packet_tcp_header ) && is_ack_of_fin_ack( packet_tcp_header, fin_1_seq_number ) ) {
+                    ack_1 = packet;
+                } else if ( fin_2 && !ack_2 && is_ack( packet_tcp_header ) && is_ack_of_fin_ack( packet_tcp_header, fin_2_seq_number ) ) {
+                    ack_2 = packet;
+                }
 
-         std::vector<std::vector<uint8_t>> connection_packets;
+                if ( fin_1 && ack_1 && fin_2 && ack_2 ) {
+                    terminations.push_back( tcp_termination {
+                        .closing_sequence = fin_ack_fin_ack{ *fin_1, *ack_1, *fin_2, *ack_2 }
+                    } );
+                    fin_1 = ack_1 = fin_2 = ack_2 = std::nullopt;
+                    fin_1_seq_number = fin_2_seq_number = std::numeric_limits<uint32_t>::max();
+                }
+            }
 
-        for ( const auto& packet : packets ) {
-            if ( is_same_connection( packet, four ) ) {
-                connection_packets.push_back( packet );
+            for ( const auto* connection_packet : connection_packets ) {
+                const auto& packet = *connection_packet;
+                auto packet_tcp_header = get_tcp_header( packet.data() );
+                if ( packet_tcp_header.flags & 0x04 ) { 
+                    terminations.push_back( tcp_termination {
+                        .closing_sequence = packet
+                    } );
+                }
             }
+
+            return terminations;
         }
 
-        std::optional<std::vector<uint8_t>> fin_1;
-        std::optional<std::vector<uint8_t>> ack_1; 
-        std::optional<std::vector<uint8_t>> fin_2; 
-        std::optional<std::vector<uint8_t>> ack_2;
+        // find_terminations, with the flow read again for its resets rather than held on to
+        template<typename Packets>
+        generator<tcp_termination> lazy_terminations( four_tuple four, const Packets& packets ) {
 
-        uint32_t fin_1_seq_number = std::numeric_limits<uint32_t>::max();
-        uint32_t fin_2_seq_number = std::numeric_limits<uint32_t>::max();
+            std::optional<std::vector<uint8_t>> fin_1;
+            std::optional<std::vector<uint8_t>> ack_1; 
+            std::optional<std::vector<uint8_t>> fin_2; 
+            std::optional<std::vector<uint8_t>> ack_2;
 
-        auto is_fin_ack = [&]( const auto& packet_tcp_header ) {
-            return ( packet_tcp_header.flags & static_cast<uint8_t>( tcp_flags::FIN_ACK ) ) == static_cast<uint8_t>( tcp_flags::FIN_ACK );
-        };
+            uint32_t fin_1_seq_number = std::numeric_limits<uint32_t>::max();
+            uint32_t fin_2_seq_number = std::numeric_limits<uint32_t>::max();
 
-        auto is_ack_of_fin_ack = [&]( const auto& tcp_header, uint32_t fin_ack_seq_number ) {
-            return tcp_header.acknowledgment_number == fin_ack_seq_number + 1;
-        };
+            auto is_fin_ack = [&]( const auto& packet_tcp_header ) {
+                return ( packet_tcp_header.flags & static_cast<uint8_t>( tcp_flags::FIN_ACK ) ) == static_cast<uint8_t>( tcp_flags::FIN_ACK );
+            };
 
-        for ( const auto& packet : connection_packets ) {
-    
-            auto packet_tcp_header = get_tcp_header( packet.data() );
-
-            if ( !fin_1 && is_fin_ack( packet_tcp_header ) ) {
-                fin_1 = packet;
-                fin_1_seq_number = packet_tcp_header.sequence_number;
-            } else if ( !fin_2 && is_fin_ack( packet_tcp_header ) ) {
-                if ( packet_tcp_header.sequence_number == fin_1_seq_number ) continue;
-                fin_2 = packet;
-                fin_2_seq_number = packet_tcp_header.sequence_number;
-            } else if ( fin_1 && !ack_1 && is_ack( packet_tcp_header ) && is_ack_of_fin_ack( packet_tcp_header, fin_1_seq_number ) ) {
-                ack_1 = packet;
-            } else if ( fin_2 && !ack_2 && is_ack( packet_tcp_header ) && is_ack_of_fin_ack( packet_tcp_header, fin_2_seq_number ) ) {
-                ack_2 = packet;
-            }
+            auto is_ack_of_fin_ack = [&]( const auto& tcp_header, uint32_t fin_ack_seq_number ) {
+                return tcp_header.acknowledgment_number == fin_ack_seq_number + 1;
+            };
 
-            if ( fin_1 && ack_1 && fin_2 && ack_2 ) {
-                terminations.push_back( tcp_termination {
-                    .closing_sequence = fin_ack_fin_ack{ *fin_1, *ack_1, *fin_2, *ack_2 }
-                } );
-                fin_1 = ack_1 = fin_2 = ack_2 = std::nullopt;
-                fin_1_seq_number = fin_2_seq_number = std::numeric_limits<uint32_t>::max();
+            for ( const auto* connection_packet : each_connection_packet( four, packets ) ) {
+                const auto& packet = *connection_packet;
+        
+                auto packet_tcp_header = get_tcp_header( packet.data() );
+
+                if ( !fin_1 && is_fin_ack( packet_tcp_header ) ) {
+                    fin_1 = packet;
+                    fin_1_seq_number = packet_tcp_header.sequence_number;
+                } else if ( !fin_2 && is_fin_ack( packet_tcp_header ) ) {
+                    if ( packet_tcp_header.sequence_number == fin_1_seq_number ) continue;
+                    fin_2 = packet;
+                    fin_2_seq_number = packet_tcp_header.sequence_number;
+                } else if ( fin_1 && !ack_1 && is_ack( packet_tcp_header ) && is_ack_of_fin_ack( packet_tcp_header, fin_1_seq_number ) ) {
+                    ack_1 = packet;
+                } else if ( fin_2 && !ack_2 && is_ack( packet_tcp_header ) && is_ack_of_fin_ack( packet_tcp_header, fin_2_seq_number ) ) {
+                    ack_2 = packet;
+                }
+
+                if ( fin_1 && ack_1 && fin_2 && ack_2 ) {
+                    // named rather than yielded as a temporary, gcc 12 destroys those twice
+                    tcp_termination termination {
+                        .closing_sequence = fin_ack_fin_ack{ std::move( *fin_1 ), std::move( *ack_1 ), std::move( *fin_2 ), std::move( *ack_2 ) }
+                    };
+                    co_yield std::move( termination );
+                    fin_1 = ack_1 = fin_2 = ack_2 = std::nullopt;
+                    fin_1_seq_number = fin_2_seq_number = std::numeric_limits<uint32_t>::max();
+                }
             }
-        }
 
-        for ( const auto& packet : connection_packets ) {
-            auto packet_tcp_header = get_tcp_header( packet.data() );
-            if ( packet_tcp_header.flags & 0x04 ) { 
-                terminations.push_back( tcp_termination {
-                    .closing_sequence = packet
-                } );
+            for ( const auto* connection_packet : each_connection_packet( four, packets ) ) {
+                const auto& packet = *connection_packet;
+                auto packet_tcp_header = get_tcp_header( packet.data() );
+                if ( packet_tcp_header.flags & 0x04 ) { 
+                    tcp_termination termination {
+                        .closing_sequence = packet
+                    };
+                    co_yield std::move( termination );
+                }
             }
         }
 
-        return terminations;
+    } // namespace
+
+    tcp_termination get_termination( const four_tuple& four, const session& packets ) {
+        return find_termination( connection_packets( four, packets ) );
+    }
+
+    tcp_termination get_termination( const four_tuple& four, const flow_index& index ) {
+        return find_termination( connection_packets( four, index ) );
+    }
+
+    std::vector<tcp_termination> get_terminations( const four_tuple& four, const session& packets ) {
+        return find_terminations( connection_packets( four, packets ) );
+    }
+
+    std::vector<tcp_termination> get_terminations( const four_tuple& four, const flow_index& index ) {
+        return find_terminations( connection_packets( four, index ) );
+    }
+
+    generator<tcp_termination> generate_terminations( four_tuple four, const session& packets ) {
+        return lazy_terminations( four, packets );
+    }
+
+    generator<tcp_termination> generate_terminations( four_tuple four, const flow_index& index ) {
+        return lazy_terminations( four, index );
     }
 
     const std::vector<uint8_t>* get_start_of_termination( const session& packets, 
@@ -597,63 +734,48 @@ namespace ntk {
 
     void tcp_transfer::load( const session& packet_data ) {
 
-        tcp_handshake handshake = get_handshake( m_four, packet_data );
-        tcp_termination termination = get_termination( m_four, packet_data );
+        m_stream = replay_stream( m_four, packet_data );
+        if ( !m_stream ) return;
 
-        m_handshake = handshake;
-        m_termination = termination;
+        m_handshake = m_stream->handshake();
+        m_termination = m_stream->termination();
 
-        split_stream( packet_data );
+        split_stream( *m_stream );
     }
 
-    void tcp_transfer::split_stream( const session& packet_data ) {
-
-        auto syn_header = get_tcp_header( m_handshake.syn.data() );
-        auto syn_ack_header = get_tcp_header( m_handshake.syn_ack.data() );
-
-        auto handshake_ack_ptr = get_end_of_handshake( packet_data, m_four, m_handshake );
-        handshake_ack_ptr++;
-
-        std::cout << "got handshake" << std::endl;
-
-        auto termination_ptr = get_start_of_termination( packet_data, m_four, m_termination );
-
-        std::cout << "got termination" << std::endl;
+    const std::optional<tcp_live_stream>& tcp_transfer::stream() const {
+        return m_stream;
+    }
 
-        auto size = static_cast<size_t>( termination_ptr - handshake_ack_ptr );
+    void tcp_transfer::split_stream( const tcp_live_stream& stream ) {
 
-        std::cout << "span size: " << size << std::endl;
+        // the stream holds what came between handshake and termination, each frame is sorted by sender
+        auto server = flip_four( m_four );
 
-        auto packet_span = std::span{ handshake_ack_ptr, size };
+        auto sort = [&]( std::span<const uint8_t> frame ) {
 
-        for ( auto& packet : packet_span ) {
-            
-            if ( is_data_packet( packet ) && get_four_from_ethernet( packet ) == m_four ) {
-                m_client_traffic.push_back( packet );
+            auto decoded = decode_packet( frame );
+            if ( !decoded ) return;
 
-                std::cout << "adding traffic" << std::endl;
-                continue;
-            }
+            bool from_client = decoded->four() == m_four;
+            if ( !from_client && decoded->four() != server ) return;
 
-            if ( is_data_packet( packet ) && get_four_from_ethernet( packet ) == flip_four( m_four ) ) {
-                m_server_traffic.push_back( packet );
+            std::vector<uint8_t> packet( frame.begin(), frame.end() );
 
-                std::cout << "adding traffic" << std::endl;
-                continue;
-            }
-
-            if ( is_ack( packet ) && get_four_from_ethernet( packet ) == m_four ) {
-                m_client_acks.push_back( packet );
-
-                std::cout << "adding ack" << std::endl;
-                continue;
+            if ( is_data_packet( packet ) ) {
+                ( from_client ? m_client_traffic : m_server_traffic ).push_back( std::move( packet ) );
+            } else if ( is_ack( packet ) ) {
+                ( from_client ? m_client_acks : m_server_acks ).push_back( std::move( packet ) );
             }
+        };
 
-            if ( is_ack( packet ) && get_four_from_ethernet( packet ) == flip_four( m_four ) ) {
-                m_server_acks.push_back( packet );
+        stream.for_each_frame( sort );
 
-                std::cout << "adding ack" << std::endl;
-                continue;
+        // a fin exchange a reset cut short came before the termination, its packets count as acks
+        auto& feed = stream.m_termination_feed;
+        if ( std::holds_alternative<rst>( feed.m_termination.closing_sequence ) ) {
+            for ( auto* closing : { &feed.m_fin_1, &feed.m_ack_1, &feed.m_fin_2, &feed.m_ack_2 } ) {
+                if ( *closing ) sort( **closing );
             }
         }
     }
@@ -696,10 +818,14 @@ namespace ntk {
         return t.m_termination_feed;
     }
 
-    const std::vector<std::vector<uint8_t>>& tcp_live_stream_friend_helper::traffic( const tcp_live_stream& t ) {
+    const frame_arena& tcp_live_stream_friend_helper::traffic( const tcp_live_stream& t ) {
         return t.m_traffic;
     }
 
+    const std::vector<packet_view>& tcp_live_stream_friend_helper::pooled_traffic( const tcp_live_stream& t ) {
+        return t.m_pooled_traffic;
+    }
+
     const four_tuple& tcp_live_stream_friend_helper::four( const tcp_live_stream& t ) {
         return t.m_four;
     }
@@ -721,71 +847,93 @@ namespace ntk {
 
     four_tuple get_four_from_ethernet( const unsigned char* packet ) {
 
-        tcp_header packet_tcp_header = get_tcp_header( packet );
-        ipv4_header packet_ip_header = get_ipv4_header( packet );
+        // read in place, this runs for every packet and the full header parse allocates
+        const unsigned char* ip = packet + constants::ethernet_header_len;
+        const unsigned char* tcp = ip + ( ip[ 0 ] & 0x0f ) * 4;
+        // past the first fragment there are no ports, only part of the datagram's payload
+        bool has_ports = ( ( ( ip[ 6 ] & 0x1f ) << 8 ) | ip[ 7 ] ) == 0;
+
+        auto read_ip = []( const unsigned char* p ) {
+            return ( static_cast<uint32_t>( p[ 0 ] ) << 24 ) | ( static_cast<uint32_t>( p[ 1 ] ) << 16 ) |
+                   ( static_cast<uint32_t>( p[ 2 ] ) << 8 ) | p[ 3 ];
+        };
 
         return four_tuple {
-            .client_ip = packet_ip_header.source_ip_addr,
-            .server_ip = packet_ip_header.destination_ip_addr,
-            .client_port = packet_tcp_header.source_port,
-            .server_port = packet_tcp_header.destination_port
+            .client_ip = read_ip( ip + 12 ),
+            .server_ip = read_ip( ip + 16 ),
+            .client_port = has_ports ? static_cast<uint16_t>( ( tcp[ 0 ] << 8 ) | tcp[ 1 ] ) : uint16_t( 0 ),
+            .server_port = has_ports ? static_cast<uint16_t>( ( tcp[ 2 ] << 8 ) | tcp[ 3 ] ) : uint16_t( 0 )
         };
     }
 
     std::unordered_set<four_tuple> get_four_tuples( const session& packets ) {
 
         std::unordered_set<four_tuple> four_tuples;
+        // one probe per packet, the flow_key is the same for both directions
+        std::unordered_set<flow_key,flow_key_hash> seen;
 
         for ( auto& packet : packets ) {
             auto four = get_four_from_ethernet( packet );
-            auto flipped = flip_four( four );
-            if ( four_tuples.contains( four ) || four_tuples.contains( flipped ) ) {
-                continue;
-            }
-            four_tuples.insert( four );
+            if ( seen.insert( four ).second ) four_tuples.insert( four );
         }
         
         return four_tuples;
     }
 
-    bool is_data_packet( const std::vector<uint8_t>& packet ) {
+    std::unordered_set<four_tuple> get_four_tuples( const flow_index& index ) {
+        std::unordered_set<four_tuple> four_tuples;
+        for ( auto& flow : index.flows() ) four_tuples.insert( flow.four );
+        return four_tuples;
+    }
+
+    std::unordered_set<four_tuple> get_four_tuples( const session_columns& columns ) {
 
-        ipv4_header packet_ip_header = get_ipv4_header( packet.data() );
-        tcp_header packet_tcp_header = get_tcp_header( packet.data() );
-        size_t tcp_header_len = packet_tcp_header.data_offset * 4;
+        std::unordered_set<four_tuple> four_tuples;
+        std::unordered_set<flow_key,flow_key_hash> seen;
 
-        size_t payload_len = packet.size() - packet_ip_header.ihl - tcp_header_len - constants::ethernet_header_len;
+        for ( size_t row = 0; row < columns.size(); ++row ) {
+            auto four = columns.four( row );
+            if ( seen.insert( four ).second ) four_tuples.insert( four );
+        }
 
-        return payload_len > 0;
+        return four_tuples;
     }
 
-    bool is_ack_only_packet( const std::vector<uint8_t>& packet ) {
-        return !is_data_packet( packet ) && ( get_tcp_header( packet.data() ).flags & 0x10 );
+    // counts anything after the headers, ethernet padding included, unlike decoded_packet::is_data_packet
+    bool is_data_packet( const std::vector<uint8_t>& packet ) {
+        auto decoded = decode_packet( packet );
+        return decoded && packet.size() > decoded->network_offset + decoded->ip_header_len + decoded->tcp_header_len;
     }
 
-    bool tcp_handshake_feed::feed_packet( const std::vector<uint8_t>& packet ) {
+    bool is_ack_only_packet( const std::vector<uint8_t>& packet ) {
+        auto decoded = decode_packet( packet );
+        return decoded && !is_data_packet( packet ) && decoded->is_ack();
+    }
 
-        auto packet_tcp_header = get_tcp_header( packet.data() );
+    bool tcp_handshake_feed::feed_packet( const decoded_packet& packet ) {
 
-        if ( is_syn( packet ) ) {
+        if ( packet.is_syn() ) {
             reset();
-            m_syn = packet;
+            m_syn = std::vector<uint8_t>( packet.frame.begin(), packet.frame.end() );
+            m_syn_seq_number = packet.sequence_number;
+            m_syn_four = packet.four();
 
             std::cout << "syn detected" << std::endl;
             return true;
         }
 
-        if ( m_syn && !m_syn_ack && is_syn_ack( packet ) &&
-             packet_tcp_header.acknowledgment_number == get_tcp_header( m_syn.value().data() ).sequence_number + 1 ) {
-            m_syn_ack = packet;
+        if ( m_syn && !m_syn_ack && packet.is_syn_ack() &&
+             packet.acknowledgment_number == m_syn_seq_number + 1 ) {
+            m_syn_ack = std::vector<uint8_t>( packet.frame.begin(), packet.frame.end() );
+            m_syn_ack_seq_number = packet.sequence_number;
 
             std::cout << "syn_ack detected" << std::endl;
             return true;
         }
 
-        if ( m_syn_ack && is_ack( packet ) &&
-             packet_tcp_header.acknowledgment_number == get_tcp_header( m_syn_ack.value().data() ).sequence_number + 1 )  {
-            m_ack = packet;
+        if ( m_syn_ack && packet.is_ack() &&
+             packet.acknowledgment_number == m_syn_ack_seq_number + 1 )  {
+            m_ack = std::vector<uint8_t>( packet.frame.begin(), packet.frame.end() );
 
             std::cout << "ack detected" << std::endl;
             return true;
@@ -794,7 +942,7 @@ namespace ntk {
         return false;
     }
 
-    bool tcp_handshake_feed::feed( const std::vector<uint8_t>& packet ) { 
+    bool tcp_handshake_feed::feed( const decoded_packet& packet ) { 
         
         bool accepted = feed_packet( packet );
 
@@ -813,47 +961,51 @@ namespace ntk {
         return true;
     };
 
-    bool tcp_termination_feed::feed_packet( const std::vector<uint8_t>& packet ) {
-
-        auto packet_tcp_header = get_tcp_header( packet.data() );
+    bool tcp_termination_feed::feed_packet( const decoded_packet& packet ) {
 
-        auto is_fin_ack = [&]( const auto& packet_tcp_header ) {
-            return ( packet_tcp_header.flags & static_cast<uint8_t>( tcp_flags::FIN_ACK ) ) == static_cast<uint8_t>( tcp_flags::FIN_ACK );
+        auto frame = [&]() {
+            return std::vector<uint8_t>( packet.frame.begin(), packet.frame.end() );
         };
 
-        if ( !m_fin_1 && is_fin_ack( packet_tcp_header ) ) {
-            m_fin_1 = packet;
-            m_fin_1_seq_number = packet_tcp_header.sequence_number;
+        // a reset ends the connection whatever state the fin exchange was in, as get_termination has it
+        if ( packet.is_reset() ) {
+            m_termination.closing_sequence = frame();
+            return true;
+        }
+
+        if ( !m_fin_1 && packet.is_fin_ack() ) {
+            m_fin_1 = frame();
+            m_fin_1_seq_number = packet.sequence_number;
             std::cout << "fin_1_seq_number: " << m_fin_1_seq_number << std::endl;
             return true;
         }
 
-        if ( !m_fin_2 && is_fin_ack( packet_tcp_header ) ) {
-            if ( packet_tcp_header.sequence_number == m_fin_1_seq_number ) return false;
-            m_fin_2 = packet;
-            m_fin_2_seq_number = packet_tcp_header.sequence_number;
+        if ( !m_fin_2 && packet.is_fin_ack() ) {
+            if ( packet.sequence_number == m_fin_1_seq_number ) return false;
+            m_fin_2 = frame();
+            m_fin_2_seq_number = packet.sequence_number;
 
             std::cout << "fin_2_seq_number: " << m_fin_2_seq_number << std::endl;
             
-            if ( packet_tcp_header.acknowledgment_number == m_fin_1_seq_number + 1 ) {
-                m_ack_1 = packet;
+            if ( packet.acknowledgment_number == m_fin_1_seq_number + 1 ) {
+                m_ack_1 = frame();
                 std::cout << "ack_1 set by piggyback on fin_2 packet" << std::endl;
             }
             return true;
         }
 
         if ( m_fin_1 && !m_ack_1 ) {
-            if ( is_ack( packet_tcp_header ) &&
-                 packet_tcp_header.acknowledgment_number == m_fin_1_seq_number + 1 ) {
-                m_ack_1 = packet;
+            if ( packet.is_ack() &&
+                 packet.acknowledgment_number == m_fin_1_seq_number + 1 ) {
+                m_ack_1 = frame();
                 std::cout << "ack 1 set" << std::endl;
                 return true;
             }
         }
 
-        if ( m_fin_2 && !m_ack_2 && is_ack( packet_tcp_header ) ) {
-            if ( packet_tcp_header.acknowledgment_number == m_fin_2_seq_number + 1 ) {
-                m_ack_2 = packet;
+        if ( m_fin_2 && !m_ack_2 && packet.is_ack() ) {
+            if ( packet.acknowledgment_number == m_fin_2_seq_number + 1 ) {
+                m_ack_2 = frame();
 
                 std::cout << "ack 2 set" << std::endl;
                 return true;
@@ -863,11 +1015,16 @@ namespace ntk {
         return false;
     }
 
-    bool tcp_termination_feed::feed( const std::vector<uint8_t>& packet ) {
+    bool tcp_termination_feed::feed( const decoded_packet& packet ) {
 
         bool accepted = feed_packet( packet );
 
         if ( !accepted ) return false;
+
+        if ( std::holds_alternative<rst>( m_termination.closing_sequence ) ) {
+            m_complete = true;
+            return true;
+        }
         
         if ( m_fin_1 && m_ack_1 && m_fin_2 && m_ack_2 ) {
             m_termination.closing_sequence = fin_ack_fin_ack{ *m_fin_1, *m_ack_1, *m_fin_2, *m_ack_2 };
@@ -881,6 +1038,9 @@ namespace ntk {
     tcp_live_stream::tcp_live_stream( const four_tuple& four ) 
         : m_four( four ), m_handshake_feed( four ), m_termination_feed( four ) {}
 
+    tcp_live_stream::tcp_live_stream( const four_tuple& four, std::pmr::memory_resource* upstream )
+        : m_handshake_feed( four ), m_termination_feed( four ), m_traffic( upstream ), m_four( four ) {}
+
     bool tcp_live_stream::operator==( const tcp_live_stream& other ) const {
 
         return m_four == other.m_four && m_handshake_feed.m_handshake == other.m_handshake_feed.m_handshake && 
@@ -891,9 +1051,16 @@ namespace ntk {
         return m_termination_feed.m_complete;
     }
 
-    bool tcp_live_stream::feed( const std::vector<uint8_t>& packet ) {
+    eviction_reason tcp_live_stream::eviction() const {
+        return m_eviction;
+    }
+
+    bool tcp_live_stream::feed_control( const decoded_packet& packet, bool& is_traffic ) {
+
+        is_traffic = false;
 
         if ( is_complete() ) return false;
+
         if ( !is_same_connection( packet, m_four ) ) return false;
 
         bool handshake_packet = false;
@@ -905,56 +1072,675 @@ namespace ntk {
         if ( !m_termination_feed.m_complete ) termination_packet = m_termination_feed.feed( packet );
         if ( termination_packet ) return true;
 
-        m_traffic.push_back( packet );
+        is_traffic = true;
 
         return true;
     }
 
+    template<typename Packet>
+    bool tcp_live_stream::feed_decoded( const decoded_packet& decoded, const Packet& packet ) {
+
+        bool is_traffic;
+        if ( !feed_control( decoded, is_traffic ) ) return false;
+
+        update_reassembly( decoded, is_traffic );
+
+        if constexpr ( std::is_same_v<Packet,captured_packet> ) {
+            update_timing( decoded, packet.timestamp, is_traffic );
+            m_metrics.add( decoded, is_from_client( decoded ), packet.timestamp );
+        } else {
+            m_metrics.add( decoded, is_from_client( decoded ) );
+        }
+
+        if ( !is_traffic || !m_store_frames || m_frames_truncated ) return true;
+
+        // pooled frames too, a slot held past the policy is a slot the capture cannot use
+        if ( m_retention.kind == retention_policy::mode::FIRST_BYTES ) {
+            auto& kept = is_from_client( decoded ) ? m_client_frame_bytes : m_server_frame_bytes;
+            if ( kept >= m_retention.bytes ) return true;
+            kept += packet.size();
+        }
+
+        if constexpr ( std::is_same_v<Packet,packet_view> ) {
+            m_pooled_traffic.push_back( packet );
+        } else {
+            if ( m_spill ) {
+                // out of disk too, what was spilled is kept and the rest dropped
+                if ( !m_spill->append( std::span<const uint8_t>( packet.data(), packet.size() ) ) ) m_frames_truncated = true;
+                return true;
+            }
+
+            m_traffic.push_back( std::span<const uint8_t>( packet.data(), packet.size() ) );
+        }
+
+        return true;
+    }
+
+    bool tcp_live_stream::feed( const std::vector<uint8_t>& packet ) {
+        auto decoded = decode_packet( packet );
+        return decoded && feed_decoded( *decoded, packet );
+    }
+
+    bool tcp_live_stream::feed( std::span<const uint8_t> packet ) {
+        auto decoded = decode_packet( packet );
+        return decoded && feed_decoded( *decoded, packet );
+    }
+
+    bool tcp_live_stream::feed( const packet_view& packet ) {
+        auto decoded = decode_packet( packet.bytes() );
+        return decoded && feed_decoded( *decoded, packet );
+    }
+
+    bool tcp_live_stream::feed( const captured_packet& packet ) {
+        auto decoded = decode_packet( packet.bytes );
+        return decoded && feed_decoded( *decoded, packet );
+    }
+
+    void tcp_live_stream::update_timing( const decoded_packet& packet, const capture_time& timestamp, bool is_traffic ) {
+
+        if ( !m_timing.first_packet ) m_timing.first_packet = timestamp;
+        m_timing.last_packet = timestamp;
+
+        auto is_stored = [&]( const std::optional<std::vector<uint8_t>>& stored ) {
+            return stored && std::ranges::equal( *stored, packet.frame );
+        };
+
+        if ( !is_traffic ) {
+            // a syn resets the handshake feed, so the later milestones start over with it
+            if ( is_stored( m_handshake_feed.m_syn ) && !m_handshake_feed.m_syn_ack ) {
+                m_timing.syn = timestamp;
+                m_timing.syn_ack = m_timing.ack = std::nullopt;
+            } else if ( !m_timing.syn_ack && is_stored( m_handshake_feed.m_syn_ack ) ) {
+                m_timing.syn_ack = timestamp;
+            } else if ( !m_timing.ack && is_stored( m_handshake_feed.m_ack ) ) {
+                m_timing.ack = timestamp;
+            }
+            return;
+        }
+
+        if ( m_timing.first_request && m_timing.first_response ) return;
+        if ( packet.payload.empty() ) return;
+
+        bool from_client = is_from_client( packet );
+
+        if ( from_client && !m_timing.first_request ) m_timing.first_request = timestamp;
+        if ( !from_client && !m_timing.first_response ) m_timing.first_response = timestamp;
+    }
+
+    void tcp_live_stream::update_reassembly( const decoded_packet& packet, bool is_traffic ) {
+
+        m_delivery.bytes = 0;
+
+        // anchor each direction at its handshake, a new syn restarts both like it restarts the handshake feed
+        if ( !is_traffic && packet.is_syn() ) {
+            m_client_reassembler.start( packet.sequence_number + 1 );
+            m_server_reassembler.reset();
+        } else if ( !is_traffic && packet.is_syn_ack() ) {
+            m_server_reassembler.start( packet.sequence_number + 1 );
+        }
+
+        if ( packet.payload.empty() || m_payload_truncated || m_headers_only ) return;
+
+        bool from_client = is_from_client( packet );
+        auto& reassembler = from_client ? m_client_reassembler : m_server_reassembler;
+
+        m_delivery.direction = from_client ? stream_direction::CLIENT_TO_SERVER : stream_direction::SERVER_TO_CLIENT;
+        m_delivery.bytes = reassembler.add( packet.sequence_number, packet.payload );
+    }
+
+    void tcp_live_stream::deliver( stream_events& events, bool release ) {
+
+        if ( m_delivery.bytes == 0 ) return;
+
+        auto& reassembler = m_delivery.direction == stream_direction::CLIENT_TO_SERVER ? m_client_reassembler : m_server_reassembler;
+
+        // what was appended sits at the end, a closed gap may have pulled in more than this packet
+        // a retention_policy of the last bytes may hold less than the packet brought in
+        events.on_data( m_four, m_delivery.direction, reassembler.recent( m_delivery.bytes ) );
+        if ( release ) reassembler.release();
+
+        m_delivery.bytes = 0;
+    }
+
+    void tcp_live_stream::deliver_held( stream_events& events, bool release ) {
+
+        // only the first bytes of each side are ordered, by capture time when there is one
+        bool server_first = m_timing.first_request && m_timing.first_response && *m_timing.first_response < *m_timing.first_request;
+
+        auto hand_over = [&]( stream_direction direction, tcp_reassembler& reassembler ) {
+            if ( reassembler.contiguous().empty() ) return;
+            events.on_data( m_four, direction, reassembler.contiguous() );
+            if ( release ) reassembler.release();
+        };
+
+        if ( server_first ) hand_over( stream_direction::SERVER_TO_CLIENT, m_server_reassembler );
+        hand_over( stream_direction::CLIENT_TO_SERVER, m_client_reassembler );
+        if ( !server_first ) hand_over( stream_direction::SERVER_TO_CLIENT, m_server_reassembler );
+
+        m_delivery.bytes = 0;
+    }
+
+    void tcp_live_stream::keep_headers_only() {
+        m_headers_only = true;
+        m_store_frames = false;
+        m_traffic.release();
+        std::vector<packet_view>().swap( m_pooled_traffic );
+        m_client_reassembler.release();
+        m_server_reassembler.release();
+        m_delivery.bytes = 0;
+    }
+
+    void tcp_live_stream::retain( const retention_policy& policy ) {
+
+        m_retention = policy;
+
+        switch ( policy.kind ) {
+            case retention_policy::mode::ALL:
+                break;
+            case retention_policy::mode::HEADERS_ONLY:
+                keep_headers_only();
+                break;
+            case retention_policy::mode::FIRST_BYTES:
+                // frames stored while undecided are the first ones anyway and stay
+                m_client_reassembler.keep_first( policy.bytes );
+                m_server_reassembler.keep_first( policy.bytes );
+                break;
+            case retention_policy::mode::LAST_BYTES:
+                m_store_frames = false;
+                m_traffic.release();
+                std::vector<packet_view>().swap( m_pooled_traffic );
+                m_client_reassembler.keep_last( policy.bytes );
+                m_server_reassembler.keep_last( policy.bytes );
+                break;
+        }
+    }
+
+    void tcp_live_stream::compress_payload() {
+        m_client_reassembler.compress();
+        m_server_reassembler.compress();
+        // the frames carry the same payload again, they would hold on to what the reassemblers gave up
+        m_traffic.compress();
+    }
+
+    bool tcp_live_stream::is_from_client( const decoded_packet& packet ) const {
+        // the side that sent the syn is the client, without one fall back to whoever spoke first
+        four_tuple client = m_handshake_feed.m_syn ? m_handshake_feed.m_syn_four : m_four;
+        return packet.four() == client;
+    }
+
+    const flow_metrics& tcp_live_stream::metrics() const {
+        return m_metrics;
+    }
+
+    std::span<const uint8_t> tcp_live_stream::client_payload() const {
+        return m_client_reassembler.contiguous();
+    }
+
+    std::span<const uint8_t> tcp_live_stream::server_payload() const {
+        return m_server_reassembler.contiguous();
+    }
+
+    const retention_policy& tcp_live_stream::retention() const {
+        return m_retention;
+    }
+
+    stream_memory tcp_live_stream::memory() const {
+        return stream_memory{
+            .frame_bytes = m_traffic.stored_bytes(),
+            .reassembled_bytes = m_client_reassembler.stored_bytes() + m_client_reassembler.pending_bytes() +
+                                 m_server_reassembler.stored_bytes() + m_server_reassembler.pending_bytes(),
+            .spilled_bytes = m_spill ? m_spill->size_bytes() : 0,
+            .truncated = m_frames_truncated || m_payload_truncated
+        };
+    }
+
+    const spill_file* tcp_live_stream::spilled_traffic() const {
+        return m_spill.get();
+    }
+
+    bool tcp_live_stream::spill( const std::filesystem::path& directory ) {
+
+        auto file = std::make_shared<spill_file>( directory );
+        if ( !file->is_open() ) return false;
+
+        // sealed frames are inflated a block at a time on their way out
+        bool written = true;
+        m_traffic.for_each( [&]( std::span<const uint8_t> frame ) { written = written && file->append( frame ); } );
+        if ( !written ) return false;
+
+        m_spill = std::move( file );
+
+        m_traffic.release();
+
+        return true;
+    }
+
+    void tcp_live_stream::truncate() {
+        if ( !m_spill ) m_frames_truncated = true;
+        m_payload_truncated = true;
+    }
+
     const four_tuple& tcp_live_stream::get_four_tuple() const {
         return m_four;
     }
 
+    const tcp_handshake& tcp_live_stream::handshake() const {
+        return m_handshake_feed.m_handshake;
+    }
+
+    const tcp_termination& tcp_live_stream::termination() const {
+        return m_termination_feed.m_termination;
+    }
+
+    const stream_timing& tcp_live_stream::timing() const {
+        return m_timing;
+    }
+
+    std::optional<std::chrono::nanoseconds> tcp_live_stream::handshake_rtt() const {
+        if ( !m_timing.syn || !m_timing.ack ) return std::nullopt;
+        return *m_timing.ack - *m_timing.syn;
+    }
+
+    std::optional<std::chrono::nanoseconds> tcp_live_stream::time_to_first_byte() const {
+        if ( !m_timing.first_request || !m_timing.first_response ) return std::nullopt;
+        if ( *m_timing.first_response < *m_timing.first_request ) return std::nullopt;
+        return *m_timing.first_response - *m_timing.first_request;
+    }
+
+    std::optional<std::chrono::nanoseconds> tcp_live_stream::capture_to_offload_latency() const {
+        if ( !m_timing.last_packet || !m_timing.offloaded ) return std::nullopt;
+        return *m_timing.offloaded - *m_timing.last_packet;
+    }
+
     tcp_live_stream_session::tcp_live_stream_session() 
         : m_offload_queue( nullptr ) {}
 
     tcp_live_stream_session::tcp_live_stream_session( transfer_queue_interface<tcp_live_stream>* offload_queue )
         : m_offload_queue( offload_queue ) {}
 
+    tcp_live_stream_session::tcp_live_stream_session( transfer_queue_interface<tcp_live_stream>* offload_queue, const session_limits& limits )
+        : m_offload_queue( offload_queue ), m_limits( limits ), m_fragments( limits.fragments ), m_link( link_layer_of( limits.link ) ) {}
+
+    tcp_live_stream_session::tcp_live_stream_session( transfer_queue_interface<tcp_live_stream>* offload_queue, stream_events* events, const session_limits& limits )
+        : m_offload_queue( offload_queue ), m_events( events ), m_limits( limits ), m_fragments( limits.fragments ),
+          m_link( link_layer_of( limits.link ) ) {}
+
     void tcp_live_stream_session::feed( const std::vector<uint8_t>& packet ) {
-        auto packet_four = get_four_from_ethernet( packet );
+        feed_packet( packet );
+    }
+
+    void tcp_live_stream_session::feed( const packet_view& packet ) {
+        feed_packet( packet );
+    }
 
-        if ( !m_four_tuples.contains( packet_four ) && !m_four_tuples.contains( flip_four( packet_four ) ) ) {
-            m_four_tuples.insert( packet_four );
-            m_live_streams.emplace_back( tcp_live_stream{ packet_four } );
-        } 
+    void tcp_live_stream_session::feed( std::span<const uint8_t> packet ) {
+        feed_packet( packet );
+    }
+
+    void tcp_live_stream_session::feed( const captured_packet& packet ) {
+        feed_packet( packet );
+        advance_time( packet.timestamp );
+    }
 
-        if ( !m_offload_queue ) {
-            for ( auto& stream : m_live_streams ) {
-                bool accepted = stream.feed( packet );
-                if ( accepted ) return;
+    void tcp_live_stream_session::advance_time( capture_time now ) {
+        m_fragments.advance_time( now );
+        m_expiry_timers.advance( now, [&]( const flow_key& key ) { expire( key, now ); } );
+    }
+
+    template<typename Packet>
+    void tcp_live_stream_session::feed_packet( const Packet& packet ) {
+
+        std::span<const uint8_t> frame( packet.data(), packet.size() );
+
+        // decoded once here, every stage after this reads the same view
+        auto decoded = m_link.decode( frame );
+
+        if ( !decoded ) {
+            // a fragment is held back until its datagram is whole, which is then fed in its place
+            auto network = m_link.network( frame );
+            if ( network && is_ipv4_fragment( frame, network->offset ) ) {
+                std::optional<capture_time> now;
+                if constexpr ( std::is_same_v<Packet,captured_packet> ) now = packet.timestamp;
+                if ( m_fragments.feed( frame, now, network->offset ) == fragment_result::COMPLETE ) {
+                    if constexpr ( std::is_same_v<Packet,captured_packet> ) {
+                        feed_packet( make_captured_packet( packet.timestamp, m_fragments.datagram() ) );
+                    } else {
+                        feed_packet( m_fragments.datagram() );
+                    }
+                }
+                return;
             }
+            m_packets_fed.add();
+            m_packets_unmatched.add();
+            return;
         }
 
-        std::vector<tcp_live_stream> updated_streams;
+        m_packets_fed.add();
 
-        for ( auto& stream : m_live_streams ) {
-            bool accepted = stream.feed( packet );
-            if ( accepted ) {
-                if ( stream.is_complete() ) { 
-                    offload( std::move( stream ) );
-                    continue;
+        if ( m_limits.verify_checksums ) {
+            auto checksums = verify_checksums( *decoded );
+            m_checksums.count( checksums );
+            if ( checksums.invalid() ) return;
+        }
+
+        auto packet_four = decoded->four();
+
+        flow_key key( packet_four );
+
+        tcp_live_stream* stream = m_live_streams.find( key );
+        bool is_new = false;
+        stream_memory held;
+
+        if ( !stream ) {
+            if ( auto dropped = m_tombstones.find( key ); dropped != m_tombstones.end() ) {
+                // the tombstone lasts while the flow goes on
+                if constexpr ( std::is_same_v<Packet,captured_packet> ) {
+                    if ( dropped->second.expires ) dropped->second.expires = tombstone_deadline( packet.timestamp );
                 }
+                m_packets_unmatched.add();
+                return;
+            }
+            // answers a connection that is gone, e.g. one just offloaded, and never opens one
+            if ( decoded->is_reset() ) {
+                m_packets_unmatched.add();
+                return;
+            }
+            stream = &m_live_streams.emplace( key, packet_four, m_limits.frame_upstream ? m_limits.frame_upstream : std::pmr::get_default_resource() );
+            stream->m_store_frames = m_offload_queue || !m_events;
+            stream->m_classified = !m_classifier || m_limits.metrics_only;
+            if ( m_limits.metrics_only ) {
+                stream->keep_headers_only();
+            } else {
+                stream->retain( m_limits.retention );
+                if ( m_limits.compress_payload ) stream->compress_payload();
             }
-            updated_streams.push_back( std::move( stream ) );
+            is_new = true;
+        } else {
+            held = stream->memory();
         }
-        
-        m_live_streams = std::move( updated_streams );
+
+        if ( !stream->feed_decoded( *decoded, packet ) ) {
+            m_packets_unmatched.add();
+            return;
+        }
+
+        if ( !stream->m_classified ) {
+            // decided on the client's first bytes, before anything is reported or kept for long
+            flow_verdict verdict = stream->m_client_reassembler.size() == 0 ? flow_verdict::UNDECIDED : m_classifier( *stream );
+
+            if ( verdict == flow_verdict::DROP ) {
+                std::optional<capture_time> now;
+                if constexpr ( std::is_same_v<Packet,captured_packet> ) now = packet.timestamp;
+                drop( key, held, now );
+                return;
+            }
+
+            if ( verdict != flow_verdict::UNDECIDED ) {
+                stream->m_classified = true;
+                if ( verdict == flow_verdict::HEADERS_ONLY ) stream->keep_headers_only();
+                if ( verdict == flow_verdict::RETAIN ) stream->retain( m_limits.classified_retention );
+                if ( m_events ) open( *stream );
+            }
+        } else if ( m_events ) {
+            if ( is_new ) m_events->on_open( stream->get_four_tuple() );
+            stream->deliver( *m_events, !m_offload_queue );
+        }
+
+        account( held, stream->memory() );
+
+        if constexpr ( std::is_same_v<Packet,captured_packet> ) {
+            if ( is_new ) schedule_expiry( key, *stream );
+        }
+
+        if ( m_limits.max_flow_bytes > 0 || m_limits.max_session_bytes > 0 ) {
+            enforce_budget( *stream );
+            // the global budget may have evicted this very stream
+            stream = m_live_streams.find( key );
+            if ( !stream ) return;
+        }
+
+        if ( ( m_offload_queue || m_events ) && stream->is_complete() ) close( key, close_reason::TERMINATED );
+    }
+
+    void tcp_live_stream_session::close( const flow_key& key, close_reason reason ) {
+
+        tcp_live_stream* stream = m_live_streams.find( key );
+        if ( !stream ) return;
+
+        if ( m_events ) {
+            // never classified, e.g. no client payload, is reported like a kept stream
+            if ( !stream->m_classified ) open( *stream );
+            m_events->on_close( stream->get_four_tuple(), reason );
+        }
+
+        offload( std::move( *stream ) );
+        m_live_streams.erase( key );
+    }
+
+    void tcp_live_stream_session::open( tcp_live_stream& stream ) {
+        m_events->on_open( stream.get_four_tuple() );
+        stream.deliver_held( *m_events, !m_offload_queue );
+    }
+
+    void tcp_live_stream_session::drop( const flow_key& key, const stream_memory& held, std::optional<capture_time> now ) {
+
+        // not accounted for this packet yet, so only what it held before goes
+        m_bytes_in_memory -= held.in_memory();
+        m_bytes_in_memory_gauge.set( m_bytes_in_memory );
+        m_bytes_spilled.add( m_live_streams.find( key )->memory().spilled_bytes - held.spilled_bytes );
+
+        m_live_streams.erase( key );
+        m_streams_dropped.add();
+
+        // keeps the rest of the flow out
+        auto& dropped = m_tombstones[ key ];
+        dropped.placed = ++m_tombstones_placed;
+        dropped.expires = now ? tombstone_deadline( *now ) : std::nullopt;
+        m_tombstone_order.emplace_back( key, dropped.placed );
+        if ( dropped.expires ) m_expiry_timers.schedule( key, *dropped.expires );
+
+        if ( m_limits.max_dropped_flows > 0 && m_tombstone_order.size() > m_limits.max_dropped_flows ) {
+            auto [ oldest, placed ] = m_tombstone_order.front();
+            m_tombstone_order.pop_front();
+            if ( auto it = m_tombstones.find( oldest ); it != m_tombstones.end() && it->second.placed == placed ) m_tombstones.erase( it );
+        }
+    }
+
+    std::optional<capture_time> tcp_live_stream_session::tombstone_deadline( capture_time now ) const {
+        if ( m_limits.idle_timeout.count() > 0 ) return now + m_limits.idle_timeout;
+        if ( m_limits.max_lifetime.count() > 0 ) return now + m_limits.max_lifetime;
+        return std::nullopt;
     }
 
     void tcp_live_stream_session::offload( tcp_live_stream&& stream ) {
+
+        // every caller drops the stream from the table next
+        m_bytes_in_memory -= stream.memory().in_memory();
+        m_bytes_in_memory_gauge.set( m_bytes_in_memory );
+
         if ( m_offload_queue ) {
+            if ( stream.m_spill ) stream.m_spill->map();
+            // only streams fed with timestamps have a latency to measure, the rest skip the clock read
+            if ( stream.m_timing.last_packet ) {
+                stream.m_timing.offloaded = capture_clock::now();
+                if ( m_capture_to_offload ) m_capture_to_offload->record( *stream.m_timing.offloaded - *stream.m_timing.last_packet );
+            }
             m_offload_queue->push( std::move( stream ) );
+            m_streams_offloaded.add();
+        }
+    }
+
+    void tcp_live_stream_session::schedule_expiry( const flow_key& key, const tcp_live_stream& stream ) {
+
+        auto& timing = stream.timing();
+        if ( !timing.first_packet ) return;
+
+        // the earlier of the two deadlines, expire() re-arms if the stream was active since
+        std::optional<capture_time> deadline;
+        if ( m_limits.idle_timeout.count() > 0 ) deadline = *timing.last_packet + m_limits.idle_timeout;
+        if ( m_limits.max_lifetime.count() > 0 ) {
+            capture_time end_of_life = *timing.first_packet + m_limits.max_lifetime;
+            if ( !deadline || end_of_life < *deadline ) deadline = end_of_life;
+        }
+
+        if ( deadline ) m_expiry_timers.schedule( key, *deadline );
+    }
+
+    void tcp_live_stream_session::expire( const flow_key& key, capture_time now ) {
+
+        tcp_live_stream* stream = m_live_streams.find( key );
+
+        if ( !stream ) {
+            // offloaded since the timer was set, or the flow was dropped and this is its tombstone
+            auto dropped = m_tombstones.find( key );
+            if ( dropped == m_tombstones.end() || !dropped->second.expires ) return;
+            if ( *dropped->second.expires > now ) {
+                m_expiry_timers.schedule( key, *dropped->second.expires );
+                return;
+            }
+
+            m_tombstones.erase( dropped );
+            // the entries of tombstones already gone, so the order does not outgrow them
+            while ( !m_tombstone_order.empty() ) {
+                auto it = m_tombstones.find( m_tombstone_order.front().first );
+                if ( it != m_tombstones.end() && it->second.placed == m_tombstone_order.front().second ) break;
+                m_tombstone_order.pop_front();
+            }
+            return;
+        }
+
+        // kept as completed when there is no queue
+        if ( stream->is_complete() ) return;
+
+        auto& timing = stream->timing();
+
+        if ( m_limits.max_lifetime.count() > 0 && now - *timing.first_packet >= m_limits.max_lifetime ) {
+            evict( key, eviction_reason::LIFETIME );
+        } else if ( m_limits.idle_timeout.count() > 0 && now - *timing.last_packet >= m_limits.idle_timeout ) {
+            evict( key, eviction_reason::IDLE );
+        } else {
+            schedule_expiry( key, *stream );
+        }
+    }
+
+    void tcp_live_stream_session::evict( const flow_key& key, eviction_reason reason ) {
+
+        tcp_live_stream* stream = m_live_streams.find( key );
+        if ( !stream ) return;
+
+        stream->m_eviction = reason;
+        m_streams_evicted.add();
+
+        // without a queue there is nobody to hand the partial stream to, so it is dropped
+        switch ( reason ) {
+            case eviction_reason::IDLE: close( key, close_reason::IDLE ); break;
+            case eviction_reason::LIFETIME: close( key, close_reason::LIFETIME ); break;
+            case eviction_reason::SHUTDOWN: close( key, close_reason::SHUTDOWN ); break;
+            default: close( key, close_reason::MEMORY ); break;
+        }
+    }
+
+    void tcp_live_stream_session::account( const stream_memory& before, const stream_memory& after ) {
+        m_bytes_in_memory = m_bytes_in_memory + after.in_memory() - before.in_memory();
+        m_bytes_in_memory_gauge.set( m_bytes_in_memory );
+        // a spill file only grows
+        m_bytes_spilled.add( after.spilled_bytes - before.spilled_bytes );
+    }
+
+    void tcp_live_stream_session::enforce_budget( tcp_live_stream& stream ) {
+
+        if ( m_limits.max_flow_bytes > 0 && stream.memory().in_memory() > m_limits.max_flow_bytes ) shed( stream );
+
+        if ( m_limits.max_session_bytes == 0 ) return;
+
+        while ( m_bytes_in_memory > m_limits.max_session_bytes ) {
+
+            // the largest stream frees the most per spill file, a linear scan is fine as it only runs over budget
+            tcp_live_stream* largest = nullptr;
+            size_t largest_bytes = 0;
+            for ( auto& live_stream : m_live_streams ) {
+                size_t bytes = live_stream.memory().in_memory();
+                if ( bytes > largest_bytes ) {
+                    largest = &live_stream;
+                    largest_bytes = bytes;
+                }
+            }
+
+            if ( !largest ) break;
+
+            if ( m_limits.on_overflow == overflow_policy::SPILL && !largest->m_spill && !largest->m_traffic.empty() && shed( *largest ) ) continue;
+
+            evict( flow_key( largest->get_four_tuple() ), eviction_reason::MEMORY );
+        }
+    }
+
+    bool tcp_live_stream_session::shed( tcp_live_stream& stream ) {
+
+        if ( m_limits.on_overflow == overflow_policy::SPILL && !stream.m_spill ) {
+            auto held = stream.memory();
+            if ( stream.spill( spill_directory() ) ) {
+                account( held, stream.memory() );
+                return true;
+            }
+        }
+
+        stream.truncate();
+        return false;
+    }
+
+    std::filesystem::path tcp_live_stream_session::spill_directory() const {
+        if ( !m_limits.spill_directory.empty() ) return m_limits.spill_directory;
+        std::error_code ec;
+        auto directory = std::filesystem::temp_directory_path( ec );
+        return ec ? std::filesystem::path( "." ) : directory;
+    }
+
+    session_statistics tcp_live_stream_session::statistics() const {
+        return session_statistics{ m_packets_fed.value(), m_packets_unmatched.value(), m_streams_offloaded.value(), m_streams_evicted.value(),
+                                   m_bytes_in_memory_gauge.value(), m_bytes_spilled.value(), m_streams_dropped.value() };
+    }
+
+    fragment_statistics tcp_live_stream_session::fragments() const {
+        return m_fragments.statistics();
+    }
+
+    checksum_statistics tcp_live_stream_session::checksums() const {
+        return m_checksums.statistics();
+    }
+
+    void tcp_live_stream_session::set_classifier( flow_classifier classifier ) {
+        m_classifier = std::move( classifier );
+    }
+
+    size_t tcp_live_stream_session::flush() {
+
+        // collected first, closing erases from the table being walked
+        std::vector<flow_key> open;
+        for ( auto& stream : m_live_streams ) {
+            if ( !stream.is_complete() ) open.emplace_back( stream.get_four_tuple() );
         }
+
+        for ( auto& key : open ) evict( key, eviction_reason::SHUTDOWN );
+
+        return open.size();
+    }
+
+    void tcp_live_stream_session::instrument( metrics_registry& registry, const std::string& label ) {
+
+        m_capture_to_offload = &registry.get_histogram( "ntk_capture_to_offload_seconds",
+                                                        "Capture of a stream's last packet to its offload.", nanoseconds_to_seconds );
+
+        std::string name = label.empty() ? "ntk_session_bytes_in_memory" : "ntk_session_bytes_in_memory{" + label + "}";
+        registry.add_gauge( name, "Bytes held by live streams.", [ this ] {
+            return static_cast<int64_t>( m_bytes_in_memory_gauge.value() );
+        });
+    }
+
+    std::vector<flow_memory_usage> tcp_live_stream_session::memory_usage() const {
+        std::vector<flow_memory_usage> usage;
+        usage.reserve( m_live_streams.size() );
+        for ( auto& stream : m_live_streams ) usage.push_back( flow_memory_usage{ stream.get_four_tuple(), stream.memory() } );
+        return usage;
     }
 
     size_t tcp_live_stream_session::number_of_completed_transfers() {
@@ -965,24 +1751,21 @@ namespace ntk {
     }
 
     const tcp_live_stream& tcp_live_stream_session_friend_helper::get_live_stream( const tcp_live_stream_session& t, const four_tuple& four ) {
-        auto matched_live_stream = std::find_if( t.m_live_streams.begin(), t.m_live_streams.end(), [&]( const auto& live_stream ) { 
-            auto& live_stream_four = tcp_live_stream_friend_helper::four( live_stream );
-            return live_stream_four == four;
-        });
+        auto matched_live_stream = t.m_live_streams.find( four );
 
-        if ( matched_live_stream == t.m_live_streams.end() ) {
+        if ( !matched_live_stream ) {
             throw std::runtime_error( "Live stream with given four_tuple not found" );
         }
 
         return *matched_live_stream;
     }
 
-    const std::vector<tcp_live_stream>& tcp_live_stream_session_friend_helper::live_streams( const tcp_live_stream_session& t ) {
+    const flow_table<flow_key,tcp_live_stream,flow_key_hash>& tcp_live_stream_session_friend_helper::live_streams( const tcp_live_stream_session& t ) {
         return t.m_live_streams;
     }
 
-    const std::unordered_set<four_tuple>& tcp_live_stream_session_friend_helper::four_tuples( const tcp_live_stream_session& t ) {
-        return t.m_four_tuples;
+    size_t tcp_live_stream_session_friend_helper::tombstones( const tcp_live_stream_session& t ) {
+        return t.m_tombstones.size();
     }
 
     bool is_valid_handshake( const tcp_handshake& handshake ) {
@@ -1029,6 +1812,44 @@ namespace ntk {
         return payloads;
     } 
 
+    std::vector<std::vector<uint8_t>> extract_payloads( const four_tuple& four, const flow_index& index ) {
+
+        std::vector<std::vector<uint8_t>> payloads;
+
+        auto flow = index.find( four );
+        if ( !flow ) return payloads;
+
+        for ( auto& p : flow->packets ) {
+            if ( flow->is_sent_by( p, four ) ) {
+                auto payload = extract_payload_from_ethernet( index.packet( p ) );
+                if ( payload.size() > 0 ) payloads.push_back( payload );
+            }
+        }
+
+        return payloads;
+    }
+
+    generator<std::vector<uint8_t>> generate_payloads( four_tuple four, const session& packets ) {
+        for ( auto& packet : packets ) {
+            if ( get_four_from_ethernet( packet ) == four ) {
+                auto payload = extract_payload_from_ethernet( packet );
+                if ( payload.size() > 0 ) co_yield std::move( payload );
+            }
+        }
+    }
+
+    generator<std::vector<uint8_t>> generate_payloads( four_tuple four, const flow_index& index ) {
+        auto flow = index.find( four );
+        if ( !flow ) co_return;
+
+        for ( auto& p : flow->packets ) {
+            if ( flow->is_sent_by( p, four ) ) {
+                auto payload = extract_payload_from_ethernet( index.packet( p ) );
+                if ( payload.size() > 0 ) co_yield std::move( payload );
+            }
+        }
+    }
+
     std::expected<client_server_payloads,std::string> split_payloads( const session& packets ) {
 
         client_server_payloads payloads;
@@ -1046,4 +1867,22 @@ namespace ntk {
         return payloads;
     }
 
-} // namespace ntk
\ No newline at end of file
+    std::expected<client_server_payloads,std::string> split_payloads( const flow_index& index ) {
+
+        client_server_payloads payloads;
+
+        // the first handshake of the capture, however many flows it has, like the session overload
+        auto handshake = get_handshake( index.packets() );
+
+        if ( handshake.empty() ) return std::unexpected( "No hanshake found" );
+
+        auto client_four = get_four_from_ethernet( handshake.syn );
+        auto server_four = get_four_from_ethernet( handshake.syn_ack );
+
+        payloads.client_payloads = extract_payloads( client_four, index );
+        payloads.server_payloads = extract_payloads( server_four, index );
+
+        return payloads;
+    }
+
+} // namespace ntk
@@ -0,0 +1,298 @@
+#include <tcp_reassembler.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <lz4_block.hpp>
+
+namespace ntk {
+
+    tcp_reassembler::tcp_reassembler()
+        : m_sealed_size( 0 ), m_sealed_stored( 0 ), m_initial_seq( 0 ), m_next_seq( 0 ), m_pending_bytes( 0 ), m_started( false ),
+          m_keep_first( 0 ), m_keep_last( 0 ), m_block_size( 0 ) {}
+
+    void tcp_reassembler::start( uint32_t initial_seq ) {
+        m_data.clear();
+        m_sealed.clear();
+        m_sealed_size = 0;
+        m_sealed_stored = 0;
+        m_pending.clear();
+        m_pending_bytes = 0;
+        m_initial_seq = initial_seq;
+        m_next_seq = initial_seq;
+        m_started = true;
+    }
+
+    bool tcp_reassembler::started() const {
+        return m_started;
+    }
+
+    void tcp_reassembler::reset() {
+        m_data.clear();
+        m_sealed.clear();
+        m_sealed_size = 0;
+        m_sealed_stored = 0;
+        m_pending.clear();
+        m_pending_bytes = 0;
+        m_started = false;
+    }
+
+    size_t tcp_reassembler::add( uint32_t seq, std::span<const uint8_t> payload ) {
+
+        if ( payload.empty() ) return 0;
+
+        // joined mid-stream, the first payload seen defines the start
+        if ( !m_started ) start( seq );
+
+        if ( m_keep_first ) {
+            uint32_t end = m_initial_seq + static_cast<uint32_t>( m_keep_first );
+            if ( !seq_before( seq, end ) ) return 0;
+            if ( seq_before( end, seq + static_cast<uint32_t>( payload.size() ) ) ) payload = payload.first( end - seq );
+        }
+
+        // before the payload goes in, so what this segment appends is never sealed right away
+        if ( m_block_size && !m_keep_last && m_data.size() >= m_block_size ) seal();
+
+        uint32_t ahead = seq - m_next_seq;
+
+        if ( ahead != 0 && !seq_before( seq, m_next_seq ) ) {
+            if ( ahead < max_window ) hold( seq, payload );
+            return 0;
+        }
+
+        size_t appended = append( seq, payload );
+        if ( appended ) appended += drain();
+
+        // trimmed only once it holds twice the bound, so the front is not moved on every segment
+        if ( m_keep_last && m_data.size() > 2 * m_keep_last ) m_data.erase( m_data.begin(), m_data.end() - m_keep_last );
+
+        return appended;
+    }
+
+    size_t tcp_reassembler::append( uint32_t seq, std::span<const uint8_t> payload ) {
+
+        // the part before m_next_seq is a retransmission of bytes already held
+        uint32_t behind = m_next_seq - seq;
+        if ( behind >= payload.size() ) return 0;
+
+        auto fresh = payload.subspan( behind );
+        m_data.insert( m_data.end(), fresh.begin(), fresh.end() );
+        m_next_seq += static_cast<uint32_t>( fresh.size() );
+
+        return fresh.size();
+    }
+
+    void tcp_reassembler::hold( uint32_t seq, std::span<const uint8_t> payload ) {
+
+        // kept ordered by distance from m_next_seq, which does not change while a segment waits
+        auto position = std::find_if( m_pending.begin(), m_pending.end(), [&]( const segment& s ) {
+            return seq_before( seq, s.seq ) || ( s.seq == seq && payload.size() > s.data.size() );
+        });
+
+        if ( position != m_pending.begin() ) {
+            auto& previous = *std::prev( position );
+            // already covered by the segment before it
+            if ( !seq_before( previous.seq + static_cast<uint32_t>( previous.data.size() ), seq + static_cast<uint32_t>( payload.size() ) ) ) return;
+        }
+
+        if ( m_pending.size() == max_pending_segments ) return;
+
+        m_pending.insert( position, segment{ seq, std::vector<uint8_t>( payload.begin(), payload.end() ) } );
+        m_pending_bytes += payload.size();
+    }
+
+    size_t tcp_reassembler::drain() {
+
+        size_t appended = 0;
+        size_t consumed = 0;
+
+        while ( consumed < m_pending.size() && !seq_before( m_next_seq, m_pending[ consumed ].seq ) ) {
+            appended += append( m_pending[ consumed ].seq, m_pending[ consumed ].data );
+            m_pending_bytes -= m_pending[ consumed ].data.size();
+            ++consumed;
+        }
+
+        m_pending.erase( m_pending.begin(), m_pending.begin() + consumed );
+
+        return appended;
+    }
+
+    void tcp_reassembler::seal() {
+
+        size_t offset = 0;
+        for ( ; m_data.size() - offset >= m_block_size; offset += m_block_size ) {
+
+            std::span<const uint8_t> block( m_data.data() + offset, m_block_size );
+            sealed_block sealed{ .bytes = {}, .size = m_block_size, .compressed = true };
+            lz4_compress_block( block, sealed.bytes );
+
+            if ( sealed.bytes.size() >= block.size() ) {
+                sealed.bytes.assign( block.begin(), block.end() );
+                sealed.compressed = false;
+            }
+            sealed.bytes.shrink_to_fit();
+
+            m_sealed_size += sealed.size;
+            m_sealed_stored += sealed.bytes.size();
+            m_sealed.push_back( std::move( sealed ) );
+        }
+
+        // what is left is less than a block, so the copy is short
+        m_data.erase( m_data.begin(), m_data.begin() + offset );
+    }
+
+    void tcp_reassembler::inflate( std::span<uint8_t> into ) const {
+
+        for ( auto& sealed : m_sealed ) {
+            auto block = into.first( sealed.size );
+            if ( !sealed.compressed ) {
+                std::copy( sealed.bytes.begin(), sealed.bytes.end(), block.begin() );
+            } else if ( auto inflated = lz4_decompress_block( sealed.bytes, block ); !inflated ) {
+                // only ever our own output, this is memory gone bad
+                throw std::runtime_error( inflated.error() );
+            }
+            into = into.subspan( sealed.size );
+        }
+    }
+
+    void tcp_reassembler::unseal() const {
+
+        if ( m_sealed.empty() ) return;
+
+        std::vector<uint8_t> data( m_sealed_size + m_data.size() );
+        inflate( data );
+        std::copy( m_data.begin(), m_data.end(), data.begin() + m_sealed_size );
+
+        m_data = std::move( data );
+        m_sealed.clear();
+        m_sealed_size = 0;
+        m_sealed_stored = 0;
+    }
+
+    std::span<const uint8_t> tcp_reassembler::contiguous() const {
+        unseal();
+        std::span<const uint8_t> data( m_data );
+        if ( m_keep_last && data.size() > m_keep_last ) return data.last( m_keep_last );
+        return data;
+    }
+
+    std::span<const uint8_t> tcp_reassembler::recent( size_t bytes ) const {
+        std::span<const uint8_t> data( m_data );
+        if ( m_keep_last && data.size() > m_keep_last ) data = data.last( m_keep_last );
+        return data.last( std::min( bytes, data.size() ) );
+    }
+
+    size_t tcp_reassembler::size() const {
+        return m_sealed_size + ( m_keep_last ? std::min( m_data.size(), m_keep_last ) : m_data.size() );
+    }
+
+    size_t tcp_reassembler::stored_bytes() const {
+        return m_sealed_stored + ( m_keep_last ? std::min( m_data.size(), m_keep_last ) : m_data.size() );
+    }
+
+    void tcp_reassembler::release() {
+        std::vector<uint8_t>().swap( m_data );
+        std::vector<sealed_block>().swap( m_sealed );
+        m_sealed_size = 0;
+        m_sealed_stored = 0;
+    }
+
+    uint32_t tcp_reassembler::next_seq() const {
+        return m_next_seq;
+    }
+
+    void tcp_reassembler::keep_first( size_t bytes ) {
+
+        m_keep_first = bytes;
+        if ( !m_started ) return;
+
+        // already past the end, e.g. set once a classifier has decided
+        uint32_t end = m_initial_seq + static_cast<uint32_t>( bytes );
+        if ( seq_before( end, m_next_seq ) ) {
+            unseal();
+            m_data.resize( m_data.size() - std::min<size_t>( m_data.size(), m_next_seq - end ) );
+            m_next_seq = end;
+        }
+
+        std::erase_if( m_pending, [&]( const segment& s ) {
+            if ( seq_before( s.seq, end ) ) return false;
+            m_pending_bytes -= s.data.size();
+            return true;
+        });
+    }
+
+    void tcp_reassembler::keep_last( size_t bytes ) {
+        m_keep_last = bytes;
+        unseal();
+        if ( m_data.size() > bytes ) m_data.erase( m_data.begin(), m_data.end() - bytes );
+    }
+
+    void tcp_reassembler::compress( size_t block_size ) {
+        m_block_size = block_size;
+        if ( block_size == 0 ) unseal();
+    }
+
+    size_t tcp_reassembler::pending_segments() const {
+        return m_pending.size();
+    }
+
+    size_t tcp_reassembler::pending_bytes() const {
+        return m_pending_bytes;
+    }
+
+    void tcp_reassembler::save( snapshot_writer& out ) const {
+
+        out.write( m_initial_seq );
+        out.write( m_next_seq );
+        out.write( m_started );
+        out.write( static_cast<uint64_t>( m_keep_first ) );
+        out.write( static_cast<uint64_t>( m_keep_last ) );
+
+        // written inflated, the restored stream seals it again as it grows
+        if ( m_sealed.empty() ) {
+            out.write_bytes( m_data );
+        } else {
+            std::vector<uint8_t> data( m_sealed_size + m_data.size() );
+            inflate( data );
+            std::copy( m_data.begin(), m_data.end(), data.begin() + m_sealed_size );
+            out.write_bytes( data );
+        }
+
+        out.write( static_cast<uint64_t>( m_pending.size() ) );
+        for ( auto& s : m_pending ) {
+            out.write( s.seq );
+            out.write_bytes( s.data );
+        }
+    }
+
+    bool tcp_reassembler::restore( snapshot_reader& in ) {
+
+        uint64_t keep_first = 0, keep_last = 0, pending = 0;
+
+        in.read( m_initial_seq );
+        in.read( m_next_seq );
+        in.read( m_started );
+        in.read( keep_first );
+        in.read( keep_last );
+        in.read_bytes( m_data );
+        m_sealed.clear();
+        m_sealed_size = 0;
+        m_sealed_stored = 0;
+        if ( !in.read( pending ) || pending > max_pending_segments ) return false;
+
+        m_keep_first = keep_first;
+        m_keep_last = keep_last;
+
+        m_pending.clear();
+        m_pending_bytes = 0;
+        for ( uint64_t i = 0; i < pending; ++i ) {
+            segment s;
+            if ( !in.read( s.seq ) || !in.read_bytes( s.data ) ) return false;
+            m_pending_bytes += s.data.size();
+            m_pending.push_back( std::move( s ) );
+        }
+
+        return !in.failed();
+    }
+
+} // namespace ntk
@@ -0,0 +1,113 @@
+#include <tcp_replay.hpp>
+
+#include <deque>
+
+#include <capture_file.hpp>
+#include <link_layer.hpp>
+
+namespace ntk {
+
+    namespace {
+
+        // keeps what the session offloads, or only the one flow asked for
+        class collecting_queue : public transfer_queue_interface<tcp_live_stream> {
+
+            public:
+                collecting_queue( std::optional<flow_key> only = std::nullopt )
+                    : m_only( only ) {}
+
+                void push( const tcp_live_stream& stream ) override {
+                    if ( wanted( stream ) ) m_streams.push_back( stream );
+                }
+
+                void push( tcp_live_stream&& stream ) override {
+                    if ( wanted( stream ) ) m_streams.push_back( std::move( stream ) );
+                }
+
+                std::optional<tcp_live_stream> pop_for( std::chrono::milliseconds ) override {
+                    return try_pop();
+                }
+
+                std::optional<tcp_live_stream> try_pop() override {
+                    if ( m_streams.empty() ) return std::nullopt;
+                    tcp_live_stream stream = std::move( m_streams.front() );
+                    m_streams.pop_front();
+                    return stream;
+                }
+
+                std::vector<tcp_live_stream> take() {
+                    return std::vector<tcp_live_stream>( std::make_move_iterator( m_streams.begin() ), std::make_move_iterator( m_streams.end() ) );
+                }
+            private:
+                bool wanted( const tcp_live_stream& stream ) const {
+                    return !m_only || flow_key( stream.get_four_tuple() ) == *m_only;
+                }
+
+                std::optional<flow_key> m_only;
+                std::deque<tcp_live_stream> m_streams;
+        };
+
+    } // namespace
+
+    std::vector<tcp_live_stream> replay_streams( const session& packets, const session_limits& limits ) {
+
+        collecting_queue offloaded;
+
+        {
+            tcp_live_stream_session replay( &offloaded, limits );
+            for ( auto& packet : packets ) replay.feed( packet );
+            replay.flush();
+        }
+
+        return offloaded.take();
+    }
+
+    std::expected<std::vector<tcp_live_stream>,std::string> replay_streams( const std::string& filename, const session_limits& limits ) {
+
+        capture_file file( filename );
+        if ( !file.is_open() ) return std::unexpected( "Failed to open capture: " + filename );
+
+        session_limits file_limits = limits;
+
+        // HEX captures have neither a link type nor timestamps, their frames go in as they are
+        bool timestamped = file.format() != capture_format::HEX;
+        if ( timestamped ) {
+            auto link = to_link_type( file.datalink() );
+            if ( !link ) return std::unexpected( "unsupported link type " + std::to_string( file.datalink() ) + " in " + filename );
+            file_limits.link = *link;
+        }
+
+        collecting_queue offloaded;
+
+        {
+            tcp_live_stream_session replay( &offloaded, file_limits );
+
+            for ( auto it = file.begin(); it != file.end(); ++it ) {
+                if ( timestamped ) {
+                    auto& record = it.record();
+                    replay.feed( make_captured_packet( record.ts_sec, record.ts_usec, record.len, record.data ) );
+                } else {
+                    replay.feed( *it );
+                }
+            }
+
+            replay.flush();
+        }
+
+        return offloaded.take();
+    }
+
+    std::optional<tcp_live_stream> replay_stream( const four_tuple& four, const session& packets, const session_limits& limits ) {
+
+        collecting_queue offloaded{ flow_key( four ) };
+
+        {
+            tcp_live_stream_session replay( &offloaded, limits );
+            for ( auto& packet : packets ) replay.feed( packet );
+            replay.flush();
+        }
+
+        return offloaded.try_pop();
+    }
+
+} // namespace ntk
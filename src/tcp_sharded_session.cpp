@@ -0,0 +1,206 @@
+#include <tcp_sharded_session.hpp>
+
+#include <array>
+#include <stdexcept>
+
+namespace ntk {
+
+    size_t symmetric_flow_hash( const four_tuple& four ) {
+        return flow_key_hash{}( flow_key( four ) );
+    }
+
+    tcp_sharded_session::shard::shard( transfer_queue_interface<tcp_live_stream>* offload_queue, const session_limits& limits )
+        : session( offload_queue, limits ) {}
+
+    tcp_sharded_session::tcp_sharded_session( size_t n_shards )
+        : tcp_sharded_session( n_shards, nullptr ) {}
+
+    tcp_sharded_session::tcp_sharded_session( size_t n_shards, transfer_queue_interface<tcp_live_stream>* offload_queue,
+                                              shard_hash hash )
+        : tcp_sharded_session( n_shards, offload_queue, session_limits{}, hash ) {}
+
+    tcp_sharded_session::tcp_sharded_session( size_t n_shards, transfer_queue_interface<tcp_live_stream>* offload_queue,
+                                              const session_limits& limits, shard_hash hash )
+        : m_hash( hash ), m_toeplitz( symmetric_rss_key ), m_link( link_layer_of( limits.link ) ), m_fragments( limits.fragments ), m_stop( false ) {
+
+        if ( n_shards == 0 ) {
+            throw std::runtime_error( "tcp_sharded_session needs at least one shard" );
+        }
+
+        m_shards.reserve( n_shards );
+        for ( size_t i = 0; i < n_shards; ++i ) {
+            m_shards.push_back( std::make_unique<shard>( offload_queue, limits ) );
+        }
+
+        // start the workers only once every shard exists
+        for ( auto& s : m_shards ) {
+            s->worker = std::thread( &tcp_sharded_session::run_shard, this, std::ref( *s ) );
+        }
+    }
+
+    tcp_sharded_session::~tcp_sharded_session() {
+        stop();
+    }
+
+    void tcp_sharded_session::feed( const std::vector<uint8_t>& packet ) {
+        if ( auto shard_index = route( packet, std::nullopt ) ) dispatch( *shard_index, shard_packet( packet ) );
+    }
+
+    void tcp_sharded_session::feed( const packet_view& packet ) {
+        if ( auto shard_index = route( packet.bytes(), std::nullopt ) ) dispatch( *shard_index, shard_packet( packet ) );
+    }
+
+    void tcp_sharded_session::feed( captured_packet packet ) {
+        if ( auto shard_index = route( packet.bytes, packet.timestamp ) ) dispatch( *shard_index, shard_packet( std::move( packet ) ) );
+    }
+
+    std::optional<size_t> tcp_sharded_session::route( std::span<const uint8_t> frame, std::optional<capture_time> now ) {
+
+        // decoded like the shard will, so both directions of a flow hash the same whatever the link
+        if ( auto decoded = m_link.decode( frame ) ) return shard_of( decoded->four() );
+
+        auto network = m_link.network( frame );
+        if ( network && is_ipv4_fragment( frame, network->offset ) ) {
+            reassemble( frame, now, network->offset );
+            return std::nullopt;
+        }
+
+        // belongs to no flow, any shard counts it as unmatched the same
+        return 0;
+    }
+
+    void tcp_sharded_session::reassemble( std::span<const uint8_t> frame, std::optional<capture_time> now, size_t ip_offset ) {
+
+        if ( m_fragments.feed( frame, now, ip_offset ) != fragment_result::COMPLETE ) return;
+
+        auto datagram = m_fragments.datagram();
+        if ( now ) {
+            feed( make_captured_packet( *now, datagram ) );
+        } else {
+            feed( std::vector<uint8_t>( datagram.begin(), datagram.end() ) );
+        }
+    }
+
+    void tcp_sharded_session::dispatch( size_t shard_index, shard_packet&& packet ) {
+        auto& ring = m_shards[ shard_index ]->ring;
+        // lossless, a full ring holds the producer back until its worker catches up
+        while ( !ring.push( std::move( packet ) ) ) {
+            std::this_thread::yield();
+        }
+    }
+
+    void tcp_sharded_session::run_shard( shard& s ) {
+
+        std::array<shard_packet,32> batch;
+
+        while ( true ) {
+
+            size_t n = s.ring.pop_bulk( batch );
+
+            if ( n == 0 ) {
+                // the stop flag is published after the last push, so an empty ring here is final
+                if ( m_stop.load( std::memory_order_acquire ) && s.ring.empty() ) break;
+                std::this_thread::yield();
+                continue;
+            }
+
+            for ( size_t i = 0; i < n; ++i ) {
+                std::visit( [&]( const auto& packet ) { s.session.feed( packet ); }, batch[ i ] );
+                // drop the reference so pooled slots go back as soon as the session is done with them
+                batch[ i ] = shard_packet{};
+            }
+        }
+    }
+
+    void tcp_sharded_session::stop() {
+        m_stop.store( true, std::memory_order_release );
+        for ( auto& s : m_shards ) {
+            if ( s->worker.joinable() ) s->worker.join();
+        }
+    }
+
+    size_t tcp_sharded_session::flush() {
+        stop();
+        // the workers are gone, so the shards' sessions are safe to touch from here
+        size_t flushed = 0;
+        for ( auto& s : m_shards ) flushed += s->session.flush();
+        return flushed;
+    }
+
+    size_t tcp_sharded_session::number_of_shards() const {
+        return m_shards.size();
+    }
+
+    link_type tcp_sharded_session::link() const {
+        return m_link.type;
+    }
+
+    size_t tcp_sharded_session::shard_of( const four_tuple& four ) const {
+        if ( m_hash == shard_hash::TOEPLITZ ) {
+            return toeplitz_hasher::queue_of( m_toeplitz( four ), m_shards.size() );
+        }
+        return symmetric_flow_hash( four ) % m_shards.size();
+    }
+
+    size_t tcp_sharded_session::number_of_completed_transfers() {
+        size_t n_completed = 0;
+        for ( auto& s : m_shards ) {
+            n_completed += s->session.number_of_completed_transfers();
+        }
+        return n_completed;
+    }
+
+    session_statistics tcp_sharded_session::statistics() const {
+        session_statistics total{ 0, 0, 0, 0, 0, 0, 0 };
+        for ( auto& s : m_shards ) {
+            auto shard_statistics = s->session.statistics();
+            total.packets_fed += shard_statistics.packets_fed;
+            total.packets_unmatched += shard_statistics.packets_unmatched;
+            total.streams_offloaded += shard_statistics.streams_offloaded;
+            total.streams_evicted += shard_statistics.streams_evicted;
+            total.bytes_in_memory += shard_statistics.bytes_in_memory;
+            total.bytes_spilled += shard_statistics.bytes_spilled;
+            total.streams_dropped += shard_statistics.streams_dropped;
+        }
+        return total;
+    }
+
+    fragment_statistics tcp_sharded_session::fragments() const {
+        return m_fragments.statistics();
+    }
+
+    void tcp_sharded_session::set_classifier( const flow_classifier& classifier ) {
+        for ( auto& s : m_shards ) s->session.set_classifier( classifier );
+    }
+
+    void tcp_sharded_session::place_workers( const std::vector<thread_placement>& placements ) {
+
+        if ( placements.empty() ) return;
+
+        for ( size_t i = 0; i < m_shards.size(); ++i ) {
+            auto& placement = placements[ i % placements.size() ];
+            apply_placement( m_shards[ i ]->worker, placement );
+            // the ring is most of a shard, and both sides of it run on this node from now on
+            if ( placement.numa_node >= 0 ) bind_memory_to_node( m_shards[ i ].get(), sizeof( shard ), placement.numa_node );
+        }
+    }
+
+    void tcp_sharded_session::instrument( metrics_registry& registry ) {
+        for ( size_t i = 0; i < m_shards.size(); ++i ) {
+            std::string label = "shard=\"" + std::to_string( i ) + "\"";
+            m_shards[ i ]->session.instrument( registry, label );
+            registry.add_gauge( "ntk_shard_ring_occupancy{" + label + "}", "Frames waiting in a shard's ring.", [ &ring = m_shards[ i ]->ring ] {
+                return static_cast<int64_t>( ring.size() );
+            });
+        }
+    }
+
+    ring_statistics tcp_sharded_session::shard_ring_statistics( size_t shard_index ) const {
+        return m_shards.at( shard_index )->ring.statistics();
+    }
+
+    const tcp_live_stream_session& tcp_sharded_session_friend_helper::shard_session( const tcp_sharded_session& t, size_t shard_index ) {
+        return t.m_shards.at( shard_index )->session;
+    }
+
+} // namespace ntk
@@ -0,0 +1,341 @@
+#include <tcp.hpp>
+
+#include <cstdio>
+#include <fstream>
+
+namespace ntk {
+
+    namespace {
+
+        constexpr std::array<char,8> snapshot_magic = { 'N', 'T', 'K', 'S', 'N', 'A', 'P', '\0' };
+        constexpr uint32_t snapshot_version = 2;
+        constexpr uint32_t byte_order_mark = 0x01020304;
+
+        static_assert( std::is_trivially_copyable_v<four_tuple> );
+        static_assert( std::is_trivially_copyable_v<flow_key> );
+        static_assert( std::is_trivially_copyable_v<stream_timing> );
+        static_assert( std::is_trivially_copyable_v<std::optional<capture_time>> );
+        static_assert( std::is_trivially_copyable_v<retention_policy> );
+
+        void save_handshake( snapshot_writer& out, const tcp_handshake_feed& feed ) {
+            out.write( feed.m_four );
+            out.write_bytes( feed.m_handshake.syn );
+            out.write_bytes( feed.m_handshake.syn_ack );
+            out.write_bytes( feed.m_handshake.ack );
+            out.write( feed.m_complete );
+            out.write_optional_bytes( feed.m_syn );
+            out.write_optional_bytes( feed.m_syn_ack );
+            out.write_optional_bytes( feed.m_ack );
+            out.write( feed.m_syn_seq_number );
+            out.write( feed.m_syn_ack_seq_number );
+            out.write( feed.m_syn_four );
+        }
+
+        bool restore_handshake( snapshot_reader& in, tcp_handshake_feed& feed ) {
+            in.read( feed.m_four );
+            in.read_bytes( feed.m_handshake.syn );
+            in.read_bytes( feed.m_handshake.syn_ack );
+            in.read_bytes( feed.m_handshake.ack );
+            in.read( feed.m_complete );
+            in.read_optional_bytes( feed.m_syn );
+            in.read_optional_bytes( feed.m_syn_ack );
+            in.read_optional_bytes( feed.m_ack );
+            in.read( feed.m_syn_seq_number );
+            in.read( feed.m_syn_ack_seq_number );
+            in.read( feed.m_syn_four );
+            return !in.failed();
+        }
+
+        void save_termination( snapshot_writer& out, const tcp_termination_feed& feed ) {
+
+            out.write( feed.m_four );
+            out.write( feed.m_complete );
+
+            auto& closing = feed.m_termination.closing_sequence;
+            out.write( static_cast<uint8_t>( closing.index() ) );
+            if ( auto* sequence = std::get_if<fin_ack_fin_ack>( &closing ) ) {
+                for ( auto& frame : *sequence ) out.write_bytes( frame );
+            } else {
+                out.write_bytes( std::get<rst>( closing ) );
+            }
+
+            out.write_optional_bytes( feed.m_fin_1 );
+            out.write_optional_bytes( feed.m_ack_1 );
+            out.write_optional_bytes( feed.m_fin_2 );
+            out.write_optional_bytes( feed.m_ack_2 );
+            out.write( feed.m_fin_1_seq_number );
+            out.write( feed.m_fin_2_seq_number );
+        }
+
+        bool restore_termination( snapshot_reader& in, tcp_termination_feed& feed ) {
+
+            in.read( feed.m_four );
+            in.read( feed.m_complete );
+
+            uint8_t index = 0;
+            if ( !in.read( index ) ) return false;
+            if ( index == 0 ) {
+                fin_ack_fin_ack sequence;
+                for ( auto& frame : sequence ) in.read_bytes( frame );
+                feed.m_termination.closing_sequence = std::move( sequence );
+            } else if ( index == 1 ) {
+                rst frame;
+                in.read_bytes( frame );
+                feed.m_termination.closing_sequence = std::move( frame );
+            } else {
+                return false;
+            }
+
+            in.read_optional_bytes( feed.m_fin_1 );
+            in.read_optional_bytes( feed.m_ack_1 );
+            in.read_optional_bytes( feed.m_fin_2 );
+            in.read_optional_bytes( feed.m_ack_2 );
+            in.read( feed.m_fin_1_seq_number );
+            in.read( feed.m_fin_2_seq_number );
+            return !in.failed();
+        }
+
+    } // namespace
+
+    void tcp_live_stream::save( snapshot_writer& out ) const {
+
+        // first, the session reads it to make the stream before restoring the rest
+        out.write( m_four );
+
+        save_handshake( out, m_handshake_feed );
+        save_termination( out, m_termination_feed );
+
+        out.write( m_timing );
+        m_metrics.save( out );
+        out.write( m_eviction );
+
+        m_client_reassembler.save( out );
+        m_server_reassembler.save( out );
+
+        out.write( m_frames_truncated );
+        out.write( m_payload_truncated );
+        out.write( m_store_frames );
+        out.write( m_classified );
+        out.write( m_headers_only );
+        out.write( m_retention );
+        out.write( static_cast<uint64_t>( m_client_frame_bytes ) );
+        out.write( static_cast<uint64_t>( m_server_frame_bytes ) );
+        out.write( m_delivery.direction );
+        out.write( static_cast<uint64_t>( m_delivery.bytes ) );
+
+        // spilled frames come ahead of the ones in memory, pooled frames are stored like any other
+        uint64_t spilled = m_spill ? m_spill->frame_count() : 0;
+        out.write( spilled );
+        std::vector<uint8_t> frame;
+        for ( size_t i = 0; i < spilled; ++i ) {
+            if ( !m_spill->read( i, frame ) ) frame.clear();
+            out.write_bytes( frame );
+        }
+
+        out.write( static_cast<uint64_t>( m_traffic.size() + m_pooled_traffic.size() ) );
+        // written inflated without unsealing them for good, the restored stream seals them again
+        m_traffic.for_each( [&]( std::span<const uint8_t> traffic ) { out.write_bytes( traffic ); } );
+        for ( auto& pooled : m_pooled_traffic ) out.write_bytes( pooled.bytes() );
+    }
+
+    bool tcp_live_stream::restore( snapshot_reader& in, const std::filesystem::path& spill_directory ) {
+
+        if ( !restore_handshake( in, m_handshake_feed ) ) return false;
+        if ( !restore_termination( in, m_termination_feed ) ) return false;
+
+        in.read( m_timing );
+        if ( !m_metrics.restore( in ) ) return false;
+        in.read( m_eviction );
+
+        if ( !m_client_reassembler.restore( in ) ) return false;
+        if ( !m_server_reassembler.restore( in ) ) return false;
+
+        uint64_t client_frame_bytes = 0, server_frame_bytes = 0, delivered = 0;
+
+        in.read( m_frames_truncated );
+        in.read( m_payload_truncated );
+        in.read( m_store_frames );
+        in.read( m_classified );
+        in.read( m_headers_only );
+        in.read( m_retention );
+        in.read( client_frame_bytes );
+        in.read( server_frame_bytes );
+        in.read( m_delivery.direction );
+        in.read( delivered );
+
+        m_client_frame_bytes = client_frame_bytes;
+        m_server_frame_bytes = server_frame_bytes;
+        m_delivery.bytes = delivered;
+
+        uint64_t spilled = 0;
+        if ( !in.read( spilled ) ) return false;
+
+        if ( spilled > 0 ) {
+            auto file = std::make_shared<spill_file>( spill_directory );
+            if ( file->is_open() ) m_spill = std::move( file );
+        }
+
+        for ( uint64_t i = 0; i < spilled; ++i ) {
+            auto frame = in.read_bytes();
+            if ( !frame ) return false;
+            if ( m_spill && m_spill->append( *frame ) ) continue;
+            m_traffic.push_back( *frame );
+        }
+
+        uint64_t frames = 0;
+        if ( !in.read( frames ) ) return false;
+
+        for ( uint64_t i = 0; i < frames; ++i ) {
+            auto frame = in.read_bytes();
+            if ( !frame ) return false;
+            m_traffic.push_back( *frame );
+        }
+
+        return !in.failed();
+    }
+
+    std::expected<size_t,std::string> tcp_live_stream_session::checkpoint( const std::string& filename ) const {
+
+        // written beside the final name and moved over it, a restart never finds half a snapshot
+        std::string partial = filename + ".partial";
+
+        {
+            std::ofstream file( partial, std::ios::binary | std::ios::trunc );
+            if ( !file.is_open() ) return std::unexpected( "Failed to open snapshot: " + partial );
+
+            snapshot_writer out( file );
+
+            out.write( snapshot_magic );
+            out.write( snapshot_version );
+            out.write( byte_order_mark );
+
+            out.write( m_packets_fed.value() );
+            out.write( m_packets_unmatched.value() );
+            out.write( m_streams_offloaded.value() );
+            out.write( m_streams_evicted.value() );
+            out.write( m_streams_dropped.value() );
+            out.write( m_bytes_spilled.value() );
+
+            // oldest first, so they give way in the same order after a restore
+            out.write( static_cast<uint64_t>( m_tombstones.size() ) );
+            for ( auto& [ key, placed ] : m_tombstone_order ) {
+                auto dropped = m_tombstones.find( key );
+                if ( dropped == m_tombstones.end() || dropped->second.placed != placed ) continue;
+                out.write( key );
+                out.write( dropped->second.expires );
+            }
+
+            out.write( static_cast<uint64_t>( m_live_streams.size() ) );
+            for ( auto& stream : m_live_streams ) stream.save( out );
+
+            if ( !out.good() ) {
+                file.close();
+                std::remove( partial.c_str() );
+                return std::unexpected( "Failed to write snapshot: " + partial );
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename( partial, filename, ec );
+        if ( ec ) return std::unexpected( "Failed to move snapshot into place: " + ec.message() );
+
+        return m_live_streams.size();
+    }
+
+    std::expected<size_t,std::string> tcp_live_stream_session::restore( const std::string& filename ) {
+
+        if ( !m_live_streams.empty() || !m_tombstones.empty() ) return std::unexpected( "the session has been fed already" );
+
+        snapshot_file file( filename );
+        if ( !file.is_open() ) return std::unexpected( "Failed to open snapshot: " + filename );
+
+        snapshot_reader in( file.bytes() );
+
+        std::array<char,8> magic{};
+        uint32_t version = 0, byte_order = 0;
+        in.read( magic );
+        in.read( version );
+        in.read( byte_order );
+
+        if ( magic != snapshot_magic ) return std::unexpected( "not a session snapshot" );
+        if ( byte_order != byte_order_mark ) return std::unexpected( "snapshot was written with another byte order" );
+        if ( version != snapshot_version ) return std::unexpected( "snapshot version " + std::to_string( version ) + " is not supported" );
+
+        uint64_t packets_fed = 0, packets_unmatched = 0, streams_offloaded = 0, streams_evicted = 0, streams_dropped = 0, bytes_spilled = 0;
+        in.read( packets_fed );
+        in.read( packets_unmatched );
+        in.read( streams_offloaded );
+        in.read( streams_evicted );
+        in.read( streams_dropped );
+        in.read( bytes_spilled );
+
+        // nothing is kept from a snapshot that turns out to be cut short
+        auto fail = [&]() -> std::unexpected<std::string> {
+            m_live_streams = flow_table<flow_key,tcp_live_stream,flow_key_hash>();
+            m_tombstones.clear();
+            m_tombstone_order.clear();
+            m_expiry_timers = timer_wheel<flow_key>();
+            m_bytes_in_memory = 0;
+            m_bytes_in_memory_gauge.set( 0 );
+            return std::unexpected<std::string>( "snapshot is truncated or corrupt" );
+        };
+
+        uint64_t dropped = 0;
+        if ( !in.read( dropped ) || dropped > file.bytes().size() / sizeof( flow_key ) ) return fail();
+
+        m_tombstones.reserve( dropped );
+        for ( uint64_t i = 0; i < dropped; ++i ) {
+            flow_key key;
+            tombstone restored;
+            if ( !in.read( key ) || !in.read( restored.expires ) || m_tombstones.contains( key ) ) return fail();
+            restored.placed = ++m_tombstones_placed;
+            m_tombstones.emplace( key, restored );
+            m_tombstone_order.emplace_back( key, restored.placed );
+        }
+
+        uint64_t streams = 0;
+        if ( !in.read( streams ) || streams > file.bytes().size() / sizeof( four_tuple ) ) return fail();
+
+        m_live_streams.reserve( streams );
+        auto upstream = m_limits.frame_upstream ? m_limits.frame_upstream : std::pmr::get_default_resource();
+
+        for ( uint64_t i = 0; i < streams; ++i ) {
+
+            four_tuple four;
+            if ( !in.read( four ) ) return fail();
+
+            flow_key key( four );
+            if ( m_tombstones.contains( key ) || m_live_streams.contains( key ) ) return fail();
+
+            auto& stream = m_live_streams.emplace( key, four, upstream );
+            if ( !stream.restore( in, spill_directory() ) ) return fail();
+            // a setting of the session, not of the snapshot
+            if ( m_limits.compress_payload ) stream.compress_payload();
+
+            m_bytes_in_memory += stream.memory().in_memory();
+        }
+
+        m_bytes_in_memory_gauge.set( m_bytes_in_memory );
+
+        m_packets_fed.add( packets_fed );
+        m_packets_unmatched.add( packets_unmatched );
+        m_streams_offloaded.add( streams_offloaded );
+        m_streams_evicted.add( streams_evicted );
+        m_streams_dropped.add( streams_dropped );
+        m_bytes_spilled.add( bytes_spilled );
+
+        for ( auto& [ key, restored ] : m_tombstones ) {
+            if ( restored.expires ) m_expiry_timers.schedule( key, *restored.expires );
+        }
+
+        for ( auto& stream : m_live_streams ) {
+            flow_key key( stream.get_four_tuple() );
+            schedule_expiry( key, stream );
+            // a new consumer has not heard of the stream, it is told before the next on_data
+            if ( m_events && stream.m_classified ) m_events->on_open( stream.get_four_tuple() );
+        }
+
+        return m_live_streams.size();
+    }
+
+} // namespace ntk
@@ -0,0 +1,156 @@
+#include <thread_placement.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace ntk {
+
+    namespace {
+
+        std::optional<std::string> read_line( const std::string& path ) {
+            std::ifstream file( path );
+            std::string line;
+            if ( !file.is_open() || !std::getline( file, line ) ) return std::nullopt;
+            return line;
+        }
+
+#ifdef __linux__
+        bool set_affinity( pthread_t thread, const std::vector<unsigned>& cpus ) {
+
+            if ( cpus.empty() ) return true;
+
+            cpu_set_t set;
+            CPU_ZERO( &set );
+            for ( unsigned cpu : cpus ) {
+                if ( cpu < CPU_SETSIZE ) CPU_SET( cpu, &set );
+            }
+
+            int error = pthread_setaffinity_np( thread, sizeof( set ), &set );
+            if ( error != 0 ) {
+                std::cerr << "Failed to set thread affinity: " << error << '\n';
+                return false;
+            }
+
+            return true;
+        }
+#endif
+
+    } // namespace
+
+    thread_placement thread_placement::on_cpus( std::vector<unsigned> cpus ) {
+        return thread_placement{ std::move( cpus ), -1 };
+    }
+
+    thread_placement thread_placement::on_node( int node ) {
+        return thread_placement{ cpus_of_numa_node( node ), node };
+    }
+
+    thread_placement thread_placement::near_device( const std::string& device ) {
+        auto node = numa_node_of_device( device );
+        if ( !node ) return thread_placement{};
+        return on_node( *node );
+    }
+
+    std::vector<unsigned> parse_cpu_list( const std::string& list ) {
+
+        std::vector<unsigned> cpus;
+        std::stringstream ranges( list );
+        std::string range;
+
+        while ( std::getline( ranges, range, ',' ) ) {
+            if ( range.empty() ) continue;
+            try {
+                auto dash = range.find( '-' );
+                unsigned first = std::stoul( range.substr( 0, dash ) );
+                unsigned last = dash == std::string::npos ? first : std::stoul( range.substr( dash + 1 ) );
+                for ( unsigned cpu = first; cpu <= last; ++cpu ) cpus.push_back( cpu );
+            } catch ( const std::exception& ) {
+                std::cerr << "Malformed cpu list: " << list << '\n';
+                return {};
+            }
+        }
+
+        return cpus;
+    }
+
+    std::optional<int> numa_node_of_device( const std::string& device ) {
+        auto line = read_line( "/sys/class/net/" + device + "/device/numa_node" );
+        if ( !line ) return std::nullopt;
+        try {
+            int node = std::stoi( *line );
+            // -1 is how single node systems and virtual devices say they have no node
+            if ( node < 0 ) return std::nullopt;
+            return node;
+        } catch ( const std::exception& ) {
+            return std::nullopt;
+        }
+    }
+
+    std::vector<unsigned> cpus_of_numa_node( int node ) {
+        if ( node < 0 ) return {};
+        auto line = read_line( "/sys/devices/system/node/node" + std::to_string( node ) + "/cpulist" );
+        if ( !line ) return {};
+        return parse_cpu_list( *line );
+    }
+
+#ifdef __linux__
+
+    bool apply_placement( const thread_placement& placement ) {
+        return set_affinity( pthread_self(), placement.cpus );
+    }
+
+    bool apply_placement( std::thread& thread, const thread_placement& placement ) {
+        if ( !thread.joinable() ) return false;
+        return set_affinity( thread.native_handle(), placement.cpus );
+    }
+
+    bool bind_memory_to_node( const void* address, size_t size, int node, bool move ) {
+
+        if ( node < 0 || size == 0 ) return true;
+
+        constexpr size_t bits_per_word = sizeof( unsigned long ) * 8;
+        std::vector<unsigned long> mask( static_cast<size_t>( node ) / bits_per_word + 1, 0 );
+        mask[ node / bits_per_word ] |= 1ul << ( node % bits_per_word );
+
+        // the policy covers whole pages, so the range is widened to the pages it touches
+        uintptr_t page = static_cast<uintptr_t>( sysconf( _SC_PAGESIZE ) );
+        uintptr_t start = reinterpret_cast<uintptr_t>( address ) & ~( page - 1 );
+        uintptr_t end = reinterpret_cast<uintptr_t>( address ) + size;
+
+        long result = syscall( SYS_mbind, start, end - start, MPOL_PREFERRED, mask.data(), mask.size() * bits_per_word + 1,
+                               move ? MPOL_MF_MOVE : 0 );
+        if ( result != 0 ) {
+            std::cerr << "Failed to bind memory to NUMA node " << node << '\n';
+            return false;
+        }
+
+        return true;
+    }
+
+#else
+
+    bool apply_placement( const thread_placement& placement ) {
+        if ( !placement.cpus.empty() ) std::cerr << "Thread affinity is not supported on this platform\n";
+        return placement.cpus.empty();
+    }
+
+    bool apply_placement( std::thread& thread, const thread_placement& placement ) {
+        return apply_placement( placement );
+    }
+
+    bool bind_memory_to_node( const void* address, size_t size, int node, bool move ) {
+        return node < 0;
+    }
+
+#endif
+
+} // namespace ntk
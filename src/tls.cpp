@@ -1,4 +1,7 @@
 #include <tls.hpp>
+#include <tls_decryptor.hpp>
+#include <decoded_packet.hpp>
+#include <payload_classifier.hpp>
 
 namespace ntk {
 
@@ -233,6 +236,15 @@ namespace ntk {
         return session_keys.at( client_hex ).at( label );
     }
 
+    std::vector<uint8_t> get_traffic_secret( const key_log_store& key_log,
+                                             const std::array<uint8_t,32>& client_random,
+                                             secret_label label ) {
+
+        auto secret = key_log.find( client_random, label );
+        if ( !secret ) throw std::out_of_range( std::string( "No " ) + secret_label_name( label ) + " for client random" );
+        return std::move( *secret );
+    }
+
     std::vector<uint8_t> build_tls13_nonce( const std::vector<uint8_t>& base_iv, uint64_t seq_num ) {
         std::vector<uint8_t> nonce = base_iv;
         for ( int i = 0; i < 8; ++i ) {
@@ -289,20 +301,51 @@ namespace ntk {
         return km;
     }
 
+    std::vector<uint8_t> next_traffic_secret( uint16_t cipher_suite_id, const std::vector<uint8_t>& secret ) {
+
+        const EVP_MD* hash_func = nullptr;
+
+        switch ( static_cast<cipher_suite>( cipher_suite_id ) ) {
+            case cipher_suite::TLS_AES_128_GCM_SHA256:
+                hash_func = EVP_sha256();
+                break;
+            case cipher_suite::TLS_AES_256_GCM_SHA384:
+                hash_func = EVP_sha384();
+                break;
+            default:
+                throw std::runtime_error( "Unsupported cipher suite" );
+        }
+
+        return hkdf_expand_label( secret, "traffic upd", {}, EVP_MD_get_size( hash_func ), hash_func );
+    }
+
     std::vector<uint8_t> decrypt_aes_gcm( const std::vector<uint8_t>& key,
                                           const std::vector<uint8_t>& nonce,
                                           const std::vector<uint8_t>& aad,
                                           const std::vector<uint8_t>& cipher_text_with_tag,
                                           const EVP_CIPHER* cipher ) {
-        
+        auto plain_text = try_decrypt_aes_gcm( key, nonce, aad, cipher_text_with_tag, cipher );
+        if ( !plain_text ) throw std::runtime_error( plain_text.error() );
+        return std::move( *plain_text );
+    }
+
+    std::expected<std::vector<uint8_t>,std::string> try_decrypt_aes_gcm( std::span<const uint8_t> key,
+                                                                        std::span<const uint8_t> nonce,
+                                                                        std::span<const uint8_t> aad,
+                                                                        std::span<const uint8_t> cipher_text_with_tag,
+                                                                        const EVP_CIPHER* cipher ) {
+
+        if ( cipher_text_with_tag.size() < 16 ) return std::unexpected( "GCM cipher text shorter than its tag" );
+
         size_t cipher_len = cipher_text_with_tag.size() - 16;
 
-        const uint8_t* tag = &cipher_text_with_tag[ cipher_len ];
-        const uint8_t* cipher_text = &cipher_text_with_tag[ 0 ];
+        const uint8_t* tag = cipher_text_with_tag.data() + cipher_len;
+        const uint8_t* cipher_text = cipher_text_with_tag.data();
     
         std::vector<uint8_t> plain_text( cipher_len );
 
         EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+        if ( !ctx ) return std::unexpected( "EVP_CIPHER_CTX_new failed" );
 
         EVP_DecryptInit_ex( ctx, cipher, nullptr, nullptr, nullptr );
         EVP_CIPHER_CTX_ctrl( ctx, EVP_CTRL_GCM_SET_IVLEN, nonce.size(), nullptr );
@@ -311,14 +354,12 @@ namespace ntk {
         int len = 0;
         EVP_DecryptUpdate( ctx, nullptr, &len, aad.data(), aad.size() );
         EVP_DecryptUpdate( ctx, plain_text.data(), &len, cipher_text, cipher_len );
-        EVP_CIPHER_CTX_ctrl( ctx, EVP_CTRL_GCM_SET_TAG, 16, ( void* )tag );
-
-        if ( EVP_DecryptFinal_ex( ctx, plain_text.data() + len, &len) <= 0 ) {
-            EVP_CIPHER_CTX_free( ctx );
-            throw std::runtime_error( "GCM decryption failed ( tag mismatch )" );
-        }
+        EVP_CIPHER_CTX_ctrl( ctx, EVP_CTRL_GCM_SET_TAG, 16, const_cast<uint8_t*>( tag ) );
 
+        bool verified = EVP_DecryptFinal_ex( ctx, plain_text.data() + len, &len ) > 0;
         EVP_CIPHER_CTX_free( ctx );
+
+        if ( !verified ) return std::unexpected( "GCM decryption failed ( tag mismatch )" );
         return plain_text;
     }
 
@@ -332,6 +373,47 @@ namespace ntk {
         };
     }
 
+    namespace {
+
+        std::vector<tls_record> decrypt_records( const uint16_t cipher_suite_id, const std::vector<uint8_t>& secret,
+                                                 const std::vector<tls_record>& encrypted_records ) {
+
+            tls_decryptor decryptor( cipher_suite_id, secret );
+            std::vector<tls_record> result;
+            result.reserve( encrypted_records.size() );
+
+            for ( const auto& record : encrypted_records ) {
+                if ( record.content_type != tls_content_type::APPLICATION_DATA ) {
+                    result.push_back( record );
+                    continue;
+                }
+                tls_record& decrypted = result.emplace_back( tls_record{ record.content_type, record.version, {} } );
+                auto len = decryptor.decrypt( record, decrypted.payload );
+                if ( !len ) throw std::runtime_error( len.error() );
+            }
+
+            return result;
+        }
+
+        generator<tls_record> lazy_decrypt_records( const uint16_t cipher_suite_id, std::vector<uint8_t> secret,
+                                                    generator<tls_record> encrypted_records ) {
+
+            tls_decryptor decryptor( cipher_suite_id, secret );
+
+            for ( auto&& record : encrypted_records ) {
+                if ( record.content_type != tls_content_type::APPLICATION_DATA ) {
+                    co_yield std::move( record );
+                    continue;
+                }
+                tls_record decrypted{ record.content_type, record.version, {} };
+                auto len = decryptor.decrypt( record, decrypted.payload );
+                if ( !len ) throw std::runtime_error( len.error() );
+                co_yield std::move( decrypted );
+            }
+        }
+
+    } // namespace
+
     std::vector<tls_record> decrypt_tls_data( const std::array<uint8_t,32>& client_random,
                                               const std::array<uint8_t,32>& server_random,
                                               const uint16_t tls_version,
@@ -340,45 +422,44 @@ namespace ntk {
                                               const secrets& session_keys,
                                               const std::string& secret_label ) {
 
-        const cipher_suite suite = static_cast<cipher_suite>( cipher_suite_id );
+        auto secret = get_traffic_secret( session_keys, client_random, secret_label );
+        return decrypt_records( cipher_suite_id, secret, encrypted_records );
+    }
 
-        const EVP_MD* hash_fn = nullptr;
-        const EVP_CIPHER* cipher = nullptr;
-        size_t key_len = 0;
+    std::vector<tls_record> decrypt_tls_data( const std::array<uint8_t,32>& client_random,
+                                              const std::array<uint8_t,32>& server_random,
+                                              const uint16_t tls_version,
+                                              const uint16_t cipher_suite_id,
+                                              const std::vector<tls_record>& encrypted_records,
+                                              const key_log_store& key_log,
+                                              ntk::secret_label label ) {
 
-        switch ( suite ) {
-            case cipher_suite::TLS_AES_128_GCM_SHA256:
-                hash_fn = EVP_sha256();
-                cipher = EVP_aes_128_gcm();
-                key_len = 16;
-                break;
-            case cipher_suite::TLS_AES_256_GCM_SHA384:
-                hash_fn = EVP_sha384();
-                cipher = EVP_aes_256_gcm();
-                key_len = 32;
-                break;
-            default:
-                throw std::runtime_error( "Unsupported cipher suite" );
-        }
+        auto secret = get_traffic_secret( key_log, client_random, label );
+        return decrypt_records( cipher_suite_id, secret, encrypted_records );
+    }
+
+    generator<tls_record> generate_decrypted_records( const std::array<uint8_t,32>& client_random,
+                                                      const std::array<uint8_t,32>& server_random,
+                                                      const uint16_t tls_version,
+                                                      const uint16_t cipher_suite_id,
+                                                      generator<tls_record> encrypted_records,
+                                                      const secrets& session_keys,
+                                                      const std::string& secret_label ) {
 
         auto secret = get_traffic_secret( session_keys, client_random, secret_label );
-        auto key_material = derive_tls_key_iv( secret, hash_fn, key_len, 12 );
-        std::vector<tls_record> result;
-        uint64_t seq_num = 0;
-
-        for ( const auto& record : encrypted_records ) {
-            if ( record.content_type != tls_content_type::APPLICATION_DATA ) {
-                result.push_back( record );
-                continue;
-            }
-            auto nonce = build_tls13_nonce( key_material.iv, seq_num );
-            auto aad = build_tls13_aad( record.content_type, record.version, record.payload.size() );
-            auto decrypted_payload = decrypt_aes_gcm( key_material.key, nonce, aad, record.payload, cipher );
-            result.push_back( { record.content_type, record.version, decrypted_payload } );
-            seq_num++;
-        }
+        return lazy_decrypt_records( cipher_suite_id, std::move( secret ), std::move( encrypted_records ) );
+    }
 
-        return result;
+    generator<tls_record> generate_decrypted_records( const std::array<uint8_t,32>& client_random,
+                                                      const std::array<uint8_t,32>& server_random,
+                                                      const uint16_t tls_version,
+                                                      const uint16_t cipher_suite_id,
+                                                      generator<tls_record> encrypted_records,
+                                                      const key_log_store& key_log,
+                                                      ntk::secret_label label ) {
+
+        auto secret = get_traffic_secret( key_log, client_random, label );
+        return lazy_decrypt_records( cipher_suite_id, std::move( secret ), std::move( encrypted_records ) );
     }
 
     tls_record decrypt_record( const std::array<uint8_t,32>& client_random,
@@ -390,34 +471,14 @@ namespace ntk {
                                const std::string& secret_label,
                                uint64_t seq_num ) {
 
-        const cipher_suite suite = static_cast<cipher_suite>( cipher_suite_id );
-
-        const EVP_MD* hash_fn = nullptr;
-        const EVP_CIPHER* cipher = nullptr;
-        size_t key_len = 0;
-
-        switch ( suite ) {
-            case cipher_suite::TLS_AES_128_GCM_SHA256:
-                hash_fn = EVP_sha256();
-                cipher = EVP_aes_128_gcm();
-                key_len = 16;
-                break;
-            case cipher_suite::TLS_AES_256_GCM_SHA384:
-                hash_fn = EVP_sha384();
-                cipher = EVP_aes_256_gcm();
-                key_len = 32;
-                break;
-            default:
-                throw std::runtime_error( "Unsupported cipher suite" );
-        }
-
         auto secret = get_traffic_secret( session_keys, client_random, secret_label );
-        auto key_material = derive_tls_key_iv( secret, hash_fn, key_len, 12 );
-        auto nonce = build_tls13_nonce( key_material.iv, seq_num );
-        auto aad = build_tls13_aad( record.content_type, record.version, record.payload.size() );
-        auto decrypted_payload = decrypt_aes_gcm( key_material.key, nonce, aad, record.payload, cipher );
 
-        tls_record result { record.content_type, record.version, decrypted_payload };
+        tls_decryptor decryptor( cipher_suite_id, secret );
+        decryptor.seek( seq_num );
+
+        tls_record result { record.content_type, record.version, {} };
+        auto len = decryptor.decrypt( record, result.payload );
+        if ( !len ) throw std::runtime_error( len.error() );
 
         return result;
     }
@@ -444,52 +505,35 @@ namespace ntk {
         return cert;
     }
 
-    bool is_tls( const unsigned char* packet ) {
+    namespace {
 
-        if ( !is_tcp( packet ) ) return false;
-        
-        auto tcp_payload = extract_payload_from_ethernet( packet );
-        if ( tcp_payload.size() == 0 ) return false;
-
-        uint8_t content_type = tcp_payload[ 0 ];
-        uint8_t major_version = tcp_payload[ 1 ];
+        // the pointer predicates have only the frame, its length is taken from the ip header as extract_payload_from_ethernet does
+        std::span<const uint8_t> frame_of( const unsigned char* packet ) {
+            size_t ip_offset = constants::ethernet_header_len;
+            uint16_t total_length = static_cast<uint16_t>( ( packet[ ip_offset + 2 ] << 8 ) | packet[ ip_offset + 3 ] );
+            return std::span<const uint8_t>( packet, ip_offset + total_length );
+        }
 
-        if ( content_type < 20 || content_type > 23 ) return false; 
-        if ( major_version != 3 ) return false;
+    } // namespace
 
-        return true;
+    bool is_tls( const unsigned char* packet ) {
+        return is_tls_protocol( classify_packet( frame_of( packet ) ) );
     }
     
     bool is_tls_v( const std::vector<uint8_t>& packet ) {
-        return is_tls( packet.data() );
+        return is_tls_protocol( classify_packet( std::span<const uint8_t>( packet ) ) );
     }
 
     bool is_tls_payload( const std::vector<uint8_t>& payload ) {
-
-        uint8_t content_type = payload[ 0 ];
-        uint8_t major_version = payload[ 1 ];
-
-        if ( content_type < 20 || content_type > 23 ) return false; 
-        if ( major_version != 3 ) return false;
-
-        return true;
+        return is_tls_protocol( classify_payload( payload ) );
     }
 
     bool is_client_hello( const unsigned char* packet ) {
-
-        if ( !is_tls( packet ) ) return false;
-
-        auto tls_record = extract_payload_from_ethernet( packet );
-
-        uint8_t content_type = tls_record[ 0 ];
-        if ( content_type != 22 ) return false;
-
-        uint8_t handshake_type = tls_record[ 5 ];
-        return handshake_type == 1; 
+        return classify_packet( frame_of( packet ) ) == payload_protocol::TLS_CLIENT_HELLO;
     }
 
     bool is_client_hello_v( const std::vector<uint8_t>& packet ) {
-        return is_client_hello( packet.data() );
+        return classify_packet( std::span<const uint8_t>( packet ) ) == payload_protocol::TLS_CLIENT_HELLO;
     }
 
     bool is_client_hello(const tls_record& record) {
@@ -498,25 +542,15 @@ namespace ntk {
         if ( record.payload.empty() ) return false;
 
         uint8_t handshake_type = record.payload[0];
-        return handshake_type == 2;
+        return handshake_type == 1;
     }
 
     bool is_server_hello( const unsigned char* packet ) {
-        if ( !is_tls( packet ) ) return false;
-
-        auto tls_record = extract_payload_from_ethernet( packet );
-
-        if ( tls_record.size() < 6 ) return false;
-
-        uint8_t content_type = tls_record[ 0 ];
-        if ( content_type != 22 ) return false;
-
-        uint8_t handshake_type = tls_record[ 5 ];
-        return handshake_type == 2; 
+        return classify_packet( frame_of( packet ) ) == payload_protocol::TLS_SERVER_HELLO;
     }
 
     bool is_server_hello_v( const std::vector<uint8_t>& packet ) {
-        return is_server_hello( packet.data() );
+        return classify_packet( std::span<const uint8_t>( packet ) ) == payload_protocol::TLS_SERVER_HELLO;
     }
 
     bool is_server_hello(const tls_record& record) {
@@ -529,28 +563,11 @@ namespace ntk {
     }
 
     bool is_tls_alert( const unsigned char* packet ) {
-        if ( !is_tls( packet ) ) return false;
-
-        auto tls_record = extract_payload_from_ethernet( packet );
-
-        if ( tls_record.size() < 7 ) return false; 
-
-        uint8_t content_type = tls_record[ 0 ];
-        if ( content_type != 20 ) return false; 
-
-        uint16_t length = ( tls_record[ 3 ] << 8 ) | tls_record[ 4 ];
-        if ( length < 2 ) return false; 
-
-        uint8_t alert_level = tls_record[ 5 ];       
-        uint8_t alert_description = tls_record[ 6 ];
-
-        if ( alert_level != 1 && alert_level != 2 ) return false;
-
-        return true;
+        return classify_packet( frame_of( packet ) ) == payload_protocol::TLS_ALERT;
     }
 
     bool is_tls_alert_v( const std::vector<uint8_t>& packet ) {
-        return is_tls_alert( packet.data() );
+        return classify_packet( std::span<const uint8_t>( packet ) ) == payload_protocol::TLS_ALERT;
     }
 
     bool is_tls_application_data( const tls_record& record ) {
@@ -625,6 +642,88 @@ namespace ntk {
         return std::unexpected( "No sever name found" );
     }
 
+    std::optional<std::span<const uint8_t>> peek_client_hello( std::span<const uint8_t> tcp_payload ) {
+
+        constexpr size_t record_header_size = 5;
+        constexpr size_t handshake_header_size = 4;
+
+        if ( tcp_payload.size() < record_header_size + handshake_header_size ) return std::nullopt;
+        if ( tcp_payload[ 0 ] != static_cast<uint8_t>( tls_content_type::HANDSHAKE ) || tcp_payload[ 1 ] != 0x03 ) return std::nullopt;
+        if ( tcp_payload[ 5 ] != 1 ) return std::nullopt;
+
+        size_t record_len = ( tcp_payload[ 3 ] << 8 ) | tcp_payload[ 4 ];
+        size_t hello_len = ( tcp_payload[ 6 ] << 16 ) | ( tcp_payload[ 7 ] << 8 ) | tcp_payload[ 8 ];
+
+        auto body = tcp_payload.subspan( record_header_size + handshake_header_size );
+        size_t available = std::min( { body.size(), hello_len, record_len - std::min( record_len, handshake_header_size ) } );
+
+        return body.first( available );
+    }
+
+    std::optional<std::string_view> peek_sni( std::span<const uint8_t> tcp_payload ) {
+        auto hello = peek_client_hello( tcp_payload );
+        if ( !hello ) return std::nullopt;
+        return peek_sni_in_client_hello( *hello );
+    }
+
+    std::optional<std::string_view> peek_sni_in_client_hello( std::span<const uint8_t> client_hello_body ) {
+
+        auto bytes = client_hello_body;
+        auto read_u16 = [&]( size_t pos ) { return static_cast<size_t>( ( bytes[ pos ] << 8 ) | bytes[ pos + 1 ] ); };
+
+        // version and random, then the session id, cipher suites and compression methods are skipped
+        size_t pos = 2 + 32;
+        if ( bytes.size() < pos + 1 ) return std::nullopt;
+        pos += 1 + bytes[ pos ];
+        if ( bytes.size() < pos + 2 ) return std::nullopt;
+        pos += 2 + read_u16( pos );
+        if ( bytes.size() < pos + 1 ) return std::nullopt;
+        pos += 1 + bytes[ pos ];
+        if ( bytes.size() < pos + 2 ) return std::nullopt;
+
+        size_t extensions_end = std::min( bytes.size(), pos + 2 + read_u16( pos ) );
+        pos += 2;
+
+        while ( pos + 4 <= extensions_end ) {
+
+            size_t extension_type = read_u16( pos );
+            size_t extension_len = read_u16( pos + 2 );
+            pos += 4;
+
+            if ( pos + extension_len > extensions_end ) return std::nullopt;
+
+            if ( extension_type == 0x0000 ) {
+
+                if ( extension_len < 2 ) return std::nullopt;
+
+                size_t list_end = pos + 2 + std::min( read_u16( pos ), extension_len - 2 );
+                size_t entry = pos + 2;
+
+                while ( entry + 3 <= list_end ) {
+                    uint8_t name_type = bytes[ entry ];
+                    size_t name_len = read_u16( entry + 1 );
+                    if ( entry + 3 + name_len > list_end ) return std::nullopt;
+                    if ( name_type == 0 ) {
+                        return std::string_view( reinterpret_cast<const char*>( bytes.data() + entry + 3 ), name_len );
+                    }
+                    entry += 3 + name_len;
+                }
+
+                return std::nullopt;
+            }
+
+            pos += extension_len;
+        }
+
+        return std::nullopt;
+    }
+
+    std::optional<std::string_view> peek_sni_from_ethernet_frame( std::span<const uint8_t> ethernet_frame ) {
+        auto packet = decode_packet( ethernet_frame );
+        if ( !packet ) return std::nullopt;
+        return peek_sni( packet->payload );
+    }
+
     std::expected<std::string,std::string> get_sni( const std::vector<uint8_t>& hello ) {
         auto client_hello = get_client_hello_from_ethernet_frame( hello );
         auto sni = get_sni( client_hello );
@@ -674,17 +773,16 @@ namespace ntk {
 
         sni_to_ip results;
 
-        for ( auto& client_hello_packet : packets | std::views::filter( is_client_hello_v ) ) {
-            auto sni = get_sni( client_hello_packet );
+        for ( auto& packet : packets ) {
 
-            if ( !sni.has_value() ) {
-                std::cerr << sni.error() << std::endl;
-            }
+            auto decoded = decode_packet( packet );
+            if ( !decoded ) continue;
 
-            ipv4_header header = get_ipv4_header( client_hello_packet.data() );
-            if ( !results.contains( sni.value() ) ) {
-                results[ sni.value() ] = header.destination_ip_addr;
-            }
+            auto sni = peek_sni( decoded->payload );
+            if ( !sni || !decoded->destination_ip.is_v4() ) continue;
+
+            // the first connection to a host names its address
+            results.try_emplace( std::string( *sni ), decoded->destination_ip.v4() );
         }
 
         return results;
@@ -722,78 +820,263 @@ namespace ntk {
         : tcp_transfer( four ) {}
 
     tls_live_stream::tls_live_stream( const tcp_live_stream& tcp_stream ) 
-        : tcp_live_stream( tcp_stream ) {
-        
-        for ( auto& packet : m_traffic ) {
-            if ( is_client_hello_v( packet ) ) {
-                m_client_hello = get_client_hello_from_ethernet_frame( packet );
-                break;
-            }
+        : tcp_live_stream( tcp_stream ) {}
+
+    tls_live_stream::tls_live_stream( tcp_live_stream&& tcp_stream )
+        : tcp_live_stream( std::move( tcp_stream ) ) {}
+
+    std::span<const uint8_t> tls_live_stream::leading_payload( bool client ) const {
+
+        auto payload = client ? client_payload() : server_payload();
+        if ( !payload.empty() ) return payload;
+
+        // the payload went to stream_events, the frames may still be there
+        const auto four = client ? get_four_tuple() : flip_four( get_four_tuple() );
+        const uint8_t hello_type = client ? 1 : 2;
+
+        std::span<const uint8_t> found;
+        auto is_hello = [&]( std::span<const uint8_t> packet ) {
+            auto decoded = decode_packet( packet );
+            if ( !decoded || decoded->four() != four || decoded->payload.size() < 6 ) return false;
+            if ( decoded->payload[ 0 ] != static_cast<uint8_t>( tls_content_type::HANDSHAKE ) || decoded->payload[ 5 ] != hello_type ) return false;
+            found = decoded->payload;
+            return true;
+        };
+
+        bool matched = m_spill && m_spill->is_mapped() && std::any_of( m_spill->frames().begin(), m_spill->frames().end(), is_hello );
+        if ( !matched ) matched = std::any_of( m_traffic.begin(), m_traffic.end(), is_hello );
+        if ( !matched ) std::any_of( m_pooled_traffic.begin(), m_pooled_traffic.end(), [&]( const packet_view& packet ) {
+            return is_hello( packet.bytes() );
+        });
+
+        return found;
+    }
+
+    const std::optional<client_hello>& tls_live_stream::get_client_hello() const {
+        if ( !m_client_hello ) {
+            auto payload = leading_payload( true );
+            auto body = peek_client_hello( payload );
+            // parse_client_hello trusts the lengths, so only a hello that is all there is parsed
+            bool complete = body && payload.size() >= 9 && body->size() == static_cast<size_t>( ( payload[ 6 ] << 16 ) | ( payload[ 7 ] << 8 ) | payload[ 8 ] );
+            m_client_hello = complete ? std::optional<client_hello>( parse_client_hello( *body ) ) : std::nullopt;
         }
-        auto sni_result = ntk::get_sni( m_client_hello );
-        if ( sni_result.has_value() ) {
-            m_sni = sni_result.value();
-        } else {
-            m_sni = sni_result.error();
+        return *m_client_hello;
+    }
+
+    const std::optional<server_hello>& tls_live_stream::get_server_hello() const {
+        if ( !m_server_hello ) {
+            m_server_hello = std::optional<server_hello>();
+            tls_record_framer framer;
+            auto record = framer.next( leading_payload( false ) );
+            if ( record && record->content_type == tls_content_type::HANDSHAKE && record->payload.size() >= 4 && record->payload[ 0 ] == 2 ) {
+                size_t hello_len = ( record->payload[ 1 ] << 16 ) | ( record->payload[ 2 ] << 8 ) | record->payload[ 3 ];
+                if ( hello_len >= 2 + 32 + 1 + 2 + 1 + 2 && record->payload.size() >= 4 + hello_len ) {
+                    *m_server_hello = parse_server_hello( record->payload.subspan( 4, hello_len ) );
+                }
+            }
         }
+        return *m_server_hello;
     }
 
     const std::string& tls_live_stream::get_sni() const {
-        return m_sni;
+        if ( !m_sni ) {
+            auto sni = peek_sni( leading_payload( true ) );
+            // the error get_sni gives, for a stream without a hello as well
+            m_sni = sni ? std::string( *sni ) : "No sever name found";
+        }
+        return *m_sni;
     }
 
-    bool tls_filter::operator()( const ntk::tcp_live_stream& stream ) {
-        return stream.traffic_contains( is_client_hello_v );
+    namespace {
+
+        std::vector<tls_record> frame_records( std::span<const uint8_t> stream ) {
+            std::vector<tls_record> records;
+            tls_record_framer framer;
+            while ( auto view = framer.next( stream ) ) records.push_back( view->to_record() );
+            return records;
+        }
+
+    } // namespace
+
+    const std::vector<tls_record>& tls_live_stream::client_records() const {
+        if ( !m_client_records ) m_client_records = frame_records( client_payload() );
+        return *m_client_records;
     }
 
-    bool sni_filter::operator()( const ntk::tcp_live_stream& stream ) {
+    const std::vector<tls_record>& tls_live_stream::server_records() const {
+        if ( !m_server_records ) m_server_records = frame_records( server_payload() );
+        return *m_server_records;
+    }
 
-        auto has_matching_sni = [&]( const std::vector<uint8_t> packet ) {
-            if ( is_client_hello_v( packet ) ) {
-                auto client_hello = get_client_hello_from_ethernet_frame( packet );
-                auto result = sni_contains( client_hello, m_sni );
-                if ( result.has_value() ) {
-                    return result.value(); 
-                } else {
-                    return false;
-                } 
-            }
-            return false;
-        };
+    bool tls_filter::operator()( const ntk::tcp_live_stream& stream ) {
+        return stream.traffic_contains( []( const auto& packet ) {
+            auto decoded = decode_packet( std::span<const uint8_t>( packet.data(), packet.size() ) );
+            return decoded && peek_client_hello( decoded->payload ).has_value();
+        });
+    }
 
-        return stream.traffic_contains( has_matching_sni );
+    bool sni_filter::operator()( const ntk::tcp_live_stream& stream ) {
+        return stream.traffic_contains( [&]( const auto& packet ) {
+            auto sni = peek_sni_from_ethernet_frame( std::span<const uint8_t>( packet.data(), packet.size() ) );
+            return sni && sni->contains( m_sni );
+        });
     }
 
     sni_filter::sni_filter( const std::string& sni )
         : m_sni( sni ) {}
 
+    namespace {
+
+        // the ClientHello record at the start of a client payload, nullopt until the whole record is in
+        std::optional<std::expected<std::span<const uint8_t>,std::string>> leading_client_hello( std::span<const uint8_t> payload ) {
+
+            constexpr size_t record_header_size = 5;
+
+            if ( payload.size() < record_header_size ) return std::nullopt;
+            if ( payload[ 0 ] != static_cast<uint8_t>( tls_content_type::HANDSHAKE ) ) return std::unexpected( "Not a TLS handshake record" );
+
+            size_t record_size = record_header_size + ( ( payload[ 3 ] << 8 ) | payload[ 4 ] );
+            if ( payload.size() < record_size ) return std::nullopt;
+
+            auto record = payload.first( record_size );
+            if ( !peek_client_hello( record ) ) return std::unexpected( "First record is not a ClientHello" );
+
+            return record;
+        }
+
+    }
+
+    tls_classifier::tls_classifier( flow_verdict tls, flow_verdict other )
+        : m_tls( tls ), m_other( other ) {}
+
+    flow_verdict tls_classifier::operator()( const ntk::tcp_live_stream& stream ) const {
+        auto hello = leading_client_hello( stream.client_payload() );
+        if ( !hello ) return flow_verdict::UNDECIDED;
+        return hello->has_value() ? m_tls : m_other;
+    }
+
+    sni_classifier::sni_classifier( const std::string& sni, flow_verdict other )
+        : m_sni( sni ), m_other( other ) {}
+
+    flow_verdict sni_classifier::operator()( const ntk::tcp_live_stream& stream ) const {
+        auto hello = leading_client_hello( stream.client_payload() );
+        if ( !hello ) return flow_verdict::UNDECIDED;
+        if ( !hello->has_value() ) return m_other;
+        auto sni = peek_sni( hello->value() );
+        return sni && sni->contains( m_sni ) ? flow_verdict::KEEP : m_other;
+    }
+
     std::string string_to_hex( const std::vector<uint8_t>& data ) {
         return session_id_to_hex( data );
     }
 
-    tls_record_extraction_result extract_tls_records( const std::vector<std::vector<uint8_t>>& payloads ) {
+    tls_record tls_record_view::to_record() const {
+        return tls_record{ content_type, version, { payload.begin(), payload.end() } };
+    }
 
-        tls_record_extraction_result result;
-        std::vector<uint8_t> remainder;
+    tls_record_framer::tls_record_framer() : m_offset( 0 ) {}
+
+    std::optional<tls_record_view> tls_record_framer::next( std::span<const uint8_t> stream ) {
 
-        for ( auto& payload : payloads ) {
+        if ( stream.size() < m_offset + 5 ) return std::nullopt;
 
-            std::vector<uint8_t> cumulative_payload;
+        const uint8_t* header = stream.data() + m_offset;
+        const size_t record_len = ( header[ 3 ] << 8 ) | header[ 4 ];
 
-            cumulative_payload.insert( cumulative_payload.end(), remainder.begin(), remainder.end() );
-            cumulative_payload.insert( cumulative_payload.end(), payload.begin(), payload.end() );
+        if ( stream.size() - m_offset - 5 < record_len ) return std::nullopt;
 
-            auto [ complete_records, offset_reached ] = *split_tls_records( cumulative_payload );
+        tls_record_view view{
+            static_cast<tls_content_type>( header[ 0 ] ),
+            static_cast<uint16_t>( ( header[ 1 ] << 8 ) | header[ 2 ] ),
+            stream.subspan( m_offset + 5, record_len )
+        };
+
+        m_offset += 5 + record_len;
+        return view;
+    }
+
+    size_t tls_record_framer::offset() const {
+        return m_offset;
+    }
+
+    bool tls_record_framer::has_remainder( std::span<const uint8_t> stream ) const {
+        return stream.size() > m_offset;
+    }
 
-            result.records.insert( result.records.end(), complete_records.begin(), complete_records.end() );
-            remainder.assign( cumulative_payload.begin() + offset_reached, cumulative_payload.end() );
+    void tls_record_framer::reset() {
+        m_offset = 0;
+    }
+
+    tls_handshake_walker::tls_handshake_walker() : m_skip( 0 ), m_header{}, m_header_size( 0 ) {}
+
+    void tls_handshake_walker::feed( std::span<const uint8_t> content ) {
+        m_content = content;
+    }
+
+    std::optional<uint8_t> tls_handshake_walker::next() {
+
+        size_t skipped = std::min( m_skip, m_content.size() );
+        m_skip -= skipped;
+        m_content = m_content.subspan( skipped );
+
+        size_t n = std::min( m_header.size() - m_header_size, m_content.size() );
+        std::copy_n( m_content.begin(), n, m_header.begin() + m_header_size );
+        m_header_size += n;
+        m_content = m_content.subspan( n );
+        if ( m_header_size < m_header.size() ) return std::nullopt;
+
+        m_header_size = 0;
+        m_skip = ( m_header[ 1 ] << 16 ) | ( m_header[ 2 ] << 8 ) | m_header[ 3 ];
+        return m_header[ 0 ];
+    }
+
+    void tls_handshake_walker::reset() {
+        m_content = {};
+        m_skip = 0;
+        m_header_size = 0;
+    }
+
+    tls_record_extraction_result extract_tls_records( const std::vector<std::vector<uint8_t>>& payloads ) {
+
+        tls_record_extraction_result result;
+
+        // the payloads joined once, rather than the remainder copied again for every one of them
+        size_t total = 0;
+        for ( auto& payload : payloads ) total += payload.size();
+
+        std::vector<uint8_t> stream;
+        stream.reserve( total );
+        for ( auto& payload : payloads ) stream.insert( stream.end(), payload.begin(), payload.end() );
+
+        tls_record_framer framer;
+        while ( auto view = framer.next( stream ) ) {
+            result.records.push_back( view->to_record() );
         }
 
-        result.has_remainder = !remainder.empty();
+        result.has_remainder = framer.has_remainder( stream );
 
         return result;
     }
 
+    generator<tls_record> generate_tls_records( generator<std::vector<uint8_t>> payloads ) {
+
+        std::vector<uint8_t> stream;
+        tls_record_framer framer;
+
+        for ( auto&& payload : payloads ) {
+            stream.insert( stream.end(), payload.begin(), payload.end() );
+
+            while ( auto view = framer.next( stream ) ) {
+                auto record = view->to_record();
+                co_yield std::move( record );
+            }
+
+            // what the framer got through is let go of before the next payload is added
+            stream.erase( stream.begin(), stream.begin() + framer.offset() );
+            framer.reset();
+        }
+    }
+
     std::expected<tls_record,std::string> get_tls_record_from_ethernet( std::span<const uint8_t> packet ) {
 
         auto payload = extract_payload_from_ethernet( packet.data() );
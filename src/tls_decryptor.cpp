@@ -0,0 +1,221 @@
+#include <tls_decryptor.hpp>
+
+#include <algorithm>
+#include <latch>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include <cstring>
+
+namespace ntk {
+
+    namespace {
+
+        constexpr size_t tag_len = 16;
+
+    } // namespace
+
+    tls_decryptor::tls_decryptor()
+        : m_ctx( EVP_CIPHER_CTX_new() ), m_iv{}, m_seq_num( 0 ), m_keyed( false ) {
+        if ( !m_ctx ) throw std::runtime_error( "EVP_CIPHER_CTX_new failed" );
+    }
+
+    tls_decryptor::tls_decryptor( uint16_t cipher_suite_id, const std::vector<uint8_t>& secret )
+        : tls_decryptor() {
+        rekey( cipher_suite_id, secret );
+    }
+
+    tls_decryptor::~tls_decryptor() {
+        if ( m_ctx ) EVP_CIPHER_CTX_free( m_ctx );
+    }
+
+    tls_decryptor::tls_decryptor( tls_decryptor&& other ) noexcept
+        : m_ctx( std::exchange( other.m_ctx, nullptr ) ), m_iv( other.m_iv ),
+          m_seq_num( other.m_seq_num ), m_keyed( std::exchange( other.m_keyed, false ) ) {}
+
+    tls_decryptor& tls_decryptor::operator=( tls_decryptor&& other ) noexcept {
+        if ( this != &other ) {
+            if ( m_ctx ) EVP_CIPHER_CTX_free( m_ctx );
+            m_ctx = std::exchange( other.m_ctx, nullptr );
+            m_iv = other.m_iv;
+            m_seq_num = other.m_seq_num;
+            m_keyed = std::exchange( other.m_keyed, false );
+        }
+        return *this;
+    }
+
+    void tls_decryptor::rekey( uint16_t cipher_suite_id, const std::vector<uint8_t>& secret ) {
+
+        const EVP_MD* hash_fn = nullptr;
+        const EVP_CIPHER* cipher = nullptr;
+        size_t key_len = 0;
+
+        switch ( static_cast<cipher_suite>( cipher_suite_id ) ) {
+            case cipher_suite::TLS_AES_128_GCM_SHA256:
+                hash_fn = EVP_sha256();
+                cipher = EVP_aes_128_gcm();
+                key_len = 16;
+                break;
+            case cipher_suite::TLS_AES_256_GCM_SHA384:
+                hash_fn = EVP_sha384();
+                cipher = EVP_aes_256_gcm();
+                key_len = 32;
+                break;
+            default:
+                throw std::runtime_error( "Unsupported cipher suite" );
+        }
+
+        if ( !m_ctx ) m_ctx = EVP_CIPHER_CTX_new();
+        if ( !m_ctx ) throw std::runtime_error( "EVP_CIPHER_CTX_new failed" );
+
+        m_keyed = false;
+
+        auto key_material = derive_tls_key_iv( secret, hash_fn, key_len, m_iv.size() );
+
+        // the key schedule is expanded here once, records only set their nonce
+        if ( EVP_DecryptInit_ex( m_ctx, cipher, nullptr, nullptr, nullptr ) <= 0 ||
+             EVP_CIPHER_CTX_ctrl( m_ctx, EVP_CTRL_GCM_SET_IVLEN, static_cast<int>( m_iv.size() ), nullptr ) <= 0 ||
+             EVP_DecryptInit_ex( m_ctx, nullptr, nullptr, key_material.key.data(), nullptr ) <= 0 ) {
+            OPENSSL_cleanse( key_material.key.data(), key_material.key.size() );
+            throw std::runtime_error( "EVP_DecryptInit_ex failed" );
+        }
+
+        OPENSSL_cleanse( key_material.key.data(), key_material.key.size() );
+        std::memcpy( m_iv.data(), key_material.iv.data(), m_iv.size() );
+        m_seq_num = 0;
+        m_keyed = true;
+    }
+
+    bool tls_decryptor::is_keyed() const {
+        return m_keyed;
+    }
+
+    uint64_t tls_decryptor::sequence() const {
+        return m_seq_num;
+    }
+
+    void tls_decryptor::seek( uint64_t seq_num ) {
+        m_seq_num = seq_num;
+    }
+
+    std::expected<size_t,std::string> tls_decryptor::decrypt( tls_content_type content_type, uint16_t version,
+                                                              std::span<const uint8_t> payload, std::span<uint8_t> out ) {
+
+        if ( !m_keyed ) return std::unexpected( "Decryptor has no traffic secret" );
+        if ( payload.size() < tag_len || payload.size() > 0xffff ) return std::unexpected( "Bad record length" );
+
+        const size_t cipher_len = payload.size() - tag_len;
+        if ( out.size() < cipher_len ) return std::unexpected( "Output buffer too small" );
+
+        // rfc 8446 5.3, the iv xor the sequence number right aligned
+        std::array<uint8_t,12> nonce = m_iv;
+        for ( int i = 0; i < 8; ++i ) {
+            nonce[ nonce.size() - 8 + i ] ^= static_cast<uint8_t>( ( m_seq_num >> ( 56 - 8 * i ) ) & 0xff );
+        }
+
+        const uint16_t length = static_cast<uint16_t>( payload.size() );
+        const std::array<uint8_t,5> aad = {
+            static_cast<uint8_t>( content_type ),
+            static_cast<uint8_t>( version >> 8 ),
+            static_cast<uint8_t>( version & 0xff ),
+            static_cast<uint8_t>( length >> 8 ),
+            static_cast<uint8_t>( length & 0xff )
+        };
+
+        int len = 0;
+        int final_len = 0;
+        if ( EVP_DecryptInit_ex( m_ctx, nullptr, nullptr, nullptr, nonce.data() ) <= 0 ||
+             EVP_DecryptUpdate( m_ctx, nullptr, &len, aad.data(), static_cast<int>( aad.size() ) ) <= 0 ||
+             EVP_DecryptUpdate( m_ctx, out.data(), &len, payload.data(), static_cast<int>( cipher_len ) ) <= 0 ||
+             EVP_CIPHER_CTX_ctrl( m_ctx, EVP_CTRL_GCM_SET_TAG, static_cast<int>( tag_len ),
+                                  const_cast<uint8_t*>( payload.data() + cipher_len ) ) <= 0 ||
+             EVP_DecryptFinal_ex( m_ctx, out.data() + len, &final_len ) <= 0 ) {
+            return std::unexpected( "GCM decryption failed ( tag mismatch )" );
+        }
+
+        ++m_seq_num;
+        return static_cast<size_t>( len + final_len );
+    }
+
+    std::expected<size_t,std::string> tls_decryptor::decrypt( const tls_record& record, std::vector<uint8_t>& out ) {
+        return decrypt( tls_record_view{ record.content_type, record.version, record.payload }, out );
+    }
+
+    std::expected<size_t,std::string> tls_decryptor::decrypt( const tls_record_view& record, std::vector<uint8_t>& out ) {
+
+        if ( record.payload.size() < tag_len ) return std::unexpected( "Bad record length" );
+
+        out.resize( record.payload.size() - tag_len );
+        auto len = decrypt( record.content_type, record.version, record.payload, out );
+        if ( len ) out.resize( *len );
+        return len;
+    }
+
+    std::vector<tls_record> decrypt_tls_records_parallel( uint16_t cipher_suite_id, const std::vector<uint8_t>& secret,
+                                                          const std::vector<tls_record>& encrypted_records,
+                                                          work_stealing_pool& pool, size_t chunk_records ) {
+
+        // fails for an unsupported suite here rather than in every chunk
+        tls_decryptor check( cipher_suite_id, secret );
+
+        const size_t n = encrypted_records.size();
+        const size_t chunk = std::max<size_t>( chunk_records, 1 );
+        const size_t n_chunks = ( n + chunk - 1 ) / chunk;
+
+        // the sequence number each chunk starts at
+        std::vector<uint64_t> first_seq( n_chunks, 0 );
+        uint64_t seq_num = 0;
+        for ( size_t i = 0; i < n; ++i ) {
+            if ( i % chunk == 0 ) first_seq[ i / chunk ] = seq_num;
+            if ( encrypted_records[ i ].content_type == tls_content_type::APPLICATION_DATA ) ++seq_num;
+        }
+
+        std::vector<tls_record> result( n );
+        std::vector<std::optional<std::string>> errors( n_chunks );
+        std::latch done( static_cast<std::ptrdiff_t>( n_chunks ) );
+
+        for ( size_t c = 0; c < n_chunks; ++c ) {
+            pool.submit( [ &, c ]() {
+                try {
+                    tls_decryptor decryptor( cipher_suite_id, secret );
+                    decryptor.seek( first_seq[ c ] );
+
+                    for ( size_t i = c * chunk; i < std::min( n, ( c + 1 ) * chunk ); ++i ) {
+                        const auto& record = encrypted_records[ i ];
+                        result[ i ].content_type = record.content_type;
+                        result[ i ].version = record.version;
+                        if ( record.content_type != tls_content_type::APPLICATION_DATA ) {
+                            result[ i ].payload = record.payload;
+                            continue;
+                        }
+                        auto len = decryptor.decrypt( record, result[ i ].payload );
+                        if ( !len ) {
+                            errors[ c ] = len.error();
+                            break;
+                        }
+                    }
+                } catch ( const std::exception& e ) {
+                    errors[ c ] = e.what();
+                }
+                done.count_down();
+            });
+        }
+
+        if ( pool.on_pool_thread() ) {
+            while ( !done.try_wait() ) {
+                if ( !pool.run_one() ) std::this_thread::yield();
+            }
+        } else {
+            done.wait();
+        }
+
+        for ( auto& error : errors ) {
+            if ( error ) throw std::runtime_error( *error );
+        }
+
+        return result;
+    }
+
+} // namespace ntk
@@ -0,0 +1,218 @@
+#include <tls_live_decryptor.hpp>
+
+#include <stdexcept>
+
+namespace ntk {
+
+    namespace {
+
+        constexpr uint8_t client_hello_type = 1;
+        constexpr uint8_t server_hello_type = 2;
+        constexpr uint8_t finished_type = 20;
+
+        // the shortest hellos parse_client_hello and parse_server_hello read without running off
+        constexpr size_t min_client_hello = 4 + 2 + 32 + 1 + 2 + 1 + 2;
+        constexpr size_t min_server_hello = 4 + 2 + 32 + 1 + 2 + 1 + 2;
+
+        secret_label label_for( stream_direction direction, bool application ) {
+            if ( direction == stream_direction::CLIENT_TO_SERVER ) {
+                return application ? secret_label::CLIENT_TRAFFIC_SECRET_0 : secret_label::CLIENT_HANDSHAKE_TRAFFIC_SECRET;
+            }
+            return application ? secret_label::SERVER_TRAFFIC_SECRET_0 : secret_label::SERVER_HANDSHAKE_TRAFFIC_SECRET;
+        }
+
+    } // namespace
+
+    tls_live_decryptor::tls_live_decryptor( const key_log_store& key_log, tls_events& events, size_t max_buffered_bytes )
+        : m_key_log( key_log ), m_events( events ), m_max_buffered_bytes( max_buffered_bytes ) {}
+
+    void tls_live_decryptor::on_open( const four_tuple& four ) {
+        auto [ it, inserted ] = m_connections.try_emplace( four );
+        it->second.four = four;
+        m_statistics.connections = m_connections.size();
+    }
+
+    void tls_live_decryptor::on_data( const four_tuple& four, stream_direction direction, std::span<const uint8_t> data ) {
+
+        auto it = m_connections.find( four );
+        if ( it == m_connections.end() ) {
+            on_open( four );
+            it = m_connections.find( four );
+        }
+
+        auto& conn = it->second;
+        if ( conn.failed ) return;
+
+        auto& state = direction == stream_direction::CLIENT_TO_SERVER ? conn.client_to_server : conn.server_to_client;
+        state.buffer.insert( state.buffer.end(), data.begin(), data.end() );
+
+        process( conn, direction );
+    }
+
+    void tls_live_decryptor::on_close( const four_tuple& four, close_reason reason ) {
+
+        auto it = m_connections.find( four );
+        if ( it != m_connections.end() ) {
+            // the secrets may have been logged since the last payload
+            if ( !it->second.failed ) {
+                process( it->second, stream_direction::CLIENT_TO_SERVER );
+                process( it->second, stream_direction::SERVER_TO_CLIENT );
+            }
+            m_connections.erase( it );
+            m_statistics.connections = m_connections.size();
+        }
+
+        m_events.on_close( four, reason );
+    }
+
+    void tls_live_decryptor::retry() {
+        for ( auto& [ key, conn ] : m_connections ) {
+            if ( conn.failed ) continue;
+            process( conn, stream_direction::CLIENT_TO_SERVER );
+            process( conn, stream_direction::SERVER_TO_CLIENT );
+        }
+    }
+
+    tls_live_statistics tls_live_decryptor::statistics() const {
+        return m_statistics;
+    }
+
+    void tls_live_decryptor::fail( connection& conn, const std::string& reason ) {
+        conn.failed = true;
+        std::vector<uint8_t>().swap( conn.client_to_server.buffer );
+        std::vector<uint8_t>().swap( conn.server_to_client.buffer );
+        ++m_statistics.failures;
+        m_events.on_failure( conn.four, reason );
+    }
+
+    bool tls_live_decryptor::ensure_keyed( connection& conn, stream_direction direction, direction_state& state ) {
+
+        if ( state.decryptor.is_keyed() ) return true;
+        if ( !conn.client || !conn.server ) return false;
+
+        auto secret = m_key_log.find( conn.client->random, label_for( direction, state.stage == phase::APPLICATION ) );
+        if ( !secret ) return false;
+
+        try {
+            state.decryptor.rekey( conn.server->cipher_suite, *secret );
+        } catch ( const std::runtime_error& e ) {
+            fail( conn, e.what() );
+            return false;
+        }
+
+        return true;
+    }
+
+    void tls_live_decryptor::process( connection& conn, stream_direction direction ) {
+
+        auto& state = direction == stream_direction::CLIENT_TO_SERVER ? conn.client_to_server : conn.server_to_client;
+
+        while ( !conn.failed ) {
+
+            // a record is only taken off the stream once it can be dealt with
+            if ( state.stage != phase::HELLO && !ensure_keyed( conn, direction, state ) ) break;
+
+            // anything else would sit waiting on whatever length its bytes happen to give
+            if ( state.stage == phase::HELLO ) {
+                std::span<const uint8_t> header = std::span<const uint8_t>( state.buffer ).subspan( state.framer.offset() );
+                if ( ( header.size() >= 1 && header[ 0 ] != static_cast<uint8_t>( tls_content_type::HANDSHAKE ) ) ||
+                     ( header.size() >= 2 && header[ 1 ] != 0x03 ) ) {
+                    fail( conn, "Stream does not start with a TLS hello" );
+                    break;
+                }
+            }
+
+            auto view = state.framer.next( state.buffer );
+            if ( !view ) break;
+
+            if ( view->content_type == tls_content_type::CHANGE_CIPHER_SEC ) continue;
+
+            if ( state.stage == phase::HELLO ) {
+
+                const auto& payload = view->payload;
+                const uint8_t expected_type = direction == stream_direction::CLIENT_TO_SERVER ? client_hello_type : server_hello_type;
+
+                if ( view->content_type != tls_content_type::HANDSHAKE || payload.empty() || payload[ 0 ] != expected_type ) {
+                    fail( conn, "Stream does not start with a TLS hello" );
+                    break;
+                }
+
+                if ( direction == stream_direction::CLIENT_TO_SERVER ) {
+                    if ( payload.size() < min_client_hello ) {
+                        fail( conn, "ClientHello too short" );
+                        break;
+                    }
+                    conn.client = parse_client_hello( payload.subspan( 4 ) );
+                } else {
+                    if ( payload.size() < min_server_hello ) {
+                        fail( conn, "ServerHello too short" );
+                        break;
+                    }
+                    conn.server = parse_server_hello( payload.subspan( 4 ) );
+                }
+
+                state.stage = phase::HANDSHAKE;
+                if ( conn.client && conn.server ) {
+                    m_events.on_handshake( conn.four, *conn.client, *conn.server );
+                    // the other direction may have been waiting on this hello for its secret
+                    auto other = direction == stream_direction::CLIENT_TO_SERVER ? stream_direction::SERVER_TO_CLIENT
+                                                                                  : stream_direction::CLIENT_TO_SERVER;
+                    process( conn, other );
+                }
+                continue;
+            }
+
+            auto len = state.decryptor.decrypt( *view, m_plain_text );
+            if ( !len ) {
+                fail( conn, len.error() );
+                break;
+            }
+
+            // rfc 8446 5.2, the inner content type is the last byte that is not padding
+            size_t end = *len;
+            while ( end > 0 && m_plain_text[ end - 1 ] == 0 ) --end;
+            if ( end == 0 ) {
+                fail( conn, "Record without an inner content type" );
+                break;
+            }
+
+            auto type = static_cast<tls_content_type>( m_plain_text[ end - 1 ] );
+            auto content = std::span<const uint8_t>( m_plain_text.data(), end - 1 );
+
+            ++m_statistics.records_decrypted;
+            m_statistics.bytes_decrypted += content.size();
+            m_events.on_record( conn.four, direction, type, content );
+
+            if ( state.stage == phase::HANDSHAKE && type == tls_content_type::HANDSHAKE ) {
+
+                // walk the messages, a Finished ends this direction's handshake
+                bool finished = false;
+                state.handshake.feed( content );
+                while ( auto message = state.handshake.next() ) {
+                    if ( *message == finished_type ) {
+                        finished = true;
+                        break;
+                    }
+                }
+
+                if ( finished ) {
+                    state.stage = phase::APPLICATION;
+                    state.decryptor = tls_decryptor();
+                }
+            }
+        }
+
+        if ( conn.failed ) return;
+
+        // the records decrypted are gone, what is left is one the rest of has not arrived
+        if ( state.framer.offset() > 0 ) {
+            state.buffer.erase( state.buffer.begin(), state.buffer.begin() + state.framer.offset() );
+            state.framer.reset();
+        }
+
+        if ( state.buffer.size() > m_max_buffered_bytes ) {
+            fail( conn, "More than max_buffered_bytes waiting for a secret" );
+        }
+    }
+
+} // namespace ntk
@@ -0,0 +1,296 @@
+#include <tls_session_decoder.hpp>
+
+#include <stdexcept>
+#include <utility>
+
+#include <decoded_packet.hpp>
+
+namespace ntk {
+
+    namespace {
+
+        constexpr uint8_t client_hello_type = 1;
+        constexpr uint8_t server_hello_type = 2;
+        constexpr uint8_t finished_type = 20;
+        constexpr uint8_t key_update_type = 24;
+
+        constexpr size_t tag_len = 16;
+
+        // the shortest hellos parse_client_hello and parse_server_hello read without running off
+        constexpr size_t min_client_hello = 4 + 2 + 32 + 1 + 2 + 1 + 2;
+        constexpr size_t min_server_hello = 4 + 2 + 32 + 1 + 2 + 1 + 2;
+
+        secret_label label_for( stream_direction direction, tls_epoch epoch ) {
+            if ( direction == stream_direction::CLIENT_TO_SERVER ) {
+                return epoch == tls_epoch::APPLICATION ? secret_label::CLIENT_TRAFFIC_SECRET_0 : secret_label::CLIENT_HANDSHAKE_TRAFFIC_SECRET;
+            }
+            return epoch == tls_epoch::APPLICATION ? secret_label::SERVER_TRAFFIC_SECRET_0 : secret_label::SERVER_HANDSHAKE_TRAFFIC_SECRET;
+        }
+
+        stream_direction other_direction( stream_direction direction ) {
+            return direction == stream_direction::CLIENT_TO_SERVER ? stream_direction::SERVER_TO_CLIENT
+                                                                   : stream_direction::CLIENT_TO_SERVER;
+        }
+
+    } // namespace
+
+    std::span<const uint8_t> tls_transcript::content( const tls_transcript_record& record ) const {
+        return std::span<const uint8_t>( plaintext ).subspan( record.offset, record.length );
+    }
+
+    std::vector<uint8_t> tls_transcript::application_data( stream_direction direction ) const {
+
+        std::vector<uint8_t> data;
+
+        for ( auto& record : records ) {
+            if ( record.direction != direction || record.type != tls_content_type::APPLICATION_DATA ) continue;
+            auto bytes = content( record );
+            data.insert( data.end(), bytes.begin(), bytes.end() );
+        }
+
+        return data;
+    }
+
+    tls13_session_decoder::tls13_session_decoder( const key_log_store& key_log )
+        : m_key_log( key_log ) {}
+
+    std::expected<void,std::string> tls13_session_decoder::feed( stream_direction direction, std::span<const uint8_t> data ) {
+
+        if ( m_error ) return std::unexpected( *m_error );
+
+        auto& state = state_of( direction );
+
+        // nothing is waiting, so the payload is framed where it is and only a remainder is copied
+        if ( state.buffer.empty() ) {
+            process( direction, data );
+            if ( !m_error ) {
+                auto rest = data.subspan( state.framer.offset() );
+                state.buffer.assign( rest.begin(), rest.end() );
+                state.framer.reset();
+            }
+        } else {
+            state.buffer.insert( state.buffer.end(), data.begin(), data.end() );
+            process( direction, state.buffer );
+        }
+
+        if ( m_error ) return std::unexpected( *m_error );
+        return {};
+    }
+
+    std::expected<void,std::string> tls13_session_decoder::finish() {
+
+        if ( m_error ) return std::unexpected( *m_error );
+
+        for ( auto direction : { stream_direction::CLIENT_TO_SERVER, stream_direction::SERVER_TO_CLIENT } ) {
+
+            auto& state = state_of( direction );
+            if ( state.epoch == tls_epoch::PLAINTEXT || state.decryptor.is_keyed() ) continue;
+
+            // a whole record is there and nothing to decrypt it with
+            tls_record_framer framer;
+            if ( framer.next( state.buffer ) ) {
+                if ( !m_client || !m_server ) return std::unexpected( "Connection without both hellos" );
+                return std::unexpected( std::string( "No " ) + secret_label_name( label_for( direction, state.epoch ) ) +
+                                        " for client random" );
+            }
+        }
+
+        return {};
+    }
+
+    const std::optional<client_hello>& tls13_session_decoder::client() const {
+        return m_client;
+    }
+
+    const std::optional<server_hello>& tls13_session_decoder::server() const {
+        return m_server;
+    }
+
+    const tls_transcript& tls13_session_decoder::transcript() const {
+        return m_transcript;
+    }
+
+    tls_transcript tls13_session_decoder::take_transcript() {
+        return std::exchange( m_transcript, tls_transcript{} );
+    }
+
+    tls13_session_decoder::direction_state& tls13_session_decoder::state_of( stream_direction direction ) {
+        return direction == stream_direction::CLIENT_TO_SERVER ? m_client_to_server : m_server_to_client;
+    }
+
+    void tls13_session_decoder::fail( const std::string& reason ) {
+        m_error = reason;
+        std::vector<uint8_t>().swap( m_client_to_server.buffer );
+        std::vector<uint8_t>().swap( m_server_to_client.buffer );
+    }
+
+    bool tls13_session_decoder::ensure_keyed( stream_direction direction, direction_state& state ) {
+
+        if ( state.decryptor.is_keyed() ) return true;
+        if ( !m_client || !m_server ) return false;
+
+        auto secret = m_key_log.find( m_client->random, label_for( direction, state.epoch ) );
+        if ( !secret ) return false;
+
+        try {
+            state.decryptor.rekey( m_server->cipher_suite, *secret );
+        } catch ( const std::runtime_error& e ) {
+            fail( e.what() );
+            return false;
+        }
+
+        state.secret = std::move( *secret );
+        return true;
+    }
+
+    void tls13_session_decoder::process( stream_direction direction, std::span<const uint8_t> stream ) {
+
+        auto& state = state_of( direction );
+
+        while ( !m_error ) {
+
+            // a record is only taken off the stream once it can be dealt with
+            if ( state.epoch != tls_epoch::PLAINTEXT && !ensure_keyed( direction, state ) ) break;
+
+            auto view = state.framer.next( stream );
+            if ( !view ) break;
+
+            if ( view->content_type == tls_content_type::CHANGE_CIPHER_SEC ) continue;
+
+            auto& plaintext = m_transcript.plaintext;
+            const size_t offset = plaintext.size();
+
+            if ( state.epoch == tls_epoch::PLAINTEXT ) {
+
+                const auto& payload = view->payload;
+                const uint8_t expected_type = direction == stream_direction::CLIENT_TO_SERVER ? client_hello_type : server_hello_type;
+
+                if ( view->content_type != tls_content_type::HANDSHAKE || payload.empty() || payload[ 0 ] != expected_type ) {
+                    fail( "Stream does not start with a TLS hello" );
+                    break;
+                }
+
+                if ( direction == stream_direction::CLIENT_TO_SERVER ) {
+                    if ( payload.size() < min_client_hello ) {
+                        fail( "ClientHello too short" );
+                        break;
+                    }
+                    m_client = parse_client_hello( payload.subspan( 4 ) );
+                } else {
+                    if ( payload.size() < min_server_hello ) {
+                        fail( "ServerHello too short" );
+                        break;
+                    }
+                    m_server = parse_server_hello( payload.subspan( 4 ) );
+                }
+
+                plaintext.insert( plaintext.end(), payload.begin(), payload.end() );
+                m_transcript.records.push_back( { direction, view->content_type, tls_epoch::PLAINTEXT, 0, offset, payload.size() } );
+
+                state.epoch = tls_epoch::HANDSHAKE;
+                // the other direction may have been waiting on this hello for its secret
+                if ( m_client && m_server ) {
+                    auto other = other_direction( direction );
+                    process( other, state_of( other ).buffer );
+                }
+                continue;
+            }
+
+            // an alert sent in the clear, e.g. before the server could derive its keys
+            if ( view->content_type != tls_content_type::APPLICATION_DATA ) {
+                plaintext.insert( plaintext.end(), view->payload.begin(), view->payload.end() );
+                m_transcript.records.push_back( { direction, view->content_type, tls_epoch::PLAINTEXT, 0, offset, view->payload.size() } );
+                continue;
+            }
+
+            if ( view->payload.size() < tag_len ) {
+                fail( "Bad record length" );
+                break;
+            }
+
+            // decrypted in place at the end of the transcript
+            plaintext.resize( offset + view->payload.size() - tag_len );
+            auto len = state.decryptor.decrypt( view->content_type, view->version, view->payload,
+                                                std::span<uint8_t>( plaintext ).subspan( offset ) );
+            if ( !len ) {
+                plaintext.resize( offset );
+                fail( len.error() );
+                break;
+            }
+
+            // rfc 8446 5.2, the inner content type is the last byte that is not padding
+            size_t end = offset + *len;
+            while ( end > offset && plaintext[ end - 1 ] == 0 ) --end;
+            if ( end == offset ) {
+                plaintext.resize( offset );
+                fail( "Record without an inner content type" );
+                break;
+            }
+
+            auto type = static_cast<tls_content_type>( plaintext[ end - 1 ] );
+            plaintext.resize( end - 1 );
+            m_transcript.records.push_back( { direction, type, state.epoch, state.generation, offset, end - 1 - offset } );
+
+            if ( type != tls_content_type::HANDSHAKE ) continue;
+
+            // walk the messages, a Finished ends this direction's handshake and a KeyUpdate its generation
+            auto content = std::span<const uint8_t>( plaintext ).subspan( offset );
+            bool finished = false;
+            bool key_update = false;
+            state.handshake.feed( content );
+            while ( auto message = state.handshake.next() ) {
+                if ( state.epoch == tls_epoch::HANDSHAKE && *message == finished_type ) finished = true;
+                if ( state.epoch == tls_epoch::APPLICATION && *message == key_update_type ) key_update = true;
+            }
+
+            if ( finished ) {
+                state.epoch = tls_epoch::APPLICATION;
+                state.handshake.reset();
+                state.decryptor = tls_decryptor();
+            } else if ( key_update ) {
+                try {
+                    state.secret = next_traffic_secret( m_server->cipher_suite, state.secret );
+                    state.decryptor.rekey( m_server->cipher_suite, state.secret );
+                } catch ( const std::runtime_error& e ) {
+                    fail( e.what() );
+                    break;
+                }
+                ++state.generation;
+            }
+        }
+
+        if ( m_error ) return;
+
+        // a direction's own buffer keeps only what is not decoded, the caller keeps the rest of a fed payload
+        if ( stream.data() == state.buffer.data() && state.framer.offset() > 0 ) {
+            state.buffer.erase( state.buffer.begin(), state.buffer.begin() + state.framer.offset() );
+            state.framer.reset();
+        }
+    }
+
+    std::expected<tls_transcript,std::string> decode_tls13_session( const four_tuple& four, const session& packets,
+                                                                    const key_log_store& key_log ) {
+
+        tls13_session_decoder decoder( key_log );
+        const auto server_four = flip_four( four );
+
+        for ( auto& packet : packets ) {
+
+            auto decoded = decode_packet( packet );
+            if ( !decoded || decoded->payload.empty() ) continue;
+
+            auto packet_four = decoded->four();
+            std::expected<void,std::string> fed;
+            if ( packet_four == four ) {
+                fed = decoder.feed( stream_direction::CLIENT_TO_SERVER, decoded->payload );
+            } else if ( packet_four == server_four ) {
+                fed = decoder.feed( stream_direction::SERVER_TO_CLIENT, decoded->payload );
+            }
+            if ( !fed ) return std::unexpected( fed.error() );
+        }
+
+        if ( auto finished = decoder.finish(); !finished ) return std::unexpected( finished.error() );
+        return decoder.take_transcript();
+    }
+
+} // namespace ntk
@@ -0,0 +1,228 @@
+#include <tpacket_ring.hpp>
+
+#include <iostream>
+
+#include <cerrno>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace ntk {
+
+    tpacket_ring::tpacket_ring( const tpacket_options& options )
+        : m_options( options ), m_fd( -1 ), m_map( nullptr ), m_map_len( 0 ), m_stop( false ), m_statistics{ 0, 0, 0 } {}
+
+    tpacket_ring::~tpacket_ring() {
+        close();
+    }
+
+#ifdef __linux__
+
+    bool tpacket_ring::open( const char* device_name, const char* filter_exp ) {
+
+        m_fd = socket( AF_PACKET, SOCK_RAW, htons( ETH_P_ALL ) );
+        if ( m_fd < 0 ) {
+            std::cerr << "Error opening AF_PACKET socket" << std::endl;
+            return false;
+        }
+
+        int version = TPACKET_V3;
+        if ( setsockopt( m_fd, SOL_PACKET, PACKET_VERSION, &version, sizeof( version ) ) < 0 ) {
+            std::cerr << "Error selecting TPACKET_V3" << std::endl;
+            close();
+            return false;
+        }
+
+        if ( filter_exp && !attach_filter( filter_exp ) ) {
+            close();
+            return false;
+        }
+
+        tpacket_req3 req{};
+        req.tp_block_size = m_options.block_size;
+        req.tp_block_nr = m_options.block_count;
+        req.tp_frame_size = m_options.frame_size;
+        req.tp_frame_nr = ( m_options.block_size * m_options.block_count ) / m_options.frame_size;
+        req.tp_retire_blk_tov = m_options.retire_timeout_ms;
+        req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+
+        if ( setsockopt( m_fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof( req ) ) < 0 ) {
+            std::cerr << "Error setting up PACKET_RX_RING" << std::endl;
+            close();
+            return false;
+        }
+
+        m_map_len = m_options.block_size * m_options.block_count;
+        void* map = mmap( nullptr, m_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, m_fd, 0 );
+        // locking the ring needs CAP_IPC_LOCK or a large enough RLIMIT_MEMLOCK, it works unlocked as well
+        if ( map == MAP_FAILED && ( errno == EAGAIN || errno == EPERM ) ) {
+            map = mmap( nullptr, m_map_len, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0 );
+        }
+        if ( map == MAP_FAILED ) {
+            std::cerr << "Error mapping packet ring" << std::endl;
+            m_map_len = 0;
+            close();
+            return false;
+        }
+        m_map = static_cast<uint8_t*>( map );
+
+        sockaddr_ll addr{};
+        addr.sll_family = AF_PACKET;
+        addr.sll_protocol = htons( ETH_P_ALL );
+        addr.sll_ifindex = if_nametoindex( device_name );
+
+        if ( addr.sll_ifindex == 0 || bind( m_fd, reinterpret_cast<sockaddr*>( &addr ), sizeof( addr ) ) < 0 ) {
+            std::cerr << "Error binding to device: " << device_name << std::endl;
+            close();
+            return false;
+        }
+
+        m_stop = false;
+        m_statistics = tpacket_statistics{ 0, 0, 0 };
+        return true;
+    }
+
+    bool tpacket_ring::attach_filter( const char* filter_exp ) {
+
+        // compile with libpcap against a dead handle, the classic BPF program is what the socket expects
+        pcap_t* dead = pcap_open_dead( DLT_EN10MB, constants::max_snap_len );
+        struct bpf_program fp;
+
+        if ( pcap_compile( dead, &fp, filter_exp, 1, PCAP_NETMASK_UNKNOWN ) == -1 ) {
+            std::cerr << "Error compiling filter: " << pcap_geterr( dead ) << std::endl;
+            pcap_close( dead );
+            return false;
+        }
+
+        sock_fprog prog{};
+        prog.len = static_cast<unsigned short>( fp.bf_len );
+        prog.filter = reinterpret_cast<sock_filter*>( fp.bf_insns );
+
+        bool attached = setsockopt( m_fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof( prog ) ) == 0;
+        if ( !attached ) {
+            std::cerr << "Error attaching filter" << std::endl;
+        }
+
+        pcap_freecode( &fp );
+        pcap_close( dead );
+        return attached;
+    }
+
+    void tpacket_ring::run( const packet_batch_callback& callback ) {
+
+        size_t block_index = 0;
+
+        pollfd pfd{};
+        pfd.fd = m_fd;
+        pfd.events = POLLIN | POLLERR;
+
+        while ( !m_stop.load( std::memory_order_relaxed ) ) {
+
+            auto* block = m_map + block_index * m_options.block_size;
+            auto* desc = reinterpret_cast<tpacket_block_desc*>( block );
+
+            // acquire, so the frames the kernel wrote before handing the block over are seen
+            if ( ( __atomic_load_n( &desc->hdr.bh1.block_status, __ATOMIC_ACQUIRE ) & TP_STATUS_USER ) == 0 ) {
+                poll( &pfd, 1, m_options.poll_timeout_ms );
+                continue;
+            }
+
+            process_block( block, callback );
+
+            __atomic_store_n( &desc->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE );
+
+            block_index = ( block_index + 1 ) % m_options.block_count;
+        }
+    }
+
+    void tpacket_ring::process_block( uint8_t* block, const packet_batch_callback& callback ) {
+
+        auto* desc = reinterpret_cast<tpacket_block_desc*>( block );
+        uint32_t n_packets = desc->hdr.bh1.num_pkts;
+
+        m_frames.clear();
+        m_frames.reserve( n_packets );
+
+        auto* frame = reinterpret_cast<tpacket3_hdr*>( block + desc->hdr.bh1.offset_to_first_pkt );
+
+        for ( uint32_t i = 0; i < n_packets; ++i ) {
+
+            capture_frame captured;
+            captured.header.ts.tv_sec = frame->tp_sec;
+            captured.header.ts.tv_usec = frame->tp_nsec / 1000;
+            captured.header.caplen = frame->tp_snaplen;
+            captured.header.len = frame->tp_len;
+            captured.data = reinterpret_cast<const unsigned char*>( frame ) + frame->tp_mac;
+
+            m_frames.push_back( captured );
+
+            frame = reinterpret_cast<tpacket3_hdr*>( reinterpret_cast<uint8_t*>( frame ) + frame->tp_next_offset );
+        }
+
+        if ( !m_frames.empty() ) callback( m_frames );
+    }
+
+    tpacket_statistics tpacket_ring::statistics() {
+
+        std::lock_guard<std::mutex> lock( m_statistics_mutex );
+
+        if ( m_fd >= 0 ) {
+            tpacket_stats_v3 kernel_statistics{};
+            socklen_t len = sizeof( kernel_statistics );
+            if ( getsockopt( m_fd, SOL_PACKET, PACKET_STATISTICS, &kernel_statistics, &len ) == 0 ) {
+                m_statistics.packets += kernel_statistics.tp_packets;
+                m_statistics.drops += kernel_statistics.tp_drops;
+                m_statistics.queue_freezes += kernel_statistics.tp_freeze_q_cnt;
+            }
+        }
+
+        return m_statistics;
+    }
+
+    void tpacket_ring::close() {
+        if ( m_map ) {
+            munmap( m_map, m_map_len );
+            m_map = nullptr;
+            m_map_len = 0;
+        }
+        if ( m_fd >= 0 ) {
+            ::close( m_fd );
+            m_fd = -1;
+        }
+    }
+
+#else
+
+    bool tpacket_ring::open( const char* device_name, const char* filter_exp ) {
+        std::cerr << "TPACKET_V3 capture is only available on linux" << std::endl;
+        return false;
+    }
+
+    void tpacket_ring::run( const packet_batch_callback& callback ) {}
+
+    bool tpacket_ring::attach_filter( const char* filter_exp ) {
+        return false;
+    }
+
+    void tpacket_ring::close() {}
+
+    tpacket_statistics tpacket_ring::statistics() {
+        return m_statistics;
+    }
+
+#endif
+
+    void tpacket_ring::stop() {
+        m_stop = true;
+    }
+
+} // namespace ntk
@@ -1,8 +1,22 @@
 #include <udp.hpp>
 
+#include <algorithm>
+
+#include <ipv4.hpp>
+
 namespace ntk {
 
-    std::array<uint8_t,constants::udp_header_len> extract_udp_header( const unsigned char* ethernet_frame, 
+    namespace {
+
+        constexpr uint8_t udp_protocol = 17;
+
+        uint16_t read_u16( const uint8_t* p ) {
+            return static_cast<uint16_t>( ( p[ 0 ] << 8 ) | p[ 1 ] );
+        }
+
+    } // namespace
+
+    std::array<uint8_t,constants::udp_header_len> extract_udp_header( const unsigned char* ethernet_frame,
                                                                       const size_t ipv4_header_len ) {
 
         std::array<uint8_t,8> udp_header;
@@ -13,8 +27,290 @@ namespace ntk {
     udp_header parse_udp_header( const std::array<uint8_t,constants::udp_header_len>& raw_udp_header ) {
 
         udp_header header;
-        header.source_port = ( raw_udp_header[ 0 ] << 8 ) | raw_udp_header[ 1 ];
+        header.source_port = read_u16( raw_udp_header.data() );
+        header.destination_port = read_u16( raw_udp_header.data() + 2 );
+        header.length = read_u16( raw_udp_header.data() + 4 );
+        header.checksum = read_u16( raw_udp_header.data() + 6 );
         return header;
     }
 
-} // namespace ntk
\ No newline at end of file
+    bool is_udp( const unsigned char* ethernet_frame ) {
+        return read_u16( ethernet_frame + 12 ) == ethertypes::ipv4 &&
+               ethernet_frame[ constants::ethernet_header_len + 9 ] == udp_protocol;
+    }
+
+    std::optional<decoded_datagram> decode_datagram( std::span<const uint8_t> frame, const ip_layer& ip ) {
+
+        size_t udp_offset = ip.offset + ip.header_len;
+
+        if ( frame.size() < udp_offset + constants::udp_header_len ) return std::nullopt;
+
+        const uint8_t* udp = frame.data() + udp_offset;
+        size_t udp_len = read_u16( udp + 4 );
+        size_t payload_offset = udp_offset + constants::udp_header_len;
+
+        // a zero length is a jumbogram or segmentation offload, the datagram then runs to the end of the ip payload
+        if ( udp_len != 0 && udp_len < constants::udp_header_len ) return std::nullopt;
+        size_t udp_end = udp_len ? udp_offset + udp_len : ip.end;
+
+        // a snaplen-truncated frame keeps whatever payload was captured
+        size_t payload_end = std::min( { frame.size(), std::max( udp_end, payload_offset ), std::max( ip.end, payload_offset ) } );
+
+        return decoded_datagram{
+            .frame = frame,
+            .source_ip = ip.source_ip,
+            .destination_ip = ip.destination_ip,
+            .source_port = read_u16( udp ),
+            .destination_port = read_u16( udp + 2 ),
+            .ip_version = ip.version,
+            .network_offset = static_cast<uint16_t>( ip.offset ),
+            .ip_header_len = static_cast<uint16_t>( ip.header_len ),
+            .payload = frame.subspan( payload_offset, payload_end - payload_offset )
+        };
+    }
+
+    std::optional<decoded_datagram> decode_datagram( std::span<const uint8_t> frame ) {
+        auto ip = decode_ip_as<ethernet_link>( frame, udp_protocol );
+        if ( !ip ) return std::nullopt;
+        return decode_datagram( frame, *ip );
+    }
+
+    udp_flow::udp_flow( const four_tuple& four )
+        : m_four( four ) {}
+
+    const four_tuple& udp_flow::get_four_tuple() const {
+        return m_four;
+    }
+
+    const udp_direction_counters& udp_flow::client() const {
+        return m_client;
+    }
+
+    const udp_direction_counters& udp_flow::server() const {
+        return m_server;
+    }
+
+    std::optional<capture_time> udp_flow::first_packet() const {
+        return m_first_packet;
+    }
+
+    std::optional<capture_time> udp_flow::last_packet() const {
+        return m_last_packet;
+    }
+
+    std::optional<std::chrono::nanoseconds> udp_flow::duration() const {
+        if ( !m_first_packet || !m_last_packet ) return std::nullopt;
+        return *m_last_packet - *m_first_packet;
+    }
+
+    const std::vector<udp_datagram>& udp_flow::datagrams() const {
+        return m_datagrams;
+    }
+
+    bool udp_flow::datagrams_truncated() const {
+        return m_truncated;
+    }
+
+    close_reason udp_flow::reason() const {
+        return m_reason;
+    }
+
+    void udp_flow::feed( const decoded_datagram& datagram, std::optional<capture_time> timestamp, size_t max_datagrams ) {
+
+        bool from_client = datagram.four() == m_four;
+        auto& counters = from_client ? m_client : m_server;
+        counters.datagrams += 1;
+        counters.bytes += datagram.payload.size();
+
+        if ( timestamp ) {
+            if ( !m_first_packet ) m_first_packet = timestamp;
+            m_last_packet = timestamp;
+        }
+
+        if ( m_counters_only ) return;
+
+        if ( m_datagrams.size() < max_datagrams ) {
+            m_datagrams.push_back( udp_datagram{ from_client, timestamp, std::vector<uint8_t>( datagram.payload.begin(), datagram.payload.end() ) } );
+        } else {
+            m_truncated = true;
+        }
+    }
+
+    void udp_flow::keep_counters_only() {
+        m_counters_only = true;
+        std::vector<udp_datagram>().swap( m_datagrams );
+    }
+
+    udp_flow_session::udp_flow_session()
+        : m_offload_queue( nullptr ) {}
+
+    udp_flow_session::udp_flow_session( transfer_queue_interface<udp_flow>* offload_queue, const udp_session_limits& limits )
+        : m_offload_queue( offload_queue ), m_limits( limits ), m_fragments( limits.fragments ), m_link( link_layer_of( limits.link ) ) {}
+
+    void udp_flow_session::feed( const std::vector<uint8_t>& packet ) {
+        feed_packet( packet );
+    }
+
+    void udp_flow_session::feed( std::span<const uint8_t> packet ) {
+        feed_packet( packet );
+    }
+
+    void udp_flow_session::feed( const captured_packet& packet ) {
+        feed_packet( packet );
+        advance_time( packet.timestamp );
+    }
+
+    void udp_flow_session::advance_time( capture_time now ) {
+        m_fragments.advance_time( now );
+        m_expiry_timers.advance( now, [&]( const flow_key& key ) { expire( key, now ); } );
+    }
+
+    template<typename Packet>
+    void udp_flow_session::feed_packet( const Packet& packet ) {
+
+        std::span<const uint8_t> frame( packet.data(), packet.size() );
+
+        std::optional<capture_time> timestamp;
+        if constexpr ( std::is_same_v<Packet,captured_packet> ) timestamp = packet.timestamp;
+
+        std::optional<decoded_datagram> datagram;
+        if ( auto ip = m_link.ip( frame, udp_protocol ) ) datagram = decode_datagram( frame, *ip );
+
+        if ( !datagram ) {
+            // a fragment is held back until its datagram is whole, which is then fed in its place
+            auto network = m_link.network( frame );
+            if ( network && is_ipv4_fragment( frame, network->offset ) ) {
+                if ( m_fragments.feed( frame, timestamp, network->offset ) == fragment_result::COMPLETE ) {
+                    if constexpr ( std::is_same_v<Packet,captured_packet> ) {
+                        feed_packet( make_captured_packet( packet.timestamp, m_fragments.datagram() ) );
+                    } else {
+                        feed_packet( m_fragments.datagram() );
+                    }
+                }
+                return;
+            }
+            m_datagrams_fed.add();
+            m_datagrams_unmatched.add();
+            return;
+        }
+
+        m_datagrams_fed.add();
+
+        auto four = datagram->four();
+        flow_key key( four );
+
+        udp_flow* flow = m_flows.find( key );
+        bool is_new = !flow;
+
+        if ( is_new ) {
+            if ( !m_dropped.empty() && m_dropped.contains( key ) ) {
+                m_datagrams_unmatched.add();
+                return;
+            }
+            flow = &m_flows.emplace( key, four );
+            flow->m_classified = !m_classifier;
+            m_flows_opened.add();
+        }
+
+        flow->feed( *datagram, timestamp, m_limits.max_flow_datagrams );
+
+        if ( !flow->m_classified && four == flow->m_four ) {
+            // decided on the client's datagrams, before the flow is held for long
+            flow_verdict verdict = m_classifier( *flow );
+
+            if ( verdict == flow_verdict::DROP ) {
+                m_dropped.insert( key );
+                m_flows.erase( key );
+                m_flows_dropped.add();
+                return;
+            }
+
+            if ( verdict != flow_verdict::UNDECIDED ) {
+                flow->m_classified = true;
+                if ( verdict == flow_verdict::HEADERS_ONLY ) flow->keep_counters_only();
+            }
+        }
+
+        if ( is_new && timestamp ) schedule_expiry( key, *flow );
+    }
+
+    void udp_flow_session::schedule_expiry( const flow_key& key, const udp_flow& flow ) {
+
+        if ( !flow.m_first_packet ) return;
+
+        // the earlier of the two deadlines, expire() re-arms if the flow was active since
+        std::optional<capture_time> deadline;
+        if ( m_limits.idle_timeout.count() > 0 ) deadline = *flow.m_last_packet + m_limits.idle_timeout;
+        if ( m_limits.max_lifetime.count() > 0 ) {
+            capture_time end_of_life = *flow.m_first_packet + m_limits.max_lifetime;
+            if ( !deadline || end_of_life < *deadline ) deadline = end_of_life;
+        }
+
+        if ( deadline ) m_expiry_timers.schedule( key, *deadline );
+    }
+
+    void udp_flow_session::expire( const flow_key& key, capture_time now ) {
+
+        udp_flow* flow = m_flows.find( key );
+        if ( !flow ) return;
+
+        if ( m_limits.max_lifetime.count() > 0 && now - *flow->m_first_packet >= m_limits.max_lifetime ) {
+            m_flows_evicted.add();
+            close( key, close_reason::LIFETIME );
+        } else if ( m_limits.idle_timeout.count() > 0 && now - *flow->m_last_packet >= m_limits.idle_timeout ) {
+            m_flows_evicted.add();
+            close( key, close_reason::IDLE );
+        } else {
+            schedule_expiry( key, *flow );
+        }
+    }
+
+    void udp_flow_session::close( const flow_key& key, close_reason reason ) {
+
+        udp_flow* flow = m_flows.find( key );
+        if ( !flow ) return;
+
+        flow->m_reason = reason;
+
+        // without a queue there is nobody to hand the flow to, so it is dropped
+        if ( m_offload_queue ) {
+            m_offload_queue->push( std::move( *flow ) );
+            m_flows_offloaded.add();
+        }
+
+        m_flows.erase( key );
+    }
+
+    size_t udp_flow_session::flush() {
+
+        // collected first, closing erases from the table being walked
+        std::vector<flow_key> open;
+        for ( auto& flow : m_flows ) open.emplace_back( flow.get_four_tuple() );
+
+        for ( auto& key : open ) close( key, close_reason::SHUTDOWN );
+
+        return open.size();
+    }
+
+    size_t udp_flow_session::size() const {
+        return m_flows.size();
+    }
+
+    const udp_flow* udp_flow_session::find( const four_tuple& four ) const {
+        return m_flows.find( flow_key( four ) );
+    }
+
+    udp_session_statistics udp_flow_session::statistics() const {
+        return udp_session_statistics{ m_datagrams_fed.value(), m_datagrams_unmatched.value(), m_flows_opened.value(),
+                                       m_flows_offloaded.value(), m_flows_evicted.value(), m_flows_dropped.value() };
+    }
+
+    void udp_flow_session::set_classifier( udp_flow_classifier classifier ) {
+        m_classifier = std::move( classifier );
+    }
+
+    fragment_statistics udp_flow_session::fragments() const {
+        return m_fragments.statistics();
+    }
+
+} // namespace ntk
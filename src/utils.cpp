@@ -1,55 +1,35 @@
 #include <utils.hpp>
 
+#include <algorithm>
+#include <cerrno>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
 namespace ntk {
 
     session read_packets_from_file( const std::string& packet_data_file ) {
 
         std::vector<std::vector<uint8_t>> packets;
 
-        std::ifstream file_handle( packet_data_file );
-
-        if ( !file_handle.is_open() ) {
-            std::cerr << "Failed to open file: " << packet_data_file << '\n';
-            return packets;
-        }
-
-        std::string line;
-
-        while ( std::getline( file_handle, line ) ) {
-            
-            std::vector<uint8_t> packet;
-            std::istringstream iss( line );
-            std::string byte_string;
-
-            while ( iss >> byte_string ) {
-                uint8_t byte = static_cast<uint8_t>( std::stoul( byte_string, nullptr, 16 ) );
-                packet.push_back( byte );
-            }
+        capture_file file( packet_data_file );
 
-            if ( !packet.empty() ) {
-                packets.push_back( packet );
-            }
+        for ( auto packet : file ) {
+            packets.emplace_back( packet.begin(), packet.end() );
         }
 
         return packets;
     }
 
-    
     std::vector<uint8_t> parse_hex_line( const std::string& line ) {
-        
         std::vector<uint8_t> bytes;
-        std::istringstream iss(line);
-        std::string byte_str;
-
-        while ( iss >> byte_str ) {
-            uint8_t byte = static_cast<uint8_t>( std::stoul( byte_str, nullptr, 16 ) );
-            bytes.push_back( byte );
-        }
-
+        decode_hex_line( line, bytes );
         return bytes;
     }
 
-
     std::vector<std::streampos> index_line_offsets( const std::string& filename ) {
 
         std::ifstream file( filename );
@@ -224,8 +204,8 @@ namespace ntk {
     } 
 
     std::ostream& operator<<( std::ostream& os, const tls_live_stream& live_stream ) {
-        print_client_hello( live_stream.m_client_hello, os );
-        print_server_hello( live_stream.m_server_hello, os );
+        if ( auto& hello = live_stream.get_client_hello() ) print_client_hello( *hello, os );
+        if ( auto& hello = live_stream.get_server_hello() ) print_server_hello( *hello, os );
         return os;
     }
 
@@ -241,8 +221,8 @@ namespace ntk {
             os << std::left << std::setw( label_width ) << label << value << "\n";
         };
 
-        print_field( "Client IP:", four.client_ip );
-        print_field( "Server IP:", four.server_ip );
+        print_field( "Client IP:", ip_to_string( four.client_ip ) );
+        print_field( "Server IP:", ip_to_string( four.server_ip ) );
         print_field( "Client Port:", four.client_port );
         print_field( "Server Port:", four.server_port );
 
@@ -283,8 +263,18 @@ namespace ntk {
             print_packet( packet );
         }
 
-        for ( const auto& packet : live_stream.m_traffic ) {
-            print_packet( packet );
+        if ( live_stream.m_spill && live_stream.m_spill->is_mapped() ) {
+            for ( auto packet : live_stream.m_spill->frames() ) {
+                print_packet( std::vector<uint8_t>( packet.begin(), packet.end() ) );
+            }
+        }
+
+        for ( auto packet : live_stream.m_traffic ) {
+            print_packet( std::vector<uint8_t>( packet.begin(), packet.end() ) );
+        }
+
+        for ( const auto& packet : live_stream.m_pooled_traffic ) {
+            print_packet( packet.to_vector() );
         }
 
         if ( std::holds_alternative<fin_ack_fin_ack>( live_stream.m_termination_feed.m_termination.closing_sequence ) ) {
@@ -396,6 +386,63 @@ namespace ntk {
         out.write( reinterpret_cast<const char*>( payload.data() ), payload.size() );
     }
 
+#ifndef _WIN32
+
+    void write_payload_to_file( const http_body_view& payload, const std::string& filename ) {
+
+        int fd = ::open( filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+        if ( fd < 0 ) {
+            throw std::runtime_error( "Failed to open file for writing: " + filename );
+        }
+
+        // a batch at a time, at most as many pieces as one writev takes
+        constexpr size_t max_iov = 1024;
+        std::vector<iovec> iov;
+        iov.reserve( std::min( payload.pieces().size(), max_iov ) );
+
+        const auto& pieces = payload.pieces();
+        for ( size_t first = 0; first < pieces.size(); first += max_iov ) {
+
+            iov.clear();
+            for ( size_t i = first; i < std::min( pieces.size(), first + max_iov ); ++i ) {
+                iov.push_back( iovec{ const_cast<uint8_t*>( pieces[ i ].data() ), pieces[ i ].size() } );
+            }
+
+            // a short write leaves the rest of the batch for the next call
+            size_t next = 0;
+            while ( next < iov.size() ) {
+                ssize_t written = ::writev( fd, iov.data() + next, static_cast<int>( iov.size() - next ) );
+                if ( written < 0 ) {
+                    if ( errno == EINTR ) continue;
+                    ::close( fd );
+                    throw std::runtime_error( "Failed to write file: " + filename );
+                }
+                size_t left = static_cast<size_t>( written );
+                while ( next < iov.size() && left >= iov[ next ].iov_len ) left -= iov[ next++ ].iov_len;
+                if ( left > 0 ) {
+                    iov[ next ].iov_base = static_cast<uint8_t*>( iov[ next ].iov_base ) + left;
+                    iov[ next ].iov_len -= left;
+                }
+            }
+        }
+
+        ::close( fd );
+    }
+
+#else
+
+    void write_payload_to_file( const http_body_view& payload, const std::string& filename ) {
+        std::ofstream out( filename, std::ios::binary );
+        if ( !out ) {
+            throw std::runtime_error( "Failed to open file for writing: " + filename );
+        }
+        for ( auto piece : payload.pieces() ) {
+            out.write( reinterpret_cast<const char*>( piece.data() ), piece.size() );
+        }
+    }
+
+#endif
+
 } // namespace ntk
 
 
@@ -0,0 +1,140 @@
+#include <work_stealing_pool.hpp>
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+namespace ntk {
+
+    namespace {
+        thread_local const work_stealing_pool* t_pool = nullptr;
+        thread_local size_t t_index = 0;
+    }
+
+    work_stealing_pool::work_stealing_pool( size_t n_threads )
+        : m_next_queue( 0 ), m_queued( 0 ), m_pending( 0 ) {
+
+        if ( n_threads == 0 ) n_threads = std::max<size_t>( std::thread::hardware_concurrency(), 1 );
+
+        m_queues.reserve( n_threads );
+        for ( size_t i = 0; i < n_threads; ++i ) m_queues.push_back( std::make_unique<worker_queue>() );
+
+        m_threads.reserve( n_threads );
+        for ( size_t i = 0; i < n_threads; ++i ) {
+            m_threads.emplace_back( [ this, i ]( std::stop_token stop ) { run( stop, i ); } );
+        }
+    }
+
+    work_stealing_pool::~work_stealing_pool() {
+        wait_idle();
+        for ( auto& thread : m_threads ) thread.request_stop();
+        for ( auto& thread : m_threads ) thread.join();
+    }
+
+    void work_stealing_pool::submit( task t ) {
+
+        size_t index = on_pool_thread() ? t_index : m_next_queue.fetch_add( 1, std::memory_order_relaxed ) % m_queues.size();
+
+        m_pending.fetch_add( 1 );
+        {
+            std::lock_guard<std::mutex> lock( m_queues[ index ]->mutex );
+            m_queues[ index ]->tasks.push_back( std::move( t ) );
+        }
+        m_queued.fetch_add( 1 );
+
+        // taking the lock orders this against a thread about to sleep
+        { std::lock_guard<std::mutex> lock( m_mutex ); }
+        m_work_cv.notify_one();
+    }
+
+    bool work_stealing_pool::run_one() {
+
+        size_t index = on_pool_thread() ? t_index : 0;
+
+        task t;
+        if ( !( on_pool_thread() && pop( index, t ) ) && !steal( index, t ) ) return false;
+
+        execute( t );
+        return true;
+    }
+
+    void work_stealing_pool::wait_idle() {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        m_idle_cv.wait( lock, [ this ] { return m_pending.load() == 0; } );
+    }
+
+    bool work_stealing_pool::on_pool_thread() const {
+        return t_pool == this;
+    }
+
+    size_t work_stealing_pool::thread_count() const {
+        return m_queues.size();
+    }
+
+    void work_stealing_pool::run( std::stop_token stop, size_t index ) {
+
+        t_pool = this;
+        t_index = index;
+
+        while ( true ) {
+
+            task t;
+            if ( pop( index, t ) || steal( index, t ) ) {
+                execute( t );
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock( m_mutex );
+            m_work_cv.wait( lock, stop, [ this ] { return m_queued.load() > 0; } );
+            if ( stop.stop_requested() && m_queued.load() == 0 ) return;
+        }
+    }
+
+    bool work_stealing_pool::pop( size_t index, task& t ) {
+
+        auto& queue = *m_queues[ index ];
+
+        std::lock_guard<std::mutex> lock( queue.mutex );
+        if ( queue.tasks.empty() ) return false;
+
+        t = std::move( queue.tasks.back() );
+        queue.tasks.pop_back();
+        m_queued.fetch_sub( 1 );
+
+        return true;
+    }
+
+    bool work_stealing_pool::steal( size_t thief, task& t ) {
+
+        for ( size_t i = 1; i <= m_queues.size(); ++i ) {
+
+            auto& queue = *m_queues[ ( thief + i ) % m_queues.size() ];
+
+            std::lock_guard<std::mutex> lock( queue.mutex );
+            if ( queue.tasks.empty() ) continue;
+
+            t = std::move( queue.tasks.front() );
+            queue.tasks.pop_front();
+            m_queued.fetch_sub( 1 );
+
+            return true;
+        }
+
+        return false;
+    }
+
+    void work_stealing_pool::execute( task& t ) {
+
+        try {
+            t();
+        } catch ( const std::exception& e ) {
+            std::cerr << "Pool task failed: " << e.what() << '\n';
+        }
+
+        if ( m_pending.fetch_sub( 1 ) == 1 ) {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_idle_cv.notify_all();
+        }
+    }
+
+} // namespace ntk
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <ranges>
+#include <string>
+#include <vector>
+
+#include <capture_file.hpp>
+#include <pcap_file.hpp>
+#include <tcp.hpp>
+#include <utils.hpp>
+#include <test_constants.hpp>
+
+static_assert( std::ranges::forward_range<ntk::capture_file> );
+
+TEST( CaptureFileTests, CaptureFileMatchesSession ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto path = ( std::filesystem::temp_directory_path() / "ntk_capture_file.pcap" ).string();
+
+    {
+        ntk::capture_file_writer writer( path, ntk::capture_format::PCAP );
+        for ( auto& packet : packet_data ) writer.write( packet );
+    }
+
+    for ( auto& file_name : { test::packet_data_files[ "tiny_cross" ], path } ) {
+
+        ntk::capture_file file( file_name );
+
+        ASSERT_TRUE( file.is_open() );
+
+        size_t i = 0;
+        for ( auto packet : file ) {
+            ASSERT_LT( i, packet_data.size() );
+            ASSERT_EQ( std::vector<uint8_t>( packet.begin(), packet.end() ), packet_data[ i ] );
+            ++i;
+        }
+
+        ASSERT_EQ( i, packet_data.size() );
+    }
+
+    std::filesystem::remove( path );
+}
+
+TEST( CaptureFileTests, CaptureFileWriterRecordsItsDatalink ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    for ( auto [ name, format ] : { std::pair{ "ntk_capture_file_sll.pcap", ntk::capture_format::PCAP },
+                                    std::pair{ "ntk_capture_file_sll.pcapng", ntk::capture_format::PCAPNG } } ) {
+
+        auto path = ( std::filesystem::temp_directory_path() / name ).string();
+
+        {
+            ntk::capture_file_writer writer( path, format, ntk::constants::max_snap_len, 113 );
+            writer.write( packet_data[ 0 ] );
+        }
+
+        ntk::capture_file file( path );
+
+        ASSERT_TRUE( file.is_open() );
+        ASSERT_EQ( file.datalink(), 113 );
+        ASSERT_EQ( std::ranges::distance( file ), 1 );
+
+        std::filesystem::remove( path );
+    }
+}
+
+TEST( CaptureFileTests, CaptureFileIteratorIsMultiPass ) {
+
+    ntk::capture_file file( test::packet_data_files[ "tiny_cross" ] );
+
+    auto first = file.begin();
+    auto copy = first;
+
+    ++first;
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ASSERT_EQ( std::vector<uint8_t>( ( *copy ).begin(), ( *copy ).end() ), packet_data[ 0 ] );
+    ASSERT_EQ( std::vector<uint8_t>( ( *first ).begin(), ( *first ).end() ), packet_data[ 1 ] );
+    ASSERT_EQ( std::ranges::distance( file ), packet_data.size() );
+}
+
+TEST( CaptureFileTests, CaptureFileOfflineHelpers ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "checkerboard" ] );
+    ntk::capture_file file( test::packet_data_files[ "checkerboard" ] );
+
+    ASSERT_EQ( ntk::get_four_tuples( file ), ntk::get_four_tuples( packet_data ) );
+    ASSERT_EQ( ntk::get_merged_tcp_stream( file ), ntk::get_merged_tcp_stream( packet_data ) );
+}
+
+TEST( CaptureFileTests, CaptureFileFeedsLiveStreamSession ) {
+
+    ntk::capture_file file( test::packet_data_files[ "tiny_cross" ] );
+    ntk::tcp_live_stream_session live_stream_session;
+
+    for ( auto packet : file ) {
+        live_stream_session.feed( packet );
+    }
+
+    ASSERT_EQ( live_stream_session.number_of_completed_transfers(), 1 );
+}
+
+TEST( CaptureFileTests, MissingCaptureFileIsEmpty ) {
+
+    ntk::capture_file file( "does_not_exist.pcap" );
+
+    ASSERT_FALSE( file.is_open() );
+    ASSERT_TRUE( file.begin() == file.end() );
+}
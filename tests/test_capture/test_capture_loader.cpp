@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <capture_loader.hpp>
+#include <pcap_file.hpp>
+#include <utils.hpp>
+#include <test_constants.hpp>
+
+TEST( CaptureFileTests, ParallelLoadMatchesReadPackets ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "earth_cam_live_stream" ] );
+
+    auto directory = std::filesystem::temp_directory_path();
+    auto pcap = ( directory / "ntk_capture_loader.pcap" ).string();
+    auto pcapng = ( directory / "ntk_capture_loader.pcapng" ).string();
+
+    for ( auto& [ path, format ] : { std::pair{ pcap, ntk::capture_format::PCAP }, std::pair{ pcapng, ntk::capture_format::PCAPNG } } ) {
+        ntk::capture_file_writer writer( path, format );
+        for ( auto& packet : packet_data ) writer.write( packet );
+    }
+
+    for ( auto& file : { test::packet_data_files[ "earth_cam_live_stream" ], pcap, pcapng } ) {
+        // one thread, a few, and more threads than a small capture has packets
+        for ( size_t threads : { 1, 3, 8, 0 } ) {
+            auto arena = ntk::load_packets( file, threads );
+            ASSERT_EQ( arena.size(), packet_data.size() ) << file << " " << threads;
+            ASSERT_EQ( arena.to_session(), packet_data ) << file << " " << threads;
+        }
+    }
+
+    std::filesystem::remove( pcap );
+    std::filesystem::remove( pcapng );
+}
+
+TEST( CaptureFileTests, ParallelLoadSkipsBlankHexLines ) {
+
+    auto path = ( std::filesystem::temp_directory_path() / "ntk_capture_loader.txt" ).string();
+
+    {
+        std::ofstream file( path );
+        // blank lines, a CRLF line and no newline after the last packet
+        file << "01 02 03 \n\n\n0a 0b \r\n   \nff";
+    }
+
+    auto expected = ntk::read_packets_from_file( path );
+    ASSERT_EQ( expected.size(), 3 );
+
+    for ( size_t threads = 1; threads <= 16; ++threads ) {
+        auto arena = ntk::load_packets( path, threads );
+        ASSERT_EQ( arena.to_session(), expected ) << threads;
+        ASSERT_EQ( arena.size_bytes(), 6 );
+    }
+
+    std::filesystem::remove( path );
+
+    ASSERT_TRUE( ntk::load_packets( path ).empty() );
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <capture_replay.hpp>
+#include <captured_packet.hpp>
+#include <pcap_file.hpp>
+#include <spmc_queue.hpp>
+#include <tcp.hpp>
+#include <utils.hpp>
+#include <test_constants.hpp>
+
+namespace {
+
+    // pseudo header and segment summed, a correct checksum update leaves it as it was
+    uint32_t tcp_checksum_residual( const std::vector<uint8_t>& frame ) {
+
+        const uint8_t* ip = frame.data() + 14;
+        size_t ihl = ( ip[ 0 ] & 0x0f ) * 4;
+        size_t total = ( ip[ 2 ] << 8 ) | ip[ 3 ];
+        size_t segment = total - ihl;
+
+        uint32_t sum = 0;
+        for ( size_t i = 12; i < 20; i += 2 ) sum += ( ip[ i ] << 8 ) | ip[ i + 1 ];
+        sum += 6 + segment;
+        for ( size_t i = 0; i < segment; i += 2 ) {
+            sum += ( ip[ ihl + i ] << 8 ) | ( i + 1 < segment ? ip[ ihl + i + 1 ] : 0 );
+        }
+        while ( sum >> 16 ) sum = ( sum & 0xffff ) + ( sum >> 16 );
+        return sum;
+    }
+
+} // namespace
+
+TEST( CaptureReplayTests, EphemeralPortOffsetKeepsFlowsTogether ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto four = ntk::get_four_from_ethernet( packet_data[ 0 ] );
+    ASSERT_GT( four.client_port, four.server_port );
+
+    auto expected = four;
+    expected.client_port += 7;
+
+    for ( auto packet : packet_data ) {
+
+        uint32_t residual = tcp_checksum_residual( packet );
+
+        ASSERT_TRUE( ntk::offset_ephemeral_port( packet, 7 ) );
+        ASSERT_EQ( tcp_checksum_residual( packet ), residual );
+
+        // both directions still belong to the one flow, now on another port
+        auto moved = ntk::get_four_from_ethernet( packet );
+        ASSERT_TRUE( moved == expected || moved == ntk::flip_four( expected ) );
+    }
+
+    std::vector<uint8_t> too_short( 20, 0 );
+    ASSERT_FALSE( ntk::offset_ephemeral_port( too_short, 7 ) );
+}
+
+TEST( CaptureReplayTests, LoopsAndCopiesAreDistinctFlows ) {
+
+    ntk::replay_options options{ .pacing = ntk::replay_pacing::UNPACED, .loops = 3, .flow_copies = 2 };
+    ntk::capture_replay replay( test::packet_data_files[ "tiny_cross" ], options );
+
+    ASSERT_TRUE( replay.is_open() );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue );
+
+    ASSERT_TRUE( replay.start( [&]( const struct pcap_pkthdr* header, const unsigned char* packet ) {
+        auto bytes = std::span<const uint8_t>( packet, header->caplen );
+        live_stream_session.feed( ntk::make_captured_packet( header->ts.tv_sec, header->ts.tv_usec, header->len, bytes ) );
+    }));
+    replay.wait();
+
+    ASSERT_FALSE( replay.is_capturing() );
+    ASSERT_EQ( replay.report().packets, replay.frame_count() * 6 );
+    ASSERT_EQ( replay.statistics().received, replay.frame_count() * 6 );
+    ASSERT_EQ( live_stream_session.statistics().streams_offloaded, 6 );
+}
+
+TEST( CaptureReplayTests, FixedPacketRate ) {
+
+    ntk::replay_options options{ .pacing = ntk::replay_pacing::PACKETS_PER_SECOND, .rate = 2000 };
+    ntk::capture_replay replay( test::packet_data_files[ "tiny_cross" ], options );
+
+    ASSERT_TRUE( replay.start( []( const struct pcap_pkthdr*, const unsigned char* ) {} ) );
+    replay.wait();
+
+    auto report = replay.report();
+    auto expected = std::chrono::duration<double>( ( replay.frame_count() - 1 ) / 2000.0 );
+
+    ASSERT_EQ( report.packets, replay.frame_count() );
+    ASSERT_GE( report.elapsed, expected );
+    ASSERT_LT( report.elapsed, expected * 1.5 + std::chrono::milliseconds( 20 ) );
+}
+
+TEST( CaptureReplayTests, OriginalTimingScaled ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto path = ( std::filesystem::temp_directory_path() / "ntk_capture_replay.pcap" ).string();
+
+    // 2ms apart
+    {
+        ntk::capture_file_writer writer( path, ntk::capture_format::PCAP );
+        for ( size_t i = 0; i < packet_data.size(); ++i ) {
+            auto size = static_cast<uint32_t>( packet_data[ i ].size() );
+            writer.write( 1700000000, static_cast<uint32_t>( i * 2000 ), size, size, packet_data[ i ].data() );
+        }
+    }
+
+    ntk::capture_replay replay( path, ntk::replay_options{ .speed = 4.0, .restamp = false } );
+
+    uint32_t last_usec = 0;
+    ASSERT_TRUE( replay.start( [&]( const struct pcap_pkthdr* header, const unsigned char* ) {
+        last_usec = static_cast<uint32_t>( header->ts.tv_usec );
+    }));
+    replay.wait();
+
+    auto expected = std::chrono::microseconds( ( packet_data.size() - 1 ) * 2000 / 4 );
+
+    ASSERT_EQ( last_usec, ( packet_data.size() - 1 ) * 2000 );
+    ASSERT_GE( replay.report().elapsed, expected );
+    ASSERT_LT( replay.report().elapsed, expected * 1.5 + std::chrono::milliseconds( 20 ) );
+
+    std::filesystem::remove( path );
+}
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <flow_index.hpp>
+#include <flow_index_file.hpp>
+#include <link_layer.hpp>
+#include <pcap_file.hpp>
+#include <tcp.hpp>
+#include <utils.hpp>
+#include <test_constants.hpp>
+
+TEST( CaptureFileTests, FlowIndexFileReadsFlowsInPlace ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "checkerboard" ] );
+    ntk::flow_index expected( packet_data );
+
+    auto directory = std::filesystem::temp_directory_path();
+    auto pcap = ( directory / "ntk_flow_index_file.pcap" ).string();
+    auto pcapng = ( directory / "ntk_flow_index_file.pcapng" ).string();
+
+    for ( auto& [ path, format ] : { std::pair{ pcap, ntk::capture_format::PCAP }, std::pair{ pcapng, ntk::capture_format::PCAPNG } } ) {
+        ntk::capture_file_writer writer( path, format );
+        for ( auto& packet : packet_data ) writer.write( packet );
+    }
+
+    // the hex capture is indexed from where the tests read it, the index goes to the temp directory
+    std::vector<std::pair<std::string,std::string>> captures = {
+        { test::packet_data_files[ "checkerboard" ], ( directory / "ntk_flow_index_file.txt.flows" ).string() },
+        { pcap, ntk::flow_index_path( pcap ) },
+        { pcapng, ntk::flow_index_path( pcapng ) },
+    };
+
+    auto link = ntk::link_layer_of<ntk::ethernet_link>();
+
+    for ( auto& [ capture, index_path ] : captures ) {
+
+        auto written = ntk::write_flow_index( capture, index_path );
+        ASSERT_TRUE( written.has_value() ) << written.error();
+        ASSERT_EQ( *written, expected.size() );
+
+        ntk::flow_index_file index( capture, index_path );
+        ASSERT_TRUE( index.is_open() ) << index.error();
+        ASSERT_EQ( index.size(), expected.size() );
+
+        for ( auto& flow : expected.flows() ) {
+
+            auto found = index.find( flow.four );
+            ASSERT_NE( found, nullptr );
+            ASSERT_EQ( index.find( ntk::flip_four( flow.four ) ), found );
+            ASSERT_EQ( found->four, flow.four );
+
+            ntk::session packets;
+            for ( auto& p : flow.packets ) packets.push_back( expected.packet( p ) );
+            ASSERT_EQ( index.read_flow( flow.four ), packets );
+
+            auto records = index.packets( *found );
+            for ( size_t i = 0; i < records.size(); ++i ) {
+                ASSERT_EQ( records[ i ].reverse != 0, flow.packets[ i ].reverse );
+            }
+
+            auto handshake = ntk::get_handshake( flow.four, packet_data );
+            if ( handshake.ack.empty() ) {
+                ASSERT_EQ( found->handshake_end, ntk::flow_index_file::no_position );
+            } else {
+                ASSERT_NE( found->handshake_end, ntk::flow_index_file::no_position );
+                ASSERT_EQ( packets[ found->handshake_end ], handshake.ack );
+            }
+
+            if ( found->termination_start != ntk::flow_index_file::no_position ) {
+                auto decoded = link.decode( packets[ found->termination_start ] );
+                ASSERT_TRUE( decoded.has_value() );
+                ASSERT_TRUE( decoded->is_fin_ack() || decoded->is_reset() );
+            }
+
+            if ( capture == pcap ) {
+                auto timed = index.read_captured_flow( flow.four );
+                ASSERT_EQ( timed.size(), packets.size() );
+                ASSERT_EQ( timed.front().timestamp.time_since_epoch().count(), found->first_timestamp );
+            }
+        }
+    }
+
+    std::filesystem::remove( std::get<1>( captures[ 0 ] ) );
+    for ( auto& path : { pcap, pcapng } ) {
+        std::filesystem::remove( path );
+        std::filesystem::remove( ntk::flow_index_path( path ) );
+    }
+}
+
+TEST( CaptureFileTests, FlowIndexFileRefusesStaleIndexes ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto path = ( std::filesystem::temp_directory_path() / "ntk_flow_index_stale.pcap" ).string();
+
+    {
+        ntk::capture_file_writer writer( path, ntk::capture_format::PCAP );
+        for ( auto& packet : packet_data ) writer.write( packet );
+    }
+
+    ASSERT_TRUE( ntk::write_flow_index( path ).has_value() );
+    ASSERT_TRUE( ntk::flow_index_file( path ).is_open() );
+
+    // a packet count whose size in bytes wraps around to a few
+    {
+        uint64_t packet_count = UINT64_MAX / sizeof( ntk::flow_index_file::packet ) + 1;
+        std::fstream file( ntk::flow_index_path( path ), std::ios::binary | std::ios::in | std::ios::out );
+        file.seekp( 40 );
+        file.write( reinterpret_cast<const char*>( &packet_count ), sizeof( packet_count ) );
+    }
+    ASSERT_FALSE( ntk::flow_index_file( path ).is_open() );
+    ASSERT_TRUE( ntk::write_flow_index( path ).has_value() );
+
+    // one more packet and the offsets may no longer be where the index says
+    {
+        std::ofstream file( path, std::ios::binary | std::ios::app );
+        file.put( 0 );
+    }
+
+    ntk::flow_index_file stale( path );
+    ASSERT_FALSE( stale.is_open() );
+    ASSERT_EQ( stale.size(), 0 );
+    ASSERT_EQ( stale.find( ntk::get_four_from_ethernet( packet_data[ 0 ] ) ), nullptr );
+
+    {
+        std::ofstream file( ntk::flow_index_path( path ), std::ios::binary | std::ios::trunc );
+        file << "not an index";
+    }
+    ASSERT_FALSE( ntk::flow_index_file( path ).is_open() );
+
+    std::filesystem::remove( ntk::flow_index_path( path ) );
+    ASSERT_FALSE( ntk::flow_index_file( path ).is_open() );
+
+    std::filesystem::remove( path );
+}
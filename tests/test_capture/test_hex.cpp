@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <hex.hpp>
+#include <utils.hpp>
+#include <test_constants.hpp>
+
+namespace {
+
+    // the istringstream / std::stoul decoding parse_hex_line used to do
+    std::vector<uint8_t> legacy_parse_hex_line( const std::string& line ) {
+        std::vector<uint8_t> bytes;
+        std::istringstream iss( line );
+        std::string byte_str;
+        while ( iss >> byte_str ) {
+            bytes.push_back( static_cast<uint8_t>( std::stoul( byte_str, nullptr, 16 ) ) );
+        }
+        return bytes;
+    }
+
+    std::vector<uint8_t> scalar_decode( const std::string& line ) {
+        std::vector<uint8_t> bytes( ntk::max_decoded_hex_len( line.size() ) );
+        bytes.resize( ntk::decode_hex_line_scalar( line, bytes.data() ) );
+        return bytes;
+    }
+
+} // namespace
+
+TEST( CaptureFileTests, HexDecoderMatchesLegacyParser ) {
+
+    for ( auto& name : { "tiny_cross", "checkerboard", "tls_handshake" } ) {
+
+        std::ifstream file( test::packet_data_files[ name ] );
+        std::string line;
+
+        while ( std::getline( file, line ) ) {
+            auto expected = legacy_parse_hex_line( line );
+            ASSERT_EQ( ntk::parse_hex_line( line ), expected );
+            ASSERT_EQ( scalar_decode( line ), expected );
+        }
+    }
+}
+
+TEST( CaptureFileTests, HexDecoderIrregularLines ) {
+
+    std::mt19937 rng( 7 );
+    const std::string alphabet = "0123456789abcdefABCDEF";
+
+    for ( int round = 0; round < 2000; ++round ) {
+
+        // well-formed pairs with the odd irregular token dropped in
+        std::string line;
+        size_t n_tokens = rng() % 200;
+        for ( size_t i = 0; i < n_tokens; ++i ) {
+            switch ( rng() % 40 ) {
+                case 0: line += "abc "; break;
+                case 1: line += "f\t"; break;
+                case 2: line += "  "; break;
+                case 3: line += "0G "; break;
+                default:
+                    line += alphabet[ rng() % alphabet.size() ];
+                    line += alphabet[ rng() % alphabet.size() ];
+                    line += ' ';
+            }
+        }
+        if ( rng() % 2 && !line.empty() ) line.pop_back();
+
+        ASSERT_EQ( ntk::parse_hex_line( line ), scalar_decode( line ) ) << line;
+    }
+}
+
+TEST( CaptureFileTests, HexDecoderCasesAndSeparators ) {
+    ASSERT_EQ( ntk::parse_hex_line( "AB cd\t0f\r" ), std::vector<uint8_t>( { 0xab, 0xcd, 0x0f } ) );
+    ASSERT_EQ( ntk::parse_hex_line( "1234 5" ), std::vector<uint8_t>( { 0x34, 0x05 } ) );
+    ASSERT_EQ( ntk::parse_hex_line( "1z 22" ), std::vector<uint8_t>( { 0x01, 0x22 } ) );
+    ASSERT_TRUE( ntk::parse_hex_line( "" ).empty() );
+}
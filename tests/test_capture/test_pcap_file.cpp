@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <pcap_file.hpp>
+#include <utils.hpp>
+#include <test_constants.hpp>
+
+namespace {
+
+    std::string temp_capture_path( const std::string& name ) {
+        return ( std::filesystem::temp_directory_path() / name ).string();
+    }
+
+    void round_trip( ntk::capture_format format, const std::string& name ) {
+
+        auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+        auto path = temp_capture_path( name );
+
+        {
+            ntk::capture_file_writer writer( path, format );
+            ASSERT_TRUE( writer.is_open() );
+
+            uint32_t ts_sec = 1700000000;
+            for ( size_t i = 0; i < packet_data.size(); ++i ) {
+                auto& packet = packet_data[ i ];
+                writer.write( ts_sec + i, i * 1000, packet.size(), packet.size() + 4, packet.data() );
+            }
+        }
+
+        ASSERT_EQ( ntk::detect_capture_format( path ), format );
+        ASSERT_EQ( ntk::read_packets_from_file( path ), packet_data );
+
+        auto records = ntk::read_capture_records( path );
+
+        ASSERT_TRUE( records.has_value() );
+        ASSERT_EQ( records->size(), packet_data.size() );
+
+        for ( size_t i = 0; i < records->size(); ++i ) {
+            ASSERT_EQ( ( *records )[ i ].ts_sec, 1700000000 + i );
+            ASSERT_EQ( ( *records )[ i ].ts_usec, i * 1000 );
+            ASSERT_EQ( ( *records )[ i ].len, packet_data[ i ].size() + 4 );
+        }
+
+        std::filesystem::remove( path );
+    }
+
+} // namespace
+
+TEST( CaptureFileTests, PcapRoundTrip ) {
+    round_trip( ntk::capture_format::PCAP, "ntk_round_trip.pcap" );
+}
+
+TEST( CaptureFileTests, PcapngRoundTrip ) {
+    round_trip( ntk::capture_format::PCAPNG, "ntk_round_trip.pcapng" );
+}
+
+TEST( CaptureFileTests, HexWriterMatchesTextReader ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto path = temp_capture_path( "ntk_round_trip.txt" );
+
+    {
+        ntk::capture_file_writer writer( path, ntk::capture_format::HEX );
+        for ( auto& packet : packet_data ) writer.write( packet );
+    }
+
+    ASSERT_EQ( ntk::detect_capture_format( path ), ntk::capture_format::HEX );
+    ASSERT_EQ( ntk::read_packets_from_file( path ), packet_data );
+
+    std::filesystem::remove( path );
+}
+
+TEST( CaptureFileTests, FormatFromFilename ) {
+    ASSERT_EQ( ntk::capture_format_from_filename( "capture.pcap" ), ntk::capture_format::PCAP );
+    ASSERT_EQ( ntk::capture_format_from_filename( "capture.pcapng" ), ntk::capture_format::PCAPNG );
+    ASSERT_EQ( ntk::capture_format_from_filename( "capture.txt" ), ntk::capture_format::HEX );
+}
+
+TEST( CaptureFileTests, TruncatedPcapIsRejected ) {
+
+    std::vector<uint8_t> data( 24 + 16, 0 );
+    uint32_t magic = ntk::pcap_constants::pcap_magic_usec;
+    uint32_t caplen = 100;
+
+    std::memcpy( data.data(), &magic, sizeof( magic ) );
+    std::memcpy( data.data() + 24 + 8, &caplen, sizeof( caplen ) );
+
+    ASSERT_FALSE( ntk::parse_capture_records( data.data(), data.size() ).has_value() );
+}
+
+TEST( CaptureFileTests, UnrepresentableTimestampResolutionIsRejected ) {
+
+    auto capture_with_tsresol = []( uint8_t tsresol ) {
+        std::vector<uint8_t> data;
+        auto append = [&]( auto value ) {
+            auto* bytes = reinterpret_cast<const uint8_t*>( &value );
+            data.insert( data.end(), bytes, bytes + sizeof( value ) );
+        };
+
+        append( ntk::pcap_constants::pcapng_section_header );
+        append( uint32_t( 28 ) );
+        append( ntk::pcap_constants::pcapng_byte_order_magic );
+        append( uint16_t( 1 ) );
+        append( uint16_t( 0 ) );
+        append( int64_t( -1 ) );
+        append( uint32_t( 28 ) );
+
+        append( ntk::pcap_constants::pcapng_interface_description );
+        append( uint32_t( 32 ) );
+        append( uint16_t( ntk::pcap_constants::link_type_ethernet ) );
+        append( uint16_t( 0 ) );
+        append( uint32_t( 65535 ) );
+        append( ntk::pcap_constants::pcapng_option_tsresol );
+        append( uint16_t( 1 ) );
+        append( uint32_t( tsresol ) );
+        append( uint32_t( 0 ) );
+        append( uint32_t( 32 ) );
+
+        return data;
+    };
+
+    // the largest of each still fit in 64 bits
+    for ( uint8_t tsresol : { uint8_t( 19 ), uint8_t( 0x80 | 63 ) } ) {
+        auto capture = capture_with_tsresol( tsresol );
+        ASSERT_TRUE( ntk::parse_capture_records( capture.data(), capture.size() ).has_value() );
+    }
+
+    // 10^20 wraps and 1 << 64 is undefined, neither may become a divisor
+    for ( uint8_t tsresol : { uint8_t( 20 ), uint8_t( 0x7f ), uint8_t( 0x80 | 64 ), uint8_t( 0xff ) } ) {
+        auto capture = capture_with_tsresol( tsresol );
+        ASSERT_FALSE( ntk::parse_capture_records( capture.data(), capture.size() ).has_value() );
+    }
+}
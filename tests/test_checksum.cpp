@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <span>
+#include <vector>
+#include <cstdint>
+
+#include <checksum.hpp>
+#include <decoded_packet.hpp>
+#include <tcp.hpp>
+#include <utils.hpp>
+
+#include "test_constants.hpp"
+
+namespace {
+
+    const uint32_t capturing_host = 0xc0a80015;    // 192.168.0.21
+
+    // the first frame of the capture whose checksums are all valid and that carries payload
+    std::vector<uint8_t> valid_data_frame( const std::vector<std::vector<uint8_t>>& packets ) {
+        for ( const auto& packet : packets ) {
+            auto decoded = ntk::decode_packet( packet );
+            if ( !decoded || decoded->payload.empty() ) continue;
+            auto result = ntk::verify_checksums( *decoded );
+            if ( result.ip == ntk::checksum_status::VALID && result.tcp == ntk::checksum_status::VALID ) return packet;
+        }
+        return {};
+    }
+
+    ntk::checksum_result verify( const std::vector<uint8_t>& frame ) {
+        return ntk::verify_checksums( *ntk::decode_packet( frame ) );
+    }
+
+}
+
+TEST( ChecksumTests, OnesComplementSum ) {
+
+    // rfc 1071 3
+    std::vector<uint8_t> example = { 0x00, 0x01, 0xf2, 0x03, 0xf4, 0xf5, 0xf6, 0xf7 };
+    ASSERT_EQ( ntk::ones_complement_sum( example ), 0xddf2 );
+    ASSERT_EQ( ntk::ones_complement_sum( std::span<const uint8_t>( example ).first( 7 ) ), 0xddf2 - 0xf7 );
+    ASSERT_EQ( ntk::ones_complement_add( 0xfff0, 0x0020 ), 0x0011 );
+
+    // whatever kernel was picked agrees with the scalar loop, at every length and alignment
+    std::mt19937 rng( 55 );
+    std::vector<uint8_t> bytes( 4096 );
+    for ( auto& b : bytes ) b = static_cast<uint8_t>( rng() );
+    std::fill( bytes.begin() + 2048, bytes.end(), 0xff );
+
+    for ( size_t len = 0; len < 600; ++len ) {
+        for ( size_t offset : { 0, 1, 3 } ) {
+            auto span = std::span<const uint8_t>( bytes ).subspan( offset, len );
+            ASSERT_EQ( ntk::ones_complement_sum( span ), ntk::ones_complement_sum_scalar( span ) ) << len << " at " << offset;
+        }
+    }
+
+    ASSERT_EQ( ntk::ones_complement_sum( bytes ), ntk::ones_complement_sum_scalar( bytes ) );
+}
+
+TEST( ChecksumTests, CapturedFramesVerify ) {
+
+    auto packets = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    size_t valid = 0, offloaded = 0;
+    for ( const auto& packet : packets ) {
+        auto decoded = ntk::decode_packet( packet );
+        ASSERT_TRUE( decoded.has_value() );
+
+        auto result = ntk::verify_checksums( *decoded );
+        ASSERT_FALSE( result.invalid() );
+        ASSERT_EQ( result.ip, ntk::checksum_status::VALID );
+
+        // captured on the way out, before the nic filled in the tcp checksum
+        if ( result.tcp == ntk::checksum_status::OFFLOADED ) {
+            ASSERT_EQ( decoded->source_ip, capturing_host );
+            ++offloaded;
+        }
+        if ( result.tcp == ntk::checksum_status::VALID ) ++valid;
+    }
+
+    ASSERT_GT( valid, 0 );
+    ASSERT_GT( offloaded, 0 );
+}
+
+TEST( ChecksumTests, DetectsCorruption ) {
+
+    auto frame = valid_data_frame( ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] ) );
+    ASSERT_FALSE( frame.empty() );
+
+    auto decoded = *ntk::decode_packet( frame );
+    size_t ip = decoded.network_offset;
+    size_t tcp = ip + decoded.ip_header_len;
+
+    auto payload_flipped = frame;
+    payload_flipped.back() ^= 0x10;
+    ASSERT_EQ( verify( payload_flipped ).tcp, ntk::checksum_status::INVALID );
+    ASSERT_EQ( verify( payload_flipped ).ip, ntk::checksum_status::VALID );
+
+    // the ttl is in the ip header only, the tcp pseudo header does not cover it
+    auto ttl_flipped = frame;
+    ttl_flipped[ ip + 8 ] ^= 0x01;
+    ASSERT_EQ( verify( ttl_flipped ).ip, ntk::checksum_status::INVALID );
+    ASSERT_EQ( verify( ttl_flipped ).tcp, ntk::checksum_status::VALID );
+
+    // zeroed fields are left to the nic rather than wrong
+    ttl_flipped[ ip + 10 ] = ttl_flipped[ ip + 11 ] = 0x00;
+    ASSERT_EQ( verify( ttl_flipped ).ip, ntk::checksum_status::OFFLOADED );
+    payload_flipped[ tcp + 16 ] = payload_flipped[ tcp + 17 ] = 0x00;
+    ASSERT_EQ( verify( payload_flipped ).tcp, ntk::checksum_status::OFFLOADED );
+    ASSERT_FALSE( verify( payload_flipped ).invalid() );
+
+    // cut short by the snaplen, the segment cannot be summed
+    frame.resize( frame.size() - 1 );
+    ASSERT_EQ( verify( frame ).tcp, ntk::checksum_status::UNVERIFIABLE );
+    std::vector<uint8_t> header_only( test::ethernet_frame_tcp, test::ethernet_frame_tcp + sizeof( test::ethernet_frame_tcp ) );
+    ASSERT_EQ( verify( header_only ).tcp, ntk::checksum_status::UNVERIFIABLE );
+
+    ntk::checksum_counters counters;
+    counters.count( verify( frame ) );
+    counters.count( verify( payload_flipped ) );
+    counters.count( verify( ttl_flipped ) );
+    counters.count( { ntk::checksum_status::INVALID, ntk::checksum_status::INVALID } );
+
+    auto statistics = counters.statistics();
+    ASSERT_EQ( statistics.verified, 0 );
+    ASSERT_EQ( statistics.unverifiable, 1 );
+    ASSERT_EQ( statistics.offloaded, 2 );
+    ASSERT_EQ( statistics.ip_invalid, 1 );
+    ASSERT_EQ( statistics.tcp_invalid, 1 );
+}
+
+TEST( ChecksumTests, SessionDropsCorruptFrames ) {
+
+    auto packets = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto frame = valid_data_frame( packets );
+
+    size_t offloaded = 0;
+    for ( auto& packet : packets ) {
+        if ( verify( packet ).tcp == ntk::checksum_status::OFFLOADED ) ++offloaded;
+        if ( packet == frame ) packet.back() ^= 0x10;
+    }
+
+    ntk::session_limits limits;
+    limits.verify_checksums = true;
+    ntk::tcp_live_stream_session session( nullptr, limits );
+
+    for ( const auto& packet : packets ) session.feed( packet );
+
+    auto checksums = session.checksums();
+    ASSERT_EQ( checksums.tcp_invalid, 1 );
+    ASSERT_EQ( checksums.ip_invalid, 0 );
+    ASSERT_EQ( checksums.offloaded, offloaded );
+    ASSERT_EQ( checksums.verified, packets.size() - offloaded - 1 );
+    ASSERT_EQ( session.statistics().packets_fed, packets.size() );
+
+    // off by default
+    ntk::tcp_live_stream_session unchecked;
+    for ( const auto& packet : packets ) unchecked.feed( packet );
+    ASSERT_EQ( unchecked.checksums().tcp_invalid, 0 );
+}
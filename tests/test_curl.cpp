@@ -1,7 +1,61 @@
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
 #include <requests.hpp>
 
 TEST( CurlRequestTests, SimpleGoogleRequest ) {
     ASSERT_TRUE( ntk::make_request_curl( "https://www.google.com" ) );
-}
\ No newline at end of file
+}
+
+namespace {
+
+    // file:// needs no network, each request still goes through the multi handle
+    std::string local_file_url( size_t size ) {
+        auto path = std::filesystem::temp_directory_path() / "ntk_load_generator.bin";
+        std::ofstream( path, std::ios::binary ) << std::string( size, 'x' );
+        return "file://" + path.string();
+    }
+
+} // namespace
+
+TEST( CurlRequestTests, LoadGeneratorCompletesEveryRequest ) {
+
+    ntk::curl_load_generator generator( ntk::load_options{
+        .urls = { local_file_url( 1000 ) }, .total_requests = 200, .max_concurrent = 16 } );
+
+    ASSERT_TRUE( generator.run() );
+
+    auto statistics = generator.statistics();
+
+    ASSERT_EQ( statistics.started, 200 );
+    ASSERT_EQ( statistics.completed, 200 );
+    ASSERT_EQ( statistics.failed, 0 );
+    ASSERT_EQ( statistics.bytes_received, 200 * 1000 );
+    ASSERT_EQ( statistics.latency.count(), 200 );
+}
+
+TEST( CurlRequestTests, LoadGeneratorKeepsToTheRate ) {
+
+    ntk::curl_load_generator generator( ntk::load_options{
+        .urls = { local_file_url( 10 ) }, .total_requests = 20, .requests_per_second = 200 } );
+
+    ASSERT_TRUE( generator.run() );
+
+    // the last of 20 starts 95ms in
+    ASSERT_EQ( generator.statistics().completed, 20 );
+    ASSERT_GE( generator.statistics().elapsed, std::chrono::milliseconds( 90 ) );
+}
+
+TEST( CurlRequestTests, LoadGeneratorCountsFailures ) {
+
+    ntk::curl_load_generator generator( ntk::load_options{
+        .urls = { "file:///nonexistent/ntk" }, .total_requests = 5 } );
+
+    ASSERT_TRUE( generator.run() );
+    ASSERT_EQ( generator.statistics().failed, 5 );
+    ASSERT_FALSE( generator.statistics().first_error.empty() );
+}
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <flow_table.hpp>
+#include <tcp.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+TEST( DataStructureTests, FlowTableEmplaceFindErase ) {
+
+    ntk::flow_table<int,std::string> table;
+
+    table.emplace( 1, "one" );
+    table.emplace( 2, "two" );
+
+    ASSERT_EQ( table.size(), 2 );
+    ASSERT_EQ( *table.find( 1 ), "one" );
+    ASSERT_EQ( table.find( 3 ), nullptr );
+
+    ASSERT_TRUE( table.erase( 1 ) );
+    ASSERT_FALSE( table.erase( 1 ) );
+    ASSERT_FALSE( table.contains( 1 ) );
+    ASSERT_EQ( table.size(), 1 );
+
+    // the freed slot is reused rather than growing the slots
+    table.emplace( 3, "three" );
+
+    std::vector<std::string> values( table.begin(), table.end() );
+    ASSERT_EQ( values, std::vector<std::string>( { "three", "two" } ) );
+}
+
+TEST( DataStructureTests, FlowTableLiveStreamSessionDropsCompletedFlows ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue );
+
+    for ( auto& packet : packet_data ) {
+        live_stream_session.feed( packet );
+    }
+
+    auto& live_streams = ntk::tcp_live_stream_session_friend_helper::live_streams( live_stream_session );
+
+    ASSERT_TRUE( live_streams.empty() );
+    ASSERT_EQ( live_stream_session.statistics().streams_offloaded, 1 );
+}
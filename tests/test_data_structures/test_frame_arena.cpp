@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include <memory_resource>
+#include <vector>
+
+#include <frame_arena.hpp>
+#include <tcp.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+namespace {
+
+    // counts what reaches the upstream, to tell how often the arena went back for more
+    class counting_resource : public std::pmr::memory_resource {
+        public:
+            size_t allocations = 0;
+            size_t outstanding = 0;
+        private:
+            void* do_allocate( size_t bytes, size_t alignment ) override {
+                ++allocations;
+                ++outstanding;
+                return std::pmr::new_delete_resource()->allocate( bytes, alignment );
+            }
+
+            void do_deallocate( void* p, size_t bytes, size_t alignment ) override {
+                --outstanding;
+                std::pmr::new_delete_resource()->deallocate( p, bytes, alignment );
+            }
+
+            bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept override {
+                return this == &other;
+            }
+    };
+
+} // namespace
+
+TEST( DataStructureTests, FrameArenaKeepsFrames ) {
+
+    counting_resource upstream;
+    ntk::frame_arena arena( &upstream );
+
+    ASSERT_EQ( upstream.allocations, 0 );
+
+    std::vector<uint8_t> frame( 1500, 0xab );
+    for ( size_t i = 0; i < 1000; ++i ) {
+        frame[ 0 ] = static_cast<uint8_t>( i );
+        arena.push_back( frame );
+    }
+
+    ASSERT_EQ( arena.size(), 1000 );
+    ASSERT_EQ( arena[ 7 ][ 0 ], 7 );
+    ASSERT_EQ( arena[ 7 ].size(), 1500 );
+
+    // blocks grow geometrically, far fewer than one per frame
+    ASSERT_LT( upstream.allocations, 20 );
+
+    ntk::frame_arena copy( arena );
+    ntk::frame_arena moved( std::move( arena ) );
+
+    ASSERT_EQ( copy.size(), moved.size() );
+    ASSERT_NE( copy[ 999 ].data(), moved[ 999 ].data() );
+    ASSERT_TRUE( std::ranges::equal( copy[ 999 ], moved[ 999 ] ) );
+
+    moved.release();
+    copy.release();
+
+    ASSERT_TRUE( moved.empty() );
+    ASSERT_EQ( upstream.outstanding, 0 );
+}
+
+TEST( DataStructureTests, SessionUsesFrameUpstream ) {
+
+    counting_resource upstream;
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue, ntk::session_limits{ .frame_upstream = &upstream } );
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    for ( auto& packet : packet_data ) live_stream_session.feed( packet );
+
+    auto stream = offload_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+
+    ASSERT_TRUE( stream.has_value() );
+    ASSERT_GT( upstream.allocations, 0 );
+    ASSERT_LT( upstream.allocations, ntk::tcp_live_stream_friend_helper::traffic( *stream ).size() );
+
+    stream.reset();
+    ASSERT_EQ( upstream.outstanding, 0 );
+}
+
+TEST( DataStructureTests, FrameArenaSealsCompressedFrames ) {
+
+    ntk::frame_arena arena;
+
+    std::vector<std::vector<uint8_t>> fed;
+    for ( size_t i = 0; i < 300; ++i ) {
+        std::vector<uint8_t> frame( 100 + i % 1400, static_cast<uint8_t>( i ) );
+        arena.push_back( frame );
+        fed.push_back( frame );
+        // the first ones go in before compress(), which seals them too
+        if ( i == 10 ) arena.compress( 4096 );
+    }
+
+    size_t raw = 0;
+    for ( auto& frame : fed ) raw += frame.size();
+
+    ASSERT_EQ( arena.size(), fed.size() );
+    ASSERT_LT( arena.stored_bytes(), raw / 10 );
+
+    // read without inflating anything for good, and copied the same way
+    std::vector<std::vector<uint8_t>> visited;
+    arena.for_each( [&]( std::span<const uint8_t> frame ) { visited.emplace_back( frame.begin(), frame.end() ); } );
+    ASSERT_EQ( visited, fed );
+    ASSERT_LT( arena.stored_bytes(), raw / 10 );
+
+    ntk::frame_arena copy( arena );
+    ASSERT_EQ( copy.stored_bytes(), raw );
+
+    // the first read inflates every block
+    ASSERT_TRUE( std::ranges::equal( arena[ 299 ], fed[ 299 ] ) );
+    ASSERT_EQ( arena.stored_bytes(), raw );
+    ASSERT_EQ( arena.size(), fed.size() );
+    for ( size_t i = 0; i < fed.size(); ++i ) {
+        ASSERT_TRUE( std::ranges::equal( arena[ i ], fed[ i ] ) );
+        ASSERT_TRUE( std::ranges::equal( copy[ i ], fed[ i ] ) );
+    }
+
+    arena.release();
+    ASSERT_TRUE( arena.empty() );
+    ASSERT_EQ( arena.stored_bytes(), 0 );
+}
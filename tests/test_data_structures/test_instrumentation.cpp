@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <instrumentation.hpp>
+#include <spmc_queue.hpp>
+#include <stream_processor.hpp>
+#include <tcp.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+TEST( DataStructureTests, HistogramBucketsBoundTheError ) {
+
+    size_t previous = 0;
+
+    for ( uint64_t value : { 0ull, 1ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull, 1ull << 40, ~0ull } ) {
+
+        size_t index = ntk::histogram_buckets::index( value );
+        uint64_t upper = ntk::histogram_buckets::upper_bound( index );
+
+        ASSERT_LT( index, ntk::histogram_buckets::count );
+        ASSERT_GE( index, previous );
+        ASSERT_GE( upper, value );
+        ASSERT_LE( upper - value, value / ntk::histogram_buckets::sub_buckets );
+
+        previous = index;
+    }
+}
+
+TEST( DataStructureTests, HistogramPercentilesMergeAcrossThreads ) {
+
+    ntk::histogram latencies;
+
+    std::vector<std::thread> threads;
+    for ( int t = 0; t < 4; ++t ) {
+        threads.emplace_back( [&] {
+            for ( uint64_t v = 1; v <= 1000; ++v ) latencies.record( v );
+        });
+    }
+    for ( auto& t : threads ) t.join();
+
+    auto snapshot = latencies.snapshot();
+
+    ASSERT_EQ( snapshot.count(), 4000 );
+    ASSERT_EQ( snapshot.sum(), 4 * 500500 );
+    ASSERT_EQ( snapshot.max(), 1000 );
+    ASSERT_EQ( snapshot.percentile( 1.0 ), 1000 );
+
+    uint64_t median = snapshot.percentile( 0.5 );
+    ASSERT_GE( median, 500 );
+    ASSERT_LE( median, 500 + 500 / ntk::histogram_buckets::sub_buckets );
+}
+
+TEST( DataStructureTests, MetricsRegistryWritesPrometheusText ) {
+
+    ntk::metrics_registry registry;
+
+    auto& latency = registry.get_histogram( "ntk_test_seconds", "A test latency.", ntk::nanoseconds_to_seconds );
+    ASSERT_EQ( &latency, &registry.get_histogram( "ntk_test_seconds" ) );
+
+    latency.record( std::chrono::milliseconds( 2 ) );
+
+    int64_t depth = 7;
+    registry.add_gauge( "ntk_test_depth{shard=\"0\"}", "A test gauge.", [&] { return depth; } );
+    registry.add_gauge( "ntk_test_depth{shard=\"1\"}", "A test gauge.", [] { return int64_t( 3 ); } );
+
+    auto snapshot = registry.snapshot();
+    ASSERT_EQ( snapshot.find_histogram( "ntk_test_seconds" )->count(), 1 );
+    ASSERT_EQ( snapshot.find_gauge( "ntk_test_depth{shard=\"0\"}" ), 7 );
+
+    depth = 9;
+
+    std::ostringstream os;
+    registry.write_prometheus( os );
+    std::string text = os.str();
+
+    ASSERT_NE( text.find( "# TYPE ntk_test_seconds summary\n" ), std::string::npos );
+    ASSERT_NE( text.find( "ntk_test_seconds{quantile=\"0.99\"} 0.002" ), std::string::npos );
+    ASSERT_NE( text.find( "ntk_test_seconds_count 1\n" ), std::string::npos );
+    ASSERT_NE( text.find( "ntk_test_depth{shard=\"0\"} 9\n" ), std::string::npos );
+    ASSERT_NE( text.find( "ntk_test_depth{shard=\"1\"} 3\n" ), std::string::npos );
+    // one TYPE line per family
+    ASSERT_EQ( text.find( "# TYPE ntk_test_depth gauge" ), text.rfind( "# TYPE ntk_test_depth gauge" ) );
+}
+
+TEST( DataStructureTests, InstrumentedPipelineRecordsEveryStage ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::metrics_registry registry;
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    registry.add_gauge( "ntk_offload_queue_depth", "Streams waiting for the processor.", [&] {
+        return static_cast<int64_t>( offload_queue.size() );
+    });
+
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue );
+    live_stream_session.instrument( registry );
+
+    ntk::capture_time start = ntk::capture_clock::now();
+    for ( size_t i = 0; i < packet_data.size(); ++i ) {
+        live_stream_session.feed( ntk::make_captured_packet( start + std::chrono::microseconds( i ), packet_data[ i ] ) );
+    }
+
+    ASSERT_EQ( registry.snapshot().find_gauge( "ntk_offload_queue_depth" ), 1 );
+
+    ntk::stream_processor processor( offload_queue, []( ntk::tcp_live_stream&& ) {}, 1 );
+    processor.instrument( registry );
+    processor.start();
+    processor.stop( ntk::stop_mode::DRAIN );
+
+    auto snapshot = registry.snapshot();
+
+    ASSERT_EQ( snapshot.find_histogram( "ntk_capture_to_offload_seconds" )->count(), 1 );
+    ASSERT_EQ( snapshot.find_histogram( "ntk_offload_to_callback_seconds" )->count(), 1 );
+    ASSERT_EQ( snapshot.find_histogram( "ntk_callback_seconds" )->count(), 1 );
+    ASSERT_EQ( snapshot.find_gauge( "ntk_offload_queue_depth" ), 0 );
+    ASSERT_EQ( snapshot.find_gauge( "ntk_session_bytes_in_memory" ), 0 );
+}
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+#include <lz4_block.hpp>
+
+namespace {
+
+    std::vector<uint8_t> round_trip( const std::vector<uint8_t>& data ) {
+        std::vector<uint8_t> compressed;
+        ntk::lz4_compress_block( data, compressed );
+        EXPECT_LE( compressed.size(), ntk::lz4_compress_bound( data.size() ) );
+
+        std::vector<uint8_t> inflated( data.size() );
+        auto result = ntk::lz4_decompress_block( compressed, inflated );
+        EXPECT_TRUE( result.has_value() ) << result.error();
+        return inflated;
+    }
+
+} // namespace
+
+TEST( DataStructureTests, LZ4BlockRoundTrip ) {
+
+    std::string request = "GET /index.html HTTP/1.1\r\nHost: example.com\r\nAccept: */*\r\n\r\n";
+    std::vector<uint8_t> requests;
+    for ( int i = 0; i < 1000; ++i ) requests.insert( requests.end(), request.begin(), request.end() );
+
+    std::vector<uint8_t> noise( 70000 );
+    std::mt19937 random( 7 );
+    for ( auto& byte : noise ) byte = static_cast<uint8_t>( random() );
+
+    // lengths of 15 and 255 and more, matches overlapping what they write, and nothing to match at all
+    for ( auto& data : { std::vector<uint8_t>(), std::vector<uint8_t>( 1, 'a' ), std::vector<uint8_t>( 12, 'a' ), std::vector<uint8_t>( 13, 'a' ),
+                         std::vector<uint8_t>( 100000, 'a' ), requests, noise } ) {
+        ASSERT_EQ( round_trip( data ), data );
+    }
+
+    std::vector<uint8_t> compressed;
+    ntk::lz4_compress_block( requests, compressed );
+    ASSERT_LT( compressed.size(), requests.size() / 50 );
+}
+
+TEST( DataStructureTests, LZ4BlockReadsReferenceOutputAndRejectsBadBlocks ) {
+
+    // the request as LZ4_compress_default compresses it, one match back into the Accept header
+    std::vector<uint8_t> reference = {
+        0xf4, 0x29, 0x47, 0x45, 0x54, 0x20, 0x2f, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x20, 0x48, 0x54, 0x54, 0x50,
+        0x2f, 0x31, 0x2e, 0x31, 0x0d, 0x0a, 0x48, 0x6f, 0x73, 0x74, 0x3a, 0x20, 0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2e, 0x63, 0x6f,
+        0x6d, 0x0d, 0x0a, 0x41, 0x63, 0x63, 0x65, 0x70, 0x74, 0x3a, 0x20, 0x2a, 0x2f, 0x2a, 0x0d, 0x00, 0xf0, 0x08, 0x2d, 0x45, 0x6e, 0x63,
+        0x6f, 0x64, 0x69, 0x6e, 0x67, 0x3a, 0x20, 0x69, 0x64, 0x65, 0x6e, 0x74, 0x69, 0x74, 0x79, 0x0d, 0x0a, 0x0d, 0x0a
+    };
+    std::string request = "GET /index.html HTTP/1.1\r\nHost: example.com\r\nAccept: */*\r\nAccept-Encoding: identity\r\n\r\n";
+
+    std::vector<uint8_t> inflated( request.size() );
+    ASSERT_TRUE( ntk::lz4_decompress_block( reference, inflated ).has_value() );
+    ASSERT_EQ( std::string( inflated.begin(), inflated.end() ), request );
+
+    // cut short, told the wrong size, and a match reaching back before the block
+    std::vector<uint8_t> truncated( reference.begin(), reference.end() - 10 );
+    ASSERT_FALSE( ntk::lz4_decompress_block( truncated, inflated ).has_value() );
+
+    std::vector<uint8_t> shorter( request.size() - 1 ), longer( request.size() + 1 );
+    ASSERT_FALSE( ntk::lz4_decompress_block( reference, shorter ).has_value() );
+    ASSERT_FALSE( ntk::lz4_decompress_block( reference, longer ).has_value() );
+
+    std::vector<uint8_t> reaching_back = { 0x10, 'a', 0x05, 0x00, 0x00 };
+    std::vector<uint8_t> output( 5 );
+    ASSERT_FALSE( ntk::lz4_decompress_block( reaching_back, output ).has_value() );
+}
@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+
+#include <tcp.hpp>
+#include <mpmc_queue.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    // counts the copies made of it, moves are free
+    struct copy_counted {
+        copy_counted( int v = 0 ) : value( v ) {}
+        copy_counted( const copy_counted& other ) : value( other.value ) { ++copies; }
+        copy_counted( copy_counted&& other ) noexcept : value( other.value ) {}
+        copy_counted& operator=( const copy_counted& other ) { value = other.value; ++copies; return *this; }
+        copy_counted& operator=( copy_counted&& other ) noexcept { value = other.value; return *this; }
+
+        int value;
+        static inline int copies = 0;
+    };
+
+}
+
+TEST( DataStructureTests, MPMCTransferQueueIsFIFO ) {
+
+    ntk::mpmc_transfer_queue<int,8> queue;
+
+    ASSERT_TRUE( queue.empty() );
+
+    for ( int i = 0; i < 5; ++i ) queue.push( i );
+
+    for ( int i = 0; i < 5; ++i ) {
+        auto item = queue.try_pop();
+        ASSERT_TRUE( item );
+        ASSERT_EQ( *item, i );
+    }
+
+    ASSERT_FALSE( queue.try_pop() );
+    ASSERT_TRUE( queue.empty() );
+}
+
+TEST( DataStructureTests, MPMCTransferQueueTryPushFailsWhenFull ) {
+
+    // rounded up to a power of two
+    ntk::mpmc_transfer_queue<int,3> queue;
+    ASSERT_EQ( queue.capacity(), 4 );
+
+    for ( int i = 0; i < 4; ++i ) ASSERT_TRUE( queue.try_push( int( i ) ) );
+    ASSERT_FALSE( queue.try_push( 4 ) );
+
+    ASSERT_EQ( *queue.try_pop(), 0 );
+    ASSERT_TRUE( queue.try_push( 4 ) );
+
+    for ( int i = 1; i < 5; ++i ) ASSERT_EQ( *queue.try_pop(), i );
+}
+
+TEST( DataStructureTests, MPMCTransferQueueMovesItems ) {
+
+    ntk::mpmc_transfer_queue<copy_counted,4> queue;
+    ntk::transfer_queue_interface<copy_counted>& offload = queue;
+
+    copy_counted::copies = 0;
+
+    offload.push( copy_counted( 7 ) );
+    auto item = queue.pop_for( std::chrono::milliseconds( 0 ) );
+
+    ASSERT_TRUE( item );
+    ASSERT_EQ( item->value, 7 );
+    ASSERT_EQ( copy_counted::copies, 0 );
+
+    copy_counted kept( 8 );
+    offload.push( kept );
+    ASSERT_EQ( copy_counted::copies, 1 );
+}
+
+TEST( DataStructureTests, MPMCTransferQueuePopForTimesOut ) {
+
+    ntk::mpmc_transfer_queue<int,4> queue;
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_FALSE( queue.pop_for( std::chrono::milliseconds( 20 ) ) );
+    ASSERT_GE( std::chrono::steady_clock::now() - start, std::chrono::milliseconds( 20 ) );
+}
+
+TEST( DataStructureTests, MPMCTransferQueueManyProducersManyConsumers ) {
+
+    const int producers = 4;
+    const int consumers = 4;
+    const int per_producer = 20000;
+
+    // small enough that producers regularly wait for room
+    ntk::mpmc_transfer_queue<int,64> queue;
+
+    std::atomic<long long> sum{ 0 };
+    std::atomic<int> received{ 0 };
+
+    std::vector<std::thread> threads;
+
+    for ( int c = 0; c < consumers; ++c ) {
+        threads.emplace_back( [&] {
+            while ( received.load() < producers * per_producer ) {
+                if ( auto item = queue.pop_for( std::chrono::milliseconds( 5 ) ) ) {
+                    sum += *item;
+                    ++received;
+                }
+            }
+        });
+    }
+
+    for ( int p = 0; p < producers; ++p ) {
+        threads.emplace_back( [&, p] {
+            for ( int i = 0; i < per_producer; ++i ) queue.push( p * per_producer + i + 1 );
+        });
+    }
+
+    for ( auto& t : threads ) t.join();
+
+    long long n = producers * per_producer;
+    ASSERT_EQ( received.load(), n );
+    ASSERT_EQ( sum.load(), n * ( n + 1 ) / 2 );
+    ASSERT_TRUE( queue.empty() );
+}
+
+TEST( DataStructureTests, TinyCrossMPMCTransferQueueFilterByFour ) {
+
+    auto tiny_cross_packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto checkerboard_packet_data = ntk::read_packets_from_file( test::packet_data_files[ "checkerboard" ] );
+
+    auto tiny_cross_four = *ntk::get_four_tuples( tiny_cross_packet_data ).begin();
+
+    ntk::four_tuple_filter filter( tiny_cross_four );
+    ntk::mpmc_transfer_queue<ntk::tcp_live_stream,16,ntk::four_tuple_filter> offload_queue( filter );
+
+    ntk::tcp_live_stream_session tiny_cross_session( &offload_queue );
+    ntk::tcp_live_stream_session checkerboard_session( &offload_queue );
+
+    for ( auto& packet : checkerboard_packet_data ) checkerboard_session.feed( packet );
+    for ( auto& packet : tiny_cross_packet_data ) tiny_cross_session.feed( packet );
+
+    auto popped_live_stream = offload_queue.try_pop();
+
+    ASSERT_TRUE( popped_live_stream );
+    ASSERT_EQ( popped_live_stream->get_four_tuple(), tiny_cross_four );
+    ASSERT_FALSE( offload_queue.try_pop() );
+}
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+
+#include <packet_pool.hpp>
+#include <ring_buffer.hpp>
+#include <tcp.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+TEST( DataStructureTests, PacketPoolAcquireAndRelease ) {
+
+    ntk::packet_pool pool( 4, 64 );
+
+    const unsigned char frame[] = { 0x01, 0x02, 0x03 };
+
+    {
+        auto view = pool.acquire( frame, sizeof( frame ) );
+
+        ASSERT_TRUE( view.has_value() );
+        ASSERT_EQ( view->size(), 3 );
+        ASSERT_EQ( view->to_vector(), std::vector<uint8_t>( { 0x01, 0x02, 0x03 } ) );
+        ASSERT_EQ( pool.available(), 3 );
+    }
+
+    ASSERT_EQ( pool.available(), 4 );
+}
+
+TEST( DataStructureTests, PacketPoolExhaustion ) {
+
+    ntk::packet_pool pool( 2, 64 );
+
+    const unsigned char frame[] = { 0xff };
+
+    auto first = pool.acquire( frame, sizeof( frame ) );
+    auto second = pool.acquire( frame, sizeof( frame ) );
+
+    ASSERT_TRUE( first && second );
+    ASSERT_FALSE( pool.acquire( frame, sizeof( frame ) ).has_value() );
+
+    first.reset();
+
+    ASSERT_TRUE( pool.acquire( frame, sizeof( frame ) ).has_value() );
+}
+
+TEST( DataStructureTests, PacketViewCopySharesSlot ) {
+
+    ntk::packet_pool pool( 2, 64 );
+
+    const unsigned char frame[] = { 0x0a, 0x0b };
+
+    auto view = pool.acquire( frame, sizeof( frame ) );
+    ntk::packet_view copy = *view;
+
+    ASSERT_EQ( copy.data(), view->data() );
+    ASSERT_EQ( copy.use_count(), 2 );
+
+    view.reset();
+
+    ASSERT_EQ( copy.use_count(), 1 );
+    ASSERT_EQ( pool.available(), 1 );
+}
+
+TEST( DataStructureTests, PacketViewThroughRingBuffer ) {
+
+    ntk::packet_pool pool( 2, 64 );
+    ntk::ring_buffer<ntk::packet_view,4> buf;
+
+    const unsigned char frame[] = { 0x0c };
+
+    ASSERT_TRUE( buf.push( std::move( *pool.acquire( frame, sizeof( frame ) ) ) ) );
+
+    {
+        ntk::packet_view popped;
+        ASSERT_TRUE( buf.pop( popped ) );
+        ASSERT_EQ( popped.use_count(), 1 );
+    }
+
+    ASSERT_EQ( pool.available(), 2 );
+}
+
+TEST( DataStructureTests, TinyCrossPooledLiveStreamSession ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::packet_pool pool( packet_data.size() );
+
+    ntk::tcp_live_stream_session pooled_session;
+    ntk::tcp_live_stream_session session;
+
+    for ( auto& packet : packet_data ) {
+        pooled_session.feed( *pool.acquire( packet.data(), packet.size() ) );
+        session.feed( packet );
+    }
+
+    ASSERT_EQ( pooled_session.number_of_completed_transfers(), 1 );
+
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+
+    auto& pooled_stream = ntk::tcp_live_stream_session_friend_helper::get_live_stream( pooled_session, four );
+    auto& stream = ntk::tcp_live_stream_session_friend_helper::get_live_stream( session, four );
+
+    ASSERT_EQ( pooled_stream, stream );
+
+    auto& pooled_traffic = ntk::tcp_live_stream_friend_helper::pooled_traffic( pooled_stream );
+    auto& traffic = ntk::tcp_live_stream_friend_helper::traffic( stream );
+
+    ASSERT_EQ( pooled_traffic.size(), traffic.size() );
+
+    for ( size_t i = 0; i < traffic.size(); ++i ) {
+        ASSERT_EQ( pooled_traffic[ i ], traffic[ i ] );
+    }
+
+    ASSERT_EQ( pool.available(), pool.slot_count() - traffic.size() );
+}
+
+TEST( DataStructureTests, PooledLiveStreamSessionKeepsToTheRetentionPolicy ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+
+    ntk::packet_pool pool( packet_data.size() );
+
+    ntk::session_limits limits{ .retention = ntk::retention_policy::first_bytes( 100 ) };
+    ntk::tcp_live_stream_session pooled_session( nullptr, limits );
+    ntk::tcp_live_stream_session session( nullptr, limits );
+
+    for ( auto& packet : packet_data ) {
+        pooled_session.feed( *pool.acquire( packet.data(), packet.size() ) );
+        session.feed( packet );
+    }
+
+    auto& pooled_stream = ntk::tcp_live_stream_session_friend_helper::get_live_stream( pooled_session, four );
+    auto& stream = ntk::tcp_live_stream_session_friend_helper::get_live_stream( session, four );
+
+    auto& pooled_traffic = ntk::tcp_live_stream_friend_helper::pooled_traffic( pooled_stream );
+    auto& traffic = ntk::tcp_live_stream_friend_helper::traffic( stream );
+
+    // frames stop at the same one as in the arena, and the slots past it went back to the pool
+    ASSERT_LT( traffic.size(), packet_data.size() - 8 );
+    ASSERT_EQ( pooled_traffic.size(), traffic.size() );
+    for ( size_t i = 0; i < traffic.size(); ++i ) {
+        ASSERT_EQ( pooled_traffic[ i ], traffic[ i ] );
+    }
+
+    ASSERT_EQ( pool.available(), pool.slot_count() - traffic.size() );
+}
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <pipeline.hpp>
+#include <tcp.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+TEST( DataStructureTests, PipelineFansOutToEveryConnectedStage ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+
+    ntk::tcp_live_stream live_stream( four );
+    for ( auto& packet : packet_data ) live_stream.feed( packet );
+    ASSERT_TRUE( live_stream.is_complete() );
+
+    size_t expected = live_stream.server_payload().size();
+
+    ntk::work_stealing_pool pool( 4 );
+
+    std::atomic<size_t> total{ 0 };
+    std::atomic<size_t> count{ 0 };
+
+    ntk::pipeline_stage<ntk::tcp_live_stream,size_t> payload_size( pool, []( ntk::tcp_live_stream&& stream ) {
+        return stream.server_payload().size();
+    });
+    ntk::pipeline_stage<size_t> sum( pool, [ & ]( size_t&& bytes ) { total += bytes; } );
+    ntk::pipeline_stage<size_t> counter( pool, [ & ]( size_t&& ) { ++count; } );
+
+    payload_size.connect( sum ).connect( counter );
+
+    for ( int i = 0; i < 20; ++i ) payload_size.push( live_stream );
+
+    pool.wait_idle();
+
+    ASSERT_EQ( payload_size.processed(), 20 );
+    ASSERT_EQ( total.load(), 20 * expected );
+    ASSERT_EQ( count.load(), 20 );
+}
+
+TEST( DataStructureTests, PipelineEmitterAndOptionalResults ) {
+
+    ntk::work_stealing_pool pool( 2 );
+
+    std::mutex mutex;
+    std::vector<int> seen;
+
+    // one item in, several out
+    ntk::pipeline_stage<int,int> split( pool, []( int&& n, const ntk::stage_emitter<int>& emit ) {
+        for ( int i = 0; i < n; ++i ) emit( i );
+    });
+    // odd numbers are dropped
+    ntk::pipeline_stage<int,int> evens( pool, []( int&& n ) -> std::optional<int> {
+        if ( n % 2 ) return std::nullopt;
+        return n;
+    });
+    ntk::pipeline_stage<int> collect( pool, [ & ]( int&& n ) {
+        std::lock_guard<std::mutex> lock( mutex );
+        seen.push_back( n );
+    });
+
+    split.connect( evens );
+    evens.connect( collect );
+
+    split.push( 10 );
+    pool.wait_idle();
+
+    std::sort( seen.begin(), seen.end() );
+    ASSERT_EQ( seen, ( std::vector<int>{ 0, 2, 4, 6, 8 } ) );
+}
+
+TEST( DataStructureTests, PipelineSlowStageAppliesBackpressure ) {
+
+    ntk::work_stealing_pool pool( 4 );
+
+    std::atomic<size_t> most_queued{ 0 };
+    std::atomic<int> done{ 0 };
+
+    ntk::stage_options options;
+    options.capacity = 4;
+    options.concurrency = 1;
+
+    ntk::pipeline_stage<int> slow( pool, [ & ]( int&& ) {
+        std::this_thread::sleep_for( std::chrono::microseconds( 200 ) );
+        ++done;
+    }, options );
+
+    ntk::pipeline_stage<int,int> fast( pool, [ & ]( int&& n ) {
+        size_t queued = slow.queued();
+        if ( queued > most_queued ) most_queued = queued;
+        return n;
+    });
+
+    fast.connect( slow );
+
+    for ( int i = 0; i < 200; ++i ) fast.push( i );
+
+    pool.wait_idle();
+
+    ASSERT_EQ( done.load(), 200 );
+    ASSERT_LE( most_queued.load(), options.capacity );
+}
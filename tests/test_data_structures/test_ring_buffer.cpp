@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
 
+#include <thread>
+#include <vector>
+
 #include <ring_buffer.hpp>
 
 TEST( DataStructureTests, RingBufferPushAndPop ) {
@@ -63,3 +66,101 @@ TEST( DataStructureTests, RingBufferWrapAround ) {
     buf.pop( val ); EXPECT_EQ( val, 3 );
     buf.pop( val ); EXPECT_EQ( val, 4 );
 }
+
+TEST( DataStructureTests, RingBufferNonPowerOfTwoCapacity ) {
+
+    ntk::ring_buffer<int,5> buf;
+
+    EXPECT_TRUE( buf.push( 1 ) );
+    EXPECT_TRUE( buf.push( 2 ) );
+    EXPECT_TRUE( buf.push( 3 ) );
+    EXPECT_TRUE( buf.push( 4 ) );
+
+    EXPECT_FALSE( buf.push( 5 ) );
+    EXPECT_EQ( buf.size(), 4 );
+}
+
+TEST( DataStructureTests, RingBufferMovePushAndEmplace ) {
+
+    ntk::ring_buffer<std::vector<uint8_t>,4> buf;
+
+    std::vector<uint8_t> packet = { 0x01, 0x02 };
+
+    EXPECT_TRUE( buf.push( std::move( packet ) ) );
+    EXPECT_TRUE( buf.emplace( 3, 0xff ) );
+
+    std::vector<uint8_t> val;
+
+    buf.pop( val ); EXPECT_EQ( val, std::vector<uint8_t>( { 0x01, 0x02 } ) );
+    buf.pop( val ); EXPECT_EQ( val, std::vector<uint8_t>( 3, 0xff ) );
+}
+
+TEST( DataStructureTests, RingBufferBulkPushAndPop ) {
+
+    ntk::ring_buffer<int,8> buf;
+
+    std::array<int,10> in = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+
+    EXPECT_EQ( buf.push_bulk( in ), 7 );
+
+    std::array<int,4> out;
+
+    EXPECT_EQ( buf.pop_bulk( out ), 4 );
+    EXPECT_EQ( out, ( std::array<int,4>{ 0, 1, 2, 3 } ) );
+
+    EXPECT_EQ( buf.push_bulk( std::span<int>( in ).subspan( 7 ) ), 3 );
+
+    std::array<int,8> rest;
+
+    EXPECT_EQ( buf.pop_bulk( rest ), 6 );
+    EXPECT_EQ( rest[ 0 ], 4 );
+    EXPECT_EQ( rest[ 5 ], 9 );
+    EXPECT_TRUE( buf.empty() );
+}
+
+TEST( DataStructureTests, RingBufferProducerConsumerOrder ) {
+
+    const int n_items = 100000;
+
+    ntk::ring_buffer<int,64> buf;
+
+    std::thread producer( [&]() {
+        for ( int i = 0; i < n_items; ) {
+            if ( buf.push( i ) ) ++i;
+        }
+    });
+
+    int expected = 0;
+    bool in_order = true;
+
+    while ( expected < n_items ) {
+        int val;
+        if ( buf.pop( val ) ) {
+            in_order = in_order && val == expected;
+            ++expected;
+        }
+    }
+
+    producer.join();
+
+    EXPECT_TRUE( in_order );
+}
+
+TEST( DataStructureTests, RingBufferStatistics ) {
+
+    ntk::ring_buffer<int,4> buf;
+
+    for ( int i = 0; i < 5; ++i ) buf.push( i );
+
+    int val;
+    buf.pop( val );
+    buf.pop( val );
+
+    std::vector<int> items = { 10, 11, 12 };
+    EXPECT_EQ( buf.push_bulk( items ), 2 );
+
+    auto stats = buf.statistics();
+
+    EXPECT_EQ( stats.push_failures, 3 );
+    EXPECT_EQ( stats.high_watermark, 3 );
+}
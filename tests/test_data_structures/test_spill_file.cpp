@@ -0,0 +1,34 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <vector>
+
+#include <spill_file.hpp>
+
+TEST( DataStructureTests, SpillFileAppendAndMap ) {
+
+    ntk::spill_file file( std::filesystem::temp_directory_path() );
+
+    ASSERT_TRUE( file.is_open() );
+
+    std::vector<std::vector<uint8_t>> frames = { { 1, 2, 3 }, {}, { 4, 5, 6, 7, 8 } };
+    for ( auto& frame : frames ) ASSERT_TRUE( file.append( frame ) );
+
+    ASSERT_EQ( file.frame_count(), 3 );
+    ASSERT_EQ( file.size_bytes(), 8 );
+
+    ASSERT_TRUE( file.map() );
+    ASSERT_TRUE( file.is_mapped() );
+    ASSERT_FALSE( file.append( frames[ 0 ] ) );
+
+    ASSERT_EQ( file.frames().size(), frames.size() );
+    for ( size_t i = 0; i < frames.size(); ++i ) {
+        ASSERT_EQ( std::vector<uint8_t>( file.frames()[ i ].begin(), file.frames()[ i ].end() ), frames[ i ] );
+    }
+}
+
+TEST( DataStructureTests, SpillFileMissingDirectory ) {
+    ntk::spill_file file( "/nonexistent/spill/directory" );
+    ASSERT_FALSE( file.is_open() );
+    ASSERT_FALSE( file.append( std::vector<uint8_t>{ 1 } ) );
+}
@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include <packet_pool.hpp>
+#include <thread_placement.hpp>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+TEST( DataStructureTests, CPUListsAreParsed ) {
+    ASSERT_EQ( ntk::parse_cpu_list( "0-3,8,10-11" ), ( std::vector<unsigned>{ 0, 1, 2, 3, 8, 10, 11 } ) );
+    ASSERT_EQ( ntk::parse_cpu_list( "5" ), ( std::vector<unsigned>{ 5 } ) );
+    ASSERT_TRUE( ntk::parse_cpu_list( "" ).empty() );
+    ASSERT_TRUE( ntk::parse_cpu_list( "a-b" ).empty() );
+}
+
+TEST( DataStructureTests, UnknownDeviceHasNoPlacement ) {
+    ASSERT_FALSE( ntk::numa_node_of_device( "no-such-device" ).has_value() );
+    ASSERT_TRUE( ntk::thread_placement::near_device( "no-such-device" ).empty() );
+}
+
+#ifdef __linux__
+TEST( DataStructureTests, ThreadIsPinnedToItsPlacement ) {
+
+    cpu_set_t allowed;
+    ASSERT_EQ( sched_getaffinity( 0, sizeof( allowed ), &allowed ), 0 );
+
+    unsigned cpu = 0;
+    while ( !CPU_ISSET( cpu, &allowed ) ) ++cpu;
+
+    auto placement = ntk::thread_placement::on_cpus( { cpu } );
+
+    int ran_on = -1;
+    std::thread pinned( [&] {
+        ASSERT_TRUE( ntk::apply_placement( placement ) );
+        ran_on = sched_getcpu();
+    });
+    pinned.join();
+
+    ASSERT_EQ( ran_on, static_cast<int>( cpu ) );
+}
+#endif
+
+TEST( DataStructureTests, PacketPoolOnNodeStillHandsOutSlots ) {
+
+    // node 0 exists wherever there is NUMA at all, and binding is only a preference
+    ntk::packet_pool pool( 4, 128, 0 );
+
+    const unsigned char frame[] = { 1, 2, 3 };
+    auto view = pool.acquire( frame, sizeof( frame ) );
+
+    ASSERT_TRUE( view.has_value() );
+    ASSERT_EQ( view->size(), sizeof( frame ) );
+    ASSERT_EQ( pool.available(), 3 );
+}
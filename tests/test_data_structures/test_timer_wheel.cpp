@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <vector>
+
+#include <timer_wheel.hpp>
+
+TEST( DataStructureTests, TimerWheelFiresInDeadlineOrder ) {
+
+    ntk::timer_wheel<int> wheel;
+    ntk::capture_time start = ntk::to_capture_time( 1700000000, 0 );
+
+    // spread over the first three levels
+    wheel.schedule( 0, start );
+    wheel.schedule( 3, start + std::chrono::seconds( 30 ) );
+    wheel.schedule( 1, start + std::chrono::milliseconds( 10 ) );
+    wheel.schedule( 2, start + std::chrono::milliseconds( 700 ) );
+
+    ASSERT_EQ( wheel.size(), 4 );
+
+    std::vector<int> fired;
+    auto collect = [&]( int id ) { fired.push_back( id ); };
+
+    wheel.advance( start + std::chrono::milliseconds( 5 ), collect );
+    ASSERT_EQ( fired, std::vector<int>( { 0 } ) );
+
+    wheel.advance( start + std::chrono::milliseconds( 699 ), collect );
+    ASSERT_EQ( fired, std::vector<int>( { 0, 1 } ) );
+
+    wheel.advance( start + std::chrono::seconds( 29 ), collect );
+    ASSERT_EQ( fired, std::vector<int>( { 0, 1, 2 } ) );
+
+    wheel.advance( start + std::chrono::seconds( 31 ), collect );
+    ASSERT_EQ( fired, std::vector<int>( { 0, 1, 2, 3 } ) );
+    ASSERT_TRUE( wheel.empty() );
+}
+
+TEST( DataStructureTests, TimerWheelBeyondSpan ) {
+
+    ntk::timer_wheel<int> wheel;
+    ntk::capture_time start = ntk::to_capture_time( 1700000000, 0 );
+
+    std::vector<int> fired;
+    auto collect = [&]( int id ) { fired.push_back( id ); };
+
+    wheel.schedule( 0, start );
+    // further out than four levels of 64 one millisecond ticks
+    wheel.schedule( 1, start + std::chrono::hours( 6 ) );
+
+    wheel.advance( start + std::chrono::hours( 5 ), collect );
+    ASSERT_EQ( fired, std::vector<int>( { 0 } ) );
+
+    wheel.advance( start + std::chrono::hours( 6 ) + std::chrono::milliseconds( 1 ), collect );
+    ASSERT_EQ( fired, std::vector<int>( { 0, 1 } ) );
+}
+
+TEST( DataStructureTests, TimerWheelScheduledFromCallback ) {
+
+    ntk::timer_wheel<int> wheel;
+    ntk::capture_time start = ntk::to_capture_time( 1700000000, 0 );
+
+    wheel.schedule( 0, start + std::chrono::milliseconds( 100 ) );
+
+    // re-arm once, the way an owner does when its deadline moved
+    size_t fired = 0;
+    auto rearm = [&]( int id ) {
+        if ( ++fired == 1 ) wheel.schedule( id, start + std::chrono::milliseconds( 200 ) );
+    };
+
+    wheel.advance( start + std::chrono::milliseconds( 150 ), rearm );
+    ASSERT_EQ( fired, 1 );
+    ASSERT_EQ( wheel.size(), 1 );
+
+    wheel.advance( start + std::chrono::milliseconds( 250 ), rearm );
+    ASSERT_EQ( fired, 2 );
+    ASSERT_TRUE( wheel.empty() );
+}
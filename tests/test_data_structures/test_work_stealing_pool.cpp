@@ -0,0 +1,38 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+
+#include <work_stealing_pool.hpp>
+
+TEST( DataStructureTests, WorkStealingPoolRunsEveryTask ) {
+
+    ntk::work_stealing_pool pool( 4 );
+    ASSERT_EQ( pool.thread_count(), 4 );
+
+    std::atomic<int> sum{ 0 };
+
+    // tasks that submit more tasks land on the submitting thread's deque and get stolen from there
+    for ( int i = 0; i < 100; ++i ) {
+        pool.submit( [ &, i ] {
+            for ( int j = 0; j < 10; ++j ) pool.submit( [ &, i ] { sum += i; } );
+        });
+    }
+
+    pool.wait_idle();
+
+    ASSERT_EQ( sum.load(), 10 * ( 99 * 100 / 2 ) );
+}
+
+TEST( DataStructureTests, WorkStealingPoolSurvivesThrowingTask ) {
+
+    ntk::work_stealing_pool pool( 1 );
+    std::atomic<bool> ran{ false };
+
+    pool.submit( [] { throw std::runtime_error( "stage failure" ); } );
+    pool.submit( [ & ] { ran = true; } );
+
+    pool.wait_idle();
+
+    ASSERT_TRUE( ran.load() );
+}
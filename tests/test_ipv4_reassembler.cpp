@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <span>
+#include <vector>
+#include <cstdint>
+
+#include <decoded_packet.hpp>
+#include <ipv4.hpp>
+#include <ipv4_reassembler.hpp>
+#include <spmc_queue.hpp>
+#include <tcp.hpp>
+#include <utils.hpp>
+
+#include "test_constants.hpp"
+
+namespace {
+
+    // splits a frame's ip payload into fragments of piece bytes, a multiple of 8
+    std::vector<std::vector<uint8_t>> fragment( const std::vector<uint8_t>& frame, size_t piece, uint16_t identification = 0x1234 ) {
+
+        const size_t ip_offset = ntk::constants::ethernet_header_len;
+        size_t ip_header_len = ( frame[ ip_offset ] & 0x0f ) * 4;
+        size_t total_length = ( frame[ ip_offset + 2 ] << 8 ) | frame[ ip_offset + 3 ];
+        size_t payload_len = total_length - ip_header_len;
+
+        std::vector<std::vector<uint8_t>> fragments;
+        for ( size_t begin = 0; begin < payload_len; begin += piece ) {
+            size_t length = std::min( piece, payload_len - begin );
+            bool more = begin + length < payload_len;
+
+            std::vector<uint8_t> f( frame.begin(), frame.begin() + ip_offset + ip_header_len );
+            f.insert( f.end(), frame.begin() + ip_offset + ip_header_len + begin, frame.begin() + ip_offset + ip_header_len + begin + length );
+
+            uint8_t* ip = f.data() + ip_offset;
+            uint16_t field = static_cast<uint16_t>( ( more ? 0x2000 : 0 ) | ( begin / 8 ) );
+            ip[ 2 ] = static_cast<uint8_t>( ( ip_header_len + length ) >> 8 );
+            ip[ 3 ] = static_cast<uint8_t>( ip_header_len + length );
+            ip[ 4 ] = static_cast<uint8_t>( identification >> 8 );
+            ip[ 5 ] = static_cast<uint8_t>( identification );
+            ip[ 6 ] = static_cast<uint8_t>( field >> 8 );
+            ip[ 7 ] = static_cast<uint8_t>( field );
+            fragments.push_back( f );
+        }
+        return fragments;
+    }
+
+    bool checksum_holds( std::span<const uint8_t> frame ) {
+        auto ip = frame.subspan( ntk::constants::ethernet_header_len, ( frame[ ntk::constants::ethernet_header_len ] & 0x0f ) * 4 );
+        uint32_t sum = 0;
+        for ( size_t i = 0; i + 1 < ip.size(); i += 2 ) sum += ( ip[ i ] << 8 ) | ip[ i + 1 ];
+        while ( sum >> 16 ) sum = ( sum & 0xffff ) + ( sum >> 16 );
+        return sum == 0xffff;
+    }
+
+    // the client hello, the largest frame of the handshake
+    std::vector<uint8_t> client_hello_frame() {
+        auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tls_handshake" ] );
+        return packet_data[ 3 ];
+    }
+
+}
+
+TEST( IPv4ReassemblerTests, FragmentsAreRecognised ) {
+
+    auto frame = client_hello_frame();
+    auto fragments = fragment( frame, 64 );
+
+    ASSERT_GT( fragments.size(), 2 );
+    ASSERT_FALSE( ntk::is_ipv4_fragment( frame ) );
+    ASSERT_TRUE( ntk::is_ipv4_fragment( fragments.front() ) );
+    ASSERT_TRUE( ntk::is_ipv4_fragment( fragments.back() ) );
+
+    // no fragment decodes as a segment, and only the first one has ports
+    ASSERT_FALSE( ntk::decode_packet( fragments.front() ).has_value() );
+    ASSERT_EQ( ntk::get_four_from_ethernet( fragments.front() ), ntk::get_four_from_ethernet( frame ) );
+    ASSERT_EQ( ntk::get_four_from_ethernet( fragments[ 1 ] ).client_port, 0 );
+
+    auto header = ntk::get_ipv4_header( fragments[ 1 ].data() );
+    ASSERT_EQ( header.identification, 0x1234 );
+    ASSERT_EQ( header.flags, 0x1 );
+    ASSERT_EQ( header.fragment_offset, 64 );
+}
+
+TEST( IPv4ReassemblerTests, OutOfOrderFragmentsComplete ) {
+
+    auto frame = client_hello_frame();
+    auto fragments = fragment( frame, 64 );
+    std::reverse( fragments.begin(), fragments.end() );
+
+    ntk::ipv4_reassembler reassembler;
+
+    ASSERT_EQ( reassembler.feed( frame ), ntk::fragment_result::NOT_FRAGMENT );
+
+    for ( size_t i = 0; i + 1 < fragments.size(); ++i ) {
+        ASSERT_EQ( reassembler.feed( fragments[ i ] ), ntk::fragment_result::HELD );
+    }
+    // a retransmitted fragment changes nothing
+    ASSERT_EQ( reassembler.feed( fragments[ 0 ] ), ntk::fragment_result::HELD );
+    ASSERT_EQ( reassembler.feed( fragments.back() ), ntk::fragment_result::COMPLETE );
+
+    auto datagram = reassembler.datagram();
+    ASSERT_EQ( datagram.size(), frame.size() );
+    ASSERT_TRUE( checksum_holds( datagram ) );
+    ASSERT_FALSE( ntk::is_ipv4_fragment( datagram ) );
+
+    auto expected = ntk::decode_packet( frame );
+    auto rebuilt = ntk::decode_packet( datagram );
+    ASSERT_TRUE( rebuilt.has_value() );
+    ASSERT_EQ( rebuilt->four(), expected->four() );
+    ASSERT_TRUE( std::ranges::equal( rebuilt->payload, expected->payload ) );
+
+    ASSERT_EQ( reassembler.size(), 0 );
+    ASSERT_EQ( reassembler.statistics().datagrams_reassembled, 1 );
+    ASSERT_EQ( reassembler.statistics().bytes_held, 0 );
+}
+
+TEST( IPv4ReassemblerTests, OverlapsDropTheDatagram ) {
+
+    auto frame = client_hello_frame();
+    auto fragments = fragment( frame, 64 );
+    auto overlapping = fragment( frame, 128 );
+    overlapping[ 0 ].back() ^= 0xff;
+
+    ntk::ipv4_reassembler reassembler;
+
+    ASSERT_EQ( reassembler.feed( fragments[ 0 ] ), ntk::fragment_result::HELD );
+    ASSERT_EQ( reassembler.feed( overlapping[ 0 ] ), ntk::fragment_result::DROPPED );
+    ASSERT_EQ( reassembler.size(), 0 );
+
+    // whatever follows starts a datagram that cannot complete without its first fragment
+    for ( size_t i = 1; i < fragments.size(); ++i ) {
+        ASSERT_NE( reassembler.feed( fragments[ i ] ), ntk::fragment_result::COMPLETE );
+    }
+}
+
+TEST( IPv4ReassemblerTests, LimitsBoundWhatIsHeld ) {
+
+    auto frame = client_hello_frame();
+    auto start = ntk::capture_time( std::chrono::seconds( 1000 ) );
+
+    ntk::fragment_limits limits;
+    limits.max_datagrams = 2;
+    limits.timeout = std::chrono::seconds( 5 );
+    ntk::ipv4_reassembler reassembler( limits );
+
+    for ( uint16_t id = 1; id <= 3; ++id ) {
+        ASSERT_EQ( reassembler.feed( fragment( frame, 64, id )[ 0 ], start ), ntk::fragment_result::HELD );
+    }
+    ASSERT_EQ( reassembler.size(), 2 );
+    ASSERT_EQ( reassembler.statistics().datagrams_evicted, 1 );
+
+    reassembler.advance_time( start + std::chrono::seconds( 5 ) );
+    ASSERT_EQ( reassembler.size(), 0 );
+    ASSERT_EQ( reassembler.statistics().datagrams_timed_out, 2 );
+
+    ntk::fragment_limits source_limits;
+    source_limits.max_source_bytes = 256;
+    ntk::ipv4_reassembler bounded( source_limits );
+
+    auto fragments = fragment( frame, 64 );
+    ASSERT_EQ( bounded.feed( fragments[ 0 ] ), ntk::fragment_result::HELD );
+    ntk::fragment_result result = ntk::fragment_result::HELD;
+    for ( size_t i = 1; i < fragments.size() && result == ntk::fragment_result::HELD; ++i ) result = bounded.feed( fragments[ i ] );
+    ASSERT_EQ( result, ntk::fragment_result::DROPPED );
+    ASSERT_EQ( bounded.statistics().bytes_held, 0 );
+}
+
+TEST( IPv4ReassemblerTests, SessionReassemblesInFrontOfStreams ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> reference_queue;
+    ntk::tcp_live_stream_session reference( &reference_queue );
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session session( &offload_queue );
+
+    for ( size_t i = 0; i < packet_data.size(); ++i ) {
+        reference.feed( packet_data[ i ] );
+        if ( ntk::decode_packet( packet_data[ i ] )->is_data_packet() ) {
+            for ( auto& f : fragment( packet_data[ i ], 48, static_cast<uint16_t>( i ) ) ) session.feed( f );
+        } else {
+            session.feed( packet_data[ i ] );
+        }
+    }
+
+    auto expected = reference_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+    auto stream = offload_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+
+    ASSERT_TRUE( expected.has_value() );
+    ASSERT_TRUE( stream.has_value() );
+    ASSERT_FALSE( stream->client_payload().empty() );
+    ASSERT_TRUE( std::ranges::equal( stream->client_payload(), expected->client_payload() ) );
+    ASSERT_TRUE( std::ranges::equal( stream->server_payload(), expected->server_payload() ) );
+    ASSERT_GT( session.fragments().datagrams_reassembled, 0 );
+    ASSERT_EQ( session.statistics().packets_fed, reference.statistics().packets_fed );
+}
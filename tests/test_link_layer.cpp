@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <span>
+#include <vector>
+#include <cstdint>
+
+#include <decoded_packet.hpp>
+#include <flow_key.hpp>
+#include <ipv4.hpp>
+#include <link_layer.hpp>
+#include <spmc_queue.hpp>
+#include <tcp.hpp>
+#include <tcp_sharded_session.hpp>
+#include <utils.hpp>
+
+#include "test_constants.hpp"
+
+namespace {
+
+    // the frame with a vlan tag between the mac addresses and the ethertype
+    std::vector<uint8_t> vlan_tagged( const std::vector<uint8_t>& frame, uint16_t vlan = 42 ) {
+        std::vector<uint8_t> tagged( frame.begin(), frame.begin() + 12 );
+        tagged.insert( tagged.end(), { 0x81, 0x00, static_cast<uint8_t>( vlan >> 8 ), static_cast<uint8_t>( vlan ) } );
+        tagged.insert( tagged.end(), frame.begin() + 12, frame.end() );
+        return tagged;
+    }
+
+    // the frame with its ethernet header swapped for the cooked header of the "any" device
+    std::vector<uint8_t> linux_sll( const std::vector<uint8_t>& frame ) {
+        std::vector<uint8_t> cooked = { 0x00, 0x00, 0x00, 0x01, 0x00, 0x06 };
+        cooked.insert( cooked.end(), frame.begin() + 6, frame.begin() + 12 );
+        cooked.insert( cooked.end(), { 0x00, 0x00 } );
+        cooked.insert( cooked.end(), frame.begin() + 12, frame.end() );
+        return cooked;
+    }
+
+    const std::array<uint8_t,16> client_v6 = { 0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01 };
+    const std::array<uint8_t,16> server_v6 = { 0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x02 };
+
+    // the frame's tcp segment carried by ipv6 instead, behind a hop-by-hop header if asked
+    std::vector<uint8_t> over_ipv6( const std::vector<uint8_t>& frame, bool hop_by_hop = false ) {
+
+        const size_t ip_offset = ntk::constants::ethernet_header_len;
+        size_t ip_header_len = ( frame[ ip_offset ] & 0x0f ) * 4;
+        size_t total_length = ( frame[ ip_offset + 2 ] << 8 ) | frame[ ip_offset + 3 ];
+        auto segment_begin = frame.begin() + ip_offset + ip_header_len;
+        auto segment_end = frame.begin() + ip_offset + total_length;
+        size_t payload_len = ( segment_end - segment_begin ) + ( hop_by_hop ? 8 : 0 );
+
+        std::vector<uint8_t> v6( frame.begin(), frame.begin() + 12 );
+        v6.insert( v6.end(), { 0x86, 0xdd } );
+        v6.insert( v6.end(), { 0x60, 0x00, 0x00, 0x00, static_cast<uint8_t>( payload_len >> 8 ), static_cast<uint8_t>( payload_len ),
+                               static_cast<uint8_t>( hop_by_hop ? 0 : 6 ), 64 } );
+        v6.insert( v6.end(), client_v6.begin(), client_v6.end() );
+        v6.insert( v6.end(), server_v6.begin(), server_v6.end() );
+        if ( hop_by_hop ) v6.insert( v6.end(), { 6, 0, 1, 4, 0, 0, 0, 0 } );
+        v6.insert( v6.end(), segment_begin, segment_end );
+        return v6;
+    }
+
+    std::vector<uint8_t> data_frame() {
+        auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+        for ( auto& packet : packet_data ) {
+            if ( ntk::decode_packet( packet )->is_data_packet() ) return packet;
+        }
+        return {};
+    }
+
+}
+
+TEST( LinkLayerTests, TaggedAndCookedFramesDecodeAlike ) {
+
+    auto frame = data_frame();
+    ASSERT_FALSE( frame.empty() );
+    auto expected = ntk::decode_packet( frame );
+
+    auto tagged = vlan_tagged( frame );
+    auto double_tagged = vlan_tagged( vlan_tagged( frame ), 7 );
+    double_tagged[ 12 ] = 0x88;
+    double_tagged[ 13 ] = 0xa8;
+    auto cooked = linux_sll( frame );
+
+    for ( auto decoded : { ntk::decode_packet( tagged ), ntk::decode_packet( double_tagged ),
+                           ntk::decode_packet_as<ntk::linux_sll_link>( cooked ) } ) {
+        ASSERT_TRUE( decoded.has_value() );
+        ASSERT_EQ( decoded->four(), expected->four() );
+        ASSERT_EQ( decoded->ip_version, 4 );
+        ASSERT_TRUE( std::ranges::equal( decoded->payload, expected->payload ) );
+        ASSERT_TRUE( decoded->is_data_packet() );
+    }
+    ASSERT_EQ( ntk::decode_packet( tagged )->network_offset, 18 );
+    ASSERT_EQ( ntk::decode_packet( double_tagged )->network_offset, 22 );
+    ASSERT_EQ( ntk::decode_packet_as<ntk::linux_sll_link>( cooked )->network_offset, 16 );
+
+    // a cooked frame read as ethernet is not a segment, the link type has to be known up front
+    ASSERT_FALSE( ntk::decode_packet( cooked ).has_value() );
+
+    ASSERT_EQ( ntk::to_link_type( 113 ), ntk::link_type::LINUX_SLL );
+    ASSERT_FALSE( ntk::to_link_type( 105 ).has_value() );
+    auto sll = ntk::link_layer_of( ntk::link_type::LINUX_SLL );
+    ASSERT_EQ( sll.decode( cooked )->four(), expected->four() );
+    ASSERT_EQ( ntk::with_link_layer( ntk::link_type::LINUX_SLL, []( auto link ) { return decltype( link )::header_len; } ), 16 );
+}
+
+TEST( LinkLayerTests, IPv6Segments ) {
+
+    auto frame = data_frame();
+    auto expected = ntk::decode_packet( frame );
+
+    for ( bool hop_by_hop : { false, true } ) {
+        auto v6 = over_ipv6( frame, hop_by_hop );
+        auto decoded = ntk::decode_packet( v6 );
+
+        ASSERT_TRUE( decoded.has_value() );
+        ASSERT_EQ( decoded->ip_version, 6 );
+        ASSERT_EQ( decoded->source_ip, ntk::ip_address::from_bytes( client_v6 ) );
+        ASSERT_EQ( decoded->destination_ip.bytes(), server_v6 );
+        ASSERT_EQ( decoded->source_port, expected->source_port );
+        ASSERT_TRUE( std::ranges::equal( decoded->payload, expected->payload ) );
+        ASSERT_TRUE( ntk::decode_packet( vlan_tagged( v6 ) ).has_value() );
+    }
+
+    auto decoded = ntk::decode_packet( over_ipv6( frame ) );
+    ASSERT_EQ( ntk::ip_to_string( decoded->source_ip ), "2001:db8::1" );
+    ASSERT_FALSE( decoded->source_ip.is_v4() );
+    ASSERT_EQ( ntk::ip_to_string( expected->source_ip ), ntk::ip_to_string( expected->source_ip.v4() ) );
+
+    // both directions of an ipv6 flow are one key, and v4 mapped addresses stay apart from v4
+    ntk::four_tuple four = decoded->four();
+    ASSERT_EQ( ntk::flow_key( four ), ntk::flow_key( ntk::flip_four( four ) ) );
+    ASSERT_EQ( ntk::flow_key_hash{}( ntk::flow_key( four ) ), ntk::flow_key_hash{}( ntk::flow_key( ntk::flip_four( four ) ) ) );
+    ASSERT_NE( ntk::flow_key( four ), ntk::flow_key( expected->four() ) );
+
+    ntk::toeplitz_hasher symmetric_hasher( ntk::symmetric_rss_key );
+    ASSERT_EQ( symmetric_hasher( four ), symmetric_hasher( ntk::flip_four( four ) ) );
+}
+
+TEST( LinkLayerTests, SessionDecodesItsLinkType ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> reference_queue;
+    ntk::tcp_live_stream_session reference( &reference_queue );
+
+    ntk::session_limits limits;
+    limits.link = ntk::link_type::LINUX_SLL;
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session session( &offload_queue, limits );
+
+    for ( auto& packet : packet_data ) {
+        reference.feed( packet );
+        session.feed( linux_sll( packet ) );
+    }
+
+    auto expected = reference_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+    auto stream = offload_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+
+    ASSERT_TRUE( expected.has_value() );
+    ASSERT_TRUE( stream.has_value() );
+    ASSERT_TRUE( std::ranges::equal( stream->client_payload(), expected->client_payload() ) );
+    ASSERT_TRUE( std::ranges::equal( stream->server_payload(), expected->server_payload() ) );
+    ASSERT_EQ( session.statistics().packets_unmatched, reference.statistics().packets_unmatched );
+}
+
+TEST( LinkLayerTests, ShardedSessionRoutesByTheDecodedFlow ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    for ( auto type : { ntk::link_type::ETHERNET, ntk::link_type::LINUX_SLL } ) {
+
+        ntk::session_limits limits;
+        limits.link = type;
+        ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+        ntk::tcp_sharded_session sharded_session( 8, &offload_queue, limits );
+        ASSERT_EQ( sharded_session.link(), type );
+
+        for ( auto& packet : packet_data ) {
+            sharded_session.feed( type == ntk::link_type::ETHERNET ? vlan_tagged( packet ) : linux_sll( packet ) );
+        }
+        // no flow to route by, and too short to hold an ip header at all
+        sharded_session.feed( std::vector<uint8_t>( 20, 0xff ) );
+
+        sharded_session.stop();
+
+        // both directions met in one shard, so the stream completed
+        auto stream = offload_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+        ASSERT_TRUE( stream.has_value() );
+        ASSERT_TRUE( stream->is_complete() );
+        ASSERT_EQ( sharded_session.statistics().streams_offloaded, 1 );
+        ASSERT_EQ( sharded_session.statistics().packets_unmatched, 1 );
+    }
+}
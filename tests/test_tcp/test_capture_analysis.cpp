@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+
+#include <map>
+
+#include <capture_analysis.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+TEST( PacketParsingTests, AnalyzeCaptureMatchesSequentialReconstruction ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "checkerboard" ] );
+
+    ntk::flow_index index( packet_data );
+
+    std::map<size_t,ntk::flow_analysis> results;
+
+    size_t flows = ntk::analyze_capture( packet_data, ntk::capture_analysis_options{ .threads = 4 }, [&]( ntk::flow_analysis&& analysis ) {
+        results.emplace( analysis.flow_number, std::move( analysis ) );
+    });
+
+    ASSERT_EQ( flows, index.size() );
+    ASSERT_EQ( results.size(), index.size() );
+
+    for ( auto& [ flow_number, analysis ] : results ) {
+
+        auto expected = ntk::analyze_flow( index, flow_number );
+
+        ASSERT_EQ( analysis.client, expected.client );
+        ASSERT_EQ( analysis.handshake, ntk::get_handshake( index.flows()[ flow_number ].four, packet_data ) );
+        ASSERT_EQ( analysis.client_stream, expected.client_stream );
+        ASSERT_EQ( analysis.server_stream, expected.server_stream );
+    }
+}
+
+TEST( PacketParsingTests, AnalyzeFlowParsesHttp ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::flow_index index( packet_data );
+
+    ASSERT_EQ( index.size(), 1 );
+
+    auto analysis = ntk::analyze_flow( index, 0 );
+
+    // the client is whoever sent the syn
+    ASSERT_EQ( analysis.client, ntk::get_four_from_ethernet( analysis.handshake.syn ) );
+
+    auto client_four = analysis.client;
+    auto filter_direction = [&]( const ntk::four_tuple& four ) {
+        ntk::session direction;
+        for ( auto& packet : packet_data ) if ( ntk::get_four_from_ethernet( packet ) == four ) direction.push_back( packet );
+        return ntk::get_merged_tcp_stream( direction );
+    };
+
+    ASSERT_EQ( analysis.client_stream, filter_direction( client_four ) );
+    ASSERT_EQ( analysis.server_stream, filter_direction( ntk::flip_four( client_four ) ) );
+
+    ASSERT_TRUE( analysis.request.has_value() );
+    ASSERT_EQ( analysis.request->request_line.method_token, "GET" );
+    ASSERT_TRUE( analysis.response.has_value() );
+    ASSERT_EQ( analysis.response->status_line.status_code, 200 );
+    ASSERT_TRUE( analysis.client_tls_records.empty() );
+}
+
+TEST( PacketParsingTests, AnalyzeFlowExtractsTls ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tls_handshake" ] );
+
+    size_t tls_flows = 0;
+
+    ntk::analyze_capture( packet_data, ntk::capture_analysis_options{ .threads = 2 }, [&]( ntk::flow_analysis&& analysis ) {
+        if ( !analysis.client_tls_records.empty() ) {
+            ++tls_flows;
+            EXPECT_EQ( analysis.client_tls_records[ 0 ].content_type, ntk::tls_content_type::HANDSHAKE );
+            EXPECT_FALSE( analysis.request.has_value() );
+        }
+    });
+
+    ASSERT_GT( tls_flows, 0 );
+}
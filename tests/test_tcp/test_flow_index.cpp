@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include <flow_index.hpp>
+#include <tcp.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+TEST( PacketParsingTests, FlowIndexGroupsPacketsByFlow ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "checkerboard" ] );
+
+    ntk::flow_index index( packet_data );
+
+    ASSERT_GT( index.size(), 0 );
+
+    size_t indexed = 0;
+    for ( auto& flow : index.flows() ) {
+        uint32_t previous = 0;
+        for ( auto& p : flow.packets ) {
+            // capture order, and the direction bit agrees with the packet's own four tuple
+            ASSERT_GE( p.index, previous );
+            previous = p.index;
+            auto four = ntk::get_four_from_ethernet( index.packet( p ) );
+            ASSERT_EQ( four, p.reverse ? ntk::flip_four( flow.four ) : flow.four );
+            ASSERT_TRUE( flow.is_sent_by( p, four ) );
+        }
+        indexed += flow.packets.size();
+
+        ASSERT_EQ( index.find( flow.four ), &flow );
+        ASSERT_EQ( index.find( ntk::flip_four( flow.four ) ), &flow );
+    }
+
+    ASSERT_EQ( indexed, std::count_if( packet_data.begin(), packet_data.end(), ntk::is_tcp_v ) );
+}
+
+TEST( PacketParsingTests, FlowIndexOverloadsMatchSessionScans ) {
+
+    std::vector<std::string> files = {
+        test::packet_data_files[ "checkerboard" ],
+        test::packet_data_files[ "tiny_cross" ],
+    };
+
+    for ( auto& file : files ) {
+
+        auto packet_data = ntk::read_packets_from_file( file );
+
+        ntk::flow_index index( packet_data );
+
+        ASSERT_EQ( ntk::get_four_tuples( index ).size(), index.size() );
+
+        for ( auto& flow : index.flows() ) {
+            auto four = flow.four;
+            ASSERT_EQ( ntk::get_handshake( four, index ), ntk::get_handshake( four, packet_data ) );
+            ASSERT_EQ( ntk::get_handshakes( four, index ), ntk::get_handshakes( four, packet_data ) );
+            ASSERT_EQ( ntk::get_termination( four, index ), ntk::get_termination( four, packet_data ) );
+            ASSERT_EQ( ntk::get_terminations( four, index ), ntk::get_terminations( four, packet_data ) );
+            ASSERT_EQ( ntk::extract_payloads( four, index ), ntk::extract_payloads( four, packet_data ) );
+            ASSERT_EQ( ntk::extract_payloads( ntk::flip_four( four ), index ), ntk::extract_payloads( ntk::flip_four( four ), packet_data ) );
+        }
+
+        auto split_index = ntk::split_payloads( index );
+        auto split_session = ntk::split_payloads( packet_data );
+
+        ASSERT_EQ( split_index.has_value(), split_session.has_value() );
+        if ( split_index ) {
+            ASSERT_EQ( split_index->client_payloads, split_session->client_payloads );
+            ASSERT_EQ( split_index->server_payloads, split_session->server_payloads );
+        }
+    }
+}
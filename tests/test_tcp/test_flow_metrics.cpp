@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <vector>
+#include <cstdint>
+
+#include <flow_metrics.hpp>
+#include <spmc_queue.hpp>
+#include <tcp.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+namespace {
+
+    const std::vector<uint8_t> payload_bytes( 1500, 0x41 );
+
+    ntk::decoded_packet segment( uint32_t seq, uint32_t ack, uint8_t flags, size_t payload_len = 0, uint16_t window = 1024 ) {
+        ntk::decoded_packet packet{};
+        packet.sequence_number = seq;
+        packet.acknowledgment_number = ack;
+        packet.flags = flags;
+        packet.window_size = window;
+        packet.payload = std::span<const uint8_t>( payload_bytes.data(), payload_len );
+        return packet;
+    }
+
+    constexpr uint8_t syn = 0x02, syn_ack = 0x12, ack = 0x10, psh_ack = 0x18;
+}
+
+TEST( FlowMetricsTests, CountsRetransmissionsReorderingAndZeroWindows ) {
+
+    ntk::capture_time start = ntk::to_capture_time( 1700000000, 0 );
+    auto at = [&]( int ms ) { return start + std::chrono::milliseconds( ms ); };
+
+    ntk::flow_metrics metrics;
+    metrics.add( segment( 100, 0, syn ), true, at( 0 ) );
+    metrics.add( segment( 500, 101, syn_ack ), false, at( 10 ) );
+    metrics.add( segment( 101, 501, ack ), true, at( 20 ) );
+
+    metrics.add( segment( 101, 501, psh_ack, 100 ), true, at( 21 ) );
+    // 201 to 301 is missing and turns up a millisecond later, within the handshake rtt
+    metrics.add( segment( 301, 501, psh_ack, 100 ), true, at( 22 ) );
+    metrics.add( segment( 201, 501, psh_ack, 100 ), true, at( 23 ) );
+    // bytes already seen
+    metrics.add( segment( 101, 501, psh_ack, 100 ), true, at( 24 ) );
+
+    metrics.add( segment( 501, 401, ack, 0, 0 ), false, at( 25 ) );
+    metrics.add( segment( 501, 401, ack, 0, 0 ), false, at( 26 ) );
+    metrics.add( segment( 501, 401, ack, 0, 4096 ), false, at( 27 ) );
+    metrics.add( segment( 501, 401, psh_ack, 50, 0 ), false, at( 28 ) );
+
+    ASSERT_EQ( metrics.handshake_rtt(), std::chrono::milliseconds( 20 ) );
+    ASSERT_EQ( metrics.duration(), std::chrono::milliseconds( 28 ) );
+
+    ASSERT_EQ( metrics.client().packets, 6 );
+    ASSERT_EQ( metrics.client().bytes, 400 );
+    ASSERT_EQ( metrics.client().out_of_order, 1 );
+    ASSERT_EQ( metrics.client().retransmissions, 1 );
+    ASSERT_EQ( metrics.client().zero_windows, 0 );
+
+    ASSERT_EQ( metrics.server().packets, 5 );
+    ASSERT_EQ( metrics.server().bytes, 50 );
+    ASSERT_EQ( metrics.server().zero_windows, 2 );
+    ASSERT_EQ( metrics.server().retransmissions, 0 );
+}
+
+TEST( FlowMetricsTests, LateGapFillIsARetransmission ) {
+
+    ntk::capture_time start = ntk::to_capture_time( 1700000000, 0 );
+    auto at = [&]( int ms ) { return start + std::chrono::milliseconds( ms ); };
+
+    ntk::flow_metrics metrics;
+    metrics.add( segment( 100, 0, syn ), true, at( 0 ) );
+    metrics.add( segment( 500, 101, syn_ack ), false, at( 1 ) );
+    metrics.add( segment( 101, 501, ack ), true, at( 2 ) );
+
+    // lost before the capture point and sent again long after the handshake rtt
+    metrics.add( segment( 101, 501, psh_ack, 100 ), true, at( 3 ) );
+    metrics.add( segment( 301, 501, psh_ack, 100 ), true, at( 4 ) );
+    metrics.add( segment( 201, 501, psh_ack, 50 ), true, at( 200 ) );
+    // the rest of the hole without timestamps, which can only be reordering
+    metrics.add( segment( 251, 501, psh_ack, 50 ), true );
+
+    ASSERT_EQ( metrics.client().retransmissions, 1 );
+    ASSERT_EQ( metrics.client().out_of_order, 1 );
+}
+
+TEST( TCPLiveStreamSession, FlowMetricsMatchTheCapture ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+    auto client = ntk::get_four_from_ethernet( ntk::get_handshake( four, packet_data ).syn );
+
+    ntk::capture_time start = ntk::to_capture_time( 1700000000, 0 );
+
+    auto run = [&]( const ntk::session_limits& limits ) {
+        ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+        ntk::tcp_live_stream_session live_stream_session( &offload_queue, limits );
+        for ( size_t i = 0; i < packet_data.size(); ++i ) {
+            live_stream_session.feed( ntk::make_captured_packet( start + std::chrono::milliseconds( i ), packet_data[ i ] ) );
+        }
+        live_stream_session.flush();
+        return offload_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+    };
+
+    auto stream = run( ntk::session_limits{} );
+    ASSERT_TRUE( stream.has_value() );
+
+    uint64_t client_packets = 0, client_bytes = 0, server_packets = 0, server_bytes = 0;
+    for ( auto& packet : packet_data ) {
+        if ( !ntk::is_tcp_v( packet ) || ntk::flow_key( ntk::get_four_from_ethernet( packet ) ) != ntk::flow_key( four ) ) continue;
+        auto bytes = ntk::extract_payload_from_ethernet( packet ).size();
+        if ( ntk::get_four_from_ethernet( packet ) == client ) {
+            client_packets++;
+            client_bytes += bytes;
+        } else {
+            server_packets++;
+            server_bytes += bytes;
+        }
+    }
+
+    auto& metrics = stream->metrics();
+    ASSERT_EQ( metrics.client().packets, client_packets );
+    ASSERT_EQ( metrics.client().bytes, client_bytes );
+    ASSERT_EQ( metrics.server().packets, server_packets );
+    ASSERT_EQ( metrics.server().bytes, server_bytes );
+    ASSERT_EQ( metrics.handshake_rtt(), stream->handshake_rtt() );
+    ASSERT_EQ( metrics.duration(), *stream->timing().last_packet - *stream->timing().first_packet );
+
+    // the same numbers with nothing stored
+    auto counted = run( ntk::session_limits{ .metrics_only = true } );
+    ASSERT_TRUE( counted.has_value() );
+    ASSERT_TRUE( counted->is_complete() );
+    ASSERT_EQ( counted->memory().in_memory(), 0 );
+    ASSERT_TRUE( counted->client_payload().empty() );
+    ASSERT_FALSE( counted->traffic_contains( []( std::span<const uint8_t> ) { return true; } ) );
+
+    ASSERT_EQ( counted->metrics().client().packets, metrics.client().packets );
+    ASSERT_EQ( counted->metrics().client().bytes, metrics.client().bytes );
+    ASSERT_EQ( counted->metrics().client().retransmissions, metrics.client().retransmissions );
+    ASSERT_EQ( counted->metrics().server().out_of_order, metrics.server().out_of_order );
+    ASSERT_EQ( counted->metrics().handshake_rtt(), metrics.handshake_rtt() );
+}
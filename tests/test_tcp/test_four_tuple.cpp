@@ -45,4 +45,58 @@ TEST( PacketParsingTests, TinyCrossFourTupleSet ) {
     auto four_tuples = ntk::get_four_tuples( packet_data );
 
     ASSERT_EQ( four_tuples.size(), 1 ); 
-}
\ No newline at end of file
+}
+TEST( PacketParsingTests, FlowKeyIgnoresDirection ) {
+
+    ntk::four_tuple four = ntk::get_four_from_ethernet( test_constants::tcp_syn_packet );
+
+    ntk::flow_key key( four );
+    ntk::flow_key flipped_key( ntk::flip_four( four ) );
+
+    ASSERT_EQ( key, flipped_key );
+    ASSERT_EQ( ntk::flow_key_hash{}( key ), ntk::flow_key_hash{}( flipped_key ) );
+
+    // neighbouring NAT clients must not collide
+    ntk::four_tuple neighbour = four;
+    neighbour.client_ip = ntk::ip_address( four.client_ip.v4() + 1 );
+    neighbour.client_port += 1;
+    ASSERT_NE( ntk::flow_key_hash{}( neighbour ), ntk::flow_key_hash{}( key ) );
+}
+
+TEST( PacketParsingTests, ToeplitzHashMatchesRSSVerificationSuite ) {
+
+    // key and first ipv4 / tcp vector of the receive side scaling verification suite
+    const uint8_t rss_key[ 40 ] = {
+        0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2, 0x41, 0x67,
+        0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0, 0xd0, 0xca, 0x2b, 0xcb,
+        0xae, 0x7b, 0x30, 0xb4, 0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30,
+        0xf2, 0x0c, 0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa
+    };
+
+    ntk::toeplitz_hasher hasher( rss_key );
+
+    ntk::four_tuple four = {
+        .client_ip = 0x420995bb,    // 66.9.149.187
+        .server_ip = 0xa18e6450,    // 161.142.100.80
+        .client_port = 2794,
+        .server_port = 1766
+    };
+
+    ASSERT_EQ( hasher( four ), 0x51ccc178 );
+
+    // and its first ipv6 / tcp vector
+    const uint8_t client_v6[ 16 ] = { 0x3f, 0xfe, 0x25, 0x01, 0x02, 0x00, 0x1f, 0xff, 0, 0, 0, 0, 0, 0, 0, 0x07 };
+    const uint8_t server_v6[ 16 ] = { 0x3f, 0xfe, 0x25, 0x01, 0x02, 0x00, 0x00, 0x03, 0, 0, 0, 0, 0, 0, 0, 0x01 };
+
+    ntk::four_tuple four_v6 = {
+        .client_ip = ntk::ip_address::from_bytes( client_v6 ),
+        .server_ip = ntk::ip_address::from_bytes( server_v6 ),
+        .client_port = 2794,
+        .server_port = 1766
+    };
+
+    ASSERT_EQ( hasher( four_v6 ), 0x40207d3d );
+
+    ntk::toeplitz_hasher symmetric_hasher( ntk::symmetric_rss_key );
+    ASSERT_EQ( symmetric_hasher( four ), symmetric_hasher( ntk::flip_four( four ) ) );
+}
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+#include <flow_index.hpp>
+#include <generator.hpp>
+#include <tcp.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+namespace {
+
+    template<typename T>
+    std::vector<T> collect( ntk::generator<T> lazy ) {
+        std::vector<T> all;
+        for ( auto&& value : lazy ) all.push_back( std::move( value ) );
+        return all;
+    }
+
+    ntk::generator<int> count_to( int last, int& resumed ) {
+        for ( int i = 1; i <= last; ++i ) {
+            ++resumed;
+            co_yield i;
+        }
+        throw std::runtime_error( "ran past the end" );
+    }
+
+} // namespace
+
+TEST( GeneratorTests, StopsWhereTheCallerStops ) {
+
+    int resumed = 0;
+
+    std::vector<int> taken;
+    for ( int i : count_to( 100, resumed ) ) {
+        taken.push_back( i );
+        if ( taken.size() == 3 ) break;
+    }
+    ASSERT_EQ( taken, ( std::vector<int>{ 1, 2, 3 } ) );
+    ASSERT_EQ( resumed, 3 );
+
+    // and composes with views, take moving on to the element after the last it gives
+    resumed = 0;
+    std::vector<int> doubled;
+    for ( int i : count_to( 100, resumed ) | std::views::transform( []( int i ) { return i * 2; } ) | std::views::take( 2 ) ) {
+        doubled.push_back( i );
+    }
+    ASSERT_EQ( doubled, ( std::vector<int>{ 2, 4 } ) );
+    ASSERT_EQ( resumed, 3 );
+
+    // nothing runs before the first begin()
+    resumed = 0;
+    auto untouched = count_to( 100, resumed );
+    ASSERT_EQ( resumed, 0 );
+
+    // an exception comes out of the increment that reached it
+    auto all = count_to( 2, resumed );
+    auto it = all.begin();
+    ++it;
+    ASSERT_THROW( ++it, std::runtime_error );
+}
+
+TEST( GeneratorTests, LazyFramesMatchEagerExtraction ) {
+
+    for ( std::string name : { "tls_handshake", "tiny_cross", "lena" } ) {
+
+        auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ name ] );
+
+        auto eager = ntk::extract_raw_tcp_stream( packet_data );
+        auto lazy = collect( ntk::generate_raw_tcp_stream( packet_data ) );
+
+        ASSERT_EQ( lazy.size(), eager.size() ) << name;
+        for ( size_t i = 0; i < eager.size(); ++i ) {
+            ASSERT_EQ( lazy[ i ].header, eager[ i ].header ) << name << " " << i;
+            ASSERT_EQ( lazy[ i ].body, eager[ i ].body ) << name << " " << i;
+        }
+
+        ntk::tcp_stream stream;
+        for ( auto&& [ sequence_number, body ] : ntk::generate_tcp_segments( ntk::generate_raw_tcp_stream( packet_data ) ) ) {
+            stream[ sequence_number ] = std::move( body );
+        }
+        ASSERT_EQ( stream, ntk::get_tcp_stream( eager ) ) << name;
+    }
+}
+
+TEST( GeneratorTests, LazyFlowScansMatchEagerOnes ) {
+
+    for ( std::string name : { "tls_handshake", "tiny_cross", "checkerboard", "lena" } ) {
+
+        auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ name ] );
+        ntk::flow_index index( packet_data );
+
+        for ( auto& four : ntk::get_four_tuples( packet_data ) ) {
+            for ( auto& direction : { four, ntk::flip_four( four ) } ) {
+
+                ASSERT_EQ( collect( ntk::generate_handshakes( direction, packet_data ) ), ntk::get_handshakes( direction, packet_data ) ) << name;
+                ASSERT_EQ( collect( ntk::generate_handshakes( direction, index ) ), ntk::get_handshakes( direction, index ) ) << name;
+
+                ASSERT_EQ( collect( ntk::generate_terminations( direction, packet_data ) ), ntk::get_terminations( direction, packet_data ) ) << name;
+                ASSERT_EQ( collect( ntk::generate_terminations( direction, index ) ), ntk::get_terminations( direction, index ) ) << name;
+
+                ASSERT_EQ( collect( ntk::generate_payloads( direction, packet_data ) ), ntk::extract_payloads( direction, packet_data ) ) << name;
+                ASSERT_EQ( collect( ntk::generate_payloads( direction, index ) ), ntk::extract_payloads( direction, index ) ) << name;
+            }
+        }
+    }
+}
@@ -1,9 +1,28 @@
+#include <span>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include <gtest/gtest.h>
 
 #include <http.hpp>
 
+TEST( PacketParsingTests, HTTPSingleChunkWithoutThrowing ) {
+
+    auto decode = []( std::string_view body ) {
+        return ntk::try_decode_single_chunk( std::span<const uint8_t>( reinterpret_cast<const uint8_t*>( body.data() ), body.size() ) );
+    };
+
+    auto chunk = decode( "a;ext=1\r\n0123456789\r\n0\r\n\r\n" );
+    ASSERT_TRUE( chunk.has_value() );
+    ASSERT_EQ( std::string_view( reinterpret_cast<const char*>( chunk->data() ), chunk->size() ), "0123456789" );
+
+    ASSERT_FALSE( decode( "zz\r\nabc" ).has_value() );
+    ASSERT_FALSE( decode( "10\r\nshort" ).has_value() );
+    ASSERT_FALSE( decode( "ffffffffffffffffff\r\n" ).has_value() );
+    ASSERT_FALSE( decode( "5" ).has_value() );
+}
+
 TEST( PacketParsingTests, HTTPChunkedBodyDecoding ) {
 
     std::vector<uint8_t> chunked_data = {
@@ -20,4 +39,60 @@ TEST( PacketParsingTests, HTTPChunkedBodyDecoding ) {
     };
 
     ASSERT_EQ( expected_decoded_data, actual_decoded_data );
-}
\ No newline at end of file
+}
+TEST( PacketParsingTests, HTTPChunkedDecoderAcrossSlices ) {
+
+    std::string chunked = "4;name=value\r\nWiki\r\n5 \r\npedia\r\nE\r\n in\r\n\r\nchunks.\r\n0\r\nExpires: never\r\n\r\n";
+
+    for ( size_t step = 1; step <= chunked.size(); ++step ) {
+
+        ntk::chunked_decoder decoder;
+        std::string decoded;
+
+        for ( size_t i = 0; i < chunked.size(); i += step ) {
+            auto slice = std::string_view( chunked ).substr( i, step );
+            size_t consumed = decoder.feed( std::span<const uint8_t>( reinterpret_cast<const uint8_t*>( slice.data() ), slice.size() ),
+                [&]( std::span<const uint8_t> data ) { decoded.append( data.begin(), data.end() ); } );
+            ASSERT_EQ( consumed, slice.size() );
+        }
+
+        ASSERT_TRUE( decoder.done() ) << "step " << step;
+        ASSERT_EQ( decoded, "Wikipedia in\r\n\r\nchunks." ) << "step " << step;
+    }
+}
+
+TEST( PacketParsingTests, HTTPChunkedDecoderInPlace ) {
+
+    std::vector<uint8_t> buffer = {
+        '4', '\r', '\n', 'W', 'i', 'k', 'i', '\r', '\n',
+        '5', '\r', '\n', 'p', 'e', 'd', 'i', 'a', '\r', '\n',
+        '0', '\r', '\n', '\r', '\n'
+    };
+
+    ntk::chunked_decoder decoder;
+    size_t decoded = decoder.decode_in_place( buffer );
+
+    ASSERT_TRUE( decoder.done() );
+    ASSERT_EQ( std::string( buffer.begin(), buffer.begin() + decoded ), "Wikipedia" );
+}
+
+TEST( PacketParsingTests, HTTPChunkedDecoderTruncatedAndMalformed ) {
+
+    std::string truncated = "a\r\n0123";
+    ntk::chunked_decoder decoder;
+    std::string decoded;
+    decoder.feed( std::span<const uint8_t>( reinterpret_cast<const uint8_t*>( truncated.data() ), truncated.size() ),
+        [&]( std::span<const uint8_t> data ) { decoded.append( data.begin(), data.end() ); } );
+
+    ASSERT_FALSE( decoder.done() );
+    ASSERT_FALSE( decoder.failed() );
+    ASSERT_EQ( decoded, "0123" );
+
+    // the chunk runs past its size
+    std::string overrun = "3\r\nabcd\r\n0\r\n\r\n";
+    decoder.reset();
+    decoder.feed( std::span<const uint8_t>( reinterpret_cast<const uint8_t*>( overrun.data() ), overrun.size() ),
+        []( std::span<const uint8_t> ) {} );
+
+    ASSERT_TRUE( decoder.failed() );
+}
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include <span>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+#include <zlib.h>
+
+#include <decompress.hpp>
+
+namespace {
+
+    // window_bits as deflateInit2 takes them: 16 + 15 gzip, 15 zlib, -15 raw
+    std::vector<uint8_t> deflate_with( const std::string& text, int window_bits ) {
+        z_stream stream{};
+        deflateInit2( &stream, Z_BEST_COMPRESSION, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY );
+        std::vector<uint8_t> out( deflateBound( &stream, text.size() ) + 32 );
+        stream.next_in = reinterpret_cast<Bytef*>( const_cast<char*>( text.data() ) );
+        stream.avail_in = text.size();
+        stream.next_out = out.data();
+        stream.avail_out = out.size();
+        deflate( &stream, Z_FINISH );
+        out.resize( stream.total_out );
+        deflateEnd( &stream );
+        return out;
+    }
+
+    std::string sample_text() {
+        std::string text;
+        for ( int i = 0; i < 20000; ++i ) text += "line " + std::to_string( i % 977 ) + " of a large api response\n";
+        return text;
+    }
+
+} // namespace
+
+TEST( DecompressTests, ContentCodingFromHeader ) {
+    ASSERT_EQ( ntk::parse_content_coding( "gzip" ), ntk::content_coding::GZIP );
+    ASSERT_EQ( ntk::parse_content_coding( " X-GZIP " ), ntk::content_coding::GZIP );
+    ASSERT_EQ( ntk::parse_content_coding( "deflate" ), ntk::content_coding::DEFLATE );
+    ASSERT_EQ( ntk::parse_content_coding( "" ), ntk::content_coding::IDENTITY );
+    ASSERT_FALSE( ntk::parse_content_coding( "br" ).has_value() );
+}
+
+TEST( DecompressTests, InflatesEachFramingChunkByChunk ) {
+
+    auto text = sample_text();
+    ntk::inflater_pool pool;
+
+    struct framing { ntk::content_coding coding; int window_bits; };
+    for ( auto [ coding, window_bits ] : { framing{ ntk::content_coding::GZIP, 16 + 15 },
+                                           framing{ ntk::content_coding::DEFLATE, 15 },
+                                           framing{ ntk::content_coding::DEFLATE, -15 } } ) {
+
+        auto compressed = deflate_with( text, window_bits );
+
+        ntk::inflater inflater( coding, pool );
+        std::string out;
+        for ( size_t i = 0; i < compressed.size(); i += 1000 ) {
+            auto chunk = std::span<const uint8_t>( compressed ).subspan( i, std::min<size_t>( 1000, compressed.size() - i ) );
+            auto fed = inflater.feed( chunk, [&]( std::span<const uint8_t> output ) {
+                ASSERT_LE( output.size(), ntk::inflater_pool::output_size );
+                out.append( output.begin(), output.end() );
+            });
+            ASSERT_TRUE( fed.has_value() ) << fed.error();
+        }
+
+        ASSERT_TRUE( inflater.done() ) << window_bits;
+        ASSERT_EQ( out, text ) << window_bits;
+        ASSERT_EQ( inflater.total_out(), text.size() );
+    }
+
+    // the streams went back to the pool when each ended, and were reused
+    ASSERT_EQ( pool.idle(), 1 );
+}
+
+TEST( DecompressTests, CorruptInputFails ) {
+
+    auto compressed = deflate_with( sample_text(), 16 + 15 );
+    compressed[ 20 ] ^= 0xff;
+    compressed[ 21 ] ^= 0xff;
+
+    ntk::inflater inflater( ntk::content_coding::GZIP );
+    auto fed = inflater.feed( compressed, []( std::span<const uint8_t> ) {} );
+
+    ASSERT_FALSE( fed.has_value() );
+    ASSERT_THROW( ntk::decompress_gzip( compressed ), std::runtime_error );
+    ASSERT_EQ( ntk::decompress_gzip( deflate_with( "hello", 16 + 15 ) ), "hello" );
+}
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstdint>
+
+#include <hpack.hpp>
+
+namespace {
+
+    std::vector<uint8_t> from_hex( std::string_view hex ) {
+        std::vector<uint8_t> bytes;
+        for ( size_t i = 0; i + 1 < hex.size(); i += 2 ) bytes.push_back( static_cast<uint8_t>( std::stoi( std::string( hex.substr( i, 2 ) ), nullptr, 16 ) ) );
+        return bytes;
+    }
+
+    std::vector<std::string> decode( ntk::hpack_decoder& decoder, std::string_view hex ) {
+        std::vector<ntk::hpack_header> headers;
+        auto decoded = decoder.decode( from_hex( hex ), headers );
+        EXPECT_TRUE( decoded.has_value() ) << decoded.error();
+        std::vector<std::string> lines;
+        for ( const auto& header : headers ) lines.push_back( header.name + ": " + header.value );
+        return lines;
+    }
+
+} // namespace
+
+TEST( HPACKTests, HuffmanStrings ) {
+
+    ASSERT_EQ( ntk::hpack_huffman_decode( from_hex( "f1e3c2e5f23a6ba0ab90f4ff" ) ).value(), "www.example.com" );
+    ASSERT_EQ( ntk::hpack_huffman_decode( from_hex( "a8eb10649cbf" ) ).value(), "no-cache" );
+    ASSERT_EQ( ntk::hpack_huffman_decode( {} ).value(), "" );
+
+    // padding has to be the start of eos, all ones and shorter than a byte
+    ASSERT_FALSE( ntk::hpack_huffman_decode( from_hex( "00" ) ).has_value() );
+    ASSERT_FALSE( ntk::hpack_huffman_decode( from_hex( "ff" ) ).has_value() );
+    ASSERT_FALSE( ntk::hpack_huffman_decode( from_hex( "ffffffff" ) ).has_value() );
+}
+
+// rfc 7541 c.4, requests on one connection with huffman coding
+TEST( HPACKTests, RequestsShareTheDynamicTable ) {
+
+    ntk::hpack_decoder decoder;
+
+    std::vector<std::string> first = { ":method: GET", ":scheme: http", ":path: /", ":authority: www.example.com" };
+    ASSERT_EQ( decode( decoder, "828684418cf1e3c2e5f23a6ba0ab90f4ff" ), first );
+    ASSERT_EQ( decoder.table_size(), 57 );
+
+    std::vector<std::string> second = { ":method: GET", ":scheme: http", ":path: /", ":authority: www.example.com", "cache-control: no-cache" };
+    ASSERT_EQ( decode( decoder, "828684be5886a8eb10649cbf" ), second );
+    ASSERT_EQ( decoder.table_size(), 110 );
+
+    std::vector<std::string> third = { ":method: GET", ":scheme: https", ":path: /index.html", ":authority: www.example.com", "custom-key: custom-value" };
+    ASSERT_EQ( decode( decoder, "828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf" ), third );
+    ASSERT_EQ( decoder.table_size(), 164 );
+    ASSERT_EQ( decoder.table_entries(), 3 );
+}
+
+TEST( HPACKTests, TableSizeAndErrors ) {
+
+    ntk::hpack_decoder decoder;
+    decode( decoder, "828684418cf1e3c2e5f23a6ba0ab90f4ff" );
+    ASSERT_EQ( decoder.table_entries(), 1 );
+
+    // a size update to 0 empties the table, so the entry at 62 is gone
+    std::vector<ntk::hpack_header> headers;
+    ASSERT_TRUE( decoder.decode( from_hex( "20" ), headers ).has_value() );
+    ASSERT_EQ( decoder.table_size(), 0 );
+    ASSERT_FALSE( decoder.decode( from_hex( "be" ), headers ).has_value() );
+
+    // above what SETTINGS allowed
+    decoder.set_max_table_size( 100 );
+    ASSERT_FALSE( decoder.decode( from_hex( "3f4a" ), headers ).has_value() );      // 31 + 74 = 105
+
+    // index 0, a truncated integer and a string running past the block
+    ASSERT_FALSE( decoder.decode( from_hex( "80" ), headers ).has_value() );
+    ASSERT_FALSE( decoder.decode( from_hex( "ff" ), headers ).has_value() );
+    ASSERT_FALSE( decoder.decode( from_hex( "000541" ), headers ).has_value() );
+}
@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstdint>
+
+#include <http2.hpp>
+
+namespace {
+
+    std::vector<uint8_t> from_hex( std::string_view hex ) {
+        std::vector<uint8_t> bytes;
+        for ( size_t i = 0; i + 1 < hex.size(); i += 2 ) bytes.push_back( static_cast<uint8_t>( std::stoi( std::string( hex.substr( i, 2 ) ), nullptr, 16 ) ) );
+        return bytes;
+    }
+
+    void append_frame( std::vector<uint8_t>& out, ntk::http2_frame_type type, uint8_t flags, uint32_t stream_id, std::span<const uint8_t> payload ) {
+        uint32_t length = static_cast<uint32_t>( payload.size() );
+        uint8_t header[] = {
+            uint8_t( length >> 16 ), uint8_t( length >> 8 ), uint8_t( length ),
+            static_cast<uint8_t>( type ), flags,
+            uint8_t( stream_id >> 24 ), uint8_t( stream_id >> 16 ), uint8_t( stream_id >> 8 ), uint8_t( stream_id )
+        };
+        out.insert( out.end(), std::begin( header ), std::end( header ) );
+        out.insert( out.end(), payload.begin(), payload.end() );
+    }
+
+    void append_frame( std::vector<uint8_t>& out, ntk::http2_frame_type type, uint8_t flags, uint32_t stream_id, std::string_view payload ) {
+        append_frame( out, type, flags, stream_id, std::span<const uint8_t>( reinterpret_cast<const uint8_t*>( payload.data() ), payload.size() ) );
+    }
+
+    struct recorded_stream : ntk::http_events {
+
+        void on_request( const ntk::http_request& request ) override {
+            events.push_back( "request " + request.request_line.method_token + " " + request.request_line.path +
+                " " + std::string( request.header_view.get( "Host" ).value_or( "" ) ) );
+        }
+
+        void on_response( const ntk::http_response& response, const ntk::http_request* request ) override {
+            events.push_back( "response " + std::to_string( response.status_line.status_code ) + " " +
+                ( request ? request->request_line.path : "?" ) + " " +
+                std::string( response.header_view.content_type().value_or( "" ) ) );
+        }
+
+        void on_body( ntk::http_type type, std::span<const uint8_t> data ) override {
+            body.append( data.begin(), data.end() );
+        }
+
+        void on_message_end( ntk::http_type type, bool complete ) override {
+            events.push_back( std::string( type == ntk::http_type::REQUEST ? "request" : "response" ) +
+                ( complete ? " end" : " cut" ) );
+        }
+
+        std::vector<std::string> events;
+        std::string body;
+    };
+
+    struct recorded_connection : ntk::http2_events {
+
+        ntk::http_events* on_stream( uint32_t stream_id ) override {
+            return &streams[ stream_id ];
+        }
+
+        void on_stream_end( uint32_t stream_id ) override {
+            ended.push_back( stream_id );
+        }
+
+        void on_error( const std::string& reason ) override {
+            errors.push_back( reason );
+        }
+
+        std::map<uint32_t,recorded_stream> streams;
+        std::vector<uint32_t> ended;
+        std::vector<std::string> errors;
+    };
+
+    void feed( ntk::http2_connection_parser& parser, ntk::stream_direction direction, std::span<const uint8_t> data, size_t step ) {
+        for ( size_t i = 0; i < data.size(); i += step ) {
+            parser.feed( direction, data.subspan( i, std::min( step, data.size() - i ) ) );
+        }
+    }
+
+    using type = ntk::http2_frame_type;
+    constexpr uint8_t end_stream = 0x1;
+    constexpr uint8_t end_headers = 0x4;
+    constexpr uint8_t padded = 0x8;
+
+} // namespace
+
+TEST( HTTP2Tests, MultiplexedStreams ) {
+
+    // the request blocks of rfc 7541 c.4, the second refers to the first's dynamic entry
+    std::vector<uint8_t> client( ntk::http2_client_preface.begin(), ntk::http2_client_preface.end() );
+    append_frame( client, type::SETTINGS, 0, 0, "" );
+    append_frame( client, type::HEADERS, end_stream | end_headers, 1, from_hex( "828684418cf1e3c2e5f23a6ba0ab90f4ff" ) );
+    append_frame( client, type::HEADERS, end_stream | end_headers, 3, from_hex( "828684be5886a8eb10649cbf" ) );
+
+    // :status 200, content-type video/mp2t, content-length 11, then :status 200, content-type from the
+    // dynamic table, x-trace a. the second block is split over a CONTINUATION
+    auto second_block = from_hex( "88bf4085f2b26c190b811f" );
+    std::vector<uint8_t> server;
+    append_frame( server, type::SETTINGS, 0, 0, "" );
+    append_frame( server, type::HEADERS, end_headers, 1, from_hex( "885f87ee690a7629ac495c82087f" ) );
+    append_frame( server, type::HEADERS, 0, 3, std::span( second_block ).first( 4 ) );
+    append_frame( server, type::CONTINUATION, end_headers, 3, std::span( second_block ).subspan( 4 ) );
+    append_frame( server, type::DATA, 0, 1, "hello " );
+    append_frame( server, type::DATA, padded, 3, std::string_view( "\x02" "abc\0\0", 6 ) );
+    append_frame( server, type::PING, 0, 0, "12345678" );
+    append_frame( server, type::DATA, end_stream, 1, "world" );
+    append_frame( server, type::DATA, end_stream, 3, "" );
+
+    for ( size_t step : { size_t( 1 ), size_t( 5 ), client.size() + server.size() } ) {
+
+        recorded_connection events;
+        ntk::http2_connection_parser parser( events );
+
+        feed( parser, ntk::stream_direction::CLIENT_TO_SERVER, client, step );
+        feed( parser, ntk::stream_direction::SERVER_TO_CLIENT, server, step );
+
+        ASSERT_TRUE( events.errors.empty() ) << events.errors.front();
+        ASSERT_EQ( events.streams.size(), 2 );
+
+        std::vector<std::string> first = { "request GET / www.example.com", "request end", "response 200 / video/mp2t", "response end" };
+        ASSERT_EQ( events.streams[ 1 ].events, first ) << "step " << step;
+        ASSERT_EQ( events.streams[ 1 ].body, "hello world" );
+
+        std::vector<std::string> second = { "request GET / www.example.com", "request end", "response 200 / video/mp2t", "response end" };
+        ASSERT_EQ( events.streams[ 3 ].events, second ) << "step " << step;
+        ASSERT_EQ( events.streams[ 3 ].body, "abc" );
+
+        ASSERT_EQ( events.ended, std::vector<uint32_t>( { 1, 3 } ) );
+    }
+}
+
+TEST( HTTP2Tests, InterimResetAndNotHTTP2 ) {
+
+    std::vector<uint8_t> client( ntk::http2_client_preface.begin(), ntk::http2_client_preface.end() );
+    append_frame( client, type::HEADERS, end_headers, 1, from_hex( "828684418cf1e3c2e5f23a6ba0ab90f4ff" ) );
+    append_frame( client, type::DATA, 0, 1, "part" );
+
+    std::vector<uint8_t> server;
+    append_frame( server, type::HEADERS, end_headers, 1, from_hex( "48820801" ) );        // :status 100
+
+    std::vector<uint8_t> reset;
+    append_frame( reset, type::RST_STREAM, 0, 1, std::string_view( "\0\0\0\x08", 4 ) );
+
+    recorded_connection events;
+    ntk::http2_connection_parser parser( events );
+    ASSERT_TRUE( parser.feed( ntk::stream_direction::CLIENT_TO_SERVER, client ) );
+    ASSERT_TRUE( parser.feed( ntk::stream_direction::SERVER_TO_CLIENT, server ) );
+    ASSERT_TRUE( parser.feed( ntk::stream_direction::CLIENT_TO_SERVER, reset ) );
+
+    std::vector<std::string> expected = { "request GET / www.example.com", "response 100 / ", "response end", "request cut" };
+    ASSERT_EQ( events.streams[ 1 ].events, expected );
+    ASSERT_EQ( events.streams[ 1 ].body, "part" );
+    ASSERT_EQ( events.ended, std::vector<uint32_t>( { 1 } ) );
+
+    // a http/1.1 request fails on its first bytes
+    recorded_connection plain;
+    ntk::http2_connection_parser plain_parser( plain );
+    std::string_view request = "GET / HTTP/1.1\r\n";
+    ASSERT_FALSE( plain_parser.feed( ntk::stream_direction::CLIENT_TO_SERVER,
+        std::span<const uint8_t>( reinterpret_cast<const uint8_t*>( request.data() ), request.size() ) ) );
+    ASSERT_EQ( plain.errors.size(), 1 );
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include <cstdint>
+
+#include <http.hpp>
+#include <tcp.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+TEST( HTTPBodyViewTests, ChunkedBodyStaysInTheSegments ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "lena" ] );
+    auto merged_tcp_stream = ntk::get_merged_tcp_stream( packet_data );
+
+    auto body = ntk::get_http_response_body( merged_tcp_stream );
+
+    // what the lena test builds by concatenating every segment and then dechunking
+    std::vector<uint8_t> chunked;
+    for ( auto& [ sequence_number, tcp_body ] : merged_tcp_stream ) {
+        if ( ntk::get_http_type( tcp_body ) == ntk::http_type::REQUEST ) continue;
+        if ( ntk::get_http_type( tcp_body ) == ntk::http_type::RESPONSE ) {
+            auto [ status_line, headers, rest ] = ntk::split_http_payload( tcp_body );
+            chunked.insert( chunked.end(), rest.begin(), rest.end() );
+            continue;
+        }
+        chunked.insert( chunked.end(), tcp_body.begin(), tcp_body.end() );
+    }
+
+    ASSERT_GT( body.pieces().size(), 1 );
+    ASSERT_EQ( body.to_vector(), ntk::decode_chunked_http_body( chunked ) );
+
+    // every piece points into a segment of the stream, nothing was copied
+    for ( auto piece : body.pieces() ) {
+        bool inside = false;
+        for ( auto& [ sequence_number, tcp_body ] : merged_tcp_stream ) {
+            inside |= piece.data() >= tcp_body.data() && piece.data() + piece.size() <= tcp_body.data() + tcp_body.size();
+        }
+        ASSERT_TRUE( inside );
+    }
+}
+
+TEST( HTTPBodyViewTests, ContentLengthBodyWrittenWithWritev ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "color" ] );
+    auto merged_stream = ntk::get_merged_tcp_stream( packet_data );
+
+    auto headers = ntk::get_http_headers_from_payload( ntk::get_first_http_respone( packet_data ) );
+    auto body = ntk::get_http_response_body( merged_stream );
+
+    ASSERT_EQ( body.size(), std::stoul( headers[ "Content-Length" ] ) );
+    ASSERT_EQ( ntk::get_http_response_data( merged_stream ), body.to_vector() );
+
+    auto file = ( std::filesystem::temp_directory_path() / "ntk_body_view.mp4" ).string();
+    ntk::write_payload_to_file( body, file );
+
+    std::ifstream in( file, std::ios::binary );
+    std::vector<uint8_t> written( ( std::istreambuf_iterator<char>( in ) ), std::istreambuf_iterator<char>() );
+    ASSERT_EQ( written, body.to_vector() );
+
+    std::filesystem::remove( file );
+}
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstdint>
+
+#include <http.hpp>
+#include <tcp.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+namespace {
+
+    struct recorded_http_events : ntk::http_events {
+
+        void on_request( const ntk::http_request& request ) override {
+            events.push_back( "request " + request.request_line.method_token + " " + request.request_line.path );
+        }
+
+        void on_response( const ntk::http_response& response, const ntk::http_request* request ) override {
+            events.push_back( "response " + std::to_string( response.status_line.status_code ) + " " +
+                ( request ? request->request_line.path : "?" ) );
+        }
+
+        void on_body( ntk::http_type type, std::span<const uint8_t> data ) override {
+            auto& body = type == ntk::http_type::REQUEST ? request_body : response_body;
+            body.append( data.begin(), data.end() );
+        }
+
+        void on_message_end( ntk::http_type type, bool complete ) override {
+            events.push_back( std::string( type == ntk::http_type::REQUEST ? "request" : "response" ) +
+                ( complete ? " end" : " cut" ) );
+        }
+
+        void on_error( ntk::http_type type, const std::string& reason ) override {
+            errors.push_back( reason );
+        }
+
+        std::vector<std::string> events;
+        std::string request_body;
+        std::string response_body;
+        std::vector<std::string> errors;
+    };
+
+    // feeds text a few bytes at a time so every state is split across feeds
+    void feed( ntk::http_connection_parser& parser, ntk::stream_direction direction, std::string_view text, size_t step ) {
+        for ( size_t i = 0; i < text.size(); i += step ) {
+            auto part = text.substr( i, step );
+            parser.feed( direction, std::span<const uint8_t>( reinterpret_cast<const uint8_t*>( part.data() ), part.size() ) );
+        }
+    }
+
+} // namespace
+
+TEST( HTTPConnectionParserTests, PipelinedKeepAlive ) {
+
+    std::string requests =
+        "GET /a HTTP/1.1\r\nHost: x\r\n\r\n"
+        "POST /b HTTP/1.1\r\nHost: x\r\ncontent-length: 4\r\n\r\nabcd"
+        "HEAD /c HTTP/1.1\r\nHost: x\r\n\r\n"
+        "GET /d HTTP/1.1\r\nHost: x\r\n\r\n";
+
+    std::string responses =
+        "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello"
+        "HTTP/1.1 100 Continue\r\n\r\n"
+        "HTTP/1.1 201 Created\r\ntransfer-encoding: chunked\r\n\r\n3;x=y\r\nabc\r\n2\r\nde\r\n0\r\nTrailer: t\r\n\r\n"
+        "HTTP/1.1 200 OK\r\nContent-Length: 1000\r\n\r\n"
+        "HTTP/1.1 200 OK\r\n\r\nuntil close";
+
+    for ( size_t step : { size_t( 1 ), size_t( 7 ), requests.size() + responses.size() } ) {
+
+        recorded_http_events events;
+        ntk::http_connection_parser parser( events );
+
+        feed( parser, ntk::stream_direction::CLIENT_TO_SERVER, requests, step );
+        feed( parser, ntk::stream_direction::SERVER_TO_CLIENT, responses, step );
+        parser.finish();
+
+        std::vector<std::string> expected = {
+            "request GET /a", "request end",
+            "request POST /b", "request end",
+            "request HEAD /c", "request end",
+            "request GET /d", "request end",
+            "response 200 /a", "response end",
+            "response 100 /b", "response end",
+            "response 201 /b", "response end",
+            "response 200 /c", "response end",         // no body for a HEAD, whatever its length says
+            "response 200 /d", "response end"          // ended by the close
+        };
+
+        ASSERT_TRUE( events.errors.empty() ) << events.errors.front();
+        ASSERT_EQ( events.events, expected ) << "step " << step;
+        ASSERT_EQ( events.request_body, "abcd" );
+        ASSERT_EQ( events.response_body, "helloabcdeuntil close" );
+    }
+}
+
+TEST( HTTPConnectionParserTests, CutShortAndNotHTTP ) {
+
+    recorded_http_events events;
+    ntk::http_connection_parser parser( events );
+
+    feed( parser, ntk::stream_direction::SERVER_TO_CLIENT, "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nonly", 100 );
+    parser.finish();
+
+    ASSERT_EQ( events.events.back(), "response cut" );
+    ASSERT_EQ( events.response_body, "only" );
+
+    // the start of a ClientHello, given up on without waiting for an empty line
+    std::string tls( "\x16\x03\x01\x02\x00\x01\x00\x01\xfc\x03\x03", 11 );
+    ASSERT_FALSE( parser.feed( ntk::stream_direction::CLIENT_TO_SERVER,
+        std::span<const uint8_t>( reinterpret_cast<const uint8_t*>( tls.data() ), tls.size() ) ) );
+    ASSERT_EQ( events.errors.size(), 1 );
+}
+
+TEST( HTTPConnectionParserTests, ChunkedCaptureMatchesOffload ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "lena" ] );
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+
+    std::vector<uint8_t> server_payload;
+    for ( auto& payload : ntk::extract_payloads( ntk::flip_four( four ), packet_data ) ) {
+        server_payload.insert( server_payload.end(), payload.begin(), payload.end() );
+    }
+    ASSERT_EQ( ntk::get_http_type( server_payload ), ntk::http_type::RESPONSE );
+
+    auto responses = ntk::get_http_responses( server_payload );
+    ASSERT_EQ( responses.size(), 1 );
+
+    auto [ status_line, headers, body ] = ntk::split_http_payload( server_payload );
+    ASSERT_EQ( responses[ 0 ].body, ntk::decode_chunked_http_body( body ) );
+}
@@ -58,4 +58,78 @@ TEST( PacketParsingTests, HttpResponseStatusLine ) {
     auto htpp_response_status_line = ntk::parse_http_status_line( std::get<0>( http_sections ) );
 
     ASSERT_EQ( htpp_response_status_line.status_code, 200 );
-}
\ No newline at end of file
+}
+
+TEST( PacketParsingTests, HttpResponseStatusLineWithoutThrowing ) {
+
+    auto parse = []( std::string_view line ) {
+        return ntk::try_parse_http_status_line( std::span<const uint8_t>( reinterpret_cast<const uint8_t*>( line.data() ), line.size() ) );
+    };
+
+    auto status_line = parse( "HTTP/1.1 404 Not Found\r\n" );
+    ASSERT_TRUE( status_line.has_value() );
+    ASSERT_EQ( status_line->http_version, "HTTP/1.1" );
+    ASSERT_EQ( status_line->status_code, 404 );
+    ASSERT_EQ( status_line->reason_phrase, "Not Found" );
+
+    ASSERT_EQ( parse( "HTTP/1.1 204" )->status_code, 204 );
+    ASSERT_FALSE( parse( "" ).has_value() );
+    ASSERT_FALSE( parse( "HTTP/1.1 OK" ).has_value() );
+    ASSERT_FALSE( parse( "HTTP/1.1 2x0 OK" ).has_value() );
+    ASSERT_FALSE( parse( "HTTP/1.1 99999999999 OK" ).has_value() );
+
+    std::string garbage = "\x16\x03\x01 junk";
+    ASSERT_FALSE( ntk::try_get_http_response( std::vector<uint8_t>( garbage.begin(), garbage.end() ) ).has_value() );
+    ASSERT_THROW( ntk::parse_http_status_line( std::vector<uint8_t>( garbage.begin(), garbage.end() ) ), std::invalid_argument );
+}
+TEST( PacketParsingTests, HttpHeaderNamesIgnoreCase ) {
+
+    std::vector<uint8_t> http_payload = ntk::extract_http_payload_from_ethernet( test::http_get_packet );
+    ntk::http_headers headers = ntk::get_http_headers_from_payload( http_payload );
+
+    ASSERT_TRUE( ntk::contains_http_header( headers, "host" ) );
+    ASSERT_EQ( headers[ "HOST" ], "192.168.0.21:3000" );
+}
+
+TEST( PacketParsingTests, HttpHeaderView ) {
+
+    std::string header_lines =
+        "content-length: 42\r\n"
+        "Content-Type:video/MP2T \r\n"
+        "X-Repeated: first\r\n"
+        "no colon here\r\n"
+        "x-repeated: second\r\n"
+        "Transfer-Encoding: gzip, chunked\r\n";
+
+    ntk::http_header_view headers( header_lines );
+
+    ASSERT_EQ( headers.size(), 5 );
+    ASSERT_EQ( headers.content_length(), 42 );
+    ASSERT_EQ( headers.content_type(), "video/MP2T" );
+    ASSERT_FALSE( headers.content_encoding().has_value() );
+    ASSERT_TRUE( headers.is_chunked() );
+    ASSERT_EQ( headers.get( "X-REPEATED" ), "first" );
+    ASSERT_FALSE( headers.contains( "no colon here" ) );
+
+    // the views point into the lines they were parsed from
+    ASSERT_EQ( headers[ 0 ].name.data(), header_lines.data() );
+
+    auto owned = headers.to_headers();
+    ASSERT_EQ( owned[ "Content-Length" ], "42" );
+    ASSERT_EQ( owned[ "x-repeated" ], "second" );
+}
+
+TEST( PacketParsingTests, HttpHeaderViewBeyondInlineFields ) {
+
+    std::string header_lines;
+    for ( size_t i = 0; i < ntk::http_header_view::inline_fields + 4; ++i ) {
+        header_lines += "X-Field-" + std::to_string( i ) + ": " + std::to_string( i ) + "\r\n";
+    }
+    header_lines += "Content-Encoding: br\r\n";
+
+    ntk::http_header_view headers( header_lines );
+
+    ASSERT_EQ( headers.size(), ntk::http_header_view::inline_fields + 5 );
+    ASSERT_EQ( headers.get( "x-field-26" ), "26" );
+    ASSERT_EQ( headers.content_encoding(), "br" );
+}
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstdint>
+
+#include <http.hpp>
+#include <mp4.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+namespace {
+
+    struct recorded_mp4_events : ntk::mp4_events {
+
+        void on_box_start( const ntk::mp4_box& box ) override {
+            events.push_back( std::string( box.depth, ' ' ) + ntk::mp4_box_type_name( box.type ) + " " +
+                std::to_string( box.offset ) + " " + std::to_string( box.size ) );
+        }
+
+        void on_box_data( const ntk::mp4_box& box, std::span<const uint8_t> data ) override {
+            if ( box.type == ntk::mp4_box_type( "mdat" ) ) mdat.append( data.begin(), data.end() );
+        }
+
+        void on_box_end( const ntk::mp4_box& box ) override {
+            events.push_back( std::string( box.depth, ' ' ) + "/" + ntk::mp4_box_type_name( box.type ) );
+        }
+
+        void on_error( const std::string& reason ) override {
+            errors.push_back( reason );
+        }
+
+        std::vector<std::string> events;
+        std::string mdat;
+        std::vector<std::string> errors;
+    };
+
+    void append_box( std::vector<uint8_t>& out, std::string_view type, std::string_view payload ) {
+        uint32_t size = static_cast<uint32_t>( payload.size() + 8 );
+        uint8_t header[] = { uint8_t( size >> 24 ), uint8_t( size >> 16 ), uint8_t( size >> 8 ), uint8_t( size ),
+                             uint8_t( type[ 0 ] ), uint8_t( type[ 1 ] ), uint8_t( type[ 2 ] ), uint8_t( type[ 3 ] ) };
+        out.insert( out.end(), std::begin( header ), std::end( header ) );
+        out.insert( out.end(), payload.begin(), payload.end() );
+    }
+
+    std::string_view as_text( const std::vector<uint8_t>& bytes ) {
+        return std::string_view( reinterpret_cast<const char*>( bytes.data() ), bytes.size() );
+    }
+
+} // namespace
+
+TEST( MP4ParserTests, FragmentedFileFedInPieces ) {
+
+    std::vector<uint8_t> tfhd, traf, moof, file;
+    append_box( tfhd, "tfhd", "12345678" );
+    append_box( traf, "traf", as_text( tfhd ) );
+    append_box( moof, "mfhd", "abcdefgh" );
+    moof.insert( moof.end(), traf.begin(), traf.end() );
+
+    append_box( file, "ftyp", std::string_view( "iso6\0\0\0\0iso6mp41", 16 ) );
+    append_box( file, "moof", as_text( moof ) );
+    append_box( file, "mdat", "first segment" );
+
+    // a mdat with a 64 bit size
+    std::string_view second = "second";
+    uint64_t size = second.size() + 16;
+    uint8_t large[] = { 0, 0, 0, 1, 'm', 'd', 'a', 't', 0, 0, 0, 0, 0, 0, 0, uint8_t( size ) };
+    file.insert( file.end(), std::begin( large ), std::end( large ) );
+    file.insert( file.end(), second.begin(), second.end() );
+
+    std::vector<std::string> expected = {
+        "ftyp 0 24", "/ftyp",
+        "moof 24 48", " mfhd 32 16", " /mfhd", " traf 48 24", "  tfhd 56 16", "  /tfhd", " /traf", "/moof",
+        "mdat 72 21", "/mdat",
+        "mdat 93 22", "/mdat"
+    };
+
+    for ( size_t step : { size_t( 1 ), size_t( 3 ), file.size() } ) {
+
+        recorded_mp4_events events;
+        ntk::mp4_parser parser( events );
+        for ( size_t i = 0; i < file.size(); i += step ) {
+            ASSERT_TRUE( parser.feed( std::span<const uint8_t>( file ).subspan( i, std::min( step, file.size() - i ) ) ) );
+        }
+
+        ASSERT_TRUE( parser.finish() );
+        ASSERT_TRUE( events.errors.empty() );
+        ASSERT_EQ( events.events, expected ) << "step " << step;
+        ASSERT_EQ( events.mdat, "first segmentsecond" );
+    }
+
+    auto ftyp = ntk::parse_file_type_box( std::span<const uint8_t>( file ).subspan( 8, 16 ) );
+    ASSERT_TRUE( ftyp.has_value() );
+    ASSERT_EQ( ftyp->major_brand, ntk::mp4_box_type( "iso6" ) );
+    ASSERT_EQ( ftyp->compatible_brands, std::vector<uint32_t>( { ntk::mp4_box_type( "iso6" ), ntk::mp4_box_type( "mp41" ) } ) );
+}
+
+TEST( MP4ParserTests, BadSizes ) {
+
+    // a child larger than its parent
+    std::vector<uint8_t> child, file;
+    append_box( child, "mvhd", "12345678" );
+    child[ 3 ] = 100;
+    append_box( file, "moov", as_text( child ) );
+
+    recorded_mp4_events events;
+    ntk::mp4_parser parser( events );
+    ASSERT_FALSE( parser.feed( file ) );
+    ASSERT_EQ( events.errors.size(), 1 );
+
+    // cut short
+    std::vector<uint8_t> mdat;
+    append_box( mdat, "mdat", "payload" );
+    recorded_mp4_events cut_events;
+    ntk::mp4_parser cut( cut_events );
+    ASSERT_TRUE( cut.feed( std::span<const uint8_t>( mdat ).first( 10 ) ) );
+    ASSERT_FALSE( cut.finish() );
+}
+
+TEST( MP4ParserTests, ColorCapture ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "color" ] );
+    auto merged_stream = ntk::get_merged_tcp_stream( packet_data );
+    auto body = ntk::get_http_response_body( merged_stream );
+    ASSERT_FALSE( body.empty() );
+
+    auto boxes = ntk::list_mp4_boxes( body );
+    ASSERT_FALSE( boxes.empty() );
+    ASSERT_EQ( boxes.front().type, ntk::mp4_box_type( "ftyp" ) );
+
+    // the top level boxes cover the whole body
+    uint64_t top_level = 0;
+    bool has_moov = false, has_mdat = false;
+    for ( const auto& box : boxes ) {
+        if ( box.depth > 0 ) continue;
+        ASSERT_EQ( box.offset, top_level );
+        top_level += box.size;
+        has_moov |= box.type == ntk::mp4_box_type( "moov" );
+        has_mdat |= box.type == ntk::mp4_box_type( "mdat" );
+    }
+    ASSERT_EQ( top_level, body.size() );
+    ASSERT_TRUE( has_moov );
+    ASSERT_TRUE( has_mdat );
+}
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <cstdint>
+
+#include <payload_dedup.hpp>
+
+namespace {
+
+    std::span<const uint8_t> as_bytes( std::string_view text ) {
+        return std::span<const uint8_t>( reinterpret_cast<const uint8_t*>( text.data() ), text.size() );
+    }
+
+    ntk::payload_digest digest_of( std::string_view text, size_t step, bool confirm = false ) {
+        ntk::payload_hasher hasher( confirm );
+        for ( size_t i = 0; i < text.size(); i += step ) hasher.update( as_bytes( text.substr( i, step ) ) );
+        return hasher.digest();
+    }
+
+} // namespace
+
+TEST( PayloadDedupTests, DigestDoesNotDependOnPieces ) {
+
+    std::string payload;
+    for ( int i = 0; i < 1000; ++i ) payload.push_back( static_cast<char>( i * 31 ) );
+
+    auto whole = digest_of( payload, payload.size(), true );
+    for ( size_t step : { 1, 7, 16, 100 } ) ASSERT_EQ( digest_of( payload, step, true ), whole ) << "step " << step;
+
+    ASSERT_EQ( whole.size, payload.size() );
+    ASSERT_TRUE( whole.sha256.has_value() );
+
+    // one byte changed, one byte more, or a trailing zero
+    std::string changed = payload;
+    changed[ 500 ] ^= 1;
+    ASSERT_NE( digest_of( changed, 64 ).hash, digest_of( payload, 64 ).hash );
+    ASSERT_NE( digest_of( payload + "x", 64 ), digest_of( payload, 64 ) );
+    ASSERT_NE( digest_of( std::string( "a\0", 2 ), 1 ).hash, digest_of( "a", 1 ).hash );
+
+    // sha-256 of "abc"
+    auto abc = digest_of( "abc", 3, true );
+    ASSERT_EQ( abc.sha256->at( 0 ), 0xba );
+    ASSERT_EQ( abc.sha256->at( 31 ), 0xad );
+}
+
+TEST( PayloadDedupTests, IndexForgetsLeastRecentlySeen ) {
+
+    ntk::payload_dedup_index index( 2 );
+    auto a = digest_of( "a", 1 ), b = digest_of( "b", 1 ), c = digest_of( "c", 1 );
+
+    index.insert( a, "a.ts" );
+    index.insert( b, "b.ts" );
+    ASSERT_EQ( index.find( a ).value(), "a.ts" );     // a is now the most recent
+
+    index.insert( c, "c.ts" );
+    ASSERT_EQ( index.size(), 2 );
+    ASSERT_FALSE( index.find( b ).has_value() );
+    ASSERT_EQ( index.find( a ).value(), "a.ts" );
+    ASSERT_EQ( index.find( c ).value(), "c.ts" );
+}
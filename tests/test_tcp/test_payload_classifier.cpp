@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include <span>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+#include <payload_classifier.hpp>
+#include <http.hpp>
+#include <tls.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+#include <test_tls_handshake_packets.hpp>
+
+namespace {
+
+    std::vector<uint8_t> bytes_of( std::string_view text ) {
+        return std::vector<uint8_t>( text.begin(), text.end() );
+    }
+
+}
+
+TEST( PayloadClassifierTests, HTTPPrefixes ) {
+
+    ASSERT_EQ( ntk::classify_payload( bytes_of( "HTTP/1.1 200 OK\r\n" ) ), ntk::payload_protocol::HTTP_RESPONSE );
+    ASSERT_EQ( ntk::classify_payload( bytes_of( "GET / HTTP/1.1\r\n" ) ), ntk::payload_protocol::HTTP_REQUEST );
+    ASSERT_EQ( ntk::classify_payload( bytes_of( "POST /form HTTP/1.1\r\n" ) ), ntk::payload_protocol::HTTP_REQUEST );
+    ASSERT_EQ( ntk::classify_payload( bytes_of( "PATCH /a HTTP/1.1\r\n" ) ), ntk::payload_protocol::HTTP_REQUEST );
+    ASSERT_EQ( ntk::classify_payload( bytes_of( "OPTIONS * HTTP/1.1\r\n" ) ), ntk::payload_protocol::HTTP_REQUEST );
+
+    // a prefix needs all of its bytes, and the space after a method
+    ASSERT_EQ( ntk::classify_payload( bytes_of( "GE" ) ), ntk::payload_protocol::UNKNOWN );
+    ASSERT_EQ( ntk::classify_payload( bytes_of( "GETTER" ) ), ntk::payload_protocol::UNKNOWN );
+    ASSERT_EQ( ntk::classify_payload( bytes_of( "PUSH /" ) ), ntk::payload_protocol::UNKNOWN );
+    ASSERT_EQ( ntk::classify_payload( std::span<const uint8_t>() ), ntk::payload_protocol::EMPTY );
+}
+
+TEST( PayloadClassifierTests, TLSRecords ) {
+
+    std::vector<uint8_t> client_hello = { 22, 3, 1, 0, 4, 1, 0, 0, 0 };
+    std::vector<uint8_t> server_hello = { 22, 3, 3, 0, 4, 2, 0, 0, 0 };
+    std::vector<uint8_t> finished = { 22, 3, 3, 0, 4, 20, 0, 0, 0 };
+    std::vector<uint8_t> alert = { 21, 3, 3, 0, 2, 2, 40 };
+    std::vector<uint8_t> encrypted_alert = { 21, 3, 3, 0, 2, 0x7a, 0x11 };
+    std::vector<uint8_t> change_cipher_spec = { 20, 3, 3, 0, 1, 1 };
+    std::vector<uint8_t> application_data = { 23, 3, 3, 0, 1, 0xff };
+    std::vector<uint8_t> not_tls = { 22, 2, 0 };
+
+    ASSERT_EQ( ntk::classify_payload( client_hello ), ntk::payload_protocol::TLS_CLIENT_HELLO );
+    ASSERT_EQ( ntk::classify_payload( server_hello ), ntk::payload_protocol::TLS_SERVER_HELLO );
+    ASSERT_EQ( ntk::classify_payload( finished ), ntk::payload_protocol::TLS_HANDSHAKE );
+    ASSERT_EQ( ntk::classify_payload( alert ), ntk::payload_protocol::TLS_ALERT );
+    ASSERT_EQ( ntk::classify_payload( encrypted_alert ), ntk::payload_protocol::TLS_RECORD );
+    ASSERT_EQ( ntk::classify_payload( change_cipher_spec ), ntk::payload_protocol::TLS_CHANGE_CIPHER_SPEC );
+    ASSERT_EQ( ntk::classify_payload( application_data ), ntk::payload_protocol::TLS_APPLICATION_DATA );
+    ASSERT_EQ( ntk::classify_payload( not_tls ), ntk::payload_protocol::UNKNOWN );
+
+    // a single byte is too short to tell, and must not be read past
+    ASSERT_EQ( ntk::classify_payload( std::vector<uint8_t>{ 22 } ), ntk::payload_protocol::UNKNOWN );
+
+    ASSERT_TRUE( ntk::is_tls_payload( alert ) );
+    ASSERT_FALSE( ntk::is_tls_payload( std::vector<uint8_t>{ 22 } ) );
+}
+
+TEST( PayloadClassifierTests, Packets ) {
+
+    std::span<const uint8_t> get( test::http_get_packet, sizeof( test::http_get_packet ) );
+    std::span<const uint8_t> response( test::http_response_packet, sizeof( test::http_response_packet ) );
+    std::span<const uint8_t> client_hello( test_constants::tls_client_hello_packet, sizeof( test_constants::tls_client_hello_packet ) );
+
+    ASSERT_EQ( ntk::classify_packet( get ), ntk::payload_protocol::HTTP_REQUEST );
+    ASSERT_EQ( ntk::classify_packet( response ), ntk::payload_protocol::HTTP_RESPONSE );
+    ASSERT_EQ( ntk::classify_packet( client_hello ), ntk::payload_protocol::TLS_CLIENT_HELLO );
+
+    ASSERT_TRUE( ntk::is_client_hello( test_constants::tls_client_hello_packet ) );
+    ASSERT_FALSE( ntk::is_server_hello( test_constants::tls_client_hello_packet ) );
+    ASSERT_FALSE( ntk::is_tls_alert( test_constants::tls_client_hello_packet ) );
+    ASSERT_TRUE( ntk::is_tls( test_constants::tls_client_hello_packet ) );
+    ASSERT_FALSE( ntk::is_tls( test::http_get_packet ) );
+
+    // the handshake capture holds five records, none of them http
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tls_handshake" ] );
+    size_t tls_packets = 0, server_hellos = 0;
+    for ( const auto& packet : packet_data ) {
+        auto protocol = ntk::classify_packet( std::span<const uint8_t>( packet ) );
+        ASSERT_FALSE( ntk::is_http_protocol( protocol ) );
+        ASSERT_EQ( ntk::is_server_hello_v( packet ), protocol == ntk::payload_protocol::TLS_SERVER_HELLO );
+        tls_packets += ntk::is_tls_protocol( protocol );
+        server_hellos += protocol == ntk::payload_protocol::TLS_SERVER_HELLO;
+    }
+    ASSERT_EQ( tls_packets, 5 );
+    ASSERT_EQ( server_hellos, 1 );
+}
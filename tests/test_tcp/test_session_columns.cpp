@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <ranges>
+#include <vector>
+#include <cstdint>
+
+#include <ipv4.hpp>
+#include <session_columns.hpp>
+#include <tcp.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+TEST( PacketParsingTests, SessionColumnsMatchHeaders ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::session_columns columns( packet_data );
+
+    ASSERT_EQ( columns.size(), std::count_if( packet_data.begin(), packet_data.end(), ntk::is_tcp_v ) );
+    ASSERT_TRUE( columns.timestamps().empty() );
+
+    for ( size_t row = 0; row < columns.size(); ++row ) {
+        auto& packet = packet_data[ columns.index()[ row ] ];
+        auto header = ntk::get_tcp_header( packet.data() );
+
+        ASSERT_EQ( columns.four( row ), ntk::get_four_from_ethernet( packet.data() ) );
+        ASSERT_EQ( columns.sequence_number()[ row ], header.sequence_number );
+        ASSERT_EQ( columns.acknowledgment_number()[ row ], header.acknowledgment_number );
+        ASSERT_EQ( columns.flags()[ row ], header.flags );
+
+        auto payload = ntk::extract_payload_from_ethernet( packet );
+        auto offset = columns.payload_offset()[ row ];
+        ASSERT_EQ( std::vector<uint8_t>( packet.begin() + offset, packet.begin() + offset + columns.payload_len()[ row ] ), payload );
+    }
+
+    // the counts test_statistics.cpp makes by parsing every packet
+    auto fin_ack = static_cast<uint8_t>( ntk::tcp_flags::FIN_ACK );
+    ASSERT_EQ( ntk::count_flags( columns, fin_ack, fin_ack ), 2 );
+    ASSERT_EQ( std::ranges::count_if( columns.flags(), [&]( uint8_t flags ) { return ( flags & fin_ack ) == fin_ack; } ), 2 );
+
+    ASSERT_EQ( ntk::get_four_tuples( columns ), ntk::get_four_tuples( packet_data ) );
+}
+
+TEST( PacketParsingTests, SessionColumnsFilterLikeTheSession ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "earth_cam_live_stream" ] );
+
+    ntk::session_columns columns( packet_data );
+
+    auto src_dest = ntk::get_sender_reciever( packet_data.front().data() );
+
+    auto rows_to_packets = [&]( auto&& rows ) {
+        std::vector<std::vector<uint8_t>> packets;
+        for ( size_t row : rows ) packets.push_back( packet_data[ columns.index()[ row ] ] );
+        return packets;
+    };
+
+    auto scanned = ntk::filter_by_ip( packet_data, src_dest );
+    ASSERT_EQ( rows_to_packets( ntk::filter_by_ip( columns, src_dest ) ), std::vector<std::vector<uint8_t>>( scanned.begin(), scanned.end() ) );
+
+    auto duplex = ntk::filter_by_ip_duplex( packet_data, src_dest );
+    ASSERT_EQ( rows_to_packets( ntk::filter_by_ip_duplex( columns, src_dest ) ), std::vector<std::vector<uint8_t>>( duplex.begin(), duplex.end() ) );
+
+    ntk::ipv4_filter filter{ src_dest.first };
+    auto by_row = std::views::iota( size_t( 0 ), columns.size() ) | std::views::filter( [&]( size_t row ) { return filter( columns, row ); } );
+    ASSERT_EQ( std::ranges::distance( by_row ), std::count_if( packet_data.begin(), packet_data.end(), filter ) );
+}
+
+TEST( PacketParsingTests, SessionColumnsKeepTimestamps ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    auto start = ntk::capture_time( std::chrono::seconds( 1700000000 ) );
+    std::vector<ntk::captured_packet> captured;
+    for ( size_t i = 0; i < packet_data.size(); ++i ) {
+        captured.push_back( ntk::make_captured_packet( start + std::chrono::milliseconds( i ), packet_data[ i ] ) );
+    }
+
+    ntk::session_columns columns( captured );
+
+    ASSERT_EQ( columns.timestamps().size(), columns.size() );
+    for ( size_t row = 0; row < columns.size(); ++row ) {
+        ASSERT_EQ( columns.timestamps()[ row ], start + std::chrono::milliseconds( columns.index()[ row ] ) );
+    }
+}
@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <spmc_queue.hpp>
+#include <tcp.hpp>
+#include <tls.hpp>
+#include <utils.hpp>
+#include <test_constants.hpp>
+
+namespace {
+
+    ntk::captured_packet at( const ntk::session& packet_data, size_t i ) {
+        return ntk::make_captured_packet( ntk::to_capture_time( 1700000000, 0 ) + std::chrono::milliseconds( i ), packet_data[ i ] );
+    }
+
+    std::vector<std::vector<uint8_t>> frames( const ntk::tcp_live_stream& stream ) {
+        std::vector<std::vector<uint8_t>> all;
+        if ( auto spilled = stream.spilled_traffic() ) {
+            for ( auto& frame : spilled->frames() ) all.emplace_back( frame.begin(), frame.end() );
+        }
+        for ( auto& frame : ntk::tcp_live_stream_friend_helper::traffic( stream ) ) all.emplace_back( frame.begin(), frame.end() );
+        return all;
+    }
+
+    // the whole capture through one session, and through two with a checkpoint and restore after split packets
+    std::pair<ntk::tcp_live_stream,ntk::tcp_live_stream> run( const ntk::session& packet_data, size_t split, const ntk::session_limits& limits = {} ) {
+
+        auto path = ( std::filesystem::temp_directory_path() / "ntk_session.snapshot" ).string();
+
+        ntk::spmc_transfer_queue<ntk::tcp_live_stream> expected_queue;
+        ntk::tcp_live_stream_session uninterrupted( &expected_queue, limits );
+        for ( size_t i = 0; i < packet_data.size(); ++i ) uninterrupted.feed( at( packet_data, i ) );
+        uninterrupted.flush();
+
+        ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+        {
+            ntk::tcp_live_stream_session before( &offload_queue, limits );
+            for ( size_t i = 0; i < split; ++i ) before.feed( at( packet_data, i ) );
+            auto written = before.checkpoint( path );
+            EXPECT_TRUE( written.has_value() ) << written.error();
+        }
+
+        ntk::tcp_live_stream_session after( &offload_queue, limits );
+        auto restored = after.restore( path );
+        EXPECT_TRUE( restored.has_value() ) << restored.error();
+        EXPECT_EQ( after.statistics().packets_fed, split );
+
+        for ( size_t i = split; i < packet_data.size(); ++i ) after.feed( at( packet_data, i ) );
+        after.flush();
+
+        std::filesystem::remove( path );
+
+        auto expected = expected_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+        auto stream = offload_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+        EXPECT_TRUE( expected.has_value() && stream.has_value() );
+        EXPECT_EQ( after.statistics().packets_fed, uninterrupted.statistics().packets_fed );
+
+        return { std::move( *expected ), std::move( *stream ) };
+    }
+}
+
+TEST( TCPLiveStreamSession, RestoredSessionCarriesOnWithOpenStreams ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "long_stream" ] );
+
+    // well past the handshakes, the rest of the stream only makes sense with them
+    auto [ expected, stream ] = run( packet_data, packet_data.size() / 2 );
+
+    ASSERT_EQ( stream, expected );
+    ASSERT_TRUE( std::ranges::equal( stream.client_payload(), expected.client_payload() ) );
+    ASSERT_TRUE( std::ranges::equal( stream.server_payload(), expected.server_payload() ) );
+    ASSERT_EQ( frames( stream ), frames( expected ) );
+
+    ASSERT_EQ( stream.timing().first_packet, expected.timing().first_packet );
+    ASSERT_EQ( stream.handshake_rtt(), expected.handshake_rtt() );
+    ASSERT_EQ( stream.metrics().client().packets, expected.metrics().client().packets );
+    ASSERT_EQ( stream.metrics().server().bytes, expected.metrics().server().bytes );
+    ASSERT_EQ( stream.metrics().server().retransmissions, expected.metrics().server().retransmissions );
+
+    ntk::tls_live_stream tls_expected( std::move( expected ) );
+    ntk::tls_live_stream tls_stream( std::move( stream ) );
+
+    ASSERT_TRUE( tls_stream.get_server_hello().has_value() );
+    ASSERT_EQ( tls_stream.get_server_hello()->random, tls_expected.get_server_hello()->random );
+    ASSERT_EQ( tls_stream.get_sni(), tls_expected.get_sni() );
+    ASSERT_EQ( tls_stream.server_records().size(), tls_expected.server_records().size() );
+    ASSERT_EQ( tls_stream.server_records().back().payload, tls_expected.server_records().back().payload );
+}
+
+TEST( TCPLiveStreamSession, RestoredSessionSpillsAgain ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::session_limits limits{ .max_flow_bytes = 4096, .spill_directory = std::filesystem::temp_directory_path() };
+    auto [ expected, stream ] = run( packet_data, packet_data.size() - 2, limits );
+
+    ASSERT_NE( stream.spilled_traffic(), nullptr );
+    ASSERT_EQ( frames( stream ), frames( expected ) );
+    ASSERT_EQ( stream.memory().frame_bytes, expected.memory().frame_bytes );
+}
+
+TEST( TCPLiveStreamSession, RestoreRefusesBadSnapshots ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto path = ( std::filesystem::temp_directory_path() / "ntk_bad_session.snapshot" ).string();
+
+    ntk::tcp_live_stream_session fed;
+    for ( size_t i = 0; i < 4; ++i ) fed.feed( packet_data[ i ] );
+    ASSERT_EQ( fed.checkpoint( path ).value(), 1 );
+
+    // only into a session that has not started on its own traffic
+    ASSERT_FALSE( fed.restore( path ).has_value() );
+
+    std::vector<uint8_t> contents( std::filesystem::file_size( path ) );
+    {
+        std::ifstream file( path, std::ios::binary );
+        file.read( reinterpret_cast<char*>( contents.data() ), contents.size() );
+    }
+
+    // cut short in the middle of the stream
+    {
+        std::ofstream file( path, std::ios::binary | std::ios::trunc );
+        file.write( reinterpret_cast<const char*>( contents.data() ), contents.size() - 10 );
+    }
+
+    ntk::tcp_live_stream_session truncated;
+    auto restored = truncated.restore( path );
+    ASSERT_FALSE( restored.has_value() );
+    ASSERT_TRUE( ntk::tcp_live_stream_session_friend_helper::live_streams( truncated ).empty() );
+    ASSERT_EQ( ntk::tcp_live_stream_session_friend_helper::tombstones( truncated ), 0 );
+
+    // and usable as if nothing happened
+    for ( auto& packet : packet_data ) truncated.feed( packet );
+    ASSERT_EQ( truncated.statistics().packets_fed, packet_data.size() );
+
+    {
+        std::ofstream file( path, std::ios::binary | std::ios::trunc );
+        file << "not a snapshot";
+    }
+    ASSERT_FALSE( ntk::tcp_live_stream_session().restore( path ).has_value() );
+
+    std::filesystem::remove( path );
+    ASSERT_FALSE( ntk::tcp_live_stream_session().restore( path ).has_value() );
+}
+
+TEST( TCPLiveStreamSession, RestoredSessionKeepsDroppedFlowsOut ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto path = ( std::filesystem::temp_directory_path() / "ntk_dropped_session.snapshot" ).string();
+
+    ntk::session_limits limits{ .idle_timeout = std::chrono::seconds( 10 ) };
+    ntk::capture_time start = ntk::to_capture_time( 1700000000, 0 );
+
+    {
+        ntk::tcp_live_stream_session fed( nullptr, limits );
+        fed.set_classifier( []( const ntk::tcp_live_stream& ) { return ntk::flow_verdict::DROP; } );
+        for ( size_t i = 0; i < 4; ++i ) fed.feed( ntk::make_captured_packet( start + std::chrono::milliseconds( i ), packet_data[ i ] ) );
+        ASSERT_EQ( fed.checkpoint( path ).value(), 0 );
+    }
+
+    ntk::tcp_live_stream_session restored( nullptr, limits );
+    ASSERT_TRUE( restored.restore( path ).has_value() );
+    ASSERT_EQ( ntk::tcp_live_stream_session_friend_helper::tombstones( restored ), 1 );
+
+    restored.feed( ntk::make_captured_packet( start + std::chrono::seconds( 1 ), packet_data[ 4 ] ) );
+    ASSERT_EQ( restored.statistics().packets_unmatched, 1 );
+    ASSERT_TRUE( restored.memory_usage().empty() );
+
+    // with the deadline it was saved with
+    restored.advance_time( start + std::chrono::seconds( 12 ) );
+    ASSERT_EQ( ntk::tcp_live_stream_session_friend_helper::tombstones( restored ), 0 );
+
+    std::filesystem::remove( path );
+}
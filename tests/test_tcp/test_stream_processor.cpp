@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <ring_buffer.hpp>
+#include <shutdown.hpp>
+#include <tcp.hpp>
+#include <stream_processor.hpp>
+#include <utils.hpp>
+#include <spmc_queue.hpp>
+#include <test_constants.hpp>
+
+TEST( TCPLiveStreamSession, StreamProcessorDrainsQueuedStreams ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue );
+
+    for ( size_t i = 0; i < 8; ++i ) {
+        for ( auto& packet : packet_data ) live_stream_session.feed( packet );
+    }
+
+    size_t offloaded = live_stream_session.statistics().streams_offloaded;
+    ASSERT_GT( offloaded, 0 );
+
+    std::atomic<size_t> processed{ 0 };
+    ntk::stream_processor processor( offload_queue, [&]( ntk::tcp_live_stream&& stream ) {
+        if ( stream.is_complete() ) ++processed;
+    }, 4 );
+
+    ASSERT_EQ( processor.worker_count(), 4 );
+
+    processor.start();
+    processor.stop( ntk::stop_mode::DRAIN );
+
+    ASSERT_EQ( processed.load(), offloaded );
+    ASSERT_TRUE( offload_queue.empty() );
+}
+
+TEST( TCPLiveStreamSession, StreamProcessorStopWakesIdleWorkers ) {
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::stream_processor processor( offload_queue, []( ntk::tcp_live_stream&& ) {}, 4 );
+
+    processor.start();
+    // let every worker block in pop_for
+    std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+
+    auto start = std::chrono::steady_clock::now();
+    processor.stop();
+
+    ASSERT_LT( std::chrono::steady_clock::now() - start, std::chrono::milliseconds( 50 ) );
+}
+
+TEST( TCPLiveStreamSession, StreamProcessorRunsCallbacksInParallel ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    std::atomic<int> running{ 0 };
+    std::atomic<bool> overlapped{ false };
+
+    ntk::stream_processor processor( offload_queue, [&]( ntk::tcp_live_stream&& ) {
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            threads.insert( std::this_thread::get_id() );
+        }
+        // hold on until a second worker is inside the callback too
+        ++running;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds( 2 );
+        while ( running.load() < 2 && std::chrono::steady_clock::now() < deadline ) std::this_thread::yield();
+        if ( running.load() >= 2 ) overlapped = true;
+    }, 2 );
+
+    processor.start();
+
+    offload_queue.push( ntk::tcp_live_stream( four ) );
+    offload_queue.push( ntk::tcp_live_stream( four ) );
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds( 2 );
+    while ( !offload_queue.empty() && std::chrono::steady_clock::now() < deadline ) std::this_thread::yield();
+
+    processor.stop( ntk::stop_mode::DRAIN );
+
+    ASSERT_TRUE( overlapped.load() );
+    ASSERT_EQ( threads.size(), 2 );
+}
+
+TEST( TCPLiveStreamSession, StreamProcessorDrainStopsAtDeadline ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::stream_processor processor( offload_queue, []( ntk::tcp_live_stream&& ) {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+    } );
+
+    for ( size_t i = 0; i < 16; ++i ) offload_queue.push( ntk::tcp_live_stream( four ) );
+
+    processor.start();
+
+    ASSERT_FALSE( processor.stop( ntk::stop_mode::DRAIN, std::chrono::steady_clock::now() + std::chrono::milliseconds( 50 ) ) );
+    ASSERT_FALSE( offload_queue.empty() );
+}
+
+namespace {
+
+    struct stopped_listener {
+        void stop() { ++stops; }
+        int stops = 0;
+    };
+
+} // namespace
+
+TEST( TCPLiveStreamSession, DrainPipelineLosesNothingOnShutdown ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    // capture stopped half way, the rest of the flow never arrives
+    ntk::ring_buffer<std::vector<uint8_t>,1024> ring;
+    for ( size_t i = 0; i < packet_data.size() / 2; ++i ) ASSERT_TRUE( ring.push( packet_data[ i ] ) );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue );
+
+    std::atomic<size_t> flushed{ 0 };
+    ntk::stream_processor processor( offload_queue, [&]( ntk::tcp_live_stream&& stream ) {
+        if ( stream.eviction() == ntk::eviction_reason::SHUTDOWN ) ++flushed;
+    }, 2 );
+    processor.start();
+
+    stopped_listener listener;
+    ntk::stream_processor* processors[] = { &processor };
+
+    auto report = ntk::drain_pipeline( listener, ring, live_stream_session, processors,
+                                       std::chrono::steady_clock::now() + std::chrono::seconds( 5 ) );
+
+    ASSERT_EQ( listener.stops, 1 );
+    ASSERT_TRUE( report.completed );
+    ASSERT_EQ( report.frames_drained, packet_data.size() / 2 );
+    ASSERT_EQ( report.streams_flushed, 1 );
+    ASSERT_EQ( flushed.load(), 1 );
+    ASSERT_TRUE( offload_queue.empty() );
+}
@@ -28,3 +28,48 @@ TEST( PacketParsingTests, TCPHeaderExtraction ) {
 
     ASSERT_EQ( expected_header, actual_header );
 }
+
+TEST( PacketParsingTests, DecodedPacketMatchesHeaderParsing ) {
+
+    std::span<const uint8_t> frame( test::ethernet_frame_tcp, sizeof( test::ethernet_frame_tcp ) );
+
+    auto decoded = ntk::decode_packet( frame );
+
+    ASSERT_TRUE( decoded.has_value() );
+
+    ntk::tcp_header header = ntk::get_tcp_header( test::ethernet_frame_tcp );
+    ntk::ipv4_header ip_header = ntk::get_ipv4_header( test::ethernet_frame_tcp );
+
+    ASSERT_EQ( decoded->source_port, header.source_port );
+    ASSERT_EQ( decoded->destination_port, header.destination_port );
+    ASSERT_EQ( decoded->sequence_number, header.sequence_number );
+    ASSERT_EQ( decoded->acknowledgment_number, header.acknowledgment_number );
+    ASSERT_EQ( decoded->flags, header.flags );
+    ASSERT_EQ( decoded->tcp_header_len, header.data_offset * 4 );
+    ASSERT_EQ( decoded->options(), header.options );
+    ASSERT_EQ( decoded->four(), ntk::get_four_from_ethernet( test::ethernet_frame_tcp ) );
+    // the constant stops after the headers, so the payload is cut to what the frame holds
+    size_t headers_len = 14 + ip_header.ihl + header.data_offset * 4;
+    ASSERT_EQ( decoded->payload.size(), frame.size() - headers_len );
+
+    // cut inside the tcp header
+    ASSERT_FALSE( ntk::decode_packet( frame.first( 40 ) ).has_value() );
+}
+
+TEST( PacketParsingTests, TCPHeaderParsingWithoutThrowing ) {
+
+    std::vector<uint8_t> ipv4_header = ntk::extract_ipv4_header( test::ethernet_frame_tcp );
+    ntk::ipv4_header ip_header = ntk::parse_ipv4_header( ipv4_header );
+    auto raw = ntk::extract_tcp_header( test::ethernet_frame_tcp, ip_header.ihl );
+
+    auto header = ntk::try_parse_tcp_header( raw );
+    ASSERT_TRUE( header.has_value() );
+    ASSERT_EQ( *header, ntk::parse_tcp_header( raw ) );
+
+    ASSERT_FALSE( ntk::try_parse_tcp_header( std::span<const uint8_t>( raw ).first( 19 ) ).has_value() );
+    ASSERT_THROW( ntk::parse_tcp_header( std::vector<uint8_t>( raw.begin(), raw.begin() + 19 ) ), std::runtime_error );
+
+    // a data offset of less than the fixed header
+    raw[ 12 ] = 0x40;
+    ASSERT_FALSE( ntk::try_parse_tcp_header( raw ).has_value() );
+}
@@ -1,9 +1,11 @@
 #include <gtest/gtest.h>
 
+#include <filesystem>
 #include <span>
 #include <cstdint>
 
 #include <tcp.hpp>
+#include <tls.hpp>
 #include <utils.hpp>
 #include <spmc_queue.hpp>
 #include <test_constants.hpp>
@@ -265,8 +267,6 @@ TEST( PacketParsingTests, TCPLiveStreamSessionEquivalence ) {
         expected_streams.push_back( live_stream ); 
     }
 
-    auto& four_tuples = ntk::tcp_live_stream_session_friend_helper::four_tuples( live_stream_session );
-
     for ( auto& expected_stream : expected_streams ) {
         auto& four = ntk::tcp_live_stream_friend_helper::four( expected_stream );
         auto& actual_stream = ntk::tcp_live_stream_session_friend_helper::get_live_stream( live_stream_session, four );
@@ -290,4 +290,577 @@ TEST( TCPLiveStreamSession, OffloadQueue ) {
 
     ASSERT_TRUE( live_stream_session.number_of_completed_transfers() == 0 );
     ASSERT_FALSE( offload_queue.empty() );
-}
\ No newline at end of file
+}
+TEST( TCPLiveStreamSession, Statistics ) {
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue );
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "checkerboard" ] );
+
+    for ( auto& packet : packet_data ) {
+        live_stream_session.feed( packet );
+    }
+
+    auto stats = live_stream_session.statistics();
+
+    ASSERT_EQ( stats.packets_fed, packet_data.size() );
+    ASSERT_EQ( stats.streams_offloaded, 1 );
+    ASSERT_LT( stats.packets_unmatched, packet_data.size() );
+}
+
+TEST( TCPLiveStreamSession, CapturedPacketTimestamps ) {
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue );
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+    auto handshake = ntk::get_handshake( four, packet_data );
+
+    // one packet per millisecond, so each milestone's timestamp tells its index
+    ntk::capture_time start = ntk::to_capture_time( 1700000000, 0 );
+    auto timestamp_of = [&]( const std::vector<uint8_t>& packet ) {
+        auto it = std::find( packet_data.begin(), packet_data.end(), packet );
+        return start + std::chrono::milliseconds( it - packet_data.begin() );
+    };
+
+    for ( size_t i = 0; i < packet_data.size(); ++i ) {
+        live_stream_session.feed( ntk::make_captured_packet( start + std::chrono::milliseconds( i ), packet_data[ i ] ) );
+    }
+
+    auto stream = offload_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+
+    ASSERT_TRUE( stream.has_value() );
+
+    auto& timing = stream->timing();
+
+    ASSERT_EQ( timing.first_packet, start );
+    ASSERT_EQ( timing.last_packet, start + std::chrono::milliseconds( packet_data.size() - 1 ) );
+    ASSERT_EQ( timing.syn, timestamp_of( handshake.syn ) );
+    ASSERT_EQ( timing.syn_ack, timestamp_of( handshake.syn_ack ) );
+    ASSERT_EQ( timing.ack, timestamp_of( handshake.ack ) );
+    ASSERT_EQ( stream->handshake_rtt(), timestamp_of( handshake.ack ) - timestamp_of( handshake.syn ) );
+
+    ASSERT_TRUE( stream->time_to_first_byte().has_value() );
+    ASSERT_GT( stream->time_to_first_byte()->count(), 0 );
+    ASSERT_TRUE( stream->capture_to_offload_latency().has_value() );
+}
+
+TEST( TCPLiveStreamSession, IdleStreamsAreEvicted ) {
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue, ntk::session_limits{ .idle_timeout = std::chrono::seconds( 10 ) } );
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::capture_time start = ntk::to_capture_time( 1700000000, 0 );
+
+    // the first half never reaches the termination
+    for ( size_t i = 0; i < packet_data.size() / 2; ++i ) {
+        live_stream_session.feed( ntk::make_captured_packet( start + std::chrono::milliseconds( i ), packet_data[ i ] ) );
+    }
+
+    live_stream_session.advance_time( start + std::chrono::seconds( 5 ) );
+    ASSERT_FALSE( offload_queue.pop_for( std::chrono::milliseconds( 10 ) ).has_value() );
+
+    live_stream_session.advance_time( start + std::chrono::seconds( 11 ) );
+
+    auto stream = offload_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+
+    ASSERT_TRUE( stream.has_value() );
+    ASSERT_FALSE( stream->is_complete() );
+    ASSERT_EQ( stream->eviction(), ntk::eviction_reason::IDLE );
+    ASSERT_EQ( live_stream_session.statistics().streams_evicted, 1 );
+    ASSERT_EQ( live_stream_session.statistics().streams_offloaded, 1 );
+}
+
+TEST( TCPLiveStreamSession, LongLivedStreamsAreEvicted ) {
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue, ntk::session_limits{ .idle_timeout = std::chrono::seconds( 10 ), .max_lifetime = std::chrono::seconds( 30 ) } );
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::capture_time start = ntk::to_capture_time( 1700000000, 0 );
+
+    // a packet every five seconds keeps the stream from going idle
+    for ( size_t i = 0; i < packet_data.size() / 2; ++i ) {
+        live_stream_session.feed( ntk::make_captured_packet( start + std::chrono::seconds( 5 * i ), packet_data[ i ] ) );
+        if ( start + std::chrono::seconds( 5 * i ) >= start + std::chrono::seconds( 30 ) ) break;
+    }
+
+    live_stream_session.advance_time( start + std::chrono::seconds( 31 ) );
+
+    auto stream = offload_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+
+    ASSERT_TRUE( stream.has_value() );
+    ASSERT_EQ( stream->eviction(), ntk::eviction_reason::LIFETIME );
+    ASSERT_EQ( live_stream_session.statistics().streams_evicted, 1 );
+}
+
+TEST( TCPLiveStreamSession, MemoryUsageIsReportedPerFlow ) {
+
+    ntk::tcp_live_stream_session live_stream_session;
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "checkerboard" ] );
+    for ( auto& packet : packet_data ) live_stream_session.feed( packet );
+
+    auto usage = live_stream_session.memory_usage();
+
+    ASSERT_FALSE( usage.empty() );
+
+    size_t total = 0;
+    for ( auto& flow : usage ) total += flow.memory.in_memory();
+
+    ASSERT_GT( total, 0 );
+    ASSERT_EQ( live_stream_session.statistics().bytes_in_memory, total );
+    ASSERT_EQ( live_stream_session.statistics().bytes_spilled, 0 );
+}
+
+TEST( TCPLiveStreamSession, FlowOverBudgetSpillsToDisk ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> unlimited_queue;
+    ntk::tcp_live_stream_session unlimited_session( &unlimited_queue );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue, ntk::session_limits{ .max_flow_bytes = 4096, .spill_directory = std::filesystem::temp_directory_path() } );
+
+    for ( auto& packet : packet_data ) {
+        unlimited_session.feed( packet );
+        live_stream_session.feed( packet );
+    }
+
+    auto expected = unlimited_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+    auto stream = offload_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+
+    ASSERT_TRUE( expected.has_value() );
+    ASSERT_TRUE( stream.has_value() );
+    ASSERT_EQ( stream->eviction(), ntk::eviction_reason::NONE );
+
+    auto spilled = stream->spilled_traffic();
+
+    ASSERT_NE( spilled, nullptr );
+    ASSERT_TRUE( spilled->is_mapped() );
+    ASSERT_EQ( stream->memory().frame_bytes, 0 );
+
+    // everything the unlimited stream kept is on disk, in order
+    auto& expected_traffic = ntk::tcp_live_stream_friend_helper::traffic( *expected );
+
+    ASSERT_TRUE( ntk::tcp_live_stream_friend_helper::traffic( *stream ).empty() );
+    ASSERT_EQ( spilled->frames().size(), expected_traffic.size() );
+    for ( size_t i = 0; i < expected_traffic.size(); ++i ) {
+        ASSERT_TRUE( std::ranges::equal( spilled->frames()[ i ], expected_traffic[ i ] ) );
+    }
+
+    ASSERT_EQ( live_stream_session.statistics().bytes_spilled, spilled->size_bytes() );
+    ASSERT_EQ( live_stream_session.statistics().bytes_in_memory, 0 );
+}
+
+TEST( TCPLiveStreamSession, FlowOverBudgetIsTruncated ) {
+
+    const size_t budget = 4096;
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue, ntk::session_limits{ .max_flow_bytes = budget, .on_overflow = ntk::overflow_policy::TRUNCATE } );
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    for ( auto& packet : packet_data ) live_stream_session.feed( packet );
+
+    auto stream = offload_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+
+    ASSERT_TRUE( stream.has_value() );
+    ASSERT_TRUE( stream->is_complete() );
+    ASSERT_EQ( stream->spilled_traffic(), nullptr );
+    ASSERT_TRUE( stream->memory().truncated );
+
+    // held on to the packet that crossed the budget, nothing after it
+    size_t largest_frame = 0;
+    for ( auto& packet : packet_data ) largest_frame = std::max( largest_frame, packet.size() );
+    ASSERT_LE( stream->memory().in_memory(), budget + 2 * largest_frame );
+}
+
+TEST( TCPLiveStreamSession, SessionOverBudgetEvictsLargestStreams ) {
+
+    const size_t budget = 16384;
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue, ntk::session_limits{ .max_session_bytes = budget, .on_overflow = ntk::overflow_policy::TRUNCATE } );
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "checkerboard" ] );
+    for ( auto& packet : packet_data ) {
+        live_stream_session.feed( packet );
+        ASSERT_LE( live_stream_session.statistics().bytes_in_memory, budget );
+    }
+
+    auto statistics = live_stream_session.statistics();
+
+    ASSERT_GT( statistics.streams_evicted, 0 );
+
+    size_t evicted = 0;
+    while ( auto stream = offload_queue.pop_for( std::chrono::milliseconds( 10 ) ) ) {
+        if ( stream->eviction() == ntk::eviction_reason::MEMORY ) ++evicted;
+    }
+
+    ASSERT_EQ( evicted, statistics.streams_evicted );
+}
+
+namespace {
+
+    struct recorded_events : ntk::stream_events {
+
+        void on_open( const ntk::four_tuple& four ) override {
+            opened.push_back( four );
+        }
+
+        void on_data( const ntk::four_tuple& four, ntk::stream_direction direction, std::span<const uint8_t> data ) override {
+            auto& payload = direction == ntk::stream_direction::CLIENT_TO_SERVER ? client_payload : server_payload;
+            payload.insert( payload.end(), data.begin(), data.end() );
+        }
+
+        void on_close( const ntk::four_tuple& four, ntk::close_reason reason ) override {
+            closed.push_back( reason );
+        }
+
+        std::vector<ntk::four_tuple> opened;
+        std::vector<ntk::close_reason> closed;
+        std::vector<uint8_t> client_payload;
+        std::vector<uint8_t> server_payload;
+    };
+
+} // namespace
+
+TEST( TCPLiveStreamSession, EventsStreamPayloadInOrder ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session reference_session( &offload_queue );
+
+    recorded_events events;
+    ntk::tcp_live_stream_session live_stream_session( nullptr, &events );
+
+    for ( auto& packet : packet_data ) {
+        reference_session.feed( packet );
+        live_stream_session.feed( packet );
+    }
+
+    auto expected = offload_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+
+    ASSERT_TRUE( expected.has_value() );
+
+    ASSERT_EQ( events.opened, std::vector<ntk::four_tuple>( { expected->get_four_tuple() } ) );
+    ASSERT_EQ( events.closed, std::vector<ntk::close_reason>( { ntk::close_reason::TERMINATED } ) );
+
+    ASSERT_FALSE( events.client_payload.empty() );
+    ASSERT_TRUE( std::ranges::equal( events.client_payload, expected->client_payload() ) );
+    ASSERT_TRUE( std::ranges::equal( events.server_payload, expected->server_payload() ) );
+
+    // without a queue the closed stream is gone and nothing delivered was kept
+    ASSERT_TRUE( live_stream_session.memory_usage().empty() );
+    ASSERT_EQ( live_stream_session.statistics().bytes_in_memory, 0 );
+}
+
+TEST( TCPLiveStreamSession, EventsReportEviction ) {
+
+    recorded_events events;
+    ntk::tcp_live_stream_session live_stream_session( nullptr, &events, ntk::session_limits{ .idle_timeout = std::chrono::seconds( 10 ) } );
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::capture_time start = ntk::to_capture_time( 1700000000, 0 );
+
+    for ( size_t i = 0; i < packet_data.size() / 2; ++i ) {
+        live_stream_session.feed( ntk::make_captured_packet( start + std::chrono::milliseconds( i ), packet_data[ i ] ) );
+    }
+
+    ASSERT_EQ( live_stream_session.memory_usage().size(), 1 );
+    ASSERT_EQ( live_stream_session.memory_usage()[ 0 ].memory.frame_bytes, 0 );
+
+    live_stream_session.advance_time( start + std::chrono::seconds( 11 ) );
+
+    ASSERT_EQ( events.opened.size(), 1 );
+    ASSERT_EQ( events.closed, std::vector<ntk::close_reason>( { ntk::close_reason::IDLE } ) );
+    ASSERT_TRUE( live_stream_session.memory_usage().empty() );
+}
+
+TEST( TCPLiveStreamSession, FlushOffloadsOpenStreams ) {
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    recorded_events events;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue, &events );
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    for ( size_t i = 0; i < packet_data.size() / 2; ++i ) live_stream_session.feed( packet_data[ i ] );
+
+    ASSERT_TRUE( offload_queue.empty() );
+    ASSERT_EQ( live_stream_session.flush(), 1 );
+
+    auto stream = offload_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+
+    ASSERT_TRUE( stream.has_value() );
+    ASSERT_FALSE( stream->is_complete() );
+    ASSERT_FALSE( stream->client_payload().empty() );
+    ASSERT_EQ( stream->eviction(), ntk::eviction_reason::SHUTDOWN );
+    ASSERT_EQ( events.closed, std::vector<ntk::close_reason>( { ntk::close_reason::SHUTDOWN } ) );
+    ASSERT_TRUE( live_stream_session.memory_usage().empty() );
+
+    // nothing left to flush
+    ASSERT_EQ( live_stream_session.flush(), 0 );
+}
+
+TEST( TCPLiveStreamSession, ClassifierDropsFlowsBeforeTheyAreBuffered ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    recorded_events events;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue, &events );
+
+    size_t asked = 0;
+    live_stream_session.set_classifier( [&]( const ntk::tcp_live_stream& stream ) {
+        ++asked;
+        EXPECT_FALSE( stream.client_payload().empty() );
+        return ntk::flow_verdict::DROP;
+    });
+
+    for ( auto& packet : packet_data ) live_stream_session.feed( packet );
+
+    auto statistics = live_stream_session.statistics();
+
+    ASSERT_EQ( asked, 1 );
+    ASSERT_EQ( statistics.streams_dropped, 1 );
+    ASSERT_EQ( statistics.streams_offloaded, 0 );
+    ASSERT_EQ( statistics.bytes_in_memory, 0 );
+    ASSERT_TRUE( live_stream_session.memory_usage().empty() );
+    // the tombstone keeps the rest of the flow from opening a new stream
+    ASSERT_EQ( ntk::tcp_live_stream_session_friend_helper::tombstones( live_stream_session ), 1 );
+    ASSERT_TRUE( events.opened.empty() );
+    ASSERT_TRUE( events.closed.empty() );
+    ASSERT_TRUE( offload_queue.empty() );
+}
+
+TEST( TCPLiveStreamSession, EvictedFlowStartsOverOnItsNextPacket ) {
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue, ntk::session_limits{ .idle_timeout = std::chrono::seconds( 10 ) } );
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::capture_time start = ntk::to_capture_time( 1700000000, 0 );
+
+    for ( size_t i = 0; i < packet_data.size() / 2; ++i ) {
+        live_stream_session.feed( ntk::make_captured_packet( start + std::chrono::milliseconds( i ), packet_data[ i ] ) );
+    }
+
+    live_stream_session.advance_time( start + std::chrono::seconds( 11 ) );
+
+    auto evicted = offload_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+    ASSERT_TRUE( evicted.has_value() );
+    ASSERT_EQ( evicted->eviction(), ntk::eviction_reason::IDLE );
+
+    // the same 4-tuple used again later, a new connection
+    for ( size_t i = 0; i < packet_data.size(); ++i ) {
+        live_stream_session.feed( ntk::make_captured_packet( start + std::chrono::seconds( 20 ) + std::chrono::milliseconds( i ), packet_data[ i ] ) );
+    }
+
+    auto reused = offload_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+    ASSERT_TRUE( reused.has_value() );
+    ASSERT_TRUE( reused->is_complete() );
+    ASSERT_EQ( reused->eviction(), ntk::eviction_reason::NONE );
+    ASSERT_EQ( live_stream_session.statistics().packets_unmatched, 0 );
+    ASSERT_EQ( live_stream_session.statistics().streams_offloaded, 2 );
+}
+
+TEST( TCPLiveStreamSession, DroppedFlowTombstoneAgesOut ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue, ntk::session_limits{ .idle_timeout = std::chrono::seconds( 10 ) } );
+    live_stream_session.set_classifier( []( const ntk::tcp_live_stream& ) { return ntk::flow_verdict::DROP; } );
+
+    ntk::capture_time start = ntk::to_capture_time( 1700000000, 0 );
+
+    // dropped on its first client payload, the fourth packet
+    for ( size_t i = 0; i < 5; ++i ) {
+        live_stream_session.feed( ntk::make_captured_packet( start + std::chrono::milliseconds( i ), packet_data[ i ] ) );
+    }
+
+    ASSERT_EQ( live_stream_session.statistics().streams_dropped, 1 );
+    ASSERT_EQ( live_stream_session.statistics().packets_unmatched, 1 );
+    ASSERT_EQ( ntk::tcp_live_stream_session_friend_helper::tombstones( live_stream_session ), 1 );
+
+    // a packet of the flow pushes the deadline out like it would for a stream
+    live_stream_session.feed( ntk::make_captured_packet( start + std::chrono::seconds( 9 ), packet_data[ 5 ] ) );
+    live_stream_session.advance_time( start + std::chrono::seconds( 15 ) );
+    ASSERT_EQ( ntk::tcp_live_stream_session_friend_helper::tombstones( live_stream_session ), 1 );
+
+    live_stream_session.advance_time( start + std::chrono::seconds( 20 ) );
+    ASSERT_EQ( ntk::tcp_live_stream_session_friend_helper::tombstones( live_stream_session ), 0 );
+
+    // gone with it, so the 4-tuple is decided on again
+    for ( size_t i = 0; i < 4; ++i ) {
+        live_stream_session.feed( ntk::make_captured_packet( start + std::chrono::seconds( 30 ) + std::chrono::milliseconds( i ), packet_data[ i ] ) );
+    }
+
+    ASSERT_EQ( live_stream_session.statistics().streams_dropped, 2 );
+    ASSERT_EQ( ntk::tcp_live_stream_session_friend_helper::tombstones( live_stream_session ), 1 );
+}
+
+TEST( TCPLiveStreamSession, OldestTombstoneGivesWay ) {
+
+    auto tiny_cross = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto checkerboard = ntk::read_packets_from_file( test::packet_data_files[ "checkerboard" ] );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue, ntk::session_limits{ .max_dropped_flows = 1 } );
+    live_stream_session.set_classifier( []( const ntk::tcp_live_stream& ) { return ntk::flow_verdict::DROP; } );
+
+    for ( size_t i = 0; i < 4; ++i ) live_stream_session.feed( tiny_cross[ i ] );
+    for ( auto& packet : checkerboard ) live_stream_session.feed( packet );
+
+    ASSERT_EQ( live_stream_session.statistics().streams_dropped, 2 );
+    ASSERT_EQ( ntk::tcp_live_stream_session_friend_helper::tombstones( live_stream_session ), 1 );
+
+    // the first flow's tombstone made room for the second, its next packet opens a stream
+    size_t unmatched = live_stream_session.statistics().packets_unmatched;
+    live_stream_session.feed( tiny_cross[ 4 ] );
+    ASSERT_EQ( live_stream_session.statistics().packets_unmatched, unmatched );
+    ASSERT_EQ( live_stream_session.memory_usage().size(), 1 );
+}
+
+TEST( TCPLiveStreamSession, ClassifierKeepsOnlyHeaders ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    recorded_events events;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue, &events );
+
+    live_stream_session.set_classifier( []( const ntk::tcp_live_stream& ) { return ntk::flow_verdict::HEADERS_ONLY; } );
+
+    for ( auto& packet : packet_data ) live_stream_session.feed( packet );
+
+    auto stream = offload_queue.try_pop();
+
+    ASSERT_TRUE( stream.has_value() );
+    ASSERT_TRUE( stream->is_complete() );
+    ASSERT_TRUE( stream->client_payload().empty() );
+    ASSERT_TRUE( stream->server_payload().empty() );
+    ASSERT_EQ( stream->memory().in_memory(), 0 );
+
+    ASSERT_EQ( events.opened.size(), 1 );
+    ASSERT_EQ( events.closed, std::vector<ntk::close_reason>( { ntk::close_reason::TERMINATED } ) );
+    ASSERT_TRUE( events.client_payload.empty() );
+    ASSERT_TRUE( events.server_payload.empty() );
+}
+
+TEST( TCPLiveStreamSession, RetentionPolicyBoundsWhatIsStored ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    auto run = [&]( const ntk::session_limits& limits ) {
+        ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+        ntk::tcp_live_stream_session live_stream_session( &offload_queue, limits );
+        for ( auto& packet : packet_data ) live_stream_session.feed( packet );
+        return offload_queue.try_pop();
+    };
+
+    auto full = run( ntk::session_limits{} );
+    auto first = run( ntk::session_limits{ .retention = ntk::retention_policy::first_bytes( 100 ) } );
+    auto last = run( ntk::session_limits{ .retention = ntk::retention_policy::last_bytes( 100 ) } );
+
+    ASSERT_TRUE( full.has_value() && first.has_value() && last.has_value() );
+    ASSERT_GT( full->server_payload().size(), 100 );
+
+    // the flow still completes and is counted in full
+    ASSERT_TRUE( first->is_complete() );
+    ASSERT_TRUE( last->is_complete() );
+    ASSERT_EQ( first->metrics().server().bytes, full->metrics().server().bytes );
+
+    ASSERT_TRUE( std::ranges::equal( first->server_payload(), full->server_payload().first( 100 ) ) );
+    ASSERT_TRUE( std::ranges::equal( last->server_payload(), full->server_payload().last( 100 ) ) );
+    ASSERT_TRUE( std::ranges::equal( first->client_payload(), full->client_payload().first( 100 ) ) );
+
+    // frames stop at the one that crosses the bound in each direction
+    ASSERT_LT( first->memory().frame_bytes, full->memory().frame_bytes );
+    ASSERT_EQ( last->memory().frame_bytes, 0 );
+    ASSERT_LE( last->memory().reassembled_bytes, 2 * 2 * 100 );
+    ASSERT_LT( last->memory().reassembled_bytes, full->memory().reassembled_bytes );
+}
+
+TEST( TCPLiveStreamSession, ClassifierPicksTheRetention ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue, ntk::session_limits{ .classified_retention = ntk::retention_policy::first_bytes( 16 ) } );
+
+    live_stream_session.set_classifier( []( const ntk::tcp_live_stream& ) { return ntk::flow_verdict::RETAIN; } );
+
+    for ( auto& packet : packet_data ) live_stream_session.feed( packet );
+
+    auto stream = offload_queue.try_pop();
+
+    ASSERT_TRUE( stream.has_value() );
+    ASSERT_EQ( stream->retention().kind, ntk::retention_policy::mode::FIRST_BYTES );
+    ASSERT_EQ( stream->client_payload().size(), 16 );
+    ASSERT_EQ( stream->server_payload().size(), 16 );
+}
+
+TEST( TCPLiveStreamSession, ClassifierHoldsEventsUntilDecided ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session reference_session( &offload_queue );
+
+    recorded_events events;
+    ntk::tcp_live_stream_session live_stream_session( nullptr, &events );
+
+    // decided only once the server has answered, everything held by then is delivered at once
+    live_stream_session.set_classifier( []( const ntk::tcp_live_stream& stream ) {
+        return stream.server_payload().empty() ? ntk::flow_verdict::UNDECIDED : ntk::flow_verdict::KEEP;
+    });
+
+    for ( auto& packet : packet_data ) {
+        reference_session.feed( packet );
+        live_stream_session.feed( packet );
+    }
+
+    auto expected = offload_queue.try_pop();
+
+    ASSERT_TRUE( expected.has_value() );
+    ASSERT_EQ( events.opened.size(), 1 );
+    ASSERT_TRUE( std::ranges::equal( events.client_payload, expected->client_payload() ) );
+    ASSERT_TRUE( std::ranges::equal( events.server_payload, expected->server_payload() ) );
+    ASSERT_EQ( live_stream_session.statistics().bytes_in_memory, 0 );
+}
+
+TEST( TCPLiveStreamSession, SNIClassifierDecidesOnClientHello ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "short_stream" ] );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+
+    ntk::tcp_live_stream_session matching_session( &offload_queue );
+    matching_session.set_classifier( ntk::sni_classifier( "earthcam" ) );
+
+    ntk::tcp_live_stream_session other_session( &offload_queue );
+    other_session.set_classifier( ntk::sni_classifier( "example.org" ) );
+
+    for ( auto& packet : packet_data ) {
+        matching_session.feed( packet );
+        other_session.feed( packet );
+    }
+
+    ASSERT_EQ( matching_session.statistics().streams_dropped, 0 );
+    ASSERT_EQ( other_session.statistics().streams_dropped, 1 );
+    ASSERT_EQ( other_session.statistics().bytes_in_memory, 0 );
+    // kept, so it was either offloaded or is still held
+    ASSERT_TRUE( !offload_queue.empty() || matching_session.statistics().bytes_in_memory > 0 );
+}
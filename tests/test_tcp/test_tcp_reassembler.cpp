@@ -0,0 +1,227 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <spmc_queue.hpp>
+#include <tcp.hpp>
+#include <tcp_reassembler.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+namespace {
+
+    std::vector<uint8_t> bytes( std::span<const uint8_t> s ) {
+        return std::vector<uint8_t>( s.begin(), s.end() );
+    }
+
+    std::vector<std::vector<uint8_t>> frames( const ntk::tcp_live_stream& stream ) {
+        std::vector<std::vector<uint8_t>> all;
+        for ( auto& frame : ntk::tcp_live_stream_friend_helper::traffic( stream ) ) all.emplace_back( frame.begin(), frame.end() );
+        return all;
+    }
+
+} // namespace
+
+TEST( PacketParsingTests, TCPReassemblerOutOfOrderAndOverlap ) {
+
+    ntk::tcp_reassembler reassembler;
+    reassembler.start( 100 );
+
+    std::vector<uint8_t> a = { 'a', 'b', 'c' };
+    std::vector<uint8_t> b = { 'd', 'e', 'f' };
+    std::vector<uint8_t> c = { 'e', 'f', 'g', 'h' };
+
+    ASSERT_EQ( reassembler.add( 104, c ), 0 );
+    ASSERT_EQ( reassembler.add( 100, a ), 3 );
+    ASSERT_EQ( reassembler.pending_segments(), 1 );
+
+    // fills the gap and overlaps the held segment by two bytes
+    ASSERT_EQ( reassembler.add( 103, b ), 3 + 2 );
+
+    // a stale retransmission changes nothing
+    ASSERT_EQ( reassembler.add( 100, a ), 0 );
+
+    ASSERT_EQ( reassembler.pending_segments(), 0 );
+    ASSERT_EQ( reassembler.next_seq(), 108 );
+    ASSERT_EQ( bytes( reassembler.contiguous() ), std::vector<uint8_t>( { 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h' } ) );
+}
+
+TEST( PacketParsingTests, TCPReassemblerFillsGap ) {
+
+    ntk::tcp_reassembler reassembler;
+    reassembler.start( 0 );
+
+    std::vector<uint8_t> first = { 1, 2 };
+    std::vector<uint8_t> second = { 3, 4 };
+    std::vector<uint8_t> third = { 5, 6 };
+
+    reassembler.add( 4, third );
+    reassembler.add( 2, second );
+
+    ASSERT_TRUE( reassembler.contiguous().empty() );
+    ASSERT_EQ( reassembler.pending_segments(), 2 );
+    ASSERT_EQ( reassembler.pending_bytes(), 4 );
+
+    ASSERT_EQ( reassembler.add( 0, first ), 6 );
+    ASSERT_EQ( bytes( reassembler.contiguous() ), std::vector<uint8_t>( { 1, 2, 3, 4, 5, 6 } ) );
+}
+
+TEST( PacketParsingTests, TCPReassemblerSequenceWraparound ) {
+
+    ntk::tcp_reassembler reassembler;
+    reassembler.start( 0xfffffffe );
+
+    std::vector<uint8_t> before_wrap = { 1, 2 };
+    std::vector<uint8_t> after_wrap = { 3, 4 };
+    std::vector<uint8_t> straddling = { 2, 3, 4, 5 };
+
+    reassembler.add( 0, after_wrap );
+    reassembler.add( 0xfffffffe, before_wrap );
+    reassembler.add( 0xffffffff, straddling );
+
+    ASSERT_EQ( reassembler.next_seq(), 3 );
+    ASSERT_EQ( bytes( reassembler.contiguous() ), std::vector<uint8_t>( { 1, 2, 3, 4, 5 } ) );
+}
+
+TEST( PacketParsingTests, TCPLiveStreamReassemblyMatchesMergedStream ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+
+    ntk::tcp_live_stream live_stream( four );
+
+    for ( auto& packet : packet_data ) {
+        live_stream.feed( packet );
+    }
+
+    ASSERT_TRUE( live_stream.is_complete() );
+
+    // the existing path, one direction at a time
+    auto merged_payload = [&]( const ntk::four_tuple& sender ) {
+        ntk::session one_way;
+        for ( auto& packet : packet_data ) {
+            if ( ntk::get_four_from_ethernet( packet ) == sender ) one_way.push_back( packet );
+        }
+        std::vector<uint8_t> payload;
+        for ( auto& [ seq, data ] : ntk::get_merged_tcp_stream( one_way ) ) {
+            payload.insert( payload.end(), data.begin(), data.end() );
+        }
+        return payload;
+    };
+
+    ASSERT_FALSE( live_stream.server_payload().empty() );
+    ASSERT_EQ( bytes( live_stream.client_payload() ), merged_payload( four ) );
+    ASSERT_EQ( bytes( live_stream.server_payload() ), merged_payload( ntk::flip_four( four ) ) );
+}
+
+TEST( PacketParsingTests, TCPReassemblerKeepsFirstBytes ) {
+
+    ntk::tcp_reassembler reassembler;
+    reassembler.start( 100 );
+    reassembler.keep_first( 5 );
+
+    std::vector<uint8_t> a = { 'a', 'b', 'c' };
+    std::vector<uint8_t> b = { 'd', 'e', 'f' };
+
+    // past the limit before the gap closes, never held
+    ASSERT_EQ( reassembler.add( 106, a ), 0 );
+    ASSERT_EQ( reassembler.pending_segments(), 0 );
+
+    ASSERT_EQ( reassembler.add( 100, a ), 3 );
+    ASSERT_EQ( reassembler.add( 103, b ), 2 );
+    ASSERT_EQ( reassembler.add( 106, b ), 0 );
+    ASSERT_EQ( bytes( reassembler.contiguous() ), std::vector<uint8_t>( { 'a', 'b', 'c', 'd', 'e' } ) );
+}
+
+TEST( PacketParsingTests, TCPReassemblerKeepsLastBytes ) {
+
+    ntk::tcp_reassembler reassembler;
+    reassembler.start( 0 );
+    reassembler.keep_last( 4 );
+
+    std::vector<uint8_t> stream;
+    for ( uint8_t i = 0; i < 100; ++i ) {
+        std::vector<uint8_t> segment = { i, static_cast<uint8_t>( i + 1 ), static_cast<uint8_t>( i + 2 ) };
+        ASSERT_EQ( reassembler.add( static_cast<uint32_t>( stream.size() ), segment ), 3 );
+        stream.insert( stream.end(), segment.begin(), segment.end() );
+
+        ASSERT_LE( reassembler.contiguous().size(), 4 );
+    }
+
+    ASSERT_EQ( bytes( reassembler.contiguous() ), std::vector<uint8_t>( stream.end() - 4, stream.end() ) );
+}
+
+TEST( PacketParsingTests, TCPReassemblerCompressesSealedBlocks ) {
+
+    ntk::tcp_reassembler plain, compressed;
+    plain.start( 0 );
+    compressed.start( 0 );
+    compressed.compress( 1024 );
+
+    std::string line = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n\r\n";
+    std::vector<uint8_t> segment( line.begin(), line.end() );
+
+    uint32_t seq = 0;
+    for ( int i = 0; i < 500; ++i, seq += static_cast<uint32_t>( segment.size() ) ) {
+        ASSERT_EQ( compressed.add( seq, segment ), plain.add( seq, segment ) );
+        // what the segment brought in is there without inflating the rest
+        ASSERT_EQ( bytes( compressed.recent( segment.size() ) ), segment );
+    }
+
+    ASSERT_EQ( compressed.size(), plain.size() );
+    ASSERT_LT( compressed.stored_bytes(), plain.stored_bytes() / 4 );
+
+    ASSERT_EQ( bytes( compressed.contiguous() ), bytes( plain.contiguous() ) );
+    ASSERT_EQ( compressed.stored_bytes(), plain.stored_bytes() );
+
+    // sealed again as it grows on, and past a checkpoint
+    for ( int i = 0; i < 100; ++i, seq += static_cast<uint32_t>( segment.size() ) ) compressed.add( seq, segment );
+    ASSERT_LT( compressed.stored_bytes(), compressed.size() );
+
+    std::stringstream out;
+    ntk::snapshot_writer writer( out );
+    compressed.save( writer );
+    std::string saved = out.str();
+
+    ntk::tcp_reassembler restored;
+    ntk::snapshot_reader reader( std::span( reinterpret_cast<const uint8_t*>( saved.data() ), saved.size() ) );
+    ASSERT_TRUE( restored.restore( reader ) );
+    ASSERT_EQ( bytes( restored.contiguous() ), bytes( compressed.contiguous() ) );
+    ASSERT_EQ( restored.size(), 600 * segment.size() );
+}
+
+TEST( PacketParsingTests, TCPLiveStreamSessionCompressedPayload ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "lena" ] );
+
+    auto offload = [&]( bool compress, size_t& peak ) {
+        ntk::spmc_transfer_queue<ntk::tcp_live_stream> queue;
+        ntk::tcp_live_stream_session session( &queue, ntk::session_limits{ .compress_payload = compress } );
+        peak = 0;
+        for ( auto& packet : packet_data ) {
+            session.feed( packet );
+            peak = std::max<size_t>( peak, session.statistics().bytes_in_memory );
+        }
+        session.flush();
+        auto stream = queue.pop_for( std::chrono::milliseconds( 1000 ) );
+        EXPECT_TRUE( stream.has_value() );
+        return std::move( *stream );
+    };
+
+    size_t plain_peak = 0, compressed_peak = 0;
+    auto plain = offload( false, plain_peak );
+    auto compressed = offload( true, compressed_peak );
+
+    ASSERT_EQ( bytes( compressed.client_payload() ), bytes( plain.client_payload() ) );
+    ASSERT_EQ( bytes( compressed.server_payload() ), bytes( plain.server_payload() ) );
+    // the frames are sealed with the payload, so neither copy is held in full
+    ASSERT_LT( compressed_peak, plain_peak * 3 / 4 );
+    ASSERT_EQ( frames( compressed ), frames( plain ) );
+}
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <pcap_file.hpp>
+#include <tcp.hpp>
+#include <tcp_replay.hpp>
+#include <utils.hpp>
+#include <test_constants.hpp>
+
+TEST( TCPReplayTests, ReplayedStreamsMatchTheScanners ) {
+
+    for ( std::string name : { "tls_handshake", "tiny_cross", "checkerboard" } ) {
+
+        auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ name ] );
+        auto streams = ntk::replay_streams( packet_data );
+
+        ASSERT_EQ( streams.size(), ntk::get_four_tuples( packet_data ).size() ) << name;
+
+        for ( auto& stream : streams ) {
+            auto& four = stream.get_four_tuple();
+            ASSERT_EQ( stream.handshake(), ntk::get_handshake( four, packet_data ) ) << name;
+            ASSERT_EQ( stream.termination(), ntk::get_termination( four, packet_data ) ) << name;
+
+            auto single = ntk::replay_stream( ntk::flip_four( four ), packet_data );
+            ASSERT_TRUE( single.has_value() ) << name;
+            ASSERT_EQ( *single, stream ) << name;
+        }
+    }
+}
+
+TEST( TCPReplayTests, CaptureFileReplayCarriesTimestamps ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto path = ( std::filesystem::temp_directory_path() / "ntk_tcp_replay.pcap" ).string();
+
+    {
+        ntk::capture_file_writer writer( path, ntk::capture_format::PCAP );
+        for ( size_t i = 0; i < packet_data.size(); ++i ) {
+            auto size = static_cast<uint32_t>( packet_data[ i ].size() );
+            writer.write( 1700000000, static_cast<uint32_t>( i ), size, size, packet_data[ i ].data() );
+        }
+    }
+
+    auto from_file = ntk::replay_streams( path );
+    auto from_session = ntk::replay_streams( packet_data );
+    std::filesystem::remove( path );
+
+    ASSERT_TRUE( from_file.has_value() ) << from_file.error();
+    ASSERT_EQ( *from_file, from_session );
+    for ( size_t i = 0; i < from_session.size(); ++i ) {
+        ASSERT_TRUE( std::ranges::equal( ( *from_file )[ i ].client_payload(), from_session[ i ].client_payload() ) );
+        ASSERT_TRUE( std::ranges::equal( ( *from_file )[ i ].server_payload(), from_session[ i ].server_payload() ) );
+    }
+    ASSERT_EQ( from_file->front().timing().first_packet, ntk::to_capture_time( 1700000000, 0 ) );
+    ASSERT_FALSE( from_session.front().timing().first_packet.has_value() );
+
+    auto hex = ntk::replay_streams( test::packet_data_files[ "tiny_cross" ] );
+    ASSERT_TRUE( hex.has_value() );
+    ASSERT_EQ( *hex, from_session );
+
+    ASSERT_FALSE( ntk::replay_streams( path ).has_value() );
+}
+
+TEST( TCPReplayTests, TransferIsAViewOfTheReplayedStream ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+
+    ntk::tcp_transfer transfer( four );
+    ASSERT_FALSE( transfer.stream().has_value() );
+
+    transfer.load( packet_data );
+
+    ASSERT_TRUE( transfer.stream().has_value() );
+    ASSERT_TRUE( transfer.stream()->is_complete() );
+    ASSERT_EQ( ntk::tcp_transfer_friend_helper::handshake( transfer ), ntk::get_handshake( four, packet_data ) );
+    ASSERT_EQ( ntk::tcp_transfer_friend_helper::termination( transfer ), ntk::get_termination( four, packet_data ) );
+
+    size_t client_data = 0;
+    for ( auto& packet : packet_data ) {
+        if ( ntk::is_data_packet( packet ) && ntk::get_four_from_ethernet( packet ) == four ) ++client_data;
+    }
+    ASSERT_EQ( ntk::tcp_transfer_friend_helper::client_traffic( transfer ).size(), client_data );
+}
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+
+#include <tcp.hpp>
+#include <tcp_sharded_session.hpp>
+#include <utils.hpp>
+#include <spmc_queue.hpp>
+#include <test_constants.hpp>
+
+TEST( PacketParsingTests, SymmetricFlowHashIgnoresDirection ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    for ( auto& four : ntk::get_four_tuples( packet_data ) ) {
+        ASSERT_EQ( ntk::symmetric_flow_hash( four ), ntk::symmetric_flow_hash( ntk::flip_four( four ) ) );
+    }
+}
+
+TEST( PacketParsingTests, TCPShardedSessionCompletesTransfers ) {
+
+    std::vector<std::string> files = {
+        test::packet_data_files[ "checkerboard" ],
+        test::packet_data_files[ "tiny_cross" ],
+    };
+
+    std::vector<ntk::session> transfer_data;
+
+    for ( auto& file : files ) {
+        transfer_data.push_back( ntk::read_packets_from_file( file ) );
+    }
+
+    ntk::tcp_sharded_session sharded_session( 4 );
+
+    for ( size_t i = 0; i < transfer_data[ 0 ].size() || i < transfer_data[ 1 ].size(); ++i ) {
+        for ( auto& transfer : transfer_data ) {
+            if ( i < transfer.size() ) sharded_session.feed( transfer[ i ] );
+        }
+    }
+
+    sharded_session.stop();
+
+    ASSERT_EQ( sharded_session.number_of_completed_transfers(), transfer_data.size() );
+
+    // every flow lives in exactly the shard its hash selects
+    for ( auto& transfer : transfer_data ) {
+        auto four = *ntk::get_four_tuples( transfer ).begin();
+        size_t owner = sharded_session.shard_of( four );
+
+        for ( size_t i = 0; i < sharded_session.number_of_shards(); ++i ) {
+            auto& shard = ntk::tcp_sharded_session_friend_helper::shard_session( sharded_session, i );
+            // kept as completed, there is no queue to offload to
+            bool present = ntk::tcp_live_stream_session_friend_helper::live_streams( shard ).contains( ntk::flow_key( four ) );
+            ASSERT_EQ( present, i == owner );
+        }
+    }
+}
+
+TEST( PacketParsingTests, TCPShardedSessionOffloadQueue ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_sharded_session sharded_session( 3, &offload_queue );
+
+    for ( auto& packet : packet_data ) {
+        sharded_session.feed( packet );
+    }
+
+    sharded_session.stop();
+
+    auto stats = sharded_session.statistics();
+
+    ASSERT_EQ( stats.packets_fed, packet_data.size() );
+    ASSERT_EQ( stats.streams_offloaded, 1 );
+
+    auto stream = offload_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+
+    ASSERT_TRUE( stream.has_value() );
+    ASSERT_TRUE( stream->is_complete() );
+    ASSERT_TRUE( offload_queue.empty() );
+}
+
+TEST( PacketParsingTests, TCPShardedSessionForwardsLimits ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_sharded_session sharded_session( 3, &offload_queue, ntk::session_limits{ .metrics_only = true } );
+
+    for ( auto& packet : packet_data ) {
+        sharded_session.feed( packet );
+    }
+
+    sharded_session.stop();
+
+    auto stream = offload_queue.pop_for( std::chrono::milliseconds( 1000 ) );
+
+    ASSERT_TRUE( stream.has_value() );
+    ASSERT_TRUE( stream->is_complete() );
+    ASSERT_TRUE( ntk::tcp_live_stream_friend_helper::traffic( *stream ).empty() );
+    ASSERT_TRUE( stream->client_payload().empty() );
+}
+
+TEST( PacketParsingTests, TCPShardedSessionToeplitzSharding ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::tcp_sharded_session sharded_session( 4, nullptr, ntk::shard_hash::TOEPLITZ );
+
+    for ( auto& packet : packet_data ) {
+        sharded_session.feed( packet );
+    }
+
+    sharded_session.stop();
+
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+
+    ASSERT_EQ( sharded_session.shard_of( four ), sharded_session.shard_of( ntk::flip_four( four ) ) );
+    ASSERT_EQ( sharded_session.number_of_completed_transfers(), 1 );
+}
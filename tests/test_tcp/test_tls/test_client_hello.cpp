@@ -96,7 +96,7 @@ TEST( PacketParsingTests, TLSClientHelloEquivalence ) {
 
     ntk::print_tls_record( client_hello_record );
 
-    //ASSERT_TRUE( ntk::is_client_hello( client_hello_record ) );
+    ASSERT_TRUE( ntk::is_client_hello( client_hello_record ) );
 
     auto client_hello_from_record = ntk::get_client_hello( client_hello_record );
 
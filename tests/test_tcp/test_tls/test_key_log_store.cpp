@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <key_log_store.hpp>
+#include <tls.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+namespace {
+
+    ntk::client_random random_from_hex( const std::string& hex ) {
+        ntk::client_random random;
+        for ( size_t i = 0; i < random.size(); ++i ) random[ i ] = std::stoi( hex.substr( 2 * i, 2 ), nullptr, 16 );
+        return random;
+    }
+
+    const std::string line_random = "32c540c62c32fe6e16bab77bc1be24a6459c1d1c880d364a529de58995c6ddd7";
+
+} // namespace
+
+TEST( PacketParsingTests, KeyLogStoreMatchesParsedSecrets ) {
+
+    auto expected = ntk::get_tls_secrets( "tls_session_keys.log" );
+    ntk::key_log_store key_log( "tls_session_keys.log" );
+
+    ASSERT_EQ( key_log.size(), expected.size() );
+
+    for ( auto& [ random_hex, labels ] : expected ) {
+        for ( auto& [ label_name, secret ] : labels ) {
+            auto label = ntk::parse_secret_label( label_name );
+            ASSERT_TRUE( label.has_value() );
+            ASSERT_EQ( key_log.find( random_from_hex( random_hex ), *label ), secret );
+        }
+    }
+
+    ASSERT_FALSE( key_log.find( ntk::client_random{}, ntk::secret_label::SERVER_TRAFFIC_SECRET_0 ).has_value() );
+}
+
+TEST( PacketParsingTests, KeyLogStoreRejectsMalformedLines ) {
+
+    ntk::key_log_store key_log;
+
+    ASSERT_FALSE( key_log.add_line( "# SSL/TLS secrets log file" ) );
+    ASSERT_FALSE( key_log.add_line( "UNKNOWN_LABEL " + line_random + " 00ff" ) );
+    ASSERT_FALSE( key_log.add_line( "EXPORTER_SECRET 32c540 00ff" ) );
+    ASSERT_FALSE( key_log.add_line( "EXPORTER_SECRET " + line_random + " 0g" ) );
+    ASSERT_TRUE( key_log.add_line( "EXPORTER_SECRET " + line_random + " 00ff\r" ) );
+
+    ASSERT_EQ( key_log.find( random_from_hex( line_random ), ntk::secret_label::EXPORTER_SECRET ), std::vector<uint8_t>( { 0x00, 0xff } ) );
+}
+
+TEST( PacketParsingTests, KeyLogStoreReadsOnlyWhatWasAppended ) {
+
+    auto path = ( std::filesystem::temp_directory_path() / "ntk_key_log_store.log" ).string();
+    std::ofstream( path, std::ios::trunc ) << "EXPORTER_SECRET " << line_random << " 0102\n";
+
+    ntk::key_log_store key_log( path );
+    ASSERT_EQ( key_log.size(), 1 );
+
+    // a line still being written waits for its newline
+    std::ofstream( path, std::ios::app ) << "SERVER_TRAFFIC_SECRET_0 " << line_random << " 03";
+    ASSERT_EQ( key_log.poll(), 0 );
+    std::ofstream( path, std::ios::app ) << "04\n";
+    ASSERT_EQ( key_log.poll(), 1 );
+    ASSERT_EQ( key_log.poll(), 0 );
+
+    ASSERT_EQ( key_log.find( random_from_hex( line_random ), ntk::secret_label::SERVER_TRAFFIC_SECRET_0 ), std::vector<uint8_t>( { 0x03, 0x04 } ) );
+
+    // rotated, read again from the start
+    std::ofstream( path, std::ios::trunc ) << "CLIENT_RANDOM " << line_random << " 05\n";
+    ASSERT_EQ( key_log.poll(), 1 );
+
+    std::filesystem::remove( path );
+}
+
+TEST( PacketParsingTests, KeyLogStoreWaitsForTheNewlineWhileTheFileGrows ) {
+
+    auto path = ( std::filesystem::temp_directory_path() / "ntk_key_log_partial.log" ).string();
+    std::ofstream( path, std::ios::trunc ) << "CLIENT_RANDOM " << line_random << " 0102";
+
+    // a load of the file as it is takes the last line without its newline
+    ntk::key_log_store key_log( path );
+    ASSERT_EQ( key_log.find( random_from_hex( line_random ), ntk::secret_label::CLIENT_RANDOM ), std::vector<uint8_t>( { 0x01, 0x02 } ) );
+
+    // it was still being written, the whole line replaces it
+    std::ofstream( path, std::ios::app ) << "03\n";
+    ASSERT_EQ( key_log.poll(), 1 );
+    ASSERT_EQ( key_log.find( random_from_hex( line_random ), ntk::secret_label::CLIENT_RANDOM ), std::vector<uint8_t>( { 0x01, 0x02, 0x03 } ) );
+
+    // polls that find nothing more never take an even length prefix of the secret
+    std::ofstream( path, std::ios::app ) << "SERVER_TRAFFIC_SECRET_0 " << line_random << " 0405";
+    ASSERT_EQ( key_log.poll(), 0 );
+    ASSERT_EQ( key_log.poll(), 0 );
+    ASSERT_FALSE( key_log.find( random_from_hex( line_random ), ntk::secret_label::SERVER_TRAFFIC_SECRET_0 ).has_value() );
+
+    std::ofstream( path, std::ios::app ) << "06\n";
+    ASSERT_EQ( key_log.poll(), 1 );
+    ASSERT_EQ( key_log.find( random_from_hex( line_random ), ntk::secret_label::SERVER_TRAFFIC_SECRET_0 ), std::vector<uint8_t>( { 0x04, 0x05, 0x06 } ) );
+
+    std::filesystem::remove( path );
+}
+
+TEST( PacketParsingTests, KeyLogStoreFollowsTheFile ) {
+
+    auto path = ( std::filesystem::temp_directory_path() / "ntk_key_log_follow.log" ).string();
+    std::filesystem::remove( path );
+
+    ntk::key_log_store key_log( path );
+    ASSERT_TRUE( key_log.follow() );
+
+    // give the watch a moment to be in place
+    std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+    std::ofstream( path, std::ios::app ) << "CLIENT_TRAFFIC_SECRET_0 " << line_random << " aabb\n";
+
+    auto start = std::chrono::steady_clock::now();
+    auto secret = key_log.wait_for( random_from_hex( line_random ), ntk::secret_label::CLIENT_TRAFFIC_SECRET_0, std::chrono::seconds( 2 ) );
+
+    ASSERT_EQ( secret, std::vector<uint8_t>( { 0xaa, 0xbb } ) );
+    ASSERT_LT( std::chrono::steady_clock::now() - start, std::chrono::milliseconds( 500 ) );
+
+    key_log.stop_following();
+    std::filesystem::remove( path );
+}
+
+TEST( PacketParsingTests, TLSDecryptionWithKeyLogStore ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tls_handshake" ] );
+    auto merged_stream = ntk::get_merged_tcp_stream( packet_data );
+
+    auto& first_packet = merged_stream.begin()->second;
+    auto& second_packet = std::next( merged_stream.begin() )->second;
+
+    auto [ first_records, first_offset ] = *ntk::split_tls_records( first_packet );
+
+    std::vector<uint8_t> remainder( first_packet.begin() + first_offset, first_packet.end() );
+    remainder.insert( remainder.end(), second_packet.begin(), second_packet.end() );
+
+    auto [ second_records, second_offset ] = *ntk::split_tls_records( remainder );
+
+    auto tls_client_hello_bytes = ntk::extract_payload_from_ethernet( packet_data[ 3 ].data() );
+    auto client_hello = ntk::parse_client_hello( std::span<const uint8_t>( tls_client_hello_bytes ).subspan( 9 ) );
+    auto server_hello = ntk::parse_server_hello( std::span<const uint8_t>( first_records[ 0 ].payload ).subspan( 4 ) );
+
+    ntk::key_log_store key_log( "tls_session_keys.log" );
+
+    auto expected = ntk::decrypt_tls_data( client_hello.random, server_hello.random, server_hello.server_version,
+        server_hello.cipher_suite, second_records, ntk::get_tls_secrets( "tls_session_keys.log" ) );
+    auto actual = ntk::decrypt_tls_data( client_hello.random, server_hello.random, server_hello.server_version,
+        server_hello.cipher_suite, second_records, key_log );
+
+    ASSERT_EQ( actual.size(), 1 );
+    ASSERT_EQ( actual[ 0 ].payload, expected[ 0 ].payload );
+
+    ASSERT_THROW( ntk::get_traffic_secret( key_log, ntk::client_random{}, ntk::secret_label::SERVER_HANDSHAKE_TRAFFIC_SECRET ), std::out_of_range );
+}
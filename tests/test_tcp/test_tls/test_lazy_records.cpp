@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <generator.hpp>
+#include <key_log_store.hpp>
+#include <tcp.hpp>
+#include <tls.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+namespace {
+
+    ntk::generator<ntk::tls_record> skip( size_t count, ntk::generator<ntk::tls_record> records ) {
+        for ( auto&& record : records ) {
+            if ( count > 0 ) {
+                --count;
+                continue;
+            }
+            co_yield std::move( record );
+        }
+    }
+
+    void expect_same( const std::vector<ntk::tls_record>& lazy, const std::vector<ntk::tls_record>& eager ) {
+        ASSERT_EQ( lazy.size(), eager.size() );
+        for ( size_t i = 0; i < eager.size(); ++i ) {
+            ASSERT_EQ( lazy[ i ].content_type, eager[ i ].content_type ) << i;
+            ASSERT_EQ( lazy[ i ].version, eager[ i ].version ) << i;
+            ASSERT_EQ( lazy[ i ].payload, eager[ i ].payload ) << i;
+        }
+    }
+
+} // namespace
+
+TEST( TLSRecordGeneratorTests, LazyRecordsMatchExtraction ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "long_stream" ] );
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+
+    for ( auto& direction : { four, ntk::flip_four( four ) } ) {
+        std::vector<ntk::tls_record> lazy;
+        for ( auto&& record : ntk::generate_tls_records( ntk::generate_payloads( direction, packet_data ) ) ) lazy.push_back( std::move( record ) );
+        expect_same( lazy, ntk::extract_tls_records( ntk::extract_payloads( direction, packet_data ) ).records );
+    }
+
+    // the server hello without framing the rest of the server's records
+    auto server_records = ntk::generate_tls_records( ntk::generate_payloads( ntk::flip_four( four ), packet_data ) );
+    auto server_hello = ntk::get_server_hello( *server_records.begin() );
+    auto expected = ntk::get_server_hello( ntk::extract_tls_records( ntk::extract_payloads( ntk::flip_four( four ), packet_data ) ).records[ 0 ] );
+    ASSERT_EQ( server_hello.random, expected.random );
+}
+
+TEST( TLSRecordGeneratorTests, LazyDecryptionMatchesDecryptTLSData ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "long_stream" ] );
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+    auto server = ntk::flip_four( four );
+
+    auto client_records = ntk::extract_tls_records( ntk::extract_payloads( four, packet_data ) ).records;
+    auto server_records = ntk::extract_tls_records( ntk::extract_payloads( server, packet_data ) ).records;
+
+    auto client_hello = ntk::get_client_hello( client_records[ 0 ] );
+    auto server_hello = ntk::get_server_hello( server_records[ 0 ] );
+
+    ntk::key_log_store key_log( "sslkeys.log" );
+
+    std::vector<ntk::tls_record> application_records( server_records.begin() + 3, server_records.end() );
+    auto eager = ntk::decrypt_tls_data( client_hello.random, server_hello.random, server_hello.server_version, server_hello.cipher_suite,
+                                        application_records, key_log, ntk::secret_label::SERVER_TRAFFIC_SECRET_0 );
+
+    std::vector<ntk::tls_record> lazy;
+    auto plaintext = ntk::generate_decrypted_records( client_hello.random, server_hello.random, server_hello.server_version, server_hello.cipher_suite,
+                                                      skip( 3, ntk::generate_tls_records( ntk::generate_payloads( server, packet_data ) ) ),
+                                                      key_log, ntk::secret_label::SERVER_TRAFFIC_SECRET_0 );
+    for ( auto&& record : plaintext ) lazy.push_back( std::move( record ) );
+
+    expect_same( lazy, eager );
+}
@@ -2,7 +2,11 @@
 
 #include <pcap.h>
 
+#include <chrono>
+#include <filesystem>
 #include <span>
+#include <thread>
+#include <vector>
 #include <cstdint>
 
 #include <packet_listener.hpp>
@@ -51,15 +55,17 @@ TEST( LiveStreamTests, Google ) {
 
     ASSERT_EQ( live_streams.size(), 1 );
 
-    auto& handshake = ntk::tcp_live_stream_friend_helper::handshake_feed( live_streams.front() ).m_handshake;
-    auto& termination = ntk::tcp_live_stream_friend_helper::termination_feed( live_streams.front() ).m_termination;
+    auto& live_stream = *live_streams.begin();
+
+    auto& handshake = ntk::tcp_live_stream_friend_helper::handshake_feed( live_stream ).m_handshake;
+    auto& termination = ntk::tcp_live_stream_friend_helper::termination_feed( live_stream ).m_termination;
 
     ASSERT_TRUE( ntk::is_valid_handshake( handshake ) );
     ASSERT_TRUE( ntk::is_valid_fin_ack_fin_ack( termination ) );
 
-    ASSERT_TRUE( live_streams.front().traffic_contains( ntk::is_client_hello_v ) );
+    ASSERT_TRUE( live_stream.traffic_contains( ntk::is_client_hello_v ) );
 
-    ntk::tls_live_stream tls_stream( live_streams.front() );
+    ntk::tls_live_stream tls_stream( live_stream );
 }
 
 TEST( LiveStreamTests, OffloadQueueTestFilter ) {
@@ -278,5 +284,56 @@ TEST( LiveStreamTests, FireFoxEarthCamStrictSNIFilter ) {
     ASSERT_TRUE( stream.traffic_contains( ntk::is_client_hello_v ) );
 }
 
+TEST( LiveStreamTests, LoadGeneratorHandshakesDecrypt ) {
+
+    auto key_log = ( std::filesystem::temp_directory_path() / "ntk_load_generator_keys.log" ).string();
+    std::filesystem::remove( key_log );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue );
+
+    ntk::packet_listener listener( "wlo1", "tcp port 443" );
+    ASSERT_TRUE( listener.start( [&]( const struct pcap_pkthdr* header, const unsigned char* packet ) {
+        live_stream_session.feed( std::vector<uint8_t>( packet, packet + header->caplen ) );
+    }));
+
+    ntk::curl_load_generator generator( ntk::load_options{
+        .urls = { "https://www.google.com" }, .total_requests = 50, .max_concurrent = 25, .key_log_file = key_log } );
+    ASSERT_TRUE( generator.run() );
+    ASSERT_EQ( generator.statistics().completed, 50 );
+
+    // let the last terminations arrive
+    std::this_thread::sleep_for( std::chrono::seconds( 1 ) );
+    listener.stop();
+    live_stream_session.flush();
+
+    size_t decrypted = 0;
+    while ( auto stream = offload_queue.try_pop() ) {
 
+        if ( !stream->traffic_contains( ntk::is_client_hello_v ) ) continue;
 
+        auto client_records = ntk::split_tls_records( stream->client_payload() );
+        auto server_records = ntk::split_tls_records( stream->server_payload() );
+        ASSERT_TRUE( client_records.has_value() && server_records.has_value() );
+
+        auto& [ client, client_offset ] = *client_records;
+        auto& [ server, server_offset ] = *server_records;
+
+        auto client_hello = ntk::get_client_hello( client[ 0 ] );
+        auto server_hello = ntk::get_server_hello( server[ 0 ] );
+
+        auto secrets = ntk::get_tls_secrets( key_log, client_hello.random );
+        ASSERT_FALSE( secrets.empty() );
+
+        std::vector<ntk::tls_record> encrypted;
+        for ( auto& record : server ) {
+            if ( record.content_type == ntk::tls_content_type::APPLICATION_DATA ) encrypted.push_back( record );
+        }
+
+        auto records = ntk::decrypt_tls_data( client_hello.random, server_hello.random, server_hello.server_version,
+            server_hello.cipher_suite, encrypted, secrets );
+        if ( !records.empty() ) ++decrypted;
+    }
+
+    ASSERT_GE( decrypted, 50 );
+}
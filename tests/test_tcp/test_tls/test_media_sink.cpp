@@ -0,0 +1,236 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstdint>
+
+#include <key_log_store.hpp>
+#include <media_sink.hpp>
+#include <tcp.hpp>
+#include <tls_live_decryptor.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+namespace {
+
+    const ntk::four_tuple media_four{ 0x0a000001, 0x0a000002, 50000, 443 };
+
+    std::filesystem::path fresh_directory( const std::string& name ) {
+        auto directory = std::filesystem::temp_directory_path() / name;
+        std::filesystem::remove_all( directory );
+        std::filesystem::create_directories( directory );
+        return directory;
+    }
+
+    std::string read_file( const std::filesystem::path& file ) {
+        std::ifstream in( file, std::ios::binary );
+        return std::string( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() );
+    }
+
+    void send( ntk::media_sink& sink, ntk::stream_direction direction, std::string_view text, size_t record_size = SIZE_MAX ) {
+        while ( !text.empty() ) {
+            auto part = text.substr( 0, record_size );
+            sink.on_record( media_four, direction, ntk::tls_content_type::APPLICATION_DATA,
+                std::span<const uint8_t>( reinterpret_cast<const uint8_t*>( part.data() ), part.size() ) );
+            text.remove_prefix( part.size() );
+        }
+    }
+
+} // namespace
+
+TEST( MediaSinkTests, ClassifiesByContentTypeThenPath ) {
+    ASSERT_EQ( ntk::classify_media( "application/vnd.apple.mpegurl", "/live/index" ), ntk::media_kind::PLAYLIST );
+    ASSERT_EQ( ntk::classify_media( "video/MP2T", "/x" ), ntk::media_kind::MPEG_TS );
+    ASSERT_EQ( ntk::classify_media( "video/iso.segment", "/x" ), ntk::media_kind::FMP4 );
+    ASSERT_EQ( ntk::classify_media( "application/octet-stream", "/live/seg_12.ts?token=abc" ), ntk::media_kind::MPEG_TS );
+    ASSERT_EQ( ntk::classify_media( "", "/live/chunk.m4s" ), ntk::media_kind::FMP4 );
+    ASSERT_FALSE( ntk::classify_media( "text/html", "/index.html" ).has_value() );
+}
+
+TEST( MediaSinkTests, WritesSegmentsAcrossRecords ) {
+
+    auto directory = fresh_directory( "ntk_media_sink" );
+    std::vector<ntk::media_segment> segments;
+    // a buffer smaller than the bodies so some of each goes out before the end
+    ntk::media_sink sink( directory, [&]( const ntk::media_segment& segment ) { segments.push_back( segment ); }, 4096 );
+
+    std::string playlist = "#EXTM3U\n#EXT-X-TARGETDURATION:2\n#EXTINF:2.0,\nseg_1.ts\n";
+    std::string segment( 10000, '\0' );
+    for ( size_t i = 0; i < segment.size(); ++i ) segment[ i ] = static_cast<char>( i * 7 );
+
+    // the segment comes chunked, the page is not media
+    std::string chunked;
+    for ( size_t i = 0; i < segment.size(); i += 3000 ) {
+        auto part = segment.substr( i, 3000 );
+        char size[ 16 ];
+        std::snprintf( size, sizeof( size ), "%zx;ext=1\r\n", part.size() );
+        chunked += size + part + "\r\n";
+    }
+    chunked += "0\r\n\r\n";
+
+    send( sink, ntk::stream_direction::CLIENT_TO_SERVER,
+        "GET /live/index.m3u8 HTTP/1.1\r\nHost: cam\r\n\r\n"
+        "GET /live/seg_1.ts?t=9 HTTP/1.1\r\nHost: cam\r\n\r\n"
+        "GET /about.html HTTP/1.1\r\nHost: cam\r\n\r\n" );
+
+    std::string responses =
+        "HTTP/1.1 200 OK\r\nContent-Type: application/vnd.apple.mpegurl\r\nContent-Length: " + std::to_string( playlist.size() ) + "\r\n\r\n" + playlist +
+        "HTTP/1.1 200 OK\r\nContent-Type: video/MP2T\r\nTransfer-Encoding: chunked\r\n\r\n" + chunked +
+        "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: 5\r\n\r\nhello";
+    send( sink, ntk::stream_direction::SERVER_TO_CLIENT, responses, 777 );
+
+    ASSERT_EQ( segments.size(), 2 );
+
+    ASSERT_EQ( segments[ 0 ].kind, ntk::media_kind::PLAYLIST );
+    ASSERT_TRUE( segments[ 0 ].complete );
+    ASSERT_EQ( segments[ 0 ].file.filename(), "000000_index.m3u8" );
+    ASSERT_EQ( read_file( segments[ 0 ].file ), playlist );
+
+    ASSERT_EQ( segments[ 1 ].kind, ntk::media_kind::MPEG_TS );
+    ASSERT_EQ( segments[ 1 ].path, "/live/seg_1.ts?t=9" );
+    ASSERT_TRUE( segments[ 1 ].complete );
+    ASSERT_EQ( segments[ 1 ].bytes, segment.size() );
+    ASSERT_EQ( read_file( segments[ 1 ].file ), segment );
+
+    auto statistics = sink.statistics();
+    ASSERT_EQ( statistics.responses, 3 );
+    ASSERT_EQ( statistics.segments, 2 );
+    ASSERT_EQ( statistics.bytes_written, playlist.size() + segment.size() );
+    ASSERT_EQ( statistics.failures, 0 );
+
+    std::filesystem::remove_all( directory );
+}
+
+TEST( MediaSinkTests, CloseEndsOpenSegments ) {
+
+    auto directory = fresh_directory( "ntk_media_sink_close" );
+    std::vector<ntk::media_segment> segments;
+    ntk::media_sink sink( directory, [&]( const ntk::media_segment& segment ) { segments.push_back( segment ); } );
+
+    send( sink, ntk::stream_direction::CLIENT_TO_SERVER, "GET /a.m4s HTTP/1.1\r\n\r\n" );
+    send( sink, ntk::stream_direction::SERVER_TO_CLIENT, "HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\nonly part" );
+    ASSERT_TRUE( segments.empty() );
+
+    sink.on_close( media_four, ntk::close_reason::IDLE );
+
+    ASSERT_EQ( segments.size(), 1 );
+    ASSERT_FALSE( segments[ 0 ].complete );
+    ASSERT_EQ( segments[ 0 ].kind, ntk::media_kind::FMP4 );
+    ASSERT_EQ( read_file( segments[ 0 ].file ), "only part" );
+
+    // not http at all
+    send( sink, ntk::stream_direction::SERVER_TO_CLIENT, "\x16\x03\x03 binary\r\n\r\n" );
+    ASSERT_EQ( sink.statistics().failures, 1 );
+
+    std::filesystem::remove_all( directory );
+}
+
+TEST( MediaSinkTests, SkipsDuplicateBodies ) {
+
+    auto directory = fresh_directory( "ntk_media_sink_dedup" );
+    std::vector<ntk::media_segment> segments;
+    ntk::payload_dedup_index dedup( 16, true );
+    ntk::media_sink sink( directory, [&]( const ntk::media_segment& segment ) { segments.push_back( segment ); }, 4096, &dedup );
+
+    // the same playlist twice, then a segment larger than the write buffer twice
+    std::string playlist = "#EXTM3U\n#EXTINF:2.0,\nseg_1.ts\n";
+    std::string segment( 10000, 'x' );
+    send( sink, ntk::stream_direction::CLIENT_TO_SERVER,
+        "GET /a.m3u8 HTTP/1.1\r\n\r\nGET /b.m3u8 HTTP/1.1\r\n\r\nGET /1.ts HTTP/1.1\r\n\r\nGET /2.ts HTTP/1.1\r\n\r\n" );
+    std::string playlist_response = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string( playlist.size() ) + "\r\n\r\n" + playlist;
+    std::string segment_response = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string( segment.size() ) + "\r\n\r\n" + segment;
+    send( sink, ntk::stream_direction::SERVER_TO_CLIENT, playlist_response + playlist_response + segment_response + segment_response, 1000 );
+
+    ASSERT_EQ( segments.size(), 4 );
+    ASSERT_FALSE( segments[ 0 ].duplicate_of.has_value() );
+    ASSERT_EQ( segments[ 1 ].duplicate_of.value(), segments[ 0 ].file );
+    ASSERT_FALSE( segments[ 2 ].duplicate_of.has_value() );
+    ASSERT_EQ( segments[ 3 ].duplicate_of.value(), segments[ 2 ].file );
+
+    ASSERT_EQ( read_file( segments[ 0 ].file ), playlist );
+    ASSERT_EQ( read_file( segments[ 2 ].file ), segment );
+    ASSERT_FALSE( std::filesystem::exists( segments[ 1 ].file ) );
+    ASSERT_FALSE( std::filesystem::exists( segments[ 3 ].file ) );
+
+    auto statistics = sink.statistics();
+    ASSERT_EQ( statistics.duplicates, 2 );
+    ASSERT_EQ( statistics.bytes_written, playlist.size() + segment.size() );
+    ASSERT_EQ( statistics.bytes_deduplicated, playlist.size() + segment.size() );
+
+    std::filesystem::remove_all( directory );
+}
+
+TEST( MediaSinkTests, LargeDuplicatesAreNeverWritten ) {
+
+    auto directory = fresh_directory( "ntk_media_sink_prefix" );
+    std::vector<ntk::media_segment> segments;
+    ntk::payload_dedup_index dedup( 16 );
+    ntk::media_sink sink( directory, [&]( const ntk::media_segment& segment ) { segments.push_back( segment ); }, 4096, &dedup );
+
+    // three bodies of several buffers, the last one differs from the first only past its first buffer
+    std::string segment( 20000, '\0' );
+    for ( size_t i = 0; i < segment.size(); ++i ) segment[ i ] = static_cast<char>( i * 13 );
+    std::string changed = segment;
+    changed[ 15000 ] ^= 1;
+
+    auto response = [&]( const std::string& body ) {
+        return "HTTP/1.1 200 OK\r\nContent-Type: video/MP2T\r\nContent-Length: " + std::to_string( body.size() ) + "\r\n\r\n" + body;
+    };
+    send( sink, ntk::stream_direction::CLIENT_TO_SERVER,
+        "GET /1.ts HTTP/1.1\r\n\r\nGET /2.ts HTTP/1.1\r\n\r\nGET /3.ts HTTP/1.1\r\n\r\n" );
+    send( sink, ntk::stream_direction::SERVER_TO_CLIENT, response( segment ), 1000 );
+
+    // most of the copy is in, none of it went to disk
+    auto second = response( segment );
+    send( sink, ntk::stream_direction::SERVER_TO_CLIENT, std::string_view( second ).substr( 0, second.size() - 10 ), 1000 );
+    ASSERT_EQ( segments.size(), 1 );
+    ASSERT_FALSE( std::filesystem::exists( directory / "000001_2.ts" ) );
+    send( sink, ntk::stream_direction::SERVER_TO_CLIENT, std::string_view( second ).substr( second.size() - 10 ) );
+
+    send( sink, ntk::stream_direction::SERVER_TO_CLIENT, response( changed ), 1000 );
+
+    ASSERT_EQ( segments.size(), 3 );
+    ASSERT_EQ( segments[ 1 ].duplicate_of.value(), segments[ 0 ].file );
+    ASSERT_FALSE( std::filesystem::exists( segments[ 1 ].file ) );
+    ASSERT_FALSE( segments[ 2 ].duplicate_of.has_value() );
+    ASSERT_TRUE( segments[ 2 ].complete );
+    ASSERT_EQ( read_file( segments[ 2 ].file ), changed );
+
+    auto statistics = sink.statistics();
+    ASSERT_EQ( statistics.duplicates, 1 );
+    ASSERT_EQ( statistics.bytes_written, 2 * segment.size() );
+
+    std::filesystem::remove_all( directory );
+}
+
+TEST( MediaSinkTests, FollowsDecryptedCapture ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "long_stream" ] );
+    auto directory = fresh_directory( "ntk_media_sink_capture" );
+
+    std::vector<ntk::media_segment> segments;
+    ntk::media_sink sink( directory, [&]( const ntk::media_segment& segment ) { segments.push_back( segment ); } );
+
+    ntk::key_log_store key_log( "sslkeys.log" );
+    ntk::tls_live_decryptor decryptor( key_log, sink );
+    ntk::tcp_live_stream_session live_stream_session( nullptr, &decryptor );
+
+    for ( auto& packet : packet_data ) live_stream_session.feed( packet );
+    live_stream_session.flush();
+
+    auto statistics = sink.statistics();
+    ASSERT_EQ( statistics.failures, 0 );
+    ASSERT_GT( statistics.responses, 0 );
+    for ( const auto& segment : segments ) {
+        ASSERT_EQ( std::filesystem::file_size( segment.file ), segment.bytes );
+    }
+
+    std::filesystem::remove_all( directory );
+}
@@ -4,6 +4,7 @@
 #include <cstdint>
 
 #include <tls.hpp>
+#include <tls_decryptor.hpp>
 #include <utils.hpp>
 
 #include <test_tls_handshake_packets.hpp>
@@ -120,4 +121,184 @@ TEST( PacketParsingTests, TLSHandshakeParsing ) {
         0 );
  
     ntk::print_vector( decrypted_record.payload );
-}
\ No newline at end of file
+}
+
+TEST( PacketParsingTests, TLSDecryptorMatchesDecryptRecord ) {
+
+    auto session_keys = ntk::get_tls_secrets( "tls_session_keys.log" );
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tls_handshake" ] );
+    auto client_hello = ntk::get_client_hello_from_ethernet_frame( packet_data[ 3 ] );
+    auto server_hello = ntk::get_server_hello_from_ethernet_frame( packet_data[ 5 ] );
+
+    auto tls_application_data = ntk::extract_payload_from_ethernet( packet_data[ 11 ].data() );
+    auto [ encrypted_records, offset_reached ] = *ntk::split_tls_records(
+        std::span( tls_application_data.data(), tls_application_data.size() ) );
+
+    ASSERT_EQ( encrypted_records.size(), 2 );
+
+    auto secret = ntk::get_traffic_secret( session_keys, client_hello.random, "SERVER_TRAFFIC_SECRET_0" );
+    ntk::tls_decryptor decryptor( server_hello.cipher_suite, secret );
+
+    std::vector<uint8_t> plain_text;
+    for ( uint64_t i = 0; i < encrypted_records.size(); ++i ) {
+        auto expected = ntk::decrypt_record( client_hello.random, server_hello.random, server_hello.server_version,
+            server_hello.cipher_suite, encrypted_records[ i ], session_keys, "SERVER_TRAFFIC_SECRET_0", i );
+
+        auto len = decryptor.decrypt( encrypted_records[ i ], plain_text );
+        ASSERT_TRUE( len.has_value() ) << len.error();
+        ASSERT_EQ( *len, encrypted_records[ i ].payload.size() - 16 );
+        ASSERT_EQ( plain_text, expected.payload );
+    }
+    ASSERT_EQ( decryptor.sequence(), 2 );
+
+    // a tampered tag fails and leaves the sequence number for the next record
+    auto tampered = encrypted_records[ 0 ];
+    tampered.payload.back() ^= 0x01;
+    ASSERT_FALSE( decryptor.decrypt( tampered, plain_text ).has_value() );
+    ASSERT_EQ( decryptor.sequence(), 2 );
+
+    // into a caller buffer, rekeyed back to sequence 0
+    decryptor.rekey( server_hello.cipher_suite, secret );
+    std::vector<uint8_t> buffer( encrypted_records[ 0 ].payload.size() );
+    auto len = decryptor.decrypt( encrypted_records[ 0 ].content_type, encrypted_records[ 0 ].version,
+                                  encrypted_records[ 0 ].payload, buffer );
+    ASSERT_TRUE( len.has_value() );
+    auto expected = ntk::decrypt_record( client_hello.random, server_hello.random, server_hello.server_version,
+        server_hello.cipher_suite, encrypted_records[ 0 ], session_keys, "SERVER_TRAFFIC_SECRET_0", 0 );
+    ASSERT_TRUE( std::equal( expected.payload.begin(), expected.payload.end(), buffer.begin(), buffer.begin() + *len ) );
+
+    std::vector<uint8_t> too_small( encrypted_records[ 0 ].payload.size() - 17 );
+    ASSERT_FALSE( decryptor.decrypt( encrypted_records[ 0 ].content_type, encrypted_records[ 0 ].version,
+                                     encrypted_records[ 0 ].payload, too_small ).has_value() );
+}
+
+TEST( PacketParsingTests, TLSRecordFramerFollowsAGrowingStream ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "long_stream" ] );
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+    auto server_payloads = ntk::extract_payloads( ntk::flip_four( four ), packet_data );
+
+    auto expected = ntk::extract_tls_records( server_payloads );
+    ASSERT_GT( expected.records.size(), 3 );
+
+    // the stream grows, and reallocates, between calls the way a reassembled one does
+    std::vector<uint8_t> stream;
+    std::vector<ntk::tls_record> framed;
+    ntk::tls_record_framer framer;
+
+    for ( auto& payload : server_payloads ) {
+        stream.insert( stream.end(), payload.begin(), payload.end() );
+        while ( auto view = framer.next( stream ) ) {
+            ASSERT_GE( view->payload.data(), stream.data() );
+            ASSERT_LE( view->payload.data() + view->payload.size(), stream.data() + stream.size() );
+            framed.push_back( view->to_record() );
+        }
+    }
+
+    ASSERT_EQ( framed.size(), expected.records.size() );
+    size_t framed_bytes = 0;
+    for ( size_t i = 0; i < framed.size(); ++i ) {
+        ASSERT_EQ( framed[ i ].content_type, expected.records[ i ].content_type );
+        ASSERT_EQ( framed[ i ].version, expected.records[ i ].version );
+        ASSERT_EQ( framed[ i ].payload, expected.records[ i ].payload );
+        framed_bytes += 5 + framed[ i ].payload.size();
+    }
+    ASSERT_EQ( framer.offset(), framed_bytes );
+    ASSERT_EQ( framer.has_remainder( stream ), expected.has_remainder );
+
+    // a header on its own is not a record yet
+    std::vector<uint8_t> partial = { 0x17, 0x03, 0x03, 0x00, 0x02, 0xaa };
+    framer.reset();
+    ASSERT_FALSE( framer.next( partial ).has_value() );
+    ASSERT_TRUE( framer.has_remainder( partial ) );
+    partial.push_back( 0xbb );
+    auto view = framer.next( partial );
+    ASSERT_TRUE( view.has_value() );
+    ASSERT_EQ( view->content_type, ntk::tls_content_type::APPLICATION_DATA );
+    ASSERT_EQ( view->payload.size(), 2 );
+    ASSERT_FALSE( framer.has_remainder( partial ) );
+}
+
+TEST( PacketParsingTests, TLSHandshakeWalkerJoinsSplitHeaders ) {
+
+    // EncryptedExtensions, then a Finished whose header is split 2 + 2 across records
+    std::vector<uint8_t> first = { 0x08, 0x00, 0x00, 0x02, 0x00, 0x00, 0x14, 0x00 };
+    std::vector<uint8_t> second = { 0x00, 0x03, 0xaa, 0xbb };
+    std::vector<uint8_t> third = { 0xcc, 0x0f, 0x00 };
+
+    ntk::tls_handshake_walker walker;
+    std::vector<uint8_t> types;
+
+    for ( auto* record : { &first, &second, &third } ) {
+        walker.feed( *record );
+        while ( auto type = walker.next() ) types.push_back( *type );
+    }
+
+    // the Finished body ends in the third record, which starts the header of another message
+    ASSERT_EQ( types, ( std::vector<uint8_t>{ 0x08, 0x14 } ) );
+
+    walker.feed( std::vector<uint8_t>{ 0x00, 0x00, 0x00 } );
+    ASSERT_EQ( walker.next(), 0x0f );
+
+    walker.reset();
+    walker.feed( third );
+    ASSERT_FALSE( walker.next().has_value() );
+}
+
+TEST( PacketParsingTests, TLSParallelDecryptionMatchesSerial ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "long_stream" ] );
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+
+    auto client_tls_records = ntk::extract_tls_records( ntk::extract_payloads( four, packet_data ) ).records;
+    auto server_tls_records = ntk::extract_tls_records( ntk::extract_payloads( ntk::flip_four( four ), packet_data ) ).records;
+
+    auto client_hello = ntk::get_client_hello( client_tls_records[ 0 ] );
+    auto server_hello = ntk::get_server_hello( server_tls_records[ 0 ] );
+    auto secrets = ntk::get_tls_secrets( "sslkeys.log", client_hello.random );
+
+    // a plaintext record in the middle must not take a sequence number
+    std::vector<ntk::tls_record> records( server_tls_records.begin() + 3, server_tls_records.end() );
+    ASSERT_GT( records.size(), 8 );
+    records.insert( records.begin() + 5, ntk::tls_record{ ntk::tls_content_type::CHANGE_CIPHER_SEC, 0x0303, { 0x01 } } );
+
+    auto expected = ntk::decrypt_tls_data( client_hello.random, server_hello.random, server_hello.server_version,
+        server_hello.cipher_suite, records, secrets, "SERVER_TRAFFIC_SECRET_0" );
+
+    auto secret = ntk::get_traffic_secret( secrets, client_hello.random, "SERVER_TRAFFIC_SECRET_0" );
+    ntk::work_stealing_pool pool( 4 );
+
+    for ( size_t chunk : { 1, 3, 1000 } ) {
+        auto actual = ntk::decrypt_tls_records_parallel( server_hello.cipher_suite, secret, records, pool, chunk );
+        ASSERT_EQ( actual.size(), expected.size() );
+        for ( size_t i = 0; i < actual.size(); ++i ) {
+            ASSERT_EQ( actual[ i ].content_type, expected[ i ].content_type );
+            ASSERT_EQ( actual[ i ].payload, expected[ i ].payload );
+        }
+    }
+
+    records.back().payload.back() ^= 0x01;
+    ASSERT_THROW( ntk::decrypt_tls_records_parallel( server_hello.cipher_suite, secret, records, pool, 3 ), std::runtime_error );
+}
+
+TEST( PacketParsingTests, AESGCMWithoutThrowing ) {
+
+    // gcm spec test case 2, zero key, iv and plain text
+    std::vector<uint8_t> key( 16, 0 ), nonce( 12, 0 );
+    std::vector<uint8_t> cipher_text = {
+        0x03, 0x88, 0xda, 0xce, 0x60, 0xb6, 0xa3, 0x92, 0xf3, 0x28, 0xc2, 0xb9, 0x71, 0xb2, 0xfe, 0x78,
+        0xab, 0x6e, 0x47, 0xd4, 0x2c, 0xec, 0x13, 0xbd, 0xf5, 0x3a, 0x67, 0xb2, 0x12, 0x57, 0xbd, 0xdf
+    };
+
+    auto plain_text = ntk::try_decrypt_aes_gcm( key, nonce, {}, cipher_text, EVP_aes_128_gcm() );
+    ASSERT_TRUE( plain_text.has_value() ) << plain_text.error();
+    ASSERT_EQ( *plain_text, std::vector<uint8_t>( 16, 0 ) );
+
+    cipher_text.back() ^= 1;
+    ASSERT_FALSE( ntk::try_decrypt_aes_gcm( key, nonce, {}, cipher_text, EVP_aes_128_gcm() ).has_value() );
+    ASSERT_THROW( ntk::decrypt_aes_gcm( key, nonce, {}, cipher_text, EVP_aes_128_gcm() ), std::runtime_error );
+
+    // shorter than the tag
+    ASSERT_FALSE( ntk::try_decrypt_aes_gcm( key, nonce, {}, std::span( cipher_text ).first( 15 ), EVP_aes_128_gcm() ).has_value() );
+}
@@ -90,3 +90,37 @@ TEST( LiveStreamTests, ClientHelloSNI ) {
 
     ASSERT_TRUE( found );
 }
+
+TEST( PacketParsingTests, PeekSNIMatchesGetSNI ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "earth_cam_live_stream" ] );
+
+    size_t hellos = 0;
+    for ( auto& packet : packet_data | std::views::filter( ntk::is_client_hello_v ) ) {
+
+        auto expected = ntk::get_sni( ntk::get_client_hello_from_ethernet_frame( packet ) );
+        auto actual = ntk::peek_sni_from_ethernet_frame( packet );
+
+        ASSERT_EQ( actual.has_value(), expected.has_value() );
+        if ( expected ) ASSERT_EQ( *actual, *expected );
+        ++hellos;
+    }
+
+    ASSERT_GT( hellos, 0 );
+}
+
+TEST( PacketParsingTests, PeekSNIStaysInBounds ) {
+
+    auto payload = ntk::extract_payload_from_ethernet( test_constants::tls_client_hello_packet );
+
+    ASSERT_EQ( ntk::peek_sni( payload ), "earthcam.com" );
+
+    // every prefix is read without running off its end, the name only comes back whole
+    for ( size_t len = 0; len < payload.size(); ++len ) {
+        std::vector<uint8_t> prefix( payload.begin(), payload.begin() + len );
+        auto sni = ntk::peek_sni( prefix );
+        if ( sni ) ASSERT_EQ( *sni, "earthcam.com" );
+    }
+
+    ASSERT_FALSE( ntk::peek_sni( std::span<const uint8_t>() ).has_value() );
+}
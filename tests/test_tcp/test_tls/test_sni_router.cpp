@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <sni_router.hpp>
+#include <spmc_queue.hpp>
+#include <tcp.hpp>
+#include <tls.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+TEST( SNIRouterTests, RuleTableMatchesExactWildcardAndSuffix ) {
+
+    ntk::sni_rule_table rules;
+
+    ASSERT_TRUE( rules.add( "videos-3.earthcam.com", 0 ) );
+    ASSERT_TRUE( rules.add( "*.earthcam.com", 1 ) );
+    ASSERT_TRUE( rules.add( ".example.com", 2 ) );
+    ASSERT_TRUE( rules.add( ".a.example.com", 3 ) );
+    ASSERT_EQ( rules.size(), 4 );
+
+    ASSERT_EQ( rules.match( "videos-3.earthcam.com" ), 0 );
+    ASSERT_EQ( rules.match( "VIDEOS-3.EarthCam.com." ), 0 );
+    ASSERT_EQ( rules.match( "static.earthcam.com" ), 1 );
+    // a wildcard is one label, and not the name itself
+    ASSERT_FALSE( rules.match( "a.static.earthcam.com" ).has_value() );
+    ASSERT_FALSE( rules.match( "earthcam.com" ).has_value() );
+
+    ASSERT_EQ( rules.match( "example.com" ), 2 );
+    ASSERT_EQ( rules.match( "www.example.com" ), 2 );
+    ASSERT_EQ( rules.match( "x.y.a.example.com" ), 3 );
+
+    ASSERT_FALSE( rules.match( "example.org" ).has_value() );
+    ASSERT_FALSE( rules.match( "notexample.com" ).has_value() );
+    ASSERT_FALSE( rules.match( "" ).has_value() );
+}
+
+TEST( SNIRouterTests, RuleTableRejectsMalformedPatterns ) {
+
+    ntk::sni_rule_table rules;
+
+    ASSERT_FALSE( rules.add( "", 0 ) );
+    ASSERT_FALSE( rules.add( "*", 0 ) );
+    ASSERT_FALSE( rules.add( "a..com", 0 ) );
+    ASSERT_FALSE( rules.add( "www.*.com", 0 ) );
+    ASSERT_FALSE( rules.add( std::string( 64, 'a' ) + ".com", 0 ) );
+    ASSERT_EQ( rules.size(), 0 );
+
+    // the same pattern again replaces the target
+    ASSERT_TRUE( rules.add( "example.com", 0 ) );
+    ASSERT_TRUE( rules.add( "example.com", 1 ) );
+    ASSERT_EQ( rules.size(), 1 );
+    ASSERT_EQ( rules.match( "example.com" ), 1 );
+}
+
+TEST( SNIRouterTests, RuleTableScalesToThousandsOfRules ) {
+
+    ntk::sni_rule_table rules;
+
+    for ( size_t i = 0; i < 5000; ++i ) {
+        ASSERT_TRUE( rules.add( "customer-" + std::to_string( i ) + ".example.com", i ) );
+        ASSERT_TRUE( rules.add( "*.cdn-" + std::to_string( i ) + ".net", 5000 + i ) );
+    }
+
+    ASSERT_EQ( rules.match( "customer-4321.example.com" ), 4321 );
+    ASSERT_EQ( rules.match( "edge.cdn-17.net" ), 5017 );
+    ASSERT_FALSE( rules.match( "customer-5000.example.com" ).has_value() );
+}
+
+TEST( SNIRouterTests, StreamsGoToTheQueueOfTheirRule ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "earth_cam_live_stream" ] );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> videos;
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> earthcam;
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> unmatched;
+
+    ntk::sni_router router( &unmatched );
+    ASSERT_TRUE( router.add_route( "videos-3.earthcam.com", videos ) );
+    ASSERT_TRUE( router.add_route( ".earthcam.com", earthcam ) );
+
+    ntk::tcp_live_stream_session live_stream_session( &router );
+    for ( auto& packet : packet_data ) live_stream_session.feed( packet );
+    live_stream_session.flush();
+
+    ASSERT_FALSE( videos.empty() );
+
+    while ( auto stream = videos.try_pop() ) {
+        ASSERT_EQ( ntk::get_stream_sni( *stream ), "videos-3.earthcam.com" );
+    }
+    while ( auto stream = earthcam.try_pop() ) {
+        auto sni = ntk::get_stream_sni( *stream );
+        ASSERT_TRUE( sni.has_value() );
+        ASSERT_TRUE( sni->ends_with( "earthcam.com" ) );
+        ASSERT_NE( *sni, "videos-3.earthcam.com" );
+    }
+
+    auto statistics = router.statistics();
+    ASSERT_EQ( statistics.streams_unmatched, unmatched.size() );
+    ASSERT_GT( statistics.streams_routed, 0 );
+    ASSERT_FALSE( router.try_pop().has_value() );
+}
@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+#include <key_log_store.hpp>
+#include <tcp.hpp>
+#include <tls.hpp>
+#include <tls_live_decryptor.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+namespace {
+
+    struct recorded_tls_events : ntk::tls_events {
+
+        void on_handshake( const ntk::four_tuple& four, const ntk::client_hello& client, const ntk::server_hello& server ) override {
+            ++handshakes;
+        }
+
+        void on_record( const ntk::four_tuple& four, ntk::stream_direction direction, ntk::tls_content_type type,
+                        std::span<const uint8_t> plaintext ) override {
+            if ( type != ntk::tls_content_type::APPLICATION_DATA ) return;
+            auto& records = direction == ntk::stream_direction::CLIENT_TO_SERVER ? client_records : server_records;
+            records.emplace_back( plaintext.begin(), plaintext.end() );
+        }
+
+        void on_failure( const ntk::four_tuple& four, const std::string& reason ) override {
+            failures.push_back( reason );
+        }
+
+        void on_close( const ntk::four_tuple& four, ntk::close_reason reason ) override {
+            closed.push_back( reason );
+        }
+
+        size_t handshakes = 0;
+        std::vector<std::vector<uint8_t>> client_records;
+        std::vector<std::vector<uint8_t>> server_records;
+        std::vector<std::string> failures;
+        std::vector<ntk::close_reason> closed;
+    };
+
+    // what decrypt_tls_data gives after the capture, with the inner content type taken off
+    std::vector<std::vector<uint8_t>> decrypted_after_offload( const ntk::session& packet_data, bool server ) {
+
+        auto four = *ntk::get_four_tuples( packet_data ).begin();
+        auto client_tls_records = ntk::extract_tls_records( ntk::extract_payloads( four, packet_data ) ).records;
+        auto server_tls_records = ntk::extract_tls_records( ntk::extract_payloads( ntk::flip_four( four ), packet_data ) ).records;
+
+        auto client_hello = ntk::get_client_hello( client_tls_records[ 0 ] );
+        auto server_hello = ntk::get_server_hello( server_tls_records[ 0 ] );
+
+        auto& records = server ? server_tls_records : client_tls_records;
+        std::vector<ntk::tls_record> records_to_decrypt( records.begin() + 3, records.end() );
+
+        auto decrypted = ntk::decrypt_tls_data( client_hello.random, server_hello.random, server_hello.server_version,
+            server_hello.cipher_suite, records_to_decrypt, ntk::get_tls_secrets( "sslkeys.log", client_hello.random ),
+            server ? "SERVER_TRAFFIC_SECRET_0" : "CLIENT_TRAFFIC_SECRET_0" );
+
+        std::vector<std::vector<uint8_t>> payloads;
+        for ( auto& record : decrypted ) {
+            record.payload.pop_back();
+            payloads.push_back( record.payload );
+        }
+        return payloads;
+    }
+
+} // namespace
+
+TEST( TCPLiveStreamSession, TLSLiveDecryptionMatchesOffload ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "long_stream" ] );
+
+    ntk::key_log_store key_log( "sslkeys.log" );
+    recorded_tls_events events;
+    ntk::tls_live_decryptor decryptor( key_log, events );
+    ntk::tcp_live_stream_session live_stream_session( nullptr, &decryptor );
+
+    for ( auto& packet : packet_data ) live_stream_session.feed( packet );
+    live_stream_session.flush();
+
+    ASSERT_TRUE( events.failures.empty() ) << events.failures.front();
+    ASSERT_EQ( events.handshakes, 1 );
+    ASSERT_EQ( events.closed.size(), 1 );
+
+    ASSERT_FALSE( events.server_records.empty() );
+    ASSERT_EQ( events.server_records, decrypted_after_offload( packet_data, true ) );
+    ASSERT_EQ( events.client_records, decrypted_after_offload( packet_data, false ) );
+
+    auto statistics = decryptor.statistics();
+    ASSERT_EQ( statistics.connections, 0 );
+    ASSERT_GT( statistics.records_decrypted, events.server_records.size() + events.client_records.size() );
+}
+
+TEST( TCPLiveStreamSession, TLSLiveDecryptionWaitsForSecrets ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "long_stream" ] );
+
+    // nothing logged while the connection runs
+    ntk::key_log_store key_log;
+    recorded_tls_events events;
+    ntk::tls_live_decryptor decryptor( key_log, events );
+    ntk::tcp_live_stream_session live_stream_session( nullptr, &decryptor );
+
+    for ( size_t i = 0; i < packet_data.size() / 2; ++i ) live_stream_session.feed( packet_data[ i ] );
+
+    ASSERT_EQ( events.handshakes, 1 );
+    ASSERT_TRUE( events.server_records.empty() );
+    ASSERT_EQ( decryptor.statistics().records_decrypted, 0 );
+
+    std::ifstream file( "sslkeys.log" );
+    for ( std::string line; std::getline( file, line ); ) key_log.add_line( line );
+
+    decryptor.retry();
+    ASSERT_FALSE( events.server_records.empty() );
+
+    for ( size_t i = packet_data.size() / 2; i < packet_data.size(); ++i ) live_stream_session.feed( packet_data[ i ] );
+    live_stream_session.flush();
+
+    ASSERT_TRUE( events.failures.empty() ) << events.failures.front();
+    ASSERT_EQ( events.server_records, decrypted_after_offload( packet_data, true ) );
+}
+
+TEST( TCPLiveStreamSession, TLSLiveDecryptionGivesUpOnPlainTCP ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::key_log_store key_log;
+    recorded_tls_events events;
+    ntk::tls_live_decryptor decryptor( key_log, events );
+    ntk::tcp_live_stream_session live_stream_session( nullptr, &decryptor );
+
+    for ( auto& packet : packet_data ) live_stream_session.feed( packet );
+
+    ASSERT_EQ( events.failures.size(), 1 );
+    ASSERT_EQ( events.closed, std::vector<ntk::close_reason>( { ntk::close_reason::TERMINATED } ) );
+    ASSERT_EQ( decryptor.statistics().failures, 1 );
+}
@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+
+#include <span>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+#include <key_log_store.hpp>
+#include <tcp.hpp>
+#include <tls.hpp>
+#include <tls_session_decoder.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+
+namespace {
+
+    // one decrypt_tls_data per label and direction, as it was done before the decoder
+    std::vector<std::vector<uint8_t>> decrypted_per_label( const ntk::session& packet_data, const ntk::four_tuple& four,
+                                                           bool server, bool handshake ) {
+
+        auto client_tls_records = ntk::extract_tls_records( ntk::extract_payloads( four, packet_data ) ).records;
+        auto server_tls_records = ntk::extract_tls_records( ntk::extract_payloads( ntk::flip_four( four ), packet_data ) ).records;
+
+        auto client_hello = ntk::get_client_hello( client_tls_records[ 0 ] );
+        auto server_hello = ntk::get_server_hello( server_tls_records[ 0 ] );
+
+        auto& records = server ? server_tls_records : client_tls_records;
+        std::vector<ntk::tls_record> records_to_decrypt;
+        if ( handshake ) {
+            records_to_decrypt.assign( records.begin() + 2, records.begin() + 3 );
+        } else {
+            records_to_decrypt.assign( records.begin() + 3, records.end() );
+        }
+
+        std::string label = handshake ? ( server ? "SERVER_HANDSHAKE_TRAFFIC_SECRET" : "CLIENT_HANDSHAKE_TRAFFIC_SECRET" )
+                                      : ( server ? "SERVER_TRAFFIC_SECRET_0" : "CLIENT_TRAFFIC_SECRET_0" );
+
+        auto decrypted = ntk::decrypt_tls_data( client_hello.random, server_hello.random, server_hello.server_version,
+            server_hello.cipher_suite, records_to_decrypt, ntk::get_tls_secrets( "sslkeys.log", client_hello.random ), label );
+
+        std::vector<std::vector<uint8_t>> payloads;
+        for ( auto& record : decrypted ) {
+            record.payload.pop_back();
+            payloads.push_back( record.payload );
+        }
+        return payloads;
+    }
+
+    std::vector<std::vector<uint8_t>> transcript_records( const ntk::tls_transcript& transcript,
+                                                          ntk::stream_direction direction, ntk::tls_epoch epoch ) {
+        std::vector<std::vector<uint8_t>> payloads;
+        for ( auto& record : transcript.records ) {
+            if ( record.direction != direction || record.epoch != epoch ) continue;
+            auto content = transcript.content( record );
+            payloads.emplace_back( content.begin(), content.end() );
+        }
+        return payloads;
+    }
+
+} // namespace
+
+TEST( TLSSessionDecoderTests, MatchesDecryptionPerLabel ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "long_stream" ] );
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+
+    ntk::key_log_store key_log( "sslkeys.log" );
+    auto transcript = ntk::decode_tls13_session( four, packet_data, key_log );
+
+    ASSERT_TRUE( transcript.has_value() ) << transcript.error();
+
+    for ( bool server : { true, false } ) {
+        auto direction = server ? ntk::stream_direction::SERVER_TO_CLIENT : ntk::stream_direction::CLIENT_TO_SERVER;
+        ASSERT_EQ( transcript_records( *transcript, direction, ntk::tls_epoch::HANDSHAKE ),
+                   decrypted_per_label( packet_data, four, server, true ) );
+        ASSERT_EQ( transcript_records( *transcript, direction, ntk::tls_epoch::APPLICATION ),
+                   decrypted_per_label( packet_data, four, server, false ) );
+    }
+
+    // the hellos lead, the client's first
+    ASSERT_GE( transcript->records.size(), 2 );
+    ASSERT_EQ( transcript->records[ 0 ].direction, ntk::stream_direction::CLIENT_TO_SERVER );
+    ASSERT_EQ( transcript->records[ 0 ].epoch, ntk::tls_epoch::PLAINTEXT );
+    ASSERT_EQ( transcript->records[ 1 ].direction, ntk::stream_direction::SERVER_TO_CLIENT );
+
+    for ( auto& record : transcript->records ) ASSERT_EQ( record.generation, 0 );
+}
+
+TEST( TLSSessionDecoderTests, InterleavesDirections ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "long_stream" ] );
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+
+    ntk::key_log_store key_log( "sslkeys.log" );
+    auto transcript = ntk::decode_tls13_session( four, packet_data, key_log );
+
+    ASSERT_TRUE( transcript.has_value() ) << transcript.error();
+
+    // the first request comes before the response to it
+    size_t request = transcript->records.size();
+    size_t response = transcript->records.size();
+    for ( size_t i = 0; i < transcript->records.size(); ++i ) {
+        auto& record = transcript->records[ i ];
+        if ( record.type != ntk::tls_content_type::APPLICATION_DATA ) continue;
+        auto& first = record.direction == ntk::stream_direction::CLIENT_TO_SERVER ? request : response;
+        if ( first == transcript->records.size() ) first = i;
+    }
+    ASSERT_LT( request, response );
+    ASSERT_LT( response, transcript->records.size() );
+
+    auto body = transcript->application_data( ntk::stream_direction::SERVER_TO_CLIENT );
+    size_t expected_size = 0;
+    for ( auto& payload : decrypted_per_label( packet_data, four, true, false ) ) expected_size += payload.size();
+    ASSERT_EQ( body.size(), expected_size );
+}
+
+TEST( TLSSessionDecoderTests, ReportsMissingSecrets ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "long_stream" ] );
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+
+    ntk::key_log_store key_log;
+    auto transcript = ntk::decode_tls13_session( four, packet_data, key_log );
+
+    ASSERT_FALSE( transcript.has_value() );
+    ASSERT_NE( transcript.error().find( "HANDSHAKE_TRAFFIC_SECRET" ), std::string::npos );
+}
+
+TEST( TLSSessionDecoderTests, NextTrafficSecret ) {
+
+    std::vector<uint8_t> secret( 32, 0x42 );
+
+    auto next = ntk::next_traffic_secret( static_cast<uint16_t>( ntk::cipher_suite::TLS_AES_128_GCM_SHA256 ), secret );
+
+    ASSERT_EQ( next.size(), 32 );
+    ASSERT_NE( next, secret );
+    ASSERT_EQ( next, ntk::next_traffic_secret( static_cast<uint16_t>( ntk::cipher_suite::TLS_AES_128_GCM_SHA256 ), secret ) );
+    ASSERT_EQ( ntk::next_traffic_secret( static_cast<uint16_t>( ntk::cipher_suite::TLS_AES_256_GCM_SHA384 ),
+                                         std::vector<uint8_t>( 48, 0x42 ) ).size(), 48 );
+}
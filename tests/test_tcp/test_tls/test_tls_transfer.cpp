@@ -59,4 +59,63 @@ TEST( TCPLiveStreamSession, OffloadQueueTLSFilter ) {
 
     ASSERT_TRUE( live_stream_session.number_of_completed_transfers() == 0 );
     ASSERT_TRUE( offload_queue.empty() );
-}
\ No newline at end of file
+}
+TEST( TCPLiveStreamSession, TLSLiveStreamParsesOnDemand ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "long_stream" ] );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue );
+
+    for ( auto& packet : packet_data ) live_stream_session.feed( packet );
+    live_stream_session.flush();
+
+    auto stream = offload_queue.try_pop();
+    ASSERT_TRUE( stream.has_value() );
+
+    auto client_payload = stream->client_payload();
+    ntk::tls_live_stream tls_stream( std::move( *stream ) );
+
+    // the payload was moved over, not copied
+    ASSERT_EQ( tls_stream.client_payload().data(), client_payload.data() );
+
+    auto four = *ntk::get_four_tuples( packet_data ).begin();
+    auto client_tls_records = ntk::extract_tls_records( ntk::extract_payloads( four, packet_data ) ).records;
+    auto server_tls_records = ntk::extract_tls_records( ntk::extract_payloads( ntk::flip_four( four ), packet_data ) ).records;
+
+    ASSERT_TRUE( tls_stream.get_client_hello().has_value() );
+    ASSERT_EQ( *tls_stream.get_client_hello(), ntk::get_client_hello( client_tls_records[ 0 ] ) );
+
+    ASSERT_TRUE( tls_stream.get_server_hello().has_value() );
+    ASSERT_EQ( tls_stream.get_server_hello()->random, ntk::get_server_hello( server_tls_records[ 0 ] ).random );
+    ASSERT_EQ( tls_stream.get_server_hello()->cipher_suite, ntk::get_server_hello( server_tls_records[ 0 ] ).cipher_suite );
+
+    ASSERT_EQ( tls_stream.get_sni(), *ntk::get_sni( *tls_stream.get_client_hello() ) );
+
+    ASSERT_EQ( tls_stream.client_records().size(), client_tls_records.size() );
+    ASSERT_EQ( tls_stream.server_records().size(), server_tls_records.size() );
+    ASSERT_EQ( tls_stream.server_records().back().payload, server_tls_records.back().payload );
+
+    // asked again, the same parse is handed back
+    ASSERT_EQ( &tls_stream.client_records(), &tls_stream.client_records() );
+}
+
+TEST( TCPLiveStreamSession, TLSLiveStreamWithoutHello ) {
+
+    auto packet_data = ntk::read_packets_from_file( test::packet_data_files[ "tiny_cross" ] );
+
+    ntk::spmc_transfer_queue<ntk::tcp_live_stream> offload_queue;
+    ntk::tcp_live_stream_session live_stream_session( &offload_queue );
+
+    for ( auto& packet : packet_data ) live_stream_session.feed( packet );
+    live_stream_session.flush();
+
+    auto stream = offload_queue.try_pop();
+    ASSERT_TRUE( stream.has_value() );
+
+    ntk::tls_live_stream tls_stream( *stream );
+
+    ASSERT_FALSE( tls_stream.get_client_hello().has_value() );
+    ASSERT_FALSE( tls_stream.get_server_hello().has_value() );
+    ASSERT_EQ( tls_stream.get_sni(), "No sever name found" );
+}
@@ -0,0 +1,258 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+#include <openssl/evp.h>
+
+#include <quic.hpp>
+#include <tcp.hpp>
+#include <tls.hpp>
+#include <udp.hpp>
+#include <utils.hpp>
+
+#include <test_constants.hpp>
+#include <test_tls_handshake_packets.hpp>
+
+namespace {
+
+    // rfc 9001 a.1
+    const std::vector<uint8_t> rfc_connection_id = { 0x83, 0x94, 0xc8, 0xf0, 0x3e, 0x51, 0x57, 0x08 };
+
+    const ntk::four_tuple quic_connection = {
+        .client_ip = 0xc0a80015,    // 192.168.0.21
+        .server_ip = 0x5db8d822,    // 93.184.216.34
+        .client_port = 50214,
+        .server_port = 443
+    };
+
+    std::vector<uint8_t> bytes_from_hex( std::string_view hex ) {
+        std::vector<uint8_t> bytes;
+        for ( size_t i = 0; i + 1 < hex.size(); i += 2 ) bytes.push_back( static_cast<uint8_t>( std::stoi( std::string( hex.substr( i, 2 ) ), nullptr, 16 ) ) );
+        return bytes;
+    }
+
+    // the ClientHello handshake message of the tls capture, header included
+    std::vector<uint8_t> client_hello_message() {
+        auto payload = ntk::extract_payload_from_ethernet( test_constants::tls_client_hello_packet );
+        size_t len = ( payload[ 6 ] << 16 ) | ( payload[ 7 ] << 8 ) | payload[ 8 ];
+        return std::vector<uint8_t>( payload.begin() + 5, payload.begin() + 5 + 4 + len );
+    }
+
+    void push_varint( std::vector<uint8_t>& out, uint16_t value ) {
+        out.push_back( static_cast<uint8_t>( 0x40 | ( value >> 8 ) ) );
+        out.push_back( static_cast<uint8_t>( value ) );
+    }
+
+    std::vector<uint8_t> crypto_frame( uint16_t offset, std::span<const uint8_t> data ) {
+        std::vector<uint8_t> frame = { 0x06 };
+        push_varint( frame, offset );
+        push_varint( frame, static_cast<uint16_t>( data.size() ) );
+        frame.insert( frame.end(), data.begin(), data.end() );
+        frame.insert( frame.end(), 8, 0x00 );   // padding frames
+        return frame;
+    }
+
+    // a client Initial packet around frames, protected the way rfc 9001 5 has it with a two byte packet number
+    std::vector<uint8_t> protect_initial( const std::vector<uint8_t>& dcid, uint16_t packet_number, const std::vector<uint8_t>& frames ) {
+
+        auto keys = ntk::derive_quic_initial_keys( dcid );
+        const size_t pn_len = 2;
+        const size_t tag_len = 16;
+
+        std::vector<uint8_t> packet = { 0xc0 | ( pn_len - 1 ), 0x00, 0x00, 0x00, 0x01, static_cast<uint8_t>( dcid.size() ) };
+        packet.insert( packet.end(), dcid.begin(), dcid.end() );
+        packet.push_back( 0x00 );   // no source connection id
+        packet.push_back( 0x00 );   // no token
+        push_varint( packet, static_cast<uint16_t>( pn_len + frames.size() + tag_len ) );
+        size_t pn_offset = packet.size();
+        packet.push_back( static_cast<uint8_t>( packet_number >> 8 ) );
+        packet.push_back( static_cast<uint8_t>( packet_number ) );
+
+        std::vector<uint8_t> nonce = keys.iv;
+        nonce[ nonce.size() - 2 ] ^= static_cast<uint8_t>( packet_number >> 8 );
+        nonce[ nonce.size() - 1 ] ^= static_cast<uint8_t>( packet_number );
+
+        std::vector<uint8_t> cipher_text( frames.size() );
+        std::array<uint8_t,16> tag;
+        int len = 0;
+
+        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+        EVP_EncryptInit_ex( ctx, EVP_aes_128_gcm(), nullptr, keys.key.data(), nonce.data() );
+        EVP_EncryptUpdate( ctx, nullptr, &len, packet.data(), static_cast<int>( packet.size() ) );
+        EVP_EncryptUpdate( ctx, cipher_text.data(), &len, frames.data(), static_cast<int>( frames.size() ) );
+        EVP_EncryptFinal_ex( ctx, cipher_text.data() + len, &len );
+        EVP_CIPHER_CTX_ctrl( ctx, EVP_CTRL_GCM_GET_TAG, 16, tag.data() );
+        EVP_CIPHER_CTX_free( ctx );
+
+        packet.insert( packet.end(), cipher_text.begin(), cipher_text.end() );
+        packet.insert( packet.end(), tag.begin(), tag.end() );
+
+        std::array<uint8_t,16> mask;
+        ctx = EVP_CIPHER_CTX_new();
+        EVP_EncryptInit_ex( ctx, EVP_aes_128_ecb(), nullptr, keys.hp.data(), nullptr );
+        EVP_CIPHER_CTX_set_padding( ctx, 0 );
+        EVP_EncryptUpdate( ctx, mask.data(), &len, packet.data() + pn_offset + 4, 16 );
+        EVP_CIPHER_CTX_free( ctx );
+
+        packet[ 0 ] ^= mask[ 0 ] & 0x0f;
+        for ( size_t i = 0; i < pn_len; ++i ) packet[ pn_offset + i ] ^= mask[ 1 + i ];
+
+        return packet;
+    }
+
+    // the ClientHello over two datagrams, the second half first
+    std::array<std::vector<uint8_t>,2> split_client_hello() {
+
+        auto hello = client_hello_message();
+        std::span<const uint8_t> whole( hello );
+        size_t half = hello.size() / 2;
+
+        auto first = protect_initial( rfc_connection_id, 0, crypto_frame( half, whole.subspan( half ) ) );
+        auto second = protect_initial( rfc_connection_id, 1, crypto_frame( 0, whole.first( half ) ) );
+
+        // coalesced behind it, a Handshake packet the Initial keys cannot open
+        std::vector<uint8_t> handshake = { 0xe1, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x40, 0x14 };
+        handshake.insert( handshake.end(), 20, 0xaa );
+        second.insert( second.end(), handshake.begin(), handshake.end() );
+
+        return { first, second };
+    }
+
+    std::vector<uint8_t> udp_frame( const ntk::four_tuple& four, std::span<const uint8_t> payload ) {
+
+        uint32_t source = four.client_ip.v4();
+        uint32_t destination = four.server_ip.v4();
+        size_t udp_len = ntk::constants::udp_header_len + payload.size();
+        size_t total_len = 20 + udp_len;
+
+        std::vector<uint8_t> frame( test::ethernet_frame_udp, test::ethernet_frame_udp + ntk::constants::ethernet_header_len );
+        frame.insert( frame.end(), {
+            0x45, 0x00, static_cast<uint8_t>( total_len >> 8 ), static_cast<uint8_t>( total_len ), 0x00, 0x01, 0x00, 0x00, 0x40, 0x11, 0x00, 0x00,
+            static_cast<uint8_t>( source >> 24 ), static_cast<uint8_t>( source >> 16 ), static_cast<uint8_t>( source >> 8 ), static_cast<uint8_t>( source ),
+            static_cast<uint8_t>( destination >> 24 ), static_cast<uint8_t>( destination >> 16 ), static_cast<uint8_t>( destination >> 8 ), static_cast<uint8_t>( destination ),
+            static_cast<uint8_t>( four.client_port >> 8 ), static_cast<uint8_t>( four.client_port ),
+            static_cast<uint8_t>( four.server_port >> 8 ), static_cast<uint8_t>( four.server_port ),
+            static_cast<uint8_t>( udp_len >> 8 ), static_cast<uint8_t>( udp_len ), 0x00, 0x00
+        } );
+        frame.insert( frame.end(), payload.begin(), payload.end() );
+        return frame;
+    }
+
+}
+
+TEST( QUICTests, DerivesInitialKeys ) {
+
+    auto client = ntk::derive_quic_initial_keys( rfc_connection_id );
+    ASSERT_EQ( client.key, bytes_from_hex( "1f369613dd76d5467730efcbe3b1a22d" ) );
+    ASSERT_EQ( client.iv, bytes_from_hex( "fa044b2f42a3fd3b46fb255c" ) );
+    ASSERT_EQ( client.hp, bytes_from_hex( "9f50449e04a0e810283a1e9933adedd2" ) );
+
+    auto server = ntk::derive_quic_initial_keys( rfc_connection_id, false );
+    ASSERT_EQ( server.key, bytes_from_hex( "cf3a5331653c364c88f0f379b6067e37" ) );
+    ASSERT_EQ( server.iv, bytes_from_hex( "0ac1493ca1905853b0bba03e" ) );
+    ASSERT_EQ( server.hp, bytes_from_hex( "c206b8d9b9f0f37644430b490eeaa314" ) );
+}
+
+TEST( QUICTests, ReadsVarints ) {
+
+    // rfc 9000 a.1
+    auto encoded = bytes_from_hex( "c2197c5eff14e88c9d7f3e7d7bbd254025" );
+    size_t pos = 0;
+
+    ASSERT_EQ( ntk::read_quic_varint( encoded, pos ), 151288809941952652ull );
+    ASSERT_EQ( ntk::read_quic_varint( encoded, pos ), 494878333 );
+    ASSERT_EQ( ntk::read_quic_varint( encoded, pos ), 15293 );
+    ASSERT_EQ( ntk::read_quic_varint( encoded, pos ), 37 );
+    ASSERT_EQ( ntk::read_quic_varint( encoded, pos ), 37 );
+    ASSERT_EQ( pos, encoded.size() );
+    ASSERT_FALSE( ntk::read_quic_varint( encoded, pos ).has_value() );
+
+    // a length prefix running past the end leaves pos where it was
+    pos = 0;
+    ASSERT_FALSE( ntk::read_quic_varint( std::span<const uint8_t>( encoded ).first( 3 ), pos ).has_value() );
+    ASSERT_EQ( pos, 0 );
+}
+
+TEST( QUICTests, ReassemblesClientHelloAcrossDatagrams ) {
+
+    auto [ first, second ] = split_client_hello();
+
+    ntk::quic_initial_decoder decoder;
+
+    ASSERT_TRUE( decoder.feed( first ) );
+    ASSERT_FALSE( decoder.client_hello().has_value() );
+    ASSERT_FALSE( decoder.sni().has_value() );
+
+    ASSERT_TRUE( decoder.feed( second ) );
+    ASSERT_EQ( decoder.packets(), 2 );
+    ASSERT_EQ( decoder.client_hello()->size(), client_hello_message().size() - 4 );
+    ASSERT_EQ( decoder.sni(), "earthcam.com" );
+
+    // neither half names the server on its own
+    ASSERT_FALSE( ntk::peek_quic_sni( first ).has_value() );
+    ASSERT_FALSE( ntk::peek_quic_sni( second ).has_value() );
+
+    auto hello = client_hello_message();
+    auto whole = protect_initial( rfc_connection_id, 0, crypto_frame( 0, hello ) );
+    ASSERT_EQ( ntk::peek_quic_sni( whole ), "earthcam.com" );
+
+    // a flipped bit fails authentication, and tls over tcp is no quic
+    whole[ whole.size() - 1 ] ^= 0x01;
+    ASSERT_FALSE( ntk::quic_initial_decoder().feed( whole ) );
+    ASSERT_FALSE( ntk::peek_quic_sni( ntk::extract_payload_from_ethernet( test_constants::tls_client_hello_packet ) ).has_value() );
+}
+
+TEST( QUICTests, ClassifiesFlowsOnTheirInitialPackets ) {
+
+    auto [ first, second ] = split_client_hello();
+
+    auto other = quic_connection;
+    other.client_port += 1;
+    std::vector<uint8_t> query = { 0x12, 0x34, 0x01, 0x00 };
+
+    ntk::udp_flow_session session;
+    session.set_classifier( ntk::quic_sni_classifier( "earthcam" ) );
+
+    // undecided until the second half of the ClientHello is in
+    session.feed( udp_frame( quic_connection, first ) );
+    session.feed( udp_frame( ntk::flip_four( quic_connection ), query ) );
+    ASSERT_NE( session.find( quic_connection ), nullptr );
+    session.feed( udp_frame( quic_connection, second ) );
+
+    // not quic, dropped on its first datagram and ignored after
+    session.feed( udp_frame( other, query ) );
+    session.feed( udp_frame( other, query ) );
+
+    ASSERT_EQ( session.size(), 1 );
+    ASSERT_EQ( ntk::get_quic_sni( *session.find( quic_connection ) ), "earthcam.com" );
+
+    auto statistics = session.statistics();
+    ASSERT_EQ( statistics.flows_opened, 2 );
+    ASSERT_EQ( statistics.flows_dropped, 1 );
+    ASSERT_EQ( statistics.datagrams_unmatched, 1 );
+
+    // a ClientHello for another host is dropped once it is whole
+    ntk::udp_flow_session elsewhere;
+    elsewhere.set_classifier( ntk::quic_sni_classifier( "example.com" ) );
+    elsewhere.feed( udp_frame( quic_connection, first ) );
+    ASSERT_EQ( elsewhere.size(), 1 );
+    elsewhere.feed( udp_frame( quic_connection, second ) );
+    ASSERT_EQ( elsewhere.size(), 0 );
+
+    // headers only keeps counting quic without holding its datagrams
+    ntk::udp_flow_session counted;
+    counted.set_classifier( ntk::quic_classifier( ntk::flow_verdict::HEADERS_ONLY ) );
+    counted.feed( udp_frame( quic_connection, first ) );
+    counted.feed( udp_frame( quic_connection, second ) );
+    counted.feed( udp_frame( quic_connection, query ) );
+
+    const ntk::udp_flow* flow = counted.find( quic_connection );
+    ASSERT_NE( flow, nullptr );
+    ASSERT_EQ( flow->client().datagrams, 3 );
+    ASSERT_TRUE( flow->datagrams().empty() );
+}
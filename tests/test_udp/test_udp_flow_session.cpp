@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+#include <ipv4.hpp>
+#include <spmc_queue.hpp>
+#include <tcp.hpp>
+#include <udp.hpp>
+
+#include <test_constants.hpp>
+
+namespace {
+
+    const ntk::four_tuple resolver_query = {
+        .client_ip = 0xc0a80015,    // 192.168.0.21
+        .server_ip = 0x08080808,    // 8.8.8.8
+        .client_port = 53124,
+        .server_port = 53
+    };
+
+    // an ethernet / ipv4 / udp frame from source to destination of four
+    std::vector<uint8_t> udp_frame( const ntk::four_tuple& four, std::string_view payload, uint16_t identification = 1 ) {
+
+        uint32_t source = four.client_ip.v4();
+        uint32_t destination = four.server_ip.v4();
+        size_t udp_len = ntk::constants::udp_header_len + payload.size();
+        size_t total_len = 20 + udp_len;
+
+        std::vector<uint8_t> frame( test::ethernet_frame_udp, test::ethernet_frame_udp + ntk::constants::ethernet_header_len );
+        frame.insert( frame.end(), {
+            0x45, 0x00, static_cast<uint8_t>( total_len >> 8 ), static_cast<uint8_t>( total_len ),
+            static_cast<uint8_t>( identification >> 8 ), static_cast<uint8_t>( identification ), 0x00, 0x00, 0x40, 0x11, 0x00, 0x00,
+            static_cast<uint8_t>( source >> 24 ), static_cast<uint8_t>( source >> 16 ), static_cast<uint8_t>( source >> 8 ), static_cast<uint8_t>( source ),
+            static_cast<uint8_t>( destination >> 24 ), static_cast<uint8_t>( destination >> 16 ), static_cast<uint8_t>( destination >> 8 ), static_cast<uint8_t>( destination ),
+            static_cast<uint8_t>( four.client_port >> 8 ), static_cast<uint8_t>( four.client_port ),
+            static_cast<uint8_t>( four.server_port >> 8 ), static_cast<uint8_t>( four.server_port ),
+            static_cast<uint8_t>( udp_len >> 8 ), static_cast<uint8_t>( udp_len ), 0x00, 0x00
+        } );
+        frame.insert( frame.end(), payload.begin(), payload.end() );
+        return frame;
+    }
+
+    std::vector<uint8_t> bytes_of( std::string_view text ) {
+        return std::vector<uint8_t>( text.begin(), text.end() );
+    }
+
+}
+
+TEST( UDPFlowSessionTests, DecodesDatagrams ) {
+
+    auto frame = udp_frame( resolver_query, "query" );
+    frame.insert( frame.end(), 6, 0x00 );   // ethernet padding
+
+    auto datagram = ntk::decode_datagram( frame );
+
+    ASSERT_TRUE( datagram.has_value() );
+    ASSERT_EQ( datagram->four(), resolver_query );
+    ASSERT_EQ( std::vector<uint8_t>( datagram->payload.begin(), datagram->payload.end() ), bytes_of( "query" ) );
+    ASSERT_TRUE( ntk::is_udp( frame.data() ) );
+
+    // tcp is not udp, and neither is udp tcp
+    ASSERT_FALSE( ntk::decode_datagram( std::span<const uint8_t>( test::ethernet_frame_tcp, sizeof( test::ethernet_frame_tcp ) ) ).has_value() );
+    ASSERT_FALSE( ntk::decode_packet( frame ).has_value() );
+    ASSERT_FALSE( ntk::is_udp( test::ethernet_frame_tcp ) );
+
+    auto header = ntk::parse_udp_header( ntk::extract_udp_header( frame.data(), 20 ) );
+    ASSERT_EQ( header.destination_port, 53 );
+    ASSERT_EQ( header.length, 13 );
+}
+
+TEST( UDPFlowSessionTests, GroupsBothDirections ) {
+
+    ntk::spmc_transfer_queue<ntk::udp_flow> offload_queue;
+    ntk::udp_flow_session session( &offload_queue );
+
+    auto other = resolver_query;
+    other.client_port += 1;
+
+    session.feed( udp_frame( resolver_query, "query" ) );
+    session.feed( udp_frame( ntk::flip_four( resolver_query ), "answer!" ) );
+    session.feed( udp_frame( other, "another query" ) );
+    session.feed( std::vector<uint8_t>( test::ethernet_frame_tcp, test::ethernet_frame_tcp + sizeof( test::ethernet_frame_tcp ) ) );
+
+    ASSERT_EQ( session.size(), 2 );
+
+    const ntk::udp_flow* flow = session.find( ntk::flip_four( resolver_query ) );
+    ASSERT_NE( flow, nullptr );
+    ASSERT_EQ( flow->get_four_tuple(), resolver_query );
+    ASSERT_EQ( flow->client().datagrams, 1 );
+    ASSERT_EQ( flow->client().bytes, 5 );
+    ASSERT_EQ( flow->server().bytes, 7 );
+    ASSERT_EQ( flow->datagrams().size(), 2 );
+    ASSERT_TRUE( flow->datagrams()[ 0 ].from_client );
+    ASSERT_FALSE( flow->datagrams()[ 1 ].from_client );
+    ASSERT_EQ( flow->datagrams()[ 1 ].payload, bytes_of( "answer!" ) );
+    ASSERT_FALSE( flow->first_packet().has_value() );
+
+    auto statistics = session.statistics();
+    ASSERT_EQ( statistics.datagrams_fed, 4 );
+    ASSERT_EQ( statistics.datagrams_unmatched, 1 );
+    ASSERT_EQ( statistics.flows_opened, 2 );
+
+    // without timestamps nothing expires, a flush hands over what is open
+    ASSERT_EQ( session.flush(), 2 );
+    ASSERT_EQ( session.size(), 0 );
+
+    auto offloaded = offload_queue.pop_for( std::chrono::milliseconds( 100 ) );
+    ASSERT_TRUE( offloaded.has_value() );
+    ASSERT_EQ( offloaded->reason(), ntk::close_reason::SHUTDOWN );
+    ASSERT_EQ( session.statistics().flows_offloaded, 2 );
+}
+
+TEST( UDPFlowSessionTests, IdleFlowsExpire ) {
+
+    ntk::udp_session_limits limits;
+    limits.idle_timeout = std::chrono::seconds( 5 );
+    limits.max_flow_datagrams = 2;
+
+    ntk::spmc_transfer_queue<ntk::udp_flow> offload_queue;
+    ntk::udp_flow_session session( &offload_queue, limits );
+
+    auto start = ntk::capture_time( std::chrono::seconds( 1000 ) );
+
+    for ( int i = 0; i < 3; ++i ) {
+        session.feed( ntk::make_captured_packet( start + std::chrono::seconds( i ), udp_frame( resolver_query, "query" ) ) );
+    }
+
+    // the deadline moved with the last datagram
+    session.advance_time( start + std::chrono::seconds( 6 ) );
+    ASSERT_EQ( session.size(), 1 );
+    ASSERT_TRUE( offload_queue.empty() );
+
+    session.advance_time( start + std::chrono::seconds( 7 ) );
+    ASSERT_EQ( session.size(), 0 );
+
+    auto flow = offload_queue.pop_for( std::chrono::milliseconds( 100 ) );
+    ASSERT_TRUE( flow.has_value() );
+    ASSERT_EQ( flow->reason(), ntk::close_reason::IDLE );
+    ASSERT_EQ( flow->client().datagrams, 3 );
+    ASSERT_EQ( flow->datagrams().size(), 2 );
+    ASSERT_TRUE( flow->datagrams_truncated() );
+    ASSERT_EQ( *flow->duration(), std::chrono::seconds( 2 ) );
+    ASSERT_EQ( session.statistics().flows_evicted, 1 );
+}
+
+TEST( UDPFlowSessionTests, FragmentedDatagramsAreReassembled ) {
+
+    std::string payload( 3000, 'q' );
+    auto frame = udp_frame( resolver_query, payload, 0x4242 );
+
+    // two fragments, the first with the udp header and 1472 bytes of payload
+    const size_t ip_offset = ntk::constants::ethernet_header_len;
+    const size_t first_len = 1480;
+
+    std::vector<uint8_t> first( frame.begin(), frame.begin() + ip_offset + 20 + first_len );
+    first[ ip_offset + 2 ] = static_cast<uint8_t>( ( 20 + first_len ) >> 8 );
+    first[ ip_offset + 3 ] = static_cast<uint8_t>( 20 + first_len );
+    first[ ip_offset + 6 ] = 0x20;
+
+    std::vector<uint8_t> second( frame.begin(), frame.begin() + ip_offset + 20 );
+    second.insert( second.end(), frame.begin() + ip_offset + 20 + first_len, frame.end() );
+    size_t second_len = second.size() - ip_offset;
+    second[ ip_offset + 2 ] = static_cast<uint8_t>( second_len >> 8 );
+    second[ ip_offset + 3 ] = static_cast<uint8_t>( second_len );
+    second[ ip_offset + 6 ] = static_cast<uint8_t>( ( first_len / 8 ) >> 8 );
+    second[ ip_offset + 7 ] = static_cast<uint8_t>( first_len / 8 );
+
+    ASSERT_FALSE( ntk::decode_datagram( first ).has_value() );
+
+    ntk::udp_flow_session session;
+    session.feed( second );
+    session.feed( first );
+
+    const ntk::udp_flow* flow = session.find( resolver_query );
+    ASSERT_NE( flow, nullptr );
+    ASSERT_EQ( flow->client().bytes, payload.size() );
+    ASSERT_EQ( flow->datagrams()[ 0 ].payload, bytes_of( payload ) );
+    ASSERT_EQ( session.fragments().datagrams_reassembled, 1 );
+    ASSERT_EQ( session.statistics().datagrams_fed, 1 );
+}